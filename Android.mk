@@ -18,6 +18,7 @@ include $(MY_LOCAL_PATH)/visualizer/Android.mk
 include $(MY_LOCAL_PATH)/post_proc/Android.mk
 include $(MY_LOCAL_PATH)/qahw/Android.mk
 include $(MY_LOCAL_PATH)/qahw_api/Android.mk
+include $(MY_LOCAL_PATH)/alsa_sim/Android.mk
 endif
 
 ifeq ($(USE_LEGACY_AUDIO_DAEMON), true)
@@ -0,0 +1,72 @@
+ifeq ($(strip $(AUDIO_FEATURE_ENABLED_ALSA_SIM)),true)
+
+LOCAL_PATH := $(call my-dir)
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := libalsa_sim
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_SRC_FILES := \
+    src/alsa_sim.c \
+    src/sim_pcm.c \
+    src/sim_mixer.c \
+    src/sim_compress.c
+
+LOCAL_C_INCLUDES := \
+    $(LOCAL_PATH)/inc \
+    external/tinyalsa/include \
+    external/tinycompress/include \
+    external/expat/lib
+
+LOCAL_HEADER_LIBRARIES := libutils_headers \
+    libsystem_headers
+
+LOCAL_SHARED_LIBRARIES := \
+    liblog \
+    libcutils \
+    libexpat
+
+LOCAL_EXPORT_C_INCLUDE_DIRS := $(LOCAL_PATH)/inc
+
+LOCAL_CFLAGS += -Wall -Werror
+
+LOCAL_PROPRIETARY_MODULE := true
+LOCAL_VENDOR_MODULE := true
+
+include $(BUILD_SHARED_LIBRARY)
+
+# host build, for running the HAL and its tests on the build machine
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := libalsa_sim
+LOCAL_MODULE_TAGS := optional
+
+LOCAL_SRC_FILES := \
+    src/alsa_sim.c \
+    src/sim_pcm.c \
+    src/sim_mixer.c \
+    src/sim_compress.c
+
+LOCAL_C_INCLUDES := \
+    $(LOCAL_PATH)/inc \
+    external/tinyalsa/include \
+    external/tinycompress/include \
+    external/expat/lib
+
+LOCAL_HEADER_LIBRARIES := libutils_headers \
+    libsystem_headers
+
+LOCAL_SHARED_LIBRARIES := \
+    liblog \
+    libcutils \
+    libexpat
+
+LOCAL_EXPORT_C_INCLUDE_DIRS := $(LOCAL_PATH)/inc
+
+LOCAL_CFLAGS += -Wall -Werror
+
+include $(BUILD_HOST_SHARED_LIBRARY)
+
+include $(LOCAL_PATH)/test/Android.mk
+endif
@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2020, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef ALSA_SIM_H
+#define ALSA_SIM_H
+
+#include <stdint.h>
+#include <sys/cdefs.h>
+
+__BEGIN_DECLS
+
+/*
+ * Simulated sound card for running the audio HAL without ALSA hardware.
+ *
+ * libalsa_sim implements the tinyalsa PCM/mixer and tinycompress entry points
+ * used by the HAL and libaudioroute. It is either preloaded
+ * (LD_PRELOAD=libalsa_sim.so) or linked in place of libtinyalsa and
+ * libtinycompress. PCM and compress streams are paced by a device clock that
+ * runs at ALSA_SIM_SPEED times wall clock, with the hw pointer moving in
+ * period steps unless the stream is opened PCM_NOIRQ/PCM_MMAP.
+ *
+ * Environment, read once on first use:
+ *   ALSA_SIM_SPEED         device clock rate vs wall clock, default 1.0.
+ *                          0 lets the card consume/produce data instantly.
+ *   ALSA_SIM_JITTER_US     random extra delay added to each blocking wake up.
+ *   ALSA_SIM_XRUN_PERIODS  force an xrun every N periods of each PCM stream.
+ *   ALSA_SIM_OPEN_US       time spent in pcm_open()/compress_open().
+ *   ALSA_SIM_CARD          card number of the simulated card, default 0.
+ *   ALSA_SIM_CARD_NAME     name returned by mixer_get_name().
+ *   ALSA_SIM_MIXER_PATHS   mixer_paths xml defining the mixer controls, e.g.
+ *                          configs/kona/mixer_paths.xml. Controls missing from
+ *                          it are created on first lookup unless
+ *   ALSA_SIM_MIXER_STRICT  is set to 1.
+ *   ALSA_SIM_COMPR_BITRATE bit rate used to drain compressed data when the
+ *                          codec does not carry one, default 128000.
+ *
+ * The functions below are meant for benchmarks. Look them up with
+ * dlsym(RTLD_DEFAULT, ...) to detect whether the simulated card is in use.
+ */
+
+struct alsa_sim_stats {
+    uint64_t pcm_opens;
+    uint64_t frames_written;      /* playback frames accepted by pcm_write/mmap */
+    uint64_t frames_read;         /* capture frames returned */
+    uint64_t xruns;               /* underruns and overruns, injected ones included */
+    uint64_t blocked_ns;          /* wall clock time spent waiting for the card */
+    uint64_t compr_opens;
+    uint64_t compr_bytes;         /* compressed bytes written or read */
+    uint64_t ctl_writes;          /* mixer control value changes */
+    uint64_t ctl_events;          /* events queued to subscribed mixers */
+};
+
+/* Device clock rate for streams started from now on, see ALSA_SIM_SPEED. */
+void alsa_sim_set_speed(double speed);
+double alsa_sim_get_speed(void);
+
+/* Every running PCM stream takes an xrun at its next transfer. */
+void alsa_sim_inject_xrun(void);
+/* Changes ALSA_SIM_XRUN_PERIODS, 0 disables periodic xruns. */
+void alsa_sim_set_xrun_period(unsigned int periods);
+
+void alsa_sim_get_stats(struct alsa_sim_stats *stats);
+void alsa_sim_reset_stats(void);
+
+/*
+ * Queues a value event for ctl_name to every mixer subscribed to events, as
+ * the DSP does for its event controls. Returns -ENOENT if no such control.
+ */
+int alsa_sim_mixer_notify(const char *ctl_name);
+
+__END_DECLS
+
+#endif /* ALSA_SIM_H */
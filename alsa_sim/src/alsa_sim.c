@@ -0,0 +1,202 @@
+/*
+ * Copyright (c) 2020, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define LOG_TAG "alsa_sim"
+/*#define LOG_NDEBUG 0*/
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <utils/Log.h>
+#ifdef ANDROID
+#include <cutils/ashmem.h>
+#endif
+
+#include "alsa_sim_internal.h"
+
+#define SIM_DEFAULT_CARD_NAME "alsa-sim-snd-card"
+#define SIM_DEFAULT_COMPR_BITRATE 128000
+
+struct alsa_sim_counters sim_counters;
+atomic_uint sim_xrun_generation;
+
+static struct alsa_sim_config config;
+static pthread_once_t config_once = PTHREAD_ONCE_INIT;
+
+static unsigned int env_uint(const char *name, unsigned int def)
+{
+    const char *value = getenv(name);
+
+    if (value == NULL || *value == '\0')
+        return def;
+    return (unsigned int)strtoul(value, NULL, 0);
+}
+
+static void config_init(void)
+{
+    const char *value;
+    double speed = 1.0;
+
+    value = getenv("ALSA_SIM_SPEED");
+    if (value != NULL && *value != '\0') {
+        speed = strtod(value, NULL);
+        if (speed < 0)
+            speed = 1.0;
+    }
+    atomic_init(&config.speed, speed);
+    config.jitter_us = env_uint("ALSA_SIM_JITTER_US", 0);
+    atomic_init(&config.xrun_periods, env_uint("ALSA_SIM_XRUN_PERIODS", 0));
+    config.open_us = env_uint("ALSA_SIM_OPEN_US", 0);
+    config.card = env_uint("ALSA_SIM_CARD", 0);
+    config.compr_bitrate = env_uint("ALSA_SIM_COMPR_BITRATE",
+                                    SIM_DEFAULT_COMPR_BITRATE);
+    if (config.compr_bitrate == 0)
+        config.compr_bitrate = SIM_DEFAULT_COMPR_BITRATE;
+    config.mixer_strict = env_uint("ALSA_SIM_MIXER_STRICT", 0) != 0;
+
+    value = getenv("ALSA_SIM_CARD_NAME");
+    strlcpy(config.card_name, value ? value : SIM_DEFAULT_CARD_NAME,
+            sizeof(config.card_name));
+    value = getenv("ALSA_SIM_MIXER_PATHS");
+    if (value)
+        strlcpy(config.mixer_paths, value, sizeof(config.mixer_paths));
+
+    ALOGI("%s: card %u (%s) speed %.2f jitter %uus xrun every %u periods, mixer %s",
+          __func__, config.card, config.card_name, speed, config.jitter_us,
+          atomic_load(&config.xrun_periods),
+          config.mixer_paths[0] ? config.mixer_paths : "<learned>");
+}
+
+const struct alsa_sim_config *sim_config(void)
+{
+    pthread_once(&config_once, config_init);
+    return &config;
+}
+
+int sim_alloc_fd(const char *name, size_t size)
+{
+    int fd;
+
+#ifdef ANDROID
+    fd = ashmem_create_region(name, size);
+#else
+    fd = syscall(SYS_memfd_create, name, 0);
+    if (fd >= 0 && ftruncate(fd, size) < 0) {
+        close(fd);
+        fd = -1;
+    }
+#endif
+    return fd;
+}
+
+void sim_cond_init(pthread_cond_t *cond)
+{
+    pthread_condattr_t attr;
+
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(cond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+bool sim_cond_wait_ns(pthread_cond_t *cond, pthread_mutex_t *lock,
+                      int64_t ns, unsigned int *seed)
+{
+    const struct alsa_sim_config *cfg = sim_config();
+    struct timespec ts;
+    int64_t start = sim_now_ns();
+    int ret;
+
+    if (ns > SIM_MAX_WAIT_NS)
+        ns = SIM_MAX_WAIT_NS;
+    if (cfg->jitter_us > 0)
+        ns += (int64_t)(rand_r(seed) % (cfg->jitter_us + 1)) * 1000;
+    sim_ns_to_timespec(start + ns, &ts);
+    ret = pthread_cond_timedwait(cond, lock, &ts);
+    atomic_fetch_add(&sim_counters.blocked_ns, (uint64_t)(sim_now_ns() - start));
+    return ret != ETIMEDOUT;
+}
+
+void sim_open_delay(void)
+{
+    const struct alsa_sim_config *cfg = sim_config();
+
+    if (cfg->open_us > 0)
+        usleep(cfg->open_us);
+}
+
+void alsa_sim_set_speed(double speed)
+{
+    if (speed < 0)
+        return;
+    atomic_store(&((struct alsa_sim_config *)sim_config())->speed, speed);
+}
+
+double alsa_sim_get_speed(void)
+{
+    return atomic_load(&sim_config()->speed);
+}
+
+void alsa_sim_inject_xrun(void)
+{
+    atomic_fetch_add(&sim_xrun_generation, 1);
+}
+
+void alsa_sim_set_xrun_period(unsigned int periods)
+{
+    atomic_store(&((struct alsa_sim_config *)sim_config())->xrun_periods, periods);
+}
+
+void alsa_sim_get_stats(struct alsa_sim_stats *stats)
+{
+    stats->pcm_opens = atomic_load(&sim_counters.pcm_opens);
+    stats->frames_written = atomic_load(&sim_counters.frames_written);
+    stats->frames_read = atomic_load(&sim_counters.frames_read);
+    stats->xruns = atomic_load(&sim_counters.xruns);
+    stats->blocked_ns = atomic_load(&sim_counters.blocked_ns);
+    stats->compr_opens = atomic_load(&sim_counters.compr_opens);
+    stats->compr_bytes = atomic_load(&sim_counters.compr_bytes);
+    stats->ctl_writes = atomic_load(&sim_counters.ctl_writes);
+    stats->ctl_events = atomic_load(&sim_counters.ctl_events);
+}
+
+void alsa_sim_reset_stats(void)
+{
+    atomic_store(&sim_counters.pcm_opens, 0);
+    atomic_store(&sim_counters.frames_written, 0);
+    atomic_store(&sim_counters.frames_read, 0);
+    atomic_store(&sim_counters.xruns, 0);
+    atomic_store(&sim_counters.blocked_ns, 0);
+    atomic_store(&sim_counters.compr_opens, 0);
+    atomic_store(&sim_counters.compr_bytes, 0);
+    atomic_store(&sim_counters.ctl_writes, 0);
+    atomic_store(&sim_counters.ctl_events, 0);
+}
@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2020, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef ALSA_SIM_INTERNAL_H
+#define ALSA_SIM_INTERNAL_H
+
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "alsa_sim.h"
+
+#define NSEC_PER_SEC 1000000000LL
+/* longest single wait, streams waiting for a resume or a stop wake up anyway */
+#define SIM_MAX_WAIT_NS (3600 * NSEC_PER_SEC)
+
+struct alsa_sim_config {
+    _Atomic double speed;
+    unsigned int jitter_us;
+    _Atomic unsigned int xrun_periods;
+    unsigned int open_us;
+    unsigned int card;
+    char card_name[64];
+    char mixer_paths[PATH_MAX];
+    bool mixer_strict;
+    unsigned int compr_bitrate;
+};
+
+struct alsa_sim_counters {
+    atomic_uint_fast64_t pcm_opens;
+    atomic_uint_fast64_t frames_written;
+    atomic_uint_fast64_t frames_read;
+    atomic_uint_fast64_t xruns;
+    atomic_uint_fast64_t blocked_ns;
+    atomic_uint_fast64_t compr_opens;
+    atomic_uint_fast64_t compr_bytes;
+    atomic_uint_fast64_t ctl_writes;
+    atomic_uint_fast64_t ctl_events;
+};
+
+extern struct alsa_sim_counters sim_counters;
+/* bumped by alsa_sim_inject_xrun(), streams compare it with the value they saw */
+extern atomic_uint sim_xrun_generation;
+
+const struct alsa_sim_config *sim_config(void);
+/* Opens the shared memory backing a stream buffer, -1 on failure. */
+int sim_alloc_fd(const char *name, size_t size);
+
+static inline int64_t sim_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static inline void sim_ns_to_timespec(int64_t ns, struct timespec *ts)
+{
+    ts->tv_sec = ns / NSEC_PER_SEC;
+    ts->tv_nsec = ns % NSEC_PER_SEC;
+}
+
+/* Device time elapsed between base_ns and now_ns, in units per second of rate. */
+static inline uint64_t sim_elapsed_units(int64_t base_ns, int64_t now_ns,
+                                         double speed, double rate)
+{
+    if (now_ns <= base_ns)
+        return 0;
+    return (uint64_t)((double)(now_ns - base_ns) * speed * rate / NSEC_PER_SEC);
+}
+
+/* Wall clock time the card needs to move units at rate. */
+static inline int64_t sim_units_to_ns(uint64_t units, double speed, double rate)
+{
+    if (speed <= 0 || rate <= 0)
+        return 0;
+    return (int64_t)((double)units * NSEC_PER_SEC / (speed * rate)) + 1;
+}
+
+/*
+ * Waits up to ns on cond, plus the configured jitter. cond must use
+ * CLOCK_MONOTONIC, see sim_cond_init(). Returns false on timeout.
+ */
+bool sim_cond_wait_ns(pthread_cond_t *cond, pthread_mutex_t *lock,
+                      int64_t ns, unsigned int *seed);
+void sim_cond_init(pthread_cond_t *cond);
+void sim_open_delay(void);
+
+#endif /* ALSA_SIM_INTERNAL_H */
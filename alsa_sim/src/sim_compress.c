@@ -0,0 +1,538 @@
+/*
+ * Copyright (c) 2020, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define LOG_TAG "alsa_sim_compress"
+/*#define LOG_NDEBUG 0*/
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <utils/Log.h>
+#include <tinycompress/tinycompress.h>
+
+#include "alsa_sim_internal.h"
+
+#define COMPR_ERR_MAX 128
+#define COMPR_DEFAULT_POLL_WAIT_MS 20000
+
+/*
+ * A simulated compressed stream. The DSP drains the written bytes at
+ * byte_rate while running; running dry simply stalls rendering, as the DSP
+ * does, so compressed streams never xrun. byte_rate is the PCM rate for
+ * SND_AUDIOCODEC_PCM, else the codec bit rate or ALSA_SIM_COMPR_BITRATE.
+ */
+struct compress {
+    int fd;                     /* only used to tell a ready stream apart */
+    unsigned int flags;
+    unsigned int card;
+    unsigned int device;
+    struct compr_config config;
+    struct snd_codec codec;
+    uint64_t buffer_bytes;
+    double byte_rate;
+    unsigned int sample_rate;
+
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    bool running;
+    bool paused;
+    bool nonblock;
+    int max_poll_wait_ms;
+    double speed;
+    uint64_t written;           /* bytes written, or produced for capture */
+    uint64_t done_base;         /* bytes rendered (read for capture) at base_ns */
+    int64_t base_ns;
+    unsigned int seed;
+
+    char error[COMPR_ERR_MAX];
+};
+
+static struct compress bad_compress = {
+    .fd = -1,
+};
+
+static int oops(struct compress *compress, int e, const char *fmt, ...)
+{
+    va_list ap;
+    int sz;
+
+    va_start(ap, fmt);
+    vsnprintf(compress->error, COMPR_ERR_MAX, fmt, ap);
+    va_end(ap);
+    sz = strlen(compress->error);
+
+    snprintf(compress->error + sz, COMPR_ERR_MAX - sz, ": %s", strerror(e));
+    errno = e;
+    return -1;
+}
+
+static inline bool compress_is_capture(const struct compress *compress)
+{
+    return (compress->flags & COMPRESS_OUT) != 0;
+}
+
+/*
+ * Bytes the DSP has consumed (playback) or produced (capture) so far. Once
+ * playback runs dry the clock is rebased, rendering resumes with the next
+ * write.
+ */
+static uint64_t compress_done_l(struct compress *compress, int64_t now)
+{
+    uint64_t done, limit;
+
+    if (!compress->running || compress->paused)
+        return compress->done_base;
+    if (compress->speed <= 0)
+        done = compress_is_capture(compress) ?
+                   compress->written + compress->buffer_bytes : compress->written;
+    else
+        done = compress->done_base + sim_elapsed_units(compress->base_ns, now,
+                                                       compress->speed,
+                                                       compress->byte_rate);
+
+    /* a capture stream stops producing once its buffer is full */
+    limit = compress->written;
+    if (compress_is_capture(compress))
+        limit += compress->buffer_bytes;
+    if (done >= limit) {
+        done = limit;
+        compress->done_base = done;
+        compress->base_ns = now;
+    }
+    return done;
+}
+
+/* Room in the buffer for playback, data available for capture. */
+static uint64_t compress_avail_l(struct compress *compress, int64_t now)
+{
+    uint64_t done = compress_done_l(compress, now);
+
+    if (compress_is_capture(compress))
+        return done - compress->written;
+    return compress->buffer_bytes - (compress->written - done);
+}
+
+/* Waits for until() or the poll wait, -ETIME once that expires. */
+static int compress_wait_l(struct compress *compress, int timeout_ms,
+                           bool (*until)(struct compress *, int64_t))
+{
+    int64_t now = sim_now_ns();
+    int64_t deadline = timeout_ms < 0 ? INT64_MAX : now + (int64_t)timeout_ms * 1000000;
+    int64_t wait_ns;
+
+    while (!until(compress, now)) {
+        if (now >= deadline)
+            return -ETIME;
+        if (!compress->running || compress->paused || compress->speed <= 0)
+            wait_ns = deadline - now;
+        else
+            wait_ns = sim_units_to_ns(compress->config.fragment_size, compress->speed,
+                                      compress->byte_rate);
+        if (wait_ns > deadline - now)
+            wait_ns = deadline - now;
+        sim_cond_wait_ns(&compress->cond, &compress->lock, wait_ns, &compress->seed);
+        now = sim_now_ns();
+        if (compress->fd < 0)
+            return -EBADFD;
+    }
+    return 0;
+}
+
+static bool compress_has_fragment(struct compress *compress, int64_t now)
+{
+    return compress_avail_l(compress, now) >= compress->config.fragment_size;
+}
+
+static bool compress_drained(struct compress *compress, int64_t now)
+{
+    return !compress->running || compress_done_l(compress, now) == compress->written;
+}
+
+struct compress *compress_open(unsigned int card, unsigned int device,
+                               unsigned int flags, struct compr_config *config)
+{
+    const struct alsa_sim_config *cfg = sim_config();
+    struct compress *compress;
+    struct snd_codec *codec;
+    unsigned int bytes_per_sample;
+
+    if (card != cfg->card) {
+        oops(&bad_compress, ENODEV, "cannot open device '/dev/snd/comprC%uD%u'",
+             card, device);
+        return &bad_compress;
+    }
+    if (!config || !config->codec || !config->fragment_size || !config->fragments) {
+        oops(&bad_compress, EINVAL, "invalid compress config");
+        return &bad_compress;
+    }
+
+    compress = calloc(1, sizeof(struct compress));
+    if (!compress) {
+        oops(&bad_compress, ENOMEM, "cannot allocate compress object");
+        return &bad_compress;
+    }
+    codec = &compress->codec;
+    compress->card = card;
+    compress->device = device;
+    compress->flags = flags;
+    compress->config = *config;
+    *codec = *config->codec;
+    compress->config.codec = codec;
+    compress->buffer_bytes = (uint64_t)config->fragment_size * config->fragments;
+    compress->sample_rate = codec->sample_rate ? codec->sample_rate : 48000;
+
+    if (codec->id == SND_AUDIOCODEC_PCM) {
+        switch (codec->format) {
+        case SNDRV_PCM_FORMAT_S24_3LE:
+            bytes_per_sample = 3;
+            break;
+        case SNDRV_PCM_FORMAT_S24_LE:
+        case SNDRV_PCM_FORMAT_S32_LE:
+            bytes_per_sample = 4;
+            break;
+        default:
+            bytes_per_sample = 2;
+            break;
+        }
+        compress->byte_rate = (double)compress->sample_rate *
+                              (codec->ch_in ? codec->ch_in : 2) * bytes_per_sample;
+    } else {
+        compress->byte_rate = (codec->bit_rate ? codec->bit_rate : cfg->compr_bitrate) / 8.0;
+    }
+
+    pthread_mutex_init(&compress->lock, NULL);
+    sim_cond_init(&compress->cond);
+    compress->max_poll_wait_ms = COMPR_DEFAULT_POLL_WAIT_MS;
+    compress->seed = (unsigned int)sim_now_ns() ^ device;
+    compress->fd = 0;
+    atomic_fetch_add(&sim_counters.compr_opens, 1);
+
+    sim_open_delay();
+    ALOGV("%s: card %u device %u codec %u, %u x %u bytes at %.0f B/s", __func__,
+          card, device, codec->id, config->fragment_size, config->fragments,
+          compress->byte_rate);
+    return compress;
+}
+
+void compress_close(struct compress *compress)
+{
+    if (compress == &bad_compress)
+        return;
+
+    pthread_mutex_lock(&compress->lock);
+    compress->fd = -1;
+    pthread_cond_broadcast(&compress->cond);
+    pthread_mutex_unlock(&compress->lock);
+
+    pthread_cond_destroy(&compress->cond);
+    pthread_mutex_destroy(&compress->lock);
+    free(compress);
+}
+
+int is_compress_ready(struct compress *compress)
+{
+    return compress->fd >= 0;
+}
+
+int is_compress_running(struct compress *compress)
+{
+    return compress->fd >= 0 && compress->running;
+}
+
+const char *compress_get_error(struct compress *compress)
+{
+    return compress->error;
+}
+
+bool is_codec_supported(unsigned int card, unsigned int device __unused,
+                        unsigned int flags __unused, struct snd_codec *codec __unused)
+{
+    return card == sim_config()->card;
+}
+
+void compress_set_max_poll_wait(struct compress *compress, int milliseconds)
+{
+    compress->max_poll_wait_ms = milliseconds;
+}
+
+void compress_nonblock(struct compress *compress, int nonblock)
+{
+    compress->nonblock = !!nonblock;
+}
+
+int compress_write(struct compress *compress, const void *buf __unused, unsigned int size)
+{
+    uint64_t avail;
+    unsigned int to_write = size;
+    int written = 0;
+    int ret;
+
+    if (!is_compress_ready(compress))
+        return oops(compress, ENODEV, "device not ready");
+    if (compress_is_capture(compress))
+        return oops(compress, EINVAL, "Invalid flag set");
+
+    pthread_mutex_lock(&compress->lock);
+    while (to_write > 0) {
+        avail = compress_avail_l(compress, sim_now_ns());
+        if (avail < compress->config.fragment_size && avail < to_write) {
+            if (compress->nonblock)
+                break;
+            ret = compress_wait_l(compress, compress->max_poll_wait_ms,
+                                  compress_has_fragment);
+            if (ret < 0) {
+                written = oops(compress, -ret, "cannot write");
+                goto exit;
+            }
+            continue;
+        }
+        if (avail > to_write)
+            avail = to_write;
+        compress->written += avail;
+        written += avail;
+        to_write -= avail;
+    }
+    atomic_fetch_add(&sim_counters.compr_bytes, written);
+exit:
+    pthread_mutex_unlock(&compress->lock);
+    return written;
+}
+
+int compress_read(struct compress *compress, void *buf, unsigned int size)
+{
+    uint64_t avail;
+    unsigned int to_read = size;
+    int total = 0;
+    int ret;
+
+    if (!is_compress_ready(compress))
+        return oops(compress, ENODEV, "device not ready");
+    if (!compress_is_capture(compress))
+        return oops(compress, EINVAL, "Invalid flag set");
+
+    pthread_mutex_lock(&compress->lock);
+    while (to_read > 0) {
+        avail = compress_avail_l(compress, sim_now_ns());
+        if (avail < compress->config.fragment_size && avail < to_read) {
+            if (compress->nonblock)
+                break;
+            ret = compress_wait_l(compress, compress->max_poll_wait_ms,
+                                  compress_has_fragment);
+            if (ret < 0) {
+                total = oops(compress, -ret, "cannot read");
+                goto exit;
+            }
+            continue;
+        }
+        if (avail > to_read)
+            avail = to_read;
+        memset((uint8_t *)buf + total, 0, avail);
+        compress->written += avail;
+        total += avail;
+        to_read -= avail;
+    }
+    atomic_fetch_add(&sim_counters.compr_bytes, total);
+exit:
+    pthread_mutex_unlock(&compress->lock);
+    return total;
+}
+
+int compress_start(struct compress *compress)
+{
+    if (!is_compress_ready(compress))
+        return oops(compress, ENODEV, "device not ready");
+
+    pthread_mutex_lock(&compress->lock);
+    if (!compress->running) {
+        compress->running = true;
+        compress->paused = false;
+        compress->speed = alsa_sim_get_speed();
+        compress->base_ns = sim_now_ns();
+    }
+    pthread_mutex_unlock(&compress->lock);
+    return 0;
+}
+
+/* Drops the buffered data, the timestamp restarts from 0. */
+int compress_stop(struct compress *compress)
+{
+    if (!is_compress_ready(compress))
+        return oops(compress, ENODEV, "device not ready");
+
+    pthread_mutex_lock(&compress->lock);
+    compress->running = false;
+    compress->paused = false;
+    compress->written = 0;
+    compress->done_base = 0;
+    pthread_cond_broadcast(&compress->cond);
+    pthread_mutex_unlock(&compress->lock);
+    return 0;
+}
+
+int compress_pause(struct compress *compress)
+{
+    if (!is_compress_ready(compress))
+        return oops(compress, ENODEV, "device not ready");
+
+    pthread_mutex_lock(&compress->lock);
+    if (compress->running && !compress->paused) {
+        compress->done_base = compress_done_l(compress, sim_now_ns());
+        compress->paused = true;
+    }
+    pthread_mutex_unlock(&compress->lock);
+    return 0;
+}
+
+int compress_resume(struct compress *compress)
+{
+    if (!is_compress_ready(compress))
+        return oops(compress, ENODEV, "device not ready");
+
+    pthread_mutex_lock(&compress->lock);
+    if (compress->paused) {
+        compress->paused = false;
+        compress->base_ns = sim_now_ns();
+        pthread_cond_broadcast(&compress->cond);
+    }
+    pthread_mutex_unlock(&compress->lock);
+    return 0;
+}
+
+int compress_drain(struct compress *compress)
+{
+    int ret;
+
+    if (!is_compress_ready(compress))
+        return oops(compress, ENODEV, "device not ready");
+
+    pthread_mutex_lock(&compress->lock);
+    ret = compress_wait_l(compress, -1, compress_drained);
+    pthread_mutex_unlock(&compress->lock);
+    return ret < 0 ? oops(compress, -ret, "cannot drain the stream") : 0;
+}
+
+int compress_partial_drain(struct compress *compress)
+{
+    return compress_drain(compress);
+}
+
+int compress_next_track(struct compress *compress)
+{
+    if (!is_compress_ready(compress))
+        return oops(compress, ENODEV, "device not ready");
+    return 0;
+}
+
+int compress_wait(struct compress *compress, int timeout_ms)
+{
+    int ret;
+
+    if (!is_compress_ready(compress))
+        return oops(compress, ENODEV, "device not ready");
+
+    pthread_mutex_lock(&compress->lock);
+    ret = compress_wait_l(compress, timeout_ms, compress_has_fragment);
+    pthread_mutex_unlock(&compress->lock);
+    return ret < 0 ? oops(compress, -ret, "poll timed out") : 0;
+}
+
+int compress_get_hpointer(struct compress *compress, unsigned int *avail,
+                          struct timespec *tstamp)
+{
+    uint64_t rendered;
+    uint64_t bytes;
+    int64_t now;
+
+    if (!is_compress_ready(compress))
+        return oops(compress, ENODEV, "device not ready");
+
+    pthread_mutex_lock(&compress->lock);
+    now = sim_now_ns();
+    bytes = compress_avail_l(compress, now);
+    rendered = compress_done_l(compress, now);
+    pthread_mutex_unlock(&compress->lock);
+
+    *avail = bytes > UINT_MAX ? UINT_MAX : (unsigned int)bytes;
+    sim_ns_to_timespec((int64_t)((double)rendered * NSEC_PER_SEC / compress->byte_rate),
+                       tstamp);
+    return 0;
+}
+
+int compress_get_tstamp(struct compress *compress, unsigned long *samples,
+                        unsigned int *sampling_rate)
+{
+    uint64_t rendered;
+
+    if (!is_compress_ready(compress))
+        return oops(compress, ENODEV, "device not ready");
+
+    pthread_mutex_lock(&compress->lock);
+    rendered = compress_done_l(compress, sim_now_ns());
+    pthread_mutex_unlock(&compress->lock);
+
+    *samples = (unsigned long)((double)rendered * compress->sample_rate / compress->byte_rate);
+    *sampling_rate = compress->sample_rate;
+    return 0;
+}
+
+int compress_set_gapless_metadata(struct compress *compress,
+                                  struct compr_gapless_mdata *mdata __unused)
+{
+    if (!is_compress_ready(compress))
+        return oops(compress, ENODEV, "device not ready");
+    return 0;
+}
+
+int compress_set_next_track_param(struct compress *compress,
+                                  union snd_codec_options *codec_options __unused)
+{
+    if (!is_compress_ready(compress))
+        return oops(compress, ENODEV, "device not ready");
+    return 0;
+}
+
+int compress_set_metadata(struct compress *compress,
+                          struct snd_compr_metadata *mdata __unused)
+{
+    if (!is_compress_ready(compress))
+        return oops(compress, ENODEV, "device not ready");
+    return 0;
+}
+
+int compress_get_metadata(struct compress *compress, struct snd_compr_metadata *mdata)
+{
+    if (!is_compress_ready(compress))
+        return oops(compress, ENODEV, "device not ready");
+
+    memset(mdata->value, 0, sizeof(mdata->value));
+    return 0;
+}
@@ -0,0 +1,858 @@
+/*
+ * Copyright (c) 2020, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define LOG_TAG "alsa_sim_mixer"
+/*#define LOG_NDEBUG 0*/
+
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <expat.h>
+#include <cutils/list.h>
+#include <utils/Log.h>
+#include <tinyalsa/asoundlib.h>
+
+#include "alsa_sim_internal.h"
+
+#define BUF_SIZE 1024
+#define MIXER_HASH_SIZE 4096
+/* values of a control created on lookup, grown by larger writes */
+#define MIXER_LEARNED_VALUES 64
+#define MIXER_EVENT_QUEUE 256
+
+/*
+ * The control namespace is shared by every mixer opened on the card, as the
+ * kernel's is. Controls are defined by the <ctl> elements of the mixer_paths
+ * xml: a control gets the ENUM type if any of its values is not a number, the
+ * BYTE type if a value is a list of numbers and the INT type otherwise, with
+ * enough values for the largest id used. The INT range spans the values seen.
+ *
+ * Controls the xml does not mention, such as the per stream app type and
+ * volume controls, are created on first lookup as BYTE controls that accept
+ * any array size; writing a string turns them into an ENUM that accepts any
+ * string. ALSA_SIM_MIXER_STRICT disables this and the lookup fails instead.
+ */
+struct mixer_ctl {
+    unsigned int id;
+    char *name;
+    enum mixer_ctl_type type;
+    unsigned int num_values;
+    long *values;               /* BOOL, INT and ENUM */
+    uint8_t *bytes;             /* BYTE */
+    char **enum_names;
+    unsigned int num_enums;
+    long min;
+    long max;
+    bool learned;
+
+    /* xml parse state */
+    bool non_numeric;
+    unsigned int max_tokens;
+
+    struct mixer_ctl *hash_next;
+};
+
+struct sim_card {
+    pthread_mutex_t lock;
+    struct mixer_ctl **ctls;
+    unsigned int num_ctls;
+    unsigned int ctls_size;
+    struct mixer_ctl *hash[MIXER_HASH_SIZE];
+    struct listnode subscribers;
+};
+
+struct mixer {
+    struct sim_card *card;
+    int event_fd;
+    unsigned int events[MIXER_EVENT_QUEUE];
+    unsigned int event_head;
+    unsigned int event_count;
+    unsigned int events_dropped;
+    struct listnode node;
+};
+
+static struct sim_card sim_card;
+static pthread_once_t sim_card_once = PTHREAD_ONCE_INIT;
+
+static unsigned int ctl_hash(const char *name)
+{
+    uint32_t hash = 2166136261u;
+
+    while (*name) {
+        hash ^= (uint8_t)*name++;
+        hash *= 16777619u;
+    }
+    return hash % MIXER_HASH_SIZE;
+}
+
+static struct mixer_ctl *card_find_ctl_l(struct sim_card *card, const char *name)
+{
+    struct mixer_ctl *ctl;
+
+    for (ctl = card->hash[ctl_hash(name)]; ctl != NULL; ctl = ctl->hash_next) {
+        if (!strcmp(ctl->name, name))
+            return ctl;
+    }
+    return NULL;
+}
+
+static struct mixer_ctl *card_add_ctl_l(struct sim_card *card, const char *name)
+{
+    struct mixer_ctl **ctls;
+    struct mixer_ctl *ctl;
+    unsigned int hash;
+
+    if (card->num_ctls == card->ctls_size) {
+        ctls = realloc(card->ctls, (card->ctls_size + 256) * sizeof(*ctls));
+        if (!ctls)
+            return NULL;
+        card->ctls = ctls;
+        card->ctls_size += 256;
+    }
+
+    ctl = calloc(1, sizeof(struct mixer_ctl));
+    if (!ctl)
+        return NULL;
+    ctl->name = strdup(name);
+    if (!ctl->name) {
+        free(ctl);
+        return NULL;
+    }
+    ctl->id = card->num_ctls;
+    ctl->type = MIXER_CTL_TYPE_INT;
+    ctl->min = LONG_MAX;
+    ctl->max = LONG_MIN;
+
+    hash = ctl_hash(name);
+    ctl->hash_next = card->hash[hash];
+    card->hash[hash] = ctl;
+    card->ctls[card->num_ctls++] = ctl;
+    return ctl;
+}
+
+static int ctl_add_enum_l(struct mixer_ctl *ctl, const char *string)
+{
+    char **names;
+    unsigned int i;
+
+    for (i = 0; i < ctl->num_enums; i++) {
+        if (!strcmp(ctl->enum_names[i], string))
+            return i;
+    }
+
+    names = realloc(ctl->enum_names, (ctl->num_enums + 1) * sizeof(*names));
+    if (!names)
+        return -ENOMEM;
+    ctl->enum_names = names;
+    names[ctl->num_enums] = strdup(string);
+    if (!names[ctl->num_enums])
+        return -ENOMEM;
+    return ctl->num_enums++;
+}
+
+/* Makes room for num_values, for controls created on lookup. */
+static int ctl_resize_l(struct mixer_ctl *ctl, unsigned int num_values)
+{
+    void *values;
+
+    if (num_values <= ctl->num_values)
+        return 0;
+
+    if (ctl->type == MIXER_CTL_TYPE_BYTE) {
+        values = realloc(ctl->bytes, num_values);
+        if (!values)
+            return -ENOMEM;
+        memset((uint8_t *)values + ctl->num_values, 0, num_values - ctl->num_values);
+        ctl->bytes = values;
+    } else {
+        values = realloc(ctl->values, num_values * sizeof(long));
+        if (!values)
+            return -ENOMEM;
+        memset((long *)values + ctl->num_values, 0,
+               (num_values - ctl->num_values) * sizeof(long));
+        ctl->values = values;
+    }
+    ctl->num_values = num_values;
+    return 0;
+}
+
+static void mixer_queue_event_l(struct mixer *mixer, unsigned int id)
+{
+    uint64_t one = 1;
+
+    if (mixer->event_count == MIXER_EVENT_QUEUE) {
+        mixer->events_dropped++;
+        return;
+    }
+    mixer->events[(mixer->event_head + mixer->event_count) % MIXER_EVENT_QUEUE] = id;
+    mixer->event_count++;
+    if (write(mixer->event_fd, &one, sizeof(one)) < 0)
+        ALOGW("%s: event fd write failed, %s", __func__, strerror(errno));
+    atomic_fetch_add(&sim_counters.ctl_events, 1);
+}
+
+static void card_notify_l(struct sim_card *card, struct mixer_ctl *ctl)
+{
+    struct listnode *node;
+
+    list_for_each(node, &card->subscribers) {
+        mixer_queue_event_l(node_to_item(node, struct mixer, node), ctl->id);
+    }
+}
+
+static void ctl_changed_l(struct mixer_ctl *ctl)
+{
+    atomic_fetch_add(&sim_counters.ctl_writes, 1);
+    card_notify_l(&sim_card, ctl);
+}
+
+static bool parse_long(const char *token, long *value)
+{
+    char *end;
+
+    errno = 0;
+    *value = strtol(token, &end, 0);
+    return errno == 0 && end != token && *end == '\0';
+}
+
+static void xml_ctl_value(struct mixer_ctl *ctl, const char *value, int id)
+{
+    char *copy, *token, *save = NULL;
+    unsigned int tokens = 0;
+    long number;
+
+    copy = strdup(value);
+    if (!copy)
+        return;
+    for (token = strtok_r(copy, " \t", &save); token != NULL;
+         token = strtok_r(NULL, " \t", &save)) {
+        tokens++;
+        if (parse_long(token, &number)) {
+            if (number < ctl->min)
+                ctl->min = number;
+            if (number > ctl->max)
+                ctl->max = number;
+        } else {
+            ctl->non_numeric = true;
+        }
+    }
+    free(copy);
+
+    if (tokens == 1)
+        ctl_add_enum_l(ctl, value);
+    if (tokens > ctl->max_tokens)
+        ctl->max_tokens = tokens;
+    if (id >= 0 && (unsigned int)id + 1 > ctl->num_values)
+        ctl->num_values = id + 1;
+}
+
+static void xml_start_tag(void *data, const XML_Char *tag_name,
+                          const XML_Char **attr)
+{
+    struct sim_card *card = (struct sim_card *)data;
+    const char *name = NULL, *value = NULL;
+    struct mixer_ctl *ctl;
+    int id = -1;
+    unsigned int i;
+
+    if (strcmp(tag_name, "ctl"))
+        return;
+
+    for (i = 0; attr[i]; i += 2) {
+        if (!strcmp(attr[i], "name"))
+            name = attr[i + 1];
+        else if (!strcmp(attr[i], "value"))
+            value = attr[i + 1];
+        else if (!strcmp(attr[i], "id"))
+            id = atoi(attr[i + 1]);
+    }
+    if (!name || !value)
+        return;
+
+    ctl = card_find_ctl_l(card, name);
+    if (!ctl)
+        ctl = card_add_ctl_l(card, name);
+    if (ctl)
+        xml_ctl_value(ctl, value, id);
+}
+
+/* Gives the controls read from the xml their type and storage. */
+static void card_finish_ctls_l(struct sim_card *card)
+{
+    struct mixer_ctl *ctl;
+    unsigned int i, num_values;
+
+    for (i = 0; i < card->num_ctls; i++) {
+        ctl = card->ctls[i];
+        num_values = ctl->num_values ? ctl->num_values : 1;
+        ctl->num_values = 0;
+        if (ctl->non_numeric) {
+            ctl->type = MIXER_CTL_TYPE_ENUM;
+            ctl->min = 0;
+            ctl->max = ctl->num_enums - 1;
+        } else if (ctl->max_tokens > 1) {
+            ctl->type = MIXER_CTL_TYPE_BYTE;
+            num_values = ctl->max_tokens;
+            ctl->min = 0;
+            ctl->max = UINT8_MAX;
+        } else {
+            ctl->type = MIXER_CTL_TYPE_INT;
+            if (ctl->min > 0)
+                ctl->min = 0;
+            if (ctl->max < 1)
+                ctl->max = 1;
+            /* numbers are only kept as enum strings for ENUM controls */
+            while (ctl->num_enums > 0)
+                free(ctl->enum_names[--ctl->num_enums]);
+        }
+        ctl_resize_l(ctl, num_values);
+    }
+}
+
+static int card_load_xml_l(struct sim_card *card, const char *path)
+{
+    XML_Parser parser;
+    FILE *file;
+    void *buf;
+    int bytes_read;
+    int ret = 0;
+
+    file = fopen(path, "r");
+    if (!file) {
+        ALOGE("%s: failed to open %s, %s", __func__, path, strerror(errno));
+        return -errno;
+    }
+
+    parser = XML_ParserCreate(NULL);
+    if (!parser) {
+        ALOGE("%s: Failed to create XML parser!", __func__);
+        ret = -ENOMEM;
+        goto err_close_file;
+    }
+    XML_SetUserData(parser, card);
+    XML_SetElementHandler(parser, xml_start_tag, NULL);
+
+    while (1) {
+        buf = XML_GetBuffer(parser, BUF_SIZE);
+        if (buf == NULL) {
+            ret = -ENOMEM;
+            break;
+        }
+        bytes_read = fread(buf, 1, BUF_SIZE, file);
+        if (XML_ParseBuffer(parser, bytes_read, bytes_read == 0) == XML_STATUS_ERROR) {
+            ALOGE("%s: XML_ParseBuffer failed for %s", __func__, path);
+            ret = -EINVAL;
+            break;
+        }
+        if (bytes_read == 0)
+            break;
+    }
+
+    XML_ParserFree(parser);
+err_close_file:
+    fclose(file);
+    return ret;
+}
+
+static void sim_card_init(void)
+{
+    const struct alsa_sim_config *cfg = sim_config();
+
+    pthread_mutex_init(&sim_card.lock, NULL);
+    list_init(&sim_card.subscribers);
+    if (cfg->mixer_paths[0] == '\0')
+        return;
+
+    if (card_load_xml_l(&sim_card, cfg->mixer_paths) == 0)
+        ALOGI("%s: %u controls from %s", __func__, sim_card.num_ctls, cfg->mixer_paths);
+    card_finish_ctls_l(&sim_card);
+}
+
+struct mixer *mixer_open(unsigned int card)
+{
+    struct mixer *mixer;
+
+    if (card != sim_config()->card)
+        return NULL;
+    pthread_once(&sim_card_once, sim_card_init);
+
+    mixer = calloc(1, sizeof(struct mixer));
+    if (!mixer)
+        return NULL;
+    mixer->card = &sim_card;
+    mixer->event_fd = -1;
+    list_init(&mixer->node);
+    return mixer;
+}
+
+void mixer_close(struct mixer *mixer)
+{
+    if (!mixer)
+        return;
+
+    mixer_subscribe_events(mixer, 0);
+    free(mixer);
+}
+
+const char *mixer_get_name(struct mixer *mixer __unused)
+{
+    return sim_config()->card_name;
+}
+
+unsigned int mixer_get_num_ctls(struct mixer *mixer)
+{
+    unsigned int num_ctls;
+
+    if (!mixer)
+        return 0;
+
+    pthread_mutex_lock(&mixer->card->lock);
+    num_ctls = mixer->card->num_ctls;
+    pthread_mutex_unlock(&mixer->card->lock);
+    return num_ctls;
+}
+
+struct mixer_ctl *mixer_get_ctl(struct mixer *mixer, unsigned int id)
+{
+    struct mixer_ctl *ctl = NULL;
+
+    if (!mixer)
+        return NULL;
+
+    pthread_mutex_lock(&mixer->card->lock);
+    if (id < mixer->card->num_ctls)
+        ctl = mixer->card->ctls[id];
+    pthread_mutex_unlock(&mixer->card->lock);
+    return ctl;
+}
+
+struct mixer_ctl *mixer_get_ctl_by_name(struct mixer *mixer, const char *name)
+{
+    struct sim_card *card;
+    struct mixer_ctl *ctl;
+
+    if (!mixer || !name)
+        return NULL;
+
+    card = mixer->card;
+    pthread_mutex_lock(&card->lock);
+    ctl = card_find_ctl_l(card, name);
+    if (!ctl && !sim_config()->mixer_strict) {
+        ctl = card_add_ctl_l(card, name);
+        if (ctl) {
+            ctl->type = MIXER_CTL_TYPE_BYTE;
+            ctl->min = 0;
+            ctl->max = UINT8_MAX;
+            ctl->learned = true;
+            ctl_resize_l(ctl, MIXER_LEARNED_VALUES);
+            ALOGV("%s: learned control %s", __func__, name);
+        }
+    }
+    pthread_mutex_unlock(&card->lock);
+    return ctl;
+}
+
+void mixer_ctl_update(struct mixer_ctl *ctl __unused)
+{
+}
+
+int mixer_ctl_is_access_tlv_rw(struct mixer_ctl *ctl __unused)
+{
+    return 0;
+}
+
+const char *mixer_ctl_get_name(struct mixer_ctl *ctl)
+{
+    return ctl ? ctl->name : NULL;
+}
+
+enum mixer_ctl_type mixer_ctl_get_type(struct mixer_ctl *ctl)
+{
+    return ctl ? ctl->type : MIXER_CTL_TYPE_UNKNOWN;
+}
+
+const char *mixer_ctl_get_type_string(struct mixer_ctl *ctl)
+{
+    switch (mixer_ctl_get_type(ctl)) {
+    case MIXER_CTL_TYPE_BOOL: return "BOOL";
+    case MIXER_CTL_TYPE_INT: return "INT";
+    case MIXER_CTL_TYPE_ENUM: return "ENUM";
+    case MIXER_CTL_TYPE_BYTE: return "BYTE";
+    case MIXER_CTL_TYPE_IEC958: return "IEC958";
+    case MIXER_CTL_TYPE_INT64: return "INT64";
+    default: return "Unknown";
+    }
+}
+
+unsigned int mixer_ctl_get_num_values(struct mixer_ctl *ctl)
+{
+    unsigned int num_values;
+
+    if (!ctl)
+        return 0;
+
+    pthread_mutex_lock(&sim_card.lock);
+    num_values = ctl->num_values;
+    pthread_mutex_unlock(&sim_card.lock);
+    return num_values;
+}
+
+unsigned int mixer_ctl_get_num_enums(struct mixer_ctl *ctl)
+{
+    unsigned int num_enums;
+
+    if (!ctl)
+        return 0;
+
+    pthread_mutex_lock(&sim_card.lock);
+    num_enums = ctl->num_enums;
+    pthread_mutex_unlock(&sim_card.lock);
+    return num_enums;
+}
+
+const char *mixer_ctl_get_enum_string(struct mixer_ctl *ctl, unsigned int enum_id)
+{
+    const char *string = NULL;
+
+    if (!ctl)
+        return NULL;
+
+    pthread_mutex_lock(&sim_card.lock);
+    if (ctl->type == MIXER_CTL_TYPE_ENUM && enum_id < ctl->num_enums)
+        string = ctl->enum_names[enum_id];
+    pthread_mutex_unlock(&sim_card.lock);
+    return string;
+}
+
+int mixer_ctl_get_range_min(struct mixer_ctl *ctl)
+{
+    if (!ctl || ctl->type != MIXER_CTL_TYPE_INT)
+        return -EINVAL;
+    return (int)ctl->min;
+}
+
+int mixer_ctl_get_range_max(struct mixer_ctl *ctl)
+{
+    if (!ctl || ctl->type != MIXER_CTL_TYPE_INT)
+        return -EINVAL;
+    return (int)ctl->max;
+}
+
+int mixer_ctl_get_value(struct mixer_ctl *ctl, unsigned int id)
+{
+    int value = -EINVAL;
+
+    if (!ctl)
+        return -EINVAL;
+
+    pthread_mutex_lock(&sim_card.lock);
+    if (id < ctl->num_values) {
+        if (ctl->type == MIXER_CTL_TYPE_BYTE)
+            value = ctl->bytes[id];
+        else
+            value = (int)ctl->values[id];
+    }
+    pthread_mutex_unlock(&sim_card.lock);
+    return value;
+}
+
+int mixer_ctl_set_value(struct mixer_ctl *ctl, unsigned int id, int value)
+{
+    bool changed = false;
+    int ret = 0;
+
+    if (!ctl)
+        return -EINVAL;
+
+    pthread_mutex_lock(&sim_card.lock);
+    if (ctl->learned && id >= ctl->num_values && ctl_resize_l(ctl, id + 1) < 0) {
+        ret = -ENOMEM;
+        goto exit;
+    }
+    if (id >= ctl->num_values ||
+            (ctl->type == MIXER_CTL_TYPE_ENUM && (value < 0 ||
+                                                  (unsigned int)value >= ctl->num_enums))) {
+        ret = -EINVAL;
+        goto exit;
+    }
+
+    if (ctl->type == MIXER_CTL_TYPE_BYTE) {
+        changed = ctl->bytes[id] != (uint8_t)value;
+        ctl->bytes[id] = (uint8_t)value;
+    } else {
+        changed = ctl->values[id] != value;
+        ctl->values[id] = value;
+    }
+    if (changed)
+        ctl_changed_l(ctl);
+exit:
+    pthread_mutex_unlock(&sim_card.lock);
+    return ret;
+}
+
+/*
+ * Array elements are sized as in tinyalsa: long for BOOL and INT, unsigned
+ * int for ENUM and bytes for BYTE.
+ */
+int mixer_ctl_get_array(struct mixer_ctl *ctl, void *array, size_t count)
+{
+    unsigned int i;
+    int ret = 0;
+
+    if (!ctl || !array || !count)
+        return -EINVAL;
+
+    pthread_mutex_lock(&sim_card.lock);
+    if (count > ctl->num_values) {
+        ret = -EINVAL;
+        goto exit;
+    }
+    switch (ctl->type) {
+    case MIXER_CTL_TYPE_BYTE:
+        memcpy(array, ctl->bytes, count);
+        break;
+    case MIXER_CTL_TYPE_ENUM:
+        for (i = 0; i < count; i++)
+            ((unsigned int *)array)[i] = (unsigned int)ctl->values[i];
+        break;
+    default:
+        memcpy(array, ctl->values, count * sizeof(long));
+        break;
+    }
+exit:
+    pthread_mutex_unlock(&sim_card.lock);
+    return ret;
+}
+
+int mixer_ctl_set_array(struct mixer_ctl *ctl, const void *array, size_t count)
+{
+    bool changed = false;
+    unsigned int i;
+    long value;
+    int ret = 0;
+
+    if (!ctl || !array || !count)
+        return -EINVAL;
+
+    pthread_mutex_lock(&sim_card.lock);
+    if (ctl->learned && count > ctl->num_values && ctl_resize_l(ctl, count) < 0) {
+        ret = -ENOMEM;
+        goto exit;
+    }
+    if (count > ctl->num_values) {
+        ret = -EINVAL;
+        goto exit;
+    }
+
+    if (ctl->type == MIXER_CTL_TYPE_BYTE) {
+        changed = memcmp(ctl->bytes, array, count) != 0;
+        memcpy(ctl->bytes, array, count);
+    } else {
+        for (i = 0; i < count; i++) {
+            if (ctl->type == MIXER_CTL_TYPE_ENUM)
+                value = ((const unsigned int *)array)[i];
+            else
+                value = ((const long *)array)[i];
+            changed |= ctl->values[i] != value;
+            ctl->values[i] = value;
+        }
+    }
+    if (changed)
+        ctl_changed_l(ctl);
+exit:
+    pthread_mutex_unlock(&sim_card.lock);
+    return ret;
+}
+
+int mixer_ctl_set_enum_by_string(struct mixer_ctl *ctl, const char *string)
+{
+    unsigned int i;
+    int ret = -EINVAL;
+
+    if (!ctl || !string)
+        return -EINVAL;
+
+    pthread_mutex_lock(&sim_card.lock);
+    if (ctl->learned && ctl->type == MIXER_CTL_TYPE_BYTE) {
+        free(ctl->bytes);
+        ctl->bytes = NULL;
+        ctl->num_values = 0;
+        ctl->type = MIXER_CTL_TYPE_ENUM;
+        if (ctl_resize_l(ctl, 1) < 0) {
+            ret = -ENOMEM;
+            goto exit;
+        }
+    }
+    if (ctl->type != MIXER_CTL_TYPE_ENUM)
+        goto exit;
+
+    for (i = 0; i < ctl->num_enums; i++) {
+        if (!strcmp(string, ctl->enum_names[i]))
+            break;
+    }
+    if (i == ctl->num_enums) {
+        if (!ctl->learned)
+            goto exit;
+        ret = ctl_add_enum_l(ctl, string);
+        if (ret < 0)
+            goto exit;
+    }
+    ret = 0;
+    if (ctl->values[0] != (long)i) {
+        ctl->values[0] = i;
+        ctl_changed_l(ctl);
+    }
+exit:
+    pthread_mutex_unlock(&sim_card.lock);
+    return ret;
+}
+
+int mixer_ctl_get_percent(struct mixer_ctl *ctl, unsigned int id)
+{
+    int value;
+
+    if (!ctl || ctl->type != MIXER_CTL_TYPE_INT || ctl->max == ctl->min)
+        return -EINVAL;
+
+    value = mixer_ctl_get_value(ctl, id);
+    return (int)(((long long)value - ctl->min) * 100 / (ctl->max - ctl->min));
+}
+
+int mixer_ctl_set_percent(struct mixer_ctl *ctl, unsigned int id, int percent)
+{
+    if (!ctl || ctl->type != MIXER_CTL_TYPE_INT)
+        return -EINVAL;
+
+    return mixer_ctl_set_value(ctl, id,
+                               (int)(ctl->min + (long long)(ctl->max - ctl->min) * percent / 100));
+}
+
+int mixer_subscribe_events(struct mixer *mixer, int subscribe)
+{
+    struct sim_card *card;
+    int ret = 0;
+
+    if (!mixer)
+        return -EINVAL;
+
+    card = mixer->card;
+    pthread_mutex_lock(&card->lock);
+    if (subscribe && mixer->event_fd < 0) {
+        mixer->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (mixer->event_fd < 0) {
+            ret = -errno;
+            goto exit;
+        }
+        mixer->event_head = 0;
+        mixer->event_count = 0;
+        list_add_tail(&card->subscribers, &mixer->node);
+    } else if (!subscribe && mixer->event_fd >= 0) {
+        list_remove(&mixer->node);
+        list_init(&mixer->node);
+        close(mixer->event_fd);
+        mixer->event_fd = -1;
+    }
+exit:
+    pthread_mutex_unlock(&card->lock);
+    return ret;
+}
+
+int mixer_wait_event(struct mixer *mixer, int timeout)
+{
+    struct pollfd pfd;
+    int ret;
+
+    if (!mixer || mixer->event_fd < 0)
+        return -EINVAL;
+
+    pfd.fd = mixer->event_fd;
+    pfd.events = POLLIN;
+    ret = poll(&pfd, 1, timeout);
+    if (ret < 0)
+        return -errno;
+    return ret > 0 && (pfd.revents & POLLIN) ? 1 : 0;
+}
+
+int mixer_read(struct mixer *mixer, struct snd_ctl_event *ev)
+{
+    struct sim_card *card;
+    struct mixer_ctl *ctl;
+    uint64_t count;
+    unsigned int id;
+    int ret = sizeof(*ev);
+
+    if (!mixer || !ev)
+        return -EINVAL;
+
+    card = mixer->card;
+    pthread_mutex_lock(&card->lock);
+    if (mixer->event_count == 0) {
+        ret = -EAGAIN;
+        goto exit;
+    }
+    id = mixer->events[mixer->event_head];
+    mixer->event_head = (mixer->event_head + 1) % MIXER_EVENT_QUEUE;
+    if (--mixer->event_count == 0 &&
+            read(mixer->event_fd, &count, sizeof(count)) < 0 && errno != EAGAIN)
+        ALOGW("%s: event fd read failed, %s", __func__, strerror(errno));
+
+    ctl = card->ctls[id];
+    memset(ev, 0, sizeof(*ev));
+    ev->type = SNDRV_CTL_EVENT_ELEM;
+    ev->data.elem.mask = SNDRV_CTL_EVENT_MASK_VALUE;
+    ev->data.elem.id.numid = id + 1;
+    ev->data.elem.id.iface = SNDRV_CTL_ELEM_IFACE_MIXER;
+    strlcpy((char *)ev->data.elem.id.name, ctl->name, sizeof(ev->data.elem.id.name));
+exit:
+    pthread_mutex_unlock(&card->lock);
+    return ret;
+}
+
+int alsa_sim_mixer_notify(const char *ctl_name)
+{
+    struct mixer_ctl *ctl;
+    int ret = 0;
+
+    if (!ctl_name)
+        return -EINVAL;
+    pthread_once(&sim_card_once, sim_card_init);
+
+    pthread_mutex_lock(&sim_card.lock);
+    ctl = card_find_ctl_l(&sim_card, ctl_name);
+    if (ctl)
+        card_notify_l(&sim_card, ctl);
+    else
+        ret = -ENOENT;
+    pthread_mutex_unlock(&sim_card.lock);
+    return ret;
+}
@@ -0,0 +1,855 @@
+/*
+ * Copyright (c) 2020, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define LOG_TAG "alsa_sim_pcm"
+/*#define LOG_NDEBUG 0*/
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <cutils/list.h>
+#include <utils/Log.h>
+#include <tinyalsa/asoundlib.h>
+
+#include "alsa_sim_internal.h"
+
+#define PCM_ERROR_MAX 128
+
+#define PCM_DEFAULT_CHANNELS 2
+#define PCM_DEFAULT_RATE 48000
+#define PCM_DEFAULT_PERIOD_SIZE 1024
+#define PCM_DEFAULT_PERIOD_COUNT 2
+
+/*
+ * A simulated PCM stream.
+ *
+ * appl_ptr and the hw pointer are frame counters that never wrap. While the
+ * stream runs, the hw pointer moves from hw_base at base_ns at the stream
+ * rate scaled by speed. Unless the stream is NOIRQ or MMAP it is only
+ * reported at period boundaries, as if updated from the period interrupt.
+ */
+struct pcm {
+    int fd;                     /* first member, the HAL's pcm_ioctl() reads it */
+    unsigned int flags;
+    unsigned int card;
+    unsigned int device;
+    struct pcm_config config;
+    unsigned int frame_bytes;
+    unsigned int buffer_size;
+    void *mmap_buffer;
+    size_t mmap_size;
+
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int state;
+    bool running;
+    double speed;
+    uint64_t appl_ptr;
+    uint64_t hw_base;
+    int64_t base_ns;
+    uint64_t xrun_mark;         /* appl_ptr at the last start or xrun */
+    unsigned int xrun_gen;
+    unsigned int underruns;
+    unsigned int seed;
+
+    struct listnode node;
+    char error[PCM_ERROR_MAX];
+};
+
+static struct pcm bad_pcm = {
+    .fd = -1,
+};
+
+static pthread_mutex_t pcm_list_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct listnode pcm_list = { &pcm_list, &pcm_list };
+
+static int oops(struct pcm *pcm, int e, const char *fmt, ...)
+{
+    va_list ap;
+    int sz;
+
+    va_start(ap, fmt);
+    vsnprintf(pcm->error, PCM_ERROR_MAX, fmt, ap);
+    va_end(ap);
+    sz = strlen(pcm->error);
+
+    if (e)
+        snprintf(pcm->error + sz, PCM_ERROR_MAX - sz, ": %s", strerror(e));
+    return -1;
+}
+
+static inline bool pcm_is_capture(const struct pcm *pcm)
+{
+    return (pcm->flags & PCM_IN) != 0;
+}
+
+static inline bool pcm_period_aligned(const struct pcm *pcm)
+{
+    return (pcm->flags & (PCM_MMAP | PCM_NOIRQ)) == 0;
+}
+
+/* Position the card would have reached now, not rounded to periods. */
+static uint64_t pcm_hw_pos_l(const struct pcm *pcm, int64_t now)
+{
+    if (!pcm->running)
+        return pcm->hw_base;
+    if (pcm->speed <= 0)
+        return pcm_is_capture(pcm) ? pcm->appl_ptr + pcm->buffer_size : pcm->appl_ptr;
+    return pcm->hw_base + sim_elapsed_units(pcm->base_ns, now, pcm->speed,
+                                            pcm->config.rate);
+}
+
+static uint64_t pcm_hw_ptr_l(const struct pcm *pcm, int64_t now)
+{
+    uint64_t pos = pcm_hw_pos_l(pcm, now);
+
+    if (!pcm->running || pcm->speed <= 0 || !pcm_period_aligned(pcm))
+        return pos;
+    return pcm->hw_base + (pos - pcm->hw_base) / pcm->config.period_size *
+                          pcm->config.period_size;
+}
+
+static int64_t pcm_avail_l(const struct pcm *pcm, uint64_t hw_ptr)
+{
+    if (pcm_is_capture(pcm))
+        return (int64_t)hw_ptr - (int64_t)pcm->appl_ptr;
+    return (int64_t)pcm->buffer_size + (int64_t)hw_ptr - (int64_t)pcm->appl_ptr;
+}
+
+static void pcm_start_l(struct pcm *pcm, int64_t now)
+{
+    pcm->running = true;
+    pcm->state = SNDRV_PCM_STATE_RUNNING;
+    pcm->speed = alsa_sim_get_speed();
+    pcm->base_ns = now;
+    pcm->xrun_mark = pcm->appl_ptr;
+}
+
+/*
+ * Detects an underrun/overrun at now, either because the application fell
+ * behind the card or because one was injected, and stops the stream with the
+ * data in flight dropped.
+ */
+static bool pcm_check_xrun_l(struct pcm *pcm, int64_t now)
+{
+    const struct alsa_sim_config *cfg = sim_config();
+    unsigned int gen = atomic_load(&sim_xrun_generation);
+    unsigned int xrun_periods = atomic_load(&cfg->xrun_periods);
+    uint64_t pos;
+    bool xrun;
+
+    if (!pcm->running)
+        return false;
+
+    pos = pcm_hw_pos_l(pcm, now);
+    xrun = gen != pcm->xrun_gen;
+    if (xrun_periods > 0 && pcm->appl_ptr - pcm->xrun_mark >=
+            (uint64_t)xrun_periods * pcm->config.period_size)
+        xrun = true;
+    if (pcm->speed > 0 && pcm_avail_l(pcm, pos) >= (int64_t)pcm->config.stop_threshold)
+        xrun = true;
+    if (!xrun)
+        return false;
+
+    if (!pcm_is_capture(pcm) && pos > pcm->appl_ptr)
+        pos = pcm->appl_ptr;
+    pcm->hw_base = pos;
+    pcm->appl_ptr = pos;
+    pcm->xrun_mark = pos;
+    pcm->xrun_gen = gen;
+    pcm->running = false;
+    pcm->state = SNDRV_PCM_STATE_XRUN;
+    pcm->underruns++;
+    atomic_fetch_add(&sim_counters.xruns, 1);
+    ALOGV("%s: %s card %u device %u xrun at %llu", __func__,
+          pcm_is_capture(pcm) ? "capture" : "playback", pcm->card, pcm->device,
+          (unsigned long long)pos);
+    return true;
+}
+
+static void pcm_stop_l(struct pcm *pcm, int64_t now)
+{
+    uint64_t pos = pcm_hw_ptr_l(pcm, now);
+
+    if (!pcm_is_capture(pcm) && pos > pcm->appl_ptr)
+        pos = pcm->appl_ptr;
+    pcm->hw_base = pos;
+    pcm->appl_ptr = pos;
+    pcm->running = false;
+    pcm->state = SNDRV_PCM_STATE_SETUP;
+    pthread_cond_broadcast(&pcm->cond);
+}
+
+/* Wall clock time until the hw pointer allows a transfer of need frames. */
+static int64_t pcm_wait_ns_l(const struct pcm *pcm, int64_t now, unsigned int need)
+{
+    uint64_t pos = pcm_hw_pos_l(pcm, now);
+    uint64_t target = pcm->appl_ptr + need;
+    uint64_t period = pcm->config.period_size;
+
+    if (!pcm_is_capture(pcm))
+        target = target > pcm->buffer_size ? target - pcm->buffer_size : 0;
+    if (pcm_period_aligned(pcm) && target > pcm->hw_base)
+        target = pcm->hw_base + (target - pcm->hw_base + period - 1) / period * period;
+    if (target <= pos)
+        return 0;
+    return sim_units_to_ns(target - pos, pcm->speed, pcm->config.rate);
+}
+
+static void pcm_copy_l(struct pcm *pcm, void *data, unsigned int frames)
+{
+    unsigned int offset = pcm->appl_ptr % pcm->buffer_size;
+    unsigned int first = pcm->buffer_size - offset;
+    uint8_t *ring = (uint8_t *)pcm->mmap_buffer;
+    uint8_t *buf = (uint8_t *)data;
+
+    if (first > frames)
+        first = frames;
+    if (pcm_is_capture(pcm)) {
+        memcpy(buf, ring + offset * pcm->frame_bytes, first * pcm->frame_bytes);
+        memcpy(buf + first * pcm->frame_bytes, ring, (frames - first) * pcm->frame_bytes);
+    } else {
+        memcpy(ring + offset * pcm->frame_bytes, buf, first * pcm->frame_bytes);
+        memcpy(ring, buf + first * pcm->frame_bytes, (frames - first) * pcm->frame_bytes);
+    }
+}
+
+/*
+ * Blocking transfer shared by the read and write calls. Like tinyalsa, an
+ * xrun restarts the stream unless it was opened PCM_NORESTART.
+ */
+static int pcm_transfer_l(struct pcm *pcm, void *data, unsigned int frames)
+{
+    uint8_t *buf = (uint8_t *)data;
+    int64_t now;
+    int64_t avail;
+    unsigned int chunk;
+
+    if (pcm->state == SNDRV_PCM_STATE_SETUP)
+        pcm->state = SNDRV_PCM_STATE_PREPARED;
+
+    while (frames > 0) {
+        now = sim_now_ns();
+        if (pcm_check_xrun_l(pcm, now)) {
+            if (pcm->flags & PCM_NORESTART)
+                return -EPIPE;
+            pcm->state = SNDRV_PCM_STATE_PREPARED;
+            continue;
+        }
+
+        if (!pcm->running && pcm_is_capture(pcm))
+            pcm_start_l(pcm, now);
+
+        avail = pcm_avail_l(pcm, pcm_hw_ptr_l(pcm, now));
+        if (avail <= 0) {
+            if (!pcm->running) {
+                /* playback buffer filled below the start threshold */
+                pcm_start_l(pcm, now);
+                continue;
+            }
+            chunk = frames < pcm->config.period_size ? frames : pcm->config.period_size;
+            sim_cond_wait_ns(&pcm->cond, &pcm->lock, pcm_wait_ns_l(pcm, now, chunk),
+                             &pcm->seed);
+            if (pcm->fd < 0 || pcm->state == SNDRV_PCM_STATE_SETUP)
+                return oops(pcm, EBADFD, "stream stopped during transfer");
+            continue;
+        }
+
+        chunk = (uint64_t)avail < frames ? (unsigned int)avail : frames;
+        pcm_copy_l(pcm, buf, chunk);
+        pcm->appl_ptr += chunk;
+        buf += (size_t)chunk * pcm->frame_bytes;
+        frames -= chunk;
+
+        if (pcm_is_capture(pcm)) {
+            atomic_fetch_add(&sim_counters.frames_read, chunk);
+        } else {
+            atomic_fetch_add(&sim_counters.frames_written, chunk);
+            if (!pcm->running &&
+                    pcm->appl_ptr - pcm->hw_base >= pcm->config.start_threshold)
+                pcm_start_l(pcm, now);
+        }
+    }
+    return 0;
+}
+
+unsigned int pcm_format_to_bits(enum pcm_format format)
+{
+    switch (format) {
+    case PCM_FORMAT_S32_LE:
+    case PCM_FORMAT_S24_LE:
+        return 32;
+    case PCM_FORMAT_S24_3LE:
+        return 24;
+    case PCM_FORMAT_S8:
+        return 8;
+    default:
+    case PCM_FORMAT_S16_LE:
+        return 16;
+    };
+}
+
+unsigned int pcm_bytes_to_frames(struct pcm *pcm, unsigned int bytes)
+{
+    return bytes / (pcm->config.channels *
+        (pcm_format_to_bits(pcm->config.format) >> 3));
+}
+
+unsigned int pcm_frames_to_bytes(struct pcm *pcm, unsigned int frames)
+{
+    return frames * pcm->config.channels *
+        (pcm_format_to_bits(pcm->config.format) >> 3);
+}
+
+const char *pcm_get_error(struct pcm *pcm)
+{
+    return pcm->error;
+}
+
+int pcm_is_ready(struct pcm *pcm)
+{
+    return pcm->fd >= 0;
+}
+
+unsigned int pcm_get_buffer_size(struct pcm *pcm)
+{
+    return pcm->buffer_size;
+}
+
+int pcm_get_poll_fd(struct pcm *pcm)
+{
+    return pcm->fd;
+}
+
+int pcm_set_config(struct pcm *pcm, struct pcm_config *config)
+{
+    if (pcm == NULL)
+        return -EFAULT;
+    if (config == NULL) {
+        config = &pcm->config;
+        config->channels = PCM_DEFAULT_CHANNELS;
+        config->rate = PCM_DEFAULT_RATE;
+        config->period_size = PCM_DEFAULT_PERIOD_SIZE;
+        config->period_count = PCM_DEFAULT_PERIOD_COUNT;
+        config->format = PCM_FORMAT_S16_LE;
+        config->start_threshold = config->period_count * config->period_size;
+        config->stop_threshold = config->period_count * config->period_size;
+        config->silence_threshold = 0;
+    } else {
+        pcm->config = *config;
+    }
+    if (pcm->config.channels == 0 || pcm->config.rate == 0 ||
+            pcm->config.period_size == 0 || pcm->config.period_count == 0)
+        return oops(pcm, EINVAL, "cannot set hw params");
+
+    pcm->frame_bytes = pcm_frames_to_bytes(pcm, 1);
+    pcm->buffer_size = pcm->config.period_count * pcm->config.period_size;
+    if (!pcm->config.start_threshold)
+        pcm->config.start_threshold = pcm->buffer_size / 2;
+    if (!pcm->config.stop_threshold)
+        pcm->config.stop_threshold = pcm->buffer_size;
+    if (!pcm->config.avail_min)
+        pcm->config.avail_min = pcm->config.period_size;
+    if (pcm_is_capture(pcm))
+        pcm->config.start_threshold = 1;
+    return 0;
+}
+
+static bool pcm_device_busy_l(unsigned int card, unsigned int device, unsigned int flags)
+{
+    struct listnode *node;
+    struct pcm *pcm;
+
+    list_for_each(node, &pcm_list) {
+        pcm = node_to_item(node, struct pcm, node);
+        if (pcm->card == card && pcm->device == device &&
+                (pcm->flags & PCM_IN) == (flags & PCM_IN))
+            return true;
+    }
+    return false;
+}
+
+struct pcm *pcm_open(unsigned int card, unsigned int device,
+                     unsigned int flags, struct pcm_config *config)
+{
+    const struct alsa_sim_config *cfg = sim_config();
+    struct pcm *pcm;
+    void *addr;
+    int fd;
+
+    if (card != cfg->card) {
+        oops(&bad_pcm, ENODEV, "cannot open device '/dev/snd/pcmC%uD%u%c'",
+             card, device, flags & PCM_IN ? 'c' : 'p');
+        return &bad_pcm;
+    }
+
+    pcm = calloc(1, sizeof(struct pcm));
+    if (!pcm) {
+        oops(&bad_pcm, ENOMEM, "cannot allocate PCM object");
+        return &bad_pcm;
+    }
+    pcm->fd = -1;
+    pcm->card = card;
+    pcm->device = device;
+    pcm->flags = flags;
+    if (pcm_set_config(pcm, config) != 0) {
+        strlcpy(bad_pcm.error, pcm->error, PCM_ERROR_MAX);
+        free(pcm);
+        return &bad_pcm;
+    }
+
+    pthread_mutex_lock(&pcm_list_lock);
+    if (pcm_device_busy_l(card, device, flags)) {
+        pthread_mutex_unlock(&pcm_list_lock);
+        oops(&bad_pcm, EBUSY, "cannot open device '/dev/snd/pcmC%uD%u%c'",
+             card, device, flags & PCM_IN ? 'c' : 'p');
+        free(pcm);
+        return &bad_pcm;
+    }
+    list_add_tail(&pcm_list, &pcm->node);
+    pthread_mutex_unlock(&pcm_list_lock);
+
+    pcm->mmap_size = (size_t)pcm->buffer_size * pcm->frame_bytes;
+    fd = sim_alloc_fd("alsa_sim_pcm", pcm->mmap_size);
+    addr = fd < 0 ? MAP_FAILED : mmap(NULL, pcm->mmap_size, PROT_READ | PROT_WRITE,
+                                      MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED) {
+        oops(&bad_pcm, errno, "failed to mmap device memory");
+        if (fd >= 0)
+            close(fd);
+        pthread_mutex_lock(&pcm_list_lock);
+        list_remove(&pcm->node);
+        pthread_mutex_unlock(&pcm_list_lock);
+        free(pcm);
+        return &bad_pcm;
+    }
+    pcm->fd = fd;
+    pcm->mmap_buffer = addr;
+
+    pthread_mutex_init(&pcm->lock, NULL);
+    sim_cond_init(&pcm->cond);
+    pcm->state = SNDRV_PCM_STATE_SETUP;
+    pcm->xrun_gen = atomic_load(&sim_xrun_generation);
+    pcm->seed = (unsigned int)sim_now_ns() ^ device;
+    atomic_fetch_add(&sim_counters.pcm_opens, 1);
+
+    sim_open_delay();
+    ALOGV("%s: card %u device %u %s, %u ch %u Hz period %u x %u", __func__,
+          card, device, flags & PCM_IN ? "capture" : "playback",
+          pcm->config.channels, pcm->config.rate, pcm->config.period_size,
+          pcm->config.period_count);
+    return pcm;
+}
+
+int pcm_close(struct pcm *pcm)
+{
+    if (pcm == &bad_pcm)
+        return 0;
+
+    pthread_mutex_lock(&pcm_list_lock);
+    list_remove(&pcm->node);
+    pthread_mutex_unlock(&pcm_list_lock);
+
+    pthread_mutex_lock(&pcm->lock);
+    pcm_stop_l(pcm, sim_now_ns());
+    pthread_mutex_unlock(&pcm->lock);
+
+    munmap(pcm->mmap_buffer, pcm->mmap_size);
+    close(pcm->fd);
+    pthread_cond_destroy(&pcm->cond);
+    pthread_mutex_destroy(&pcm->lock);
+    free(pcm);
+    return 0;
+}
+
+int pcm_prepare(struct pcm *pcm)
+{
+    if (!pcm_is_ready(pcm))
+        return -1;
+
+    pthread_mutex_lock(&pcm->lock);
+    if (pcm->running)
+        pcm_stop_l(pcm, sim_now_ns());
+    pcm->state = SNDRV_PCM_STATE_PREPARED;
+    pthread_mutex_unlock(&pcm->lock);
+    return 0;
+}
+
+int pcm_start(struct pcm *pcm)
+{
+    if (!pcm_is_ready(pcm))
+        return -1;
+
+    pthread_mutex_lock(&pcm->lock);
+    if (!pcm->running)
+        pcm_start_l(pcm, sim_now_ns());
+    pthread_mutex_unlock(&pcm->lock);
+    return 0;
+}
+
+int pcm_stop(struct pcm *pcm)
+{
+    if (!pcm_is_ready(pcm))
+        return -1;
+
+    pthread_mutex_lock(&pcm->lock);
+    pcm_stop_l(pcm, sim_now_ns());
+    pthread_mutex_unlock(&pcm->lock);
+    return 0;
+}
+
+int pcm_state(struct pcm *pcm)
+{
+    int state;
+
+    if (!pcm_is_ready(pcm))
+        return -1;
+
+    pthread_mutex_lock(&pcm->lock);
+    pcm_check_xrun_l(pcm, sim_now_ns());
+    state = pcm->state;
+    pthread_mutex_unlock(&pcm->lock);
+    return state;
+}
+
+int pcm_write(struct pcm *pcm, const void *data, unsigned int count)
+{
+    int ret;
+
+    if (!pcm_is_ready(pcm) || pcm_is_capture(pcm))
+        return -EINVAL;
+
+    pthread_mutex_lock(&pcm->lock);
+    ret = pcm_transfer_l(pcm, (void *)data, pcm_bytes_to_frames(pcm, count));
+    pthread_mutex_unlock(&pcm->lock);
+    return ret;
+}
+
+int pcm_read(struct pcm *pcm, void *data, unsigned int count)
+{
+    int ret;
+
+    if (!pcm_is_ready(pcm) || !pcm_is_capture(pcm))
+        return -EINVAL;
+
+    pthread_mutex_lock(&pcm->lock);
+    ret = pcm_transfer_l(pcm, data, pcm_bytes_to_frames(pcm, count));
+    pthread_mutex_unlock(&pcm->lock);
+    return ret;
+}
+
+int pcm_mmap_write(struct pcm *pcm, const void *data, unsigned int count)
+{
+    return pcm_write(pcm, data, count);
+}
+
+int pcm_mmap_read(struct pcm *pcm, void *data, unsigned int count)
+{
+    return pcm_read(pcm, data, count);
+}
+
+int pcm_mmap_avail(struct pcm *pcm)
+{
+    int64_t now;
+    int64_t avail;
+
+    if (!pcm_is_ready(pcm))
+        return -1;
+
+    pthread_mutex_lock(&pcm->lock);
+    now = sim_now_ns();
+    pcm_check_xrun_l(pcm, now);
+    avail = pcm_avail_l(pcm, pcm_hw_ptr_l(pcm, now));
+    pthread_mutex_unlock(&pcm->lock);
+    if (avail < 0)
+        avail = 0;
+    return avail > pcm->buffer_size ? (int)pcm->buffer_size : (int)avail;
+}
+
+int pcm_mmap_begin(struct pcm *pcm, void **areas, unsigned int *offset,
+                   unsigned int *frames)
+{
+    unsigned int continuous, copy_frames;
+    int avail;
+
+    if (!pcm_is_ready(pcm))
+        return -1;
+
+    avail = pcm_mmap_avail(pcm);
+    pthread_mutex_lock(&pcm->lock);
+    *areas = pcm->mmap_buffer;
+    *offset = pcm->appl_ptr % pcm->buffer_size;
+    continuous = pcm->buffer_size - *offset;
+    pthread_mutex_unlock(&pcm->lock);
+
+    copy_frames = *frames;
+    if (copy_frames > (unsigned int)avail)
+        copy_frames = avail;
+    if (copy_frames > continuous)
+        copy_frames = continuous;
+    *frames = copy_frames;
+    return 0;
+}
+
+int pcm_mmap_commit(struct pcm *pcm, unsigned int offset __unused, unsigned int frames)
+{
+    if (!pcm_is_ready(pcm))
+        return -1;
+
+    pthread_mutex_lock(&pcm->lock);
+    pcm->appl_ptr += frames;
+    if (pcm_is_capture(pcm)) {
+        atomic_fetch_add(&sim_counters.frames_read, frames);
+    } else {
+        atomic_fetch_add(&sim_counters.frames_written, frames);
+        if (!pcm->running && pcm->state == SNDRV_PCM_STATE_PREPARED &&
+                pcm->appl_ptr - pcm->hw_base >= pcm->config.start_threshold)
+            pcm_start_l(pcm, sim_now_ns());
+    }
+    pthread_mutex_unlock(&pcm->lock);
+    return frames;
+}
+
+int pcm_mmap_get_hw_ptr(struct pcm *pcm, unsigned int *hw_ptr, struct timespec *tstamp)
+{
+    int64_t now;
+
+    if (!pcm_is_ready(pcm) || hw_ptr == NULL || tstamp == NULL)
+        return -1;
+
+    pthread_mutex_lock(&pcm->lock);
+    now = sim_now_ns();
+    *hw_ptr = (unsigned int)pcm_hw_pos_l(pcm, now);
+    sim_ns_to_timespec(pcm->running ? now : pcm->base_ns, tstamp);
+    pthread_mutex_unlock(&pcm->lock);
+    return 0;
+}
+
+int pcm_get_htimestamp(struct pcm *pcm, unsigned int *avail, struct timespec *tstamp)
+{
+    int64_t now, ts_ns, frames;
+    uint64_t hw_ptr;
+    int ret = -1;
+
+    if (!pcm_is_ready(pcm))
+        return -1;
+
+    pthread_mutex_lock(&pcm->lock);
+    now = sim_now_ns();
+    pcm_check_xrun_l(pcm, now);
+    if (!pcm->running)
+        goto exit;
+
+    hw_ptr = pcm_hw_ptr_l(pcm, now);
+    frames = pcm_avail_l(pcm, hw_ptr);
+    if (frames < 0)
+        frames = 0;
+    *avail = frames > pcm->buffer_size ? pcm->buffer_size : (unsigned int)frames;
+
+    /* time stamp of the last hw pointer update */
+    ts_ns = now;
+    if (pcm->speed > 0)
+        ts_ns = pcm->base_ns + sim_units_to_ns(hw_ptr - pcm->hw_base, pcm->speed,
+                                               pcm->config.rate) - 1;
+    sim_ns_to_timespec(ts_ns, tstamp);
+    ret = 0;
+exit:
+    pthread_mutex_unlock(&pcm->lock);
+    return ret;
+}
+
+long pcm_get_delay(struct pcm *pcm)
+{
+    int64_t delay;
+
+    if (!pcm_is_ready(pcm))
+        return -1;
+
+    pthread_mutex_lock(&pcm->lock);
+    delay = pcm_avail_l(pcm, pcm_hw_ptr_l(pcm, sim_now_ns()));
+    if (!pcm_is_capture(pcm))
+        delay = (int64_t)pcm->buffer_size - delay;
+    pthread_mutex_unlock(&pcm->lock);
+    return (long)delay;
+}
+
+int pcm_set_avail_min(struct pcm *pcm, int avail_min)
+{
+    if (!pcm_is_ready(pcm) || avail_min <= 0)
+        return -1;
+
+    pthread_mutex_lock(&pcm->lock);
+    pcm->config.avail_min = avail_min;
+    pthread_mutex_unlock(&pcm->lock);
+    return 0;
+}
+
+int pcm_wait(struct pcm *pcm, int timeout)
+{
+    int64_t now, deadline, wait_ns;
+    int ret = 0;
+
+    if (!pcm_is_ready(pcm))
+        return -1;
+
+    pthread_mutex_lock(&pcm->lock);
+    now = sim_now_ns();
+    deadline = timeout < 0 ? INT64_MAX : now + (int64_t)timeout * 1000000;
+    for (;;) {
+        if (pcm_check_xrun_l(pcm, now)) {
+            ret = -EPIPE;
+            break;
+        }
+        if (pcm->running &&
+                pcm_avail_l(pcm, pcm_hw_ptr_l(pcm, now)) >= pcm->config.avail_min) {
+            ret = 1;
+            break;
+        }
+        if (now >= deadline)
+            break;
+        wait_ns = pcm->running ? pcm_wait_ns_l(pcm, now, pcm->config.avail_min) :
+                                 deadline - now;
+        if (wait_ns > deadline - now)
+            wait_ns = deadline - now;
+        sim_cond_wait_ns(&pcm->cond, &pcm->lock, wait_ns, &pcm->seed);
+        now = sim_now_ns();
+    }
+    pthread_mutex_unlock(&pcm->lock);
+    return ret;
+}
+
+/* Capabilities of every simulated device. */
+struct pcm_params {
+    unsigned int min[PCM_PARAM_TICK_TIME + 1];
+    unsigned int max[PCM_PARAM_TICK_TIME + 1];
+    struct pcm_mask formats;
+};
+
+#define PCM_MASK_BITS (sizeof(unsigned int) * 8)
+
+static void pcm_mask_set(struct pcm_mask *mask, unsigned int bit)
+{
+    mask->bits[bit / PCM_MASK_BITS] |= 1u << (bit % PCM_MASK_BITS);
+}
+
+static bool pcm_mask_test(const struct pcm_mask *mask, unsigned int bit)
+{
+    return (mask->bits[bit / PCM_MASK_BITS] >> (bit % PCM_MASK_BITS)) & 1;
+}
+
+struct pcm_params *pcm_params_get(unsigned int card, unsigned int device __unused,
+                                  unsigned int flags __unused)
+{
+    struct pcm_params *params;
+
+    if (card != sim_config()->card)
+        return NULL;
+
+    params = calloc(1, sizeof(struct pcm_params));
+    if (!params)
+        return NULL;
+
+    params->min[PCM_PARAM_SAMPLE_BITS] = 16;
+    params->max[PCM_PARAM_SAMPLE_BITS] = 32;
+    params->min[PCM_PARAM_CHANNELS] = 1;
+    params->max[PCM_PARAM_CHANNELS] = 8;
+    params->min[PCM_PARAM_RATE] = 8000;
+    params->max[PCM_PARAM_RATE] = 384000;
+    params->min[PCM_PARAM_PERIOD_SIZE] = 16;
+    params->max[PCM_PARAM_PERIOD_SIZE] = 16384;
+    params->min[PCM_PARAM_PERIODS] = 2;
+    params->max[PCM_PARAM_PERIODS] = 32;
+    pcm_mask_set(&params->formats, SNDRV_PCM_FORMAT_S16_LE);
+    pcm_mask_set(&params->formats, SNDRV_PCM_FORMAT_S24_LE);
+    pcm_mask_set(&params->formats, SNDRV_PCM_FORMAT_S32_LE);
+    pcm_mask_set(&params->formats, SNDRV_PCM_FORMAT_S24_3LE);
+    return params;
+}
+
+void pcm_params_free(struct pcm_params *pcm_params)
+{
+    free(pcm_params);
+}
+
+unsigned int pcm_params_get_min(struct pcm_params *pcm_params, enum pcm_param param)
+{
+    if (!pcm_params || param < 0 || param > PCM_PARAM_TICK_TIME)
+        return 0;
+    return pcm_params->min[param];
+}
+
+unsigned int pcm_params_get_max(struct pcm_params *pcm_params, enum pcm_param param)
+{
+    if (!pcm_params || param < 0 || param > PCM_PARAM_TICK_TIME)
+        return 0;
+    return pcm_params->max[param];
+}
+
+struct pcm_mask *pcm_params_get_mask(struct pcm_params *pcm_params, enum pcm_param param)
+{
+    if (!pcm_params || param != PCM_PARAM_FORMAT)
+        return NULL;
+    return &pcm_params->formats;
+}
+
+int pcm_params_format_test(struct pcm_params *params, enum pcm_format format)
+{
+    static const int alsa_format[] = {
+        [PCM_FORMAT_S16_LE] = SNDRV_PCM_FORMAT_S16_LE,
+        [PCM_FORMAT_S32_LE] = SNDRV_PCM_FORMAT_S32_LE,
+        [PCM_FORMAT_S8] = SNDRV_PCM_FORMAT_S8,
+        [PCM_FORMAT_S24_LE] = SNDRV_PCM_FORMAT_S24_LE,
+        [PCM_FORMAT_S24_3LE] = SNDRV_PCM_FORMAT_S24_3LE,
+    };
+
+    if (!params || format < 0 || format >= (int)(sizeof(alsa_format) / sizeof(alsa_format[0])))
+        return 0;
+    return pcm_mask_test(&params->formats, alsa_format[format]);
+}
+
+int pcm_params_to_string(struct pcm_params *params, char *string, unsigned int size)
+{
+    if (!params || !string || size == 0)
+        return -EINVAL;
+
+    return snprintf(string, size,
+                    "Format:\tS16_LE S24_LE S32_LE S24_3LE\n"
+                    "Channels:\tmin=%u\t\tmax=%u\n"
+                    "Rate:\tmin=%uHz\tmax=%uHz\n"
+                    "Period size:\tmin=%u\t\tmax=%u\n"
+                    "Period count:\tmin=%u\t\tmax=%u\n",
+                    params->min[PCM_PARAM_CHANNELS], params->max[PCM_PARAM_CHANNELS],
+                    params->min[PCM_PARAM_RATE], params->max[PCM_PARAM_RATE],
+                    params->min[PCM_PARAM_PERIOD_SIZE], params->max[PCM_PARAM_PERIOD_SIZE],
+                    params->min[PCM_PARAM_PERIODS], params->max[PCM_PARAM_PERIODS]);
+}
@@ -0,0 +1,15 @@
+LOCAL_PATH := $(call my-dir)
+
+# alsa_sim_test
+# ==============================================================================
+include $(CLEAR_VARS)
+LOCAL_SRC_FILES := alsa_sim_test.c
+LOCAL_MODULE := alsa_sim_test
+LOCAL_MODULE_TAGS := optional
+LOCAL_C_INCLUDES := \
+    $(LOCAL_PATH)/../../hal/test \
+    external/tinyalsa/include \
+    external/tinycompress/include
+LOCAL_CFLAGS += -Wall -Werror
+LOCAL_SHARED_LIBRARIES := libalsa_sim
+include $(BUILD_HOST_EXECUTABLE)
@@ -0,0 +1,262 @@
+/*
+ * Copyright (c) 2023 Qualcomm Innovation Center, Inc. All rights reserved.
+ * SPDX-License-Identifier: BSD-3-Clause-Clear
+ */
+
+/*
+ * Host test of libalsa_sim through the tinyalsa and tinycompress API, the
+ * way the HAL uses it: mixer controls from a mixer_paths xml and their
+ * events, PCM pacing by the device clock, busy devices, xrun injection,
+ * the MMAP hw pointer and compressed stream drain.
+ *
+ * usage: alsa_sim_test
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include "test_common.h"
+#include <tinyalsa/asoundlib.h>
+#include <tinycompress/tinycompress.h>
+#include "alsa_sim.h"
+
+#define PLAYBACK_DEVICE 1
+#define CAPTURE_DEVICE 5
+#define MMAP_DEVICE 7
+#define COMPRESS_DEVICE 9
+
+static const char mixer_paths[] =
+    "<mixer>\n"
+    "    <ctl name=\"SLIM RX0 MUX\" value=\"ZERO\" />\n"
+    "    <ctl name=\"RX1 Digital Volume\" value=\"84\" />\n"
+    "    <path name=\"speaker\">\n"
+    "        <ctl name=\"SLIM RX0 MUX\" value=\"AIF1_PB\" />\n"
+    "        <ctl name=\"RX1 Digital Volume\" value=\"0\" />\n"
+    "    </path>\n"
+    "</mixer>\n";
+
+static double now_s(void)
+{
+    return test_now_ns() / 1e9;
+}
+
+static void test_mixer(void)
+{
+    struct mixer *mixer = mixer_open(0);
+    struct mixer *events = mixer_open(0);
+    struct mixer_ctl *mux, *volume;
+    struct snd_ctl_event event;
+
+    EXPECT(mixer != NULL && events != NULL, "mixer_open");
+    if (mixer == NULL || events == NULL)
+        return;
+    mixer_subscribe_events(events, 1);
+
+    mux = mixer_get_ctl_by_name(mixer, "SLIM RX0 MUX");
+    EXPECT(mux != NULL && mixer_ctl_get_type(mux) == MIXER_CTL_TYPE_ENUM &&
+           mixer_ctl_get_num_enums(mux) == 2, "enum control from the xml");
+    volume = mixer_get_ctl_by_name(mixer, "RX1 Digital Volume");
+    EXPECT(volume != NULL && mixer_ctl_get_type(volume) == MIXER_CTL_TYPE_INT &&
+           mixer_ctl_get_range_min(volume) == 0 && mixer_ctl_get_range_max(volume) == 84,
+           "int control range from the xml");
+    if (mux == NULL || volume == NULL)
+        goto exit;
+
+    EXPECT(mixer_ctl_set_enum_by_string(mux, "AIF1_PB") == 0, "set enum");
+    EXPECT(mixer_ctl_set_enum_by_string(mux, "NOPE") == -EINVAL, "unknown enum accepted");
+    EXPECT(mixer_ctl_set_value(volume, 0, 40) == 0 && mixer_ctl_get_value(volume, 0) == 40,
+           "int value");
+
+    EXPECT(mixer_wait_event(events, 100) > 0, "no event for the value changes");
+    while (mixer_wait_event(events, 0) > 0)
+        mixer_read(events, &event);
+
+    EXPECT(alsa_sim_mixer_notify("SLIM RX0 MUX") == 0, "notify");
+    EXPECT(mixer_wait_event(events, 100) > 0 &&
+           mixer_read(events, &event) == sizeof(event) &&
+           !strcmp((const char *)event.data.elem.id.name, "SLIM RX0 MUX"),
+           "notified event");
+    EXPECT(alsa_sim_mixer_notify("No Such Control") == -ENOENT, "notify unknown control");
+
+exit:
+    mixer_close(events);
+    mixer_close(mixer);
+}
+
+/* plays seconds of audio, returns the wall clock time it took */
+static double play(double seconds)
+{
+    struct pcm_config config = {
+        .channels = 2,
+        .rate = 48000,
+        .period_size = 240,
+        .period_count = 4,
+        .format = PCM_FORMAT_S16_LE,
+    };
+    static char buffer[240 * 4];
+    struct pcm *pcm = pcm_open(0, PLAYBACK_DEVICE, PCM_OUT, &config);
+    int periods = (int)(seconds * config.rate / config.period_size);
+    double start = now_s();
+    int i;
+
+    if (!pcm_is_ready(pcm)) {
+        EXPECT(false, "pcm_open: %s", pcm_get_error(pcm));
+        pcm_close(pcm);
+        return -1;
+    }
+    for (i = 0; i < periods; i++)
+        pcm_write(pcm, buffer, sizeof(buffer));
+    pcm_close(pcm);
+    return now_s() - start;
+}
+
+static void test_pcm_pacing(void)
+{
+    struct alsa_sim_stats stats;
+    double elapsed;
+
+    alsa_sim_reset_stats();
+    alsa_sim_set_speed(10);
+    elapsed = play(1.0);
+    EXPECT(elapsed > 0.07 && elapsed < 0.5, "1 s at speed 10 took %.3f s", elapsed);
+
+    alsa_sim_set_speed(0);
+    elapsed = play(1.0);
+    EXPECT(elapsed < 0.05, "1 s at speed 0 took %.3f s", elapsed);
+
+    alsa_sim_get_stats(&stats);
+    EXPECT(stats.frames_written == 2 * 48000, "frames written %llu",
+           (unsigned long long)stats.frames_written);
+}
+
+static void test_xrun_injection(void)
+{
+    struct alsa_sim_stats stats;
+
+    alsa_sim_set_speed(0);
+    alsa_sim_reset_stats();
+    alsa_sim_set_xrun_period(20);
+    play(1.0);
+    alsa_sim_set_xrun_period(0);
+    alsa_sim_get_stats(&stats);
+    EXPECT(stats.xruns >= 5 && stats.xruns <= 20, "%llu xruns in 200 periods",
+           (unsigned long long)stats.xruns);
+}
+
+static void test_capture(void)
+{
+    struct pcm_config config = {
+        .channels = 1,
+        .rate = 16000,
+        .period_size = 320,
+        .period_count = 2,
+        .format = PCM_FORMAT_S16_LE,
+    };
+    struct alsa_sim_stats stats;
+    char buffer[640];
+    struct pcm *pcm, *busy;
+    int i;
+
+    alsa_sim_set_speed(0);
+    alsa_sim_reset_stats();
+    pcm = pcm_open(0, CAPTURE_DEVICE, PCM_IN, &config);
+    busy = pcm_open(0, CAPTURE_DEVICE, PCM_IN, &config);
+    EXPECT(pcm_is_ready(pcm), "capture open: %s", pcm_get_error(pcm));
+    EXPECT(!pcm_is_ready(busy), "second capture open on a busy device succeeded");
+    pcm_close(busy);
+
+    for (i = 0; i < 10; i++)
+        EXPECT(pcm_read(pcm, buffer, sizeof(buffer)) == 0, "pcm_read");
+    pcm_close(pcm);
+    alsa_sim_get_stats(&stats);
+    EXPECT(stats.frames_read == 10 * 320, "frames read %llu",
+           (unsigned long long)stats.frames_read);
+}
+
+static void test_mmap(void)
+{
+    struct pcm_config config = {
+        .channels = 2,
+        .rate = 48000,
+        .period_size = 96,
+        .period_count = 8,
+        .format = PCM_FORMAT_S16_LE,
+        .start_threshold = 0x7fffffff,
+        .stop_threshold = 0x7fffffff,
+    };
+    struct pcm *pcm;
+    struct timespec ts;
+    unsigned int offset = 0, frames = 0, hw_ptr = 0;
+    void *area = NULL;
+
+    alsa_sim_set_speed(1);
+    pcm = pcm_open(0, MMAP_DEVICE, PCM_OUT | PCM_MMAP | PCM_NOIRQ, &config);
+    EXPECT(pcm_is_ready(pcm), "mmap open: %s", pcm_get_error(pcm));
+    EXPECT(pcm_mmap_begin(pcm, &area, &offset, &frames) == 0 && area != NULL,
+           "mmap area");
+    EXPECT(pcm_get_poll_fd(pcm) >= 0, "mmap buffer has no fd");
+    EXPECT(pcm_start(pcm) == 0, "start");
+    usleep(50000);
+    EXPECT(pcm_mmap_get_hw_ptr(pcm, &hw_ptr, &ts) == 0 && hw_ptr >= 48000 / 40,
+           "hw pointer %u after 50 ms", hw_ptr);
+    pcm_close(pcm);
+}
+
+static void test_compress(void)
+{
+    struct snd_codec codec;
+    struct compr_config config;
+    static char buffer[4000];
+    struct compress *compress;
+    unsigned long samples = 0;
+    unsigned int rate = 0;
+    int i;
+
+    memset(&codec, 0, sizeof(codec));
+    codec.id = SND_AUDIOCODEC_MP3;
+    codec.sample_rate = 48000;
+    codec.ch_in = 2;
+    codec.bit_rate = 128000;
+    config.fragment_size = sizeof(buffer);
+    config.fragments = 4;
+    config.codec = &codec;
+
+    /* 5 fragments of 4000 bytes at 128 kbit/s are 1.25 s, 60000 samples */
+    alsa_sim_set_speed(10);
+    compress = compress_open(0, COMPRESS_DEVICE, COMPRESS_IN, &config);
+    EXPECT(is_compress_ready(compress), "compress open: %s", compress_get_error(compress));
+    compress_write(compress, buffer, sizeof(buffer));
+    compress_start(compress);
+    for (i = 0; i < 4; i++)
+        compress_write(compress, buffer, sizeof(buffer));
+    EXPECT(compress_drain(compress) == 0, "drain");
+    EXPECT(compress_get_tstamp(compress, &samples, &rate) == 0 && samples == 60000,
+           "%lu samples rendered after drain", samples);
+    compress_stop(compress);
+    compress_close(compress);
+}
+
+int main(void)
+{
+    char path[] = "/tmp/alsa_sim_test_XXXXXX";
+    int fd = mkstemp(path);
+
+    if (fd < 0 || write(fd, mixer_paths, sizeof(mixer_paths) - 1) < 0) {
+        printf("cannot write %s\n", path);
+        return EXIT_FAILURE;
+    }
+    close(fd);
+    /* the card reads its environment on first use */
+    setenv("ALSA_SIM_MIXER_PATHS", path, 1);
+    setenv("ALSA_SIM_MIXER_STRICT", "1", 1);
+
+    test_mixer();
+    test_pcm_pacing();
+    test_xrun_injection();
+    test_capture();
+    test_mmap();
+    test_compress();
+
+    unlink(path);
+    return test_finish();
+}
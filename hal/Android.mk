@@ -141,6 +141,8 @@ LOCAL_SRC_FILES += audio_extn/audio_extn.c \
                    audio_extn/usb.c \
                    audio_extn/utils.c \
                    audio_extn/device_utils.c \
+                   audio_extn/param_router.c \
+                   audio_extn/lock_stats.c \
                    voice_extn/compress_voip.c \
                    voice_extn/voice_extn.c
 
@@ -409,5 +411,6 @@ LOCAL_CFLAGS += -Wno-tautological-compare
 LOCAL_CFLAGS += -Wno-unused-function
 LOCAL_CFLAGS += -Wno-unused-local-typedef
 
+include $(LOCAL_PATH)/test/Android.mk
 endif
 endif
@@ -22,6 +22,7 @@
 #define LOG_NDDEBUG 0
 
 #include <stdlib.h>
+#include <string.h>
 #include <dlfcn.h>
 #include <log/log.h>
 #include <cutils/list.h>
@@ -262,3 +263,42 @@ int acdb_set_metainfo_key(void *platform, char *name, int key) {
 
     return 0;
 }
+
+void acdb_cal_cache_init(struct acdb_cal_cache *cache)
+{
+    memset(cache, 0, sizeof(*cache));
+    /* entries at generation 0 are never valid */
+    cache->gen = 1;
+}
+
+void acdb_cal_cache_invalidate(struct acdb_cal_cache *cache)
+{
+    __atomic_add_fetch(&cache->gen, 1, __ATOMIC_RELEASE);
+}
+
+/* Stamps cal with the current generation and compares it to the last send */
+bool acdb_cal_cache_is_sent(struct acdb_cal_cache *cache,
+                            struct acdb_cal_state *cal, int acdb_dev_type)
+{
+    if (acdb_dev_type < 0 || acdb_dev_type >= ACDB_CAL_CACHE_DEV_TYPES)
+        return false;
+
+    cal->gen = __atomic_load_n(&cache->gen, __ATOMIC_ACQUIRE);
+    return !memcmp(&cache->sent[acdb_dev_type], cal, sizeof(*cal));
+}
+
+void acdb_cal_cache_update(struct acdb_cal_cache *cache,
+                           struct acdb_cal_state *cal, int acdb_dev_type,
+                           bool hit, uint64_t send_us)
+{
+    if (hit) {
+        cache->hits++;
+        if (cache->misses)
+            cache->saved_us += cache->send_us / cache->misses;
+        return;
+    }
+    cache->misses++;
+    cache->send_us += send_us;
+    if (acdb_dev_type >= 0 && acdb_dev_type < ACDB_CAL_CACHE_DEV_TYPES)
+        cache->sent[acdb_dev_type] = *cal;
+}
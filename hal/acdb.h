@@ -21,6 +21,7 @@
 #define ACDB_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <linux/msm_audio_calibration.h>
 
 #define MAX_CVD_VERSION_STRING_SIZE 100
@@ -89,4 +90,40 @@ int acdb_init(int);
 int acdb_init_v2(struct mixer *);
 
 int acdb_set_metainfo_key(void *platform, char *name, int key);
+
+/* Audio calibration last sent for an ACDB device type */
+struct acdb_cal_state {
+    uint32_t gen;                   /* cache generation at send */
+    int acdb_dev_id;
+    int app_type;
+    int sample_rate;
+    int path;
+    int backend_sample_rate;
+    int backend_bit_width;
+};
+
+/* indexed by ACDB_DEV_TYPE_OUT and ACDB_DEV_TYPE_IN */
+#define ACDB_CAL_CACHE_DEV_TYPES 3
+
+/*
+ * Skips audio calibration sends repeating the calibration last sent on the
+ * same device type and path, which the DSP still holds. Anything else
+ * changing audio calibration bumps gen, invalidating all entries.
+ */
+struct acdb_cal_cache {
+    uint32_t gen;
+    struct acdb_cal_state sent[ACDB_CAL_CACHE_DEV_TYPES];
+    uint32_t hits;
+    uint32_t misses;
+    uint64_t send_us;               /* time spent in sends */
+    uint64_t saved_us;              /* hits at the average send time */
+};
+
+void acdb_cal_cache_init(struct acdb_cal_cache *cache);
+void acdb_cal_cache_invalidate(struct acdb_cal_cache *cache);
+bool acdb_cal_cache_is_sent(struct acdb_cal_cache *cache,
+                            struct acdb_cal_state *cal, int acdb_dev_type);
+void acdb_cal_cache_update(struct acdb_cal_cache *cache,
+                           struct acdb_cal_state *cal, int acdb_dev_type,
+                           bool hit, uint64_t send_us);
 #endif //ACDB_H
@@ -267,7 +267,9 @@ LOCAL_MODULE_OWNER := third_party
 LOCAL_VENDOR_MODULE := true
 
 LOCAL_SRC_FILES:= \
-        spkr_protection.c
+        spkr_protection.c \
+        device_utils.c \
+        lock_stats.c
 
 LOCAL_CFLAGS += \
     -Wall \
@@ -326,7 +328,9 @@ LOCAL_MODULE_OWNER := third_party
 LOCAL_VENDOR_MODULE := true
 
 LOCAL_SRC_FILES:= \
-        cirrus_playback.c
+        cirrus_playback.c \
+        device_utils.c \
+        lock_stats.c
 
 LOCAL_CFLAGS += \
     -Wall \
@@ -587,7 +591,8 @@ endif
 
 LOCAL_SRC_FILES:= \
         passthru.c \
-        device_utils.c
+        device_utils.c \
+        lock_stats.c
 
 LOCAL_CFLAGS += \
     -Wall \
@@ -924,7 +929,8 @@ endif
 
 LOCAL_SRC_FILES:= \
         auto_hal.c \
-        device_utils.c
+        device_utils.c \
+        lock_stats.c
 
 LOCAL_CFLAGS += \
     -Wall \
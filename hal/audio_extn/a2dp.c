@@ -2931,7 +2931,7 @@ int a2dp_set_parameters(struct str_parms *parms, bool *reconfig)
             list_for_each(node, &a2dp.adev->usecase_list) {
                 uc_info = node_to_item(node, struct audio_usecase, list);
                 if (uc_info->stream.out && uc_info->type == PCM_PLAYBACK &&
-                    is_a2dp_out_device_type(&uc_info->stream.out->device_list)) {
+                    device_set_has(&uc_info->stream.out->device_list, DEVICE_SET_A2DP_OUT)) {
                     fp_check_a2dp_restore_l(a2dp.adev, uc_info->stream.out, true);
                 }
             }
@@ -40,9 +40,12 @@
 #include <pthread.h>
 #include <errno.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 #include <sys/resource.h>
 #include <sys/prctl.h>
 #include <log/log.h>
+#include <cutils/hashmap.h>
 #include <cutils/sched_policy.h>
 #include <system/thread_defs.h>
 #include <sound/asound.h>
@@ -55,7 +58,10 @@
 #include "adsp_hdlr.h"
 
 #define MAX_EVENT_PAYLOAD             512
-#define WAIT_EVENT_POLL_TIMEOUT       50
+/* the event thread only needs to wake up to check for exit */
+#define WAIT_EVENT_POLL_TIMEOUT       500
+#define EVENT_CTL_MAP_SIZE            16
+#define NUM_EVENT_WORKERS             2
 
 #define MIXER_MAX_BYTE_LENGTH 512
 
@@ -68,43 +74,57 @@ struct adsp_hdlr_stream_data {
 struct adsp_hdlr_event_info {
     struct listnode list;
     void *stream_handle;
-    char mixer_ctl_name[MIXER_PATH_MAX_LENGTH];
-    char cb_mixer_ctl_name[MIXER_PATH_MAX_LENGTH];
     adsp_event_callback_t cb;
     void *cookie;
     int event_type;
 };
 
-struct adsp_hdlr_inst {
+struct adsp_hdlr_worker {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    struct listnode cmd_list;
+    bool exit;
+};
+
+/*
+ * Callback event control of the DSP, with the events registered on it.
+ * Created on first registration and kept until deinit, so queued commands
+ * can refer to it. All events of a control are delivered by the same
+ * worker, in order.
+ */
+struct adsp_hdlr_event_ctl {
+    char name[MIXER_PATH_MAX_LENGTH];
+    struct mixer_ctl *ctl;
+    struct adsp_hdlr_worker *worker;
+    pthread_mutex_t lock;
     struct listnode event_list;
-    bool binit;
+};
+
+/*
+ * A single event thread reads the mixer events for all streams and hands
+ * them to the worker of their control, looked up by control name. The
+ * event thread stops listening to mixer events while nothing is
+ * registered.
+ */
+struct adsp_hdlr_inst {
     struct mixer *mixer;
-    pthread_mutex_t event_list_lock;
+    pthread_mutex_t lock;
+    Hashmap *event_ctls;
+    unsigned int num_event_ctls;
+    unsigned int num_events;
+    bool subscribed;
+    bool threads_active;
+    bool exit;
 
-    struct listnode list;
     pthread_cond_t event_wait_cond;
     pthread_t event_wait_thread;
-    struct listnode event_wait_cmd_list;
-    pthread_mutex_t event_wait_lock;
-    bool event_wait_thread_active;
-
-    pthread_cond_t event_callback_cond;
-    pthread_t event_callback_thread;
-    struct listnode event_callback_cmd_list;
-    pthread_mutex_t event_callback_lock;
-    bool event_callback_thread_active;
-};
-
-enum {
-    EVENT_CMD_EXIT,             /* event thread exit command loop*/
-    EVENT_CMD_WAIT,             /* event thread wait on mixer control */
-    EVENT_CMD_GET               /* event thread get param data from mixer */
+    struct adsp_hdlr_worker workers[NUM_EVENT_WORKERS];
 };
 
 struct event_cmd {
     struct listnode list;
-    int opcode;
-    char cb_mixer_ctl_name[SNDRV_CTL_ELEM_ID_NAME_MAXLEN];
+    struct adsp_hdlr_event_ctl *event_ctl;
 };
 
 static struct adsp_hdlr_inst *adsp_hdlr_inst = NULL;
@@ -112,345 +132,378 @@ static struct adsp_hdlr_inst *adsp_hdlr_inst = NULL;
 static void *event_wait_thread_loop(void *context);
 static void *event_callback_thread_loop(void *context);
 
-static int send_cmd_event_wait_thread(struct adsp_hdlr_inst *adsp_hdlr_inst, int opcode)
+static int event_ctl_hash(void *key)
 {
-    struct event_cmd *cmd = calloc(1, sizeof(*cmd));
-
-    if (!cmd) {
-        ALOGE("Failed to allocate mem for command 0x%x", opcode);
-        return -ENOMEM;
-    }
+    return hashmapHash(key, strlen((const char *)key));
+}
 
-    ALOGVV("%s %d", __func__, opcode);
+static bool event_ctl_equals(void *key1, void *key2)
+{
+    return !strcmp((const char *)key1, (const char *)key2);
+}
 
-    cmd->opcode = opcode;
+static bool free_event_ctl(void *key __unused, void *value, void *context __unused)
+{
+    struct adsp_hdlr_event_ctl *event_ctl = (struct adsp_hdlr_event_ctl *)value;
+    struct listnode *node, *tempnode;
 
-    pthread_mutex_lock(&adsp_hdlr_inst->event_wait_lock);
-    list_add_tail(&adsp_hdlr_inst->event_wait_cmd_list, &cmd->list);
-    pthread_cond_signal(&adsp_hdlr_inst->event_wait_cond);
-    pthread_mutex_unlock(&adsp_hdlr_inst->event_wait_lock);
+    list_for_each_safe(node, tempnode, &event_ctl->event_list) {
+        list_remove(node);
+        free(node_to_item(node, struct adsp_hdlr_event_info, list));
+    }
+    pthread_mutex_destroy(&event_ctl->lock);
+    free(event_ctl);
+    return true;
+}
 
-    return 0;
+static struct adsp_hdlr_event_ctl *get_event_ctl_l(struct adsp_hdlr_inst *adsp_hdlr_inst,
+                                                   const char *name,
+                                                   struct mixer_ctl *ctl)
+{
+    struct adsp_hdlr_event_ctl *event_ctl;
+
+    event_ctl = hashmapGet(adsp_hdlr_inst->event_ctls, (void *)name);
+    if (event_ctl || !ctl)
+        return event_ctl;
+
+    event_ctl = (struct adsp_hdlr_event_ctl *)calloc(1,
+                                   sizeof(struct adsp_hdlr_event_ctl));
+    if (!event_ctl)
+        return NULL;
+
+    strlcpy(event_ctl->name, name, sizeof(event_ctl->name));
+    event_ctl->ctl = ctl;
+    event_ctl->worker = &adsp_hdlr_inst->workers[adsp_hdlr_inst->num_event_ctls %
+                                                 NUM_EVENT_WORKERS];
+    pthread_mutex_init(&event_ctl->lock, (const pthread_mutexattr_t *) NULL);
+    list_init(&event_ctl->event_list);
+
+    errno = 0;
+    if (!hashmapPut(adsp_hdlr_inst->event_ctls, event_ctl->name, event_ctl) &&
+            errno == ENOMEM) {
+        pthread_mutex_destroy(&event_ctl->lock);
+        free(event_ctl);
+        return NULL;
+    }
+    adsp_hdlr_inst->num_event_ctls++;
+    return event_ctl;
 }
 
-static int send_cmd_event_callback_thread(struct adsp_hdlr_inst *adsp_hdlr_inst,
-                                          int opcode, char *mixer_ctl_name)
+static int send_cmd_event_callback_thread(struct adsp_hdlr_event_ctl *event_ctl)
 {
+    struct adsp_hdlr_worker *worker = event_ctl->worker;
     struct event_cmd *cmd = calloc(1, sizeof(*cmd));
 
     if (!cmd) {
-        ALOGE("Failed to allocate mem for command 0x%x", opcode);
+        ALOGE("Failed to allocate mem for event of %s", event_ctl->name);
         return -ENOMEM;
     }
 
-    ALOGVV("%s opcode %d, name = %s", __func__, opcode, mixer_ctl_name);
+    ALOGVV("%s name = %s", __func__, event_ctl->name);
 
-    cmd->opcode = opcode;
-    if (mixer_ctl_name)
-        strlcpy(cmd->cb_mixer_ctl_name, mixer_ctl_name, SNDRV_CTL_ELEM_ID_NAME_MAXLEN);
+    cmd->event_ctl = event_ctl;
 
-    pthread_mutex_lock(&adsp_hdlr_inst->event_callback_lock);
-    list_add_tail(&adsp_hdlr_inst->event_callback_cmd_list, &cmd->list);
-    pthread_cond_signal(&adsp_hdlr_inst->event_callback_cond);
-    pthread_mutex_unlock(&adsp_hdlr_inst->event_callback_lock);
+    pthread_mutex_lock(&worker->lock);
+    list_add_tail(&worker->cmd_list, &cmd->list);
+    pthread_cond_signal(&worker->cond);
+    pthread_mutex_unlock(&worker->lock);
 
     return 0;
 }
 
-static void create_event_wait_thread(struct adsp_hdlr_inst *adsp_hdlr_inst)
+static int subscribe_events_l(struct adsp_hdlr_inst *adsp_hdlr_inst, bool subscribe)
 {
-    pthread_cond_init(&adsp_hdlr_inst->event_wait_cond,
-                        (const pthread_condattr_t *) NULL);
-    list_init(&adsp_hdlr_inst->event_wait_cmd_list);
-    pthread_create(&adsp_hdlr_inst->event_wait_thread, (const pthread_attr_t *) NULL,
-                    event_wait_thread_loop, adsp_hdlr_inst);
-    adsp_hdlr_inst->event_wait_thread_active = true;
+    int ret = 0;
+
+    if (adsp_hdlr_inst->subscribed == subscribe)
+        return 0;
+
+    ret = mixer_subscribe_events(adsp_hdlr_inst->mixer, subscribe ? 1 : 0);
+    if (ret < 0) {
+        ALOGE("%s: Could not %s for mixer events, ret %d", __func__,
+              subscribe ? "subscribe" : "un-subscribe", ret);
+        return ret;
+    }
+    adsp_hdlr_inst->subscribed = subscribe;
+    return 0;
 }
 
-static void create_event_callback_thread(struct adsp_hdlr_inst *adsp_hdlr_inst)
+static void destroy_event_callback_thread(struct adsp_hdlr_worker *worker)
 {
-    pthread_cond_init(&adsp_hdlr_inst->event_callback_cond,
-                      (const pthread_condattr_t *) NULL);
-    list_init(&adsp_hdlr_inst->event_callback_cmd_list);
-    pthread_create(&adsp_hdlr_inst->event_callback_thread, (const pthread_attr_t *) NULL,
-                   event_callback_thread_loop, adsp_hdlr_inst);
-    adsp_hdlr_inst->event_callback_thread_active = true;
+    struct listnode *node, *tempnode;
+
+    pthread_mutex_lock(&worker->lock);
+    worker->exit = true;
+    pthread_cond_signal(&worker->cond);
+    pthread_mutex_unlock(&worker->lock);
+    pthread_join(worker->thread, (void **) NULL);
+
+    list_for_each_safe(node, tempnode, &worker->cmd_list) {
+        list_remove(node);
+        free(node_to_item(node, struct event_cmd, list));
+    }
+    pthread_cond_destroy(&worker->cond);
+    pthread_mutex_destroy(&worker->lock);
 }
 
-static void destroy_event_wait_thread(struct adsp_hdlr_inst *adsp_hdlr_inst)
+static int create_event_callback_thread(struct adsp_hdlr_worker *worker)
 {
-    send_cmd_event_wait_thread(adsp_hdlr_inst, EVENT_CMD_EXIT);
-    pthread_join(adsp_hdlr_inst->event_wait_thread, (void **) NULL);
-
-    pthread_mutex_lock(&adsp_hdlr_inst->event_wait_lock);
-    pthread_cond_destroy(&adsp_hdlr_inst->event_wait_cond);
-    adsp_hdlr_inst->event_wait_thread_active = false;
-    pthread_mutex_unlock(&adsp_hdlr_inst->event_wait_lock);
+    int ret;
+
+    pthread_mutex_init(&worker->lock, (const pthread_mutexattr_t *) NULL);
+    pthread_cond_init(&worker->cond, (const pthread_condattr_t *) NULL);
+    list_init(&worker->cmd_list);
+    worker->exit = false;
+    ret = pthread_create(&worker->thread, (const pthread_attr_t *) NULL,
+                         event_callback_thread_loop, worker);
+    if (ret) {
+        pthread_cond_destroy(&worker->cond);
+        pthread_mutex_destroy(&worker->lock);
+        return -ret;
+    }
+    return 0;
 }
 
-static void destroy_event_callback_thread(struct adsp_hdlr_inst *adsp_hdlr_inst)
+static int create_event_threads_l(struct adsp_hdlr_inst *adsp_hdlr_inst)
 {
-    send_cmd_event_callback_thread(adsp_hdlr_inst, EVENT_CMD_EXIT, NULL);
-    pthread_join(adsp_hdlr_inst->event_callback_thread, (void **) NULL);
+    int i, ret = 0;
+
+    if (adsp_hdlr_inst->threads_active)
+        return 0;
+
+    for (i = 0; i < NUM_EVENT_WORKERS; i++) {
+        ret = create_event_callback_thread(&adsp_hdlr_inst->workers[i]);
+        if (ret)
+            goto fail;
+    }
+
+    adsp_hdlr_inst->exit = false;
+    ret = -pthread_create(&adsp_hdlr_inst->event_wait_thread,
+                          (const pthread_attr_t *) NULL,
+                          event_wait_thread_loop, adsp_hdlr_inst);
+    if (ret)
+        goto fail;
+
+    adsp_hdlr_inst->threads_active = true;
+    return 0;
 
-    pthread_mutex_lock(&adsp_hdlr_inst->event_callback_lock);
-    pthread_cond_destroy(&adsp_hdlr_inst->event_callback_cond);
-    adsp_hdlr_inst->event_callback_thread_active = false;
-    pthread_mutex_unlock(&adsp_hdlr_inst->event_callback_lock);
+fail:
+    ALOGE("%s: Could not create event threads, ret %d", __func__, ret);
+    while (i-- > 0)
+        destroy_event_callback_thread(&adsp_hdlr_inst->workers[i]);
+    return ret;
 }
 
 static void destroy_event_threads(struct adsp_hdlr_inst *adsp_hdlr_inst)
 {
-    if (adsp_hdlr_inst->event_wait_thread_active)
-        destroy_event_wait_thread(adsp_hdlr_inst);
-    if (adsp_hdlr_inst->event_callback_thread_active)
-        destroy_event_callback_thread(adsp_hdlr_inst);
+    int i;
+
+    pthread_mutex_lock(&adsp_hdlr_inst->lock);
+    if (!adsp_hdlr_inst->threads_active) {
+        pthread_mutex_unlock(&adsp_hdlr_inst->lock);
+        return;
+    }
+    adsp_hdlr_inst->exit = true;
+    pthread_cond_signal(&adsp_hdlr_inst->event_wait_cond);
+    pthread_mutex_unlock(&adsp_hdlr_inst->lock);
+    pthread_join(adsp_hdlr_inst->event_wait_thread, (void **) NULL);
+
+    for (i = 0; i < NUM_EVENT_WORKERS; i++)
+        destroy_event_callback_thread(&adsp_hdlr_inst->workers[i]);
+    adsp_hdlr_inst->threads_active = false;
 }
 
 static void *event_wait_thread_loop(void *context)
 {
     int ret = 0;
-    int opcode = 0;
-    bool wait = false;
     struct adsp_hdlr_inst *adsp_hdlr_inst =
                         (struct adsp_hdlr_inst *) context;
-    struct event_cmd *cmd;
-    struct listnode *node, *tempnode;
+    struct adsp_hdlr_event_ctl *event_ctl;
     struct snd_ctl_event mixer_event = {0};
 
     setpriority(PRIO_PROCESS, 0, ANDROID_PRIORITY_AUDIO);
     set_sched_policy(0, SP_BACKGROUND);
     prctl(PR_SET_NAME, (unsigned long)"Event Wait", 0, 0, 0);
 
-    ret = mixer_subscribe_events(adsp_hdlr_inst->mixer, 1);
-    if (ret < 0) {
-        ALOGE("%s: Could not subscribe for mixer events, ret %d",
-              __func__, ret);
-        goto done;
-    }
-
-    pthread_mutex_lock(&adsp_hdlr_inst->event_wait_lock);
-    while (1) {
-        if (list_empty(&adsp_hdlr_inst->event_wait_cmd_list) && !wait) {
+    pthread_mutex_lock(&adsp_hdlr_inst->lock);
+    while (!adsp_hdlr_inst->exit) {
+        if (adsp_hdlr_inst->num_events == 0 || !adsp_hdlr_inst->subscribed) {
+            subscribe_events_l(adsp_hdlr_inst, false);
             ALOGVV("%s SLEEPING", __func__);
-            pthread_cond_wait(&adsp_hdlr_inst->event_wait_cond, &adsp_hdlr_inst->event_wait_lock);
+            pthread_cond_wait(&adsp_hdlr_inst->event_wait_cond, &adsp_hdlr_inst->lock);
             ALOGVV("%s RUNNING", __func__);
+            continue;
         }
-        /* execute command if available */
-        if (!list_empty(&adsp_hdlr_inst->event_wait_cmd_list)) {
-            node = list_head(&adsp_hdlr_inst->event_wait_cmd_list);
-            list_remove(node);
-            pthread_mutex_unlock(&adsp_hdlr_inst->event_wait_lock);
-            cmd = node_to_item(node, struct event_cmd, list);
-            opcode = cmd->opcode;
-       /* wait if no command avialable */
-       } else if (wait)
-           opcode = EVENT_CMD_WAIT;
-       /* check que again and sleep if needed */
-       else
-           continue;
-
-        ALOGVV("%s command received: %d", __func__, opcode);
-        switch(opcode) {
-        case EVENT_CMD_EXIT:
-            free(cmd);
-            goto thread_exit;
-        case EVENT_CMD_WAIT:
-            ret = mixer_wait_event(adsp_hdlr_inst->mixer, WAIT_EVENT_POLL_TIMEOUT);
-            ALOGVV("%s: mixer_wait_event unblocked!, ret = %d", __func__, ret);
-            if (ret < 0) {
-                ALOGE("%s: mixer_wait_event err!, ret = %d", __func__, ret);
-            } else if (ret > 0) {
-                ret = mixer_read(adsp_hdlr_inst->mixer, &mixer_event);
-                if (ret >= 0)
-                    send_cmd_event_callback_thread(adsp_hdlr_inst, EVENT_CMD_GET, mixer_event.data.elem.id.name);
-                else
-                    ALOGE("%s: mixer_read failed, ret = %d", __func__, ret);
+        pthread_mutex_unlock(&adsp_hdlr_inst->lock);
+
+        ret = mixer_wait_event(adsp_hdlr_inst->mixer, WAIT_EVENT_POLL_TIMEOUT);
+        ALOGVV("%s: mixer_wait_event unblocked!, ret = %d", __func__, ret);
+        if (ret < 0) {
+            ALOGE("%s: mixer_wait_event err!, ret = %d", __func__, ret);
+            usleep(WAIT_EVENT_POLL_TIMEOUT * 1000);
+        } else if (ret > 0) {
+            ret = mixer_read(adsp_hdlr_inst->mixer, &mixer_event);
+            if (ret >= 0) {
+                pthread_mutex_lock(&adsp_hdlr_inst->lock);
+                event_ctl = get_event_ctl_l(adsp_hdlr_inst,
+                                            (const char *)mixer_event.data.elem.id.name,
+                                            NULL);
+                if (event_ctl)
+                    send_cmd_event_callback_thread(event_ctl);
+                pthread_mutex_unlock(&adsp_hdlr_inst->lock);
+            } else {
+                ALOGE("%s: mixer_read failed, ret = %d", __func__, ret);
             }
-            /* Once wait command has been sent continue to wait for
-               events unless something else is in the command que */
-            wait = true;
-            break;
-        default:
-            ALOGE("%s unknown command received: %d", __func__, opcode);
-            break;
         }
+        pthread_mutex_lock(&adsp_hdlr_inst->lock);
+    }
+    subscribe_events_l(adsp_hdlr_inst, false);
+    pthread_mutex_unlock(&adsp_hdlr_inst->lock);
 
-        if (cmd != NULL) {
-            free(cmd);
-            cmd = NULL;
-        }
+    return NULL;
+}
+
+static void deliver_event(struct adsp_hdlr_event_ctl *event_ctl)
+{
+    int ret = 0;
+    size_t count = 0;
+    uint8_t param[MAX_EVENT_PAYLOAD] = {0};
+    struct listnode *node;
+    struct adsp_hdlr_event_info *event_info;
+    struct adsp_hdlr_stream_data *stream_data;
+    struct msm_adsp_event_data *received_evt = (struct msm_adsp_event_data *)param;
+
+    pthread_mutex_lock(&event_ctl->lock);
+    /* all events of the control may have been deregistered since */
+    if (list_empty(&event_ctl->event_list))
+        goto exit;
+
+    mixer_ctl_update(event_ctl->ctl);
+    count = mixer_ctl_get_num_values(event_ctl->ctl);
+    if ((count > MAX_EVENT_PAYLOAD) || (count <= 0)) {
+        ALOGE("%s: count is %d greater than allowed for %s mixer cmd",
+              __func__, count, event_ctl->name);
+        goto exit;
     }
-thread_exit:
-    ret = mixer_subscribe_events(adsp_hdlr_inst->mixer, 0);
+    ret = mixer_ctl_get_array(event_ctl->ctl, param, count);
     if (ret < 0) {
-        ALOGE("%s: Could not un-subscribe for mixer events, ret %d",
-              __func__, ret);
-        goto done;
+        ALOGE("%s: mixer_ctl_get_array failed! mixer - %s, ret = %d",
+              __func__, event_ctl->name, ret);
+        goto exit;
     }
-    pthread_mutex_lock(&adsp_hdlr_inst->event_wait_lock);
-    list_for_each_safe(node, tempnode, &adsp_hdlr_inst->event_wait_cmd_list) {
-        list_remove(node);
-        free(node);
+    ALOGD("%s: event type = %d", __func__, received_evt->event_type);
+
+    /* Call appropriate event type client callback */
+    list_for_each(node, &event_ctl->event_list) {
+        event_info = node_to_item(node, struct adsp_hdlr_event_info, list);
+        if (event_info->event_type != received_evt->event_type)
+            continue;
+
+        stream_data = event_info->stream_handle;
+        if (event_info->cb != NULL) {
+            ALOGVV("%s: calling event callback function", __func__);
+            event_info->cb(event_info->stream_handle,
+                           received_evt->payload,
+                           event_info->cookie);
+        } else if (stream_data->client_callback != NULL) {
+            ALOGVV("%s: sending client callback event %d", __func__,
+                   AUDIO_EXTN_STREAM_CBK_EVENT_ADSP);
+            stream_data->client_callback((stream_callback_event_t)
+                                         AUDIO_EXTN_STREAM_CBK_EVENT_ADSP,
+                                         received_evt,
+                                         stream_data->client_cookie);
+        }
+        break;
     }
-    pthread_mutex_unlock(&adsp_hdlr_inst->event_wait_lock);
-done:
-    return NULL;
+exit:
+    pthread_mutex_unlock(&event_ctl->lock);
 }
 
 static void *event_callback_thread_loop(void *context)
 {
-    int ret = 0;
-    size_t count = 0;
-    struct adsp_hdlr_inst *adsp_hdlr_inst =
-                            (struct adsp_hdlr_inst *)context;
-    struct mixer_ctl *ctl = NULL;
-    uint8_t param[MAX_EVENT_PAYLOAD] = {0};
+    struct adsp_hdlr_worker *worker = (struct adsp_hdlr_worker *)context;
     struct event_cmd *cmd;
-    struct listnode *node, *tempnode;
-    struct adsp_hdlr_event_info *event_info;
-    bool param_avail = false;
-    struct msm_adsp_event_data *received_evt;
+    struct listnode *node;
 
     setpriority(PRIO_PROCESS, 0, ANDROID_PRIORITY_AUDIO);
     set_sched_policy(0, SP_BACKGROUND);
     prctl(PR_SET_NAME, (unsigned long)"Event Callback", 0, 0, 0);
 
-    pthread_mutex_lock(&adsp_hdlr_inst->event_callback_lock);
-    while (1) {
-        if (list_empty(&adsp_hdlr_inst->event_callback_cmd_list)) {
+    pthread_mutex_lock(&worker->lock);
+    while (!worker->exit) {
+        if (list_empty(&worker->cmd_list)) {
             ALOGVV("%s SLEEPING", __func__);
-            pthread_cond_wait(&adsp_hdlr_inst->event_callback_cond,
-                              &adsp_hdlr_inst->event_callback_lock);
+            pthread_cond_wait(&worker->cond, &worker->lock);
             ALOGVV("%s RUNNING", __func__);
             continue;
         }
-        node = list_head(&adsp_hdlr_inst->event_callback_cmd_list);
+        node = list_head(&worker->cmd_list);
         list_remove(node);
-        pthread_mutex_unlock(&adsp_hdlr_inst->event_callback_lock);
-        cmd = node_to_item(node, struct event_cmd, list);
-
-        ALOGVV("%s command received: %d", __func__, cmd->opcode);
-        switch(cmd->opcode) {
-        case EVENT_CMD_EXIT:
-            free(cmd);
-            goto thread_exit;
-        case EVENT_CMD_GET:
-            param_avail = false;
-            pthread_mutex_lock(&adsp_hdlr_inst->event_list_lock);
-            /* Find the mixer control for which event is triggered */
-            list_for_each(node, &adsp_hdlr_inst->event_list) {
-                event_info = node_to_item(node, struct adsp_hdlr_event_info, list);
-                ALOGVV("%s: cmd mixer name: %s, event list mixer name: %s", __func__,
-                       cmd->cb_mixer_ctl_name, event_info->cb_mixer_ctl_name);
-                if (!strcmp(cmd->cb_mixer_ctl_name, event_info->cb_mixer_ctl_name)) {
-                    if (!param_avail) {
-                        ctl = mixer_get_ctl_by_name(adsp_hdlr_inst->mixer, cmd->cb_mixer_ctl_name);
-                        if (!ctl) {
-                            ALOGE("%s: Could not get ctl for mixer cmd - %s", __func__,
-                                  cmd->cb_mixer_ctl_name);
-                            break;
-                        }
-                        mixer_ctl_update(ctl);
-                        count = mixer_ctl_get_num_values(ctl);
-                        if ((count > MAX_EVENT_PAYLOAD) || (count <= 0)) {
-                            ALOGE("%s: count is %d greater than allowed for %s mixer cmd",
-                                  __func__, count, cmd->cb_mixer_ctl_name);
-                            break;
-                        }
-                        ret = mixer_ctl_get_array(ctl, param, count);
-                        if (ret < 0) {
-                            ALOGE("%s: mixer_ctl_get_array failed! mixer - %s, ret = %d",
-                                  __func__, cmd->cb_mixer_ctl_name, ret);
-                            break;
-                        }
-                        param_avail = true;
-                        received_evt = (struct msm_adsp_event_data *)param;
-                        ALOGD("%s: event type = %d", __func__, received_evt->event_type);
-                    }
-                    /* Call appropriate event type client callback */
-                    if (param_avail && event_info->event_type == received_evt->event_type) {
-                        struct adsp_hdlr_stream_data *stream_data = event_info->stream_handle;
-                        if (event_info->cb != NULL) {
-                            ALOGVV("%s: calling event callback function", __func__);
-                            event_info->cb(event_info->stream_handle,
-                                           received_evt->payload,
-                                           event_info->cookie);
-                        } else if (stream_data->client_callback != NULL) {
-                            ALOGVV("%s: sending client callback event %d", __func__,
-                                   AUDIO_EXTN_STREAM_CBK_EVENT_ADSP);
-                            stream_data->client_callback((stream_callback_event_t)
-                                                         AUDIO_EXTN_STREAM_CBK_EVENT_ADSP,
-                                                         received_evt,
-                                                         stream_data->client_cookie);
-                        }
-                        break;
-                    }
-                }
-            }
-            pthread_mutex_unlock(&adsp_hdlr_inst->event_list_lock);
+        pthread_mutex_unlock(&worker->lock);
 
-        break;
-        default:
-            ALOGE("%s unknown command received: %d", __func__, cmd->opcode);
-            break;
-        }
+        cmd = node_to_item(node, struct event_cmd, list);
+        deliver_event(cmd->event_ctl);
         free(cmd);
+
+        pthread_mutex_lock(&worker->lock);
     }
-thread_exit:
-    pthread_mutex_lock(&adsp_hdlr_inst->event_callback_lock);
-    list_for_each_safe(node, tempnode, &adsp_hdlr_inst->event_callback_cmd_list) {
-        list_remove(node);
-        free(node);
-    }
-    pthread_mutex_unlock(&adsp_hdlr_inst->event_callback_lock);
-done:
+    pthread_mutex_unlock(&worker->lock);
+
     return NULL;
 }
 
-int audio_extn_adsp_hdlr_stream_deregister_event(void *handle, void *data)
+struct deregister_context {
+    struct adsp_hdlr_stream_data *stream_data;
+    struct audio_adsp_event *param;
+    unsigned int removed;
+};
+
+static bool deregister_stream_events(void *key __unused, void *value, void *context)
 {
+    struct adsp_hdlr_event_ctl *event_ctl = (struct adsp_hdlr_event_ctl *)value;
+    struct deregister_context *dereg = (struct deregister_context *)context;
     struct listnode *node, *tempnode;
-    struct adsp_hdlr_stream_data *stream_data = (struct adsp_hdlr_stream_data *)handle;
     struct adsp_hdlr_event_info *event_info;
-    struct audio_adsp_event *param = (struct audio_adsp_event *)data;
+
+    pthread_mutex_lock(&event_ctl->lock);
+    list_for_each_safe(node, tempnode, &event_ctl->event_list) {
+        event_info = node_to_item(node, struct adsp_hdlr_event_info, list);
+        if (event_info->stream_handle != dereg->stream_data)
+            continue;
+        /* if the type of event is avaliable to dereg then dereg only that event */
+        if (dereg->param && event_info->event_type != dereg->param->event_type)
+            continue;
+
+        ALOGD("%s: Deregister event type = %d", __func__, event_info->event_type);
+        list_remove(node);
+        free(event_info);
+        dereg->removed++;
+    }
+    pthread_mutex_unlock(&event_ctl->lock);
+    return true;
+}
+
+int audio_extn_adsp_hdlr_stream_deregister_event(void *handle, void *data)
+{
+    struct deregister_context dereg;
 
     if (!handle) {
         ALOGE("%s: Invalid handle", __func__);
         return -EINVAL;
     }
 
-    pthread_mutex_lock(&adsp_hdlr_inst->event_list_lock);
-    if (list_empty(&adsp_hdlr_inst->event_list)) {
+    pthread_mutex_lock(&adsp_hdlr_inst->lock);
+    if (adsp_hdlr_inst->num_events == 0) {
         ALOGD("%s: event list is empty", __func__);
-        pthread_mutex_unlock(&adsp_hdlr_inst->event_list_lock);
+        pthread_mutex_unlock(&adsp_hdlr_inst->lock);
         return 0;
     }
-    list_for_each_safe(node, tempnode, &adsp_hdlr_inst->event_list) {
-        event_info = node_to_item(node, struct adsp_hdlr_event_info, list);
-        if (param && event_info->stream_handle == stream_data) {
-            /* if the type of event is avaliable to dereg then dereg only that event */
-            if (event_info->event_type == param->event_type) {
-                ALOGD("%s: Deregister event type = %d", __func__, event_info->event_type);
-                list_remove(node);
-                free(event_info);
-            }
-        } else if (event_info->stream_handle == stream_data) {
-            /* Dereg all the events related to that stream */
-            ALOGD("%s: Deregister all stream events", __func__);
-            list_remove(node);
-            free(event_info);
-        }
-    }
-    pthread_mutex_unlock(&adsp_hdlr_inst->event_list_lock);
-
-    if (list_empty(&adsp_hdlr_inst->event_list)) {
-        ALOGD("%s: Closing event threads", __func__);
-        destroy_event_threads(adsp_hdlr_inst);
-        pthread_mutex_destroy(&adsp_hdlr_inst->event_wait_lock);
-        pthread_mutex_destroy(&adsp_hdlr_inst->event_callback_lock);
-        pthread_mutex_destroy(&adsp_hdlr_inst->event_list_lock);
-    }
+    dereg.stream_data = (struct adsp_hdlr_stream_data *)handle;
+    dereg.param = (struct audio_adsp_event *)data;
+    dereg.removed = 0;
+    hashmapForEach(adsp_hdlr_inst->event_ctls, deregister_stream_events, &dereg);
+    adsp_hdlr_inst->num_events -= dereg.removed;
+    pthread_mutex_unlock(&adsp_hdlr_inst->lock);
 
     return 0;
 }
@@ -463,9 +516,11 @@ int audio_extn_adsp_hdlr_stream_register_event(void *handle, void *data,
     char mixer_ctl_name[MIXER_PATH_MAX_LENGTH] = {0};
     char cb_mixer_ctl_name[MIXER_PATH_MAX_LENGTH] = {0};
     struct mixer_ctl *ctl = NULL;
+    struct mixer_ctl *cb_ctl = NULL;
     uint8_t payload[AUDIO_MAX_ADSP_STREAM_CMD_PAYLOAD_LEN] = {0};
     struct adsp_hdlr_stream_data *stream_data = (struct adsp_hdlr_stream_data *)handle;
     struct adsp_hdlr_stream_cfg *config = &stream_data->config;
+    struct adsp_hdlr_event_ctl *event_ctl;
     struct adsp_hdlr_event_info *event_info;
     struct audio_adsp_event *param = (struct audio_adsp_event *)data;
 
@@ -494,9 +549,9 @@ int audio_extn_adsp_hdlr_stream_register_event(void *handle, void *data,
         goto done;
     }
 
-    ctl = mixer_get_ctl_by_name(adsp_hdlr_inst->mixer, cb_mixer_ctl_name);
+    cb_ctl = mixer_get_ctl_by_name(adsp_hdlr_inst->mixer, cb_mixer_ctl_name);
 
-    if (!ctl) {
+    if (!cb_ctl) {
         ALOGE("%s: Could not get ctl for mixer cmd - %s", __func__,
               cb_mixer_ctl_name);
         ret = -EINVAL;
@@ -525,6 +580,48 @@ int audio_extn_adsp_hdlr_stream_register_event(void *handle, void *data,
         goto done;
     }
 
+    event_info = (struct adsp_hdlr_event_info *) calloc(1,
+                                   sizeof(struct adsp_hdlr_event_info));
+    if (event_info == NULL) {
+        ret = -ENOMEM;
+        goto done;
+    }
+
+    event_info->event_type = param->event_type;
+    event_info->cb = cb;
+    event_info->cookie = cookie;
+    event_info->stream_handle = stream_data;
+
+    /*
+     * Register before sending the command, so that an event the DSP raises
+     * in response to it is not missed.
+     */
+    pthread_mutex_lock(&adsp_hdlr_inst->lock);
+    /* create event threads during first event registration */
+    ret = create_event_threads_l(adsp_hdlr_inst);
+    if (ret == 0)
+        ret = subscribe_events_l(adsp_hdlr_inst, true);
+    if (ret < 0) {
+        pthread_mutex_unlock(&adsp_hdlr_inst->lock);
+        free(event_info);
+        goto done;
+    }
+    event_ctl = get_event_ctl_l(adsp_hdlr_inst, cb_mixer_ctl_name, cb_ctl);
+    if (event_ctl == NULL) {
+        pthread_mutex_unlock(&adsp_hdlr_inst->lock);
+        free(event_info);
+        ret = -ENOMEM;
+        goto done;
+    }
+    pthread_mutex_lock(&event_ctl->lock);
+    list_add_tail(&event_ctl->event_list, &event_info->list);
+    pthread_mutex_unlock(&event_ctl->lock);
+    adsp_hdlr_inst->num_events++;
+    pthread_cond_signal(&adsp_hdlr_inst->event_wait_cond);
+    ALOGD("%s: event_info type %d added to %s", __func__, event_info->event_type,
+          cb_mixer_ctl_name);
+    pthread_mutex_unlock(&adsp_hdlr_inst->lock);
+
     ALOGD("%s: event = %d, payload_length %d", __func__, param->event_type, param->payload_length);
 
     /* copy event_type, payload size and payload */
@@ -540,51 +637,16 @@ int audio_extn_adsp_hdlr_stream_register_event(void *handle, void *data,
     if (ret < 0) {
         ALOGE("%s: Could not set ctl for mixer cmd - %s, ret %d", __func__,
               mixer_ctl_name, ret);
+        pthread_mutex_lock(&adsp_hdlr_inst->lock);
+        pthread_mutex_lock(&event_ctl->lock);
+        list_remove(&event_info->list);
+        free(event_info);
+        pthread_mutex_unlock(&event_ctl->lock);
+        adsp_hdlr_inst->num_events--;
+        pthread_mutex_unlock(&adsp_hdlr_inst->lock);
         goto done;
     }
 
-    if (list_empty(&adsp_hdlr_inst->event_list)) {
-        pthread_mutex_init(&adsp_hdlr_inst->event_wait_lock,
-                           (const pthread_mutexattr_t *) NULL);
-        pthread_mutex_init(&adsp_hdlr_inst->event_callback_lock,
-                           (const pthread_mutexattr_t *) NULL);
-        pthread_mutex_init(&adsp_hdlr_inst->event_list_lock,
-                           (const pthread_mutexattr_t *) NULL);
-
-        /* create event threads during first event registration */
-        pthread_mutex_lock(&adsp_hdlr_inst->event_wait_lock);
-
-        if (!adsp_hdlr_inst->event_wait_thread_active)
-            create_event_wait_thread(adsp_hdlr_inst);
-
-        pthread_mutex_unlock(&adsp_hdlr_inst->event_wait_lock);
-        pthread_mutex_lock(&adsp_hdlr_inst->event_callback_lock);
-
-        if (!adsp_hdlr_inst->event_callback_thread_active)
-            create_event_callback_thread(adsp_hdlr_inst);
-
-        pthread_mutex_unlock(&adsp_hdlr_inst->event_callback_lock);
-        send_cmd_event_wait_thread(adsp_hdlr_inst, EVENT_CMD_WAIT);
-    }
-
-    event_info = (struct adsp_hdlr_event_info *) calloc(1,
-                                   sizeof(struct adsp_hdlr_event_info));
-    if (event_info == NULL) {
-        ret = -ENOMEM;
-        goto done;
-    }
-
-    event_info->event_type = param->event_type;
-    event_info->cb = cb;
-    event_info->cookie = cookie;
-    event_info->stream_handle = stream_data;
-    strlcpy(event_info->mixer_ctl_name, mixer_ctl_name, SNDRV_CTL_ELEM_ID_NAME_MAXLEN);
-    strlcpy(event_info->cb_mixer_ctl_name, cb_mixer_ctl_name, SNDRV_CTL_ELEM_ID_NAME_MAXLEN);
-    pthread_mutex_lock(&adsp_hdlr_inst->event_list_lock);
-    list_add_tail(&adsp_hdlr_inst->event_list, &event_info->list);
-    ALOGD("%s: event_info type %d added from the list", __func__, event_info->event_type);
-    pthread_mutex_unlock(&adsp_hdlr_inst->event_list_lock);
-
 done:
     return ret;
 }
@@ -714,8 +776,18 @@ int audio_extn_adsp_hdlr_init(struct mixer *mixer)
         ALOGE("%s: calloc failed for adsp_hdlr_inst", __func__);
         return -EINVAL;
     }
+    adsp_hdlr_inst->event_ctls = hashmapCreate(EVENT_CTL_MAP_SIZE, event_ctl_hash,
+                                               event_ctl_equals);
+    if (!adsp_hdlr_inst->event_ctls) {
+        ALOGE("%s: hashmapCreate failed for event controls", __func__);
+        free(adsp_hdlr_inst);
+        adsp_hdlr_inst = NULL;
+        return -ENOMEM;
+    }
     adsp_hdlr_inst->mixer = mixer;
-    list_init(&adsp_hdlr_inst->event_list);
+    pthread_mutex_init(&adsp_hdlr_inst->lock, (const pthread_mutexattr_t *) NULL);
+    pthread_cond_init(&adsp_hdlr_inst->event_wait_cond,
+                      (const pthread_condattr_t *) NULL);
 
     return 0;
 }
@@ -723,6 +795,11 @@ int audio_extn_adsp_hdlr_init(struct mixer *mixer)
 int audio_extn_adsp_hdlr_deinit(void)
 {
     if (adsp_hdlr_inst) {
+        destroy_event_threads(adsp_hdlr_inst);
+        hashmapForEach(adsp_hdlr_inst->event_ctls, free_event_ctl, NULL);
+        hashmapFree(adsp_hdlr_inst->event_ctls);
+        pthread_cond_destroy(&adsp_hdlr_inst->event_wait_cond);
+        pthread_mutex_destroy(&adsp_hdlr_inst->lock);
         free(adsp_hdlr_inst);
         adsp_hdlr_inst = NULL;
     } else {
@@ -730,4 +807,3 @@ int audio_extn_adsp_hdlr_deinit(void)
     }
     return 0;
 }
-
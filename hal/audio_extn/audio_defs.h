@@ -255,6 +255,28 @@ struct audio_out_presentation_position_param {
     int32_t clock_id;
 };
 
+#define AUDIO_IN_FRAME_INFO_MAX_FRAMES 16
+
+/* frame descriptor flags */
+#define AUDIO_IN_FRAME_FLAG_TIMESTAMP     (1 << 0) /* timestamp is valid */
+#define AUDIO_IN_FRAME_FLAG_DISCONTINUITY (1 << 1) /* a read failed before this frame */
+
+struct audio_in_frame_desc {
+    uint64_t seq;       /* read sequence number of the stream */
+    uint64_t timestamp; /* capture timestamp in us */
+    uint32_t size;      /* payload bytes, metadata excluded */
+    uint32_t flags;
+};
+
+/* payload format for HAL parameter
+ * AUDIO_EXTN_PARAM_IN_FRAME_INFO
+ */
+struct audio_in_frame_info_param {
+    uint32_t num_frames; /* descriptors returned, oldest first */
+    uint32_t dropped;    /* descriptors overwritten since the last query */
+    struct audio_in_frame_desc frames[AUDIO_IN_FRAME_INFO_MAX_FRAMES];
+};
+
 typedef struct mix_matrix_params {
     uint16_t num_output_channels;
     uint16_t num_input_channels;
@@ -289,6 +311,7 @@ typedef union {
     struct mix_matrix_params mm_params;
     struct audio_license_params license_params;
     struct audio_out_presentation_position_param pos_param;
+    struct audio_in_frame_info_param in_frame_info;
 } audio_extn_param_payload;
 
 typedef enum {
@@ -313,6 +336,8 @@ typedef enum {
     /* License information */
     AUDIO_EXTN_PARAM_LICENSE_PARAMS,
     AUDIO_EXTN_PARAM_OUT_PRESENTATION_POSITION,
+    /* capture frame descriptors, same value as QAHW_PARAM_IN_FRAME_INFO */
+    AUDIO_EXTN_PARAM_IN_FRAME_INFO = 18,
 } audio_extn_param_id;
 
 typedef union {
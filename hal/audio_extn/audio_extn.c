@@ -110,6 +110,8 @@ void cin_free_input_stream_resources(struct stream_in *in);
 int cin_read(struct stream_in *in, void *buffer,
                         size_t bytes, size_t *bytes_read);
 int cin_configure_input_stream(struct stream_in *in, struct audio_config *in_config);
+int cin_get_frame_info(struct stream_in *in,
+                       struct audio_in_frame_info_param *info);
 
 void audio_extn_set_snd_card_split(const char* in_snd_card_name)
 {
@@ -1252,11 +1254,11 @@ void audio_extn_set_anc_parameters(struct audio_device *adev,
         list_for_each(node, &adev->usecase_list) {
             usecase = node_to_item(node, struct audio_usecase, list);
             if (usecase->stream.out && usecase->type != PCM_CAPTURE) {
-                if (is_single_device_type_equal(&usecase->stream.out->device_list,
+                if (device_set_is_single_type(&usecase->stream.out->device_list,
                                 AUDIO_DEVICE_OUT_WIRED_HEADPHONE) ||
-                    is_single_device_type_equal(&usecase->stream.out->device_list,
+                    device_set_is_single_type(&usecase->stream.out->device_list,
                                 AUDIO_DEVICE_OUT_WIRED_HEADSET) ||
-                    is_single_device_type_equal(&usecase->stream.out->device_list,
+                    device_set_is_single_type(&usecase->stream.out->device_list,
                                 AUDIO_DEVICE_OUT_EARPIECE)) {
                         select_devices(adev, usecase->id);
                         ALOGV("%s: switching device completed", __func__);
@@ -1813,6 +1815,9 @@ static spkr_prot_is_enabled_t spkr_prot_is_enabled;
 typedef void (*spkr_prot_calib_cancel_t)(void *);
 static spkr_prot_calib_cancel_t spkr_prot_calib_cancel;
 
+typedef void (*spkr_prot_set_idle_t)(bool);
+static spkr_prot_set_idle_t spkr_prot_set_idle;
+
 typedef void (*spkr_prot_set_parameters_t)(struct str_parms *,
                                            char *, int);
 static spkr_prot_set_parameters_t spkr_prot_set_parameters;
@@ -1868,6 +1873,7 @@ void spkr_prot_feature_init(bool is_feature_enabled)
         spkr_prot_set_parameters = NULL;
         fbsp_set_parameters = NULL;
         fbsp_get_parameters = NULL;
+        spkr_prot_set_idle = NULL;
         if ((spkr_prot_set_parameters =
              (spkr_prot_set_parameters_t)dlsym(spkr_prot_lib_handle, "spkr_prot_set_parameters")) == NULL) {
             ALOGW("%s: dlsym failed for spkr_prot_set_parameters", __func__);
@@ -1883,6 +1889,11 @@ void spkr_prot_feature_init(bool is_feature_enabled)
             ALOGW("%s: dlsym failed for fbsp_get_parameters", __func__);
         }
 
+        if ((spkr_prot_set_idle =
+             (spkr_prot_set_idle_t)dlsym(spkr_prot_lib_handle, "spkr_prot_set_idle")) == NULL) {
+            ALOGW("%s: dlsym failed for spkr_prot_set_idle", __func__);
+        }
+
         ALOGD("%s:: ---- Feature SPKR_PROT is Enabled ----", __func__);
         return;
     }
@@ -1902,6 +1913,7 @@ feature_disabled:
     spkr_prot_set_parameters = NULL;
     fbsp_set_parameters = NULL;
     fbsp_get_parameters = NULL;
+    spkr_prot_set_idle = NULL;
     get_spkr_prot_snd_device = NULL;
 
     ALOGW(":: %s: ---- Feature SPKR_PROT is disabled ----", __func__);
@@ -1990,6 +2002,14 @@ void audio_extn_spkr_prot_set_parameters(struct str_parms *parms,
     return;
 }
 
+void audio_extn_spkr_prot_set_idle(bool idle)
+{
+    if (spkr_prot_set_idle != NULL)
+        spkr_prot_set_idle(idle);
+
+    return;
+}
+
 int audio_extn_fbsp_set_parameters(struct str_parms *parms)
 {
     int ret_val = 0;
@@ -2724,7 +2744,7 @@ typedef int32_t (*ssr_init_t)(struct stream_in *,
                               int num_out_chan);
 static ssr_init_t ssr_init;
 
-typedef int32_t (*ssr_deinit_t)();
+typedef int32_t (*ssr_deinit_t)(struct stream_in *);
 static ssr_deinit_t ssr_deinit;
 
 typedef void (*ssr_update_enabled_t)();
@@ -2747,9 +2767,6 @@ typedef void (*ssr_get_parameters_t)(const struct audio_device *,
                                      struct str_parms *);
 static ssr_get_parameters_t ssr_get_parameters;
 
-typedef struct stream_in *(*ssr_get_stream_t)();
-static ssr_get_stream_t ssr_get_stream;
-
 void ssrec_feature_init(bool is_feature_enabled) {
 
     if (is_feature_enabled) {
@@ -2767,8 +2784,7 @@ void ssrec_feature_init(bool is_feature_enabled) {
             ((ssr_get_enabled = (ssr_get_enabled_t)dlsym(ssrec_lib_handle, "ssr_get_enabled")) == NULL) ||
             ((ssr_read = (ssr_read_t)dlsym(ssrec_lib_handle, "ssr_read")) == NULL) ||
             ((ssr_set_parameters = (ssr_set_parameters_t)dlsym(ssrec_lib_handle, "ssr_set_parameters")) == NULL) ||
-            ((ssr_get_parameters = (ssr_get_parameters_t)dlsym(ssrec_lib_handle, "ssr_get_parameters")) == NULL) ||
-            ((ssr_get_stream = (ssr_get_stream_t)dlsym(ssrec_lib_handle, "ssr_get_stream")) == NULL)) {
+            ((ssr_get_parameters = (ssr_get_parameters_t)dlsym(ssrec_lib_handle, "ssr_get_parameters")) == NULL)) {
             ALOGE("%s: dlsym failed", __func__);
             goto feature_disabled;
         }
@@ -2792,7 +2808,6 @@ feature_disabled:
     ssr_read = NULL;
     ssr_set_parameters = NULL;
     ssr_get_parameters = NULL;
-    ssr_get_stream = NULL;
 
     ALOGW(":: %s: ---- Feature SSREC is disabled ----", __func__);
 }
@@ -2827,11 +2842,11 @@ int32_t audio_extn_ssr_init(struct stream_in *in,
     return ret;
 }
 
-int32_t audio_extn_ssr_deinit() {
+int32_t audio_extn_ssr_deinit(struct stream_in *in) {
     int32_t ret = 0;
 
     if (ssrec_lib_handle != NULL)
-        ret = ssr_deinit();
+        ret = ssr_deinit(in);
 
     return ret;
 }
@@ -2877,13 +2892,9 @@ void audio_extn_ssr_get_parameters(const struct audio_device *adev,
         ssr_get_parameters(adev, query, reply);
 }
 
-struct stream_in *audio_extn_ssr_get_stream() {
-    struct stream_in *ret = NULL;
-
-    if (ssrec_lib_handle)
-        ret = ssr_get_stream();
-
-    return ret;
+/* true when in owns a surround record session created by ssr_init() */
+bool audio_extn_ssr_stream_active(const struct stream_in *in) {
+    return ssrec_lib_handle && in && in->ssr_ctx;
 }
 //END: SSREC_FEATURE ============================================================
 
@@ -3730,7 +3741,7 @@ static int audio_extn_set_multichannel_mask(struct audio_device *adev,
     /* validate input params. Avoid updated channel mask if loopback device */
     if ((channel_count == 6) &&
         (in->format == AUDIO_FORMAT_PCM_16_BIT) &&
-        (!is_loopback_input_device(get_device_types(&in->device_list)))) {
+        (!is_loopback_input_device(device_set_types(&in->device_list)))) {
         switch (max_mic_count) {
             case 4:
                 config->channel_mask = AUDIO_CHANNEL_INDEX_MASK_4;
@@ -3981,6 +3992,35 @@ int audio_extn_out_get_param_data(struct stream_out *out,
     return ret;
 }
 
+int audio_extn_in_get_param_data(struct stream_in *in,
+                             audio_extn_param_id param_id,
+                             audio_extn_param_payload *payload)
+{
+    int ret = -EINVAL;
+
+    if (!in || !payload) {
+        ALOGE("%s:: Invalid Param",__func__);
+        return ret;
+    }
+
+    switch (param_id) {
+        case AUDIO_EXTN_PARAM_IN_FRAME_INFO:
+            if (!audio_extn_cin_attached_usecase(in)) {
+                ret = -ENOSYS;
+                break;
+            }
+            ret = audio_extn_cin_get_frame_info(in, &payload->in_frame_info);
+            if (ret)
+                ALOGE("%s:: frame info query failed error %d", __func__, ret);
+            break;
+        default:
+            ALOGE("%s:: unsupported param_id %d", __func__, param_id);
+            break;
+    }
+
+    return ret;
+}
+
 int audio_extn_set_device_cfg_params(struct audio_device *adev,
                                      struct audio_device_cfg_param *payload)
 {
@@ -4005,13 +4045,13 @@ int audio_extn_set_device_cfg_params(struct audio_device *adev,
 
     adev_device_cfg_ptr = adev->device_cfg_params;
     /* Create an out stream to get snd device from audio device */
-    reassign_device_list(&out.device_list, device_cfg_params->device, "");
+    device_set_reassign(&out.device_list, device_cfg_params->device, "");
     out.sample_rate = device_cfg_params->sample_rate;
     snd_device = platform_get_output_snd_device(adev->platform, &out, USECASE_TYPE_MAX);
     backend_idx = platform_get_backend_index(snd_device);
 
     ALOGV("%s:: device %d sample_rate %d snd_device %d backend_idx %d",
-                __func__, get_device_types(&out.device_list),
+                __func__, device_set_types(&out.device_list),
                 out.sample_rate, snd_device, backend_idx);
 
     ALOGV("%s:: Device Config Params from Client samplerate %d  channels %d"
@@ -5559,6 +5599,11 @@ int audio_extn_cin_configure_input_stream(struct stream_in *in, struct audio_con
 {
     return (audio_extn_compress_in_enabled? cin_configure_input_stream(in, in_config): -1);
 }
+int audio_extn_cin_get_frame_info(struct stream_in *in,
+                                  struct audio_in_frame_info_param *info)
+{
+    return (audio_extn_compress_in_enabled? cin_get_frame_info(in, info): -ENOSYS);
+}
 // END: COMPRESS_IN ====================================================
 
 // START: BATTERY_LISTENER ==================================================
@@ -6378,6 +6423,7 @@ void audio_extn_set_parameters(struct audio_device *adev,
    audio_extn_set_aptx_dec_bt_addr(adev, parms);
    audio_extn_ffv_set_parameters(adev, parms);
    audio_extn_ext_hw_plugin_set_parameters(adev->ext_hw_plugin, parms);
+   audio_extn_hw_loopback_set_parameters(parms);
 }
 
 void audio_extn_get_parameters(const struct audio_device *adev,
@@ -6398,6 +6444,7 @@ void audio_extn_get_parameters(const struct audio_device *adev,
     if (adev->offload_effects_get_parameters != NULL)
         adev->offload_effects_get_parameters(query, reply);
     audio_extn_ext_hw_plugin_get_parameters(adev->ext_hw_plugin, query, reply);
+    audio_extn_hw_loopback_get_parameters(query, reply);
 
     kv_pairs = str_parms_to_str(reply);
     ALOGD_IF(kv_pairs != NULL, "%s: returns %s", __func__, kv_pairs);
@@ -384,7 +384,7 @@ int audio_extn_ssr_set_usecase(struct stream_in *in,
                                          bool *channel_mask_updated);
 int32_t audio_extn_ssr_init(struct stream_in *in,
                             int num_out_chan);
-int32_t audio_extn_ssr_deinit();
+int32_t audio_extn_ssr_deinit(struct stream_in *in);
 void audio_extn_ssr_update_enabled();
 bool audio_extn_ssr_get_enabled();
 int32_t audio_extn_ssr_read(struct audio_stream_in *stream,
@@ -394,7 +394,7 @@ void audio_extn_ssr_set_parameters(struct audio_device *adev,
 void audio_extn_ssr_get_parameters(const struct audio_device *adev,
                                    struct str_parms *query,
                                    struct str_parms *reply);
-struct stream_in *audio_extn_ssr_get_stream();
+bool audio_extn_ssr_stream_active(const struct stream_in *in);
 //END: SSREC_FEATURE ============================================================
 
 int audio_extn_check_and_set_multichannel_usecase(struct audio_device *adev,
@@ -516,6 +516,7 @@ bool audio_extn_spkr_prot_is_enabled();
 void audio_extn_spkr_prot_calib_cancel(void *adev);
 void audio_extn_spkr_prot_set_parameters(struct str_parms *parms,
                                          char *value, int len);
+void audio_extn_spkr_prot_set_idle(bool idle);
 int audio_extn_fbsp_set_parameters(struct str_parms *parms);
 int audio_extn_fbsp_get_parameters(struct str_parms *query,
                                    struct str_parms *reply);
@@ -816,6 +817,10 @@ void audio_extn_utils_update_stream_input_app_type_cfg(void *platform,
                                   uint32_t bit_width,
                                   char *profile,
                                   struct stream_app_type_cfg *app_type_cfg);
+uint32_t audio_extn_utils_get_output_standby_delay(
+                                  struct listnode *streams_output_cfg_list,
+                                  audio_output_flags_t flags,
+                                  char *profile);
 int audio_extn_utils_send_app_type_cfg(struct audio_device *adev,
                                        struct audio_usecase *usecase);
 void audio_extn_utils_send_audio_calibration(struct audio_device *adev,
@@ -900,6 +905,8 @@ uint32_t hal_format_to_pcm(audio_format_t hal_format);
 
 void audio_extn_utils_update_direct_pcm_fragment_size(struct stream_out *out);
 size_t audio_extn_utils_convert_format_24_8_to_8_24(void *buf, size_t bytes);
+void audio_extn_utils_sleep_silence(struct timespec *next, size_t bytes,
+                                    size_t frame_size, uint32_t sample_rate);
 int get_snd_codec_id(audio_format_t format);
 
 void kpi_optimize_feature_init(bool is_feature_enabled);
@@ -1112,6 +1119,8 @@ void audio_extn_cin_free_input_stream_resources(struct stream_in *in);
 int audio_extn_cin_read(struct stream_in *in, void *buffer,
                         size_t bytes, size_t *bytes_read);
 int audio_extn_cin_configure_input_stream(struct stream_in *in, struct audio_config *in_config);
+int audio_extn_cin_get_frame_info(struct stream_in *in,
+                                  struct audio_in_frame_info_param *info);
 // END: COMPRESS_INPUT_ENABLED ===============================
 
 //START: SOURCE_TRACKING_FEATURE ==============================================
@@ -1153,6 +1162,9 @@ int audio_extn_out_set_param_data(struct stream_out *out,
 int audio_extn_out_get_param_data(struct stream_out *out,
                              audio_extn_param_id param_id,
                              audio_extn_param_payload *payload);
+int audio_extn_in_get_param_data(struct stream_in *in,
+                             audio_extn_param_id param_id,
+                             audio_extn_param_payload *payload);
 int audio_extn_set_device_cfg_params(struct audio_device *adev,
                                      struct audio_device_cfg_param *payload);
 int audio_extn_utils_get_avt_device_drift(
@@ -1214,6 +1226,10 @@ int audio_extn_hw_loopback_set_param_data(audio_patch_handle_t handle,
 int audio_extn_hw_loopback_set_render_window(audio_patch_handle_t handle,
                                              struct audio_out_render_window_param *render_window);
 
+void audio_extn_hw_loopback_set_parameters(struct str_parms *parms);
+void audio_extn_hw_loopback_get_parameters(struct str_parms *query,
+                                           struct str_parms *reply);
+
 int audio_extn_hw_loopback_init(struct audio_device *adev);
 void audio_extn_hw_loopback_deinit(struct audio_device *adev);
 #else
@@ -1253,6 +1269,13 @@ static int __unused audio_extn_hw_loopback_set_render_window(audio_patch_handle_
 {
     return -ENOSYS;
 }
+static void __unused audio_extn_hw_loopback_set_parameters(struct str_parms *parms __unused)
+{
+}
+static void __unused audio_extn_hw_loopback_get_parameters(struct str_parms *query __unused,
+                                                struct str_parms *reply __unused)
+{
+}
 static int __unused audio_extn_hw_loopback_init(struct audio_device *adev __unused)
 {
     return -ENOSYS;
@@ -1268,17 +1291,17 @@ static void __unused audio_extn_hw_loopback_deinit(struct audio_device *adev __u
 #define audio_extn_ffv_check_usecase(in) (0)
 #define audio_extn_ffv_set_usecase(in, key, lic) (0)
 #define audio_extn_ffv_stream_init(in, key, lic) (0)
-#define audio_extn_ffv_stream_deinit() (0)
+#define audio_extn_ffv_stream_deinit(in) (0)
 #define audio_extn_ffv_update_enabled() (0)
 #define audio_extn_ffv_get_enabled() (0)
 #define audio_extn_ffv_read(stream, buffer, bytes) (0)
 #define audio_extn_ffv_set_parameters(adev, parms) (0)
-#define audio_extn_ffv_get_stream() (0)
-#define audio_extn_ffv_update_pcm_config(config) (0)
-#define audio_extn_ffv_init_ec_ref_loopback(adev, snd_device) (0)
-#define audio_extn_ffv_deinit_ec_ref_loopback(adev, snd_device) (0)
+#define audio_extn_ffv_stream_active(in) (0)
+#define audio_extn_ffv_update_pcm_config(in, config) (0)
+#define audio_extn_ffv_init_ec_ref_loopback(adev, in, snd_device) (0)
+#define audio_extn_ffv_deinit_ec_ref_loopback(adev, in, snd_device) (0)
 #define audio_extn_ffv_check_and_append_ec_ref_dev(device_name) (0)
-#define audio_extn_ffv_get_capture_snd_device() (0)
+#define audio_extn_ffv_get_capture_snd_device(in) (0)
 #define audio_extn_ffv_append_ec_ref_dev_name(device_name) (0)
 #else
 int32_t audio_extn_ffv_init(struct audio_device *adev);
@@ -1286,21 +1309,24 @@ int32_t audio_extn_ffv_deinit();
 bool audio_extn_ffv_check_usecase(struct stream_in *in);
 int audio_extn_ffv_set_usecase( struct stream_in *in, int key, char* lic);
 int32_t audio_extn_ffv_stream_init(struct stream_in *in, int key, char* lic);
-int32_t audio_extn_ffv_stream_deinit();
+int32_t audio_extn_ffv_stream_deinit(struct stream_in *in);
 void audio_extn_ffv_update_enabled();
 bool audio_extn_ffv_get_enabled();
 int32_t audio_extn_ffv_read(struct audio_stream_in *stream,
                        void *buffer, size_t bytes);
 void audio_extn_ffv_set_parameters(struct audio_device *adev,
                                    struct str_parms *parms);
-struct stream_in *audio_extn_ffv_get_stream();
-void audio_extn_ffv_update_pcm_config(struct pcm_config *config);
+bool audio_extn_ffv_stream_active(const struct stream_in *in);
+void audio_extn_ffv_update_pcm_config(struct stream_in *in,
+                                      struct pcm_config *config);
 int audio_extn_ffv_init_ec_ref_loopback(struct audio_device *adev,
+                                        struct stream_in *in,
                                         snd_device_t snd_device);
 int audio_extn_ffv_deinit_ec_ref_loopback(struct audio_device *adev,
+                                          struct stream_in *in,
                                           snd_device_t snd_device);
 void audio_extn_ffv_check_and_append_ec_ref_dev(char *device_name);
-snd_device_t audio_extn_ffv_get_capture_snd_device();
+snd_device_t audio_extn_ffv_get_capture_snd_device(const struct stream_in *in);
 void audio_extn_ffv_append_ec_ref_dev_name(char *device_name);
 #endif
 
@@ -143,9 +143,9 @@ int auto_hal_create_audio_patch(struct audio_hw_device *dev,
                 ALOGV("Creating audio patch for external FM tuner");
                 uc_info->id = USECASE_AUDIO_FM_TUNER_EXT;
                 uc_info->type = PCM_PASSTHROUGH;
-                list_init(&uc_info->device_list);
-                reassign_device_list(&uc_info->device_list, AUDIO_DEVICE_IN_FM_TUNER,
-                                     sources->ext.device.address);
+                device_set_init(&uc_info->device_list);
+                device_set_reassign(&uc_info->device_list, AUDIO_DEVICE_IN_FM_TUNER,
+                                    sources->ext.device.address);
                 uc_info->in_snd_device = SND_DEVICE_IN_CAPTURE_FM;
                 uc_info->out_snd_device = SND_DEVICE_OUT_BUS_MEDIA;
                 break;
@@ -167,9 +167,9 @@ int auto_hal_create_audio_patch(struct audio_hw_device *dev,
         }
         /* TODO: apply audio port gain to codec if applicable */
         usecase = uc_info->id;
-        pthread_mutex_lock(&adev->lock);
+        ADEV_LOCK(adev);
         list_add_tail(&adev->usecase_list, &uc_info->list);
-        pthread_mutex_unlock(&adev->lock);
+        ADEV_UNLOCK(adev);
     } else {
         ALOGV("%s: audio patch not supported", __func__);
         goto exit;
@@ -186,7 +186,7 @@ int auto_hal_create_audio_patch(struct audio_hw_device *dev,
         goto error;
     }
 
-    pthread_mutex_lock(&adev->lock);
+    ADEV_LOCK(adev);
     if (*handle == AUDIO_PATCH_HANDLE_NONE) {
         ALOGD("%s: audio patch handle not allocated 0x%x", __func__, *handle);
         *handle = fp_generate_patch_handle();
@@ -202,7 +202,7 @@ int auto_hal_create_audio_patch(struct audio_hw_device *dev,
         patch_record->patch.sinks[i] = sinks[i];
 
     list_add_tail(&adev->audio_patch_record_list, &patch_record->list);
-    pthread_mutex_unlock(&adev->lock);
+    ADEV_UNLOCK(adev);
 
     goto exit;
 
@@ -235,19 +235,19 @@ int auto_hal_release_audio_patch(struct audio_hw_device *dev,
     }
 
     /* get the patch record from handle */
-    pthread_mutex_lock(&adev->lock);
+    ADEV_LOCK(adev);
     patch_record = get_patch_from_list(adev, handle);
     if(!patch_record) {
         ALOGE("%s: failed to find the patch record with handle (%d) in the list",
                 __func__, handle);
         ret = -EINVAL;
     }
-    pthread_mutex_unlock(&adev->lock);
+    ADEV_UNLOCK(adev);
     if(ret)
         goto exit;
 
     if (patch_record->usecase != USECASE_INVALID) {
-        pthread_mutex_lock(&adev->lock);
+        ADEV_LOCK(adev);
         uc_info = fp_get_usecase_from_list(adev, patch_record->usecase);
         if (!uc_info) {
             ALOGE("%s: failed to find the usecase (%d)",
@@ -265,13 +265,13 @@ int auto_hal_release_audio_patch(struct audio_hw_device *dev,
             list_remove(&uc_info->list);
             free(uc_info);
         }
-        pthread_mutex_unlock(&adev->lock);
+        ADEV_UNLOCK(adev);
     }
 
     /* remove the patch record from list and free it */
-    pthread_mutex_lock(&adev->lock);
+    ADEV_LOCK(adev);
     list_remove(&patch_record->list);
-    pthread_mutex_unlock(&adev->lock);
+    ADEV_UNLOCK(adev);
     free(patch_record);
 
 exit:
@@ -476,14 +476,14 @@ int auto_hal_set_audio_port_config(struct audio_hw_device *dev,
             config->gain.values[0]);
         if (config->role == AUDIO_PORT_ROLE_SINK) {
             /* handle output devices */
-            pthread_mutex_lock(&adev->lock);
+            ADEV_LOCK(adev);
             list_for_each(node, &adev->active_outputs_list) {
                 streams_output_ctxt_t *out_ctxt = node_to_item(node,
                                                     streams_output_ctxt_t,
                                                     list);
                 /* limit audio gain support for bus device only */
                 if (config->ext.device.type == AUDIO_DEVICE_OUT_BUS &&
-                    compare_device_type_and_address(&out_ctxt->output->device_list,
+                    compare_device_type_and_address(&out_ctxt->output->device_list.list,
                                                     config->ext.device.type,
                                                     config->ext.device.address)) {
                     /* millibel = 1/100 dB = 1/1000 bel
@@ -543,7 +543,7 @@ int auto_hal_set_audio_port_config(struct audio_hw_device *dev,
                     }
                 }
             }
-            pthread_mutex_unlock(&adev->lock);
+            ADEV_UNLOCK(adev);
         } else if (config->role == AUDIO_PORT_ROLE_SOURCE) {
             // FIXME: handle input devices.
         }
@@ -593,8 +593,8 @@ int auto_hal_start_hfp_downlink(struct audio_device *adev,
 
     uc_downlink_info->type = PCM_HFP_CALL;
     uc_downlink_info->stream.out = adev->primary_output;
-    list_init(&uc_downlink_info->device_list);
-    assign_devices(&uc_downlink_info->device_list, &adev->primary_output->device_list);
+    device_set_init(&uc_downlink_info->device_list);
+    device_set_assign(&uc_downlink_info->device_list, &adev->primary_output->device_list.list);
     uc_downlink_info->in_snd_device = SND_DEVICE_NONE;
     uc_downlink_info->out_snd_device = SND_DEVICE_NONE;
 
@@ -683,7 +683,7 @@ snd_device_t auto_hal_get_input_snd_device(struct audio_device *adev,
 
     list_init(&in_devices);
     if (in != NULL)
-        assign_devices(&in_devices, &in->device_list);
+        assign_devices(&in_devices, &in->device_list.list);
 
     if (uc_id == USECASE_INVALID) {
         ALOGE("%s: Invalid usecase (%d)", __func__, uc_id);
@@ -702,7 +702,7 @@ snd_device_t auto_hal_get_input_snd_device(struct audio_device *adev,
     }
 
     list_init(&out_devices);
-    assign_devices(&out_devices, &usecase->stream.out->device_list);
+    assign_devices(&out_devices, &usecase->stream.out->device_list.list);
     if (list_empty(&out_devices) ||
         compare_device_type(&out_devices, AUDIO_DEVICE_BIT_IN)) {
         ALOGE("%s: Invalid output devices (%#x)", __func__, get_device_types(&out_devices));
@@ -770,7 +770,7 @@ snd_device_t auto_hal_get_output_snd_device(struct audio_device *adev,
     }
 
     list_init(&devices);
-    assign_devices(&devices, &usecase->stream.out->device_list);
+    assign_devices(&devices, &usecase->stream.out->device_list.list);
     if (list_empty(&devices) ||
         compare_device_type(&devices, AUDIO_DEVICE_BIT_IN)) {
         ALOGE("%s: Invalid output devices (%#x)", __func__, get_device_types(&devices));
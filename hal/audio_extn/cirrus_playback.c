@@ -499,14 +499,14 @@ static void *audio_extn_cirrus_calibration_thread() {
         ALOGE("%s: rx usecase can not be found", __func__);
         goto exit;
     }
-    pthread_mutex_lock(&adev->lock);
+    ADEV_LOCK(adev);
 
     uc_info_rx->id = USECASE_AUDIO_PLAYBACK_DEEP_BUFFER;
     uc_info_rx->type = PCM_PLAYBACK;
     uc_info_rx->in_snd_device = SND_DEVICE_NONE;
     uc_info_rx->stream.out = adev->primary_output;
     uc_info_rx->out_snd_device = SND_DEVICE_OUT_SPEAKER;
-    list_init(&uc_info_rx->device_list);
+    device_set_init(&uc_info_rx->device_list);
     list_add_tail(&adev->usecase_list, &uc_info_rx->list);
 
     fp_enable_snd_device(adev, SND_DEVICE_OUT_SPEAKER);
@@ -516,7 +516,7 @@ static void *audio_extn_cirrus_calibration_thread() {
     if (pcm_dev_rx_id < 0) {
         ALOGE("%s: Invalid pcm device for usecase (%d)",
               __func__, uc_info_rx->id);
-        pthread_mutex_unlock(&adev->lock);
+        ADEV_UNLOCK(adev);
         goto exit;
     }
 
@@ -526,17 +526,17 @@ static void *audio_extn_cirrus_calibration_thread() {
     if (handle.pcm_rx && !pcm_is_ready(handle.pcm_rx)) {
         ALOGE("%s: PCM device not ready: %s", __func__,
               pcm_get_error(handle.pcm_rx));
-        pthread_mutex_unlock(&adev->lock);
+        ADEV_UNLOCK(adev);
         goto close_stream;
     }
 
     if (pcm_start(handle.pcm_rx) < 0) {
         ALOGE("%s: pcm start for RX failed; error = %s", __func__,
               pcm_get_error(handle.pcm_rx));
-        pthread_mutex_unlock(&adev->lock);
+        ADEV_UNLOCK(adev);
         goto close_stream;
     }
-    pthread_mutex_unlock(&adev->lock);
+    ADEV_UNLOCK(adev);
     ALOGI("%s: PCM thread streaming", __func__);
 
     ret = audio_extn_cirrus_run_calibration();
@@ -546,7 +546,7 @@ static void *audio_extn_cirrus_calibration_thread() {
     ALOGE_IF(ret < 0, "%s: Set tuning configs failed (%d)", __func__, ret);
 
 close_stream:
-    pthread_mutex_lock(&adev->lock);
+    ADEV_LOCK(adev);
     if (handle.pcm_rx) {
         ALOGI("%s: pcm_rx_close", __func__);
         pcm_close(handle.pcm_rx);
@@ -557,7 +557,7 @@ close_stream:
     fp_disable_snd_device(adev, SND_DEVICE_OUT_SPEAKER);
     list_remove(&uc_info_rx->list);
     free(uc_info_rx);
-    pthread_mutex_unlock(&adev->lock);
+    ADEV_UNLOCK(adev);
 exit:
     handle.state = (prev_state == PLAYBACK) ? PLAYBACK : IDLE;
 
@@ -847,7 +847,7 @@ int spkr_prot_start_processing(snd_device_t snd_device) {
     uc_info_tx->type = PCM_CAPTURE;
     uc_info_tx->in_snd_device = SND_DEVICE_IN_CAPTURE_VI_FEEDBACK;
     uc_info_tx->out_snd_device = SND_DEVICE_NONE;
-    list_init(&uc_info_tx->device_list);
+    device_set_init(&uc_info_tx->device_list);
     handle.pcm_tx = NULL;
 
     list_add_tail(&adev->usecase_list, &uc_info_tx->list);
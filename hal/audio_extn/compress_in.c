@@ -59,6 +59,8 @@
 #ifndef COMPRESSED_TIMESTAMP_FLAG
 #define COMPRESSED_TIMESTAMP_FLAG 0
 struct snd_codec_metadata {
+uint32_t length;
+uint32_t offset;
 uint64_t timestamp;
 };
 #define compress_config_set_timstamp_flag(config) (-ENOSYS)
@@ -74,11 +76,26 @@ uint64_t timestamp;
 #endif /* COMPRESSED_TIMESTAMP_FLAG */
 
 #define COMPRESS_RECORD_NUM_FRAGMENTS 8
+/* power of 2, covers a few queries worth of AUDIO_IN_FRAME_INFO_MAX_FRAMES */
+#define CIN_FRAME_RING_SIZE 64
+
+/*
+ * Descriptors of the last reads, queried with AUDIO_EXTN_PARAM_IN_FRAME_INFO
+ * so clients get timestamps and sizes without parsing the buffer. Written by
+ * cin_read() and read by cin_get_frame_info(), both under in->lock.
+ */
+struct cin_frame_ring {
+    struct audio_in_frame_desc desc[CIN_FRAME_RING_SIZE];
+    uint64_t head;      /* seq of the next read */
+    uint64_t tail;      /* seq of the oldest descriptor not yet returned */
+    bool discontinuity; /* a read failed since the last descriptor */
+};
 
 struct cin_private_data {
     struct compr_config compr_config;
     struct compress *compr;
     bool usecase_acquired;
+    struct cin_frame_ring frames;
 };
 
 typedef struct cin_private_data cin_private_data_t;
@@ -274,6 +291,57 @@ void cin_free_input_stream_resources(struct stream_in *in)
     }
 }
 
+static void cin_record_frame(cin_private_data_t *cin_data, const void *buffer,
+                             size_t bytes, size_t mdata_size)
+{
+    struct cin_frame_ring *ring = &cin_data->frames;
+    struct audio_in_frame_desc *desc;
+
+    desc = &ring->desc[ring->head & (CIN_FRAME_RING_SIZE - 1)];
+    desc->seq = ring->head;
+    desc->flags = 0;
+    if (mdata_size) {
+        const struct snd_codec_metadata *mdata =
+                (const struct snd_codec_metadata *)buffer;
+
+        desc->timestamp = mdata->timestamp;
+        desc->size = mdata->length;
+        desc->flags |= AUDIO_IN_FRAME_FLAG_TIMESTAMP;
+    } else {
+        desc->timestamp = 0;
+        desc->size = bytes;
+    }
+    if (ring->discontinuity) {
+        desc->flags |= AUDIO_IN_FRAME_FLAG_DISCONTINUITY;
+        ring->discontinuity = false;
+    }
+    ring->head++;
+}
+
+int cin_get_frame_info(struct stream_in *in,
+                       struct audio_in_frame_info_param *info)
+{
+    cin_private_data_t *cin_data = (cin_private_data_t *) in->cin_extn;
+    struct cin_frame_ring *ring;
+    uint32_t i;
+
+    if (cin_data == NULL || info == NULL)
+        return -EINVAL;
+
+    ring = &cin_data->frames;
+    info->dropped = 0;
+    if (ring->head - ring->tail > CIN_FRAME_RING_SIZE) {
+        info->dropped = ring->head - ring->tail - CIN_FRAME_RING_SIZE;
+        ring->tail = ring->head - CIN_FRAME_RING_SIZE;
+    }
+    for (i = 0; i < AUDIO_IN_FRAME_INFO_MAX_FRAMES && ring->tail != ring->head; i++) {
+        info->frames[i] = ring->desc[ring->tail & (CIN_FRAME_RING_SIZE - 1)];
+        ring->tail++;
+    }
+    info->num_frames = i;
+    return 0;
+}
+
 int cin_read(struct stream_in *in, void *buffer,
                         size_t bytes, size_t *bytes_read)
 {
@@ -296,13 +364,16 @@ int cin_read(struct stream_in *in, void *buffer,
                 /* set ret to 0 if compress_read succeeded*/
                 ret = 0;
                 *bytes_read = bytes;
+                cin_record_frame(cin_data, buffer, bytes, mdata_size);
                 /* data from DSP comes in 24_8 format, convert it to 8_24 */
-                if (in->format == AUDIO_FORMAT_PCM_8_24_BIT) {
+                if (in->format == AUDIO_FORMAT_PCM_8_24_BIT && bytes > mdata_size) {
                     if (audio_extn_utils_convert_format_24_8_to_8_24(
-                                          (char *)buffer + mdata_size, bytes) != bytes)
+                                          (char *)buffer + mdata_size,
+                                          bytes - mdata_size) != bytes - mdata_size)
                         ret = -EIO;
                 }
             } else {
+                cin_data->frames.discontinuity = true;
                 ret = errno;
                 ALOGE("%s: failed error = %d, read = %zd, err_str %s", __func__,
                            ret, read_size, compress_get_error(cin_data->compr));
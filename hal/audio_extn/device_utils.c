@@ -624,3 +624,209 @@ int append_devices(struct listnode *dest, const struct listnode *source)
     }
     return ret;
 }
+
+/*
+ * Returns the mask bit of a single bit device type, without
+ * AUDIO_DEVICE_BIT_IN, or 0 if the type isn't a single device bit.
+ */
+static uint32_t device_type_bit(audio_devices_t type)
+{
+    uint32_t bits = type & ~AUDIO_DEVICE_BIT_IN;
+
+    if (bits == 0 || (bits & (bits - 1)) != 0)
+        return 0;
+    return bits;
+}
+
+static bool is_codec_backend_type(audio_devices_t type,
+                                  const uint32_t *array, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; i++) {
+        if (type == array[i])
+            return true;
+    }
+    return false;
+}
+
+static uint32_t device_type_classes(audio_devices_t type)
+{
+    uint32_t classes = 0;
+
+    if (audio_is_input_device(type)) {
+        classes |= DEVICE_SET_IN;
+        if (is_codec_backend_type(type, AUDIO_DEVICE_IN_ALL_CODEC_BACKEND_ARRAY,
+                                  AUDIO_DEVICE_IN_CODEC_BACKEND_CNT))
+            classes |= DEVICE_SET_CODEC_BACKEND_IN;
+        if (audio_is_usb_in_device(type))
+            classes |= DEVICE_SET_USB_IN;
+        if (audio_is_bluetooth_in_sco_device(type))
+            classes |= DEVICE_SET_SCO_IN;
+        if (audio_is_a2dp_in_device(type))
+            classes |= DEVICE_SET_A2DP_IN;
+    } else if (audio_is_output_device(type)) {
+        classes |= DEVICE_SET_OUT;
+        if (is_codec_backend_type(type, AUDIO_DEVICE_OUT_ALL_CODEC_BACKEND_ARRAY,
+                                  AUDIO_DEVICE_OUT_CODEC_BACKEND_CNT))
+            classes |= DEVICE_SET_CODEC_BACKEND_OUT;
+        if (audio_is_usb_out_device(type))
+            classes |= DEVICE_SET_USB_OUT;
+        if (audio_is_bluetooth_out_sco_device(type))
+            classes |= DEVICE_SET_SCO_OUT;
+        if (audio_is_a2dp_out_device(type))
+            classes |= DEVICE_SET_A2DP_OUT;
+    }
+    return classes;
+}
+
+/*
+ * Rebuilds the masks of a device set from its list. Called after every
+ * change to the list, which is rare compared to the queries.
+ */
+static void device_set_sync(struct audio_device_set *set)
+{
+    struct listnode *node;
+    struct audio_device_info *item = NULL;
+
+    set->types = AUDIO_DEVICE_NONE;
+    set->out_bits = 0;
+    set->in_bits = 0;
+    set->classes = 0;
+    set->count = 0;
+    set->num_other = 0;
+    set->usb_address = "";
+    set->a2dp_address = "";
+
+    list_for_each (node, &set->list) {
+        uint32_t bit, classes;
+
+        item = node_to_item(node, struct audio_device_info, list);
+        bit = device_type_bit(item->type);
+        classes = device_type_classes(item->type);
+
+        set->types |= item->type;
+        set->classes |= classes;
+        set->count++;
+        if (audio_is_input_device(item->type)) {
+            if (bit == 0 || (set->in_bits & bit))
+                set->num_other++;
+            else
+                set->in_bits |= bit;
+        } else {
+            if (bit == 0 || (set->out_bits & bit))
+                set->num_other++;
+            else
+                set->out_bits |= bit;
+        }
+
+        if ((classes & (DEVICE_SET_USB_IN | DEVICE_SET_USB_OUT)) &&
+                set->usb_address[0] == '\0')
+            set->usb_address = (const char *)&item->address[0];
+        if ((classes & (DEVICE_SET_A2DP_IN | DEVICE_SET_A2DP_OUT)) &&
+                set->a2dp_address[0] == '\0')
+            set->a2dp_address = (const char *)&item->address[0];
+    }
+}
+
+void device_set_init(struct audio_device_set *set)
+{
+    list_init(&set->list);
+    device_set_sync(set);
+}
+
+/*
+ * Operation: set = {};
+ */
+int device_set_clear(struct audio_device_set *set)
+{
+    int ret = clear_devices(&set->list);
+
+    device_set_sync(set);
+    return ret;
+}
+
+int device_set_update(struct audio_device_set *set, audio_devices_t type,
+                      const char *address, bool add_device)
+{
+    int ret = update_device_list(&set->list, type, address, add_device);
+
+    device_set_sync(set);
+    return ret;
+}
+
+/*
+ * Operation: set = source list
+ */
+int device_set_assign(struct audio_device_set *set, const struct listnode *source)
+{
+    int ret = assign_devices(&set->list, source);
+
+    device_set_sync(set);
+    return ret;
+}
+
+/*
+ * Operation: set = {type}
+ */
+int device_set_reassign(struct audio_device_set *set, audio_devices_t type,
+                        char *address)
+{
+    int ret = reassign_device_list(&set->list, type, address);
+
+    device_set_sync(set);
+    return ret;
+}
+
+/*
+ * Operation: set |= source list
+ */
+int device_set_append(struct audio_device_set *set, const struct listnode *source)
+{
+    int ret = append_devices(&set->list, source);
+
+    device_set_sync(set);
+    return ret;
+}
+
+/*
+ * Same as compare_device_type() on the set's list.
+ */
+bool device_set_has_type(struct audio_device_set *set, audio_devices_t type)
+{
+    uint32_t bit = device_type_bit(type);
+
+    if (bit == 0 || set->num_other > 0)
+        return compare_device_type(&set->list, type);
+    if (audio_is_input_device(type))
+        return (set->in_bits & bit) != 0;
+    return (set->out_bits & bit) != 0;
+}
+
+/*
+ * Same as is_single_device_type_equal() on the set's list.
+ */
+bool device_set_is_single_type(struct audio_device_set *set, audio_devices_t type)
+{
+    return set->count == 1 && set->types == type;
+}
+
+/*
+ * Same as compare_devices() on the sets' lists.
+ */
+bool device_set_equal(struct audio_device_set *s1, struct audio_device_set *s2)
+{
+    if (s1->count != s2->count)
+        return false;
+    if (s1->num_other > 0 || s2->num_other > 0)
+        return compare_devices(&s1->list, &s2->list);
+    return s1->out_bits == s2->out_bits && s1->in_bits == s2->in_bits;
+}
+
+/*
+ * Same as compare_devices_for_any_match() on the sets' lists.
+ */
+bool device_set_any_match(struct audio_device_set *s1, struct audio_device_set *s2)
+{
+    if (s1->num_other > 0 || s2->num_other > 0)
+        return compare_devices_for_any_match(&s1->list, &s2->list);
+    return (s1->out_bits & s2->out_bits) != 0 || (s1->in_bits & s2->in_bits) != 0;
+}
@@ -65,4 +65,68 @@ int reassign_device_list(struct listnode *device_list,
                             audio_devices_t type, char *address);
 int append_devices(struct listnode *dest, const struct listnode *source);
 
+/* Device classes tracked by struct audio_device_set */
+#define DEVICE_SET_IN                (1 << 0)
+#define DEVICE_SET_OUT               (1 << 1)
+#define DEVICE_SET_CODEC_BACKEND_IN  (1 << 2)
+#define DEVICE_SET_CODEC_BACKEND_OUT (1 << 3)
+#define DEVICE_SET_USB_IN            (1 << 4)
+#define DEVICE_SET_USB_OUT           (1 << 5)
+#define DEVICE_SET_SCO_IN            (1 << 6)
+#define DEVICE_SET_SCO_OUT           (1 << 7)
+#define DEVICE_SET_A2DP_IN           (1 << 8)
+#define DEVICE_SET_A2DP_OUT          (1 << 9)
+
+/*
+ * Device list that also keeps the device types it holds as bitmasks, so
+ * type queries and set comparisons don't walk the list. The list holds the
+ * same audio_device_info entries as a plain device list and can be passed
+ * to the list helpers above as &set->list for reading, but must only be
+ * changed through the device_set_* functions, which keep the masks in sync.
+ *
+ * Only single bit device types are kept in out_bits/in_bits. Other types,
+ * and a type listed again with another address, are counted in num_other;
+ * queries on such a set fall back to the list walk.
+ */
+struct audio_device_set {
+    struct listnode list;
+    audio_devices_t types;      /* all types ORed, as get_device_types() */
+    uint32_t out_bits;
+    uint32_t in_bits;           /* without AUDIO_DEVICE_BIT_IN */
+    uint32_t classes;           /* DEVICE_SET_* */
+    unsigned int count;
+    unsigned int num_other;
+    const char *usb_address;    /* address of the first USB device, or "" */
+    const char *a2dp_address;   /* address of the first A2DP device, or "" */
+};
+
+static inline bool device_set_has(const struct audio_device_set *set,
+                                  uint32_t classes)
+{
+    return (set->classes & classes) != 0;
+}
+
+static inline audio_devices_t device_set_types(const struct audio_device_set *set)
+{
+    return set->types;
+}
+
+static inline bool device_set_empty(const struct audio_device_set *set)
+{
+    return set->count == 0;
+}
+
+void device_set_init(struct audio_device_set *set);
+int device_set_clear(struct audio_device_set *set);
+int device_set_update(struct audio_device_set *set, audio_devices_t type,
+                      const char *address, bool add_device);
+int device_set_assign(struct audio_device_set *set, const struct listnode *source);
+int device_set_reassign(struct audio_device_set *set, audio_devices_t type,
+                        char *address);
+int device_set_append(struct audio_device_set *set, const struct listnode *source);
+bool device_set_has_type(struct audio_device_set *set, audio_devices_t type);
+bool device_set_is_single_type(struct audio_device_set *set, audio_devices_t type);
+bool device_set_equal(struct audio_device_set *s1, struct audio_device_set *s2);
+bool device_set_any_match(struct audio_device_set *s1, struct audio_device_set *s2);
+
 #endif
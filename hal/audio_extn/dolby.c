@@ -243,7 +243,7 @@ void send_ddp_endp_params(struct audio_device *adev,
     list_for_each(node, &adev->usecase_list) {
         usecase = node_to_item(node, struct audio_usecase, list);
         if (usecase->stream.out && (usecase->type == PCM_PLAYBACK) &&
-            (compare_device_type(&usecase->device_list, ddp_dev)) &&
+            (device_set_has_type(&usecase->device_list, ddp_dev)) &&
             (usecase->stream.out->flags & AUDIO_OUTPUT_FLAG_COMPRESS_OFFLOAD) &&
             ((usecase->stream.out->format == AUDIO_FORMAT_AC3) ||
              (usecase->stream.out->format == AUDIO_FORMAT_E_AC3) ||
@@ -261,7 +261,7 @@ void audio_extn_dolby_send_ddp_endp_params(struct audio_device *adev)
     list_for_each(node, &adev->usecase_list) {
         usecase = node_to_item(node, struct audio_usecase, list);
         if (usecase->stream.out && (usecase->type == PCM_PLAYBACK) &&
-            is_audio_out_device_type(&usecase->device_list) &&
+            device_set_has(&usecase->device_list, DEVICE_SET_OUT) &&
             (usecase->stream.out->flags & AUDIO_OUTPUT_FLAG_COMPRESS_OFFLOAD) &&
             ((usecase->stream.out->format == AUDIO_FORMAT_AC3) ||
              (usecase->stream.out->format == AUDIO_FORMAT_E_AC3) ||
@@ -270,14 +270,14 @@ void audio_extn_dolby_send_ddp_endp_params(struct audio_device *adev)
              * Use wfd /hdmi sink channel cap for dolby params if device is wfd
              * or hdmi. Otherwise use stereo configuration
              */
-            int channel_cap = compare_device_type(&usecase->device_list,
+            int channel_cap = device_set_has_type(&usecase->device_list,
                                                   AUDIO_DEVICE_OUT_AUX_DIGITAL) ?
                               adev->cur_hdmi_channels :
-                              compare_device_type(&usecase->device_list,
+                              device_set_has_type(&usecase->device_list,
                                                   AUDIO_DEVICE_OUT_PROXY) ?
                               adev->cur_wfd_channels : 2;
             send_ddp_endp_params_stream(usecase->stream.out,
-                                        get_device_types(&usecase->device_list),
+                                        device_set_types(&usecase->device_list),
                                         channel_cap, false /* set cache */);
         }
     }
@@ -378,7 +378,7 @@ void audio_extn_dolby_set_endpoint(struct audio_device *adev)
         usecase = node_to_item(node, struct audio_usecase, list);
         if ((usecase->type == PCM_PLAYBACK) &&
             (usecase->id != USECASE_AUDIO_PLAYBACK_LOW_LATENCY)) {
-            append_devices(&devices, &usecase->device_list);
+            append_devices(&devices, &usecase->device_list.list);
             send = true;
         }
     }
@@ -535,7 +535,7 @@ void audio_extn_dolby_ds2_set_endpoint(struct audio_device *adev) {
         usecase = node_to_item(node, struct audio_usecase, list);
         if ((usecase->type == PCM_PLAYBACK) &&
             (usecase->id != USECASE_AUDIO_PLAYBACK_LOW_LATENCY)) {
-            append_devices(&devices, &usecase->device_list);
+            append_devices(&devices, &usecase->device_list.list);
             send = true;
         }
     }
@@ -26,6 +26,7 @@
 #include <cutils/str_parms.h>
 #include <stdlib.h>
 #include <dlfcn.h>
+#include <pthread.h>
 #include <log/log.h>
 
 #include "audio_hw.h"
@@ -39,6 +40,25 @@
 #include <log_utils.h>
 #endif
 
+/*
+ * Sinks parsed recently, so that reconnecting one skips the parse. Entries
+ * are keyed by a hash of the SAD blob and checked against the blob itself.
+ */
+#define EDID_SINK_CACHE_SIZE    4
+#define EDID_SAD_MAX_LENGTH \
+    (MAX_EDID_BLOCKS * MIN_AUDIO_DESC_LENGTH + MIN_SPKR_ALLOCATION_DATA_LENGTH)
+
+struct edid_sink_cache_entry {
+    unsigned int hash;
+    int length;
+    char sad[EDID_SAD_MAX_LENGTH];
+    edid_audio_info info;
+};
+
+static struct edid_sink_cache_entry edid_sink_cache[EDID_SINK_CACHE_SIZE];
+static unsigned int edid_sink_cache_next;
+static pthread_mutex_t edid_sink_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
 static const char * edid_format_to_str(unsigned char format)
 {
     char * format_str = "??";
@@ -854,6 +874,81 @@ static void dump_edid_data(edid_audio_info *info)
            info->channel_map[6], info->channel_map[7]);
 }
 
+static unsigned int edid_sad_hash(const char *sad, int length)
+{
+    /* FNV-1a */
+    unsigned int hash = 2166136261u;
+    int i;
+
+    for (i = 0; i < length; i++) {
+        hash ^= (unsigned char)sad[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static bool edid_sink_cache_get(edid_audio_info *info, unsigned int hash,
+                                const char *sad, int length)
+{
+    struct edid_sink_cache_entry *entry;
+    bool found = false;
+    int i;
+
+    pthread_mutex_lock(&edid_sink_cache_lock);
+    for (i = 0; i < EDID_SINK_CACHE_SIZE; i++) {
+        entry = &edid_sink_cache[i];
+        if ((entry->length == length) && (entry->hash == hash) &&
+            !memcmp(entry->sad, sad, length)) {
+            memcpy(info, &entry->info, sizeof(edid_audio_info));
+            found = true;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&edid_sink_cache_lock);
+    return found;
+}
+
+static void edid_sink_cache_put(const edid_audio_info *info, unsigned int hash,
+                                const char *sad, int length)
+{
+    struct edid_sink_cache_entry *entry;
+
+    pthread_mutex_lock(&edid_sink_cache_lock);
+    entry = &edid_sink_cache[edid_sink_cache_next];
+    edid_sink_cache_next = (edid_sink_cache_next + 1) % EDID_SINK_CACHE_SIZE;
+    entry->hash = hash;
+    entry->length = length;
+    memcpy(entry->sad, sad, length);
+    memcpy(&entry->info, info, sizeof(edid_audio_info));
+    pthread_mutex_unlock(&edid_sink_cache_lock);
+}
+
+static void update_sink_summary(edid_audio_info* info)
+{
+    edid_audio_block_info *block;
+    int i;
+
+    info->format_mask = 0;
+    info->sr_mask = 0;
+    info->bps_mask = 0;
+    info->lpcm_max_channels = 0;
+    for (i = 0; i < info->audio_blocks && i < MAX_EDID_BLOCKS; i++) {
+        block = &info->audio_blocks_array[i];
+        /* format ids come from a signed byte and may not fit the mask */
+        if ((unsigned int)block->format_id < 32)
+            info->format_mask |= BIT(block->format_id);
+        info->sr_mask |= block->sampling_freq_bitmask;
+        info->bps_mask |= block->bits_per_sample_bitmask;
+        if ((block->format_id == LPCM) &&
+            (block->channels > info->lpcm_max_channels))
+            info->lpcm_max_channels = block->channels;
+    }
+    info->highest_sr = get_highest_edid_sf(info->sr_mask);
+    ALOGD("%s: formats 0x%x rates 0x%x bps 0x%x highest sr %d lpcm ch %d",
+          __func__, info->format_mask, info->sr_mask, info->bps_mask,
+          info->highest_sr, info->lpcm_max_channels);
+}
+
 bool edid_get_sink_caps(edid_audio_info* info, char *edid_data)
 {
     unsigned char channels[MAX_EDID_BLOCKS];
@@ -862,6 +957,9 @@ bool edid_get_sink_caps(edid_audio_info* info, char *edid_data)
     unsigned char bitrate[MAX_EDID_BLOCKS];
     int i = 0;
     int length, count_desc;
+    const char *sad;
+    unsigned int hash = 0;
+    bool cacheable;
 
     if (!info || !edid_data) {
         ALOGE("No valid EDID");
@@ -869,6 +967,7 @@ bool edid_get_sink_caps(edid_audio_info* info, char *edid_data)
     }
 
     length = (int) *edid_data++;
+    sad = edid_data;
     ALOGV("Total length is %d",length);
 
     count_desc = length/MIN_AUDIO_DESC_LENGTH;
@@ -878,7 +977,17 @@ bool edid_get_sink_caps(edid_audio_info* info, char *edid_data)
         return false;
     }
 
+    cacheable = (length > 0) && (length <= EDID_SAD_MAX_LENGTH);
+    if (cacheable) {
+        hash = edid_sad_hash(sad, length);
+        if (edid_sink_cache_get(info, hash, sad, length)) {
+            ALOGD("%s: sink 0x%x is cached", __func__, hash);
+            return true;
+        }
+    }
+
     memset(info, 0, sizeof(edid_audio_info));
+    info->sink_hash = hash;
 
     info->audio_blocks = count_desc-1;
     if (info->audio_blocks > MAX_EDID_BLOCKS) {
@@ -926,21 +1035,21 @@ bool edid_get_sink_caps(edid_audio_info* info, char *edid_data)
         ALOGV("info->audio_blocks_array[i].bits_per_sample_bitmask %d",
               info->audio_blocks_array[i].bits_per_sample_bitmask);
     }
+    update_sink_summary(info);
     dump_speaker_allocation(info);
     dump_edid_data(info);
+    if (cacheable)
+        edid_sink_cache_put(info, hash, sad, length);
     return true;
 }
 
 bool edid_is_supported_sr(edid_audio_info* info, int sr)
 {
-    int i = 0;
     if (info != NULL && sr != 0) {
-        for (i = 0; i < info->audio_blocks && i < MAX_EDID_BLOCKS; i++) {
-        if (is_supported_sr(info->audio_blocks_array[i].sampling_freq_bitmask , sr)) {
-                ALOGV("%s: returns true for sample rate [%d]",
-                      __func__, sr);
-                return true;
-            }
+        if (is_supported_sr(info->sr_mask, sr)) {
+            ALOGV("%s: returns true for sample rate [%d]",
+                  __func__, sr);
+            return true;
         }
     }
     ALOGV("%s: returns false for sample rate [%d]",
@@ -950,8 +1059,6 @@ bool edid_is_supported_sr(edid_audio_info* info, int sr)
 
 bool edid_is_supported_bps(edid_audio_info* info, int bps)
 {
-    int i = 0;
-
     if (bps == 16) {
         //16 bit bps is always supported
         //some oem may not update 16bit support in their edid info
@@ -959,12 +1066,10 @@ bool edid_is_supported_bps(edid_audio_info* info, int bps)
     }
 
     if (info != NULL && bps != 0) {
-        for (i = 0; i < info->audio_blocks && i < MAX_EDID_BLOCKS; i++) {
-            if (is_supported_bps(info->audio_blocks_array[i].bits_per_sample_bitmask, bps)) {
-                ALOGV("%s: returns true for bit width [%d]",
-                      __func__, bps);
-                return true;
-            }
+        if (is_supported_bps(info->bps_mask, bps)) {
+            ALOGV("%s: returns true for bit width [%d]",
+                  __func__, bps);
+            return true;
         }
     }
     ALOGV("%s: returns false for bit width [%d]",
@@ -974,17 +1079,10 @@ bool edid_is_supported_bps(edid_audio_info* info, int bps)
 
 int edid_get_highest_supported_sr(edid_audio_info* info)
 {
-    int sr = 0;
     int highest_sr = 0;
-    int i;
 
-    if (info != NULL) {
-        for (i = 0; i < info->audio_blocks && i < MAX_EDID_BLOCKS; i++) {
-          sr = get_highest_edid_sf(info->audio_blocks_array[i].sampling_freq_bitmask);
-          if (sr > highest_sr)
-            highest_sr = sr;
-        }
-    }
+    if (info != NULL)
+        highest_sr = info->highest_sr;
     else
         ALOGE("%s: info is NULL", __func__);
 
@@ -111,6 +111,17 @@ typedef struct edid_audio_info {
     char channel_map[MAX_CHANNELS_SUPPORTED];
     int  channel_allocation;
     unsigned int  channel_mask;
+    /*
+     * Summary of the audio blocks, filled in by edid_get_sink_caps() so
+     * capability queries don't walk them. Rate and bps masks use the SAD
+     * byte layout and cover the blocks of all formats.
+     */
+    unsigned int  sink_hash;
+    unsigned int  format_mask;      /* BIT(format_id) */
+    unsigned char sr_mask;
+    unsigned char bps_mask;
+    int  highest_sr;
+    int  lpcm_max_channels;
 } edid_audio_info;
 
 bool edid_is_supported_sr(edid_audio_info* info, int sr);
@@ -119,8 +119,35 @@ static FfvStatusType (*ffv_set_param_fn)(void *handle, char *params_buffer_ptr,
 static FfvStatusType (*ffv_register_event_callback_fn)(void *handle,
     ffv_event_callback_fn_t *fun_ptr);
 
+/*
+ * Process wide FFV state: library, feature flags, the parameters applied to
+ * new sessions and the EC reference loopback. The loopback is a single
+ * hardware path, so only one session capturing the reference separately can
+ * run; sessions getting the reference packed with the mic data
+ * (split_ec_ref_data) are only limited by the processing budget.
+ */
 struct ffvmodule {
     void *ffv_lib_handle;
+
+    int ec_ref_pcm_id;
+    struct pcm *ec_ref_pcm;
+    int ec_ref_ch_cnt;
+    audio_devices_t ec_ref_dev;
+    bool split_ec_ref_data;
+
+    bool is_ffv_enabled;
+    bool is_ffvmode_on;
+    pthread_mutex_t init_lock;
+    int target_ch_idx;
+    int num_sessions;
+    struct ffv_session *ec_ref_owner;
+};
+
+/* per stream FFV session, stored in stream_in->ffv_ctx */
+struct ffv_session {
+    struct stream_in *in;
+    void *handle;
+    int cost;
     unsigned char *in_buf;
     unsigned int in_buf_size;
     unsigned char *ec_ref_buf;
@@ -133,21 +160,9 @@ struct ffvmodule {
     struct pcm_config capture_config;
     struct pcm_config out_config;
     struct pcm_config ec_ref_config;
-
-    int ec_ref_pcm_id;
-    struct pcm *ec_ref_pcm;
-    int ec_ref_ch_cnt;
-    audio_devices_t ec_ref_dev;
     bool split_ec_ref_data;
-
-    bool is_ffv_enabled;
     bool buffers_allocated;
-    struct stream_in *in;
-    bool is_ffvmode_on;
-    void *handle;
-    pthread_mutex_t init_lock;
     bool capture_started;
-    int target_ch_idx;
 
 #ifdef FFV_PCM_DUMP
     FILE *fp_input;
@@ -159,27 +174,21 @@ struct ffvmodule {
 
 static struct ffvmodule ffvmod = {
     .ffv_lib_handle = NULL,
-    .in_buf = NULL,
-    .in_buf_size = 0,
-    .ec_ref_buf = NULL,
-    .ec_ref_buf_size = 0,
-    .split_in_buf = NULL,
-    .split_in_buf_size = 0,
-    .out_buf = NULL,
-    .out_buf_size = 0,
 
     .ec_ref_pcm = NULL,
     .ec_ref_ch_cnt = 1,
     .ec_ref_dev = AUDIO_DEVICE_OUT_SPEAKER,
     .is_ffv_enabled = false,
-    .buffers_allocated = false,
-    .in = NULL,
     .is_ffvmode_on = false,
-    .handle = NULL,
-    .capture_started = false,
     .target_ch_idx = -1,
+    .num_sessions = 0,
+    .ec_ref_owner = NULL,
 };
 
+/* estimated cost of one session, per-mille of one CPU */
+#define FFV_SESSION_COST_PROPERTY "vendor.audio.ffv.session_cost"
+#define FFV_SESSION_COST_DEFAULT 300
+
 static struct pcm_config ffv_pcm_config = {
     .channels = FFV_CHANNEL_MODE_MONO,
     .rate = FFV_SAMPLING_RATE_16000,
@@ -266,91 +275,91 @@ exit:
     return status;
 }
 
-static int deallocate_buffers()
+static int deallocate_buffers(struct ffv_session *session)
 {
-    if (ffvmod.in_buf) {
-        free(ffvmod.in_buf);
-        ffvmod.in_buf = NULL;
+    if (session->in_buf) {
+        free(session->in_buf);
+        session->in_buf = NULL;
     }
 
-    if (ffvmod.split_in_buf) {
-        free(ffvmod.split_in_buf);
-        ffvmod.split_in_buf = NULL;
+    if (session->split_in_buf) {
+        free(session->split_in_buf);
+        session->split_in_buf = NULL;
     }
 
-    if (ffvmod.ec_ref_buf) {
-        free(ffvmod.ec_ref_buf);
-        ffvmod.ec_ref_buf = NULL;
+    if (session->ec_ref_buf) {
+        free(session->ec_ref_buf);
+        session->ec_ref_buf = NULL;
     }
 
-    if (ffvmod.out_buf) {
-        free(ffvmod.out_buf);
-        ffvmod.out_buf = NULL;
+    if (session->out_buf) {
+        free(session->out_buf);
+        session->out_buf = NULL;
     }
 
-    ffvmod.buffers_allocated = false;
+    session->buffers_allocated = false;
     return 0;
 }
 
-static int allocate_buffers()
+static int allocate_buffers(struct ffv_session *session)
 {
     int status = 0;
 
     /* in_buf - buffer read from capture session */
-    ffvmod.in_buf_size = ffvmod.capture_config.period_size * ffvmod.capture_config.channels *
-                              (pcm_format_to_bits(ffvmod.capture_config.format) >> 3);
-    ffvmod.in_buf = (unsigned char *)calloc(1, ffvmod.in_buf_size);
-    if (!ffvmod.in_buf) {
-        ALOGE("%s: ERROR. Can not allocate in buffer size %d", __func__, ffvmod.in_buf_size);
+    session->in_buf_size = session->capture_config.period_size * session->capture_config.channels *
+                              (pcm_format_to_bits(session->capture_config.format) >> 3);
+    session->in_buf = (unsigned char *)calloc(1, session->in_buf_size);
+    if (!session->in_buf) {
+        ALOGE("%s: ERROR. Can not allocate in buffer size %d", __func__, session->in_buf_size);
         status = -ENOMEM;
         goto error_exit;
     }
     ALOGD("%s: Allocated in buffer size bytes =%d",
-          __func__, ffvmod.in_buf_size);
+          __func__, session->in_buf_size);
 
     /* ec_buf - buffer read from ec ref capture session */
-    ffvmod.ec_ref_buf_size = ffvmod.ec_ref_config.period_size * ffvmod.ec_ref_config.channels *
-                              (pcm_format_to_bits(ffvmod.ec_ref_config.format) >> 3);
-    ffvmod.ec_ref_buf = (unsigned char *)calloc(1, ffvmod.ec_ref_buf_size);
-    if (!ffvmod.ec_ref_buf) {
+    session->ec_ref_buf_size = session->ec_ref_config.period_size * session->ec_ref_config.channels *
+                              (pcm_format_to_bits(session->ec_ref_config.format) >> 3);
+    session->ec_ref_buf = (unsigned char *)calloc(1, session->ec_ref_buf_size);
+    if (!session->ec_ref_buf) {
         ALOGE("%s: ERROR. Can not allocate ec ref buffer size %d",
-               __func__, ffvmod.ec_ref_buf_size);
+               __func__, session->ec_ref_buf_size);
         status = -ENOMEM;
         goto error_exit;
     }
     ALOGD("%s: Allocated ec ref buffer size bytes =%d",
-          __func__, ffvmod.ec_ref_buf_size);
+          __func__, session->ec_ref_buf_size);
 
-    if (ffvmod.split_ec_ref_data) {
-        ffvmod.split_in_buf_size = ffvmod.in_buf_size - ffvmod.ec_ref_buf_size;
-        ffvmod.split_in_buf = (unsigned char *)calloc(1, ffvmod.split_in_buf_size);
-        if (!ffvmod.split_in_buf) {
+    if (session->split_ec_ref_data) {
+        session->split_in_buf_size = session->in_buf_size - session->ec_ref_buf_size;
+        session->split_in_buf = (unsigned char *)calloc(1, session->split_in_buf_size);
+        if (!session->split_in_buf) {
             ALOGE("%s: ERROR. Can not allocate split in buffer size %d",
-                   __func__, ffvmod.split_in_buf_size);
+                   __func__, session->split_in_buf_size);
             status = -ENOMEM;
             goto error_exit;
         }
         ALOGD("%s: Allocated split in buffer size bytes =%d",
-               __func__, ffvmod.split_in_buf_size);
+               __func__, session->split_in_buf_size);
     }
 
     /* out_buf - output buffer from FFV + SVA library */
-    ffvmod.out_buf_size = ffvmod.out_config.period_size * ffvmod.out_config.channels *
-                              (pcm_format_to_bits(ffvmod.out_config.format) >> 3);
-    ffvmod.out_buf = (unsigned char *)calloc(1, ffvmod.out_buf_size);
-    if (!ffvmod.out_buf) {
-        ALOGE("%s: ERROR. Can not allocate out buffer size %d", __func__, ffvmod.out_buf_size);
+    session->out_buf_size = session->out_config.period_size * session->out_config.channels *
+                              (pcm_format_to_bits(session->out_config.format) >> 3);
+    session->out_buf = (unsigned char *)calloc(1, session->out_buf_size);
+    if (!session->out_buf) {
+        ALOGE("%s: ERROR. Can not allocate out buffer size %d", __func__, session->out_buf_size);
         status = -ENOMEM;
         goto error_exit;
     }
     ALOGD("%s: Allocated out buffer size bytes =%d",
-          __func__, ffvmod.out_buf_size);
+          __func__, session->out_buf_size);
 
-    ffvmod.buffers_allocated = true;
+    session->buffers_allocated = true;
     return 0;
 
 error_exit:
-    deallocate_buffers();
+    deallocate_buffers(session);
     return status;
 }
 
@@ -386,8 +395,8 @@ bool  audio_extn_ffv_check_usecase(struct stream_in *in) {
     if ((audio_extn_ffv_get_enabled()) &&
             (channel_count == 1) &&
             (AUDIO_SOURCE_MIC == source) &&
-            (is_single_device_type_equal(&in->device_list, AUDIO_DEVICE_IN_BUILTIN_MIC) ||
-             is_single_device_type_equal(&in->device_list, AUDIO_DEVICE_IN_BACK_MIC)) &&
+            (device_set_is_single_type(&in->device_list, AUDIO_DEVICE_IN_BUILTIN_MIC) ||
+             device_set_is_single_type(&in->device_list, AUDIO_DEVICE_IN_BACK_MIC)) &&
             (in->format == AUDIO_FORMAT_PCM_16_BIT) &&
             (in->sample_rate == FFV_SAMPLING_RATE_16000)) {
         in->config.channels = channel_count;
@@ -414,16 +423,19 @@ int audio_extn_ffv_set_usecase(struct stream_in *in, int ffv_key, char* ffv_lic)
     return ret;
 }
 
-struct stream_in *audio_extn_ffv_get_stream()
+bool audio_extn_ffv_stream_active(const struct stream_in *in)
 {
-    return ffvmod.in;
+    return in && in->ffv_ctx;
 }
 
-void audio_extn_ffv_update_pcm_config(struct pcm_config *config)
+void audio_extn_ffv_update_pcm_config(struct stream_in *in,
+                                      struct pcm_config *config)
 {
-    config->channels = ffvmod.capture_config.channels;
-    config->period_count = ffvmod.capture_config.period_count;
-    config->period_size = ffvmod.capture_config.period_size;
+    struct ffv_session *session = (struct ffv_session *)in->ffv_ctx;
+
+    config->channels = session->capture_config.channels;
+    config->period_count = session->capture_config.period_count;
+    config->period_size = session->capture_config.period_size;
 }
 
 int32_t audio_extn_ffv_init(struct audio_device *adev __unused)
@@ -450,7 +462,7 @@ int32_t audio_extn_ffv_deinit()
 
 int32_t audio_extn_ffv_stream_init(struct stream_in *in, int key, char* lic)
 {
-    uint32_t ret = -EINVAL;
+    int32_t ret = -EINVAL;
     int num_tx_in_ch, num_out_ch, num_ec_ref_ch;
     int frame_len;
     int sample_rate;
@@ -464,6 +476,8 @@ int32_t audio_extn_ffv_stream_init(struct stream_in *in, int key, char* lic)
     char *params_buffer_ptr = NULL;
     int param_size = 0;
     int param_id;
+    int cost;
+    struct ffv_session *session;
 
     audio_get_vendor_config_path(vendor_config_path, sizeof(vendor_config_path));
     /* Get path for ffv_config_file_name in vendor */
@@ -472,47 +486,79 @@ int32_t audio_extn_ffv_stream_init(struct stream_in *in, int key, char* lic)
     config_file_path = platform_info_xml_path_file;
     if (!audio_extn_ffv_get_enabled()) {
         ALOGE("Rejecting FFV -- init is called without enabling FFV");
-        goto fail;
+        return -EINVAL;
     }
 
-    if (ffvmod.handle != NULL) {
+    if (in->ffv_ctx != NULL) {
         ALOGV("%s: reinitializing ffv library", __func__);
-        audio_extn_ffv_stream_deinit();
+        audio_extn_ffv_stream_deinit(in);
+    }
+
+    cost = property_get_int32(FFV_SESSION_COST_PROPERTY, FFV_SESSION_COST_DEFAULT);
+    if (!adev_proc_budget_acquire(in->dev, cost)) {
+        ALOGW("%s: Rejecting FFV -- cost %d exceeds remaining processing budget",
+              __func__, cost);
+        return -EBUSY;
+    }
+
+    session = (struct ffv_session *)calloc(1, sizeof(struct ffv_session));
+    if (!session) {
+        adev_proc_budget_release(in->dev, cost);
+        return -ENOMEM;
     }
+    session->in = in;
+    session->cost = cost;
+
+    pthread_mutex_lock(&ffvmod.init_lock);
+    session->split_ec_ref_data = ffvmod.split_ec_ref_data;
+    if (!session->split_ec_ref_data) {
+        if (ffvmod.ec_ref_owner) {
+            pthread_mutex_unlock(&ffvmod.init_lock);
+            ALOGW("%s: Rejecting FFV -- ec ref loopback in use by another session",
+                  __func__);
+            adev_proc_budget_release(in->dev, cost);
+            free(session);
+            return -EBUSY;
+        }
+        ffvmod.ec_ref_owner = session;
+    }
+    ffvmod.num_sessions++;
+    session->capture_config = ffv_pcm_config;
+    session->ec_ref_config = ffv_pcm_config;
+    session->out_config = ffv_pcm_config;
+    /* Update channels with ec ref channel count */
+    session->ec_ref_config.channels = ffvmod.ec_ref_ch_cnt;
+    pthread_mutex_unlock(&ffvmod.init_lock);
+    in->ffv_ctx = session;
 
-    ffvmod.capture_config = ffv_pcm_config;
-    ffvmod.ec_ref_config = ffv_pcm_config;
-    ffvmod.out_config = ffv_pcm_config;
     /* configure capture session with 6/8 channels */
-    ffvmod.capture_config.channels = ffvmod.split_ec_ref_data ?
+    session->capture_config.channels = session->split_ec_ref_data ?
         FFV_CHANNEL_MODE_OCT : FFV_CHANNEL_MODE_HEX;
-    ffvmod.capture_config.period_size =
+    session->capture_config.period_size =
                    CALCULATE_PERIOD_SIZE(FFV_PCM_BUFFER_DURATION_MS,
-                                         ffvmod.capture_config.rate,
+                                         session->capture_config.rate,
                                          FFV_PCM_PERIOD_COUNT, 32);
 
-    /* Update channels with ec ref channel count */
-    ffvmod.ec_ref_config.channels = ffvmod.ec_ref_ch_cnt;
-    ffvmod.ec_ref_config.period_size =
+    session->ec_ref_config.period_size =
                CALCULATE_PERIOD_SIZE(FFV_PCM_BUFFER_DURATION_MS,
-                                     ffvmod.ec_ref_config.rate,
+                                     session->ec_ref_config.rate,
                                      FFV_PCM_PERIOD_COUNT, 32);
-    ret = allocate_buffers();
+    ret = allocate_buffers(session);
     if (ret)
         goto fail;
 
-    num_ec_ref_ch = ffvmod.ec_ref_config.channels;
-    num_tx_in_ch = ffvmod.split_ec_ref_data ?
-        (ffvmod.capture_config.channels - num_ec_ref_ch) :
-        ffvmod.capture_config.channels;
-    num_out_ch = ffvmod.out_config.channels;
-    frame_len = ffvmod.capture_config.period_size;
-    sample_rate = ffvmod.capture_config.rate;
+    num_ec_ref_ch = session->ec_ref_config.channels;
+    num_tx_in_ch = session->split_ec_ref_data ?
+        (session->capture_config.channels - num_ec_ref_ch) :
+        session->capture_config.channels;
+    num_out_ch = session->out_config.channels;
+    frame_len = session->capture_config.period_size;
+    sample_rate = session->capture_config.rate;
 
     ALOGD("%s: ec_ref_ch %d, tx_in_ch %d, out_ch %d, frame_len %d, sample_rate %d",
            __func__, num_ec_ref_ch, num_tx_in_ch, num_out_ch, frame_len, sample_rate);
     ALOGD("%s: config file path %s", __func__, config_file_path);
-    status_type = ffv_init_fn(&ffvmod.handle, num_tx_in_ch, num_out_ch, num_ec_ref_ch,
+    status_type = ffv_init_fn(&session->handle, num_tx_in_ch, num_out_ch, num_ec_ref_ch,
                       frame_len, sample_rate, config_file_path, (char *)sm_buffer, 0,
                       &total_mem_size, key, lic);
     if (status_type) {
@@ -520,7 +566,7 @@ int32_t audio_extn_ffv_stream_init(struct stream_in *in, int key, char* lic)
         ret = -EINVAL;
         goto fail;
     }
-    ALOGD("%s: ffv_init success %p", __func__, ffvmod.handle);
+    ALOGD("%s: ffv_init success %p", __func__, session->handle);
 
     /* set target channel index if received as part of setparams */
     if (ffvmod.target_ch_idx != -1) {
@@ -529,7 +575,7 @@ int32_t audio_extn_ffv_stream_init(struct stream_in *in, int key, char* lic)
         params_buffer_ptr = (char *)&ch_index_param;
         param_size = sizeof(ch_index_param);
         param_id = FFV_TARGET_CHANNEL_INDEX_PARAM;
-        status_type = ffv_set_param_fn(ffvmod.handle, params_buffer_ptr,
+        status_type = ffv_set_param_fn(session->handle, params_buffer_ptr,
                                        param_id, param_size);
         if (status_type) {
             ALOGE("%s: ERROR. ffv_set_param_fn ret %d", __func__, status_type);
@@ -538,75 +584,88 @@ int32_t audio_extn_ffv_stream_init(struct stream_in *in, int key, char* lic)
         }
     }
 
-    ffvmod.in = in;
 #ifdef RUN_KEEP_ALIVE_IN_ARM_FFV
     audio_extn_keep_alive_start(KEEP_ALIVE_OUT_PRIMARY);
 #endif
 #ifdef FFV_PCM_DUMP
-    if (!ffvmod.fp_input) {
+    if (!session->fp_input) {
         ALOGD("%s: Opening input dump file \n", __func__);
-        ffvmod.fp_input = fopen("/data/misc/audio/ffv_input.pcm", "wb");
+        session->fp_input = fopen("/data/misc/audio/ffv_input.pcm", "wb");
     }
-    if (!ffvmod.fp_ecref) {
+    if (!session->fp_ecref) {
         ALOGD("%s: Opening ecref dump file \n", __func__);
-        ffvmod.fp_ecref = fopen("/data/misc/audio/ffv_ecref.pcm", "wb");
+        session->fp_ecref = fopen("/data/misc/audio/ffv_ecref.pcm", "wb");
     }
-    if (!ffvmod.fp_split_input && ffvmod.split_ec_ref_data) {
+    if (!session->fp_split_input && session->split_ec_ref_data) {
         ALOGD("%s: Opening split input dump file \n", __func__);
-        ffvmod.fp_split_input = fopen("/data/misc/audio/ffv_split_input.pcm", "wb");
+        session->fp_split_input = fopen("/data/misc/audio/ffv_split_input.pcm", "wb");
     }
-    if (!ffvmod.fp_output) {
+    if (!session->fp_output) {
         ALOGD("%s: Opening output dump file \n", __func__);
-        ffvmod.fp_output = fopen("/data/misc/audio/ffv_output.pcm", "wb");
+        session->fp_output = fopen("/data/misc/audio/ffv_output.pcm", "wb");
     }
 #endif
     ALOGV("%s: exit", __func__);
     return 0;
 
 fail:
-    audio_extn_ffv_stream_deinit();
+    audio_extn_ffv_stream_deinit(in);
     return ret;
 }
 
-int32_t audio_extn_ffv_stream_deinit()
+int32_t audio_extn_ffv_stream_deinit(struct stream_in *in)
 {
+    struct ffv_session *session = (struct ffv_session *)in->ffv_ctx;
+
     ALOGV("%s: entry", __func__);
+    if (!session)
+        return 0;
+
+    pthread_mutex_lock(&ffvmod.init_lock);
+    if (ffvmod.ec_ref_owner == session)
+        ffvmod.ec_ref_owner = NULL;
+    ffvmod.num_sessions--;
+    pthread_mutex_unlock(&ffvmod.init_lock);
 
 #ifdef FFV_PCM_DUMP
-    if (ffvmod.fp_input)
-        fclose(ffvmod.fp_input);
+    if (session->fp_input)
+        fclose(session->fp_input);
 
-    if (ffvmod.fp_ecref)
-        fclose(ffvmod.fp_ecref);
+    if (session->fp_ecref)
+        fclose(session->fp_ecref);
 
-    if (ffvmod.fp_split_input)
-        fclose(ffvmod.fp_split_input);
+    if (session->fp_split_input)
+        fclose(session->fp_split_input);
 
-    if (ffvmod.fp_output)
-        fclose(ffvmod.fp_output);
+    if (session->fp_output)
+        fclose(session->fp_output);
 #endif
 
-    if (ffvmod.handle)
-        ffv_deinit_fn(ffvmod.handle);
-
-    if (ffvmod.buffers_allocated)
-        deallocate_buffers();
+    if (session->handle) {
+        ffv_deinit_fn(session->handle);
 #ifdef RUN_KEEP_ALIVE_IN_ARM_FFV
-    audio_extn_keep_alive_stop(KEEP_ALIVE_OUT_PRIMARY);
+        audio_extn_keep_alive_stop(KEEP_ALIVE_OUT_PRIMARY);
 #endif
-    ffvmod.handle = NULL;
-    ffvmod.in = NULL;
+    }
+
+    if (session->buffers_allocated)
+        deallocate_buffers(session);
+    adev_proc_budget_release(in->dev, session->cost);
+    free(session);
+    in->ffv_ctx = NULL;
     ALOGV("%s: exit", __func__);
     return 0;
 }
 
-snd_device_t audio_extn_ffv_get_capture_snd_device()
+snd_device_t audio_extn_ffv_get_capture_snd_device(const struct stream_in *in)
 {
-    if (ffvmod.capture_config.channels == FFV_CHANNEL_MODE_OCT) {
+    struct ffv_session *session = (struct ffv_session *)in->ffv_ctx;
+
+    if (session->capture_config.channels == FFV_CHANNEL_MODE_OCT) {
         return SND_DEVICE_IN_HANDSET_8MIC;
-    } else if (ffvmod.capture_config.channels == FFV_CHANNEL_MODE_HEX) {
+    } else if (session->capture_config.channels == FFV_CHANNEL_MODE_HEX) {
         return SND_DEVICE_IN_HANDSET_6MIC;
-    } else if (ffvmod.capture_config.channels == FFV_CHANNEL_MODE_QUAD) {
+    } else if (session->capture_config.channels == FFV_CHANNEL_MODE_QUAD) {
         return SND_DEVICE_IN_HANDSET_QMIC;
     } else {
         ALOGE("%s: Invalid channels configured for capture", __func__);
@@ -615,8 +674,10 @@ snd_device_t audio_extn_ffv_get_capture_snd_device()
 }
 
 int audio_extn_ffv_init_ec_ref_loopback(struct audio_device *adev,
+                                        struct stream_in *in,
                                         snd_device_t snd_device __unused)
 {
+    struct ffv_session *session = (struct ffv_session *)in->ffv_ctx;
     struct audio_usecase *uc_info_tx = NULL;
     snd_device_t in_snd_device;
     char *params_buffer_ptr = NULL;
@@ -628,19 +689,19 @@ int audio_extn_ffv_init_ec_ref_loopback(struct audio_device *adev,
 
     ALOGV("%s: entry", __func__);
     /* notify library to reset AEC during each start */
-    status_type = ffv_set_param_fn(ffvmod.handle, params_buffer_ptr,
+    status_type = ffv_set_param_fn(session->handle, params_buffer_ptr,
                       param_id, param_size);
     if (status_type) {
         ALOGE("%s: ERROR. ffv_set_param_fn ret %d", __func__, status_type);
         return -EINVAL;
     }
 
-    if (ffvmod.split_ec_ref_data) {
+    if (session->split_ec_ref_data) {
         ALOGV("%s: Ignore ec ref loopback init", __func__);
         return 0;
     }
 
-    in_snd_device = platform_get_ec_ref_loopback_snd_device(ffvmod.ec_ref_ch_cnt);
+    in_snd_device = platform_get_ec_ref_loopback_snd_device(session->ec_ref_config.channels);
     uc_info_tx = (struct audio_usecase *)calloc(1, sizeof(struct audio_usecase));
     if (!uc_info_tx) {
         return -ENOMEM;
@@ -648,8 +709,8 @@ int audio_extn_ffv_init_ec_ref_loopback(struct audio_device *adev,
 
     if (in_snd_device == SND_DEVICE_IN_EC_REF_LOOPBACK_QUAD) {
         quad_downmix.quadrx_dwnmix_enable = true;
-        ALOGD("%s: set param for 4 ch ec, handle %p", __func__, ffvmod.handle);
-        status_type = ffv_set_param_fn(ffvmod.handle,
+        ALOGD("%s: set param for 4 ch ec, handle %p", __func__, session->handle);
+        status_type = ffv_set_param_fn(session->handle,
             (char *)&quad_downmix,
             FFV_QUADRX_USE_DWNMIX_PARAM,
             sizeof(ffv_quadrx_use_dwnmix_param_t));
@@ -679,11 +740,11 @@ int audio_extn_ffv_init_ec_ref_loopback(struct audio_device *adev,
     }
 
     ALOGV("%s: Opening PCM device card_id(%d) device_id(%d), channels %d format %d",
-          __func__, adev->snd_card, ffvmod.ec_ref_pcm_id, ffvmod.ec_ref_config.channels,
-          ffvmod.ec_ref_config.format);
+          __func__, adev->snd_card, ffvmod.ec_ref_pcm_id, session->ec_ref_config.channels,
+          session->ec_ref_config.format);
     ffvmod.ec_ref_pcm = pcm_open(adev->snd_card,
                              ffvmod.ec_ref_pcm_id,
-                             PCM_IN, &ffvmod.ec_ref_config);
+                             PCM_IN, &session->ec_ref_config);
     if (ffvmod.ec_ref_pcm && !pcm_is_ready(ffvmod.ec_ref_pcm)) {
         ALOGE("%s: %s", __func__, pcm_get_error(ffvmod.ec_ref_pcm));
         ret = -EIO;
@@ -696,7 +757,7 @@ int audio_extn_ffv_init_ec_ref_loopback(struct audio_device *adev,
         ret = -EINVAL;
     }
 
-    ffvmod.capture_started = false;
+    session->capture_started = false;
     pthread_mutex_unlock(&ffvmod.init_lock);
     ALOGV("%s: exit", __func__);
     return 0;
@@ -722,19 +783,21 @@ void audio_extn_ffv_append_ec_ref_dev_name(char *device_name)
 }
 
 int audio_extn_ffv_deinit_ec_ref_loopback(struct audio_device *adev,
+                                          struct stream_in *in,
                                           snd_device_t snd_device __unused)
 {
+    struct ffv_session *session = (struct ffv_session *)in->ffv_ctx;
     struct audio_usecase *uc_info_tx = NULL;
     snd_device_t in_snd_device;
     int ret = 0;
 
     ALOGV("%s: entry", __func__);
-    if (ffvmod.split_ec_ref_data) {
+    if (session->split_ec_ref_data) {
         ALOGV("%s: Ignore ec ref loopback init", __func__);
         return 0;
     }
 
-    in_snd_device = platform_get_ec_ref_loopback_snd_device(ffvmod.ec_ref_ch_cnt);
+    in_snd_device = platform_get_ec_ref_loopback_snd_device(session->ec_ref_config.channels);
     uc_info_tx = get_usecase_from_list(adev, USECASE_AUDIO_EC_REF_LOOPBACK);
     pthread_mutex_lock(&ffvmod.init_lock);
     if (ffvmod.ec_ref_pcm) {
@@ -752,9 +815,11 @@ int audio_extn_ffv_deinit_ec_ref_loopback(struct audio_device *adev,
     return ret;
 }
 
-int32_t audio_extn_ffv_read(struct audio_stream_in *stream __unused,
+int32_t audio_extn_ffv_read(struct audio_stream_in *stream,
                        void *buffer, size_t bytes)
 {
+    struct stream_in *in = (struct stream_in *)stream;
+    struct ffv_session *session = (struct ffv_session *)in->ffv_ctx;
     int status = 0;
     int16_t *in_ptr = NULL, *process_in_ptr = NULL, *process_out_ptr = NULL;
     int16_t *process_ec_ref_ptr = NULL;
@@ -768,39 +833,39 @@ int32_t audio_extn_ffv_read(struct audio_stream_in *stream __unused,
         return -EINVAL;
     }
 
-    if (!ffvmod.handle) {
+    if (!session->handle) {
         ALOGE("%s: ffv module handle not initialized", __func__);
         return -EINVAL;
     }
 
-    if (!ffvmod.in || !ffvmod.in->pcm) {
+    if (!in->pcm) {
         ALOGE("%s: capture session not initiliazed", __func__);
         return -EINVAL;
     }
 
-    if (!ffvmod.split_ec_ref_data && !ffvmod.ec_ref_pcm) {
+    if (!session->split_ec_ref_data && !ffvmod.ec_ref_pcm) {
         ALOGE("%s: ec ref session not initiliazed", __func__);
         return -EINVAL;
     }
 
-    if (!ffvmod.capture_started) {
+    if (!session->capture_started) {
         /* pcm_start of capture and ec ref session before read to reduce drift */
-        pcm_start(ffvmod.in->pcm);
+        pcm_start(in->pcm);
         while (status && (retry_num < FFV_PCM_MAX_RETRY)) {
             usleep(FFV_PCM_SLEEP_WAIT);
             retry_num++;
             ALOGI("%s: pcm_start retrying..status %d errno %d, retry cnt %d",
                    __func__, status, errno, retry_num);
-            status = pcm_start(ffvmod.in->pcm);
+            status = pcm_start(in->pcm);
         }
         if (status) {
             ALOGE("%s: ERROR. pcm_start failed, returned status %d - %s",
-                  __func__, status, pcm_get_error(ffvmod.in->pcm));
+                  __func__, status, pcm_get_error(in->pcm));
             return status;
         }
         retry_num = 0;
 
-        if (!ffvmod.split_ec_ref_data) {
+        if (!session->split_ec_ref_data) {
             pcm_start(ffvmod.ec_ref_pcm);
             while (status && (retry_num < FFV_PCM_MAX_RETRY)) {
                 usleep(FFV_PCM_SLEEP_WAIT);
@@ -817,40 +882,40 @@ int32_t audio_extn_ffv_read(struct audio_stream_in *stream __unused,
         }
         audio_extn_set_cpu_affinity();
         setpriority(PRIO_PROCESS, 0, ANDROID_PRIORITY_AUDIO);
-        ffvmod.capture_started = true;
+        session->capture_started = true;
     }
 
-    ALOGVV("%s: pcm_read reading bytes=%d", __func__, ffvmod.in_buf_size);
-    status = pcm_read(ffvmod.in->pcm, ffvmod.in_buf, ffvmod.in_buf_size);
+    ALOGVV("%s: pcm_read reading bytes=%d", __func__, session->in_buf_size);
+    status = pcm_read(in->pcm, session->in_buf, session->in_buf_size);
     if (status) {
         ALOGE("%s: pcm read failed status %d - %s", __func__, status,
-              pcm_get_error(ffvmod.in->pcm));
+              pcm_get_error(in->pcm));
         goto exit;
     }
     ALOGVV("%s: pcm_read done", __func__);
 
-    if (!ffvmod.split_ec_ref_data) {
+    if (!session->split_ec_ref_data) {
         /* read EC ref data */
-        ALOGVV("%s: ec ref pcm_read reading bytes=%d", __func__, ffvmod.ec_ref_buf_size);
-        status = pcm_read(ffvmod.ec_ref_pcm, ffvmod.ec_ref_buf, ffvmod.ec_ref_buf_size);
+        ALOGVV("%s: ec ref pcm_read reading bytes=%d", __func__, session->ec_ref_buf_size);
+        status = pcm_read(ffvmod.ec_ref_pcm, session->ec_ref_buf, session->ec_ref_buf_size);
         if (status) {
             ALOGE("%s: ec ref pcm read failed status %d - %s", __func__, status,
                    pcm_get_error(ffvmod.ec_ref_pcm));
             goto exit;
         }
         ALOGVV("%s: ec ref pcm_read done", __func__);
-        process_in_ptr = (int16_t *)ffvmod.in_buf;
-        process_ec_ref_ptr = (int16_t *)ffvmod.ec_ref_buf;
-        in_buf_size = ffvmod.in_buf_size;
+        process_in_ptr = (int16_t *)session->in_buf;
+        process_ec_ref_ptr = (int16_t *)session->ec_ref_buf;
+        in_buf_size = session->in_buf_size;
     } else {
         /* split input buffer into actual input channels and EC ref channels */
-        in_ptr = (int16_t *)ffvmod.in_buf;
-        process_in_ptr = (int16_t *)ffvmod.split_in_buf;
-        process_ec_ref_ptr = (int16_t *)ffvmod.ec_ref_buf;
-        total_in_ch = ffvmod.capture_config.channels;
-        ec_ref_ch = ffvmod.ec_ref_config.channels;
+        in_ptr = (int16_t *)session->in_buf;
+        process_in_ptr = (int16_t *)session->split_in_buf;
+        process_ec_ref_ptr = (int16_t *)session->ec_ref_buf;
+        total_in_ch = session->capture_config.channels;
+        ec_ref_ch = session->ec_ref_config.channels;
         in_ch = total_in_ch - ec_ref_ch;
-        for (i = 0; i < (int)ffvmod.capture_config.period_size; i++) {
+        for (i = 0; i < (int)session->capture_config.period_size; i++) {
             for (ch = 0; ch < in_ch; ch++) {
                 process_in_ptr[i*in_ch+ch] =
                           in_ptr[i*total_in_ch+ch];
@@ -860,13 +925,13 @@ int32_t audio_extn_ffv_read(struct audio_stream_in *stream __unused,
                           in_ptr[i*total_in_ch+in_ch+ch];
             }
         }
-        in_buf_size = ffvmod.split_in_buf_size;
+        in_buf_size = session->split_in_buf_size;
     }
-    process_out_ptr = (int16_t *)ffvmod.out_buf;
+    process_out_ptr = (int16_t *)session->out_buf;
 
-    ffv_process_fn(ffvmod.handle, process_in_ptr,
+    ffv_process_fn(session->handle, process_in_ptr,
             process_out_ptr, process_ec_ref_ptr);
-    out_buf_size = ffvmod.out_buf_size;
+    out_buf_size = session->out_buf_size;
     bytes_to_copy = (bytes <= out_buf_size) ? bytes : out_buf_size;
     memcpy(buffer, process_out_ptr, bytes_to_copy);
     if (bytes_to_copy != out_buf_size)
@@ -874,14 +939,14 @@ int32_t audio_extn_ffv_read(struct audio_stream_in *stream __unused,
                __func__, bytes_to_copy);
 
 #ifdef FFV_PCM_DUMP
-    if (ffvmod.fp_input)
-        fwrite(ffvmod.in_buf, 1, ffvmod.in_buf_size, ffvmod.fp_input);
-    if (ffvmod.fp_ecref)
-        fwrite(ffvmod.ec_ref_buf, 1, ffvmod.ec_ref_buf_size, ffvmod.fp_ecref);
-    if (ffvmod.fp_split_input)
-        fwrite(ffvmod.split_in_buf, 1, ffvmod.split_in_buf_size, ffvmod.fp_split_input);
-    if (ffvmod.fp_output)
-        fwrite(process_out_ptr, 1, bytes_to_copy, ffvmod.fp_output);
+    if (session->fp_input)
+        fwrite(session->in_buf, 1, session->in_buf_size, session->fp_input);
+    if (session->fp_ecref)
+        fwrite(session->ec_ref_buf, 1, session->ec_ref_buf_size, session->fp_ecref);
+    if (session->fp_split_input)
+        fwrite(session->split_in_buf, 1, session->split_in_buf_size, session->fp_split_input);
+    if (session->fp_output)
+        fwrite(process_out_ptr, 1, bytes_to_copy, session->fp_output);
 #endif
 
 exit:
@@ -896,7 +961,7 @@ void audio_extn_ffv_set_parameters(struct audio_device *adev __unused,
     char value[128];
 
     /* FFV params are required to be set before start of recording */
-    if (!ffvmod.handle) {
+    if (ffvmod.num_sessions == 0) {
         ret = str_parms_get_str(parms, AUDIO_PARAMETER_FFV_MODE_ON, value,
                                 sizeof(value));
         if (ret >= 0) {
@@ -306,8 +306,8 @@ static int32_t start_hfp(struct audio_device *adev,
     uc_info->id = hfpmod.ucid;
     uc_info->type = PCM_HFP_CALL;
     uc_info->stream.out = adev->primary_output;
-    list_init(&uc_info->device_list);
-    assign_devices(&uc_info->device_list, &adev->primary_output->device_list);
+    device_set_init(&uc_info->device_list);
+    device_set_assign(&uc_info->device_list, &adev->primary_output->device_list.list);
     uc_info->in_snd_device = SND_DEVICE_NONE;
     uc_info->out_snd_device = SND_DEVICE_NONE;
 
@@ -455,7 +455,7 @@ static int32_t stop_hfp(struct audio_device *adev)
     }
 
     /* 2. Disable echo reference while stopping hfp */
-    fp_platform_set_echo_reference(adev, false, &uc_info->device_list);
+    fp_platform_set_echo_reference(adev, false, &uc_info->device_list.list);
 
     /* 3. Get and set stream specific mixer controls */
     fp_disable_audio_route(adev, uc_info);
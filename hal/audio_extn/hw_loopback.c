@@ -44,6 +44,20 @@
 #define HW_LOOPBACK_RX_VOLUME     "Trans Loopback RX Volume"
 #define HW_LOOPBACK_RX_UNITY_GAIN 0x2000
 
+#define HW_LOOPBACK_LATENCY_BUDGET_KEY "hw_loopback_latency_budget_us"
+#define HW_LOOPBACK_RENDER_WINDOW_KEY  "hw_loopback_render_window"
+#define HW_LOOPBACK_LATENCY_KEY        "hw_loopback_latency_us"
+#define HW_LOOPBACK_DRIFT_KEY          "hw_loopback_drift_us"
+
+#define HW_LOOPBACK_FRAGMENT_SIZE      1024
+#define HW_LOOPBACK_MIN_FRAGMENT_FRAMES 32
+#define HW_LOOPBACK_MAX_FRAGMENT_FRAMES 1024
+#define HW_LOOPBACK_MAX_FRAGMENTS      4
+
+/* Transcode loopback latency modes, as in vendor.audio.transcode.latency.mode */
+#define HW_LOOPBACK_LATENCY_MODE_DEFAULT 0
+#define HW_LOOPBACK_LATENCY_MODE_LOW     1
+
 #include <math.h>
 #include <stdlib.h>
 #include <pthread.h>
@@ -82,6 +96,11 @@ typedef struct loopback_patch {
     struct compress *sink_stream;                    /* Sink stream */
     struct stream_inout patch_stream;                /* InOut type stream */
     patch_state_t patch_state;                       /* Patch operation state */
+    uint32_t latency_budget_us;                      /* Requested latency, 0 if none */
+    bool render_window_enabled;                      /* Drop data later than budget */
+    uint32_t latency_us;                             /* Estimated session latency */
+    int64_t drift_base_us;                           /* Delay at first drift query */
+    bool drift_base_valid;
 } loopback_patch_t;
 
 typedef struct patch_db_struct {
@@ -96,6 +115,8 @@ typedef struct audio_loopback {
     audio_usecase_t uc_id_tx;
     usecase_type_t  uc_type_rx;
     usecase_type_t  uc_type_tx;
+    uint32_t latency_budget_us;     /* applied to patches created afterwards */
+    bool render_window_enabled;     /* applied to patches created afterwards */
     pthread_mutex_t lock;
 } audio_loopback_t;
 
@@ -392,10 +413,27 @@ static loopback_patch_t *get_active_loopback_patch(audio_patch_handle_t handle)
     return active_loopback_patch;
 }
 
-int audio_extn_hw_loopback_set_render_window(audio_patch_handle_t handle,
+static int loopback_set_render_window(struct compress *sink_stream,
                       struct audio_out_render_window_param *render_window)
 {
     struct snd_compr_metadata metadata = {0};
+
+    metadata.key = SNDRV_COMPRESS_RENDER_WINDOW;
+    /*render window start value */
+    metadata.value[0] = 0xFFFFFFFF & render_window->render_ws; /* lsb */
+    metadata.value[1] = \
+            (0xFFFFFFFF00000000 & render_window->render_ws) >> 32; /* msb*/
+    /*render window end value */
+    metadata.value[2] = 0xFFFFFFFF & render_window->render_we; /* lsb */
+    metadata.value[3] = \
+            (0xFFFFFFFF00000000 & render_window->render_we) >> 32; /* msb*/
+
+    return compress_set_metadata(sink_stream, &metadata);
+}
+
+int audio_extn_hw_loopback_set_render_window(audio_patch_handle_t handle,
+                      struct audio_out_render_window_param *render_window)
+{
     int ret = 0;
     loopback_patch_t *active_loopback_patch = get_active_loopback_patch(handle);
 
@@ -411,24 +449,20 @@ int audio_extn_hw_loopback_set_render_window(audio_patch_handle_t handle,
         goto exit;
     }
 
-    metadata.key = SNDRV_COMPRESS_RENDER_WINDOW;
-    /*render window start value */
-    metadata.value[0] = 0xFFFFFFFF & render_window->render_ws; /* lsb */
-    metadata.value[1] = \
-            (0xFFFFFFFF00000000 & render_window->render_ws) >> 32; /* msb*/
-    /*render window end value */
-    metadata.value[2] = 0xFFFFFFFF & render_window->render_we; /* lsb */
-    metadata.value[3] = \
-            (0xFFFFFFFF00000000 & render_window->render_we) >> 32; /* msb*/
-
-    ret = compress_set_metadata(active_loopback_patch->sink_stream, &metadata);
+    ret = loopback_set_render_window(active_loopback_patch->sink_stream,
+                                     render_window);
 
 exit:
     return ret;
 }
 #else
-int audio_extn_hw_loopback_set_render_window(struct audio_hw_device *dev,
-                      audio_patch_handle_t handle __unused,
+static int loopback_set_render_window(struct compress *sink_stream __unused,
+                      struct audio_out_render_window_param *render_window __unused)
+{
+    return -ENOSYS;
+}
+
+int audio_extn_hw_loopback_set_render_window(audio_patch_handle_t handle __unused,
                       struct audio_out_render_window_param *render_window __unused)
 {
     ALOGD("%s:: configuring render window not supported", __func__);
@@ -457,6 +491,124 @@ static void transcode_loopback_util_set_latency_mode(
 }
 #endif
 
+static uint32_t loopback_frame_size(struct audio_port_config *port_config)
+{
+    return audio_channel_count_from_out_mask(port_config->channel_mask) *
+           (format_to_bitwidth(port_config->format) >> 3);
+}
+
+static uint32_t loopback_buffer_us(struct audio_port_config *port_config,
+                                   struct compr_config *config)
+{
+    uint32_t frame_size = loopback_frame_size(port_config);
+
+    if (frame_size == 0 || port_config->sample_rate == 0)
+        return 0;
+
+    return (uint64_t)(config->fragment_size / frame_size) * config->fragments *
+           1000000 / port_config->sample_rate;
+}
+
+/*
+ * Estimated end to end latency of a session: the data buffered in the
+ * capture and playback fragments plus the DSP path delay. Buffering in a
+ * compressed capture stream depends on the bitstream and is not counted.
+ */
+static uint32_t loopback_estimate_latency_us(loopback_patch_t *active_loopback_patch,
+                                             struct compr_config *source_config,
+                                             struct compr_config *sink_config,
+                                             uint32_t latency_mode)
+{
+    uint32_t latency_us = platform_transcode_loopback_latency(
+                          latency_mode == HW_LOOPBACK_LATENCY_MODE_LOW);
+
+    if (audio_is_linear_pcm(active_loopback_patch->loopback_source.format))
+        latency_us += loopback_buffer_us(&active_loopback_patch->loopback_source,
+                                         source_config);
+    latency_us += loopback_buffer_us(&active_loopback_patch->loopback_sink,
+                                     sink_config);
+    return latency_us;
+}
+
+static void loopback_set_fragments(loopback_patch_t *active_loopback_patch,
+                                   struct compr_config *source_config,
+                                   struct compr_config *sink_config,
+                                   uint32_t frames, uint32_t fragments)
+{
+    if (audio_is_linear_pcm(active_loopback_patch->loopback_source.format)) {
+        source_config->fragment_size = frames *
+                loopback_frame_size(&active_loopback_patch->loopback_source);
+        source_config->fragments = fragments;
+    }
+    sink_config->fragment_size = frames *
+            loopback_frame_size(&active_loopback_patch->loopback_sink);
+    sink_config->fragments = fragments;
+}
+
+/*
+ * Pick fragment sizes, fragment count and latency mode for the patch latency
+ * budget. The largest buffering that fits is used, in the default latency
+ * mode if possible and in low latency mode otherwise, unless the mode is
+ * forced through the property. If nothing fits, the smallest configuration
+ * is used. Returns the latency mode to set.
+ */
+static uint32_t loopback_plan_latency(loopback_patch_t *active_loopback_patch,
+                                      struct compr_config *source_config,
+                                      struct compr_config *sink_config,
+                                      int forced_latency_mode)
+{
+    uint32_t mode, first_mode, last_mode, frames, fragments;
+    uint32_t best_frames = 0, best_fragments = 0, latency_us;
+    uint32_t budget_us = active_loopback_patch->latency_budget_us;
+
+    if ((loopback_frame_size(&active_loopback_patch->loopback_sink) == 0) ||
+        (audio_is_linear_pcm(active_loopback_patch->loopback_source.format) &&
+         loopback_frame_size(&active_loopback_patch->loopback_source) == 0)) {
+        ALOGE("%s: invalid port config, keeping default fragments", __func__);
+        return (forced_latency_mode >= 0) ? (uint32_t)forced_latency_mode :
+                                            HW_LOOPBACK_LATENCY_MODE_DEFAULT;
+    }
+
+    if (forced_latency_mode >= 0) {
+        first_mode = last_mode = forced_latency_mode;
+    } else {
+        first_mode = HW_LOOPBACK_LATENCY_MODE_DEFAULT;
+        last_mode = HW_LOOPBACK_LATENCY_MODE_LOW;
+    }
+
+    for (mode = first_mode; mode <= last_mode; mode++) {
+        for (frames = HW_LOOPBACK_MAX_FRAGMENT_FRAMES;
+             frames >= HW_LOOPBACK_MIN_FRAGMENT_FRAMES; frames >>= 1) {
+            for (fragments = 1; fragments <= HW_LOOPBACK_MAX_FRAGMENTS; fragments++) {
+                if (frames * fragments <= best_frames * best_fragments)
+                    continue;
+                loopback_set_fragments(active_loopback_patch, source_config,
+                                       sink_config, frames, fragments);
+                latency_us = loopback_estimate_latency_us(active_loopback_patch,
+                                     source_config, sink_config, mode);
+                if (latency_us <= budget_us) {
+                    best_frames = frames;
+                    best_fragments = fragments;
+                }
+            }
+        }
+        if (best_frames)
+            break;
+    }
+
+    if (best_frames == 0) {
+        mode = last_mode;
+        best_frames = HW_LOOPBACK_MIN_FRAGMENT_FRAMES;
+        best_fragments = 1;
+        ALOGW("%s: latency budget %u us cannot be met", __func__, budget_us);
+    }
+    loopback_set_fragments(active_loopback_patch, source_config, sink_config,
+                           best_frames, best_fragments);
+    ALOGD("%s: budget %u us, %u frames x %u fragments, latency mode %u",
+          __func__, budget_us, best_frames, best_fragments, mode);
+    return mode;
+}
+
 /* Create a loopback session based on active loopback patch selected */
 int create_loopback_session(loopback_patch_t *active_loopback_patch)
 {
@@ -475,6 +627,9 @@ int create_loopback_session(loopback_patch_t *active_loopback_patch)
     struct adsp_hdlr_stream_cfg hdlr_stream_cfg;
     struct stream_in loopback_source_stream;
     char prop_value[PROPERTY_VALUE_MAX] = {0};
+    int forced_latency_mode = -1;
+    uint32_t latency_mode = HW_LOOPBACK_LATENCY_MODE_DEFAULT;
+    struct audio_out_render_window_param render_window;
 
     ALOGD("%s: Create loopback session begin", __func__);
 
@@ -496,9 +651,9 @@ int create_loopback_session(loopback_patch_t *active_loopback_patch)
     uc_info_rx->id = USECASE_AUDIO_TRANSCODE_LOOPBACK_RX;
     uc_info_rx->type = audio_loopback_mod->uc_type_rx;
     uc_info_rx->stream.inout = &active_loopback_patch->patch_stream;
-    list_init(&uc_info_rx->device_list);
-    assign_devices(&uc_info_rx->device_list,
-                   &active_loopback_patch->patch_stream.out_config.device_list);
+    device_set_init(&uc_info_rx->device_list);
+    device_set_assign(&uc_info_rx->device_list,
+                      &active_loopback_patch->patch_stream.out_config.device_list);
     uc_info_rx->in_snd_device = SND_DEVICE_NONE;
     uc_info_rx->out_snd_device = SND_DEVICE_NONE;
 
@@ -506,9 +661,9 @@ int create_loopback_session(loopback_patch_t *active_loopback_patch)
     uc_info_tx->id = USECASE_AUDIO_TRANSCODE_LOOPBACK_TX;
     uc_info_tx->type = audio_loopback_mod->uc_type_tx;
     uc_info_tx->stream.inout = &active_loopback_patch->patch_stream;
-    list_init(&uc_info_tx->device_list);
-    assign_devices(&uc_info_tx->device_list,
-                   &active_loopback_patch->patch_stream.in_config.device_list);
+    device_set_init(&uc_info_tx->device_list);
+    device_set_assign(&uc_info_tx->device_list,
+                      &active_loopback_patch->patch_stream.in_config.device_list);
     uc_info_tx->in_snd_device = SND_DEVICE_NONE;
     uc_info_tx->out_snd_device = SND_DEVICE_NONE;
 
@@ -516,7 +671,6 @@ int create_loopback_session(loopback_patch_t *active_loopback_patch)
     list_add_tail(&adev->usecase_list, &uc_info_tx->list);
 
     loopback_source_stream.source = AUDIO_SOURCE_UNPROCESSED;
-    loopback_source_stream.device = inout->in_config.devices;
     loopback_source_stream.channel_mask = inout->in_config.channel_mask;
     loopback_source_stream.bit_width = inout->in_config.bit_width;
     loopback_source_stream.sample_rate = inout->in_config.sample_rate;
@@ -578,10 +732,23 @@ int create_loopback_session(loopback_patch_t *active_loopback_patch)
     codec.ch_out = 2; // Irrelevant for loopback case in this direction
     codec.sample_rate = source_patch_config->sample_rate;
     codec.format = hal_format_to_alsa(source_patch_config->format);
-    source_config.fragment_size = 1024;
+    source_config.fragment_size = HW_LOOPBACK_FRAGMENT_SIZE;
     source_config.fragments = 1;
     source_config.codec = &codec;
 
+    sink_config.fragment_size = HW_LOOPBACK_FRAGMENT_SIZE;
+    sink_config.fragments = 1;
+
+    if(property_get("vendor.audio.transcode.latency.mode", prop_value, "")) {
+        forced_latency_mode = atoi(prop_value);
+        latency_mode = forced_latency_mode;
+    }
+    if (active_loopback_patch->latency_budget_us)
+        latency_mode = loopback_plan_latency(active_loopback_patch, &source_config,
+                                             &sink_config, forced_latency_mode);
+    active_loopback_patch->latency_us = loopback_estimate_latency_us(
+            active_loopback_patch, &source_config, &sink_config, latency_mode);
+
     /* Open compress stream in capture path */
     active_loopback_patch->source_stream = compress_open(adev->snd_card,
                         pcm_dev_asm_tx_id, COMPRESS_OUT, &source_config);
@@ -605,17 +772,14 @@ int create_loopback_session(loopback_patch_t *active_loopback_patch)
                                                      channel_mask);
     codec.sample_rate = sink_patch_config->sample_rate;
     codec.format = hal_format_to_alsa(sink_patch_config->format);
-    sink_config.fragment_size = 1024;
-    sink_config.fragments = 1;
     sink_config.codec = &codec;
 
     /* Do not alter the location of sending latency mode property */
     /* Mode set on any stream but before both streams are open */
-    if(property_get("vendor.audio.transcode.latency.mode", prop_value, "")) {
-        uint32_t latency_mode = atoi(prop_value);
+    if (forced_latency_mode >= 0 ||
+        latency_mode != HW_LOOPBACK_LATENCY_MODE_DEFAULT)
         transcode_loopback_util_set_latency_mode(active_loopback_patch,
                                                  latency_mode);
-    }
 
     /* Open compress stream in playback path */
     active_loopback_patch->sink_stream = compress_open(adev->snd_card,
@@ -633,6 +797,17 @@ int create_loopback_session(loopback_patch_t *active_loopback_patch)
         goto exit;
     }
 
+    /* If asked to, drop data that would render later than the budget allows */
+    if (active_loopback_patch->render_window_enabled &&
+        active_loopback_patch->latency_budget_us > active_loopback_patch->latency_us) {
+        render_window.render_ws = 0;
+        render_window.render_we = active_loopback_patch->latency_budget_us -
+                                  active_loopback_patch->latency_us;
+        if (loopback_set_render_window(active_loopback_patch->sink_stream,
+                                       &render_window) < 0)
+            ALOGW("%s: render window not set", __func__);
+    }
+
     active_loopback_patch->patch_state = PATCH_CREATED;
 
     if (compress_start(active_loopback_patch->source_stream) < 0) {
@@ -661,7 +836,8 @@ int create_loopback_session(loopback_patch_t *active_loopback_patch)
 
     /* Move patch state to running, now that session is set up */
     active_loopback_patch->patch_state = PATCH_RUNNING;
-    ALOGD("%s: Create loopback session end: status(%d)", __func__, ret);
+    ALOGD("%s: Create loopback session end: status(%d), latency %u us",
+          __func__, ret, active_loopback_patch->latency_us);
 
     if (adev->offload_effects_start_output != NULL)
         adev->offload_effects_start_output(active_loopback_patch->patch_handle_id,
@@ -731,6 +907,9 @@ int audio_extn_hw_loopback_create_audio_patch(struct audio_hw_device *dev,
     active_loopback_patch->patch_state = PATCH_INACTIVE;
     active_loopback_patch->patch_stream.ip_hdlr_handle = NULL;
     active_loopback_patch->patch_stream.adsp_hdlr_stream_handle = NULL;
+    active_loopback_patch->latency_budget_us = audio_loopback_mod->latency_budget_us;
+    active_loopback_patch->render_window_enabled =
+            audio_loopback_mod->render_window_enabled;
     memcpy(&active_loopback_patch->loopback_source, &sources[0], sizeof(struct
     audio_port_config));
     memcpy(&active_loopback_patch->loopback_sink, &sinks[0], sizeof(struct
@@ -960,6 +1139,98 @@ exit_set_port_config:
     return status;
 }
 
+/* Capture minus render position of a running session, in microseconds */
+static int loopback_get_delay_us(loopback_patch_t *active_loopback_patch,
+                                 int64_t *delay_us)
+{
+    unsigned long source_frames = 0, sink_frames = 0;
+    unsigned int source_rate = 0, sink_rate = 0;
+
+    if (compress_get_tstamp(active_loopback_patch->source_stream,
+                            &source_frames, &source_rate) < 0 ||
+        compress_get_tstamp(active_loopback_patch->sink_stream,
+                            &sink_frames, &sink_rate) < 0 ||
+        source_rate == 0 || sink_rate == 0) {
+        ALOGE("%s: failed to get session timestamps", __func__);
+        return -EINVAL;
+    }
+
+    *delay_us = (int64_t)source_frames * 1000000 / source_rate -
+                (int64_t)sink_frames * 1000000 / sink_rate;
+    return 0;
+}
+
+void audio_extn_hw_loopback_set_parameters(struct str_parms *parms)
+{
+    char value[32] = {0};
+    int ret, val;
+
+    if (audio_loopback_mod == NULL)
+        return;
+
+    ret = str_parms_get_str(parms, HW_LOOPBACK_LATENCY_BUDGET_KEY, value,
+                            sizeof(value));
+    if (ret >= 0) {
+        val = atoi(value);
+        if (val < 0) {
+            ALOGE("%s: invalid latency budget %d", __func__, val);
+        } else {
+            pthread_mutex_lock(&audio_loopback_mod->lock);
+            audio_loopback_mod->latency_budget_us = val;
+            pthread_mutex_unlock(&audio_loopback_mod->lock);
+            ALOGD("%s: latency budget %d us", __func__, val);
+        }
+    }
+
+    ret = str_parms_get_str(parms, HW_LOOPBACK_RENDER_WINDOW_KEY, value,
+                            sizeof(value));
+    if (ret >= 0) {
+        pthread_mutex_lock(&audio_loopback_mod->lock);
+        audio_loopback_mod->render_window_enabled = !strncmp(value, "true", 4);
+        pthread_mutex_unlock(&audio_loopback_mod->lock);
+        ALOGD("%s: render window %s", __func__, value);
+    }
+}
+
+void audio_extn_hw_loopback_get_parameters(struct str_parms *query,
+                                           struct str_parms *reply)
+{
+    loopback_patch_t *active_loopback_patch;
+    int64_t delay_us;
+    char value[32] = {0};
+
+    if (audio_loopback_mod == NULL)
+        return;
+
+    pthread_mutex_lock(&audio_loopback_mod->lock);
+    if (audio_loopback_mod->patch_db.num_patches <= 0)
+        goto exit;
+
+    /* Only one hw loopback patch is supported */
+    active_loopback_patch = &audio_loopback_mod->patch_db.loopback_patch[0];
+
+    if (str_parms_get_str(query, HW_LOOPBACK_LATENCY_KEY, value,
+                          sizeof(value)) >= 0)
+        str_parms_add_int(reply, HW_LOOPBACK_LATENCY_KEY,
+                          active_loopback_patch->latency_us);
+
+    if (str_parms_get_str(query, HW_LOOPBACK_DRIFT_KEY, value,
+                          sizeof(value)) >= 0 &&
+        active_loopback_patch->patch_state == PATCH_RUNNING &&
+        loopback_get_delay_us(active_loopback_patch, &delay_us) == 0) {
+        /* Drift is measured against the delay seen at the first query */
+        if (!active_loopback_patch->drift_base_valid) {
+            active_loopback_patch->drift_base_us = delay_us;
+            active_loopback_patch->drift_base_valid = true;
+        }
+        str_parms_add_int(reply, HW_LOOPBACK_DRIFT_KEY,
+                          (int)(delay_us - active_loopback_patch->drift_base_us));
+    }
+
+exit:
+    pthread_mutex_unlock(&audio_loopback_mod->lock);
+}
+
 /* Loopback extension initialization, part of hal init sequence */
 int audio_extn_hw_loopback_init(struct audio_device *adev)
 {
@@ -996,6 +1267,8 @@ int audio_extn_hw_loopback_init(struct audio_device *adev)
     audio_loopback_mod->uc_id_tx = USECASE_AUDIO_TRANSCODE_LOOPBACK_TX;
     audio_loopback_mod->uc_type_rx = TRANSCODE_LOOPBACK_RX;
     audio_loopback_mod->uc_type_tx = TRANSCODE_LOOPBACK_TX;
+    audio_loopback_mod->latency_budget_us = 0;
+    audio_loopback_mod->render_window_enabled = false;
 
 loopback_done:
     if (ret != 0) {
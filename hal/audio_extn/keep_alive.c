@@ -178,8 +178,8 @@ void get_device_id_from_mode(ka_mode_t ka_mode,
     {
         case KEEP_ALIVE_OUT_PRIMARY:
             if (adev->primary_output) {
-                if (is_audio_out_device_type(&adev->primary_output->device_list))
-                    assign_output_devices(out_devices, &adev->primary_output->device_list);
+                if (device_set_has(&adev->primary_output->device_list, DEVICE_SET_OUT))
+                    assign_output_devices(out_devices, &adev->primary_output->device_list.list);
                 else
                     reassign_device_list(out_devices, AUDIO_DEVICE_OUT_SPEAKER, "");
             }
@@ -235,7 +235,7 @@ void keep_alive_start(ka_mode_t ka_mode)
     append_devices(&ka.active_devices, &out_devices);
     ka.prev_mode |= ka_mode;
     if (ka.state == STATE_ACTIVE) {
-        assign_devices(&ka.out->device_list, &ka.active_devices);
+        device_set_assign(&ka.out->device_list, &ka.active_devices);
         select_devices(adev, USECASE_AUDIO_PLAYBACK_SILENCE);
     } else if (ka.state == STATE_IDLE) {
         keep_alive_start_l();
@@ -274,8 +274,8 @@ static int keep_alive_start_l()
     }
 
     ka.out->flags = 0;
-    list_init(&ka.out->device_list);
-    assign_devices(&ka.out->device_list, &ka.active_devices);
+    device_set_init(&ka.out->device_list);
+    device_set_assign(&ka.out->device_list, &ka.active_devices);
     ka.out->dev = adev;
     ka.out->format = AUDIO_FORMAT_PCM_16_BIT;
     ka.out->sample_rate = DEFAULT_OUTPUT_SAMPLING_RATE;
@@ -286,7 +286,7 @@ static int keep_alive_start_l()
     usecase->stream.out = ka.out;
     usecase->type = PCM_PLAYBACK;
     usecase->id = USECASE_AUDIO_PLAYBACK_SILENCE;
-    list_init(&usecase->device_list);
+    device_set_init(&usecase->device_list);
     usecase->out_snd_device = SND_DEVICE_NONE;
     usecase->in_snd_device = SND_DEVICE_NONE;
 
@@ -341,8 +341,8 @@ void keep_alive_stop(ka_mode_t ka_mode)
 
     if (list_empty(&ka.active_devices)) {
         keep_alive_cleanup();
-    } else if (!compare_devices(&ka.out->device_list, &ka.active_devices)) {
-        assign_devices(&ka.out->device_list, &ka.active_devices);
+    } else if (!compare_devices(&ka.out->device_list.list, &ka.active_devices)) {
+        device_set_assign(&ka.out->device_list, &ka.active_devices);
         select_devices(adev, USECASE_AUDIO_PLAYBACK_SILENCE);
     }
 exit:
@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) 2021, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of The Linux Foundation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define LOG_TAG "lock_stats"
+/*#define LOG_NDEBUG 0*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <log/log.h>
+
+#include "lock_stats.h"
+
+static uint64_t lock_stats_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+void lock_stats_init(struct lock_stats *stats, const char *name, bool enabled)
+{
+    memset(stats, 0, sizeof(*stats));
+    stats->name = name;
+    stats->enabled = enabled;
+    if (enabled)
+        ALOGI("%s: contention stats enabled for %s", __func__, name);
+}
+
+void lock_stats_lock(struct lock_stats *stats, pthread_mutex_t *mutex,
+                     struct lock_site *site)
+{
+    uint64_t start, now;
+    bool contended = false;
+
+    if (stats == NULL || !stats->enabled) {
+        pthread_mutex_lock(mutex);
+        return;
+    }
+
+    start = lock_stats_now_ns();
+    if (pthread_mutex_trylock(mutex) != 0) {
+        contended = true;
+        pthread_mutex_lock(mutex);
+    }
+    now = lock_stats_now_ns();
+
+    if (!site->registered) {
+        site->next = stats->sites;
+        stats->sites = site;
+        site->registered = true;
+    }
+    site->count++;
+    if (contended) {
+        site->contended++;
+        site->wait_ns += now - start;
+        if (now - start > site->max_wait_ns)
+            site->max_wait_ns = now - start;
+    }
+    stats->holder = site;
+    stats->acquired_ns = now;
+}
+
+void lock_stats_unlock(struct lock_stats *stats, pthread_mutex_t *mutex)
+{
+    struct lock_site *site = stats ? stats->holder : NULL;
+    uint64_t held;
+
+    if (site != NULL && stats->enabled) {
+        held = lock_stats_now_ns() - stats->acquired_ns;
+        site->hold_ns += held;
+        if (held > site->max_hold_ns)
+            site->max_hold_ns = held;
+        stats->holder = NULL;
+    }
+    pthread_mutex_unlock(mutex);
+}
+
+static int lock_site_cmp(const void *a, const void *b)
+{
+    const struct lock_site *sa = (const struct lock_site *)a;
+    const struct lock_site *sb = (const struct lock_site *)b;
+
+    if (sa->wait_ns != sb->wait_ns)
+        return sa->wait_ns < sb->wait_ns ? 1 : -1;
+    if (sa->hold_ns != sb->hold_ns)
+        return sa->hold_ns < sb->hold_ns ? 1 : -1;
+    return 0;
+}
+
+void lock_stats_dump(struct lock_stats *stats, pthread_mutex_t *mutex, int fd)
+{
+    struct lock_site *site, *snapshot;
+    size_t count = 0, i;
+
+    if (!stats->enabled)
+        return;
+
+    /* copy under the lock, print without it */
+    pthread_mutex_lock(mutex);
+    for (site = stats->sites; site != NULL; site = site->next)
+        count++;
+    snapshot = (struct lock_site *)calloc(count ? count : 1, sizeof(*snapshot));
+    if (snapshot == NULL) {
+        pthread_mutex_unlock(mutex);
+        ALOGE("%s: failed to allocate %zu sites", __func__, count);
+        return;
+    }
+    for (i = 0, site = stats->sites; site != NULL; site = site->next, i++)
+        snapshot[i] = *site;
+    pthread_mutex_unlock(mutex);
+
+    qsort(snapshot, count, sizeof(*snapshot), lock_site_cmp);
+
+    dprintf(fd, "%s contention, %zu sites (times in us):\n", stats->name, count);
+    dprintf(fd, "  %-40s %6s %10s %10s %12s %10s %12s %10s\n", "site", "line",
+            "count", "contended", "wait", "max_wait", "hold", "max_hold");
+    for (i = 0; i < count; i++) {
+        site = &snapshot[i];
+        dprintf(fd, "  %-40s %6d %10llu %10llu %12llu %10llu %12llu %10llu\n",
+                site->func, site->line,
+                (unsigned long long)site->count,
+                (unsigned long long)site->contended,
+                (unsigned long long)(site->wait_ns / 1000),
+                (unsigned long long)(site->max_wait_ns / 1000),
+                (unsigned long long)(site->hold_ns / 1000),
+                (unsigned long long)(site->max_hold_ns / 1000));
+    }
+    free(snapshot);
+}
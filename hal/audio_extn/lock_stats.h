@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2021, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of The Linux Foundation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef AUDIO_HW_EXTN_LOCK_STATS_H
+#define AUDIO_HW_EXTN_LOCK_STATS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+
+/*
+ * Contention accounting for a mutex, per acquisition site. Each site records
+ * how often it took the lock, how often it had to wait, and the total and
+ * worst wait and hold times. All counters are updated with the mutex held, so
+ * the accounting itself needs no extra synchronization.
+ *
+ * Sites are static objects at each LOCK_STATS_LOCK() call, so a given line
+ * must always account to the same lock_stats. Acquisitions made with plain
+ * pthread calls are not accounted. When the stats are disabled a
+ * lock/unlock costs one extra branch.
+ */
+
+struct lock_site {
+    const char *func;
+    int line;
+    struct lock_site *next;     /* registered sites of the owning lock_stats */
+    bool registered;
+    uint64_t count;
+    uint64_t contended;
+    uint64_t wait_ns;
+    uint64_t max_wait_ns;
+    uint64_t hold_ns;
+    uint64_t max_hold_ns;
+};
+
+struct lock_stats {
+    const char *name;
+    bool enabled;
+    struct lock_site *sites;
+    struct lock_site *holder;   /* site currently holding the mutex */
+    uint64_t acquired_ns;
+};
+
+void lock_stats_init(struct lock_stats *stats, const char *name, bool enabled);
+/* a NULL stats locks and unlocks without accounting */
+void lock_stats_lock(struct lock_stats *stats, pthread_mutex_t *mutex,
+                     struct lock_site *site);
+void lock_stats_unlock(struct lock_stats *stats, pthread_mutex_t *mutex);
+/* prints the sites ordered by total wait time, nothing when disabled */
+void lock_stats_dump(struct lock_stats *stats, pthread_mutex_t *mutex, int fd);
+
+/* locks mutex, accounting the wait and hold times to the calling line */
+#define LOCK_STATS_LOCK(stats, mutex)                                        \
+    do {                                                                     \
+        static struct lock_site lock_site_ = { .func = __func__,             \
+                                               .line = __LINE__ };           \
+        lock_stats_lock((stats), (mutex), &lock_site_);                      \
+    } while (0)
+
+#endif /* AUDIO_HW_EXTN_LOCK_STATS_H */
@@ -256,16 +256,16 @@ static inline bool valid_usecase(struct audio_usecase *usecase)
          (usecase->id == USECASE_AUDIO_PLAYBACK_LOW_LATENCY) ||
          (usecase->id == USECASE_AUDIO_PLAYBACK_OFFLOAD)) &&
         /* support devices */
-        (compare_device_type(&usecase->device_list, AUDIO_DEVICE_OUT_SPEAKER) ||
-         compare_device_type(&usecase->device_list, AUDIO_DEVICE_OUT_SPEAKER_SAFE) ||
-         (is_usb_out_device_type(&usecase->device_list) &&
+        (device_set_has_type(&usecase->device_list, AUDIO_DEVICE_OUT_SPEAKER) ||
+         device_set_has_type(&usecase->device_list, AUDIO_DEVICE_OUT_SPEAKER_SAFE) ||
+         (device_set_has(&usecase->device_list, DEVICE_SET_USB_OUT) &&
           ma_supported_usb())))
         /* TODO: enable A2DP when it is ready */
 
         return true;
 
     ALOGV("%s: not support type %d usecase %d device %d",
-           __func__, usecase->type, usecase->id, get_device_types(&usecase->device_list));
+           __func__, usecase->type, usecase->id, device_set_types(&usecase->device_list));
 
     return false;
 }
@@ -306,7 +306,7 @@ static bool check_and_send_all_audio_cal(struct audio_device *adev, ma_cmd_t cmd
         usecase = node_to_item(node, struct audio_usecase, list);
         if (usecase->stream.out && valid_usecase(usecase)) {
             ma_cal.common.app_type = usecase->stream.out->app_type_cfg.app_type;
-            assign_devices(&ma_cal.common.devices, &usecase->stream.out->device_list);
+            assign_devices(&ma_cal.common.devices, &usecase->stream.out->device_list.list);
             ALOGV("%s: send usecase(%d) app_type(%d) device(%d)",
                       __func__, usecase->id, ma_cal.common.app_type,
                       get_device_types(&ma_cal.common.devices));
@@ -720,7 +720,7 @@ void ma_set_device(struct audio_usecase *usecase)
 
     /* update audio_cal and send it */
     ma_cal.common.app_type = usecase->stream.out->app_type_cfg.app_type;
-    assign_devices(&ma_cal.common.devices, &usecase->stream.out->device_list);
+    assign_devices(&ma_cal.common.devices, &usecase->stream.out->device_list.list);
     ALOGV("%s: send usecase(%d) app_type(%d) device(%d)",
               __func__, usecase->id, ma_cal.common.app_type,
               get_device_types(&ma_cal.common.devices));
@@ -0,0 +1,231 @@
+/*
+ * Copyright (c) 2021, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of The Linux Foundation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define LOG_TAG "param_router"
+/*#define LOG_NDEBUG 0*/
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <log/log.h>
+
+#include "param_router.h"
+#include "lock_stats.h"
+
+struct param_handler {
+    const char *name;
+    uint32_t flags;
+    param_handler_t handler;
+};
+
+struct param_key {
+    const char *name;
+    size_t len;
+    uint32_t handlers;      /* bit i set: handlers[i] reads this key */
+};
+
+struct param_router {
+    struct param_handler handlers[PARAM_ROUTER_MAX_HANDLERS];
+    unsigned int num_handlers;
+    struct param_key *keys; /* sorted by name for bsearch */
+    unsigned int num_keys;
+    uint32_t any_key_handlers;
+    uint32_t all_key_handlers;
+};
+
+static int key_cmp(const char *a, size_t a_len, const char *b, size_t b_len)
+{
+    int ret = strncmp(a, b, a_len < b_len ? a_len : b_len);
+
+    if (ret != 0)
+        return ret;
+    return (a_len > b_len) - (a_len < b_len);
+}
+
+/* Returns the index of name in the key table, or the insertion point as -(i + 1). */
+static int find_key(const struct param_router *router, const char *name, size_t len)
+{
+    int lo = 0, hi = (int)router->num_keys - 1;
+
+    while (lo <= hi) {
+        int mid = lo + (hi - lo) / 2;
+        const struct param_key *key = &router->keys[mid];
+        int ret = key_cmp(name, len, key->name, key->len);
+
+        if (ret == 0)
+            return mid;
+        if (ret < 0)
+            hi = mid - 1;
+        else
+            lo = mid + 1;
+    }
+    return -(lo + 1);
+}
+
+static int add_key(struct param_router *router, const char *name, uint32_t handler_bit)
+{
+    struct param_key *keys;
+    size_t len = strlen(name);
+    int idx = find_key(router, name, len);
+
+    if (idx >= 0) {
+        router->keys[idx].handlers |= handler_bit;
+        return 0;
+    }
+
+    keys = realloc(router->keys, (router->num_keys + 1) * sizeof(*keys));
+    if (keys == NULL)
+        return -ENOMEM;
+    router->keys = keys;
+
+    idx = -idx - 1;
+    memmove(&keys[idx + 1], &keys[idx], (router->num_keys - idx) * sizeof(*keys));
+    keys[idx].name = name;
+    keys[idx].len = len;
+    keys[idx].handlers = handler_bit;
+    router->num_keys++;
+    return 0;
+}
+
+struct param_router *param_router_create(void)
+{
+    return calloc(1, sizeof(struct param_router));
+}
+
+void param_router_destroy(struct param_router *router)
+{
+    if (router == NULL)
+        return;
+
+    free(router->keys);
+    free(router);
+}
+
+int param_router_register(struct param_router *router, const char *name,
+                          const char * const *keys, uint32_t flags,
+                          param_handler_t handler)
+{
+    uint32_t bit;
+    int ret;
+
+    if (router == NULL || handler == NULL)
+        return -EINVAL;
+
+    if (router->num_handlers == PARAM_ROUTER_MAX_HANDLERS) {
+        ALOGE("%s: no room for handler %s", __func__, name);
+        return -ENOSPC;
+    }
+
+    bit = 1u << router->num_handlers;
+    for (; keys != NULL && *keys != NULL; keys++) {
+        ret = add_key(router, *keys, bit);
+        if (ret != 0)
+            return ret;
+    }
+    if (flags & PARAM_HANDLER_ANY_KEY)
+        router->any_key_handlers |= bit;
+    if (flags & PARAM_HANDLER_ALL_KEYS)
+        router->all_key_handlers |= bit;
+
+    router->handlers[router->num_handlers].name = name;
+    router->handlers[router->num_handlers].flags = flags;
+    router->handlers[router->num_handlers].handler = handler;
+    router->num_handlers++;
+    return 0;
+}
+
+/* Scans the keys of kvpairs the same way str_parms_create_str() splits them. */
+static uint32_t match_handlers(const struct param_router *router, const char *kvpairs)
+{
+    uint32_t handlers = router->all_key_handlers;
+    const char *p = kvpairs;
+
+    while (*p != '\0') {
+        size_t len = strcspn(p, "=;");
+
+        if (len > 0) {
+            int idx = find_key(router, p, len);
+
+            if (idx >= 0)
+                handlers |= router->keys[idx].handlers;
+            else
+                handlers |= router->any_key_handlers;
+        }
+        p += len;
+        if (*p == '=')
+            p += strcspn(p, ";");
+        if (*p == ';')
+            p++;
+    }
+    return handlers;
+}
+
+int param_router_dispatch(struct param_router *router, struct audio_device *adev,
+                          pthread_mutex_t *lock, struct lock_stats *lock_stats,
+                          const char *kvpairs)
+{
+    struct str_parms *parms;
+    uint32_t handlers;
+    bool locked = false;
+    unsigned int i;
+    int status = 0;
+
+    if (router == NULL || kvpairs == NULL)
+        return -EINVAL;
+
+    handlers = match_handlers(router, kvpairs);
+    if (handlers == 0)
+        return 0;
+
+    parms = str_parms_create_str(kvpairs);
+    if (parms == NULL)
+        return 0;
+
+    for (i = 0; i < router->num_handlers && status == 0; i++) {
+        const struct param_handler *h = &router->handlers[i];
+        bool needs_lock = (h->flags & PARAM_HANDLER_LOCKED) != 0;
+
+        if (!(handlers & (1u << i)))
+            continue;
+
+        if (needs_lock && !locked)
+            LOCK_STATS_LOCK(lock_stats, lock);
+        else if (!needs_lock && locked)
+            lock_stats_unlock(lock_stats, lock);
+        locked = needs_lock;
+
+        ALOGV("%s: running %s", __func__, h->name);
+        status = h->handler(adev, parms);
+    }
+
+    if (locked)
+        lock_stats_unlock(lock_stats, lock);
+    str_parms_destroy(parms);
+    return status;
+}
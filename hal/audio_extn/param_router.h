@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2021, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of The Linux Foundation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef AUDIO_HW_EXTN_PARAM_ROUTER_H
+#define AUDIO_HW_EXTN_PARAM_ROUTER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <cutils/str_parms.h>
+
+/*
+ * Key indexed dispatch of adev_set_parameters(). Each subsystem registers the
+ * keys it reads; a kvpairs string is scanned once for its keys and only the
+ * handlers owning one of them run, in registration order.
+ *
+ * Subsystems whose key set is open ended (voice, platform, the audio_extn
+ * fan-out) register with PARAM_HANDLER_ANY_KEY and run whenever kvpairs holds
+ * a key no handler registered, plus for the keys they list explicitly.
+ */
+
+/* handler flags */
+#define PARAM_HANDLER_LOCKED   (1 << 0) /* runs with adev->lock held */
+#define PARAM_HANDLER_ANY_KEY  (1 << 1) /* runs for keys nobody registered */
+#define PARAM_HANDLER_ALL_KEYS (1 << 2) /* runs on every call */
+
+#define PARAM_ROUTER_MAX_HANDLERS 32
+
+struct audio_device;
+struct lock_stats;
+struct param_router;
+
+/*
+ * A non-zero return stops the dispatch and becomes the status of
+ * adev_set_parameters().
+ */
+typedef int (*param_handler_t)(struct audio_device *adev, struct str_parms *parms);
+
+struct param_router *param_router_create(void);
+void param_router_destroy(struct param_router *router);
+
+/*
+ * keys is a NULL terminated array which must outlive the router. May be NULL
+ * for PARAM_HANDLER_ANY_KEY and PARAM_HANDLER_ALL_KEYS handlers.
+ */
+int param_router_register(struct param_router *router, const char *name,
+                          const char * const *keys, uint32_t flags,
+                          param_handler_t handler);
+
+/*
+ * Parses kvpairs once and runs the matching handlers. lock is taken around
+ * consecutive PARAM_HANDLER_LOCKED handlers and accounted to lock_stats,
+ * which may be NULL.
+ */
+int param_router_dispatch(struct param_router *router, struct audio_device *adev,
+                          pthread_mutex_t *lock, struct lock_stats *lock_stats,
+                          const char *kvpairs);
+
+#endif /* AUDIO_HW_EXTN_PARAM_ROUTER_H */
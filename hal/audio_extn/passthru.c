@@ -260,7 +260,7 @@ bool passthru_should_drop_data(struct stream_out * out)
 #endif
     }
 
-    if (compare_device_type(&out->device_list, AUDIO_DEVICE_OUT_AUX_DIGITAL) &&
+    if (device_set_has_type(&out->device_list, AUDIO_DEVICE_OUT_AUX_DIGITAL) &&
         (((out->format & AUDIO_FORMAT_MAIN_MASK) == AUDIO_FORMAT_PCM) ||
         (compr_passthr == LEGACY_PCM))) {
         if (android_atomic_acquire_load(&compress_passthru_active) > 0) {
@@ -296,7 +296,7 @@ void passthru_on_start(struct stream_out * out)
         list_for_each(node, &adev->usecase_list) {
             usecase = node_to_item(node, struct audio_usecase, list);
             if (usecase->stream.out && usecase->type == PCM_PLAYBACK &&
-                compare_device_type(&usecase->device_list, AUDIO_DEVICE_OUT_AUX_DIGITAL)) {
+                device_set_has_type(&usecase->device_list, AUDIO_DEVICE_OUT_AUX_DIGITAL)) {
                 o = usecase->stream.out;
                 temp = o->config.period_size * 1000000LL / o->sample_rate;
                 if (temp > max_period_us)
@@ -305,10 +305,10 @@ void passthru_on_start(struct stream_out * out)
         }
 
         if (max_period_us) {
-            pthread_mutex_unlock(&adev->lock);
+            ADEV_UNLOCK(adev);
             usleep(2*max_period_us);
             max_period_us = 0;
-            pthread_mutex_lock(&adev->lock);
+            ADEV_LOCK(adev);
         } else
             break;
     }
@@ -325,7 +325,7 @@ void passthru_on_stop(struct stream_out * out)
         android_atomic_dec(&compress_passthru_active);
     }
 
-    if (compare_device_type(&out->device_list, AUDIO_DEVICE_OUT_AUX_DIGITAL)) {
+    if (device_set_has_type(&out->device_list, AUDIO_DEVICE_OUT_AUX_DIGITAL)) {
         ALOGD("%s: passthru on aux digital, start keep alive", __func__);
         fp_audio_extn_keep_alive_start(KEEP_ALIVE_OUT_HDMI);
     }
@@ -506,7 +506,7 @@ bool passthru_is_passthrough_stream(struct stream_out *out)
     }
 
     //check supported device, currently only on HDMI.
-    if (compare_device_type(&out->device_list, AUDIO_DEVICE_OUT_AUX_DIGITAL)) {
+    if (device_set_has_type(&out->device_list, AUDIO_DEVICE_OUT_AUX_DIGITAL)) {
         //passthrough flag
         if (out->flags & AUDIO_OUTPUT_FLAG_COMPRESS_PASSTHROUGH)
             return true;
@@ -464,7 +464,7 @@ static void close_all_pcm_hdmi_output()
         }
 
         if ((p_qaf->qaf_mod[i].stream_out[QAF_OUT_OFFLOAD])
-            && compare_device_type(
+            && device_set_has_type(
                    &p_qaf->qaf_mod[i].stream_out[QAF_OUT_OFFLOAD]->device_list,
                    AUDIO_DEVICE_OUT_AUX_DIGITAL)) {
             adev_close_output_stream((struct audio_hw_device *)p_qaf->adev,
@@ -527,7 +527,7 @@ static int create_qaf_passthrough_stream()
         config.offload_info.channel_mask = config.channel_mask = out->channel_mask;
 
         //Device is copied from the QAF passthrough input stream.
-        devices = get_device_types(&out->device_list);
+        devices = device_set_types(&out->device_list);
         flags = out->flags;
 
         ret = adev_open_output_stream((struct audio_hw_device *)p_qaf->adev,
@@ -713,7 +713,7 @@ static int qaf_start_output_stream(struct stream_out *out)
 
     ALOGD("%s: enter: stream(%p)usecase(%d: %s) devices(%#x)",
           __func__, &out->stream, out->usecase, use_case_table[out->usecase],
-          get_device_types(&out->device_list));
+          device_set_types(&out->device_list));
 
     if (CARD_STATUS_OFFLINE == out->card_status ||
         CARD_STATUS_OFFLINE == adev->card_status) {
@@ -773,9 +773,9 @@ static ssize_t qaf_out_write(struct audio_stream_out *stream, const void *buffer
         unlock_output_stream(out);
         return ret;
     } else if (out->standby) {
-        pthread_mutex_lock(&adev->lock);
+        ADEV_LOCK(adev);
         ret = qaf_start_output_stream(out);
-        pthread_mutex_unlock(&adev->lock);
+        ADEV_UNLOCK(adev);
         if (ret == 0) {
             out->standby = false;
         } else {
@@ -784,7 +784,7 @@ static ssize_t qaf_out_write(struct audio_stream_out *stream, const void *buffer
     }
 
     if ((adev->is_channel_status_set == false) &&
-         compare_device_type(&out->device_list, AUDIO_DEVICE_OUT_AUX_DIGITAL)) {
+         device_set_has_type(&out->device_list, AUDIO_DEVICE_OUT_AUX_DIGITAL)) {
         audio_utils_set_hdmi_channel_status(out, (char *)buffer, bytes);
         adev->is_channel_status_set = true;
     }
@@ -1640,9 +1640,9 @@ static void notify_event_callback(audio_session_handle_t session_handle __unused
                 audio_devices_t devices;
 
                 if (qaf_mod->stream_in[QAF_IN_MAIN])
-                    devices = get_device_types(&qaf_mod->stream_in[QAF_IN_MAIN]->device_list);
+                    devices = device_set_types(&qaf_mod->stream_in[QAF_IN_MAIN]->device_list);
                 else
-                    devices = get_device_types(&qaf_mod->stream_in[QAF_IN_PCM]->device_list);
+                    devices = device_set_types(&qaf_mod->stream_in[QAF_IN_PCM]->device_list);
 
                 //If multi channel pcm or passthrough is already enabled then remove the hdmi flag from device.
                 if (p_qaf->mch_pcm_hdmi_enabled || p_qaf->passthrough_enabled) {
@@ -2351,7 +2351,7 @@ static int qaf_out_set_parameters(struct audio_stream *stream, const char *kvpai
     /* Setting new device information to the mm module input streams.
      * This is needed if QAF module output streams are not created yet.
      */
-    reassign_device_list(&out->device_list, val, "");
+    device_set_reassign(&out->device_list, val, "");
 
 #ifndef A2DP_OFFLOAD_ENABLED
     if (val == AUDIO_DEVICE_OUT_BLUETOOTH_A2DP) {
@@ -208,6 +208,7 @@ struct sound_trigger_audio_device {
     pthread_mutex_t lock;
     unsigned int sthal_prop_api_version;
     bool st_ec_ref_enabled;
+    uint32_t ses_list_gen; /* bumped on session register and deregister */
 };
 
 static struct sound_trigger_audio_device *st_dev;
@@ -242,6 +243,23 @@ get_sound_trigger_info(int capture_handle)
     return NULL;
 }
 
+/*
+ * Session of a sound trigger stream. It is resolved when the stream is
+ * opened and looked up again only once sessions were registered or
+ * deregistered since, so LAB reads don't search the list under st_dev->lock.
+ */
+static struct sound_trigger_info *
+get_stream_sound_trigger_info(struct stream_in *in)
+{
+    if (in->st_ses_gen != __atomic_load_n(&st_dev->ses_list_gen, __ATOMIC_ACQUIRE)) {
+        pthread_mutex_lock(&st_dev->lock);
+        in->st_ses_ctx = get_sound_trigger_info(in->capture_handle);
+        in->st_ses_gen = st_dev->ses_list_gen;
+        pthread_mutex_unlock(&st_dev->lock);
+    }
+    return in->st_ses_ctx;
+}
+
 static int populate_usecase(struct audio_hal_usecase *usecase,
                        struct audio_usecase *uc_info)
 {
@@ -342,13 +360,14 @@ int audio_hw_call_back(sound_trigger_event_type_t event,
         ALOGV("%s: add capture_handle %d st session opaque ptr %p", __func__,
               st_ses_info->st_ses.capture_handle, st_ses_info->st_ses.p_ses);
         list_add_tail(&st_dev->st_ses_list, &st_ses_info->list);
+        __atomic_add_fetch(&st_dev->ses_list_gen, 1, __ATOMIC_RELEASE);
         break;
 
     case ST_EVENT_START_KEEP_ALIVE:
         pthread_mutex_unlock(&st_dev->lock);
-        pthread_mutex_lock(&st_dev->adev->lock);
+        ADEV_LOCK(st_dev->adev);
         audio_extn_keep_alive_start(KEEP_ALIVE_OUT_PRIMARY);
-        pthread_mutex_unlock(&st_dev->adev->lock);
+        ADEV_UNLOCK(st_dev->adev);
         goto done;
 
     case ST_EVENT_SESSION_DEREGISTER:
@@ -366,14 +385,15 @@ int audio_hw_call_back(sound_trigger_event_type_t event,
         ALOGV("%s: remove capture_handle %d st session opaque ptr %p", __func__,
               st_ses_info->st_ses.capture_handle, st_ses_info->st_ses.p_ses);
         list_remove(&st_ses_info->list);
+        __atomic_add_fetch(&st_dev->ses_list_gen, 1, __ATOMIC_RELEASE);
         free(st_ses_info);
         break;
 
     case ST_EVENT_STOP_KEEP_ALIVE:
         pthread_mutex_unlock(&st_dev->lock);
-        pthread_mutex_lock(&st_dev->adev->lock);
+        ADEV_LOCK(st_dev->adev);
         audio_extn_keep_alive_stop(KEEP_ALIVE_OUT_PRIMARY);
-        pthread_mutex_unlock(&st_dev->adev->lock);
+        ADEV_UNLOCK(st_dev->adev);
         goto done;
 
     case ST_EVENT_UPDATE_ECHO_REF:
@@ -409,9 +429,7 @@ int audio_extn_sound_trigger_read(struct stream_in *in, void *buffer,
         goto exit;
     }
 
-    pthread_mutex_lock(&st_dev->lock);
-    st_info = get_sound_trigger_info(in->capture_handle);
-    pthread_mutex_unlock(&st_dev->lock);
+    st_info = get_stream_sound_trigger_info(in);
     if (st_info) {
         event.u.aud_info.ses_info = &st_info->st_ses;
         event.u.aud_info.buf = buffer;
@@ -425,8 +443,9 @@ exit:
             in->is_st_session_active = false;
         memset(buffer, 0, bytes);
         ALOGV("%s: read failed status %d - sleep", __func__, ret);
-        usleep(((useconds_t)bytes * 1000000) / (audio_stream_in_frame_size((struct audio_stream_in *)in) *
-                                   in->config.rate));
+        audio_extn_utils_sleep_silence(&in->silence_deadline, bytes,
+                audio_stream_in_frame_size((struct audio_stream_in *)in),
+                in->config.rate);
     }
     return ret;
 }
@@ -439,9 +458,7 @@ void audio_extn_sound_trigger_stop_lab(struct stream_in *in)
     if (!st_dev || !in || !in->is_st_session_active)
        return;
 
-    pthread_mutex_lock(&st_dev->lock);
-    st_ses_info = get_sound_trigger_info(in->capture_handle);
-    pthread_mutex_unlock(&st_dev->lock);
+    st_ses_info = get_stream_sound_trigger_info(in);
     if (st_ses_info) {
         event.u.ses_info = st_ses_info->st_ses;
         ALOGV("%s: AUDIO_EVENT_STOP_LAB st sess %p", __func__, st_ses_info->st_ses.p_ses);
@@ -459,6 +476,8 @@ void audio_extn_sound_trigger_check_and_get_session(struct stream_in *in)
 
     pthread_mutex_lock(&st_dev->lock);
     in->is_st_session = false;
+    in->st_ses_ctx = NULL;
+    in->st_ses_gen = st_dev->ses_list_gen;
     ALOGV("%s: list %d capture_handle %d", __func__,
           list_empty(&st_dev->st_ses_list), in->capture_handle);
     list_for_each(node, &st_dev->st_ses_list) {
@@ -468,6 +487,7 @@ void audio_extn_sound_trigger_check_and_get_session(struct stream_in *in)
             in->channel_mask = audio_channel_in_mask_from_count(in->config.channels);
             in->is_st_session = true;
             in->is_st_session_active = true;
+            in->st_ses_ctx = st_ses_info;
             ALOGD("%s: capture_handle %d is sound trigger", __func__, in->capture_handle);
             break;
         }
@@ -610,7 +630,7 @@ void audio_extn_sound_trigger_update_stream_status(struct audio_usecase *uc_info
     if (raise_event) {
         if (uc_info->type == PCM_PLAYBACK) {
             if (uc_info->stream.out)
-                assign_devices(&ev_info.device_info.devices, &uc_info->stream.out->device_list);
+                assign_devices(&ev_info.device_info.devices, &uc_info->stream.out->device_list.list);
             else
                 reassign_device_list(&ev_info.device_info.devices,
                                      AUDIO_DEVICE_OUT_SPEAKER, "");
@@ -114,6 +114,8 @@ enum sp_version {
 #define WAIT_TIME_SPKR_CALIB (60 * 1000 * 1000)
 
 #define MIN_SPKR_IDLE_SEC (60 * 30)
+/*Retry interval for conditions no event is raised for: an active usecase
+  or a speaker temperature out of the calibration range*/
 #define WAKEUP_MIN_IDLE_CHECK 30
 
 /*Once calibration is started sleep for 3 sec to allow
@@ -218,8 +220,14 @@ struct speaker_prot_session {
     void (*thermal_client_unregister_callback)(int handle);
     int (*thermal_client_request)(char *client_name, int req_data);
     bool spkr_prot_enable;
+    /* speaker use and idle start, under cal_wait_cond_mutex */
     bool spkr_in_use;
     struct timespec spkr_last_time_used;
+    bool cal_wait_event;
+    unsigned long min_idle_time;
+    bool quick_calib;
+    unsigned int afe_api_version;
+    enum sp_version sp_prop_version;
     struct spkr_prot_r0t0 sp_r0t0_cal;
     bool wsa_found;
     bool is_wsa_temp_mixer_ctl;
@@ -419,12 +427,18 @@ int get_tzn(const char *sensor_name)
 
 static void spkr_prot_set_spkrstatus(bool enable)
 {
+    pthread_mutex_lock(&handle.cal_wait_cond_mutex);
     if (enable)
        handle.spkr_in_use = true;
-    else {
+    else if (handle.spkr_in_use) {
+       /* already idle, e.g. warm standby, keep the time it went idle */
        handle.spkr_in_use = false;
        clock_gettime(CLOCK_BOOTTIME, &handle.spkr_last_time_used);
+       /* idle window starts, let the calibration thread arm its deadline */
+       handle.cal_wait_event = true;
+       pthread_cond_signal(&handle.cal_wait_condition);
    }
+    pthread_mutex_unlock(&handle.cal_wait_cond_mutex);
 }
 
 void spkr_prot_calib_cancel(void *adev)
@@ -455,18 +469,22 @@ void spkr_prot_calib_cancel(void *adev)
 static bool is_speaker_in_use(unsigned long *sec)
 {
     struct timespec temp;
+    bool in_use;
+
     if (!sec) {
         ALOGE("%s: Invalid params", __func__);
         return true;
     }
-    if (handle.spkr_in_use) {
+    pthread_mutex_lock(&handle.cal_wait_cond_mutex);
+    in_use = handle.spkr_in_use;
+    if (in_use) {
         *sec = 0;
-        return true;
     } else {
         clock_gettime(CLOCK_BOOTTIME, &temp);
         *sec = temp.tv_sec - handle.spkr_last_time_used.tv_sec;
-        return false;
     }
+    pthread_mutex_unlock(&handle.cal_wait_cond_mutex);
+    return in_use;
 }
 
 
@@ -515,7 +533,6 @@ static int set_spkr_prot_cal(int cal_fd,
 {
     int ret = 0;
     struct audio_cal_fb_spk_prot_cfg    cal_data;
-    char value[PROPERTY_VALUE_MAX];
     static int cal_done = 0;
 
     if (cal_fd < 0) {
@@ -547,20 +564,9 @@ static int set_spkr_prot_cal(int cal_fd,
     cal_data.cal_type.cal_info.limiter_th[SP_V2_SPKR_1] = protCfg->limiter_th[SP_V2_SPKR_1];
     cal_data.cal_type.cal_info.limiter_th[SP_V2_SPKR_2] = protCfg->limiter_th[SP_V2_SPKR_2];
 #endif
-    property_get("persist.vendor.audio.spkr.cal.duration", value, "0");
-    if (atoi(value) > 0) {
-        ALOGD("%s: quick calibration enabled", __func__);
-        cal_data.cal_type.cal_info.quick_calib_flag = 1;
-    } else {
-        property_get("persist.spkr.cal.duration", value, "0");
-        if (atoi(value) > 0) {
-            ALOGD("%s: quick calibration enabled", __func__);
-            cal_data.cal_type.cal_info.quick_calib_flag = 1;
-        } else {
-            ALOGD("%s: quick calibration disabled", __func__);
-            cal_data.cal_type.cal_info.quick_calib_flag = 0;
-        }
-    }
+    ALOGD("%s: quick calibration %s", __func__,
+          handle.quick_calib ? "enabled" : "disabled");
+    cal_data.cal_type.cal_info.quick_calib_flag = handle.quick_calib ? 1 : 0;
 
     cal_data.cal_type.cal_data.mem_handle = -1;
 
@@ -901,7 +907,7 @@ static int spkr_calibrate(int t0_spk_1, int t0_spk_2)
     uc_info_rx->type = PCM_PLAYBACK;
     uc_info_rx->in_snd_device = SND_DEVICE_NONE;
     uc_info_rx->stream.out = adev->primary_output;
-    list_init(&uc_info_rx->device_list);
+    device_set_init(&uc_info_rx->device_list);
     if (fp_audio_extn_is_vbat_enabled())
         uc_info_rx->out_snd_device = SND_DEVICE_OUT_SPEAKER_PROTECTED_VBAT;
     else
@@ -943,7 +949,7 @@ static int spkr_calibrate(int t0_spk_1, int t0_spk_2)
     uc_info_tx->type = PCM_CAPTURE;
     uc_info_tx->in_snd_device = SND_DEVICE_IN_CAPTURE_VI_FEEDBACK;
     uc_info_tx->out_snd_device = SND_DEVICE_NONE;
-    list_init(&uc_info_tx->device_list);
+    device_set_init(&uc_info_tx->device_list);
 
     disable_tx = true;
     list_add_tail(&adev->usecase_list, &uc_info_tx->list);
@@ -990,7 +996,7 @@ static int spkr_calibrate(int t0_spk_1, int t0_spk_2)
         }
     }
     pthread_mutex_lock(&handle.mutex_spkr_prot);
-    pthread_mutex_unlock(&adev->lock);
+    ADEV_UNLOCK(adev);
     acquire_device = true;
     (void)pthread_cond_timedwait(&handle.spkr_calib_cancel,
         &handle.mutex_spkr_prot, &ts);
@@ -1055,7 +1061,23 @@ static int spkr_calibrate(int t0_spk_1, int t0_spk_2)
                 break;
             } else if (status.status == -EAGAIN) {
                   ALOGV("%s: spkr_prot_thread try again", __func__);
-                  usleep(WAIT_FOR_GET_CALIB_STATUS * 1000);
+                  /* wait on the cancel condition rather than sleeping, so a
+                   * usecase starting meanwhile does not wait out the status
+                   * polling */
+                  clock_gettime(CLOCK_MONOTONIC, &ts);
+                  ts.tv_nsec += WAIT_FOR_GET_CALIB_STATUS * 1000000;
+                  if (ts.tv_nsec >= 1000000000) {
+                      ts.tv_nsec -= 1000000000;
+                      ts.tv_sec += 1;
+                  }
+                  pthread_mutex_unlock(&handle.spkr_calib_cancelack_mutex);
+                  (void)pthread_cond_timedwait(&handle.spkr_calib_cancel,
+                      &handle.mutex_spkr_prot, &ts);
+                  pthread_mutex_lock(&handle.spkr_calib_cancelack_mutex);
+                  if (handle.cancel_spkr_calib) {
+                      status.status = -EAGAIN;
+                      goto exit;
+                  }
                   retry_duration += WAIT_FOR_GET_CALIB_STATUS;
             } else {
                 ALOGE("%s: spkr_prot_thread get failed status %d",
@@ -1122,74 +1144,166 @@ exit:
         }
     }
     if (acquire_device)
-        pthread_mutex_lock(&adev->lock);
+        ADEV_LOCK(adev);
     return status.status;
 }
 
-static void spkr_calibrate_wait()
+/*
+ * Sleeps until the next calibration scheduler event: the speaker going
+ * idle, a calibration trigger or thread exit, or timeout_sec seconds when
+ * it is non zero.
+ */
+static void spkr_calibrate_wait(unsigned long timeout_sec)
 {
     struct timespec ts;
 
-    clock_gettime(CLOCK_MONOTONIC, &ts);
-    ts.tv_sec += WAKEUP_MIN_IDLE_CHECK;
     pthread_mutex_lock(&handle.cal_wait_cond_mutex);
-    pthread_cond_timedwait(&handle.cal_wait_condition,
-                           &handle.cal_wait_cond_mutex, &ts);
+    if (!handle.cal_wait_event && !handle.thread_exit) {
+        if (timeout_sec) {
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            ts.tv_sec += timeout_sec;
+            pthread_cond_timedwait(&handle.cal_wait_condition,
+                                   &handle.cal_wait_cond_mutex, &ts);
+        } else {
+            pthread_cond_wait(&handle.cal_wait_condition,
+                              &handle.cal_wait_cond_mutex);
+        }
+    }
+    handle.cal_wait_event = false;
     pthread_mutex_unlock(&handle.cal_wait_cond_mutex);
 }
 
-static void* spkr_calibration_thread()
+/*
+ * Checks whether calibration can run now, with adev->lock held. If not,
+ * sets *wait_sec to how long the scheduler should sleep: 0 while the
+ * speaker is in use, since stopping it raises an event, the rest of the
+ * idle window when it is idle, WAKEUP_MIN_IDLE_CHECK otherwise.
+ */
+static bool spkr_calib_window_open(struct audio_device *adev,
+                                   unsigned long *wait_sec)
 {
     unsigned long sec = 0;
-    int t0;
+
+    if (is_speaker_in_use(&sec)) {
+        ALOGV("%s: Speaker in use retry calibration", __func__);
+        *wait_sec = 0;
+        return false;
+    }
+    if (!adev->primary_output) {
+        *wait_sec = WAKEUP_MIN_IDLE_CHECK;
+        return false;
+    }
+    if (sec < handle.min_idle_time && !handle.trigger_cal) {
+        ALOGD("%s: speaker idle %ld, minimum time %ld", __func__, sec,
+              handle.min_idle_time);
+        *wait_sec = handle.min_idle_time - sec;
+        return false;
+    }
+    if (!list_empty(&adev->usecase_list)) {
+        ALOGD("%s: Usecase active re-try calibration", __func__);
+        *wait_sec = WAKEUP_MIN_IDLE_CHECK;
+        return false;
+    }
+    return true;
+}
+
+/*
+ * Reads the WSA temperature of thermal zone tzn with the T0 init control
+ * enabled. Returns -EAGAIN if it is outside the calibration range, 0 and
+ * the temperature in q6 format otherwise.
+ */
+static int spkr_get_wsa_tz_temp(struct audio_device *adev, int tzn,
+                                const char *mixer_ctl_name, int *t0)
+{
+    char wsa_path[MAX_PATH] = {0};
+    char buf[32] = {0};
+    struct mixer_ctl *ctl;
+    int thermal_fd, ret, temp = 0;
+
+    snprintf(wsa_path, MAX_PATH, TZ_WSA, tzn);
+    ALOGV("%s: wsa_path: %s\n", __func__, wsa_path);
+    ctl = mixer_get_ctl_by_name(adev->mixer, mixer_ctl_name);
+    if (ctl) {
+        ALOGD("%s: Got ctl for mixer cmd %s", __func__, mixer_ctl_name);
+        mixer_ctl_set_value(ctl, 0, 1);
+    }
+    thermal_fd = open(wsa_path, O_RDONLY);
+    if (thermal_fd > 0) {
+        if ((ret = read(thermal_fd, buf, sizeof(buf))) >= 0)
+            temp = atoi(buf);
+        else
+            ALOGE("%s: read fail for %s err:%d\n", __func__, wsa_path, ret);
+        close(thermal_fd);
+    } else {
+        ALOGE("%s: fd for %s is NULL\n", __func__, wsa_path);
+    }
+    if (ctl)
+        mixer_ctl_set_value(ctl, 0, 0);
+    if (temp < TZ_TEMP_MIN_THRESHOLD || temp > TZ_TEMP_MAX_THRESHOLD)
+        return -EAGAIN;
+    ALOGD("%s: temp T0 for %s %d\n", __func__, mixer_ctl_name, temp);
+    /*Convert temp into q6 format*/
+    *t0 = temp * (1 << 6);
+    return 0;
+}
+
+/*
+ * Reads the T0 of both WSA speakers, with adev->lock held. Returns -EAGAIN
+ * if a speaker is outside the calibration range.
+ */
+static int spkr_get_wsa_t0(struct audio_device *adev, int *t0_spk_1,
+                           int *t0_spk_2)
+{
+    int temp;
+
+    if (handle.is_wsa_temp_mixer_ctl) {
+        if (!spkr_get_temp(adev, WSA_SPKR_LEFT, &temp)) {
+            if (temp < TZ_TEMP_MIN_THRESHOLD || temp > TZ_TEMP_MAX_THRESHOLD)
+                return -EAGAIN;
+            ALOGD("%s: temp T0 for spkr1 %d\n", __func__, temp);
+            /*Convert temp into q6 format*/
+            *t0_spk_1 = temp * (1 << 6);
+        }
+        if (!spkr_get_temp(adev, WSA_SPKR_RIGHT, &temp)) {
+            if (temp < TZ_TEMP_MIN_THRESHOLD || temp > TZ_TEMP_MAX_THRESHOLD)
+                return -EAGAIN;
+            ALOGD("%s: temp T0 for spkr2 %d\n", __func__, temp);
+            /*Convert temp into q6 format*/
+            *t0_spk_2 = temp * (1 << 6);
+        }
+        return 0;
+    }
+    if (handle.spkr_1_tzn >= 0 &&
+        spkr_get_wsa_tz_temp(adev, handle.spkr_1_tzn, "SpkrLeft WSA T0 Init",
+                             t0_spk_1))
+        return -EAGAIN;
+    if (handle.spkr_2_tzn >= 0 &&
+        spkr_get_wsa_tz_temp(adev, handle.spkr_2_tzn, "SpkrRight WSA T0 Init",
+                             t0_spk_2))
+        return -EAGAIN;
+    return 0;
+}
+
+/*
+ * Calibration scheduler. Instead of polling the speaker state, it sleeps
+ * until the speaker has been idle for min_idle_time, woken early by
+ * spkr_prot_stop_processing(), a calibration trigger or exit, and only
+ * then reads the speaker temperature, once per attempt.
+ */
+static void* spkr_calibration_thread()
+{
+    unsigned long wait_sec = 0;
+    int t0, status;
     int t0_spk_1 = 0;
     int t0_spk_2 = 0;
-    bool goahead = false;
     struct audio_cal_info_spk_prot_cfg protCfg;
     FILE *fp;
-    int acdb_fd, thermal_fd;
+    int acdb_fd;
     struct audio_device *adev = handle.adev_handle;
-    unsigned long min_idle_time = MIN_SPKR_IDLE_SEC;
-    char value[PROPERTY_VALUE_MAX];
-    char afe_version_value[PROPERTY_VALUE_MAX];
-    char wsa_path[MAX_PATH] = {0};
-    int spk_1_tzn, spk_2_tzn;
-    char buf[32] = {0};
-    int ret;
-    bool spv3_enable = false;
-    bool spv4_enable = false;
-    enum sp_version sp_prop_version = 0;
-    unsigned int afe_api_version = 0;
-    struct mixer_ctl *ctl;
 
     memset(&protCfg, 0, sizeof(protCfg));
-    /* If the value of this persist.vendor.audio.spkr.cal.duration is 0
-     * then it means it will take 30min to calibrate
-     * and if the value is greater than zero then it would take
-     * that much amount of time to calibrate.
-     */
-    property_get("persist.vendor.audio.spkr.cal.duration", value, "0");
-    if (atoi(value) > 0)
-        min_idle_time = atoi(value);
-    else {
-        property_get("persist.spkr.cal.duration", value, "0");
-        if (atoi(value) > 0)
-            min_idle_time = atoi(value);
-    }
     handle.speaker_prot_threadid = pthread_self();
-    spv3_enable = property_get_bool("persist.vendor.audio.spv3.enable", false);
-    property_get("persist.vendor.audio.avs.afe_api_version", afe_version_value,
-                 "0");
-    if (atoi(afe_version_value) > 0)
-        afe_api_version = atoi(afe_version_value);
-
-    spv4_enable = property_get_bool("persist.vendor.audio.spv4.enable", false);
-    if (spv4_enable)
-        sp_prop_version = SP_V4;
-    else if (spv3_enable)
-        sp_prop_version = SP_V3;
-
-    if(spv4_enable)
+    if (handle.sp_prop_version == SP_V4)
         handle.sp_version = SP_V4;
     ALOGD("spkr_prot_thread enable prot Entryi sp_version %d", handle.sp_version);
 
@@ -1253,7 +1367,8 @@ static void* spkr_calibration_thread()
                 } else
                     handle.spkr_prot_mode = MSM_SPKR_PROT_CALIBRATED;
 
-                set_boost_and_limiter(adev, afe_api_version, sp_prop_version);
+                set_boost_and_limiter(adev, handle.afe_api_version,
+                                      handle.sp_prop_version);
             }
         }
         if (handle.spkr_cal_dynamic || spkr_calibrated) {
@@ -1268,209 +1383,79 @@ static void* spkr_calibration_thread()
 
     ALOGV("%s: start calibration", __func__);
     while (!handle.thread_exit) {
+        ADEV_LOCK(adev);
+        if (!spkr_calib_window_open(adev, &wait_sec)) {
+            ADEV_UNLOCK(adev);
+            spkr_calibrate_wait(wait_sec);
+            continue;
+        }
         if (handle.wsa_found) {
-            if (!handle.is_wsa_temp_mixer_ctl) {
-                spk_1_tzn = handle.spkr_1_tzn;
-                spk_2_tzn = handle.spkr_2_tzn;
-            }
-            goahead = false;
-            pthread_mutex_lock(&adev->lock);
-            if (is_speaker_in_use(&sec)) {
-                ALOGV("%s: WSA Speaker in use retry calibration", __func__);
-                pthread_mutex_unlock(&adev->lock);
-                spkr_calibrate_wait();
+            if (spkr_get_wsa_t0(adev, &t0_spk_1, &t0_spk_2)) {
+                ADEV_UNLOCK(adev);
+                spkr_calibrate_wait(WAKEUP_MIN_IDLE_CHECK);
                 continue;
-            } else {
-                ALOGD("%s: wsa speaker idle %ld,minimum time %ld", __func__, sec, min_idle_time);
-                if (!adev->primary_output ||
-                    ((sec < min_idle_time) && !handle.trigger_cal)) {
-                    pthread_mutex_unlock(&adev->lock);
-                    spkr_calibrate_wait();
+            }
+        } else {
+            ADEV_UNLOCK(adev);
+            if (!handle.thermal_client_request("spkr",1)) {
+                ALOGD("%s: wait for callback from thermal daemon", __func__);
+                pthread_mutex_lock(&handle.spkr_prot_thermalsync_mutex);
+                pthread_cond_wait(&handle.spkr_prot_thermalsync,
+                &handle.spkr_prot_thermalsync_mutex);
+                /*Convert temp into q6 format*/
+                t0 = (handle.spkr_prot_t0 * (1 << 6));
+                pthread_mutex_unlock(&handle.spkr_prot_thermalsync_mutex);
+                if (t0 < MIN_SPKR_TEMP_Q6 || t0 > MAX_SPKR_TEMP_Q6) {
+                    ALOGE("%s: Calibration temparature error %d", __func__,
+                          handle.spkr_prot_t0);
+                    spkr_calibrate_wait(WAKEUP_MIN_IDLE_CHECK);
                     continue;
-               }
-               goahead = true;
-           }
-           if (!list_empty(&adev->usecase_list)) {
-                ALOGD("%s: Usecase active re-try calibration", __func__);
-                pthread_mutex_unlock(&adev->lock);
-                spkr_calibrate_wait();
-                continue;
-           }
-           if (goahead) {
-               if (handle.is_wsa_temp_mixer_ctl) {
-                   ret = spkr_get_temp(adev, WSA_SPKR_LEFT, &t0_spk_1);
-                   if (!ret) {
-                       if (t0_spk_1 < TZ_TEMP_MIN_THRESHOLD ||
-                           t0_spk_1 > TZ_TEMP_MAX_THRESHOLD) {
-                           pthread_mutex_unlock(&adev->lock);
-                           spkr_calibrate_wait();
-                           continue;
-                       }
-                       ALOGD("%s: temp T0 for spkr1 %d\n", __func__, t0_spk_1);
-                       /*Convert temp into q6 format*/
-                       t0_spk_1 = (t0_spk_1 * (1 << 6));
-                   }
-                   ret = spkr_get_temp(adev, WSA_SPKR_RIGHT, &t0_spk_2);
-                   if (!ret) {
-                       if (t0_spk_2 < TZ_TEMP_MIN_THRESHOLD ||
-                           t0_spk_2 > TZ_TEMP_MAX_THRESHOLD) {
-                           pthread_mutex_unlock(&adev->lock);
-                           spkr_calibrate_wait();
-                           continue;
-                       }
-                       ALOGD("%s: temp T0 for spkr2 %d\n", __func__, t0_spk_2);
-                       /*Convert temp into q6 format*/
-                       t0_spk_2 = (t0_spk_2 * (1 << 6));
-                   }
-               } else {
-                   if (spk_1_tzn >= 0) {
-                       const char *mixer_ctl_name = "SpkrLeft WSA T0 Init";
-                       snprintf(wsa_path, MAX_PATH, TZ_WSA, spk_1_tzn);
-                       ALOGV("%s: wsa_path: %s\n", __func__, wsa_path);
-                       thermal_fd = -1;
-
-                       ctl = mixer_get_ctl_by_name(adev->mixer, mixer_ctl_name);
-                       if (ctl) {
-                           ALOGD("%s: Got ctl for mixer cmd %s",
-                                 __func__, mixer_ctl_name);
-                            mixer_ctl_set_value(ctl, 0, 1);
-                        }
-                       thermal_fd = open(wsa_path, O_RDONLY);
-                       if (thermal_fd > 0) {
-                           if ((ret = read(thermal_fd, buf, sizeof(buf))) >= 0)
-                               t0_spk_1 = atoi(buf);
-                           else
-                               ALOGE("%s: read fail for %s err:%d\n",
-                                     __func__, wsa_path, ret);
-                            close(thermal_fd);
-                       } else {
-                           ALOGE("%s: fd for %s is NULL\n", __func__, wsa_path);
-                       }
-                       if (ctl) {
-                           mixer_ctl_set_value(ctl, 0, 0);
-                       }
-                       if (t0_spk_1 < TZ_TEMP_MIN_THRESHOLD ||
-                           t0_spk_1 > TZ_TEMP_MAX_THRESHOLD) {
-                           pthread_mutex_unlock(&adev->lock);
-                           spkr_calibrate_wait();
-                           continue;
-                       }
-                       ALOGD("%s: temp T0 for spkr1 %d\n", __func__, t0_spk_1);
-                       /*Convert temp into q6 format*/
-                       t0_spk_1 = (t0_spk_1 * (1 << 6));
-                   }
-                   if (spk_2_tzn >= 0) {
-                       const char *mixer_ctl_name = "SpkrRight WSA T0 Init";
-                       snprintf(wsa_path, MAX_PATH, TZ_WSA, spk_2_tzn);
-                       ALOGV("%s: wsa_path: %s\n", __func__, wsa_path);
-                       ctl = mixer_get_ctl_by_name(adev->mixer, mixer_ctl_name);
-                       if (ctl) {
-                           ALOGD("%s: Got ctl for mixer cmd %s",
-                                     __func__, mixer_ctl_name);
-                           mixer_ctl_set_value(ctl, 0, 1);
-                        }
-                        thermal_fd = open(wsa_path, O_RDONLY);
-                        if (thermal_fd > 0) {
-                           if ((ret = read(thermal_fd, buf, sizeof(buf))) >= 0)
-                               t0_spk_2 = atoi(buf);
-                           else
-                               ALOGE("%s: read fail for %s err:%d\n",
-                                     __func__, wsa_path, ret);
-                           close(thermal_fd);
-                        } else {
-                           ALOGE("%s: fd for %s is NULL\n", __func__, wsa_path);
-                        }
-                        if (ctl) {
-                           mixer_ctl_set_value(ctl, 0, 0);
-                        }
-                        if (t0_spk_2 < TZ_TEMP_MIN_THRESHOLD ||
-                           t0_spk_2 > TZ_TEMP_MAX_THRESHOLD) {
-                           pthread_mutex_unlock(&adev->lock);
-                           spkr_calibrate_wait();
-                           continue;
-                        }
-                        ALOGD("%s: temp T0 for spkr2 %d\n", __func__, t0_spk_2);
-                        /*Convert temp into q6 format*/
-                        t0_spk_2 = (t0_spk_2 * (1 << 6));
-                   }
-               }
-           }
-           pthread_mutex_unlock(&adev->lock);
-        } else if (!handle.thermal_client_request("spkr",1)) {
-            ALOGD("%s: wait for callback from thermal daemon", __func__);
-            pthread_mutex_lock(&handle.spkr_prot_thermalsync_mutex);
-            pthread_cond_wait(&handle.spkr_prot_thermalsync,
-            &handle.spkr_prot_thermalsync_mutex);
-            /*Convert temp into q6 format*/
-            t0 = (handle.spkr_prot_t0 * (1 << 6));
-            pthread_mutex_unlock(&handle.spkr_prot_thermalsync_mutex);
-            if (t0 < MIN_SPKR_TEMP_Q6 || t0 > MAX_SPKR_TEMP_Q6) {
-                ALOGE("%s: Calibration temparature error %d", __func__,
-                      handle.spkr_prot_t0);
+                }
+                t0_spk_1 = t0;
+                t0_spk_2 = t0;
+                ALOGD("%s: Request t0 success value %d", __func__,
+                handle.spkr_prot_t0);
+            } else {
+                ALOGE("%s: Request t0 failed", __func__);
+                /*Assume safe value for temparature*/
+                t0_spk_1 = SAFE_SPKR_TEMP_Q6;
+                t0_spk_2 = SAFE_SPKR_TEMP_Q6;
+            }
+            /* the speaker may have been used while waiting for the reading */
+            ADEV_LOCK(adev);
+            if (!spkr_calib_window_open(adev, &wait_sec)) {
+                ADEV_UNLOCK(adev);
+                spkr_calibrate_wait(wait_sec);
                 continue;
             }
-            t0_spk_1 = t0;
-            t0_spk_2 = t0;
-            ALOGD("%s: Request t0 success value %d", __func__,
-            handle.spkr_prot_t0);
-        } else {
-            ALOGE("%s: Request t0 failed", __func__);
-            /*Assume safe value for temparature*/
-            t0_spk_1 = SAFE_SPKR_TEMP_Q6;
-            t0_spk_2 = SAFE_SPKR_TEMP_Q6;
         }
-        goahead = false;
-        pthread_mutex_lock(&adev->lock);
-        if (is_speaker_in_use(&sec)) {
-            ALOGV("%s: Speaker in use retry calibration", __func__);
-            pthread_mutex_unlock(&adev->lock);
-            spkr_calibrate_wait();
-            continue;
+        /* DSP always calibrates 1st channel data in mono case.
+         * When wsatz14 is the only speaker on target, temperature
+         * sensor data comes in 2nd channel. Therefore, we have to swap
+         * sensor channel to fix the mismatch.
+         */
+        if (handle.is_wsa_temp_mixer_ctl) {
+            if (!handle.is_spkr1_avail && handle.is_spkr1_avail)
+                status = spkr_calibrate(t0_spk_2, t0_spk_1);
+            else
+                status = spkr_calibrate(t0_spk_1, t0_spk_2);
         } else {
-            if (!(sec > min_idle_time || handle.trigger_cal)) {
-                pthread_mutex_unlock(&adev->lock);
-                spkr_calibrate_wait();
-                continue;
-            }
-            goahead = true;
+            if ( handle.spkr_1_tzn <= 0 && handle.spkr_2_tzn > 0)
+                 status = spkr_calibrate(t0_spk_2, t0_spk_1);
+            else
+                 status = spkr_calibrate(t0_spk_1, t0_spk_2);
         }
-        if (!list_empty(&adev->usecase_list)) {
-            ALOGD("%s: Usecase active re-try calibration", __func__);
-            goahead = false;
-            pthread_mutex_unlock(&adev->lock);
-            spkr_calibrate_wait();
+        ADEV_UNLOCK(adev);
+        if (status == -EAGAIN) {
+            ALOGE("%s: failed to calibrate try again %s",
+            __func__, strerror(status));
             continue;
+        } else {
+            ALOGE("%s: calibrate status %s", __func__, strerror(status));
         }
-        if (goahead) {
-                int status;
-                /* DSP always calibrates 1st channel data in mono case.
-                 * When wsatz14 is the only speaker on target, temperature
-                 * sensor data comes in 2nd channel. Therefore, we have to swap
-                 * sensor channel to fix the mismatch.
-                 */
-                if (handle.is_wsa_temp_mixer_ctl) {
-                    if (!handle.is_spkr1_avail && handle.is_spkr1_avail)
-                        status = spkr_calibrate(t0_spk_2, t0_spk_1);
-                    else
-                        status = spkr_calibrate(t0_spk_1, t0_spk_2);
-                } else {
-                    if ( handle.spkr_1_tzn <= 0 && handle.spkr_2_tzn > 0)
-                         status = spkr_calibrate(t0_spk_2, t0_spk_1);
-                    else
-                         status = spkr_calibrate(t0_spk_1, t0_spk_2);
-                }
-                pthread_mutex_unlock(&adev->lock);
-                if (status == -EAGAIN) {
-                    ALOGE("%s: failed to calibrate try again %s",
-                    __func__, strerror(status));
-                    continue;
-                } else {
-                    ALOGE("%s: calibrate status %s", __func__, strerror(status));
-                }
-                ALOGD("%s: spkr_prot_thread end calibration", __func__);
-                handle.trigger_cal = false;
-                break;
-        }
+        ALOGD("%s: spkr_prot_thread end calibration", __func__);
+        handle.trigger_cal = false;
+        break;
     }
     if (handle.thermal_client_handle)
         handle.thermal_client_unregister_callback(handle.thermal_client_handle);
@@ -1479,7 +1464,7 @@ static void* spkr_calibration_thread()
         dlclose(handle.thermal_handle);
     handle.thermal_handle = NULL;
 
-    set_boost_and_limiter(adev, afe_api_version, sp_prop_version);
+    set_boost_and_limiter(adev, handle.afe_api_version, handle.sp_prop_version);
 
     pthread_exit(0);
     return NULL;
@@ -1926,10 +1911,10 @@ static void* spkr_v_vali_thread()
     if (!handle.v_vali_vali_time)
         handle.v_vali_vali_time = SPKR_V_VALI_DEFAULT_VALI_TIME;/*set default if not setparam */
     set_spkr_prot_v_vali_cfg(handle.v_vali_wait_time, handle.v_vali_vali_time);
-    pthread_mutex_lock(&adev->lock);
+    ADEV_LOCK(adev);
     ret = spkr_calibrate(SPKR_V_VALI_TEMP_MASK,
                          SPKR_V_VALI_TEMP_MASK);/*use 0xfffe as temp to initiate v_vali*/
-    pthread_mutex_unlock(&adev->lock);
+    ADEV_UNLOCK(adev);
     if (ret)
         ALOGE("%s: failed, retry again\n", __func__);
     handle.trigger_v_vali = false;
@@ -1940,6 +1925,7 @@ static void* spkr_v_vali_thread()
 static void spkr_calibrate_signal()
 {
     pthread_mutex_lock(&handle.cal_wait_cond_mutex);
+    handle.cal_wait_event = true;
     pthread_cond_signal(&handle.cal_wait_condition);
     pthread_mutex_unlock(&handle.cal_wait_cond_mutex);
 }
@@ -2207,6 +2193,39 @@ int fbsp_get_parameters(struct str_parms *query,
     return err;
 }
 
+/*
+ * Reads the calibration properties once, rather than on each calibration
+ * thread start and calibration command.
+ */
+static void spkr_prot_get_props()
+{
+    char value[PROPERTY_VALUE_MAX];
+
+    /* If the value of this persist.vendor.audio.spkr.cal.duration is 0
+     * then it means it will take 30min to calibrate
+     * and if the value is greater than zero then it would take
+     * that much amount of time to calibrate.
+     */
+    handle.min_idle_time = MIN_SPKR_IDLE_SEC;
+    handle.quick_calib = false;
+    property_get("persist.vendor.audio.spkr.cal.duration", value, "0");
+    if (atoi(value) <= 0)
+        property_get("persist.spkr.cal.duration", value, "0");
+    if (atoi(value) > 0) {
+        handle.min_idle_time = atoi(value);
+        handle.quick_calib = true;
+    }
+
+    property_get("persist.vendor.audio.avs.afe_api_version", value, "0");
+    if (atoi(value) > 0)
+        handle.afe_api_version = atoi(value);
+
+    if (property_get_bool("persist.vendor.audio.spv4.enable", false))
+        handle.sp_prop_version = SP_V4;
+    else if (property_get_bool("persist.vendor.audio.spv3.enable", false))
+        handle.sp_prop_version = SP_V3;
+}
+
 void spkr_prot_init(void *adev, spkr_prot_init_config_t spkr_prot_init_config_val)
 {
     char value[PROPERTY_VALUE_MAX];
@@ -2231,6 +2250,7 @@ void spkr_prot_init(void *adev, spkr_prot_init_config_t spkr_prot_init_config_va
         return;
     }
     handle.spkr_cal_dynamic = property_get_bool("persist.vendor.audio.spkr.cal.dynamic", false);
+    spkr_prot_get_props();
     // init function pointers
     fp_read_line_from_file = spkr_prot_init_config_val.fp_read_line_from_file;
     fp_get_usecase_from_list =  spkr_prot_init_config_val.fp_get_usecase_from_list;
@@ -2454,7 +2474,7 @@ int spkr_prot_start_processing(snd_device_t snd_device)
     }
     uc_info_tx->id = USECASE_AUDIO_SPKR_CALIB_TX;
     uc_info_tx->type = PCM_CAPTURE;
-    list_init(&uc_info_tx->device_list);
+    device_set_init(&uc_info_tx->device_list);
 
     if (fp_platform_get_snd_device_name_extn(adev->platform, snd_device, device_name) < 0) {
         ALOGE("%s: Invalid sound device returned", __func__);
@@ -2550,6 +2570,15 @@ bool spkr_prot_is_enabled()
     return handle.spkr_prot_enable;
 }
 
+/*
+ * The speaker device stays enabled while every stream on it is in warm
+ * standby, but nothing plays: count that as idle time.
+ */
+void spkr_prot_set_idle(bool idle)
+{
+    spkr_prot_set_spkrstatus(!idle);
+}
+
 void spkr_prot_is_enabled_init()
 {
 
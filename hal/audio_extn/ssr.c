@@ -92,18 +92,16 @@ struct pcm_buffer_queue {
     struct pcm_buffer buffer;
 };
 
+/*
+ * Process wide state: feature flags and the processing libraries, which are
+ * loaded for the first session and released with the last one. Everything
+ * tied to a recording lives in struct ssr_session, one per input stream, so
+ * several streams can record in surround at once within the CPU budget.
+ */
 struct ssr_module {
-    int                 ssr_3mic;
-    int                 num_out_chan;
-    FILE                *fp_input;
-    FILE                *fp_output;
-    void                *surround_obj;
-    Word16              *surround_raw_buffer;
-    int                  surround_raw_buffer_size;
+    int                  ssr_3mic;
     bool                 is_ssr_enabled;
-    struct stream_in    *in;
-    void                *drc_obj;
-
+    bool                 is_ssr_mode_on;
 
     void *surround_rec_handle;
     surround_rec_get_get_param_data_t surround_rec_get_get_param_data;
@@ -117,6 +115,23 @@ struct ssr_module {
     drc_deinit_t drc_deinit;
     drc_process_t drc_process;
 
+    pthread_mutex_t lock; /* protects sessions and the library handles */
+    struct listnode sessions;
+    int num_sessions;
+};
+
+struct ssr_session {
+    struct listnode      list;
+    struct stream_in    *in;
+    int                  num_out_chan;
+    int                  cost;
+    FILE                *fp_input;
+    FILE                *fp_output;
+    void                *surround_obj;
+    Word16              *surround_raw_buffer;
+    int                  surround_raw_buffer_size;
+    void                *drc_obj;
+
     pthread_t ssr_process_thread;
     bool ssr_process_thread_started;
     bool ssr_process_thread_stop;
@@ -131,18 +146,11 @@ struct ssr_module {
     pthread_mutex_t ssr_process_lock;
     pthread_cond_t cond_process;
     pthread_cond_t cond_read;
-    bool is_ssr_mode_on;
 };
 
 static struct ssr_module ssrmod = {
-    .fp_input = NULL,
-    .fp_output = NULL,
-    .surround_obj = NULL,
-    .surround_raw_buffer = NULL,
-    .surround_raw_buffer_size = 0,
     .is_ssr_enabled = 0,
-    .in = NULL,
-    .drc_obj = NULL,
+    .is_ssr_mode_on = false,
 
     .surround_rec_handle = NULL,
     .surround_rec_get_get_param_data = NULL,
@@ -156,37 +164,27 @@ static struct ssr_module ssrmod = {
     .drc_deinit = NULL,
     .drc_process = NULL,
 
-    .ssr_process_thread_stop = 0,
-    .ssr_process_thread_started = 0,
-    .in_buf_data = NULL,
-    .out_buf_data = NULL,
-    .out_buf_free = NULL,
-    .out_buf = NULL,
-    .in_buf_free = NULL,
-    .in_buf = NULL,
-    .cond_process = PTHREAD_COND_INITIALIZER,
-    .cond_read = PTHREAD_COND_INITIALIZER,
-    .ssr_process_lock = PTHREAD_MUTEX_INITIALIZER,
-    .is_ssr_mode_on = false,
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .sessions = { &ssrmod.sessions, &ssrmod.sessions },
+    .num_sessions = 0,
 };
 
+/* estimated cost of one 3 mic session with DRC, per-mille of one CPU */
+#define SSR_SESSION_COST_PROPERTY   "vendor.audio.ssr.session_cost"
+#define SSR_SESSION_COST_DEFAULT    250
+
 static void *ssr_process_thread(void *context);
 
-static int32_t drc_init_lib(int num_chan, int sample_rate __unused)
+/* called with ssrmod.lock held, DRC is optional so failures are not fatal */
+static void drc_load_lib_l()
 {
-    int ret = 0;
-    const char *cfgFileName = "";
-
-    if (ssrmod.drc_obj) {
-        ALOGE("%s: DRC library is already initialized", __func__);
-        return 0;
-    }
+    if (ssrmod.drc_handle)
+        return;
 
     ssrmod.drc_handle = dlopen(LIB_DRC, RTLD_NOW);
     if (ssrmod.drc_handle == NULL) {
         ALOGE("%s: DLOPEN failed for %s", __func__, LIB_DRC);
-        ret = -ENOSYS;
-        goto init_fail;
+        return;
     }
 
     ALOGV("%s: DLOPEN successful for %s", __func__, LIB_DRC);
@@ -202,10 +200,73 @@ static int32_t drc_init_lib(int num_chan, int sample_rate __unused)
         !ssrmod.drc_process){
         ALOGW("%s: Could not find one of the symbols from %s",
               __func__, LIB_DRC);
-        ret = -ENOSYS;
-        goto init_fail;
+        dlclose(ssrmod.drc_handle);
+        ssrmod.drc_handle = NULL;
+    }
+}
+
+/* called with ssrmod.lock held */
+static int32_t ssr_load_surround_lib_l()
+{
+    if (ssrmod.surround_rec_handle)
+        return 0;
+
+    ssrmod.surround_rec_handle = dlopen(LIB_SURROUND_3MIC_PROC, RTLD_NOW);
+    if (ssrmod.surround_rec_handle == NULL) {
+        ALOGE("%s: DLOPEN failed for %s", __func__, LIB_SURROUND_3MIC_PROC);
+        return -ENOSYS;
+    }
+
+    ALOGV("%s: DLOPEN successful for %s", __func__, LIB_SURROUND_3MIC_PROC);
+    ssrmod.surround_rec_get_get_param_data = (surround_rec_get_get_param_data_t)
+    dlsym(ssrmod.surround_rec_handle, "surround_rec_get_get_param_data");
+
+    ssrmod.surround_rec_get_set_param_data = (surround_rec_get_set_param_data_t)
+    dlsym(ssrmod.surround_rec_handle, "surround_rec_get_set_param_data");
+    ssrmod.surround_rec_init = (surround_rec_init_t)
+    dlsym(ssrmod.surround_rec_handle, "surround_rec_init");
+    ssrmod.surround_rec_deinit = (surround_rec_deinit_t)
+    dlsym(ssrmod.surround_rec_handle, "surround_rec_deinit");
+    ssrmod.surround_rec_process = (surround_rec_process_t)
+    dlsym(ssrmod.surround_rec_handle, "surround_rec_process");
+
+    if (!ssrmod.surround_rec_get_get_param_data ||
+        !ssrmod.surround_rec_get_set_param_data ||
+        !ssrmod.surround_rec_init ||
+        !ssrmod.surround_rec_deinit ||
+        !ssrmod.surround_rec_process){
+        ALOGW("%s: Could not find the one of the symbols from %s",
+              __func__, LIB_SURROUND_3MIC_PROC);
+        dlclose(ssrmod.surround_rec_handle);
+        ssrmod.surround_rec_handle = NULL;
+        return -ENOSYS;
+    }
+    return 0;
+}
+
+/* called with ssrmod.lock held once the last session is gone */
+static void ssr_unload_libs_l()
+{
+    if (ssrmod.drc_handle) {
+        dlclose(ssrmod.drc_handle);
+        ssrmod.drc_handle = NULL;
     }
 
+    if (ssrmod.surround_rec_handle) {
+        dlclose(ssrmod.surround_rec_handle);
+        ssrmod.surround_rec_handle = NULL;
+    }
+}
+
+static int32_t drc_init_session(struct ssr_session *session, int num_chan,
+                                int sample_rate __unused)
+{
+    int ret = 0;
+    const char *cfgFileName = "";
+
+    if (!ssrmod.drc_handle)
+        return -ENOSYS;
+
     /* TO DO: different config files for different sample rates */
     if (num_chan == 6) {
         cfgFileName = "/vendor/etc/drc/drc_cfg_5.1.txt";
@@ -214,79 +275,35 @@ static int32_t drc_init_lib(int num_chan, int sample_rate __unused)
     }
 
     ALOGV("%s: Calling drc_init: num ch: %d, period: %d, cfg file: %s", __func__, num_chan, SSR_PERIOD_SIZE, cfgFileName);
-    ret = ssrmod.drc_init(&ssrmod.drc_obj, num_chan, SSR_PERIOD_SIZE, cfgFileName);
+    ret = ssrmod.drc_init(&session->drc_obj, num_chan, SSR_PERIOD_SIZE, cfgFileName);
     if (ret) {
         ALOGE("drc_init failed with ret:%d",ret);
-        ret = -EINVAL;
-        goto init_fail;
+        session->drc_obj = NULL;
+        return -EINVAL;
     }
 
     return 0;
-
-init_fail:
-    if (ssrmod.drc_obj) {
-        ssrmod.drc_obj = NULL;
-    }
-    if(ssrmod.drc_handle) {
-        dlclose(ssrmod.drc_handle);
-        ssrmod.drc_handle = NULL;
-    }
-    return ret;
 }
 
-static int32_t ssr_init_surround_sound_3mic_lib(unsigned long buffersize, int num_in_chan, int num_out_chan, int sample_rate)
+static int32_t ssr_init_surround_sound_3mic(struct ssr_session *session,
+                                            unsigned long buffersize, int num_in_chan,
+                                            int num_out_chan, int sample_rate)
 {
     int ret = 0;
     const char *cfgFileName = NULL;
 
-    if ( ssrmod.surround_obj ) {
-        ALOGE("%s: surround sound library is already initialized", __func__);
-        return 0;
-    }
-
-    ssrmod.surround_rec_handle = dlopen(LIB_SURROUND_3MIC_PROC, RTLD_NOW);
-    if (ssrmod.surround_rec_handle == NULL) {
-        ALOGE("%s: DLOPEN failed for %s", __func__, LIB_SURROUND_3MIC_PROC);
-        goto init_fail;
-    } else {
-        ALOGV("%s: DLOPEN successful for %s", __func__, LIB_SURROUND_3MIC_PROC);
-        ssrmod.surround_rec_get_get_param_data = (surround_rec_get_get_param_data_t)
-        dlsym(ssrmod.surround_rec_handle, "surround_rec_get_get_param_data");
-
-        ssrmod.surround_rec_get_set_param_data = (surround_rec_get_set_param_data_t)
-        dlsym(ssrmod.surround_rec_handle, "surround_rec_get_set_param_data");
-        ssrmod.surround_rec_init = (surround_rec_init_t)
-        dlsym(ssrmod.surround_rec_handle, "surround_rec_init");
-        ssrmod.surround_rec_deinit = (surround_rec_deinit_t)
-        dlsym(ssrmod.surround_rec_handle, "surround_rec_deinit");
-        ssrmod.surround_rec_process = (surround_rec_process_t)
-        dlsym(ssrmod.surround_rec_handle, "surround_rec_process");
-
-        if (!ssrmod.surround_rec_get_get_param_data ||
-            !ssrmod.surround_rec_get_set_param_data ||
-            !ssrmod.surround_rec_init ||
-            !ssrmod.surround_rec_deinit ||
-            !ssrmod.surround_rec_process){
-            ALOGW("%s: Could not find the one of the symbols from %s",
-                  __func__, LIB_SURROUND_3MIC_PROC);
-            ret = -ENOSYS;
-            goto init_fail;
-        }
-    }
-
     /* Allocate memory for input buffer */
-    ssrmod.surround_raw_buffer = (Word16 *) calloc(buffersize,
+    session->surround_raw_buffer = (Word16 *) calloc(buffersize,
                                               sizeof(Word16));
-    if (!ssrmod.surround_raw_buffer) {
+    if (!session->surround_raw_buffer) {
        ALOGE("%s: Memory allocation failure. Not able to allocate "
              "memory for surroundInputBuffer", __func__);
-       ret = -ENOMEM;
-       goto init_fail;
+       return -ENOMEM;
     }
 
-    ssrmod.surround_raw_buffer_size = buffersize;
+    session->surround_raw_buffer_size = buffersize;
 
-    ssrmod.num_out_chan = num_out_chan;
+    session->num_out_chan = num_out_chan;
 
     if (num_out_chan == 6) {
         cfgFileName = "/vendor/etc/surround_sound_3mic/surround_sound_rec_5.1.cfg";
@@ -298,30 +315,18 @@ static int32_t ssr_init_surround_sound_3mic_lib(unsigned long buffersize, int nu
 
     ALOGV("%s: Calling surround_rec_init: in ch: %d, out ch: %d, period: %d, sample rate: %d, cfg file: %s",
           __func__, num_in_chan, num_out_chan, SSR_PERIOD_SIZE, sample_rate, cfgFileName);
-     ret = ssrmod.surround_rec_init(&ssrmod.surround_obj,
+    ret = ssrmod.surround_rec_init(&session->surround_obj,
         num_in_chan, num_out_chan, SSR_PERIOD_SIZE, sample_rate, cfgFileName);
     if (ret) {
         ALOGE("surround_rec_init failed with ret:%d",ret);
-        ret = -EINVAL;
-        goto init_fail;
+        session->surround_obj = NULL;
+        free(session->surround_raw_buffer);
+        session->surround_raw_buffer = NULL;
+        session->surround_raw_buffer_size = 0;
+        return -EINVAL;
     }
 
     return 0;
-
-init_fail:
-    if (ssrmod.surround_obj) {
-        ssrmod.surround_obj = NULL;
-    }
-    if (ssrmod.surround_raw_buffer) {
-        free(ssrmod.surround_raw_buffer);
-        ssrmod.surround_raw_buffer = NULL;
-        ssrmod.surround_raw_buffer_size = 0;
-    }
-    if(ssrmod.surround_rec_handle) {
-        dlclose(ssrmod.surround_rec_handle);
-        ssrmod.surround_rec_handle = NULL;
-    }
-    return ret;
 }
 
 void ssr_update_enabled()
@@ -351,7 +356,7 @@ bool ssr_get_enabled()
 bool  ssr_check_usecase(struct stream_in *in) {
     int ret = false;
     int channel_count = audio_channel_count_from_in_mask(in->channel_mask);
-    audio_devices_t devices = get_device_types(&in->device_list);
+    audio_devices_t devices = device_set_types(&in->device_list);
     audio_source_t source = in->source;
 
     if ((ssr_get_enabled()) &&
@@ -393,73 +398,78 @@ static struct pcm_buffer_queue *pcm_buffer_queue_pop(struct pcm_buffer_queue **q
     return node;
 }
 
-static void deinit_ssr_process_thread()
+static void deinit_ssr_process_thread(struct ssr_session *session)
 {
-    pthread_mutex_lock(&ssrmod.ssr_process_lock);
-    ssrmod.ssr_process_thread_stop = 1;
-
-    if(ssrmod.in_buf_data != NULL)
-       free(ssrmod.in_buf_data);
-    ssrmod.in_buf_data = NULL;
-    ssrmod.in_buf = NULL;
-    ssrmod.in_buf_free = NULL;
-
-    if(ssrmod.out_buf_data != NULL)
-       free(ssrmod.out_buf_data);
-    ssrmod.out_buf_data = NULL;
-    ssrmod.out_buf = NULL;
-    ssrmod.out_buf_free = NULL;
-    pthread_cond_broadcast(&ssrmod.cond_process);
-    pthread_cond_broadcast(&ssrmod.cond_read);
-    pthread_mutex_unlock(&ssrmod.ssr_process_lock);
-    if (ssrmod.ssr_process_thread_started) {
-        pthread_join(ssrmod.ssr_process_thread, (void **)NULL);
-        ssrmod.ssr_process_thread_started = 0;
-    }
+    pthread_mutex_lock(&session->ssr_process_lock);
+    session->ssr_process_thread_stop = 1;
+    pthread_cond_broadcast(&session->cond_process);
+    pthread_cond_broadcast(&session->cond_read);
+    pthread_mutex_unlock(&session->ssr_process_lock);
+    if (session->ssr_process_thread_started) {
+        pthread_join(session->ssr_process_thread, (void **)NULL);
+        session->ssr_process_thread_started = 0;
+    }
+
+    /* the buffers are released once the thread can no longer touch them */
+    if(session->in_buf_data != NULL)
+       free(session->in_buf_data);
+    session->in_buf_data = NULL;
+    session->in_buf = NULL;
+    session->in_buf_free = NULL;
+
+    if(session->out_buf_data != NULL)
+       free(session->out_buf_data);
+    session->out_buf_data = NULL;
+    session->out_buf = NULL;
+    session->out_buf_free = NULL;
 }
 
-struct stream_in *ssr_get_stream()
+int32_t ssr_deinit(struct stream_in *in)
 {
-    return ssrmod.in;
-}
+    struct ssr_session *session = (struct ssr_session *)in->ssr_ctx;
 
-int32_t ssr_deinit()
-{
     ALOGV("%s: entry", __func__);
-    deinit_ssr_process_thread();
-
-    if (ssrmod.drc_obj) {
-        ssrmod.drc_deinit(ssrmod.drc_obj);
-        ssrmod.drc_obj = NULL;
-    }
+    if (session == NULL)
+        return 0;
 
-    if (ssrmod.surround_obj) {
+    pthread_mutex_lock(&ssrmod.lock);
+    list_remove(&session->list);
+    ssrmod.num_sessions--;
+    pthread_mutex_unlock(&ssrmod.lock);
 
-        if (ssrmod.ssr_3mic) {
-            ssrmod.surround_rec_deinit(ssrmod.surround_obj);
-            ssrmod.surround_obj = NULL;
-        }
-        if (ssrmod.surround_raw_buffer) {
-            free(ssrmod.surround_raw_buffer);
-            ssrmod.surround_raw_buffer = NULL;
-        }
-        if (ssrmod.fp_input)
-            fclose(ssrmod.fp_input);
-        if (ssrmod.fp_output)
-            fclose(ssrmod.fp_output);
-    }
+    deinit_ssr_process_thread(session);
 
-    if(ssrmod.drc_handle) {
-        dlclose(ssrmod.drc_handle);
-        ssrmod.drc_handle = NULL;
+    if (session->drc_obj) {
+        ssrmod.drc_deinit(session->drc_obj);
+        session->drc_obj = NULL;
     }
 
-    if(ssrmod.surround_rec_handle) {
-        dlclose(ssrmod.surround_rec_handle);
-        ssrmod.surround_rec_handle = NULL;
+    if (session->surround_obj) {
+        if (ssrmod.ssr_3mic) {
+            ssrmod.surround_rec_deinit(session->surround_obj);
+            session->surround_obj = NULL;
+        }
     }
-
-    ssrmod.in = NULL;
+    if (session->surround_raw_buffer) {
+        free(session->surround_raw_buffer);
+        session->surround_raw_buffer = NULL;
+    }
+    if (session->fp_input)
+        fclose(session->fp_input);
+    if (session->fp_output)
+        fclose(session->fp_output);
+
+    pthread_mutex_lock(&ssrmod.lock);
+    if (ssrmod.num_sessions == 0)
+        ssr_unload_libs_l();
+    pthread_mutex_unlock(&ssrmod.lock);
+
+    adev_proc_budget_release(in->dev, session->cost);
+    pthread_mutex_destroy(&session->ssr_process_lock);
+    pthread_cond_destroy(&session->cond_process);
+    pthread_cond_destroy(&session->cond_read);
+    free(session);
+    in->ssr_ctx = NULL;
     //SSR session can be closed due to device switch
     //Do not force reset ssr mode
 
@@ -471,137 +481,154 @@ int32_t ssr_deinit()
 
 int32_t ssr_init(struct stream_in *in, int num_out_chan)
 {
-    uint32_t ret = -1;
+    int32_t ret = -1;
     char c_multi_ch_dump[128] = {0};
     uint32_t buffer_size;
+    struct ssr_session *session;
+    int cost;
+    int i;
+    int output_buf_size;
 
     ALOGD("%s: ssr case, sample rate %d", __func__, in->config.rate);
 
-    if (ssrmod.surround_obj != NULL) {
-        ALOGV("%s: reinitializing surround sound library", __func__);
-        ssr_deinit();
+    if (in->ssr_ctx != NULL) {
+        ALOGV("%s: reinitializing surround sound session", __func__);
+        ssr_deinit(in);
     }
 
     if (ssr_get_enabled()) {
         ssrmod.ssr_3mic = 1;
     } else {
         ALOGE(" Rejecting SSR -- init is called without enabling SSR");
-        goto fail;
+        return -EINVAL;
+    }
+
+    cost = property_get_int32(SSR_SESSION_COST_PROPERTY, SSR_SESSION_COST_DEFAULT);
+    if (!adev_proc_budget_acquire(in->dev, cost)) {
+        ALOGW("%s: Rejecting SSR -- cost %d exceeds remaining processing budget",
+              __func__, cost);
+        return -EBUSY;
     }
 
-    /* buffer size equals to  period_size * period_count */     
+    session = (struct ssr_session *)calloc(1, sizeof(struct ssr_session));
+    if (session == NULL) {
+        adev_proc_budget_release(in->dev, cost);
+        return -ENOMEM;
+    }
+    session->in = in;
+    session->cost = cost;
+    pthread_mutex_init(&session->ssr_process_lock, (const pthread_mutexattr_t *) NULL);
+    pthread_cond_init(&session->cond_process, (const pthread_condattr_t *) NULL);
+    pthread_cond_init(&session->cond_read, (const pthread_condattr_t *) NULL);
+
+    /* registered before the libraries are touched so that they stay loaded */
+    pthread_mutex_lock(&ssrmod.lock);
+    list_add_tail(&ssrmod.sessions, &session->list);
+    ssrmod.num_sessions++;
+    ret = ssr_load_surround_lib_l();
+    if (ret == 0)
+        drc_load_lib_l();
+    pthread_mutex_unlock(&ssrmod.lock);
+    in->ssr_ctx = session;
+    if (ret != 0)
+        goto fail;
+
+    /* buffer size equals to  period_size * period_count */
     buffer_size = SSR_PERIOD_SIZE * NUM_IN_CHANNELS * sizeof(int16_t);
     ALOGV("%s: buffer_size: %d", __func__, buffer_size);
 
     if (ssrmod.ssr_3mic != 0) {
-        ret = ssr_init_surround_sound_3mic_lib(buffer_size, NUM_IN_CHANNELS, num_out_chan, in->config.rate);
+        ret = ssr_init_surround_sound_3mic(session, buffer_size, NUM_IN_CHANNELS,
+                                           num_out_chan, in->config.rate);
         if (0 != ret) {
-            ALOGE("%s: ssr_init_surround_sound_3mic_lib failed: %d  "
+            ALOGE("%s: ssr_init_surround_sound_3mic failed: %d  "
                   "buffer_size:%d", __func__, ret, buffer_size);
             goto fail;
         }
     }
 
     /* Initialize DRC if available */
-    ret = drc_init_lib(num_out_chan, in->config.rate);
+    ret = drc_init_session(session, num_out_chan, in->config.rate);
     if (0 != ret) {
-        ALOGE("%s: drc_init_lib failed, ret %d", __func__, ret);
+        ALOGE("%s: drc_init_session failed, ret %d", __func__, ret);
     }
 
-    pthread_mutex_lock(&ssrmod.ssr_process_lock);
-    if (!ssrmod.ssr_process_thread_started) {
-        int i;
-        int output_buf_size = SSR_PERIOD_SIZE * sizeof(int16_t) * num_out_chan;
-
-        ssrmod.in_buf_data = (void *)calloc(buffer_size, NUM_IN_BUFS);
-        if (ssrmod.in_buf_data == NULL) {
-            ALOGE("%s: failed to allocate input buffer", __func__);
-            pthread_mutex_unlock(&ssrmod.ssr_process_lock);
-            ret = -ENOMEM;
-            goto fail;
-        }
-        ssrmod.out_buf_data = (void *)calloc(output_buf_size, NUM_OUT_BUFS);
-        if (ssrmod.out_buf_data == NULL) {
-            ALOGE("%s: failed to allocate output buffer", __func__);
-            pthread_mutex_unlock(&ssrmod.ssr_process_lock);
-            ret = -ENOMEM;
-            // ssrmod.in_buf_data will be freed in deinit_ssr_process_thread()
-            goto fail;
-        }
-
-        ssrmod.in_buf = NULL;
-        ssrmod.in_buf_free = NULL;
-        ssrmod.out_buf = NULL;
-        ssrmod.out_buf_free = NULL;
-
-        for (i=0; i < NUM_IN_BUFS; i++) {
-            struct pcm_buffer_queue *buf = &ssrmod.in_buf_nodes[i];
-            buf->buffer.data = &(((char *)ssrmod.in_buf_data)[i*buffer_size]);
-            buf->buffer.length = buffer_size;
-            pcm_buffer_queue_push(&ssrmod.in_buf_free, buf);
-        }
+    output_buf_size = SSR_PERIOD_SIZE * sizeof(int16_t) * num_out_chan;
+    session->in_buf_data = (void *)calloc(buffer_size, NUM_IN_BUFS);
+    if (session->in_buf_data == NULL) {
+        ALOGE("%s: failed to allocate input buffer", __func__);
+        ret = -ENOMEM;
+        goto fail;
+    }
+    session->out_buf_data = (void *)calloc(output_buf_size, NUM_OUT_BUFS);
+    if (session->out_buf_data == NULL) {
+        ALOGE("%s: failed to allocate output buffer", __func__);
+        ret = -ENOMEM;
+        // session->in_buf_data will be freed in deinit_ssr_process_thread()
+        goto fail;
+    }
 
-        for (i=0; i < NUM_OUT_BUFS; i++) {
-            struct pcm_buffer_queue *buf = &ssrmod.out_buf_nodes[i];
-            buf->buffer.data = &(((char *)ssrmod.out_buf_data)[i*output_buf_size]);
-            buf->buffer.length = output_buf_size;
-            pcm_buffer_queue_push(&ssrmod.out_buf, buf);
-        }
+    for (i=0; i < NUM_IN_BUFS; i++) {
+        struct pcm_buffer_queue *buf = &session->in_buf_nodes[i];
+        buf->buffer.data = &(((char *)session->in_buf_data)[i*buffer_size]);
+        buf->buffer.length = buffer_size;
+        pcm_buffer_queue_push(&session->in_buf_free, buf);
+    }
 
-        ssrmod.ssr_process_thread_stop = 0;
-        ALOGV("%s: creating thread", __func__);
-        ret = pthread_create(&ssrmod.ssr_process_thread,
-                             (const pthread_attr_t *) NULL,
-                             ssr_process_thread, NULL);
-        if (ret != 0) {
-            ALOGE("%s: failed to create thread for surround sound recording.",
-                  __func__);
-            pthread_mutex_unlock(&ssrmod.ssr_process_lock);
-            goto fail;
-        }
+    for (i=0; i < NUM_OUT_BUFS; i++) {
+        struct pcm_buffer_queue *buf = &session->out_buf_nodes[i];
+        buf->buffer.data = &(((char *)session->out_buf_data)[i*output_buf_size]);
+        buf->buffer.length = output_buf_size;
+        pcm_buffer_queue_push(&session->out_buf, buf);
+    }
 
-        ssrmod.ssr_process_thread_started = 1;
-        ALOGV("%s: done creating thread", __func__);
+    session->ssr_process_thread_stop = 0;
+    ALOGV("%s: creating thread", __func__);
+    ret = pthread_create(&session->ssr_process_thread,
+                         (const pthread_attr_t *) NULL,
+                         ssr_process_thread, session);
+    if (ret != 0) {
+        ALOGE("%s: failed to create thread for surround sound recording.",
+              __func__);
+        goto fail;
     }
 
+    session->ssr_process_thread_started = 1;
+    ALOGV("%s: done creating thread", __func__);
+
     in->config.channels = NUM_IN_CHANNELS;
     in->config.period_size = SSR_PERIOD_SIZE;
     in->config.period_count = in->config.channels * sizeof(int16_t);
 
-    pthread_mutex_unlock(&ssrmod.ssr_process_lock);
-
     property_get("vendor.audio.ssr.pcmdump",c_multi_ch_dump,"0");
     if (0 == strncmp("true", c_multi_ch_dump, sizeof("ssr.dump-pcm"))) {
+        char dump_path[128];
+
         /* Remember to change file system permission of data(e.g. chmod 777 data/),
           otherwise, fopen may fail */
-        if ( !ssrmod.fp_input) {
-            ALOGD("%s: Opening ssr input dump file \n", __func__);
-            ssrmod.fp_input = fopen("/data/vendor/audio/ssr_input_3ch.pcm", "wb");
-        }
-
-        if ( !ssrmod.fp_output) {
-            if(ssrmod.num_out_chan == 6) {
-                ALOGD("%s: Opening ssr input dump file for 6 channel\n", __func__);
-                ssrmod.fp_output = fopen("/data/vendor/audio/ssr_output_6ch.pcm", "wb");
-            } else {
-                ALOGD("%s: Opening ssr input dump file for 2 channel\n", __func__);
-                ssrmod.fp_output = fopen("/data/vendor/audio/ssr_output_2ch.pcm", "wb");
-            }
-        }
-
-        if ((!ssrmod.fp_input) || (!ssrmod.fp_output)) {
+        ALOGD("%s: Opening ssr input dump file \n", __func__);
+        snprintf(dump_path, sizeof(dump_path),
+                 "/data/vendor/audio/ssr_input_3ch_%d.pcm", in->capture_handle);
+        session->fp_input = fopen(dump_path, "wb");
+
+        ALOGD("%s: Opening ssr output dump file for %d channel\n", __func__,
+              session->num_out_chan);
+        snprintf(dump_path, sizeof(dump_path),
+                 "/data/vendor/audio/ssr_output_%dch_%d.pcm",
+                 session->num_out_chan, in->capture_handle);
+        session->fp_output = fopen(dump_path, "wb");
+
+        if ((!session->fp_input) || (!session->fp_output)) {
             ALOGE("%s: input dump or ouput dump open failed: mfp_4ch:%p mfp_6ch:%p",
-                  __func__, ssrmod.fp_input, ssrmod.fp_output);
+                  __func__, session->fp_input, session->fp_output);
         }
     }
 
-    ssrmod.in = in;
-
     ALOGV("%s: exit", __func__);
     return 0;
 
 fail:
-    (void) ssr_deinit();
+    (void) ssr_deinit(in);
     return ret;
 }
 
@@ -638,8 +665,9 @@ int ssr_set_usecase(struct stream_in *in,
     return ret;
 }
 
-static void *ssr_process_thread(void *context __unused)
+static void *ssr_process_thread(void *context)
 {
+    struct ssr_session *session = (struct ssr_session *)context;
     int32_t ret;
 
     ALOGV("%s: enter", __func__);
@@ -647,63 +675,63 @@ static void *ssr_process_thread(void *context __unused)
     setpriority(PRIO_PROCESS, 0, ANDROID_PRIORITY_URGENT_AUDIO);
     set_sched_policy(0, SP_FOREGROUND);
 
-    pthread_mutex_lock(&ssrmod.ssr_process_lock);
-    while (!ssrmod.ssr_process_thread_stop) {
+    pthread_mutex_lock(&session->ssr_process_lock);
+    while (!session->ssr_process_thread_stop) {
         struct pcm_buffer_queue *out_buf;
         struct pcm_buffer_queue *in_buf;
 
-        while ((!ssrmod.ssr_process_thread_stop) &&
-               ((ssrmod.out_buf_free == NULL) ||
-                (ssrmod.in_buf == NULL))) {
+        while ((!session->ssr_process_thread_stop) &&
+               ((session->out_buf_free == NULL) ||
+                (session->in_buf == NULL))) {
             ALOGV("%s: waiting for buffers", __func__);
-            pthread_cond_wait(&ssrmod.cond_process, &ssrmod.ssr_process_lock);
+            pthread_cond_wait(&session->cond_process, &session->ssr_process_lock);
         }
-        if (ssrmod.ssr_process_thread_stop) {
+        if (session->ssr_process_thread_stop) {
             break;
         }
         ALOGV("%s: got buffers", __func__);
 
-        out_buf = pcm_buffer_queue_pop(&ssrmod.out_buf_free);
-        in_buf = pcm_buffer_queue_pop(&ssrmod.in_buf);
+        out_buf = pcm_buffer_queue_pop(&session->out_buf_free);
+        in_buf = pcm_buffer_queue_pop(&session->in_buf);
 
-        pthread_mutex_unlock(&ssrmod.ssr_process_lock);
+        pthread_mutex_unlock(&session->ssr_process_lock);
 
         /* apply ssr libs to convert 4ch to 6ch */
         if (ssrmod.ssr_3mic) {
-            ssrmod.surround_rec_process(ssrmod.surround_obj,
+            ssrmod.surround_rec_process(session->surround_obj,
                 (int16_t *) in_buf->buffer.data,
                 (int16_t *) out_buf->buffer.data);
         }
 
         /* Run DRC if initialized */
-        if (ssrmod.drc_obj != NULL) {
+        if (session->drc_obj != NULL) {
             ALOGV("%s: Running DRC", __func__);
-            ret = ssrmod.drc_process(ssrmod.drc_obj, out_buf->buffer.data, out_buf->buffer.data);
+            ret = ssrmod.drc_process(session->drc_obj, out_buf->buffer.data, out_buf->buffer.data);
             if (ret != 0) {
                 ALOGE("%s: drc_process returned %d", __func__, ret);
             }
         }
 
         /*dump for raw pcm data*/
-        if (ssrmod.fp_input)
-            fwrite(in_buf->buffer.data, 1, in_buf->buffer.length, ssrmod.fp_input);
-        if (ssrmod.fp_output)
-            fwrite(out_buf->buffer.data, 1, out_buf->buffer.length, ssrmod.fp_output);
+        if (session->fp_input)
+            fwrite(in_buf->buffer.data, 1, in_buf->buffer.length, session->fp_input);
+        if (session->fp_output)
+            fwrite(out_buf->buffer.data, 1, out_buf->buffer.length, session->fp_output);
 
-        pthread_mutex_lock(&ssrmod.ssr_process_lock);
+        pthread_mutex_lock(&session->ssr_process_lock);
 
-        pcm_buffer_queue_push(&ssrmod.out_buf, out_buf);
-        pcm_buffer_queue_push(&ssrmod.in_buf_free, in_buf);
+        pcm_buffer_queue_push(&session->out_buf, out_buf);
+        pcm_buffer_queue_push(&session->in_buf_free, in_buf);
 
         /* Read thread should go on without waiting for condition
          * variable. If it has to wait (due to this thread not keeping
          * up with the read requests), let this thread use the remainder
          * of its buffers before waking up the read thread. */
-        if (ssrmod.in_buf == NULL) {
-            pthread_cond_signal(&ssrmod.cond_read);
+        if (session->in_buf == NULL) {
+            pthread_cond_signal(&session->cond_read);
         }
     }
-    pthread_mutex_unlock(&ssrmod.ssr_process_lock);
+    pthread_mutex_unlock(&session->ssr_process_lock);
 
     ALOGV("%s: exit", __func__);
 
@@ -714,66 +742,71 @@ int32_t ssr_read(struct audio_stream_in *stream,
                        void *buffer, size_t bytes)
 {
     struct stream_in *in = (struct stream_in *)stream;
+    struct ssr_session *session = (struct ssr_session *)in->ssr_ctx;
     int32_t ret = 0;
     struct pcm_buffer_queue *in_buf;
     struct pcm_buffer_queue *out_buf;
 
     ALOGV("%s: entry", __func__);
 
-    if (!ssrmod.surround_obj) {
+    if (!session || !session->surround_obj) {
         ALOGE("%s: surround_obj not initialized", __func__);
         return -ENOMEM;
     }
 
-    ret = pcm_read(in->pcm, ssrmod.surround_raw_buffer, ssrmod.surround_raw_buffer_size);
+    ret = pcm_read(in->pcm, session->surround_raw_buffer, session->surround_raw_buffer_size);
     if (ret < 0) {
         ALOGE("%s: %s ret:%d", __func__, pcm_get_error(in->pcm),ret);
         return ret;
     }
 
-    pthread_mutex_lock(&ssrmod.ssr_process_lock);
+    pthread_mutex_lock(&session->ssr_process_lock);
 
-    if (!ssrmod.ssr_process_thread_started) {
-        pthread_mutex_unlock(&ssrmod.ssr_process_lock);
+    if (!session->ssr_process_thread_started) {
+        pthread_mutex_unlock(&session->ssr_process_lock);
         ALOGV("%s: ssr_process_thread not initialized", __func__);
         return -EINVAL;
     }
 
-    if ((ssrmod.in_buf_free == NULL) || (ssrmod.out_buf == NULL)) {
+    if ((session->in_buf_free == NULL) || (session->out_buf == NULL)) {
         ALOGE("%s: waiting for buffers", __func__);
-        pthread_cond_wait(&ssrmod.cond_read, &ssrmod.ssr_process_lock);
-        if ((ssrmod.in_buf_free == NULL) || (ssrmod.out_buf == NULL)) {
-            pthread_mutex_unlock(&ssrmod.ssr_process_lock);
+        pthread_cond_wait(&session->cond_read, &session->ssr_process_lock);
+        if ((session->in_buf_free == NULL) || (session->out_buf == NULL)) {
+            pthread_mutex_unlock(&session->ssr_process_lock);
             ALOGE("%s: failed to acquire buffers", __func__);
             return -EINVAL;
         }
     }
 
-    in_buf = pcm_buffer_queue_pop(&ssrmod.in_buf_free);
-    out_buf = pcm_buffer_queue_pop(&ssrmod.out_buf);
+    in_buf = pcm_buffer_queue_pop(&session->in_buf_free);
+    out_buf = pcm_buffer_queue_pop(&session->out_buf);
 
-    memcpy(in_buf->buffer.data, ssrmod.surround_raw_buffer, in_buf->buffer.length);
-    pcm_buffer_queue_push(&ssrmod.in_buf, in_buf);
+    memcpy(in_buf->buffer.data, session->surround_raw_buffer, in_buf->buffer.length);
+    pcm_buffer_queue_push(&session->in_buf, in_buf);
 
     memcpy(buffer, out_buf->buffer.data, bytes);
-    pcm_buffer_queue_push(&ssrmod.out_buf_free, out_buf);
+    pcm_buffer_queue_push(&session->out_buf_free, out_buf);
 
-    pthread_cond_signal(&ssrmod.cond_process);
+    pthread_cond_signal(&session->cond_process);
 
-    pthread_mutex_unlock(&ssrmod.ssr_process_lock);
+    pthread_mutex_unlock(&session->ssr_process_lock);
 
     ALOGV("%s: exit", __func__);
     return ret;
 }
 
+/* library parameters are applied to every running session */
 void ssr_set_parameters(struct audio_device *adev __unused,
                                    struct str_parms *parms)
 {
     int err;
     char value[4096] = {0};
+    struct listnode *node;
+    struct ssr_session *session;
 
+    pthread_mutex_lock(&ssrmod.lock);
     //Do not update SSR mode during recording
-    if ( !ssrmod.surround_obj) {
+    if (ssrmod.num_sessions == 0) {
         int ret = 0;
         ret = str_parms_get_str(parms, AUDIO_PARAMETER_SSRMODE_ON, value,
                                 sizeof(value));
@@ -787,29 +820,40 @@ void ssr_set_parameters(struct audio_device *adev __unused,
             }
         }
     }
-    if (ssrmod.ssr_3mic && ssrmod.surround_obj) {
+    if (ssrmod.ssr_3mic && ssrmod.surround_rec_handle) {
         const set_param_data_t *set_params = ssrmod.surround_rec_get_set_param_data();
         if (set_params != NULL) {
             while (set_params->name != NULL && set_params->set_param_fn != NULL) {
                 err = str_parms_get_str(parms, set_params->name, value, sizeof(value));
                 if (err >= 0) {
                     ALOGV("Set %s to %s\n", set_params->name, value);
-                    set_params->set_param_fn(ssrmod.surround_obj, value);
+                    list_for_each(node, &ssrmod.sessions) {
+                        session = node_to_item(node, struct ssr_session, list);
+                        if (session->surround_obj)
+                            set_params->set_param_fn(session->surround_obj, value);
+                    }
                 }
                 set_params++;
             }
         }
     }
+    pthread_mutex_unlock(&ssrmod.lock);
 }
 
+/* sessions share one configuration, so values are read from the oldest one */
 void ssr_get_parameters(const struct audio_device *adev __unused,
                                    struct str_parms *parms,
                                    struct str_parms *reply)
 {
     int err;
     char value[4096] = {0};
+    struct ssr_session *session = NULL;
 
-    if (ssrmod.ssr_3mic && ssrmod.surround_obj) {
+    pthread_mutex_lock(&ssrmod.lock);
+    if (!list_empty(&ssrmod.sessions))
+        session = node_to_item(list_head(&ssrmod.sessions), struct ssr_session, list);
+
+    if (ssrmod.ssr_3mic && session && session->surround_obj) {
         const get_param_data_t *get_params = ssrmod.surround_rec_get_get_param_data();
         int get_all = 0;
         err = str_parms_get_str(parms, "ssr.all", value, sizeof(value));
@@ -821,7 +865,7 @@ void ssr_get_parameters(const struct audio_device *adev __unused,
                 err = str_parms_get_str(parms, get_params->name, value, sizeof(value));
                 if (get_all || (err >= 0)) {
                     ALOGV("Getting parameter %s", get_params->name);
-                    char *val = get_params->get_param_fn(ssrmod.surround_obj);
+                    char *val = get_params->get_param_fn(session->surround_obj);
                     if (val != NULL) {
                         str_parms_add_str(reply, get_params->name, val);
                         free(val);
@@ -831,5 +875,5 @@ void ssr_get_parameters(const struct audio_device *adev __unused,
             }
         }
     }
+    pthread_mutex_unlock(&ssrmod.lock);
 }
-
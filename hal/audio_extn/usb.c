@@ -45,6 +45,8 @@
 #endif
 
 #define USB_BUFF_SIZE           2048
+/* stream0 of a device with many altsets outgrows USB_BUFF_SIZE */
+#define USB_STREAM_FILE_MAX     (64 * 1024)
 #define CHANNEL_NUMBER_STR      "Channels: "
 #define PLAYBACK_PROFILE_STR    "Playback:"
 #define CAPTURE_PROFILE_STR     "Capture:"
@@ -67,6 +69,12 @@ static uint32_t supported_sample_rates_mask[2];
 #define _MAX(x, y) (((x) >= (y)) ? (x) : (y))
 #define _MIN(x, y) (((x) <= (y)) ? (x) : (y))
 
+/* Bit widths of the stream0 formats, see usb_get_capability() */
+static const unsigned int usb_caps_bit_widths[] = { 16, 24, 32 };
+#define USB_CAPS_NUM_BIT_WIDTHS \
+    (sizeof(usb_caps_bit_widths)/sizeof(usb_caps_bit_widths[0]))
+#define USB_CAPS_MAX_CHANNELS   32
+
 typedef enum usb_usecase_type{
     USB_PLAYBACK = 0,
     USB_CAPTURE,
@@ -88,11 +96,31 @@ struct usb_device_config {
     usb_usecase_type_t type;
 };
 
+/*
+ * Altsets of a card indexed by bit width and channel count, built once when
+ * the card is added so that matching a stream config to the card doesn't
+ * walk the altset list. Rates are masks over supported_sample_rates. The
+ * sample rate policy matches exactly against all altsets of a bit width and
+ * channel count but picks the nearest rate from the last one only, so both
+ * are kept. Cards with an altset the table can't hold (unknown format, more
+ * than USB_CAPS_MAX_CHANNELS channels) are matched on the list instead.
+ */
+struct usb_card_caps {
+    bool valid;
+    uint32_t bit_width_mask;
+    uint32_t channel_mask[USB_CAPS_NUM_BIT_WIDTHS];
+    uint32_t rate_mask[USB_CAPS_NUM_BIT_WIDTHS][USB_CAPS_MAX_CHANNELS];
+    uint32_t last_rate_mask[USB_CAPS_NUM_BIT_WIDTHS][USB_CAPS_MAX_CHANNELS];
+    unsigned int max_bit_width;
+    unsigned int max_channels;
+};
+
 struct usb_card_config {
     struct listnode list;
     audio_devices_t usb_device_type;
     int usb_card;
     struct listnode usb_device_conf_list;
+    struct usb_card_caps caps;
     struct mixer *usb_snd_mixer;
     int usb_sidetone_index[USB_SIDETONE_MAX_INDEX];
     int usb_sidetone_vol_min;
@@ -361,7 +389,8 @@ static int usb_get_sample_rates(int type, char *rates_str,
                 continue;
             }
 
-            for (i = 0; i < MAX_SAMPLE_RATE_SIZE; i++) {
+            for (i = 0; i < MAX_SAMPLE_RATE_SIZE &&
+                        sr_size < MAX_SAMPLE_RATE_SIZE; i++) {
                 if (supported_sample_rates[i] == sr) {
                     ALOGI_IF(usb_audio_debug_enable,
                         "%s: sr %d, supported_sample_rates[%d] %d -> matches!!",
@@ -436,6 +465,9 @@ static int usb_get_capability(int type,
     char *bit_width_str = NULL;
     struct usb_device_config * usb_device_info;
     bool check = false;
+    size_t buf_size = USB_BUFF_SIZE;
+    size_t len = 0;
+    ssize_t bytes;
 
     memset(path, 0, sizeof(path));
     ALOGV("%s: for %s", __func__, (type == USB_PLAYBACK) ?
@@ -457,7 +489,7 @@ static int usb_get_capability(int type,
         goto done;
     }
 
-    read_buf = (char *)calloc(1, USB_BUFF_SIZE + 1);
+    read_buf = (char *)calloc(1, buf_size + 1);
 
     if (!read_buf) {
         ALOGE("Failed to create read_buf");
@@ -465,10 +497,29 @@ static int usb_get_capability(int type,
         goto done;
     }
 
-    if(read(fd, read_buf, USB_BUFF_SIZE) < 0) {
+    /* procfs hands the file out in chunks, read it whole */
+    while ((bytes = read(fd, read_buf + len, buf_size - len)) > 0) {
+        len += bytes;
+        if (len < buf_size)
+            continue;
+        if (buf_size >= USB_STREAM_FILE_MAX) {
+            ALOGW("%s: %s truncated at %zu bytes", __func__, path, len);
+            break;
+        }
+        buf_size *= 2;
+        target = (char *)realloc(read_buf, buf_size + 1);
+        if (target == NULL) {
+            ALOGE("%s: unable to grow read_buf", __func__);
+            ret = -ENOMEM;
+            goto done;
+        }
+        read_buf = target;
+    }
+    if (bytes < 0) {
         ALOGE("file read error\n");
         goto done;
     }
+    read_buf[len] = '\0';
     str_start = strstr(read_buf, ((type == USB_PLAYBACK) ?
                        PLAYBACK_PROFILE_STR : CAPTURE_PROFILE_STR));
     if (str_start == NULL) {
@@ -623,15 +674,14 @@ exit:
     return ret;
 }
 
-static int usb_get_usbid(struct usb_card_config *usb_card_info,
-                              int card)
+static int usb_get_usbid(char *usbid, int card)
 {
     int32_t fd=-1;
     char path[128];
     int ret = 0;
     char *saveptr = NULL;
 
-    memset(usb_card_info->usbid, 0, sizeof(usb_card_info->usbid));
+    memset(usbid, 0, USBID_SIZE);
 
     ret = snprintf(path, sizeof(path), "/proc/asound/card%u/usbid",
              card);
@@ -650,14 +700,14 @@ static int usb_get_usbid(struct usb_card_config *usb_card_info,
         goto done;
     }
 
-    if (read(fd, usb_card_info->usbid, USBID_SIZE - 1) < 0) {
+    if (read(fd, usbid, USBID_SIZE - 1) < 0) {
         ALOGE("file read error\n");
         ret = -EINVAL;
-        usb_card_info->usbid[0] = '\0';
+        usbid[0] = '\0';
         goto done;
     }
 
-    strtok_r(usb_card_info->usbid, "\n", &saveptr);
+    strtok_r(usbid, "\n", &saveptr);
 
 done:
     if (fd >= 0)
@@ -965,11 +1015,146 @@ exit:
     return true;
 }
 
-static bool usb_audio_backend_apply_policy(struct listnode *dev_list,
+static int usb_caps_bit_width_index(unsigned int bit_width)
+{
+    unsigned int i;
+
+    for (i = 0; i < USB_CAPS_NUM_BIT_WIDTHS; i++) {
+        if (usb_caps_bit_widths[i] == bit_width)
+            return i;
+    }
+    return -1;
+}
+
+static int usb_caps_rate_index(unsigned int rate)
+{
+    unsigned int i;
+
+    for (i = 0; i < MAX_SAMPLE_RATE_SIZE; i++) {
+        if (supported_sample_rates[i] == rate)
+            return i;
+    }
+    return -1;
+}
+
+static void usb_build_caps(struct usb_card_config *card_info)
+{
+    struct usb_card_caps *caps = &card_info->caps;
+    struct listnode *node_i;
+    struct usb_device_config *dev_info;
+    uint32_t rate_mask;
+    int bw_idx, rate_idx;
+    unsigned int i;
+
+    memset(caps, 0, sizeof(*caps));
+    caps->valid = true;
+    caps->max_bit_width = 16;
+    caps->max_channels = 1;
+    list_for_each(node_i, &card_info->usb_device_conf_list) {
+        dev_info = node_to_item(node_i, struct usb_device_config, list);
+        caps->max_bit_width = _MAX(caps->max_bit_width, dev_info->bit_width);
+        caps->max_channels = _MAX(caps->max_channels, dev_info->channels);
+
+        bw_idx = usb_caps_bit_width_index(dev_info->bit_width);
+        if ((bw_idx < 0) || (dev_info->channels < 1) ||
+            (dev_info->channels > USB_CAPS_MAX_CHANNELS)) {
+            ALOGI("%s: bw(%d) ch(%d) not indexed, card %d uses the altset list",
+                  __func__, dev_info->bit_width, dev_info->channels,
+                  card_info->usb_card);
+            caps->valid = false;
+            continue;
+        }
+        rate_mask = 0;
+        for (i = 0; i < dev_info->rate_size; i++) {
+            rate_idx = usb_caps_rate_index(dev_info->rates[i]);
+            if (rate_idx >= 0)
+                rate_mask |= (1 << rate_idx);
+        }
+        caps->bit_width_mask |= (1 << bw_idx);
+        caps->channel_mask[bw_idx] |= (1 << (dev_info->channels - 1));
+        caps->rate_mask[bw_idx][dev_info->channels - 1] |= rate_mask;
+        caps->last_rate_mask[bw_idx][dev_info->channels - 1] = rate_mask;
+    }
+    if (caps->bit_width_mask == 0)
+        caps->valid = false;
+}
+
+/*
+ * Same policy as usb_get_best_match_for_bit_width() and friends, on the
+ * indexed table. Candidates within a mask are compared with the rules of
+ * the list walk, which don't depend on the order they are visited in.
+ */
+static void usb_caps_apply_policy(const struct usb_card_caps *caps,
+                                  unsigned int *bit_width,
+                                  unsigned int *sample_rate,
+                                  unsigned int *ch)
+{
+    unsigned int bw = *bit_width, stream_ch = *ch, stream_sr = *sample_rate;
+    unsigned int candidate = 0, value, base;
+    uint32_t mask;
+    int bw_idx = 0, rate_idx;
+    unsigned int i;
+
+    for (i = 0; i < USB_CAPS_NUM_BIT_WIDTHS; i++) {
+        if (!(caps->bit_width_mask & (1 << i)))
+            continue;
+        value = usb_caps_bit_widths[i];
+        if ((candidate == 0) || (value == bw) ||
+            (ABS_SUB(bw, value) < ABS_SUB(bw, candidate)) ||
+            ((ABS_SUB(bw, value) == ABS_SUB(bw, candidate)) &&
+             (value > candidate))) {
+            candidate = value;
+            bw_idx = i;
+        }
+        if (value == bw)
+            break;
+    }
+    *bit_width = candidate;
+
+    candidate = 0;
+    mask = caps->channel_mask[bw_idx];
+    while (mask) {
+        i = __builtin_ctz(mask);
+        mask &= ~(1 << i);
+        value = i + 1;
+        if ((candidate == 0) || (value == stream_ch) ||
+            (ABS_SUB(stream_ch, value) < ABS_SUB(stream_ch, candidate)) ||
+            ((ABS_SUB(stream_ch, value) == ABS_SUB(stream_ch, candidate)) &&
+             (value > candidate)))
+            candidate = value;
+        if (value == stream_ch)
+            break;
+    }
+    *ch = candidate;
+
+    rate_idx = usb_caps_rate_index(stream_sr);
+    if ((rate_idx >= 0) &&
+        (caps->rate_mask[bw_idx][candidate - 1] & (1 << rate_idx)))
+        return;
+
+    base = usb_sample_rate_multiple(stream_sr, SAMPLE_RATE_8000) ?
+           SAMPLE_RATE_8000 : SAMPLE_RATE_11025;
+    mask = caps->last_rate_mask[bw_idx][candidate - 1];
+    candidate = 0;
+    while (mask) {
+        i = __builtin_ctz(mask);
+        mask &= ~(1 << i);
+        if (candidate == 0)
+            candidate = supported_sample_rates[i];
+        else
+            usb_find_sample_rate_candidate(base, stream_sr,
+                                           supported_sample_rates[i],
+                                           candidate, &candidate);
+    }
+    *sample_rate = candidate;
+}
+
+static bool usb_audio_backend_apply_policy(struct usb_card_config *card_info,
                                            unsigned int *bit_width,
                                            unsigned int *sample_rate,
                                            unsigned int *ch)
 {
+    struct listnode *dev_list = &card_info->usb_device_conf_list;
     bool is_usb_supported = true;
 
     ALOGV("%s: from stream: bit-width(%d) sample_rate(%d) channels (%d)",
@@ -981,6 +1166,10 @@ static bool usb_audio_backend_apply_policy(struct listnode *dev_list,
         ALOGI("%s: list is empty,fall back to default setting", __func__);
         goto exit;
     }
+    if (card_info->caps.valid) {
+        usb_caps_apply_policy(&card_info->caps, bit_width, sample_rate, ch);
+        goto exit;
+    }
     usb_get_best_match_for_bit_width(dev_list, *bit_width, bit_width);
     usb_get_best_match_for_channels(dev_list,
                                     *bit_width,
@@ -1070,7 +1259,7 @@ bool usb_is_config_supported(unsigned int *bit_width,
         if ((is_playback && usb_output_device(card_info->usb_device_type)) ||
             (!is_playback && usb_input_device(card_info->usb_device_type))){
             is_usb_supported = usb_audio_backend_apply_policy(
-                                           &card_info->usb_device_conf_list,
+                                           card_info,
                                            bit_width,
                                            sample_rate,
                                            ch);
@@ -1085,8 +1274,7 @@ bool usb_is_config_supported(unsigned int *bit_width,
 
 int usb_get_max_channels(bool is_playback)
 {
-    struct listnode *node_i, *node_j;
-    struct usb_device_config *dev_info;
+    struct listnode *node_i;
     struct usb_card_config *card_info;
     unsigned int max_ch = 1;
     list_for_each(node_i, &usbmod->usb_card_conf_list) {
@@ -1096,10 +1284,7 @@ int usb_get_max_channels(bool is_playback)
             else if (usb_input_device(card_info->usb_device_type) && is_playback)
                 continue;
 
-            list_for_each(node_j, &card_info->usb_device_conf_list) {
-                dev_info = node_to_item(node_j, struct usb_device_config, list);
-                max_ch = _MAX(max_ch, dev_info->channels);
-            }
+            max_ch = _MAX(max_ch, card_info->caps.max_channels);
     }
 
     return max_ch;
@@ -1107,8 +1292,7 @@ int usb_get_max_channels(bool is_playback)
 
 int usb_get_max_bit_width(bool is_playback)
 {
-    struct listnode *node_i, *node_j;
-    struct usb_device_config *dev_info;
+    struct listnode *node_i;
     struct usb_card_config *card_info;
     unsigned int max_bw = 16;
     list_for_each(node_i, &usbmod->usb_card_conf_list) {
@@ -1118,10 +1302,7 @@ int usb_get_max_bit_width(bool is_playback)
             else if (usb_input_device(card_info->usb_device_type) && is_playback)
                 continue;
 
-            list_for_each(node_j, &card_info->usb_device_conf_list) {
-                dev_info = node_to_item(node_j, struct usb_device_config, list);
-                max_bw = _MAX(max_bw, dev_info->bit_width);
-            }
+            max_bw = _MAX(max_bw, card_info->caps.max_bit_width);
     }
 
     return max_bw;
@@ -1163,10 +1344,36 @@ bool usb_is_tunnel_supported()
     return true;
 }
 
+static void usb_free_device_configs(struct usb_card_config *card_info)
+{
+    struct listnode *node_j, *temp_j;
+    struct usb_device_config *dev_info;
+    unsigned int i;
+
+    list_for_each_safe(node_j, temp_j, &card_info->usb_device_conf_list) {
+        dev_info = node_to_item(node_j, struct usb_device_config, list);
+        ALOGV("%s: bit-width(%d) channel(%d)",
+               __func__, dev_info->bit_width, dev_info->channels);
+        for (i =  0; i < dev_info->rate_size; i++)
+            ALOGV("%s: rate %d", __func__, dev_info->rates[i]);
+
+        list_remove(node_j);
+        free(dev_info);
+    }
+}
+
+static void usb_free_card_config(struct usb_card_config *card_info)
+{
+    usb_free_device_configs(card_info);
+    list_remove(&card_info->list);
+    free(card_info);
+}
+
 void usb_add_device(audio_devices_t device, int card)
 {
     struct usb_card_config *usb_card_info;
     char check_debug_enable[PROPERTY_VALUE_MAX];
+    char usbid[USBID_SIZE];
     struct listnode *node_i;
 
     if (property_get("vendor.audio.usb.enable.debug",
@@ -1196,6 +1403,19 @@ void usb_add_device(audio_devices_t device, int card)
                  __func__,  usb_card_info->usb_device_type, usb_card_info->usb_card);
         /* If we have cached the capability */
         if ((usb_card_info->usb_device_type == device) && (usb_card_info->usb_card == card)) {
+            /*
+             * The card number is reused for the next device plugged in, if
+             * the disconnect was missed the cache belongs to the old one.
+             */
+            if ((usb_get_usbid(usbid, card) >= 0) && (usbid[0] != '\0') &&
+                strncmp(usbid, usb_card_info->usbid, USBID_SIZE)) {
+                ALOGI("%s: card(%d) is now %s, was %s, drop cached capability",
+                      __func__, card, usbid, usb_card_info->usbid);
+                usb_free_card_config(usb_card_info);
+                supported_sample_rates_mask[usb_output_device(device) ?
+                                            USB_PLAYBACK : USB_CAPTURE] = 0;
+                break;
+            }
             ALOGV("%s: capability for device(0x%x), card(%d) is cached, no need to update",
                   __func__, device, card);
             goto exit;
@@ -1209,33 +1429,37 @@ void usb_add_device(audio_devices_t device, int card)
     }
     list_init(&usb_card_info->usb_device_conf_list);
     if (usb_output_device(device)) {
-        if (usb_get_usbid(usb_card_info, card) < 0) {
+        if (usb_get_usbid(usb_card_info->usbid, card) < 0) {
             ALOGE("parse card %d usbid fail", card);
         }
 
         if (!usb_get_device_pb_config(usb_card_info, card)){
             usb_card_info->usb_card = card;
             usb_card_info->usb_device_type = device;
+            usb_build_caps(usb_card_info);
             usb_get_sidetone_mixer(usb_card_info);
             list_add_tail(&usbmod->usb_card_conf_list, &usb_card_info->list);
             goto exit;
         }
     } else if (usb_input_device(device)) {
-        if (usb_get_usbid(usb_card_info, card) < 0) {
+        if (usb_get_usbid(usb_card_info->usbid, card) < 0) {
             ALOGE("parse card %d usbid fail", card);
         }
 
         if (!usb_get_device_cap_config(usb_card_info, card)) {
             usb_card_info->usb_card = card;
             usb_card_info->usb_device_type = device;
+            usb_build_caps(usb_card_info);
             usbmod->is_capture_supported = true;
             list_add_tail(&usbmod->usb_card_conf_list, &usb_card_info->list);
             goto exit;
         }
     }
     /* free memory in error case */
-    if (usb_card_info != NULL)
+    if (usb_card_info != NULL) {
+        usb_free_device_configs(usb_card_info);
         free(usb_card_info);
+    }
 exit:
     if (usb_audio_debug_enable)
         usb_print_active_device();
@@ -1245,10 +1469,7 @@ exit:
 void usb_remove_device(audio_devices_t device, int card)
 {
     struct listnode *node_i, *temp_i;
-    struct listnode *node_j, *temp_j;
-    struct usb_device_config *dev_info;
     struct usb_card_config *card_info;
-    unsigned int i;
 
     ALOGV("%s: device(0x%x), card(%d)",
            __func__, device, card);
@@ -1267,20 +1488,8 @@ void usb_remove_device(audio_devices_t device, int card)
         card_info = node_to_item(node_i, struct usb_card_config, list);
         ALOGV("%s: card_dev_type (0x%x), card_no(%d)",
                __func__,  card_info->usb_device_type, card_info->usb_card);
-        if ((device == card_info->usb_device_type) && (card == card_info->usb_card)){
-            list_for_each_safe(node_j, temp_j, &card_info->usb_device_conf_list) {
-                dev_info = node_to_item(node_j, struct usb_device_config, list);
-                ALOGV("%s: bit-width(%d) channel(%d)",
-                       __func__, dev_info->bit_width, dev_info->channels);
-                for (i =  0; i < dev_info->rate_size; i++)
-                    ALOGV("%s: rate %d", __func__, dev_info->rates[i]);
-
-                list_remove(node_j);
-                free(node_to_item(node_j, struct usb_device_config, list));
-            }
-            list_remove(node_i);
-            free(node_to_item(node_i, struct usb_card_config, list));
-        }
+        if ((device == card_info->usb_device_type) && (card == card_info->usb_card))
+            usb_free_card_config(card_info);
     }
     if (audio_is_usb_in_device(device)) { // XXX not sure if we need to check for card
         usbmod->is_capture_supported = false;
@@ -1470,7 +1679,7 @@ int usb_check_and_set_svc_int(struct audio_usecase *uc_info,
         list_for_each(node, &adev->usecase_list) {
             usecase = node_to_item(node, struct audio_usecase, list);
             if (usecase->type == PCM_PLAYBACK &&
-                is_usb_out_device_type(&usecase->device_list)) {
+                device_set_has(&usecase->device_list, DEVICE_SET_USB_OUT)) {
                 switch (usecase->id) {
                     case USECASE_AUDIO_PLAYBACK_MMAP:
                     case USECASE_AUDIO_PLAYBACK_ULL:
@@ -30,6 +30,7 @@
 #include <log/log.h>
 #include <cutils/misc.h>
 #include <unistd.h>
+#include <time.h>
 #include <sys/ioctl.h>
 
 
@@ -44,6 +45,14 @@
 #include <sound/devdep_params.h>
 #include <tinycompress/tinycompress.h>
 
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define UTILS_NEON
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define UTILS_SSE2
+#endif
+
 #ifdef DYNAMIC_LOG_ENABLED
 #include <log_xml_parser.h>
 #define LOG_MASK HAL_MOD_FILE_UTILS
@@ -67,6 +76,7 @@
 #define SAMPLING_RATES_TAG "sampling_rates"
 #define BIT_WIDTH_TAG "bit_width"
 #define APP_TYPE_TAG "app_type"
+#define STANDBY_DELAY_TAG "standby_delay_ms"
 
 #define STRING_TO_ENUM(string) { #string, string }
 #define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
@@ -379,6 +389,8 @@ static void update_streams_cfg_list(cnode *root, void *platform,
             s_info->app_type_cfg.bit_width = parse_bit_width_names((char *)node->value);
         } else if (strcmp(node->name, APP_TYPE_TAG) == 0) {
             s_info->app_type_cfg.app_type = parse_app_type_names(platform, (char *)node->value);
+        } else if (strcmp(node->name, STANDBY_DELAY_TAG) == 0) {
+            s_info->standby_delay_ms = (uint32_t)strtoul((char *)node->value, NULL, 10);
         }
         node = node->next;
     }
@@ -612,9 +624,10 @@ static void audio_extn_utils_dump_streams_cfg_list(
 
     list_for_each(node_i, streams_cfg_list) {
         s_info = node_to_item(node_i, struct streams_io_cfg, list);
-        ALOGV("%s: flags-%d, sample_rate-%d, bit_width-%d, app_type-%d",
+        ALOGV("%s: flags-%d, sample_rate-%d, bit_width-%d, app_type-%d, standby_delay_ms-%u",
                __func__, s_info->flags.out_flags, s_info->app_type_cfg.sample_rate,
-               s_info->app_type_cfg.bit_width, s_info->app_type_cfg.app_type);
+               s_info->app_type_cfg.bit_width, s_info->app_type_cfg.app_type,
+               s_info->standby_delay_ms);
         list_for_each(node_j, &s_info->format_list) {
             sf_info = node_to_item(node_j, struct stream_format, list);
             ALOGV("format-%x", sf_info->format);
@@ -836,6 +849,29 @@ void audio_extn_utils_update_stream_output_app_type_cfg(void *platform,
     app_type_cfg->bit_width = 16;
 }
 
+/*
+ * Time an output with these flags and profile stays in warm standby, with
+ * its PCM prepared and route applied, before it is fully stopped. 0 when
+ * the matching output does not configure standby_delay_ms.
+ */
+uint32_t audio_extn_utils_get_output_standby_delay(
+                                  struct listnode *streams_output_cfg_list,
+                                  audio_output_flags_t flags,
+                                  char *profile)
+{
+    struct listnode *node;
+    struct streams_io_cfg *s_info;
+
+    list_for_each(node, streams_output_cfg_list) {
+        s_info = node_to_item(node, struct streams_io_cfg, list);
+        if (s_info->flags.out_flags == flags &&
+            ((profile[0] == '\0' && s_info->profile[0] == '\0') ||
+             strncmp(s_info->profile, profile, sizeof(s_info->profile)) == 0))
+            return s_info->standby_delay_ms;
+    }
+    return 0;
+}
+
 static bool audio_is_this_native_usecase(struct audio_usecase *uc)
 {
     bool native_usecase = false;
@@ -907,7 +943,7 @@ void audio_extn_utils_update_stream_app_type_cfg_for_usecase(
     case PCM_PLAYBACK:
         audio_extn_utils_update_stream_output_app_type_cfg(adev->platform,
                                                 &adev->streams_output_cfg_list,
-                                                &usecase->stream.out->device_list,
+                                                &usecase->stream.out->device_list.list,
                                                 usecase->stream.out->flags,
                                                 usecase->stream.out->hal_op_format,
                                                 usecase->stream.out->sample_rate,
@@ -923,7 +959,7 @@ void audio_extn_utils_update_stream_app_type_cfg_for_usecase(
         else
             audio_extn_utils_update_stream_input_app_type_cfg(adev->platform,
                                                 &adev->streams_input_cfg_list,
-                                                &usecase->stream.in->device_list,
+                                                &usecase->stream.in->device_list.list,
                                                 usecase->stream.in->flags,
                                                 usecase->stream.in->format,
                                                 usecase->stream.in->sample_rate,
@@ -1053,7 +1089,7 @@ static int audio_extn_utils_send_app_type_cfg_hfp(struct audio_device *adev,
         goto exit_send_app_type_cfg;
     }
 
-    if (compare_device_type(&usecase->device_list, AUDIO_DEVICE_OUT_BUS))
+    if (device_set_has_type(&usecase->device_list, AUDIO_DEVICE_OUT_BUS))
         is_bus_dev_usecase = true;
 
     snd_device = usecase->out_snd_device;
@@ -1185,7 +1221,7 @@ int audio_extn_utils_get_app_sample_rate_for_device(
                    audio_extn_a2dp_get_enc_sample_rate(&usecase->stream.out->app_type_cfg.sample_rate);
                    ALOGI("%s using %d sample rate rate for A2DP CoPP",
                         __func__, usecase->stream.out->app_type_cfg.sample_rate);
-        } else if (compare_device_type(&usecase->stream.out->device_list,
+        } else if (device_set_has_type(&usecase->stream.out->device_list,
                                        AUDIO_DEVICE_OUT_SPEAKER)) {
             usecase->stream.out->app_type_cfg.sample_rate = DEFAULT_OUTPUT_SAMPLING_RATE;
         }
@@ -1703,18 +1739,66 @@ void audio_extn_utils_update_direct_pcm_fragment_size(struct stream_out *out)
     }
 }
 
+/*
+ * Sleep for the duration of a buffer of silence handed out in place of audio
+ * after a read or write error. Consecutive calls are paced against the
+ * absolute deadline kept in *next, so back to back errors keep the stream
+ * cadence and the time spent outside the sleep is not added to each period.
+ * The deadline restarts from now when the last period ended more than a
+ * period ago.
+ */
+void audio_extn_utils_sleep_silence(struct timespec *next, size_t bytes,
+                                    size_t frame_size, uint32_t sample_rate)
+{
+    struct timespec now;
+    int64_t period_ns, behind_ns;
+
+    if (frame_size == 0 || sample_rate == 0)
+        return;
+
+    period_ns = (int64_t)(bytes / frame_size) * 1000000000LL / sample_rate;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    behind_ns = (now.tv_sec - next->tv_sec) * 1000000000LL +
+                (now.tv_nsec - next->tv_nsec);
+    if (behind_ns > period_ns)
+        *next = now;
+
+    next->tv_nsec += period_ns % 1000000000LL;
+    next->tv_sec += period_ns / 1000000000LL + next->tv_nsec / 1000000000LL;
+    next->tv_nsec %= 1000000000LL;
+
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, next, NULL) == EINTR)
+        ;
+}
+
 /* converts pcm format 24_8 to 8_24 inplace */
 size_t audio_extn_utils_convert_format_24_8_to_8_24(void *buf, size_t bytes)
 {
-    size_t i = 0;
-    int *int_buf_stream = buf;
+    size_t i = 0, samples = bytes / 4;
+    int32_t *int_buf_stream = buf;
 
     if ((bytes % 4) != 0) {
         ALOGE("%s: wrong inout buffer! ... is not 32 bit aligned ", __func__);
         return -EINVAL;
     }
 
-    for (; i < (bytes / 4); i++)
+    /* arithmetic shift keeps the sign of the 24 bit sample */
+#if defined(UTILS_NEON)
+    for (; i + 8 <= samples; i += 8) {
+        int32x4_t lo = vld1q_s32(int_buf_stream + i);
+        int32x4_t hi = vld1q_s32(int_buf_stream + i + 4);
+        vst1q_s32(int_buf_stream + i, vshrq_n_s32(lo, 8));
+        vst1q_s32(int_buf_stream + i + 4, vshrq_n_s32(hi, 8));
+    }
+#elif defined(UTILS_SSE2)
+    for (; i + 8 <= samples; i += 8) {
+        __m128i lo = _mm_loadu_si128((const __m128i *)(int_buf_stream + i));
+        __m128i hi = _mm_loadu_si128((const __m128i *)(int_buf_stream + i + 4));
+        _mm_storeu_si128((__m128i *)(int_buf_stream + i), _mm_srai_epi32(lo, 8));
+        _mm_storeu_si128((__m128i *)(int_buf_stream + i + 4), _mm_srai_epi32(hi, 8));
+    }
+#endif
+    for (; i < samples; i++)
         int_buf_stream[i] >>= 8;
 
     return bytes;
@@ -2202,7 +2286,7 @@ int audio_extn_utils_get_avt_device_drift(
         backend = platform_get_snd_device_backend_interface(usecase->out_snd_device);
         if (!backend) {
             ALOGE("%s: Unsupported device %d", __func__,
-                   get_device_types(&usecase->stream.out->device_list));
+                   device_set_types(&usecase->stream.out->device_list));
             ret = -EINVAL;
             goto done;
         }
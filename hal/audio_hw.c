@@ -671,7 +671,7 @@ static inline void adjust_frames_for_device_delay(struct stream_out *out,
                                                   uint32_t *dsp_frames) {
     // Adjustment accounts for A2dp encoder latency with offload usecases
     // Note: Encoder latency is returned in ms.
-    if (is_a2dp_out_device_type(&out->device_list)) {
+    if (device_set_has(&out->device_list, DEVICE_SET_A2DP_OUT)) {
         unsigned long offset =
                 (audio_extn_a2dp_get_encoder_latency() * out->sample_rate / 1000);
         *dsp_frames = (*dsp_frames > offset) ? (*dsp_frames - offset) : 0;
@@ -724,12 +724,12 @@ static inline int io_streams_map_insert(struct audio_device *adev,
     s_info->stream = stream;
     s_info->patch_handle = patch_handle;
 
-    pthread_mutex_lock(&adev->lock);
+    ADEV_LOCK(adev);
     struct audio_stream_info *stream_info =
             hashmapPut(adev->io_streams_map, (void *) (intptr_t) handle, (void *) s_info);
     if (stream_info != NULL)
         free(stream_info);
-    pthread_mutex_unlock(&adev->lock);
+    ADEV_UNLOCK(adev);
     ALOGD("%s: Added stream in io_streams_map with handle %d", __func__, handle);
     return 0;
 }
@@ -737,7 +737,7 @@ static inline int io_streams_map_insert(struct audio_device *adev,
 static inline void io_streams_map_remove(struct audio_device *adev,
                                      audio_io_handle_t handle)
 {
-    pthread_mutex_lock(&adev->lock);
+    ADEV_LOCK(adev);
     struct audio_stream_info *s_info =
             hashmapRemove(adev->io_streams_map, (void *) (intptr_t) handle);
     if (s_info == NULL)
@@ -746,7 +746,7 @@ static inline void io_streams_map_remove(struct audio_device *adev,
     patch_map_remove_l(adev, s_info->patch_handle);
     free(s_info);
 done:
-    pthread_mutex_unlock(&adev->lock);
+    ADEV_UNLOCK(adev);
     return;
 }
 
@@ -767,14 +767,14 @@ bool audio_hw_send_gain_dep_calibration(int level) {
     pthread_mutex_lock(&adev_init_lock);
 
     if (adev != NULL && adev->platform != NULL) {
-        pthread_mutex_lock(&adev->lock);
+        ADEV_LOCK(adev);
         ret_val = platform_send_gain_dep_cal(adev->platform, level);
 
         // cache level info for any of the use case which
         // was not started.
         last_known_cal_step = level;;
 
-        pthread_mutex_unlock(&adev->lock);
+        ADEV_UNLOCK(adev);
     } else {
         ALOGE("%s: %s is NULL", __func__, adev == NULL ? "adev" : "adev->platform");
     }
@@ -823,9 +823,9 @@ int audio_hw_get_gain_level_mapping(struct amp_db_and_gain_table *mapping_tbl,
          goto done;
      }
 
-     pthread_mutex_lock(&adev->lock);
+     ADEV_LOCK(adev);
      ret_val = platform_get_gain_level_mapping(mapping_tbl, table_size);
-     pthread_mutex_unlock(&adev->lock);
+     ADEV_UNLOCK(adev);
 done:
      pthread_mutex_unlock(&adev_init_lock);
      ALOGV("%s: exit ... ", __func__);
@@ -840,9 +840,9 @@ bool audio_hw_send_qdsp_parameter(int stream_type, float vol, bool active)
     pthread_mutex_lock(&adev_init_lock);
 
     if (adev != NULL && adev->platform != NULL) {
-        pthread_mutex_lock(&adev->lock);
+        ADEV_LOCK(adev);
         ret = audio_extn_qdsp_set_state(adev, stream_type, vol, active);
-        pthread_mutex_unlock(&adev->lock);
+        ADEV_UNLOCK(adev);
     }
 
     pthread_mutex_unlock(&adev_init_lock);
@@ -1162,6 +1162,51 @@ int pcm_ioctl(struct pcm *pcm, int request, ...)
     return ioctl(pcm_fd, request, arg);
 }
 
+/*
+ * Route transactions batch the usecase mixer paths switched together, e.g.
+ * all the usecases moved by a backend change. Between route_txn_begin() and
+ * route_txn_commit(), enable_audio_route() and disable_audio_route() only
+ * stage their path in audio_route; the commit writes the net control change
+ * in a single audio_route_update_mixer() pass. Anything updating the mixer
+ * in between also flushes the staged paths, so ordering is preserved.
+ */
+static void route_txn_begin(struct audio_device *adev)
+{
+    adev->route_txn_depth++;
+}
+
+static void route_txn_commit(struct audio_device *adev)
+{
+    if (adev->route_txn_depth <= 0) {
+        ALOGE("%s: no route transaction in progress", __func__);
+        return;
+    }
+    if (--adev->route_txn_depth == 0 && adev->route_txn_pending) {
+        ATRACE_BEGIN("route_txn_commit");
+        audio_route_update_mixer(adev->audio_route);
+        ATRACE_END();
+        adev->route_txn_pending = false;
+    }
+}
+
+static int route_txn_apply_path(struct audio_device *adev, const char *mixer_path)
+{
+    if (adev->route_txn_depth == 0)
+        return audio_route_apply_and_update_path(adev->audio_route, mixer_path);
+
+    adev->route_txn_pending = true;
+    return audio_route_apply_path(adev->audio_route, mixer_path);
+}
+
+static int route_txn_reset_path(struct audio_device *adev, const char *mixer_path)
+{
+    if (adev->route_txn_depth == 0)
+        return audio_route_reset_and_update_path(adev->audio_route, mixer_path);
+
+    adev->route_txn_pending = true;
+    return audio_route_reset_path(adev->audio_route, mixer_path);
+}
+
 int enable_audio_route(struct audio_device *adev,
                        struct audio_usecase *usecase)
 {
@@ -1191,17 +1236,18 @@ int enable_audio_route(struct audio_device *adev,
                                                            USECASE_AUDIO_PLAYBACK_VOIP);
                 if (voip_usecase) {
                     assign_devices(&out_devices,
-                                   &voip_usecase->stream.out->device_list);
+                                   &voip_usecase->stream.out->device_list.list);
                 } else if (adev->primary_output &&
-                              !adev->primary_output->standby) {
+                              !adev->primary_output->standby &&
+                              !adev->primary_output->warm_standby) {
                     assign_devices(&out_devices,
-                                   &adev->primary_output->device_list);
+                                   &adev->primary_output->device_list.list);
                 } else {
                     list_for_each(node, &adev->usecase_list) {
                         uinfo = node_to_item(node, struct audio_usecase, list);
                         if (uinfo->type != PCM_CAPTURE) {
                             assign_devices(&out_devices,
-                                           &uinfo->stream.out->device_list);
+                                           &uinfo->stream.out->device_list.list);
                             break;
                         }
                     }
@@ -1238,7 +1284,7 @@ int enable_audio_route(struct audio_device *adev,
 
     if (usecase->type == PCM_CAPTURE) {
         in = usecase->stream.in;
-        if (in && is_loopback_input_device(get_device_types(&in->device_list))) {
+        if (in && is_loopback_input_device(device_set_types(&in->device_list))) {
             ALOGD("%s: set custom mtmx params v1", __func__);
             audio_extn_set_custom_mtmx_params_v1(adev, usecase, true);
         }
@@ -1252,8 +1298,13 @@ int enable_audio_route(struct audio_device *adev,
     // this also appends to mixer_path
     platform_add_backend_name(mixer_path, snd_device, usecase);
     ALOGD("%s: apply mixer and update path: %s", __func__, mixer_path);
-    ret = audio_route_apply_and_update_path(adev->audio_route, mixer_path);
+    ret = route_txn_apply_path(adev, mixer_path);
     if (!ret && usecase->id == USECASE_AUDIO_PLAYBACK_FM) {
+        /* the volume needs the route in place */
+        if (adev->route_txn_pending) {
+            audio_route_update_mixer(adev->audio_route);
+            adev->route_txn_pending = false;
+        }
         struct str_parms *parms = str_parms_create_str("fm_restore_volume=1");
         if (parms) {
             audio_extn_fm_set_parameters(adev, parms);
@@ -1310,7 +1361,7 @@ int disable_audio_route(struct audio_device *adev,
     // this also appends to mixer_path
     platform_add_backend_name(mixer_path, snd_device, usecase);
     ALOGD("%s: reset and update mixer path: %s", __func__, mixer_path);
-    audio_route_reset_and_update_path(adev->audio_route, mixer_path);
+    route_txn_reset_path(adev, mixer_path);
     if (usecase->type == PCM_CAPTURE) {
         struct stream_in *in = usecase->stream.in;
         if (in && in->ec_opened) {
@@ -1325,7 +1376,7 @@ int disable_audio_route(struct audio_device *adev,
 
     if (usecase->type == PCM_CAPTURE) {
         in = usecase->stream.in;
-        if (in && is_loopback_input_device(get_device_types(&in->device_list))) {
+        if (in && is_loopback_input_device(device_set_types(&in->device_list))) {
             ALOGD("%s: reset custom mtmx params v1", __func__);
             audio_extn_set_custom_mtmx_params_v1(adev, usecase, false);
         }
@@ -1368,6 +1419,10 @@ int enable_snd_device(struct audio_device *adev,
                                        new_snd_devices) != 0)) {
         ALOGV("%s: snd_device(%d: %s) is already active",
               __func__, snd_device, device_name);
+        /* in use again, even if the usecases already on it are warm */
+        if (platform_can_enable_spkr_prot_on_device(snd_device) &&
+            audio_extn_spkr_prot_is_enabled())
+            audio_extn_spkr_prot_set_idle(false);
         /* Set backend config for A2DP to ensure slimbus configuration
            is correct if A2DP is already active and backend is closed
            and re-opened */
@@ -1421,10 +1476,10 @@ int enable_snd_device(struct audio_device *adev,
             list_for_each(node, &adev->usecase_list) {
                 usecase = node_to_item(node, struct audio_usecase, list);
                 if (usecase->stream.in && (usecase->type == PCM_CAPTURE) &&
-                    is_sco_in_device_type(&usecase->stream.in->device_list)) {
+                    device_set_has(&usecase->stream.in->device_list, DEVICE_SET_SCO_IN)) {
                     ALOGD("a2dp resumed, switch bt sco mic to handset mic");
-                    reassign_device_list(&usecase->stream.in->device_list,
-                                         AUDIO_DEVICE_IN_BUILTIN_MIC, "");
+                    device_set_reassign(&usecase->stream.in->device_list,
+                                        AUDIO_DEVICE_IN_BUILTIN_MIC, "");
                     select_devices(adev, usecase->id);
                 }
             }
@@ -1480,9 +1535,10 @@ int enable_snd_device(struct audio_device *adev,
         }
         if (((snd_device == SND_DEVICE_IN_HANDSET_6MIC) ||
             (snd_device == SND_DEVICE_IN_HANDSET_QMIC)) &&
-            (audio_extn_ffv_get_stream() == adev_get_active_input(adev))) {
+            audio_extn_ffv_stream_active(adev_get_active_input(adev))) {
             ALOGD("%s: init ec ref loopback", __func__);
-            audio_extn_ffv_init_ec_ref_loopback(adev, snd_device);
+            audio_extn_ffv_init_ec_ref_loopback(adev, adev_get_active_input(adev),
+                                                snd_device);
         }
     }
     return 0;
@@ -1564,9 +1620,10 @@ int disable_snd_device(struct audio_device *adev,
             audio_route_apply_and_update_path(adev->audio_route, "hph-lowpower-mode");
         } else if (((snd_device == SND_DEVICE_IN_HANDSET_6MIC) ||
             (snd_device == SND_DEVICE_IN_HANDSET_QMIC)) &&
-            (audio_extn_ffv_get_stream() == adev_get_active_input(adev))) {
+            audio_extn_ffv_stream_active(adev_get_active_input(adev))) {
             ALOGD("%s: deinit ec ref loopback", __func__);
-            audio_extn_ffv_deinit_ec_ref_loopback(adev, snd_device);
+            audio_extn_ffv_deinit_ec_ref_loopback(adev, adev_get_active_input(adev),
+                                                  snd_device);
         }
 
         audio_extn_utils_release_snd_device(snd_device);
@@ -1663,67 +1720,71 @@ static snd_device_t derive_playback_snd_device(void * platform,
                                                struct audio_usecase *new_uc,
                                                snd_device_t new_snd_device)
 {
-    struct listnode a1, a2;
+    struct audio_device_set t1, t2;
+    struct audio_device_set *a1 = &t1, *a2 = &t2;
 
     snd_device_t d1 = uc->out_snd_device;
     snd_device_t d2 = new_snd_device;
+    snd_device_t derived = d2;
 
-    list_init(&a1);
-    list_init(&a2);
+    device_set_init(&t1);
+    device_set_init(&t2);
 
     switch (uc->type) {
         case TRANSCODE_LOOPBACK_RX :
-            assign_devices(&a1, &uc->stream.inout->out_config.device_list);
-            assign_devices(&a2, &new_uc->stream.inout->out_config.device_list);
+            device_set_assign(&t1, &uc->stream.inout->out_config.device_list);
+            device_set_assign(&t2, &new_uc->stream.inout->out_config.device_list);
             break;
         default :
-            assign_devices(&a1, &uc->stream.out->device_list);
-            assign_devices(&a2, &new_uc->stream.out->device_list);
+            a1 = &uc->stream.out->device_list;
+            a2 = &new_uc->stream.out->device_list;
             break;
     }
 
     // Treat as a special case when a1 and a2 are not disjoint
-    if (!compare_devices(&a1, &a2) &&
-         compare_devices_for_any_match(&a1 ,&a2)) {
+    if (!device_set_equal(a1, a2) &&
+         device_set_any_match(a1, a2)) {
         snd_device_t d3[2];
         int num_devices = 0;
         int ret = platform_split_snd_device(platform,
-                                            list_length(&a1) > 1 ? d1 : d2,
+                                            a1->count > 1 ? d1 : d2,
                                             &num_devices,
                                             d3);
         if (ret < 0) {
             if (ret != -ENOSYS) {
                 ALOGW("%s failed to split snd_device %d",
                       __func__,
-                      list_length(&a1) > 1 ? d1 : d2);
+                      a1->count > 1 ? d1 : d2);
             }
-            goto end;
+            goto end; // return whatever was calculated before.
         }
 
         if (platform_check_backends_match(d3[0], d3[1])) {
-            return d2; // case 5
+            derived = d2; // case 5
         } else {
-            if ((list_length(&a1) > 1) && (list_length(&a2) > 1) &&
+            if ((a1->count > 1) && (a2->count > 1) &&
                  platform_check_backends_match(d1, d2))
-                return d2; //case 9
-            if (list_length(&a1) > 1)
-                return d1; //case 7
+                derived = d2; //case 9
+            else if (a1->count > 1)
+                derived = d1; //case 7
             // check if d1 is related to any of d3's
-            if (d1 == d3[0] || d1 == d3[1])
-                return d1; // case 1
+            else if (d1 == d3[0] || d1 == d3[1])
+                derived = d1; // case 1
             else
-                return d3[1]; // case 8
+                derived = d3[1]; // case 8
         }
     } else {
         if (platform_check_backends_match(d1, d2)) {
-            return d2; // case 2, 4
+            derived = d2; // case 2, 4
         } else {
-            return d1; // case 6, 3
+            derived = d1; // case 6, 3
         }
     }
 
 end:
-    return d2; // return whatever was calculated before.
+    device_set_clear(&t1);
+    device_set_clear(&t2);
+    return derived;
 }
 
 static void check_usecases_codec_backend(struct audio_device *adev,
@@ -1790,6 +1851,7 @@ static void check_usecases_codec_backend(struct audio_device *adev,
     for (i = 0; i < AUDIO_USECASE_MAX; i++)
         switch_device[i] = false;
 
+    route_txn_begin(adev);
     list_for_each(node, &adev->usecase_list) {
         usecase = node_to_item(node, struct audio_usecase, list);
 
@@ -1803,12 +1865,12 @@ static void check_usecases_codec_backend(struct audio_device *adev,
             uc_derive_snd_device = derive_playback_snd_device(adev->platform,
                                                usecase, uc_info, snd_device);
             if (((uc_derive_snd_device != usecase->out_snd_device) || force_routing) &&
-                (is_codec_backend_out_device_type(&usecase->device_list) ||
-                compare_device_type(&usecase->device_list, AUDIO_DEVICE_OUT_AUX_DIGITAL) ||
-                compare_device_type(&usecase->device_list, AUDIO_DEVICE_OUT_USB_DEVICE) ||
-                compare_device_type(&usecase->device_list, AUDIO_DEVICE_OUT_USB_HEADSET) ||
-                is_a2dp_out_device_type(&usecase->device_list) ||
-                is_sco_out_device_type(&usecase->device_list)) &&
+                (device_set_has(&usecase->device_list, DEVICE_SET_CODEC_BACKEND_OUT) ||
+                device_set_has_type(&usecase->device_list, AUDIO_DEVICE_OUT_AUX_DIGITAL) ||
+                device_set_has_type(&usecase->device_list, AUDIO_DEVICE_OUT_USB_DEVICE) ||
+                device_set_has_type(&usecase->device_list, AUDIO_DEVICE_OUT_USB_HEADSET) ||
+                device_set_has(&usecase->device_list, DEVICE_SET_A2DP_OUT) ||
+                device_set_has(&usecase->device_list, DEVICE_SET_SCO_OUT)) &&
                 ((force_restart_session) ||
                 (platform_check_backends_match(snd_device, usecase->out_snd_device)))) {
                 ALOGD("%s:becf: check_usecases (%s) is active on (%s) - disabling ..",
@@ -1822,6 +1884,8 @@ static void check_usecases_codec_backend(struct audio_device *adev,
             }
         }
     }
+    /* the routes must be down before their devices and backend change */
+    route_txn_commit(adev);
 
     ALOGD("%s:becf: check_usecases num.of Usecases to switch %d", __func__,
         num_uc_to_switch);
@@ -1875,6 +1939,7 @@ static void check_usecases_codec_backend(struct audio_device *adev,
 
         /* Re-route all the usecases on the shared backend other than the
            specified usecase to new snd devices */
+        route_txn_begin(adev);
         list_for_each(node, &adev->usecase_list) {
             usecase = node_to_item(node, struct audio_usecase, list);
             /* Update the out_snd_device only before enabling the audio route */
@@ -1889,14 +1954,20 @@ static void check_usecases_codec_backend(struct audio_device *adev,
                                                        usecase->out_snd_device,
                                                        platform_get_input_snd_device(
                                                            adev->platform, NULL,
-                                                           &uc_info->device_list,
+                                                           &uc_info->device_list.list,
                                                            usecase->type));
                 enable_audio_route(adev, usecase);
-                if (usecase->stream.out && usecase->id == USECASE_AUDIO_PLAYBACK_VOIP) {
-                    out_set_voip_volume(&usecase->stream.out->stream,
-                                        usecase->stream.out->volume_l,
-                                        usecase->stream.out->volume_r);
-                }
+            }
+        }
+        route_txn_commit(adev);
+
+        list_for_each(node, &adev->usecase_list) {
+            usecase = node_to_item(node, struct audio_usecase, list);
+            if (switch_device[usecase->id] && usecase->stream.out &&
+                    usecase->id == USECASE_AUDIO_PLAYBACK_VOIP) {
+                out_set_voip_volume(&usecase->stream.out->stream,
+                                    usecase->stream.out->volume_l,
+                                    usecase->stream.out->volume_r);
             }
         }
     }
@@ -1910,7 +1981,7 @@ static void check_usecases_capture_codec_backend(struct audio_device *adev,
     struct audio_usecase *usecase;
     bool switch_device[AUDIO_USECASE_MAX];
     int i, num_uc_to_switch = 0;
-    int backend_check_cond = is_codec_backend_out_device_type(&uc_info->device_list);
+    int backend_check_cond = device_set_has(&uc_info->device_list, DEVICE_SET_CODEC_BACKEND_OUT);
     int status = 0;
 
     bool force_routing = platform_check_and_set_capture_codec_backend_cfg(adev, uc_info,
@@ -1923,7 +1994,7 @@ static void check_usecases_capture_codec_backend(struct audio_device *adev,
      * codec backend or vice versa causes issues.
      */
     if (uc_info->type == PCM_CAPTURE)
-        backend_check_cond = is_codec_backend_in_device_type(&uc_info->device_list);
+        backend_check_cond = device_set_has(&uc_info->device_list, DEVICE_SET_CODEC_BACKEND_IN);
 
     /*
      * Island cfg and power mode config needs to set before AFE port start.
@@ -1953,6 +2024,7 @@ static void check_usecases_capture_codec_backend(struct audio_device *adev,
     for (i = 0; i < AUDIO_USECASE_MAX; i++)
         switch_device[i] = false;
 
+    route_txn_begin(adev);
     list_for_each(node, &adev->usecase_list) {
         usecase = node_to_item(node, struct audio_usecase, list);
         /*
@@ -1965,10 +2037,10 @@ static void check_usecases_capture_codec_backend(struct audio_device *adev,
                                 platform_is_call_proxy_snd_device(usecase->in_snd_device);
         if (capture_uc_needs_routing && !call_proxy_snd_device &&
                 ((backend_check_cond &&
-                 (is_codec_backend_in_device_type(&usecase->device_list) ||
+                 (device_set_has(&usecase->device_list, DEVICE_SET_CODEC_BACKEND_IN) ||
                   (usecase->type == VOIP_CALL))) ||
                 ((uc_info->type == VOICE_CALL &&
-                 is_single_device_type_equal(&usecase->device_list,
+                 device_set_is_single_type(&usecase->device_list,
                                             AUDIO_DEVICE_IN_VOICE_CALL)) ||
                  platform_check_all_backends_match(snd_device,\
                                               usecase->in_snd_device))) &&
@@ -1981,6 +2053,7 @@ static void check_usecases_capture_codec_backend(struct audio_device *adev,
             num_uc_to_switch++;
         }
     }
+    route_txn_commit(adev);
 
     if (num_uc_to_switch) {
         /* All streams have been de-routed. Disable the device */
@@ -2003,6 +2076,7 @@ static void check_usecases_capture_codec_backend(struct audio_device *adev,
 
         /* Re-route all the usecases on the shared backend other than the
            specified usecase to new snd devices */
+        route_txn_begin(adev);
         list_for_each(node, &adev->usecase_list) {
             usecase = node_to_item(node, struct audio_usecase, list);
             /* Update the in_snd_device only before enabling the audio route */
@@ -2021,6 +2095,7 @@ static void check_usecases_capture_codec_backend(struct audio_device *adev,
                 enable_audio_route(adev, usecase);
             }
         }
+        route_txn_commit(adev);
     }
 }
 
@@ -2444,8 +2519,8 @@ static bool force_device_switch(struct audio_usecase *usecase)
 
     if (is_offload_usecase(usecase->id) &&
         (usecase->stream.out->sample_rate == OUTPUT_SAMPLING_RATE_44100) &&
-        (compare_device_type(&usecase->stream.out->device_list, AUDIO_DEVICE_OUT_WIRED_HEADSET) ||
-         compare_device_type(&usecase->stream.out->device_list, AUDIO_DEVICE_OUT_WIRED_HEADPHONE))) {
+        (device_set_has_type(&usecase->stream.out->device_list, AUDIO_DEVICE_OUT_WIRED_HEADSET) ||
+         device_set_has_type(&usecase->stream.out->device_list, AUDIO_DEVICE_OUT_WIRED_HEADPHONE))) {
         is_it_true_mode = (NATIVE_AUDIO_MODE_TRUE_44_1 == platform_get_native_support()? true : false);
          if ((is_it_true_mode && !adev->native_playback_enabled) ||
              (!is_it_true_mode && adev->native_playback_enabled)){
@@ -2457,7 +2532,7 @@ static bool force_device_switch(struct audio_usecase *usecase)
     // Force all a2dp output devices to reconfigure for proper AFE encode format
     //Also handle a case where in earlier a2dp start failed as A2DP stream was
     //in suspended state, hence try to trigger a retry when we again get a routing request.
-    if(is_a2dp_out_device_type(&usecase->stream.out->device_list) &&
+    if(device_set_has(&usecase->stream.out->device_list, DEVICE_SET_A2DP_OUT) &&
         audio_extn_a2dp_is_force_device_switch()) {
          ALOGD("Force a2dp device switch to update new encoder config");
          ret = true;
@@ -2563,8 +2638,13 @@ static int configure_btsco_sample_rate(snd_device_t snd_device)
 }
 
 int out_standby_l(struct audio_stream *stream);
+static void out_update_write_path(struct stream_out *out);
 
-struct stream_in *adev_get_active_input(const struct audio_device *adev)
+/*
+ * Recomputes the active input after a capture usecase was added to or removed
+ * from the usecase list. Must be called with adev->lock held.
+ */
+static void update_active_input(struct audio_device *adev)
 {
     struct listnode *node;
     struct stream_in *last_active_in = NULL;
@@ -2578,7 +2658,12 @@ struct stream_in *adev_get_active_input(const struct audio_device *adev)
             last_active_in =  usecase->stream.in;
     }
 
-    return last_active_in;
+    __atomic_store_n(&adev->active_input, last_active_in, __ATOMIC_RELEASE);
+}
+
+struct stream_in *adev_get_active_input(const struct audio_device *adev)
+{
+    return __atomic_load_n(&adev->active_input, __ATOMIC_ACQUIRE);
 }
 
 struct stream_in *get_voice_communication_input(const struct audio_device *adev)
@@ -2682,7 +2767,7 @@ int select_devices(struct audio_device *adev, audio_usecase_t uc_id)
             ALOGE("%s: stream.out is NULL", __func__);
             return -EINVAL;
         }
-        if (compare_device_type(&usecase->device_list, AUDIO_DEVICE_OUT_BUS)) {
+        if (device_set_has_type(&usecase->device_list, AUDIO_DEVICE_OUT_BUS)) {
             out_snd_device = audio_extn_auto_hal_get_output_snd_device(adev,
                                                                        uc_id);
             in_snd_device = audio_extn_auto_hal_get_input_snd_device(adev,
@@ -2692,22 +2777,24 @@ int select_devices(struct audio_device *adev, audio_usecase_t uc_id)
                                                             usecase->stream.out, usecase->type);
             in_snd_device = platform_get_input_snd_device(adev->platform,
                                                           NULL,
-                                                          &usecase->stream.out->device_list,
+                                                          &usecase->stream.out->device_list.list,
                                                           usecase->type);
         }
-        assign_devices(&usecase->device_list, &usecase->stream.out->device_list);
+        device_set_assign(&usecase->device_list, &usecase->stream.out->device_list.list);
     } else if (usecase->type == TRANSCODE_LOOPBACK_RX) {
         if (usecase->stream.inout == NULL) {
             ALOGE("%s: stream.inout is NULL", __func__);
             return -EINVAL;
         }
-        assign_devices(&stream_out.device_list, &usecase->stream.inout->out_config.device_list);
+        device_set_init(&stream_out.device_list);
+        device_set_assign(&stream_out.device_list, &usecase->stream.inout->out_config.device_list);
         stream_out.sample_rate = usecase->stream.inout->out_config.sample_rate;
         stream_out.format = usecase->stream.inout->out_config.format;
         stream_out.channel_mask = usecase->stream.inout->out_config.channel_mask;
         out_snd_device = platform_get_output_snd_device(adev->platform, &stream_out, usecase->type);
-        assign_devices(&usecase->device_list,
-                       &usecase->stream.inout->out_config.device_list);
+        device_set_clear(&stream_out.device_list);
+        device_set_assign(&usecase->device_list,
+                          &usecase->stream.inout->out_config.device_list);
     } else if (usecase->type == TRANSCODE_LOOPBACK_TX ) {
         if (usecase->stream.inout == NULL) {
             ALOGE("%s: stream.inout is NULL", __func__);
@@ -2717,8 +2804,8 @@ int select_devices(struct audio_device *adev, audio_usecase_t uc_id)
         list_init(&out_devices);
         in_snd_device = platform_get_input_snd_device(adev->platform, NULL,
                                                       &out_devices, usecase->type);
-        assign_devices(&usecase->device_list,
-                       &usecase->stream.inout->in_config.device_list);
+        device_set_assign(&usecase->device_list,
+                          &usecase->stream.inout->in_config.device_list);
     } else {
         /*
          * If the voice call is active, use the sound devices of voice call usecase
@@ -2732,21 +2819,21 @@ int select_devices(struct audio_device *adev, audio_usecase_t uc_id)
         if (voice_is_in_call(adev) && adev->mode != AUDIO_MODE_NORMAL) {
             vc_usecase = get_usecase_from_list(adev,
                                                get_usecase_id_from_usecase_type(adev, VOICE_CALL));
-            if ((vc_usecase) && ((is_codec_backend_out_device_type(&vc_usecase->device_list) &&
-                                 is_codec_backend_out_device_type(&usecase->device_list)) ||
-                                 (is_codec_backend_out_device_type(&vc_usecase->device_list) &&
-                                 is_codec_backend_in_device_type(&usecase->device_list)) ||
-                                 is_single_device_type_equal(&vc_usecase->device_list,
+            if ((vc_usecase) && ((device_set_has(&vc_usecase->device_list, DEVICE_SET_CODEC_BACKEND_OUT) &&
+                                 device_set_has(&usecase->device_list, DEVICE_SET_CODEC_BACKEND_OUT)) ||
+                                 (device_set_has(&vc_usecase->device_list, DEVICE_SET_CODEC_BACKEND_OUT) &&
+                                 device_set_has(&usecase->device_list, DEVICE_SET_CODEC_BACKEND_IN)) ||
+                                 device_set_is_single_type(&vc_usecase->device_list,
                                                         AUDIO_DEVICE_OUT_HEARING_AID) ||
-                                 is_single_device_type_equal(&usecase->device_list,
+                                 device_set_is_single_type(&usecase->device_list,
                                                      AUDIO_DEVICE_IN_VOICE_CALL) ||
-                                 (is_single_device_type_equal(&usecase->device_list,
+                                 (device_set_is_single_type(&usecase->device_list,
                                                      AUDIO_DEVICE_IN_USB_HEADSET) &&
-                                 is_single_device_type_equal(&vc_usecase->device_list,
+                                 device_set_is_single_type(&vc_usecase->device_list,
                                                         AUDIO_DEVICE_OUT_USB_HEADSET))||
-                                 (is_single_device_type_equal(&usecase->device_list,
+                                 (device_set_is_single_type(&usecase->device_list,
                                                      AUDIO_DEVICE_IN_BLUETOOTH_SCO_HEADSET) &&
-                                 is_codec_backend_out_device_type(&vc_usecase->device_list)))) {
+                                 device_set_has(&vc_usecase->device_list, DEVICE_SET_CODEC_BACKEND_OUT)))) {
                 in_snd_device = vc_usecase->in_snd_device;
                 out_snd_device = vc_usecase->out_snd_device;
             }
@@ -2762,9 +2849,9 @@ int select_devices(struct audio_device *adev, audio_usecase_t uc_id)
                                                        adev->platform,
                                                        usecase->stream.out, usecase->type));
             }
-            if ((voip_usecase) && (is_codec_backend_out_device_type(&voip_usecase->device_list) &&
-                (is_codec_backend_out_device_type(&usecase->device_list) ||
-                 is_codec_backend_in_device_type(&usecase->device_list)) &&
+            if ((voip_usecase) && (device_set_has(&voip_usecase->device_list, DEVICE_SET_CODEC_BACKEND_OUT) &&
+                (device_set_has(&usecase->device_list, DEVICE_SET_CODEC_BACKEND_OUT) ||
+                 device_set_has(&usecase->device_list, DEVICE_SET_CODEC_BACKEND_IN)) &&
                 out_snd_device_backend_match &&
                  (voip_usecase->stream.out != adev->primary_output))) {
                     in_snd_device = voip_usecase->in_snd_device;
@@ -2773,7 +2860,7 @@ int select_devices(struct audio_device *adev, audio_usecase_t uc_id)
         } else if (audio_extn_hfp_is_active(adev)) {
             hfp_ucid = audio_extn_hfp_get_usecase();
             hfp_usecase = get_usecase_from_list(adev, hfp_ucid);
-            if ((hfp_usecase) && is_codec_backend_out_device_type(&hfp_usecase->device_list)) {
+            if ((hfp_usecase) && device_set_has(&hfp_usecase->device_list, DEVICE_SET_CODEC_BACKEND_OUT)) {
                    in_snd_device = hfp_usecase->in_snd_device;
                    out_snd_device = hfp_usecase->out_snd_device;
             }
@@ -2783,12 +2870,12 @@ int select_devices(struct audio_device *adev, audio_usecase_t uc_id)
                 ALOGE("%s: stream.out is NULL", __func__);
                 return -EINVAL;
             }
-            assign_devices(&usecase->device_list, &usecase->stream.out->device_list);
+            device_set_assign(&usecase->device_list, &usecase->stream.out->device_list.list);
             in_snd_device = SND_DEVICE_NONE;
             if (out_snd_device == SND_DEVICE_NONE) {
                 struct stream_out *voip_out = adev->primary_output;
                 struct stream_in *voip_in = get_voice_communication_input(adev);
-                if (compare_device_type(&usecase->device_list, AUDIO_DEVICE_OUT_BUS))
+                if (device_set_has_type(&usecase->device_list, AUDIO_DEVICE_OUT_BUS))
                     out_snd_device = audio_extn_auto_hal_get_output_snd_device(adev, uc_id);
                 else
                     out_snd_device = platform_get_output_snd_device(adev->platform,
@@ -2807,7 +2894,7 @@ int select_devices(struct audio_device *adev, audio_usecase_t uc_id)
                 ALOGE("%s: stream.in is NULL", __func__);
                 return -EINVAL;
             }
-            assign_devices(&usecase->device_list, &usecase->stream.in->device_list);
+            device_set_assign(&usecase->device_list, &usecase->stream.in->device_list.list);
             out_snd_device = SND_DEVICE_NONE;
             if (in_snd_device == SND_DEVICE_NONE) {
                 struct listnode out_devices;
@@ -2827,10 +2914,11 @@ int select_devices(struct audio_device *adev, audio_usecase_t uc_id)
                     if (is_ha_usecase) {
                         reassign_device_list(&out_devices, AUDIO_DEVICE_OUT_TELEPHONY_TX, "");
                     } else if (voip_usecase) {
-                        assign_devices(&out_devices, &voip_usecase->stream.out->device_list);
+                        assign_devices(&out_devices, &voip_usecase->stream.out->device_list.list);
                     } else if (adev->primary_output &&
-                                  !adev->primary_output->standby) {
-                        assign_devices(&out_devices, &adev->primary_output->device_list);
+                                  !adev->primary_output->standby &&
+                                  !adev->primary_output->warm_standby) {
+                        assign_devices(&out_devices, &adev->primary_output->device_list.list);
                     } else {
                         /* forcing speaker o/p device to get matching i/p pair
                            in case o/p is not routed from same primary HAL */
@@ -2860,7 +2948,7 @@ int select_devices(struct audio_device *adev, audio_usecase_t uc_id)
             return 0;
     }
 
-    if (!compare_device_type(&usecase->device_list, AUDIO_DEVICE_OUT_BUS) &&
+    if (!device_set_has_type(&usecase->device_list, AUDIO_DEVICE_OUT_BUS) &&
         ((is_btsco_device(out_snd_device,in_snd_device) && !adev->bt_sco_on) ||
          (is_a2dp_device(out_snd_device) && !audio_extn_a2dp_source_is_ready()))) {
         ALOGD("SCO/A2DP is selected but they are not connected/ready hence dont route");
@@ -2985,7 +3073,7 @@ int select_devices(struct audio_device *adev, audio_usecase_t uc_id)
                                                             usecase);
     if (usecase->type == PCM_PLAYBACK) {
         if ((24 == usecase->stream.out->bit_width) &&
-                compare_device_type(&usecase->stream.out->device_list, AUDIO_DEVICE_OUT_SPEAKER)) {
+                device_set_has_type(&usecase->stream.out->device_list, AUDIO_DEVICE_OUT_SPEAKER)) {
             usecase->stream.out->app_type_cfg.sample_rate = DEFAULT_OUTPUT_SAMPLING_RATE;
         } else if ((out_snd_device == SND_DEVICE_OUT_HDMI ||
                     out_snd_device == SND_DEVICE_OUT_USB_HEADSET ||
@@ -3020,7 +3108,7 @@ int select_devices(struct audio_device *adev, audio_usecase_t uc_id)
               out_snd_device == AUDIO_DEVICE_OUT_SPEAKER_SAFE) &&
             (voip_in_usecase->in_snd_device ==
             platform_get_input_snd_device(adev->platform, voip_in,
-                    &usecase->stream.out->device_list,usecase->type))) {
+                    &usecase->stream.out->device_list.list,usecase->type))) {
             /*
              * if VOIP TX is enabled before VOIP RX, needs to re-route the TX path
              * for enabling echo-reference-voip with correct port
@@ -3139,11 +3227,12 @@ static int stop_input_stream(struct stream_in *in)
     /* 2. Disable the tx device */
     disable_snd_device(adev, uc_info->in_snd_device);
 
-    if (is_loopback_input_device(get_device_types(&in->device_list)))
+    if (is_loopback_input_device(device_set_types(&in->device_list)))
         audio_extn_keep_alive_stop(KEEP_ALIVE_OUT_PRIMARY);
 
     list_remove(&uc_info->list);
     free(uc_info);
+    update_active_input(adev);
 
     if (priority_in == in) {
         priority_in = get_priority_input(adev);
@@ -3183,7 +3272,7 @@ int start_input_stream(struct stream_in *in)
         goto error_config;
     }
 
-    if (is_sco_in_device_type(&in->device_list)) {
+    if (device_set_has(&in->device_list, DEVICE_SET_SCO_IN)) {
         if (!adev->bt_sco_on || audio_extn_a2dp_source_is_ready()) {
             ALOGE("%s: SCO profile is not ready, return error", __func__);
             ret = -EIO;
@@ -3226,12 +3315,13 @@ int start_input_stream(struct stream_in *in)
     uc_info->id = in->usecase;
     uc_info->type = PCM_CAPTURE;
     uc_info->stream.in = in;
-    list_init(&uc_info->device_list);
-    assign_devices(&uc_info->device_list, &in->device_list);
+    device_set_init(&uc_info->device_list);
+    device_set_assign(&uc_info->device_list, &in->device_list.list);
     uc_info->in_snd_device = SND_DEVICE_NONE;
     uc_info->out_snd_device = SND_DEVICE_NONE;
 
     list_add_tail(&adev->usecase_list, &uc_info->list);
+    update_active_input(adev);
     audio_streaming_hint_start();
     audio_extn_perf_lock_acquire(&adev->perf_lock_handle, 0,
                                  adev->perf_lock_opts,
@@ -3273,9 +3363,9 @@ int start_input_stream(struct stream_in *in)
             flags |= PCM_MMAP | PCM_NOIRQ;
         }
 
-        if (audio_extn_ffv_get_stream() == in) {
+        if (audio_extn_ffv_stream_active(in)) {
            ALOGD("%s: ffv stream, update pcm config", __func__);
-           audio_extn_ffv_update_pcm_config(&config);
+           audio_extn_ffv_update_pcm_config(in, &config);
         }
         ALOGV("%s: Opening PCM device card_id(%d) device_id(%d), channels %d",
               __func__, adev->snd_card, in->pcm_device_id, in->config.channels);
@@ -3338,7 +3428,7 @@ int start_input_stream(struct stream_in *in)
     audio_extn_audiozoom_set_microphone_direction(in, in->zoom);
     audio_extn_audiozoom_set_microphone_field_dimension(in, in->direction);
 
-    if (is_loopback_input_device(get_device_types(&in->device_list)))
+    if (is_loopback_input_device(device_set_types(&in->device_list)))
         audio_extn_keep_alive_start(KEEP_ALIVE_OUT_PRIMARY);
 
 done_open:
@@ -3479,10 +3569,10 @@ static audio_usecase_t get_offload_usecase(struct audio_device *adev, bool is_co
         else
             ret_uc = USECASE_AUDIO_PLAYBACK_OFFLOAD;
 
-        pthread_mutex_lock(&adev->lock);
+        ADEV_LOCK(adev);
         if (get_usecase_from_list(adev, ret_uc) != NULL)
            ret_uc = USECASE_INVALID;
-        pthread_mutex_unlock(&adev->lock);
+        ADEV_UNLOCK(adev);
 
         return ret_uc;
     }
@@ -3671,6 +3761,20 @@ static int destroy_offload_callback_thread(struct stream_out *out)
     return 0;
 }
 
+/* audio_perf profile held by a started output usecase, or -1 */
+static int get_output_perf_profile(struct stream_out *out)
+{
+    if (out->usecase == USECASE_AUDIO_PLAYBACK_ULL)
+        return AUDIO_PERF_PROFILE_ULL;
+    if (out->usecase == USECASE_AUDIO_PLAYBACK_MMAP)
+        return AUDIO_PERF_PROFILE_MMAP;
+    if (out->usecase == USECASE_AUDIO_PLAYBACK_VOIP)
+        return AUDIO_PERF_PROFILE_VOIP;
+    if (is_offload_usecase(out->usecase))
+        return AUDIO_PERF_PROFILE_OFFLOAD;
+    return -1;
+}
+
 static int stop_output_stream(struct stream_out *out)
 {
     int ret = 0;
@@ -3702,9 +3806,11 @@ static int stop_output_stream(struct stream_out *out)
 
         if (adev->offload_effects_stop_output != NULL)
             adev->offload_effects_stop_output(out->handle, out->pcm_device_id);
-    } else if (out->usecase == USECASE_AUDIO_PLAYBACK_ULL ||
-               out->usecase == USECASE_AUDIO_PLAYBACK_MMAP) {
-        audio_low_latency_hint_end();
+    }
+
+    if (out->perf_hint_held) {
+        audio_perf_hint_release(get_output_perf_profile(out));
+        out->perf_hint_held = false;
     }
 
     if (out->usecase == USECASE_INCALL_MUSIC_UPLINK ||
@@ -3725,7 +3831,7 @@ static int stop_output_stream(struct stream_out *out)
                                                 adev->dsp_bit_width_enforce_mode,
                                                 false);
     }
-    if (is_usb_out_device_type(&out->device_list)) {
+    if (device_set_has(&out->device_list, DEVICE_SET_USB_OUT)) {
         ret = audio_extn_usb_check_and_set_svc_int(uc_info,
                                                    false);
 
@@ -3753,7 +3859,7 @@ static int stop_output_stream(struct stream_out *out)
     }
 
     /* Must be called after removing the usecase from list */
-    if (compare_device_type(&out->device_list, AUDIO_DEVICE_OUT_AUX_DIGITAL))
+    if (device_set_has_type(&out->device_list, AUDIO_DEVICE_OUT_AUX_DIGITAL))
         audio_extn_keep_alive_start(KEEP_ALIVE_OUT_HDMI);
 
     if (out->ip_hdlr_handle) {
@@ -3767,7 +3873,7 @@ static int stop_output_stream(struct stream_out *out)
        2) trigger voip input to reroute when voip output changes to
           hearing aid. */
     if (has_voip_usecase ||
-            compare_device_type(&out->device_list, AUDIO_DEVICE_OUT_SPEAKER_SAFE)) {
+            device_set_has_type(&out->device_list, AUDIO_DEVICE_OUT_SPEAKER_SAFE)) {
         struct listnode *node;
         struct audio_usecase *usecase;
         list_for_each(node, &adev->usecase_list) {
@@ -3825,14 +3931,114 @@ struct pcm* pcm_open_prepare_helper(unsigned int snd_card, unsigned int pcm_devi
     return pcm;
 }
 
-int start_output_stream(struct stream_out *out)
+/*
+ * Opens and prepares the PCM of a routed PCM playback usecase, then applies
+ * the stream channel map and volume. Caller holds out->lock; adev->lock is
+ * only needed for the haptics PCM, see out_can_defer_pcm_open().
+ */
+static int out_open_pcm_l(struct stream_out *out)
 {
-    int ret = 0;
-    struct audio_usecase *uc_info;
     struct audio_device *adev = out->dev;
+    bool is_haptic_usecase = out->usecase == USECASE_AUDIO_PLAYBACK_WITH_HAPTICS;
     char mixer_ctl_name[128];
     struct mixer_ctl *ctl = NULL;
     char* perf_mode[] = {"ULL", "ULL_PP", "LL"};
+    unsigned int flags = PCM_OUT;
+    unsigned int pcm_open_retry_count = 0;
+
+    if (out->usecase == USECASE_AUDIO_PLAYBACK_AFE_PROXY) {
+        flags |= PCM_MMAP | PCM_NOIRQ;
+        pcm_open_retry_count = PROXY_OPEN_RETRY_COUNT;
+    } else if (out->realtime) {
+        flags |= PCM_MMAP | PCM_NOIRQ | PCM_MONOTONIC;
+    } else
+        flags |= PCM_MONOTONIC;
+
+    if ((adev->vr_audio_mode_enabled) &&
+        (out->flags & AUDIO_OUTPUT_FLAG_RAW)) {
+        snprintf(mixer_ctl_name, sizeof(mixer_ctl_name),
+                "PCM_Dev %d Topology", out->pcm_device_id);
+        ctl = mixer_get_ctl_by_name(adev->mixer, mixer_ctl_name);
+        if (!ctl) {
+            ALOGI("%s: Could not get ctl for mixer cmd might be ULL - %s",
+                  __func__, mixer_ctl_name);
+        } else {
+            //if success use ULLPP
+            ALOGI("%s: mixer ctrl %s succeeded setting up ULL for %d",
+                __func__, mixer_ctl_name, out->pcm_device_id);
+            //There is a still a possibility that some sessions
+            // that request for FAST|RAW when 3D audio is active
+            //can go through ULLPP. Ideally we expects apps to
+            //listen to audio focus and stop concurrent playback
+            //Also, we will look for mode flag (voice_in_communication)
+            //before enabling the realtime flag.
+            mixer_ctl_set_enum_by_string(ctl, perf_mode[1]);
+        }
+    }
+
+    if (out->realtime)
+        platform_set_stream_channel_map(adev->platform, out->channel_mask,
+               out->pcm_device_id, &out->channel_map_param.channel_map[0]);
+
+    out->pcm = pcm_open_prepare_helper(adev->snd_card, out->pcm_device_id,
+                                       flags, pcm_open_retry_count,
+                                       &(out->config));
+    if (out->pcm == NULL)
+        return -EIO;
+
+    if (is_haptic_usecase) {
+        adev->haptic_pcm = pcm_open_prepare_helper(adev->snd_card,
+                               adev->haptic_pcm_device_id,
+                               flags, pcm_open_retry_count,
+                               &(adev->haptics_config));
+        // failure to open haptics pcm shouldnt stop audio,
+        // so do not close audio pcm in case of error
+
+        if (property_get_bool("vendor.audio.enable_haptic_audio_sync", false)) {
+            ALOGD("%s: enable haptic audio synchronization", __func__);
+            platform_set_qtime(adev->platform, out->pcm_device_id, adev->haptic_pcm_device_id);
+        }
+    }
+
+    if (!out->realtime)
+        platform_set_stream_channel_map(adev->platform, out->channel_mask,
+               out->pcm_device_id, &out->channel_map_param.channel_map[0]);
+
+    // apply volume for voip playback after path is set up
+    if (out->usecase == USECASE_AUDIO_PLAYBACK_VOIP)
+        out_set_voip_volume(&out->stream, out->volume_l, out->volume_r);
+    else if ((out->usecase == USECASE_AUDIO_PLAYBACK_LOW_LATENCY || out->usecase == USECASE_AUDIO_PLAYBACK_DEEP_BUFFER ||
+              out->usecase == USECASE_AUDIO_PLAYBACK_ULL) && (out->apply_volume)) {
+             out_set_pcm_volume(&out->stream, out->volume_l, out->volume_r);
+             out->apply_volume = false;
+    } else if (audio_extn_auto_hal_is_bus_device_usecase(out->usecase)) {
+        out_set_pcm_volume(&out->stream, out->volume_l, out->volume_r);
+    }
+
+    return 0;
+}
+
+/*
+ * Whether out_write() may open the PCM after start_output_stream() has routed
+ * the usecase and adev->lock is dropped. pcm_open() and pcm_prepare() set up
+ * the DSP session and are the slowest part of leaving standby, but only touch
+ * the stream. Streams whose start also programs shared state after the open
+ * (haptics PCM, ADM config of realtime streams, MMAP, compress and VOIP
+ * sessions) keep the open under the lock.
+ */
+static bool out_can_defer_pcm_open(struct stream_out *out)
+{
+    return !is_offload_usecase(out->usecase) && !is_mmap_usecase(out->usecase) &&
+           !out->realtime &&
+           out->usecase != USECASE_COMPRESS_VOIP_CALL &&
+           out->usecase != USECASE_AUDIO_PLAYBACK_WITH_HAPTICS;
+}
+
+int start_output_stream(struct stream_out *out)
+{
+    int ret = 0;
+    struct audio_usecase *uc_info;
+    struct audio_device *adev = out->dev;
     bool a2dp_combo = false;
     bool is_haptic_usecase = (out->usecase == USECASE_AUDIO_PLAYBACK_WITH_HAPTICS) ? true: false;
 
@@ -3844,11 +4050,11 @@ int start_output_stream(struct stream_out *out)
 
     ALOGD("%s: enter: stream(%p)usecase(%d: %s) devices(%#x) is_haptic_usecase(%d)",
           __func__, &out->stream, out->usecase, use_case_table[out->usecase],
-          get_device_types(&out->device_list), is_haptic_usecase);
+          device_set_types(&out->device_list), is_haptic_usecase);
 
-    bool is_speaker_active = compare_device_type(&out->device_list,
+    bool is_speaker_active = device_set_has_type(&out->device_list,
                                                  AUDIO_DEVICE_OUT_SPEAKER);
-    bool is_speaker_safe_active = compare_device_type(&out->device_list,
+    bool is_speaker_safe_active = device_set_has_type(&out->device_list,
                                                       AUDIO_DEVICE_OUT_SPEAKER_SAFE);
 
     if (CARD_STATUS_OFFLINE == out->card_status ||
@@ -3868,7 +4074,7 @@ int start_output_stream(struct stream_out *out)
         }
     }
 
-    if (is_a2dp_out_device_type(&out->device_list)) {
+    if (device_set_has(&out->device_list, DEVICE_SET_A2DP_OUT)) {
         if (!audio_extn_a2dp_source_is_ready()) {
             if (is_speaker_active || is_speaker_safe_active) {
                 a2dp_combo = true;
@@ -3881,12 +4087,12 @@ int start_output_stream(struct stream_out *out)
             }
         }
     }
-    if (is_sco_out_device_type(&out->device_list)) {
+    if (device_set_has(&out->device_list, DEVICE_SET_SCO_OUT)) {
         if (!adev->bt_sco_on) {
             if (is_speaker_active) {
                 //combo usecase just by pass a2dp
                 ALOGW("%s: SCO is not connected, route it to speaker", __func__);
-                reassign_device_list(&out->device_list, AUDIO_DEVICE_OUT_SPEAKER, "");
+                device_set_reassign(&out->device_list, AUDIO_DEVICE_OUT_SPEAKER, "");
             } else {
                 ALOGE("%s: SCO profile is not ready, return error", __func__);
                 ret = -EAGAIN;
@@ -3924,13 +4130,13 @@ int start_output_stream(struct stream_out *out)
     uc_info->id = out->usecase;
     uc_info->type = PCM_PLAYBACK;
     uc_info->stream.out = out;
-    list_init(&uc_info->device_list);
-    assign_devices(&uc_info->device_list, &out->device_list);
+    device_set_init(&uc_info->device_list);
+    device_set_assign(&uc_info->device_list, &out->device_list.list);
     uc_info->in_snd_device = SND_DEVICE_NONE;
     uc_info->out_snd_device = SND_DEVICE_NONE;
 
     /* This must be called before adding this usecase to the list */
-    if (is_usb_out_device_type(&out->device_list)) {
+    if (device_set_has(&out->device_list, DEVICE_SET_USB_OUT)) {
        audio_extn_usb_check_and_set_svc_int(uc_info, true);
        /* USB backend is not reopened immediately.
        This is eventually done as part of select_devices */
@@ -3943,7 +4149,7 @@ int start_output_stream(struct stream_out *out)
                                  adev->perf_lock_opts,
                                  adev->perf_lock_opts_size);
 
-    if (compare_device_type(&out->device_list, AUDIO_DEVICE_OUT_AUX_DIGITAL)) {
+    if (device_set_has_type(&out->device_list, AUDIO_DEVICE_OUT_AUX_DIGITAL)) {
         audio_extn_keep_alive_stop(KEEP_ALIVE_OUT_HDMI);
         if (audio_extn_passthru_is_enabled() &&
             audio_extn_passthru_is_passthrough_stream(out)) {
@@ -3951,39 +4157,39 @@ int start_output_stream(struct stream_out *out)
         }
     }
 
-    if (is_a2dp_out_device_type(&out->device_list) &&
+    if (device_set_has(&out->device_list, DEVICE_SET_A2DP_OUT) &&
         (!audio_extn_a2dp_source_is_ready())) {
         if (!a2dp_combo) {
             check_a2dp_restore_l(adev, out, false);
         } else {
             struct listnode dev;
             list_init(&dev);
-            assign_devices(&dev, &out->device_list);
+            assign_devices(&dev, &out->device_list.list);
             if (compare_device_type(&dev, AUDIO_DEVICE_OUT_SPEAKER_SAFE))
-                reassign_device_list(&out->device_list,
+                device_set_reassign(&out->device_list,
                                 AUDIO_DEVICE_OUT_SPEAKER_SAFE, "");
             else
-                reassign_device_list(&out->device_list,
+                device_set_reassign(&out->device_list,
                                 AUDIO_DEVICE_OUT_SPEAKER, "");
             select_devices(adev, out->usecase);
-            assign_devices(&out->device_list, &dev);
+            device_set_assign(&out->device_list, &dev);
         }
     } else {
         select_devices(adev, out->usecase);
-        if (is_a2dp_out_device_type(&out->device_list) &&
+        if (device_set_has(&out->device_list, DEVICE_SET_A2DP_OUT) &&
              !adev->a2dp_started) {
             if (is_speaker_active || is_speaker_safe_active) {
                 struct listnode dev;
                 list_init(&dev);
-                assign_devices(&dev, &out->device_list);
+                assign_devices(&dev, &out->device_list.list);
                 if (compare_device_type(&dev, AUDIO_DEVICE_OUT_SPEAKER_SAFE))
-                    reassign_device_list(&out->device_list,
+                    device_set_reassign(&out->device_list,
                                     AUDIO_DEVICE_OUT_SPEAKER_SAFE, "");
                 else
-                    reassign_device_list(&out->device_list,
+                    device_set_reassign(&out->device_list,
                                     AUDIO_DEVICE_OUT_SPEAKER, "");
                 select_devices(adev, out->usecase);
-                assign_devices(&out->device_list, &dev);
+                device_set_assign(&out->device_list, &dev);
             } else {
                 ret = -EINVAL;
                 goto error_open;
@@ -4015,77 +4221,10 @@ int start_output_stream(struct stream_out *out)
         }
         out_set_mmap_volume(&out->stream, out->volume_l, out->volume_r);
     } else if (!is_offload_usecase(out->usecase)) {
-        unsigned int flags = PCM_OUT;
-        unsigned int pcm_open_retry_count = 0;
-        if (out->usecase == USECASE_AUDIO_PLAYBACK_AFE_PROXY) {
-            flags |= PCM_MMAP | PCM_NOIRQ;
-            pcm_open_retry_count = PROXY_OPEN_RETRY_COUNT;
-        } else if (out->realtime) {
-            flags |= PCM_MMAP | PCM_NOIRQ | PCM_MONOTONIC;
-        } else
-            flags |= PCM_MONOTONIC;
-
-        if ((adev->vr_audio_mode_enabled) &&
-            (out->flags & AUDIO_OUTPUT_FLAG_RAW)) {
-            snprintf(mixer_ctl_name, sizeof(mixer_ctl_name),
-                    "PCM_Dev %d Topology", out->pcm_device_id);
-            ctl = mixer_get_ctl_by_name(adev->mixer, mixer_ctl_name);
-            if (!ctl) {
-                ALOGI("%s: Could not get ctl for mixer cmd might be ULL - %s",
-                      __func__, mixer_ctl_name);
-            } else {
-                //if success use ULLPP
-                ALOGI("%s: mixer ctrl %s succeeded setting up ULL for %d",
-                    __func__, mixer_ctl_name, out->pcm_device_id);
-                //There is a still a possibility that some sessions
-                // that request for FAST|RAW when 3D audio is active
-                //can go through ULLPP. Ideally we expects apps to
-                //listen to audio focus and stop concurrent playback
-                //Also, we will look for mode flag (voice_in_communication)
-                //before enabling the realtime flag.
-                mixer_ctl_set_enum_by_string(ctl, perf_mode[1]);
-            }
-        }
-
-        if (out->realtime)
-            platform_set_stream_channel_map(adev->platform, out->channel_mask,
-                   out->pcm_device_id, &out->channel_map_param.channel_map[0]);
-
-        out->pcm = pcm_open_prepare_helper(adev->snd_card, out->pcm_device_id,
-                                       flags, pcm_open_retry_count,
-                                       &(out->config));
-        if (out->pcm == NULL) {
-           ret = -EIO;
-           goto error_open;
-        }
-
-        if (is_haptic_usecase) {
-            adev->haptic_pcm = pcm_open_prepare_helper(adev->snd_card,
-                                   adev->haptic_pcm_device_id,
-                                   flags, pcm_open_retry_count,
-                                   &(adev->haptics_config));
-            // failure to open haptics pcm shouldnt stop audio,
-            // so do not close audio pcm in case of error
-
-            if (property_get_bool("vendor.audio.enable_haptic_audio_sync", false)) {
-                ALOGD("%s: enable haptic audio synchronization", __func__);
-                platform_set_qtime(adev->platform, out->pcm_device_id, adev->haptic_pcm_device_id);
-            }
-        }
-
-        if (!out->realtime)
-            platform_set_stream_channel_map(adev->platform, out->channel_mask,
-                   out->pcm_device_id, &out->channel_map_param.channel_map[0]);
-
-        // apply volume for voip playback after path is set up
-        if (out->usecase == USECASE_AUDIO_PLAYBACK_VOIP)
-            out_set_voip_volume(&out->stream, out->volume_l, out->volume_r);
-        else if ((out->usecase == USECASE_AUDIO_PLAYBACK_LOW_LATENCY || out->usecase == USECASE_AUDIO_PLAYBACK_DEEP_BUFFER ||
-                  out->usecase == USECASE_AUDIO_PLAYBACK_ULL) && (out->apply_volume)) {
-                 out_set_pcm_volume(&out->stream, out->volume_l, out->volume_r);
-                 out->apply_volume = false;
-        } else if (audio_extn_auto_hal_is_bus_device_usecase(out->usecase)) {
-            out_set_pcm_volume(&out->stream, out->volume_l, out->volume_r);
+        if (!out->pcm_open_deferred) {
+            ret = out_open_pcm_l(out);
+            if (ret != 0)
+                goto error_open;
         }
     } else {
         /*
@@ -4156,7 +4295,7 @@ int start_output_stream(struct stream_out *out)
             audio_extn_check_and_set_dts_hpx_state(adev);
         }
 
-        if (compare_device_type(&out->device_list, AUDIO_DEVICE_OUT_BUS)) {
+        if (device_set_has_type(&out->device_list, AUDIO_DEVICE_OUT_BUS)) {
             /* Update cached volume from media to offload/direct stream */
             struct listnode *node = NULL;
             list_for_each(node, &adev->active_outputs_list) {
@@ -4191,9 +4330,9 @@ int start_output_stream(struct stream_out *out)
     audio_extn_perf_lock_release(&adev->perf_lock_handle);
     ALOGD("%s: exit", __func__);
 
-    if (out->usecase == USECASE_AUDIO_PLAYBACK_ULL ||
-        out->usecase == USECASE_AUDIO_PLAYBACK_MMAP) {
-        audio_low_latency_hint_start();
+    if (get_output_perf_profile(out) >= 0) {
+        audio_perf_hint_acquire(get_output_perf_profile(out));
+        out->perf_hint_held = true;
     }
 
     if (out->ip_hdlr_handle) {
@@ -4543,16 +4682,145 @@ static int out_set_format(struct audio_stream *stream __unused,
     return -ENOSYS;
 }
 
-static int out_standby(struct audio_stream *stream)
+static bool is_spkr_prot_snd_device(struct audio_device *adev,
+                                    snd_device_t snd_device)
+{
+    snd_device_t new_snd_devices[SND_DEVICE_OUT_END];
+    int i, num_devices = 0;
+
+    if (platform_can_enable_spkr_prot_on_device(snd_device))
+        return true;
+    if (platform_split_snd_device(adev->platform, snd_device,
+                                  &num_devices, new_snd_devices) == 0) {
+        for (i = 0; i < num_devices; i++)
+            if (platform_can_enable_spkr_prot_on_device(new_snd_devices[i]))
+                return true;
+    }
+    return false;
+}
+
+/*
+ * A stream in warm standby keeps the speaker enabled without playing, so
+ * speaker protection is told the speaker is idle while every usecase on it
+ * is warm, and in use again once one is not. Caller holds adev->lock.
+ */
+static void update_spkr_prot_idle_l(struct audio_device *adev)
+{
+    struct listnode *node;
+    struct audio_usecase *usecase;
+    bool warm = false, in_use = false;
+
+    list_for_each(node, &adev->usecase_list) {
+        usecase = node_to_item(node, struct audio_usecase, list);
+        if (!is_spkr_prot_snd_device(adev, usecase->out_snd_device))
+            continue;
+        if (usecase->type == PCM_PLAYBACK && usecase->stream.out != NULL &&
+            usecase->stream.out->warm_standby)
+            warm = true;
+        else
+            in_use = true;
+    }
+    if (warm || in_use)
+        audio_extn_spkr_prot_set_idle(!in_use);
+}
+
+/*
+ * Whether out_standby() may leave the stream in warm standby instead of
+ * stopping it. Only plain PCM playback on codec backends qualifies; paths
+ * to external sinks and error recovery always stop fully.
+ */
+static bool out_can_warm_standby(struct stream_out *out)
+{
+    if (out->standby || out->pcm == NULL || out->standby_delay_ms == 0)
+        return false;
+
+    if (out->card_status == CARD_STATUS_OFFLINE)
+        return false;
+
+    if (is_offload_usecase(out->usecase) || is_mmap_usecase(out->usecase) ||
+        out->realtime ||
+        out->usecase == USECASE_AUDIO_PLAYBACK_VOIP ||
+        out->usecase == USECASE_COMPRESS_VOIP_CALL ||
+        out->usecase == USECASE_AUDIO_PLAYBACK_WITH_HAPTICS)
+        return false;
+
+    return device_set_has(&out->device_list, DEVICE_SET_CODEC_BACKEND_OUT) &&
+           !device_set_has(&out->device_list, DEVICE_SET_A2DP_OUT |
+                                              DEVICE_SET_USB_OUT |
+                                              DEVICE_SET_SCO_OUT);
+}
+
+/* caller holds out->lock */
+static void out_enter_warm_standby_l(struct stream_out *out)
 {
-    struct stream_out *out = (struct stream_out *)stream;
     struct audio_device *adev = out->dev;
-    bool do_stop = true;
 
-    ALOGD("%s: enter: stream (%p) usecase(%d: %s)", __func__,
-          stream, out->usecase, use_case_table[out->usecase]);
+    /* drop queued frames as pcm_close() would, the next write prepares */
+    pcm_stop(out->pcm);
+    out->warm_standby = true;
+    out->last_fifo_valid = false;
+
+    /* nothing plays: no perf hint, and the speaker may count as idle */
+    if (out->perf_hint_held) {
+        audio_perf_hint_release(get_output_perf_profile(out));
+        out->perf_hint_held = false;
+    }
+    if (audio_extn_spkr_prot_is_enabled()) {
+        ADEV_LOCK(adev);
+        update_spkr_prot_idle_l(adev);
+        ADEV_UNLOCK(adev);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &out->warm_standby_deadline);
+    out->warm_standby_deadline.tv_sec += out->standby_delay_ms / 1000;
+    out->warm_standby_deadline.tv_nsec += (out->standby_delay_ms % 1000) * 1000000;
+    if (out->warm_standby_deadline.tv_nsec >= 1000000000) {
+        out->warm_standby_deadline.tv_sec++;
+        out->warm_standby_deadline.tv_nsec -= 1000000000;
+    }
+    pthread_cond_signal(&out->standby_cond);
+    ALOGD("%s: usecase(%s) warm for %u ms", __func__,
+          use_case_table[out->usecase], out->standby_delay_ms);
+}
+
+/* caller holds out->lock */
+static int out_resume_warm_standby_l(struct stream_out *out)
+{
+    const int64_t startNs = systemTime(SYSTEM_TIME_MONOTONIC);
+    struct audio_device *adev = out->dev;
+    int ret;
+
+    out->warm_standby = false;
+    ret = pcm_prepare(out->pcm);
+    if (ret < 0) {
+        ALOGE("%s: pcm_prepare failed %d, restarting stream", __func__, ret);
+        return ret;
+    }
+    if (audio_extn_spkr_prot_is_enabled()) {
+        ADEV_LOCK(adev);
+        update_spkr_prot_idle_l(adev);
+        ADEV_UNLOCK(adev);
+    }
+    if (get_output_perf_profile(out) >= 0) {
+        audio_perf_hint_acquire(get_output_perf_profile(out));
+        out->perf_hint_held = true;
+    }
+    out->last_fifo_valid = false;
+    simple_stats_log(&out->warm_start_latency_ms,
+                     (systemTime(SYSTEM_TIME_MONOTONIC) - startNs) * 1e-6);
+    return 0;
+}
+
+/*
+ * Full standby: closes the PCM or compress session and stops the usecase.
+ * Caller holds out->lock.
+ */
+static void out_do_standby(struct stream_out *out)
+{
+    struct audio_stream *stream = &out->stream.common;
+    struct audio_device *adev = out->dev;
+    bool do_stop = true;
 
-    lock_output_stream(out);
     if (!out->standby) {
         if (adev->adm_deregister_stream)
             adev->adm_deregister_stream(adev->adm_data, out->handle);
@@ -4561,18 +4829,18 @@ static int out_standby(struct audio_stream *stream)
             stop_compressed_output_l(out);
         }
 
-        pthread_mutex_lock(&adev->lock);
+        ADEV_LOCK(adev);
 
         amplifier_output_stream_standby((struct audio_stream_out *) stream);
 
         out->standby = true;
+        out->warm_standby = false;
         if (out->usecase == USECASE_COMPRESS_VOIP_CALL) {
             voice_extn_compress_voip_close_output_stream(stream);
             out->started = 0;
-            pthread_mutex_unlock(&adev->lock);
-            pthread_mutex_unlock(&out->lock);
+            ADEV_UNLOCK(adev);
             ALOGD("VOIP output entered standby");
-            return 0;
+            return;
         } else if (!is_offload_usecase(out->usecase)) {
             if (out->pcm) {
                 pcm_close(out->pcm);
@@ -4618,18 +4886,88 @@ static int out_standby(struct audio_stream *stream)
             stop_output_stream(out);
         }
         // if fm is active route on selected device in UI
-        audio_extn_fm_route_on_selected_device(adev, &out->device_list);
-        pthread_mutex_unlock(&adev->lock);
+        audio_extn_fm_route_on_selected_device(adev, &out->device_list.list);
+        ADEV_UNLOCK(adev);
+    }
+}
+
+static int out_standby(struct audio_stream *stream)
+{
+    struct stream_out *out = (struct stream_out *)stream;
+
+    ALOGD("%s: enter: stream (%p) usecase(%d: %s)", __func__,
+          stream, out->usecase, use_case_table[out->usecase]);
+
+    lock_output_stream(out);
+    if (out_can_warm_standby(out)) {
+        if (!out->warm_standby)
+            out_enter_warm_standby_l(out);
+    } else {
+        out_do_standby(out);
     }
     pthread_mutex_unlock(&out->lock);
     ALOGD("%s: exit", __func__);
     return 0;
 }
 
+static void *out_standby_thread_loop(void *context)
+{
+    struct stream_out *out = (struct stream_out *) context;
+    struct timespec now;
+
+    prctl(PR_SET_NAME, (unsigned long)"Standby Timer", 0, 0, 0);
+
+    lock_output_stream(out);
+    while (!out->standby_thread_exit) {
+        if (!out->warm_standby) {
+            pthread_cond_wait(&out->standby_cond, &out->lock);
+            continue;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (audio_utils_ns_from_timespec(&now) <
+                audio_utils_ns_from_timespec(&out->warm_standby_deadline)) {
+            pthread_cond_timedwait(&out->standby_cond, &out->lock,
+                                   &out->warm_standby_deadline);
+            continue;
+        }
+        ALOGD("%s: usecase(%s) idle for %u ms, entering standby", __func__,
+              use_case_table[out->usecase], out->standby_delay_ms);
+        out_do_standby(out);
+    }
+    pthread_mutex_unlock(&out->lock);
+
+    return NULL;
+}
+
+static int create_standby_thread(struct stream_out *out)
+{
+    pthread_condattr_t attr;
+
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&out->standby_cond, &attr);
+    pthread_condattr_destroy(&attr);
+    out->standby_thread_exit = false;
+    return -pthread_create(&out->standby_thread, (const pthread_attr_t *) NULL,
+                           out_standby_thread_loop, out);
+}
+
+static void destroy_standby_thread(struct stream_out *out)
+{
+    lock_output_stream(out);
+    /* no more warm standby, the next out_standby() stops the stream */
+    out->standby_delay_ms = 0;
+    out->standby_thread_exit = true;
+    pthread_cond_signal(&out->standby_cond);
+    pthread_mutex_unlock(&out->lock);
+
+    pthread_join(out->standby_thread, (void **) NULL);
+    pthread_cond_destroy(&out->standby_cond);
+}
+
 static int out_on_error(struct audio_stream *stream)
 {
     struct stream_out *out = (struct stream_out *)stream;
-    int status = 0;
 
     lock_output_stream(out);
     // always send CMD_ERROR for offload streams, this
@@ -4638,10 +4976,10 @@ static int out_on_error(struct audio_stream *stream)
     if (out->flags & AUDIO_OUTPUT_FLAG_COMPRESS_OFFLOAD) {
         stop_compressed_output_l(out);
     }
+    /* no warm standby after an error, the stream is restarted from scratch */
+    out_do_standby(out);
     pthread_mutex_unlock(&out->lock);
 
-    status = out_standby(&out->stream.common);
-
     lock_output_stream(out);
     if (out->flags & AUDIO_OUTPUT_FLAG_COMPRESS_OFFLOAD) {
         send_offload_cmd_l(out, OFFLOAD_CMD_ERROR);
@@ -4654,7 +4992,7 @@ static int out_on_error(struct audio_stream *stream)
 
     pthread_mutex_unlock(&out->lock);
 
-    return status;
+    return 0;
 }
 
 /*
@@ -4671,6 +5009,7 @@ int out_standby_l(struct audio_stream *stream)
 
     if (!out->standby) {
         ATRACE_BEGIN("out_standby_l");
+        out->warm_standby = false;
         if (adev->adm_deregister_stream)
             adev->adm_deregister_stream(adev->adm_data, out->handle);
 
@@ -4743,6 +5082,13 @@ static int out_dump(const struct audio_stream *stream, int fd)
         dprintf(fd, "      Start latency ms: %s\n", buffer);
     }
 
+    if (out->standby_delay_ms > 0) {
+        dprintf(fd, "      Warm standby: %s (%u ms)\n",
+                out->warm_standby ? "yes" : "no", out->standby_delay_ms);
+        simple_stats_to_string(&out->warm_start_latency_ms, buffer, sizeof(buffer));
+        dprintf(fd, "      Warm start latency ms: %s\n", buffer);
+    }
+
     if (locked) {
         pthread_mutex_unlock(&out->lock);
     }
@@ -4801,9 +5147,9 @@ static void out_snd_mon_cb(void * stream, struct str_parms * parms)
     if (parse_snd_card_status(parms, &card, &status) < 0)
         return;
 
-    pthread_mutex_lock(&adev->lock);
+    ADEV_LOCK(adev);
     bool valid_cb = (card == adev->snd_card);
-    pthread_mutex_unlock(&adev->lock);
+    ADEV_UNLOCK(adev);
 
     if (!valid_cb)
         return;
@@ -4822,10 +5168,10 @@ static void out_snd_mon_cb(void * stream, struct str_parms * parms)
         if (voice_is_call_state_active(adev) &&
             out == adev->primary_output) {
             ALOGD("%s: SSR/PDR occurred, end all calls\n", __func__);
-            pthread_mutex_lock(&adev->lock);
+            ADEV_LOCK(adev);
             voice_stop_call(adev);
-            adev->mode = AUDIO_MODE_NORMAL;
-            pthread_mutex_unlock(&adev->lock);
+            __atomic_store_n(&adev->mode, AUDIO_MODE_NORMAL, __ATOMIC_RELEASE);
+            ADEV_UNLOCK(adev);
         }
     }
     return;
@@ -4857,7 +5203,22 @@ int route_output_stream(struct stream_out *out,
     assign_devices(&new_devices, devices);
 
     lock_output_stream(out);
-    pthread_mutex_lock(&adev->lock);
+
+    /*
+     * A stream in warm standby keeps its PCM open on the old backend.
+     * External sinks don't take warm streams, so stop it fully and let
+     * the next write open it on the new device.
+     */
+    if (out->warm_standby &&
+            (is_a2dp_out_device_type(&new_devices) ||
+             is_usb_out_device_type(&new_devices) ||
+             is_sco_out_device_type(&new_devices))) {
+        ALOGD("%s: usecase(%s) rerouted to an external sink, leaving warm standby",
+              __func__, use_case_table[out->usecase]);
+        out_do_standby(out);
+    }
+
+    ADEV_LOCK(adev);
 
     /*
      * When HDMI cable is unplugged the music playback is paused and
@@ -4866,7 +5227,7 @@ int route_output_stream(struct stream_out *out,
      * turned off, the write gets blocked.
      * Avoid this by routing audio to speaker until standby.
      */
-    if (is_single_device_type_equal(&out->device_list,
+    if (device_set_is_single_type(&out->device_list,
                 AUDIO_DEVICE_OUT_AUX_DIGITAL) &&
             list_empty(&new_devices) &&
             !audio_extn_passthru_is_passthrough_stream(out) &&
@@ -4880,7 +5241,7 @@ int route_output_stream(struct stream_out *out,
      * (3sec). As BT is turned off, the write gets blocked.
      * Avoid this by routing audio to speaker until standby.
      */
-    if (is_a2dp_out_device_type(&out->device_list) &&
+    if (device_set_has(&out->device_list, DEVICE_SET_A2DP_OUT) &&
             list_empty(&new_devices) &&
             !audio_extn_a2dp_source_is_ready() &&
             !adev->bt_sco_on) {
@@ -4893,7 +5254,7 @@ int route_output_stream(struct stream_out *out,
      * when USB is connected back. So routing to speker will guarantee
      * AFE reconfiguration and AFE will be opend once USB is connected again
      */
-    if (is_usb_out_device_type(&out->device_list) &&
+    if (device_set_has(&out->device_list, DEVICE_SET_USB_OUT) &&
             list_empty(&new_devices) &&
             !audio_extn_usb_connected(NULL)) {
         reassign_device_list(&new_devices, AUDIO_DEVICE_OUT_SPEAKER, "");
@@ -4914,8 +5275,8 @@ int route_output_stream(struct stream_out *out,
                  * However it is still possible a2dp routing called because
                  * of current active device disconnection (like wired headset)
                  */
-                assign_devices(&out->device_list, &new_devices);
-                pthread_mutex_unlock(&adev->lock);
+                device_set_assign(&out->device_list, &new_devices);
+                ADEV_UNLOCK(adev);
                 pthread_mutex_unlock(&out->lock);
                 goto error;
             }
@@ -4932,7 +5293,7 @@ int route_output_stream(struct stream_out *out,
             goto error;
         if ((card = get_alive_usb_card(parms)) >= 0) {
             ALOGW("%s: ignoring rerouting to non existing USB card %d", __func__, card);
-            pthread_mutex_unlock(&adev->lock);
+            ADEV_UNLOCK(adev);
             pthread_mutex_unlock(&out->lock);
             str_parms_destroy(parms);
             ret = -ENOSYS;
@@ -4947,7 +5308,7 @@ int route_output_stream(struct stream_out *out,
                                    out->extconn.cs.controller,
                                    out->extconn.cs.stream) != 0)) {
         ALOGW("out_set_parameters() ignoring rerouting to non existing HDMI/DP");
-        pthread_mutex_unlock(&adev->lock);
+        ADEV_UNLOCK(adev);
         pthread_mutex_unlock(&out->lock);
         ret = -ENOSYS;
         goto error;
@@ -4972,8 +5333,8 @@ int route_output_stream(struct stream_out *out,
      *       playback to headset.
      */
     if (!list_empty(&new_devices)) {
-        bool same_dev = compare_devices(&out->device_list, &new_devices);
-        assign_devices(&out->device_list, &new_devices);
+        bool same_dev = compare_devices(&out->device_list.list, &new_devices);
+        device_set_assign(&out->device_list, &new_devices);
 
         if (output_drives_call(adev, out)) {
             if (!voice_is_call_state_active(adev)) {
@@ -4987,7 +5348,7 @@ int route_output_stream(struct stream_out *out,
             }
         }
 
-        if (is_usb_out_device_type(&out->device_list)) {
+        if (device_set_has(&out->device_list, DEVICE_SET_USB_OUT)) {
              service_interval = audio_extn_usb_find_service_interval(false, true /*playback*/);
              audio_extn_usb_set_service_interval(true /*playback*/,
                                                  service_interval,
@@ -5009,11 +5370,11 @@ int route_output_stream(struct stream_out *out,
                 select_devices(adev, out->usecase);
             } else {
                 if (compare_device_type(&new_devices, AUDIO_DEVICE_OUT_SPEAKER_SAFE))
-                    reassign_device_list(&out->device_list, AUDIO_DEVICE_OUT_SPEAKER_SAFE, "");
+                    device_set_reassign(&out->device_list, AUDIO_DEVICE_OUT_SPEAKER_SAFE, "");
                 else
-                    reassign_device_list(&out->device_list, AUDIO_DEVICE_OUT_SPEAKER, "");
+                    device_set_reassign(&out->device_list, AUDIO_DEVICE_OUT_SPEAKER, "");
                 select_devices(adev, out->usecase);
-                assign_devices(&out->device_list, &new_devices);
+                device_set_assign(&out->device_list, &new_devices);
             }
 
             if (!same_dev) {
@@ -5022,8 +5383,10 @@ int route_output_stream(struct stream_out *out,
                 platform_set_swap_channels(adev, true);
                 audio_extn_perf_lock_release(&adev->perf_lock_handle);
             }
+            if (out->pcm != NULL)
+                out_update_write_path(out);
             pthread_mutex_lock(&out->latch_lock);
-            if (!is_a2dp_out_device_type(&out->device_list) || audio_extn_a2dp_source_is_ready()) {
+            if (!device_set_has(&out->device_list, DEVICE_SET_A2DP_OUT) || audio_extn_a2dp_source_is_ready()) {
                 if (out->a2dp_muted) {
                     out->a2dp_muted = false;
                     if (is_offload_usecase(out->usecase))
@@ -5038,7 +5401,7 @@ int route_output_stream(struct stream_out *out,
         }
     }
 
-    pthread_mutex_unlock(&adev->lock);
+    ADEV_UNLOCK(adev);
     pthread_mutex_unlock(&out->lock);
 
     /*handles device and call state changes*/
@@ -5078,9 +5441,9 @@ static int out_set_parameters(struct audio_stream *stream, const char *kvpairs)
     }
 
     if (out == adev->primary_output) {
-        pthread_mutex_lock(&adev->lock);
+        ADEV_LOCK(adev);
         audio_extn_set_parameters(adev, parms);
-        pthread_mutex_unlock(&adev->lock);
+        ADEV_UNLOCK(adev);
     }
     if (is_offload_usecase(out->usecase)) {
         lock_output_stream(out);
@@ -5108,7 +5471,7 @@ static int out_set_parameters(struct audio_stream *stream, const char *kvpairs)
         lock_output_stream(out);
         audio_extn_utils_update_stream_output_app_type_cfg(adev->platform,
                                                           &adev->streams_output_cfg_list,
-                                                          &out->device_list, out->flags,
+                                                          &out->device_list.list, out->flags,
                                                           out->hal_op_format,
                                                           out->sample_rate, out->bit_width,
                                                           out->channel_mask, out->profile,
@@ -5438,7 +5801,7 @@ static uint32_t out_get_latency(const struct audio_stream_out *stream)
            (out->config.rate);
     }
 
-    if (!out->standby && is_a2dp_out_device_type(&out->device_list))
+    if (!out->standby && device_set_has(&out->device_list, DEVICE_SET_A2DP_OUT))
         latency += audio_extn_a2dp_get_encoder_latency();
 
     ALOGV("%s: Latency %d", __func__, latency);
@@ -5612,7 +5975,7 @@ static int out_set_volume(struct audio_stream_out *stream, float left,
             volume[1] = (long)(AmpToDb(right));
             mixer_ctl_set_array(ctl, volume, sizeof(volume)/sizeof(volume[0]));
             return 0;
-        } else if (compare_device_type(&out->device_list, AUDIO_DEVICE_OUT_BUS) &&
+        } else if (device_set_has_type(&out->device_list, AUDIO_DEVICE_OUT_BUS) &&
                 (out->car_audio_stream == CAR_AUDIO_STREAM_MEDIA)) {
             ALOGD("%s: Overriding offload set volume for media bus stream", __func__);
             struct listnode *node = NULL;
@@ -5721,8 +6084,7 @@ int split_and_write_audio_haptic_data(struct stream_out *out,
     size_t frame_size = channel_count * bytes_per_sample;
     size_t frame_count = bytes_to_write / frame_size;
 
-    bool force_haptic_path =
-         property_get_bool("vendor.audio.test_haptic", false);
+    bool force_haptic_path = out->write_path.force_haptic_path;
 
     // extract Haptics data from Audio buffer
     bool   alloc_haptic_buffer = false;
@@ -5787,6 +6149,110 @@ int split_and_write_audio_haptic_data(struct stream_out *out,
     return ret;
 }
 
+static int out_write_pcm(struct stream_out *out, const void *buffer,
+                         size_t bytes __unused, size_t bytes_to_write)
+{
+    return pcm_write(out->pcm, (void *)buffer, bytes_to_write);
+}
+
+static int out_write_pcm_mmap(struct stream_out *out, const void *buffer,
+                              size_t bytes __unused, size_t bytes_to_write)
+{
+    return pcm_mmap_write(out->pcm, (void *)buffer, bytes_to_write);
+}
+
+static int out_write_pcm_convert(struct stream_out *out, const void *buffer,
+                                 size_t bytes __unused, size_t bytes_to_write __unused)
+{
+    memcpy_by_audio_format(out->convert_buffer,
+                           out->hal_op_format,
+                           buffer,
+                           out->hal_ip_format,
+                           out->write_path.period_samples);
+
+    return pcm_write(out->pcm, out->convert_buffer, out->write_path.period_bytes);
+}
+
+/*
+ * To avoid underrun in DSP when the application is not pumping
+ * data at required rate, check for the no. of bytes and ignore
+ * pcm_write if it is less than actual buffer size.
+ * It is a work around to a change in compress VOIP driver.
+ */
+static int out_write_pcm_voip_rx(struct stream_out *out, const void *buffer,
+                                 size_t bytes, size_t bytes_to_write)
+{
+    size_t voip_buf_size = out->write_path.period_bytes;
+
+    if (bytes < voip_buf_size) {
+        ALOGE("%s:VOIP underrun: bytes received %zu, required:%zu\n",
+                __func__, bytes, voip_buf_size);
+        usleep(((uint64_t)voip_buf_size - bytes) *
+               1000000 / audio_stream_out_frame_size(&out->stream) /
+               out_get_sample_rate(&out->stream.common));
+        return 0;
+    }
+    return pcm_write(out->pcm, (void *)buffer, bytes_to_write);
+}
+
+static int out_write_pcm_haptics(struct stream_out *out, const void *buffer,
+                                 size_t bytes, size_t bytes_to_write __unused)
+{
+    return split_and_write_audio_haptic_data(out, buffer, bytes);
+}
+
+/*
+ * Selects the writer out_write() uses for PCM streams. Its inputs are the
+ * usecase, flags, formats, pcm config and convert buffer, which are fixed at
+ * open or by start_output_stream(), and the haptics test property. It is
+ * rebuilt every time the stream leaves standby and after a routing change
+ * of a started stream, which may reconfigure the backend under it.
+ * Must be called with out->lock held, once the stream is started.
+ */
+static void out_update_write_path(struct stream_out *out)
+{
+    struct stream_out_path *path = &out->write_path;
+
+    memset(path, 0, sizeof(*path));
+    path->downmix_mono =
+            (out->usecase == USECASE_INCALL_MUSIC_UPLINK ||
+             out->usecase == USECASE_INCALL_MUSIC_UPLINK2 ||
+             (out->usecase == USECASE_AUDIO_PLAYBACK_VOIP &&
+              !audio_extn_utils_is_vendor_enhanced_fwk()));
+    if (path->downmix_mono) {
+        LOG_ALWAYS_FATAL_IF(audio_channel_count_from_out_mask(out->channel_mask) > 2 ||
+                            out->format != AUDIO_FORMAT_PCM_16_BIT,
+                            "out_write called for %s use case with wrong properties",
+                            use_case_table[out->usecase]);
+        /*
+         * FIXME: this can be removed once audio flinger mixer supports
+         * mono output
+         */
+        path->downmix_mono =
+                audio_channel_count_from_out_mask(out->channel_mask) == 2;
+    }
+
+    if (is_mmap_usecase(out->usecase) || out->realtime) {
+        path->write = out_write_pcm_mmap;
+    } else if (out->hal_op_format != out->hal_ip_format &&
+               out->convert_buffer != NULL) {
+        path->write = out_write_pcm_convert;
+        path->period_samples = out->config.period_size * out->config.channels;
+        path->period_bytes = path->period_samples *
+                             format_to_bitwidth_table[out->hal_op_format];
+    } else if (out->flags & AUDIO_OUTPUT_FLAG_VOIP_RX) {
+        path->write = out_write_pcm_voip_rx;
+        path->period_bytes = out->config.period_size * out->config.channels *
+                             audio_bytes_per_sample(out->format);
+    } else if (out->usecase == USECASE_AUDIO_PLAYBACK_WITH_HAPTICS) {
+        path->write = out_write_pcm_haptics;
+        path->force_haptic_path =
+                property_get_bool("vendor.audio.test_haptic", false);
+    } else {
+        path->write = out_write_pcm;
+    }
+}
+
 #ifdef NO_AUDIO_OUT
 static ssize_t out_write_for_no_output(struct audio_stream_out *stream,
                                        const void *buffer __unused, size_t bytes)
@@ -5797,8 +6263,8 @@ static ssize_t out_write_for_no_output(struct audio_stream_out *stream,
      * Sleep for the amount of buffer duration
      */
     lock_output_stream(out);
-    usleep(bytes * 1000000 / audio_stream_out_frame_size(
-            (const struct audio_stream_out *)&out->stream) /
+    audio_extn_utils_sleep_silence(&out->silence_deadline, bytes,
+            audio_stream_out_frame_size((const struct audio_stream_out *)&out->stream),
             out_get_sample_rate(&out->stream.common));
     pthread_mutex_unlock(&out->lock);
     return bytes;
@@ -5846,7 +6312,7 @@ static ssize_t out_write(struct audio_stream_out *stream, const void *buffer,
         goto exit;
     }
 
-    if (compare_device_type(&out->device_list, AUDIO_DEVICE_OUT_AUX_DIGITAL) &&
+    if (device_set_has_type(&out->device_list, AUDIO_DEVICE_OUT_AUX_DIGITAL) &&
          !out->is_iec61937_info_available) {
 
         if (!audio_extn_passthru_is_passthrough_stream(out)) {
@@ -5870,14 +6336,14 @@ static ssize_t out_write(struct audio_stream_out *stream, const void *buffer,
                      * then trigger select_device to update backend configuration.
                      */
                     out->stream_config_changed = true;
-                    pthread_mutex_lock(&adev->lock);
+                    ADEV_LOCK(adev);
                     select_devices(adev, out->usecase);
                     if (!audio_extn_passthru_is_supported_backend_edid_cfg(adev, out)) {
-                        pthread_mutex_unlock(&adev->lock);
+                        ADEV_UNLOCK(adev);
                         ret = -EINVAL;
                         goto exit;
                     }
-                    pthread_mutex_unlock(&adev->lock);
+                    ADEV_UNLOCK(adev);
                     out->stream_config_changed = false;
                     out->is_iec61937_info_available = true;
                 }
@@ -5900,10 +6366,10 @@ static ssize_t out_write(struct audio_stream_out *stream, const void *buffer,
         }
     }
 
-    if (is_a2dp_out_device_type(&out->device_list) &&
+    if (device_set_has(&out->device_list, DEVICE_SET_A2DP_OUT) &&
         (audio_extn_a2dp_source_is_suspended())) {
-        if (!(compare_device_type(&out->device_list, AUDIO_DEVICE_OUT_SPEAKER) ||
-              compare_device_type(&out->device_list, AUDIO_DEVICE_OUT_SPEAKER_SAFE))) {
+        if (!(device_set_has_type(&out->device_list, AUDIO_DEVICE_OUT_SPEAKER) ||
+              device_set_has_type(&out->device_list, AUDIO_DEVICE_OUT_SPEAKER_SAFE))) {
             if (!is_offload_usecase(out->usecase)) {
                 ret = -EIO;
                 goto exit;
@@ -5911,11 +6377,18 @@ static ssize_t out_write(struct audio_stream_out *stream, const void *buffer,
         }
     }
 
+    if (out->warm_standby && out_resume_warm_standby_l(out) != 0) {
+        /* restart the stream below */
+        out_do_standby(out);
+    }
+
     if (out->standby) {
         out->standby = false;
         const int64_t startNs = systemTime(SYSTEM_TIME_MONOTONIC);
 
-        pthread_mutex_lock(&adev->lock);
+        ADEV_LOCK(adev);
+        /* route under adev->lock, open the PCM below once it is dropped */
+        out->pcm_open_deferred = out_can_defer_pcm_open(out);
         if (out->usecase == USECASE_COMPRESS_VOIP_CALL)
             ret = voice_extn_compress_voip_start_output_stream(out);
         else
@@ -5928,18 +6401,29 @@ static ssize_t out_write(struct audio_stream_out *stream, const void *buffer,
         /* ToDo: If use case is compress offload should return 0 */
         if (ret != 0) {
             out->standby = true;
-            pthread_mutex_unlock(&adev->lock);
+            out->pcm_open_deferred = false;
+            ADEV_UNLOCK(adev);
             goto exit;
         }
         out->started = 1;
         out->last_fifo_valid = false; // we're coming out of standby, last_fifo isn't valid.
+        out_update_write_path(out);
 
         if ((last_known_cal_step != -1) && (adev->platform != NULL)) {
             ALOGD("%s: retry previous failed cal level set", __func__);
             platform_send_gain_dep_cal(adev->platform, last_known_cal_step);
             last_known_cal_step = -1;
         }
-        pthread_mutex_unlock(&adev->lock);
+        ADEV_UNLOCK(adev);
+
+        if (out->pcm_open_deferred) {
+            out->pcm_open_deferred = false;
+            ret = out_open_pcm_l(out);
+            if (ret != 0) {
+                out_do_standby(out);
+                goto exit;
+            }
+        }
 
         if ((out->is_iec61937_info_available == true) &&
             (audio_extn_passthru_is_passthrough_stream(out))&&
@@ -5956,7 +6440,7 @@ static ssize_t out_write(struct audio_stream_out *stream, const void *buffer,
     }
 
     if (adev->is_channel_status_set == false &&
-            compare_device_type(&out->device_list,
+            device_set_has_type(&out->device_list,
                                 AUDIO_DEVICE_OUT_AUX_DIGITAL)) {
         audio_utils_set_hdmi_channel_status(out, (void *)buffer, bytes);
         adev->is_channel_status_set = true;
@@ -6080,34 +6564,18 @@ static ssize_t out_write(struct audio_stream_out *stream, const void *buffer,
             ALOGV("%s: frames=%zu, frame_size=%zu, bytes_to_write=%zu",
                      __func__, frames, frame_size, bytes_to_write);
 
-            if (out->usecase == USECASE_INCALL_MUSIC_UPLINK ||
-                out->usecase == USECASE_INCALL_MUSIC_UPLINK2 ||
-                (out->usecase == USECASE_AUDIO_PLAYBACK_VOIP &&
-                 !audio_extn_utils_is_vendor_enhanced_fwk())) {
-                size_t channel_count = audio_channel_count_from_out_mask(out->channel_mask);
+            /*
+             * Code below goes over each frame in the buffer and adds both
+             * L and R samples and then divides by 2 to convert to mono
+             */
+            if (out->write_path.downmix_mono) {
                 int16_t *src = (int16_t *)buffer;
                 int16_t *dst = (int16_t *)buffer;
 
-                LOG_ALWAYS_FATAL_IF(channel_count > 2 ||
-                                    out->format != AUDIO_FORMAT_PCM_16_BIT,
-                                    "out_write called for %s use case with wrong properties",
-                                    use_case_table[out->usecase]);
-
-                /*
-                 * FIXME: this can be removed once audio flinger mixer supports
-                 * mono output
-                 */
-
-                /*
-                 * Code below goes over each frame in the buffer and adds both
-                 * L and R samples and then divides by 2 to convert to mono
-                 */
-                if (channel_count == 2) {
-                    for (size_t i = 0; i < frames ; i++, dst++, src += 2) {
-                        *dst = (int16_t)(((int32_t)src[0] + (int32_t)src[1]) >> 1);
-                    }
-                    bytes_to_write /= 2;
+                for (size_t i = 0; i < frames ; i++, dst++, src += 2) {
+                    *dst = (int16_t)(((int32_t)src[0] + (int32_t)src[1]) >> 1);
                 }
+                bytes_to_write /= 2;
             }
 
             // Note: since out_get_presentation_position() is called alternating with out_write()
@@ -6144,49 +6612,9 @@ static ssize_t out_write(struct audio_stream_out *stream, const void *buffer,
                                                      out->config.rate;
 
             request_out_focus(out, ns);
-            bool use_mmap = is_mmap_usecase(out->usecase) || out->realtime;
-
-            if (use_mmap)
-                ret = pcm_mmap_write(out->pcm, (void *)buffer, bytes_to_write);
-            else if (out->hal_op_format != out->hal_ip_format &&
-                       out->convert_buffer != NULL) {
-
-                memcpy_by_audio_format(out->convert_buffer,
-                                       out->hal_op_format,
-                                       buffer,
-                                       out->hal_ip_format,
-                                       out->config.period_size * out->config.channels);
-
-                ret = pcm_write(out->pcm, out->convert_buffer,
-                                 (out->config.period_size *
-                                 out->config.channels *
-                                 format_to_bitwidth_table[out->hal_op_format]));
-            } else {
-                /*
-                 * To avoid underrun in DSP when the application is not pumping
-                 * data at required rate, check for the no. of bytes and ignore
-                 * pcm_write if it is less than actual buffer size.
-                 * It is a work around to a change in compress VOIP driver.
-                 */
-                if ((out->flags & AUDIO_OUTPUT_FLAG_VOIP_RX) &&
-                    bytes < (out->config.period_size * out->config.channels *
-                    audio_bytes_per_sample(out->format))) {
-                    size_t voip_buf_size =
-                        out->config.period_size * out->config.channels *
-                        audio_bytes_per_sample(out->format);
-                    ALOGE("%s:VOIP underrun: bytes received %zu, required:%zu\n",
-                            __func__, bytes, voip_buf_size);
-                    usleep(((uint64_t)voip_buf_size - bytes) *
-                           1000000 / audio_stream_out_frame_size(stream) /
-                           out_get_sample_rate(&out->stream.common));
-                    ret = 0;
-                } else {
-                    if (out->usecase == USECASE_AUDIO_PLAYBACK_WITH_HAPTICS)
-                        ret = split_and_write_audio_haptic_data(out, buffer, bytes);
-                    else
-                        ret = pcm_write(out->pcm, (void *)buffer, bytes_to_write);
-                }
-            }
+            if (out->write_path.write == NULL)
+                out_update_write_path(out);
+            ret = out->write_path.write(out, buffer, bytes, bytes_to_write);
 
             release_out_focus(out);
 
@@ -6208,10 +6636,10 @@ exit:
         if (out->pcm)
             ALOGE("%s: error %d, %s", __func__, (int)ret, pcm_get_error(out->pcm));
         if (out->usecase == USECASE_COMPRESS_VOIP_CALL) {
-            pthread_mutex_lock(&adev->lock);
+            ADEV_LOCK(adev);
             voice_extn_compress_voip_close_output_stream(&out->stream.common);
             out->started = 0;
-            pthread_mutex_unlock(&adev->lock);
+            ADEV_UNLOCK(adev);
             out->standby = true;
         }
         out_on_error(&out->stream.common);
@@ -6225,7 +6653,8 @@ exit:
                 ATRACE_END();
                 return -EINVAL;
              }
-             usleep((uint64_t)bytes * 1000000 / stream_size / srate);
+             audio_extn_utils_sleep_silence(&out->silence_deadline, bytes,
+                                            stream_size, srate);
         }
         if (audio_extn_passthru_is_passthrough_stream(out)) {
                 //ALOGE("%s: write error, ret = %zd", __func__, ret);
@@ -6342,7 +6771,7 @@ static int out_get_presentation_position(const struct audio_stream_out *stream,
                  &out->sample_rate);
         // Adjustment accounts for A2dp encoder latency with offload usecases
         // Note: Encoder latency is returned in ms.
-        if (is_a2dp_out_device_type(&out->device_list)) {
+        if (device_set_has(&out->device_list, DEVICE_SET_A2DP_OUT)) {
             unsigned long offset =
                         (audio_extn_a2dp_get_encoder_latency() * out->sample_rate / 1000);
             dsp_frames = (dsp_frames > offset) ? (dsp_frames - offset) : 0;
@@ -6393,7 +6822,7 @@ static int out_get_presentation_position(const struct audio_stream_out *stream,
 
                 // Adjustment accounts for A2dp encoder latency with non offload usecases
                 // Note: Encoder latency is returned in ms, while platform_render_latency in us.
-                if (is_a2dp_out_device_type(&out->device_list)) {
+                if (device_set_has(&out->device_list, DEVICE_SET_A2DP_OUT)) {
                     frames_temp = audio_extn_a2dp_get_encoder_latency() * out->sample_rate / 1000;
                     if (signed_frames >= frames_temp)
                         signed_frames -= frames_temp;
@@ -6405,7 +6834,7 @@ static int out_get_presentation_position(const struct audio_stream_out *stream,
             }
         } else if (out->card_status == CARD_STATUS_OFFLINE ||
             // audioflinger still needs position updates when A2DP is suspended
-            (is_a2dp_out_device_type(&out->device_list) && audio_extn_a2dp_source_is_suspended())) {
+            (device_set_has(&out->device_list, DEVICE_SET_A2DP_OUT) && audio_extn_a2dp_source_is_suspended())) {
             *frames = out->written;
             clock_gettime(CLOCK_MONOTONIC, timestamp);
             if (is_offload_usecase(out->usecase))
@@ -6546,14 +6975,14 @@ static int out_stop(const struct audio_stream_out* stream)
     int ret = -ENOSYS;
 
     ALOGV("%s", __func__);
-    pthread_mutex_lock(&adev->lock);
+    ADEV_LOCK(adev);
     if (out->usecase == USECASE_AUDIO_PLAYBACK_MMAP && !out->standby &&
             out->playback_started && out->pcm != NULL) {
         pcm_stop(out->pcm);
         ret = stop_output_stream(out);
         out->playback_started = false;
     }
-    pthread_mutex_unlock(&adev->lock);
+    ADEV_UNLOCK(adev);
     return ret;
 }
 
@@ -6564,7 +6993,7 @@ static int out_start(const struct audio_stream_out* stream)
     int ret = -ENOSYS;
 
     ALOGV("%s", __func__);
-    pthread_mutex_lock(&adev->lock);
+    ADEV_LOCK(adev);
     if (out->usecase == USECASE_AUDIO_PLAYBACK_MMAP && !out->standby &&
             !out->playback_started && out->pcm != NULL) {
         ret = start_output_stream(out);
@@ -6572,7 +7001,7 @@ static int out_start(const struct audio_stream_out* stream)
             out->playback_started = true;
         }
     }
-    pthread_mutex_unlock(&adev->lock);
+    ADEV_UNLOCK(adev);
     return ret;
 }
 
@@ -6622,7 +7051,7 @@ static int out_create_mmap_buffer(const struct audio_stream_out *stream,
 
     ALOGD("%s", __func__);
     lock_output_stream(out);
-    pthread_mutex_lock(&adev->lock);
+    ADEV_LOCK(adev);
 
     if (CARD_STATUS_OFFLINE == out->card_status ||
         CARD_STATUS_OFFLINE == adev->card_status) {
@@ -6721,7 +7150,7 @@ exit:
             out->pcm = NULL;
         }
     }
-    pthread_mutex_unlock(&adev->lock);
+    ADEV_UNLOCK(adev);
     pthread_mutex_unlock(&out->lock);
     return ret;
 }
@@ -6825,7 +7254,7 @@ static int in_standby(struct audio_stream *stream)
         if (adev->adm_deregister_stream)
             adev->adm_deregister_stream(adev->adm_data, in->capture_handle);
 
-        pthread_mutex_lock(&adev->lock);
+        ADEV_LOCK(adev);
         amplifier_input_stream_standby((struct audio_stream_in *) stream);
 
         in->standby = true;
@@ -6862,7 +7291,7 @@ static int in_standby(struct audio_stream *stream)
                 adev->num_va_sessions--;
         }
 
-        pthread_mutex_unlock(&adev->lock);
+        ADEV_UNLOCK(adev);
     }
     pthread_mutex_unlock(&in->lock);
     ALOGV("%s: exit:  status(%d)", __func__, status);
@@ -6912,9 +7341,9 @@ static void in_snd_mon_cb(void * stream, struct str_parms * parms)
     if (parse_snd_card_status(parms, &card, &status) < 0)
         return;
 
-    pthread_mutex_lock(&adev->lock);
+    ADEV_LOCK(adev);
     bool valid_cb = (card == adev->snd_card);
-    pthread_mutex_unlock(&adev->lock);
+    ADEV_UNLOCK(adev);
 
     if (!valid_cb)
         return;
@@ -6944,7 +7373,7 @@ int route_input_stream(struct stream_in *in,
     int ret = 0;
 
     lock_input_stream(in);
-    pthread_mutex_lock(&adev->lock);
+    ADEV_LOCK(adev);
 
     /* no audio source uses val == 0 */
     if ((in->source != source) && (source != AUDIO_SOURCE_DEFAULT)) {
@@ -6963,7 +7392,7 @@ int route_input_stream(struct stream_in *in,
         }
     }
 
-    if (!compare_devices(&in->device_list, devices) && !list_empty(devices) &&
+    if (!compare_devices(&in->device_list.list, devices) && !list_empty(devices) &&
           is_audio_in_device_type(devices)) {
         // Workaround: If routing to an non existing usb device, fail gracefully
         // The routing request will otherwise block during 10 second
@@ -6976,7 +7405,7 @@ int route_input_stream(struct stream_in *in,
             ret = -ENOSYS;
         } else {
             /* If recording is in progress, change the tx device to new device */
-            assign_devices(&in->device_list, devices);
+            device_set_assign(&in->device_list, devices);
             if (!in->standby && !in->is_st_session) {
                 ALOGV("update input routing change");
                 // inform adm before actual routing to prevent glitches.
@@ -6992,7 +7421,7 @@ int route_input_stream(struct stream_in *in,
         if (usb_addr)
             str_parms_destroy(usb_addr);
     }
-    pthread_mutex_unlock(&adev->lock);
+    ADEV_UNLOCK(adev);
     pthread_mutex_unlock(&in->lock);
 
     ALOGD("%s: exit: status(%d)", __func__, ret);
@@ -7016,7 +7445,7 @@ static int in_set_parameters(struct audio_stream *stream, const char *kvpairs)
     amplifier_in_set_parameters(parms);
 
     lock_input_stream(in);
-    pthread_mutex_lock(&adev->lock);
+    ADEV_LOCK(adev);
 
     err = str_parms_get_str(parms, AUDIO_PARAMETER_STREAM_PROFILE, value, sizeof(value));
     if (err >= 0) {
@@ -7024,12 +7453,12 @@ static int in_set_parameters(struct audio_stream *stream, const char *kvpairs)
         ALOGV("updating stream profile with value '%s'", in->profile);
         audio_extn_utils_update_stream_input_app_type_cfg(adev->platform,
                                                           &adev->streams_input_cfg_list,
-                                                          &in->device_list, in->flags, in->format,
+                                                          &in->device_list.list, in->flags, in->format,
                                                           in->sample_rate, in->bit_width,
                                                           in->profile, &in->app_type_cfg);
     }
 
-    pthread_mutex_unlock(&adev->lock);
+    ADEV_UNLOCK(adev);
     pthread_mutex_unlock(&in->lock);
 
     str_parms_destroy(parms);
@@ -7111,6 +7540,98 @@ static int in_set_gain(struct audio_stream_in *stream,
     return 0;
 }
 
+/*
+ * Capture data paths. in_select_read_fn() picks one when the stream leaves
+ * standby so that in_read() does not re-evaluate the stream type per period.
+ * Only compress capture reports partial reads, the others consume bytes.
+ */
+static int in_read_cin(struct stream_in *in, void *buffer, size_t bytes,
+                       size_t *bytes_read)
+{
+    return audio_extn_cin_read(in, buffer, bytes, bytes_read);
+}
+
+static int in_read_ssr(struct stream_in *in, void *buffer, size_t bytes,
+                       size_t *bytes_read)
+{
+    *bytes_read = bytes;
+    return audio_extn_ssr_read(&in->stream, buffer, bytes);
+}
+
+static int in_read_compr_cap(struct stream_in *in, void *buffer, size_t bytes,
+                             size_t *bytes_read)
+{
+    *bytes_read = bytes;
+    return audio_extn_compr_cap_read(in, buffer, bytes);
+}
+
+static int in_read_mmap(struct stream_in *in, void *buffer, size_t bytes,
+                        size_t *bytes_read)
+{
+    *bytes_read = bytes;
+    return pcm_mmap_read(in->pcm, buffer, bytes);
+}
+
+static int in_read_ffv(struct stream_in *in, void *buffer, size_t bytes,
+                       size_t *bytes_read)
+{
+    *bytes_read = bytes;
+    return audio_extn_ffv_read(&in->stream, buffer, bytes);
+}
+
+static int in_read_pcm(struct stream_in *in, void *buffer, size_t bytes,
+                       size_t *bytes_read)
+{
+    int ret = pcm_read(in->pcm, buffer, bytes);
+
+    *bytes_read = bytes;
+    if (ret < 0)
+        return -errno;
+    return 0;
+}
+
+/* data from DSP comes in 24_8 format, convert it to 8_24 */
+static int in_read_pcm_24_8(struct stream_in *in, void *buffer, size_t bytes,
+                            size_t *bytes_read)
+{
+    int ret = pcm_read(in->pcm, buffer, bytes);
+
+    *bytes_read = bytes;
+    if (ret < 0)
+        return -errno;
+    if (bytes > 0 &&
+        audio_extn_utils_convert_format_24_8_to_8_24(buffer, bytes) != bytes)
+        return -EINVAL;
+    return 0;
+}
+
+static int in_read_none(struct stream_in *in __unused, void *buffer __unused,
+                        size_t bytes __unused, size_t *bytes_read __unused)
+{
+    return 0;
+}
+
+/* must be called with in->lock held, once the stream is started */
+static void in_select_read_fn(struct stream_in *in)
+{
+    if (audio_extn_cin_attached_usecase(in))
+        in->read_fn = in_read_cin;
+    else if (!in->pcm)
+        in->read_fn = in_read_none;
+    else if (audio_extn_ssr_stream_active(in))
+        in->read_fn = in_read_ssr;
+    else if (audio_extn_compr_cap_usecase_supported(in->usecase))
+        in->read_fn = in_read_compr_cap;
+    else if (is_mmap_usecase(in->usecase) || in->realtime)
+        in->read_fn = in_read_mmap;
+    else if (audio_extn_ffv_stream_active(in))
+        in->read_fn = in_read_ffv;
+    else if (in->format == AUDIO_FORMAT_PCM_8_24_BIT)
+        in->read_fn = in_read_pcm_24_8;
+    else
+        in->read_fn = in_read_pcm;
+}
+
 static ssize_t in_read(struct audio_stream_in *stream, void *buffer,
                        size_t bytes)
 {
@@ -7154,7 +7675,7 @@ static ssize_t in_read(struct audio_stream_in *stream, void *buffer,
     if (in->standby) {
         const int64_t startNs = systemTime(SYSTEM_TIME_MONOTONIC);
 
-        pthread_mutex_lock(&adev->lock);
+        ADEV_LOCK(adev);
         if (in->usecase == USECASE_COMPRESS_VOIP_CALL)
             ret = voice_extn_compress_voip_start_input_stream(in);
         else
@@ -7167,11 +7688,12 @@ static ssize_t in_read(struct audio_stream_in *stream, void *buffer,
         if (ret == 0)
             amplifier_input_stream_start(stream);
 
-        pthread_mutex_unlock(&adev->lock);
+        ADEV_UNLOCK(adev);
         if (ret != 0) {
             goto exit;
         }
         in->standby = 0;
+        in_select_read_fn(in);
 
         // log startup time in ms.
         simple_stats_log(
@@ -7195,35 +7717,10 @@ static ssize_t in_read(struct audio_stream_in *stream, void *buffer,
     ret = request_in_focus(in, ns);
     if (ret != 0)
         goto exit;
-    bool use_mmap = is_mmap_usecase(in->usecase) || in->realtime;
 
-    if (audio_extn_cin_attached_usecase(in)) {
-        ret = audio_extn_cin_read(in, buffer, bytes, &bytes_read);
-    } else if (in->pcm) {
-        if (audio_extn_ssr_get_stream() == in) {
-            ret = audio_extn_ssr_read(stream, buffer, bytes);
-        } else if (audio_extn_compr_cap_usecase_supported(in->usecase)) {
-            ret = audio_extn_compr_cap_read(in, buffer, bytes);
-        } else if (use_mmap) {
-            ret = pcm_mmap_read(in->pcm, buffer, bytes);
-        } else if (audio_extn_ffv_get_stream() == in) {
-            ret = audio_extn_ffv_read(stream, buffer, bytes);
-        } else {
-            ret = pcm_read(in->pcm, buffer, bytes);
-            /* data from DSP comes in 24_8 format, convert it to 8_24 */
-            if (!ret && bytes > 0 && (in->format == AUDIO_FORMAT_PCM_8_24_BIT)) {
-                if (audio_extn_utils_convert_format_24_8_to_8_24(buffer, bytes)
-                    != bytes) {
-                    ret = -EINVAL;
-                    goto exit;
-                }
-            } else if (ret < 0) {
-                ret = -errno;
-            }
-        }
-        /* bytes read is always set to bytes for non compress usecases */
-        bytes_read = bytes;
-    }
+    if (in->read_fn == NULL)
+        in_select_read_fn(in);
+    ret = in->read_fn(in, buffer, bytes, &bytes_read);
 
     release_in_focus(in);
 
@@ -7254,9 +7751,9 @@ exit:
 
     if (ret != 0) {
         if (in->usecase == USECASE_COMPRESS_VOIP_CALL) {
-            pthread_mutex_lock(&adev->lock);
+            ADEV_LOCK(adev);
             voice_extn_compress_voip_close_input_stream(&in->stream.common);
-            pthread_mutex_unlock(&adev->lock);
+            ADEV_UNLOCK(adev);
             in->standby = true;
         }
         if (!audio_extn_cin_attached_usecase(in)) {
@@ -7267,8 +7764,9 @@ exit:
         if (in->usecase == USECASE_AUDIO_RECORD_LOW_LATENCY)
             adev->adm_routing_changed = false;
         ALOGV("%s: read failed status %d- sleeping for buffer duration", __func__, ret);
-        usleep((uint64_t)bytes * 1000000 / audio_stream_in_frame_size(stream) /
-                                   in_get_sample_rate(&in->stream.common));
+        audio_extn_utils_sleep_silence(&in->silence_deadline, bytes,
+                                       audio_stream_in_frame_size(stream),
+                                       in_get_sample_rate(&in->stream.common));
     }
     return bytes_read;
 }
@@ -7371,7 +7869,7 @@ static int add_remove_audio_effect(const struct audio_stream *stream,
         return status;
 
     lock_input_stream(in);
-    pthread_mutex_lock(&in->dev->lock);
+    ADEV_LOCK(in->dev);
     if ((in->source == AUDIO_SOURCE_VOICE_COMMUNICATION ||
             in->source == AUDIO_SOURCE_VOICE_RECOGNITION ||
             adev->mode == AUDIO_MODE_IN_COMMUNICATION) &&
@@ -7421,7 +7919,7 @@ static int add_remove_audio_effect(const struct audio_stream *stream,
         }
     }
 exit:
-    pthread_mutex_unlock(&in->dev->lock);
+    ADEV_UNLOCK(in->dev);
     pthread_mutex_unlock(&in->lock);
 
     return 0;
@@ -7480,14 +7978,14 @@ static int in_stop(const struct audio_stream_in* stream)
 
     int ret = -ENOSYS;
     ALOGV("%s", __func__);
-    pthread_mutex_lock(&adev->lock);
+    ADEV_LOCK(adev);
     if (in->usecase == USECASE_AUDIO_RECORD_MMAP && !in->standby &&
             in->capture_started && in->pcm != NULL) {
         pcm_stop(in->pcm);
         ret = stop_input_stream(in);
         in->capture_started = false;
     }
-    pthread_mutex_unlock(&adev->lock);
+    ADEV_UNLOCK(adev);
     return ret;
 }
 
@@ -7498,7 +7996,7 @@ static int in_start(const struct audio_stream_in* stream)
     int ret = -ENOSYS;
 
     ALOGV("%s in %p", __func__, in);
-    pthread_mutex_lock(&adev->lock);
+    ADEV_LOCK(adev);
     if (in->usecase == USECASE_AUDIO_RECORD_MMAP && !in->standby &&
             !in->capture_started && in->pcm != NULL) {
         if (!in->capture_started) {
@@ -7508,7 +8006,7 @@ static int in_start(const struct audio_stream_in* stream)
             }
         }
     }
-    pthread_mutex_unlock(&adev->lock);
+    ADEV_UNLOCK(adev);
     return ret;
 }
 
@@ -7536,7 +8034,7 @@ static int in_create_mmap_buffer(const struct audio_stream_in *stream,
     uint32_t mmap_size = 0;
     uint32_t buffer_size = 0;
 
-    pthread_mutex_lock(&adev->lock);
+    ADEV_LOCK(adev);
     ALOGV("%s in %p", __func__, in);
 
     if (CARD_STATUS_OFFLINE == in->card_status||
@@ -7639,7 +8137,7 @@ exit:
             in->pcm = NULL;
         }
     }
-    pthread_mutex_unlock(&adev->lock);
+    ADEV_UNLOCK(adev);
     return ret;
 }
 
@@ -7676,11 +8174,11 @@ static int in_get_active_microphones(const struct audio_stream_in *stream,
     ALOGVV("%s", __func__);
 
     lock_input_stream(in);
-    pthread_mutex_lock(&adev->lock);
+    ADEV_LOCK(adev);
     int ret = platform_get_active_microphones(adev->platform,
                                               audio_channel_count_from_in_mask(in->channel_mask),
                                               in->usecase, mic_array, mic_count);
-    pthread_mutex_unlock(&adev->lock);
+    ADEV_UNLOCK(adev);
     pthread_mutex_unlock(&in->lock);
 
     return ret;
@@ -7692,9 +8190,9 @@ static int adev_get_microphones(const struct audio_hw_device *dev,
     struct audio_device *adev = (struct audio_device *)dev;
     ALOGVV("%s", __func__);
 
-    pthread_mutex_lock(&adev->lock);
+    ADEV_LOCK(adev);
     int ret = platform_get_microphones(adev->platform, mic_array, mic_count);
-    pthread_mutex_unlock(&adev->lock);
+    ADEV_UNLOCK(adev);
 
     return ret;
 }
@@ -7720,7 +8218,7 @@ static void in_update_sink_metadata(struct audio_stream_in *stream,
         reassign_device_list(&devices, sink_metadata->tracks->dest_device, "");
 
     lock_input_stream(in);
-    pthread_mutex_lock(&adev->lock);
+    ADEV_LOCK(adev);
     ALOGV("%s: in->usecase: %d, device: %x", __func__, in->usecase, get_device_types(&devices));
 
     is_ha_usecase = adev->ha_proxy_enable ?
@@ -7731,7 +8229,7 @@ static void in_update_sink_metadata(struct audio_stream_in *stream,
         /* Use the rx device from afe-proxy record to route voice call because
            there is no routing if tx device is on primary hal and rx device
            is on other hal during voice call. */
-        assign_devices(&adev->voice_tx_output->device_list, &devices);
+        device_set_assign(&adev->voice_tx_output->device_list, &devices);
 
         if (!voice_is_call_state_active(adev)) {
             if (adev->mode == AUDIO_MODE_IN_CALL) {
@@ -7746,7 +8244,7 @@ static void in_update_sink_metadata(struct audio_stream_in *stream,
         }
     }
 
-    pthread_mutex_unlock(&adev->lock);
+    ADEV_UNLOCK(adev);
     pthread_mutex_unlock(&in->lock);
 }
 
@@ -7793,12 +8291,12 @@ int adev_open_output_stream(struct audio_hw_device *dev,
 
     *stream_out = NULL;
 
-    pthread_mutex_lock(&adev->lock);
+    ADEV_LOCK(adev);
     if (out_get_stream(adev, handle) != NULL) {
         ALOGW("%s, output stream already opened", __func__);
         ret = -EEXIST;
     }
-    pthread_mutex_unlock(&adev->lock);
+    ADEV_UNLOCK(adev);
     if (ret)
         return ret;
 
@@ -7823,8 +8321,8 @@ int adev_open_output_stream(struct audio_hw_device *dev,
         devices = AUDIO_DEVICE_OUT_SPEAKER;
 
     out->flags = flags;
-    list_init(&out->device_list);
-    update_device_list(&out->device_list, devices, address, true /* add devices */);
+    device_set_init(&out->device_list);
+    device_set_update(&out->device_list, devices, address, true /* add devices */);
     out->dev = adev;
     out->hal_op_format = out->hal_ip_format = format = out->format = config->format;
     out->sample_rate = config->sample_rate;
@@ -7858,7 +8356,7 @@ int adev_open_output_stream(struct audio_hw_device *dev,
         audio_channel_mask_t req_channel_mask = config->channel_mask;
         uint32_t req_sample_rate = config->sample_rate;
 
-        pthread_mutex_lock(&adev->lock);
+        ADEV_LOCK(adev);
         if (is_hdmi) {
             ALOGV("AUDIO_DEVICE_OUT_AUX_DIGITAL and DIRECT|OFFLOAD, check hdmi caps");
             ret = read_hdmi_sink_caps(out);
@@ -7882,7 +8380,7 @@ int adev_open_output_stream(struct audio_hw_device *dev,
             ALOGV("plugged dev USB ret %d", ret);
        }
 
-       pthread_mutex_unlock(&adev->lock);
+       ADEV_UNLOCK(adev);
        if (ret != 0) {
             if (ret == -ENOSYS) {
                 /* ignore and go with default */
@@ -7932,7 +8430,7 @@ int adev_open_output_stream(struct audio_hw_device *dev,
     }
 
     /* validate bus device address */
-    if (compare_device_type(&out->device_list, AUDIO_DEVICE_OUT_BUS)) {
+    if (device_set_has_type(&out->device_list, AUDIO_DEVICE_OUT_BUS)) {
         /* extract car audio stream index */
         out->car_audio_stream =
             audio_extn_auto_hal_get_car_audio_stream_from_address(address);
@@ -8002,9 +8500,9 @@ int adev_open_output_stream(struct audio_hw_device *dev,
         out->config.format = pcm_format_from_audio_format(out->format);
     } else if ((out->flags & AUDIO_OUTPUT_FLAG_COMPRESS_OFFLOAD) ||
                (out->flags == AUDIO_OUTPUT_FLAG_DIRECT)) {
-        pthread_mutex_lock(&adev->lock);
+        ADEV_LOCK(adev);
         bool offline = (adev->card_status == CARD_STATUS_OFFLINE);
-        pthread_mutex_unlock(&adev->lock);
+        ADEV_UNLOCK(adev);
 
         // reject offload during card offline to allow
         // fallback to s/w paths
@@ -8076,7 +8574,7 @@ int adev_open_output_stream(struct audio_hw_device *dev,
         }
 
         if (out->usecase == USECASE_INVALID) {
-            if (compare_device_type(&out->device_list, AUDIO_DEVICE_OUT_AUX_DIGITAL) &&
+            if (device_set_has_type(&out->device_list, AUDIO_DEVICE_OUT_AUX_DIGITAL) &&
                     config->format == 0 && config->sample_rate == 0 &&
                     config->channel_mask == 0) {
                 ALOGI("%s dummy open to query sink capability",__func__);
@@ -8337,8 +8835,8 @@ int adev_open_output_stream(struct audio_hw_device *dev,
                 __func__, ret);
             goto error_open;
         }
-    } else if (is_single_device_type_equal(&out->device_list,
-                                           AUDIO_DEVICE_OUT_TELEPHONY_TX)) {
+    } else if (device_set_is_single_type(&out->device_list,
+                                         AUDIO_DEVICE_OUT_TELEPHONY_TX)) {
         switch (config->sample_rate) {
             case 0:
                 out->sample_rate = AFE_PROXY_SAMPLING_RATE;
@@ -8468,7 +8966,7 @@ int adev_open_output_stream(struct audio_hw_device *dev,
                 adev->haptics_config.channels = 1;
             } else
                 adev->haptics_config.channels = audio_channel_count_from_out_mask(out->channel_mask & AUDIO_CHANNEL_HAPTIC_ALL);
-        } else if (compare_device_type(&out->device_list, AUDIO_DEVICE_OUT_BUS)) {
+        } else if (device_set_has_type(&out->device_list, AUDIO_DEVICE_OUT_BUS)) {
             ret = audio_extn_auto_hal_open_output_stream(out);
             if (ret) {
                 ALOGE("%s: Failed to open output stream for bus device", __func__);
@@ -8510,7 +9008,7 @@ int adev_open_output_stream(struct audio_hw_device *dev,
         out->bit_width = 16;
     audio_extn_utils_update_stream_output_app_type_cfg(adev->platform,
                                                 &adev->streams_output_cfg_list,
-                                                &out->device_list, out->flags,
+                                                &out->device_list.list, out->flags,
                                                 out->hal_op_format, out->sample_rate,
                                                 out->bit_width, out->channel_mask, out->profile,
                                                 &out->app_type_cfg);
@@ -8527,16 +9025,16 @@ int adev_open_output_stream(struct audio_hw_device *dev,
     }
 
     /* Check if this usecase is already existing */
-    pthread_mutex_lock(&adev->lock);
+    ADEV_LOCK(adev);
     if ((get_usecase_from_list(adev, out->usecase) != NULL) &&
         (out->usecase != USECASE_COMPRESS_VOIP_CALL)) {
         ALOGE("%s: Usecase (%d) is already present", __func__, out->usecase);
-        pthread_mutex_unlock(&adev->lock);
+        ADEV_UNLOCK(adev);
         ret = -EEXIST;
         goto error_open;
     }
 
-    pthread_mutex_unlock(&adev->lock);
+    ADEV_UNLOCK(adev);
 
     out->stream.common.get_sample_rate = out_get_sample_rate;
     out->stream.common.set_sample_rate = out_set_sample_rate;
@@ -8592,9 +9090,9 @@ int adev_open_output_stream(struct audio_hw_device *dev,
     */
     lock_output_stream(out);
     audio_extn_snd_mon_register_listener(out, out_snd_mon_cb);
-    pthread_mutex_lock(&adev->lock);
+    ADEV_LOCK(adev);
     out->card_status = adev->card_status;
-    pthread_mutex_unlock(&adev->lock);
+    ADEV_UNLOCK(adev);
     pthread_mutex_unlock(&out->lock);
 
     stream_app_type_cfg_init(&out->app_type_cfg);
@@ -8648,9 +9146,18 @@ int adev_open_output_stream(struct audio_hw_device *dev,
     }
     out_ctxt->output = out;
 
-    pthread_mutex_lock(&adev->lock);
+    ADEV_LOCK(adev);
     list_add_tail(&adev->active_outputs_list, &out_ctxt->list);
-    pthread_mutex_unlock(&adev->lock);
+    out->standby_delay_ms = audio_extn_utils_get_output_standby_delay(
+                                &adev->streams_output_cfg_list,
+                                out->flags, out->profile);
+    ADEV_UNLOCK(adev);
+
+    if (out->standby_delay_ms > 0 && create_standby_thread(out) != 0) {
+        ALOGW("%s: no standby thread, warm standby disabled", __func__);
+        pthread_cond_destroy(&out->standby_cond);
+        out->standby_delay_ms = 0;
+    }
 
     ALOGV("%s: exit", __func__);
     return 0;
@@ -8679,6 +9186,9 @@ void adev_close_output_stream(struct audio_hw_device *dev __unused,
     // between the callback and close_stream
     audio_extn_snd_mon_unregister_listener(out);
 
+    if (out->standby_delay_ms > 0)
+        destroy_standby_thread(out);
+
     /* close adsp hdrl session before standby */
     if (out->adsp_hdlr_stream_handle) {
         ret = audio_extn_adsp_hdlr_stream_close(out->adsp_hdlr_stream_handle);
@@ -8693,10 +9203,10 @@ void adev_close_output_stream(struct audio_hw_device *dev __unused,
     }
 
     if (out->usecase == USECASE_COMPRESS_VOIP_CALL) {
-        pthread_mutex_lock(&adev->lock);
+        ADEV_LOCK(adev);
         ret = voice_extn_compress_voip_close_output_stream(&stream->common);
         out->started = 0;
-        pthread_mutex_unlock(&adev->lock);
+        ADEV_UNLOCK(adev);
         if(ret != 0)
             ALOGE("%s: Compress voip output cannot be closed, error:%d",
                   __func__, ret);
@@ -8736,7 +9246,7 @@ void adev_close_output_stream(struct audio_hw_device *dev __unused,
     pthread_mutex_destroy(&out->latch_lock);
     pthread_mutex_destroy(&out->position_query_lock);
 
-    pthread_mutex_lock(&adev->lock);
+    ADEV_LOCK(adev);
     streams_output_ctxt_t *out_ctxt = out_get_stream(adev, out->handle);
     if (out_ctxt != NULL) {
         list_remove(&out_ctxt->list);
@@ -8745,49 +9255,42 @@ void adev_close_output_stream(struct audio_hw_device *dev __unused,
         ALOGW("%s, output stream already closed", __func__);
     }
     free(stream);
-    pthread_mutex_unlock(&adev->lock);
+    ADEV_UNLOCK(adev);
     ALOGV("%s: exit", __func__);
 }
 
-static int adev_set_parameters(struct audio_hw_device *dev, const char *kvpairs)
+static int adev_set_snd_card_status(struct audio_device *adev,
+                                    struct str_parms *parms)
 {
-    struct audio_device *adev = (struct audio_device *)dev;
-    struct str_parms *parms;
-    char value[32];
-    int val;
-    int ret;
-    int status = 0;
-    bool a2dp_reconfig = false;
     struct listnode *node;
-    int controller = -1, stream = -1;
-
-    ALOGD("%s: enter: %s", __func__, kvpairs);
-    parms = str_parms_create_str(kvpairs);
-
-    if (!parms)
-        goto error;
 
     /* notify adev and input/output streams on the snd card status */
     adev_snd_mon_cb((void *)adev, parms);
 
-    ret = str_parms_get_str(parms, "SND_CARD_STATUS", value, sizeof(value));
-    if (ret >= 0) {
-        list_for_each(node, &adev->active_outputs_list) {
-            streams_output_ctxt_t *out_ctxt = node_to_item(node,
-                                                streams_output_ctxt_t,
-                                                list);
-            out_snd_mon_cb((void *)out_ctxt->output, parms);
-        }
+    if (!str_parms_has_key(parms, "SND_CARD_STATUS"))
+        return 0;
 
-        list_for_each(node, &adev->active_inputs_list) {
-            streams_input_ctxt_t *in_ctxt = node_to_item(node,
-                                                streams_input_ctxt_t,
-                                                list);
-            in_snd_mon_cb((void *)in_ctxt->input, parms);
-        }
+    list_for_each(node, &adev->active_outputs_list) {
+        streams_output_ctxt_t *out_ctxt = node_to_item(node,
+                                            streams_output_ctxt_t,
+                                            list);
+        out_snd_mon_cb((void *)out_ctxt->output, parms);
     }
 
-    pthread_mutex_lock(&adev->lock);
+    list_for_each(node, &adev->active_inputs_list) {
+        streams_input_ctxt_t *in_ctxt = node_to_item(node,
+                                            streams_input_ctxt_t,
+                                            list);
+        in_snd_mon_cb((void *)in_ctxt->input, parms);
+    }
+    return 0;
+}
+
+static int adev_set_bt_sco(struct audio_device *adev, struct str_parms *parms)
+{
+    char value[32];
+    int ret;
+
     ret = str_parms_get_str(parms, "BT_SCO", value, sizeof(value));
     if (ret >= 0) {
         /* When set to false, HAL should disable EC and NS */
@@ -8805,13 +9308,13 @@ static int adev_set_parameters(struct audio_hw_device *dev, const char *kvpairs)
             list_for_each(node, &adev->usecase_list) {
                 usecase = node_to_item(node, struct audio_usecase, list);
                 if (usecase->stream.in && (usecase->type == PCM_CAPTURE) &&
-                    (!is_btsco_device(SND_DEVICE_NONE, usecase->in_snd_device)) && (is_sco_in_device_type(&usecase->stream.in->device_list))) {
+                    (!is_btsco_device(SND_DEVICE_NONE, usecase->in_snd_device)) && (device_set_has(&usecase->stream.in->device_list, DEVICE_SET_SCO_IN))) {
                     ALOGD("BT_SCO ON, switch all in use case to it");
                     select_devices(adev, usecase->id);
                     }
                 if (usecase->stream.out && (usecase->type == PCM_PLAYBACK ||
                                             usecase->type == VOICE_CALL) &&
-                    (!is_btsco_device(usecase->out_snd_device, SND_DEVICE_NONE)) && (is_sco_out_device_type(&usecase->stream.out->device_list))) {
+                    (!is_btsco_device(usecase->out_snd_device, SND_DEVICE_NONE)) && (device_set_has(&usecase->stream.out->device_list, DEVICE_SET_SCO_OUT))) {
                      ALOGD("BT_SCO ON, switch all out use case to it");
                      select_devices(adev, usecase->id);
                     }
@@ -8822,14 +9325,26 @@ static int adev_set_parameters(struct audio_hw_device *dev, const char *kvpairs)
             audio_extn_sco_reset_configuration();
         }
     }
+    return 0;
+}
 
-    status = voice_set_parameters(adev, parms);
-    if (status != 0)
-        goto done;
+static int adev_set_voice_parameters(struct audio_device *adev,
+                                     struct str_parms *parms)
+{
+    return voice_set_parameters(adev, parms);
+}
 
-    status = platform_set_parameters(adev->platform, parms);
-    if (status != 0)
-        goto done;
+static int adev_set_platform_parameters(struct audio_device *adev,
+                                        struct str_parms *parms)
+{
+    return platform_set_parameters(adev->platform, parms);
+}
+
+static int adev_set_bt_parameters(struct audio_device *adev,
+                                  struct str_parms *parms)
+{
+    char value[32];
+    int ret;
 
     ret = str_parms_get_str(parms, AUDIO_PARAMETER_KEY_BT_NREC, value, sizeof(value));
     if (ret >= 0) {
@@ -8840,62 +9355,88 @@ static int adev_set_parameters(struct audio_hw_device *dev, const char *kvpairs)
             adev->bluetooth_nrec = false;
     }
 
-    ret = str_parms_get_str(parms, "screen_state", value, sizeof(value));
+    ret = str_parms_get_str(parms, AUDIO_PARAMETER_KEY_BT_SCO_WB, value, sizeof(value));
     if (ret >= 0) {
         if (strcmp(value, AUDIO_PARAMETER_VALUE_ON) == 0)
-            adev->screen_off = false;
+            adev->bt_wb_speech_enabled = true;
         else
-            adev->screen_off = true;
-        audio_extn_sound_trigger_update_screen_status(adev->screen_off);
+            adev->bt_wb_speech_enabled = false;
     }
 
-    ret = str_parms_get_int(parms, "rotation", &val);
+    ret = str_parms_get_str(parms, "bt_swb", value, sizeof(value));
     if (ret >= 0) {
-        bool reverse_speakers = false;
-        int camera_rotation = CAMERA_ROTATION_LANDSCAPE;
-        switch (val) {
-        // FIXME: note that the code below assumes that the speakers are in the correct placement
-        //   relative to the user when the device is rotated 90deg from its default rotation. This
-        //   assumption is device-specific, not platform-specific like this code.
-        case 270:
-            reverse_speakers = true;
-            camera_rotation = CAMERA_ROTATION_INVERT_LANDSCAPE;
-            break;
-        case 0:
-        case 180:
-            camera_rotation = CAMERA_ROTATION_PORTRAIT;
-            break;
-        case 90:
-            camera_rotation = CAMERA_ROTATION_LANDSCAPE;
-            break;
-        default:
-            ALOGE("%s: unexpected rotation of %d", __func__, val);
-            status = -EINVAL;
-        }
-        if (status == 0) {
-            // check and set swap
-            //   - check if orientation changed and speaker active
-            //   - set rotation and cache the rotation value
-            adev->camera_orientation =
-                (adev->camera_orientation & ~CAMERA_ROTATION_MASK) | camera_rotation;
-            if (!audio_extn_is_maxx_audio_enabled())
-                platform_check_and_set_swap_lr_channels(adev, reverse_speakers);
-        }
+        adev->swb_speech_mode = atoi(value);
     }
+    return 0;
+}
 
-    ret = str_parms_get_str(parms, AUDIO_PARAMETER_KEY_BT_SCO_WB, value, sizeof(value));
+static int adev_set_screen_state(struct audio_device *adev,
+                                 struct str_parms *parms)
+{
+    char value[32];
+    int ret;
+
+    ret = str_parms_get_str(parms, "screen_state", value, sizeof(value));
     if (ret >= 0) {
         if (strcmp(value, AUDIO_PARAMETER_VALUE_ON) == 0)
-            adev->bt_wb_speech_enabled = true;
+            adev->screen_off = false;
         else
-            adev->bt_wb_speech_enabled = false;
+            adev->screen_off = true;
+        audio_extn_sound_trigger_update_screen_status(adev->screen_off);
     }
+    return 0;
+}
 
-    ret = str_parms_get_str(parms, "bt_swb", value, sizeof(value));
-    if (ret >= 0) {
-        val = atoi(value);
-        adev->swb_speech_mode = val;
+/*
+ * An unexpected rotation fails adev_set_parameters() with -EINVAL, as before
+ * the dispatch table. Returning it stops the dispatch, so keys owned by the
+ * handlers registered after this one are not applied by that call.
+ */
+static int adev_set_rotation(struct audio_device *adev, struct str_parms *parms)
+{
+    bool reverse_speakers = false;
+    int camera_rotation = CAMERA_ROTATION_LANDSCAPE;
+    int val;
+
+    if (str_parms_get_int(parms, "rotation", &val) < 0)
+        return 0;
+
+    switch (val) {
+    // FIXME: note that the code below assumes that the speakers are in the correct placement
+    //   relative to the user when the device is rotated 90deg from its default rotation. This
+    //   assumption is device-specific, not platform-specific like this code.
+    case 270:
+        reverse_speakers = true;
+        camera_rotation = CAMERA_ROTATION_INVERT_LANDSCAPE;
+        break;
+    case 0:
+    case 180:
+        camera_rotation = CAMERA_ROTATION_PORTRAIT;
+        break;
+    case 90:
+        camera_rotation = CAMERA_ROTATION_LANDSCAPE;
+        break;
+    default:
+        ALOGE("%s: unexpected rotation of %d", __func__, val);
+        return -EINVAL;
     }
+    // check and set swap
+    //   - check if orientation changed and speaker active
+    //   - set rotation and cache the rotation value
+    adev->camera_orientation =
+        (adev->camera_orientation & ~CAMERA_ROTATION_MASK) | camera_rotation;
+    if (!audio_extn_is_maxx_audio_enabled())
+        platform_check_and_set_swap_lr_channels(adev, reverse_speakers);
+    return 0;
+}
+
+static int adev_set_device_connection(struct audio_device *adev,
+                                      struct str_parms *parms)
+{
+    char value[32];
+    int val;
+    int ret;
+    int controller = -1, stream = -1;
 
     ret = str_parms_get_str(parms, AUDIO_PARAMETER_DEVICE_CONNECT, value, sizeof(value));
     if (ret >= 0) {
@@ -8952,9 +9493,23 @@ static int adev_set_parameters(struct audio_hw_device *dev, const char *kvpairs)
             }
         }
     }
+    return 0;
+}
 
+static int adev_set_qdsp_parameters(struct audio_device *adev,
+                                    struct str_parms *parms)
+{
     audio_extn_qdsp_set_parameters(adev, parms);
+    return 0;
+}
+
+static int adev_set_a2dp_parameters(struct audio_device *adev,
+                                    struct str_parms *parms)
+{
+    bool a2dp_reconfig = false;
+    int status;
 
+    /* a failure here only means a2dp offload is not supported */
     status = audio_extn_a2dp_set_parameters(parms, &a2dp_reconfig);
     if (status >= 0 && a2dp_reconfig) {
         struct audio_usecase *usecase;
@@ -8964,7 +9519,7 @@ static int adev_set_parameters(struct audio_hw_device *dev, const char *kvpairs)
             if ((usecase->stream.out == NULL) || (usecase->type != PCM_PLAYBACK))
                 continue;
 
-            if (is_a2dp_out_device_type(&usecase->device_list)) {
+            if (device_set_has(&usecase->device_list, DEVICE_SET_A2DP_OUT)) {
                 ALOGD("reconfigure a2dp... forcing device switch");
                 audio_extn_a2dp_set_handoff_mode(true);
                 ALOGD("Switching to speaker and muting the stream before select_devices");
@@ -8979,8 +9534,8 @@ static int adev_set_parameters(struct audio_hw_device *dev, const char *kvpairs)
                 pthread_mutex_lock(&usecase->stream.out->latch_lock);
                 if (usecase->stream.out->a2dp_muted) {
                     pthread_mutex_unlock(&usecase->stream.out->latch_lock);
-                    reassign_device_list(&usecase->stream.out->device_list,
-                                         AUDIO_DEVICE_OUT_BLUETOOTH_A2DP, "");
+                    device_set_reassign(&usecase->stream.out->device_list,
+                                        AUDIO_DEVICE_OUT_BLUETOOTH_A2DP, "");
                     check_a2dp_restore_l(adev, usecase->stream.out, true);
                     break;
                 }
@@ -8988,6 +9543,14 @@ static int adev_set_parameters(struct audio_hw_device *dev, const char *kvpairs)
             }
         }
     }
+    return 0;
+}
+
+static int adev_set_vr_audio_mode(struct audio_device *adev,
+                                  struct str_parms *parms)
+{
+    char value[32];
+    int ret;
 
     //handle vr audio setparam
     ret = str_parms_get_str(parms, AUDIO_PARAMETER_KEY_VR_AUDIO_MODE,
@@ -9004,6 +9567,18 @@ static int adev_set_parameters(struct audio_hw_device *dev, const char *kvpairs)
             ALOGI("wrong vr mode set");
         }
     }
+    return 0;
+}
+
+/*
+ * An invalid camera facing value is logged and ignored: it never failed
+ * adev_set_parameters(), and the keys after it are still applied.
+ */
+static int adev_set_camera_facing(struct audio_device *adev,
+                                  struct str_parms *parms)
+{
+    char value[32];
+    int ret;
 
     //FIXME: to be replaced by proper video capture properties API
     ret = str_parms_get_str(parms, AUDIO_PARAMETER_KEY_CAMERA_FACING, value, sizeof(value));
@@ -9015,7 +9590,7 @@ static int adev_set_parameters(struct audio_hw_device *dev, const char *kvpairs)
             camera_facing = CAMERA_FACING_BACK;
         else {
             ALOGW("%s: invalid camera facing value: %s", __func__, value);
-            goto done;
+            return 0;
         }
         adev->camera_orientation =
                        (adev->camera_orientation & ~CAMERA_FACING_MASK) | camera_facing;
@@ -9030,13 +9605,148 @@ static int adev_set_parameters(struct audio_hw_device *dev, const char *kvpairs)
             }
         }
     }
+    return 0;
+}
 
+static int adev_set_amplifier_parameters(struct audio_device *adev __unused,
+                                         struct str_parms *parms)
+{
     amplifier_set_parameters(parms);
+    return 0;
+}
+
+static int adev_set_extn_parameters(struct audio_device *adev,
+                                    struct str_parms *parms)
+{
     audio_extn_set_parameters(adev, parms);
-done:
-    str_parms_destroy(parms);
-    pthread_mutex_unlock(&adev->lock);
-error:
+    return 0;
+}
+
+/*
+ * Keys read by more than one subsystem. Handlers with an open ended key set
+ * list them so that they still see these keys when they arrive alone.
+ */
+static const char * const shared_param_keys[] = {
+    "SND_CARD_STATUS",
+    "ext_audio_device",
+    AUDIO_PARAMETER_DEVICE_CONNECT,
+    AUDIO_PARAMETER_DEVICE_DISCONNECT,
+    NULL
+};
+
+static const char * const snd_card_status_keys[] = {
+    "SND_CARD_STATUS",
+    "ext_audio_device",
+    NULL
+};
+
+static const char * const bt_sco_keys[] = {
+    "BT_SCO",
+    NULL
+};
+
+static const char * const bt_keys[] = {
+    AUDIO_PARAMETER_KEY_BT_NREC,
+    AUDIO_PARAMETER_KEY_BT_SCO_WB,
+    "bt_swb",
+    NULL
+};
+
+static const char * const screen_state_keys[] = {
+    "screen_state",
+    NULL
+};
+
+static const char * const rotation_keys[] = {
+    "rotation",
+    NULL
+};
+
+static const char * const device_connection_keys[] = {
+    AUDIO_PARAMETER_DEVICE_CONNECT,
+    AUDIO_PARAMETER_DEVICE_DISCONNECT,
+    NULL
+};
+
+static const char * const a2dp_keys[] = {
+    AUDIO_PARAMETER_DEVICE_CONNECT,
+    AUDIO_PARAMETER_DEVICE_DISCONNECT,
+    AUDIO_PARAMETER_RECONFIG_A2DP,
+    "A2dpSuspended",
+    "TwsChannelConfig",
+    "BT_SCO",
+    NULL
+};
+
+static const char * const vr_audio_mode_keys[] = {
+    AUDIO_PARAMETER_KEY_VR_AUDIO_MODE,
+    NULL
+};
+
+static const char * const camera_facing_keys[] = {
+    AUDIO_PARAMETER_KEY_CAMERA_FACING,
+    NULL
+};
+
+/*
+ * Registration order is the order handlers run in, and matches the order
+ * adev_set_parameters() used to probe them.
+ */
+static int adev_register_param_handlers(struct audio_device *adev,
+                                        bool has_amplifier)
+{
+    struct param_router *router = adev->param_router;
+    int ret = 0;
+
+    ret |= param_router_register(router, "snd_card_status", snd_card_status_keys,
+                                 0, adev_set_snd_card_status);
+    ret |= param_router_register(router, "bt_sco", bt_sco_keys,
+                                 PARAM_HANDLER_LOCKED, adev_set_bt_sco);
+    ret |= param_router_register(router, "voice", shared_param_keys,
+                                 PARAM_HANDLER_LOCKED | PARAM_HANDLER_ANY_KEY,
+                                 adev_set_voice_parameters);
+    ret |= param_router_register(router, "platform", shared_param_keys,
+                                 PARAM_HANDLER_LOCKED | PARAM_HANDLER_ANY_KEY,
+                                 adev_set_platform_parameters);
+    ret |= param_router_register(router, "bt", bt_keys,
+                                 PARAM_HANDLER_LOCKED, adev_set_bt_parameters);
+    ret |= param_router_register(router, "screen_state", screen_state_keys,
+                                 PARAM_HANDLER_LOCKED, adev_set_screen_state);
+    ret |= param_router_register(router, "rotation", rotation_keys,
+                                 PARAM_HANDLER_LOCKED, adev_set_rotation);
+    ret |= param_router_register(router, "device_connection", device_connection_keys,
+                                 PARAM_HANDLER_LOCKED, adev_set_device_connection);
+    /* the external qdsp library reads keys of its own */
+    ret |= param_router_register(router, "qdsp", shared_param_keys,
+                                 PARAM_HANDLER_LOCKED | PARAM_HANDLER_ANY_KEY,
+                                 adev_set_qdsp_parameters);
+    /* a2dp lives in a separately built library, keep feeding it unknown keys */
+    ret |= param_router_register(router, "a2dp", a2dp_keys,
+                                 PARAM_HANDLER_LOCKED | PARAM_HANDLER_ANY_KEY,
+                                 adev_set_a2dp_parameters);
+    ret |= param_router_register(router, "vr_audio_mode", vr_audio_mode_keys,
+                                 PARAM_HANDLER_LOCKED, adev_set_vr_audio_mode);
+    ret |= param_router_register(router, "camera_facing", camera_facing_keys,
+                                 PARAM_HANDLER_LOCKED, adev_set_camera_facing);
+    /* the amplifier HAL may act on any key */
+    if (has_amplifier)
+        ret |= param_router_register(router, "amplifier", NULL,
+                                     PARAM_HANDLER_LOCKED | PARAM_HANDLER_ALL_KEYS,
+                                     adev_set_amplifier_parameters);
+    ret |= param_router_register(router, "audio_extn", shared_param_keys,
+                                 PARAM_HANDLER_LOCKED | PARAM_HANDLER_ANY_KEY,
+                                 adev_set_extn_parameters);
+    return ret;
+}
+
+static int adev_set_parameters(struct audio_hw_device *dev, const char *kvpairs)
+{
+    struct audio_device *adev = (struct audio_device *)dev;
+    int status;
+
+    ALOGD("%s: enter: %s", __func__, kvpairs);
+    status = param_router_dispatch(adev->param_router, adev, &adev->lock,
+                                   &adev->lock_stats, kvpairs);
     ALOGV("%s: exit with code(%d)", __func__, status);
     return status;
 }
@@ -9072,9 +9782,9 @@ static char* adev_get_parameters(const struct audio_hw_device *dev,
 
     if (ret >= 0) {
         bool vr_audio_enabled = false;
-        pthread_mutex_lock(&adev->lock);
+        ADEV_LOCK(adev);
         vr_audio_enabled = adev->vr_audio_mode_enabled;
-        pthread_mutex_unlock(&adev->lock);
+        ADEV_UNLOCK(adev);
 
         ALOGI("getting vr mode to %d", vr_audio_enabled);
 
@@ -9089,13 +9799,13 @@ static char* adev_get_parameters(const struct audio_hw_device *dev,
         }
     }
 
-    pthread_mutex_lock(&adev->lock);
+    ADEV_LOCK(adev);
     audio_extn_get_parameters(adev, query, reply);
     voice_get_parameters(adev, query, reply);
     audio_extn_a2dp_get_parameters(query, reply);
     platform_get_parameters(adev->platform, query, reply);
     audio_extn_ma_get_parameters(adev, query, reply);
-    pthread_mutex_unlock(&adev->lock);
+    ADEV_UNLOCK(adev);
 
 exit:
     str = str_parms_to_str(reply);
@@ -9118,10 +9828,10 @@ static int adev_set_voice_volume(struct audio_hw_device *dev, float volume)
 
     audio_extn_extspk_set_voice_vol(adev->extspk, volume);
 
-    pthread_mutex_lock(&adev->lock);
+    ADEV_LOCK(adev);
     /* cache volume */
     ret = voice_set_volume(adev, volume);
-    pthread_mutex_unlock(&adev->lock);
+    ADEV_UNLOCK(adev);
     return ret;
 }
 
@@ -9156,13 +9866,13 @@ static int adev_set_mode(struct audio_hw_device *dev, audio_mode_t mode)
     struct audio_usecase *usecase = NULL;
     int ret = 0;
 
-    pthread_mutex_lock(&adev->lock);
+    ADEV_LOCK(adev);
     if (adev->mode != mode) {
         ALOGD("%s: mode %d , prev_mode %d \n", __func__, mode , adev->mode);
         adev->prev_mode = adev->mode; /* prev_mode is kept to handle voip concurrency*/
         if (amplifier_set_mode(mode) != 0)
             ALOGE("Failed setting amplifier mode");
-        adev->mode = mode;
+        __atomic_store_n(&adev->mode, mode, __ATOMIC_RELEASE);
         if (mode == AUDIO_MODE_CALL_SCREEN) {
             adev->current_call_output = adev->primary_output;
             voice_start_call(adev);
@@ -9197,7 +9907,7 @@ static int adev_set_mode(struct audio_hw_device *dev, audio_mode_t mode)
             }
         }
     }
-    pthread_mutex_unlock(&adev->lock);
+    ADEV_UNLOCK(adev);
     return 0;
 }
 
@@ -9206,7 +9916,7 @@ static int adev_set_mic_mute(struct audio_hw_device *dev, bool state)
     int ret;
     struct audio_device *adev = (struct audio_device *)dev;
 
-    pthread_mutex_lock(&adev->lock);
+    ADEV_LOCK(adev);
     ALOGD("%s state %d\n", __func__, state);
     ret = voice_set_mic_mute((struct audio_device *)dev, state);
 
@@ -9214,7 +9924,7 @@ static int adev_set_mic_mute(struct audio_hw_device *dev, bool state)
         ret = audio_extn_ext_hw_plugin_set_mic_mute(adev->ext_hw_plugin, state);
 
     adev->mic_muted = state;
-    pthread_mutex_unlock(&adev->lock);
+    ADEV_UNLOCK(adev);
 
     return ret;
 }
@@ -9367,12 +10077,12 @@ static int adev_open_input_stream(struct audio_hw_device *dev,
             return -EINVAL;
     }
 
-    pthread_mutex_lock(&adev->lock);
+    ADEV_LOCK(adev);
     if (in_get_stream(adev, handle) != NULL) {
         ALOGW("%s, input stream already opened", __func__);
         ret = -EEXIST;
     }
-    pthread_mutex_unlock(&adev->lock);
+    ADEV_UNLOCK(adev);
     if (ret)
         return ret;
 
@@ -9410,8 +10120,8 @@ static int adev_open_input_stream(struct audio_hw_device *dev,
     in->stream.set_microphone_field_dimension = in_set_microphone_field_dimension;
     in->stream.update_sink_metadata = in_update_sink_metadata;
 
-    list_init(&in->device_list);
-    update_device_list(&in->device_list, devices, address, true);
+    device_set_init(&in->device_list);
+    device_set_update(&in->device_list, devices, address, true);
     in->source = source;
     in->dev = adev;
     in->standby = 1;
@@ -9567,10 +10277,10 @@ static int adev_open_input_stream(struct audio_hw_device *dev,
         default:
             in->bit_width = 16;
         }
-    } else if (is_single_device_type_equal(&in->device_list,
-                                           AUDIO_DEVICE_IN_TELEPHONY_RX) ||
-               is_single_device_type_equal(&in->device_list,
-                                           AUDIO_DEVICE_IN_PROXY)) {
+    } else if (device_set_is_single_type(&in->device_list,
+                                         AUDIO_DEVICE_IN_TELEPHONY_RX) ||
+               device_set_is_single_type(&in->device_list,
+                                         AUDIO_DEVICE_IN_PROXY)) {
         if (config->sample_rate == 0)
             config->sample_rate = AFE_PROXY_SAMPLING_RATE;
         if (config->sample_rate != 48000 && config->sample_rate != 16000 &&
@@ -9589,8 +10299,8 @@ static int adev_open_input_stream(struct audio_hw_device *dev,
 
         in->usecase = USECASE_AUDIO_RECORD_AFE_PROXY;
         if (adev->ha_proxy_enable &&
-            is_single_device_type_equal(&in->device_list,
-                                        AUDIO_DEVICE_IN_TELEPHONY_RX))
+            device_set_is_single_type(&in->device_list,
+                                      AUDIO_DEVICE_IN_TELEPHONY_RX))
             in->usecase = USECASE_AUDIO_RECORD_AFE_PROXY2;
         in->config = pcm_config_afe_proxy_record;
         in->config.rate = config->sample_rate;
@@ -9620,10 +10330,10 @@ static int adev_open_input_stream(struct audio_hw_device *dev,
         in->af_period_multiplier = af_period_multiplier;
     } else {
         int ret_val;
-        pthread_mutex_lock(&adev->lock);
+        ADEV_LOCK(adev);
         ret_val = audio_extn_check_and_set_multichannel_usecase(adev,
                in, config, &channel_mask_updated);
-        pthread_mutex_unlock(&adev->lock);
+        ADEV_UNLOCK(adev);
 
         if (!ret_val) {
            if (channel_mask_updated == true) {
@@ -9680,13 +10390,13 @@ static int adev_open_input_stream(struct audio_hw_device *dev,
                same pcm record use case */
 
             if (in->usecase == USECASE_AUDIO_RECORD) {
-                pthread_mutex_lock(&adev->lock);
+                ADEV_LOCK(adev);
                 if (!(adev->pcm_record_uc_state)) {
                     ALOGV("%s: using USECASE_AUDIO_RECORD",__func__);
                     adev->pcm_record_uc_state = 1;
-                    pthread_mutex_unlock(&adev->lock);
+                    ADEV_UNLOCK(adev);
                 } else {
-                    pthread_mutex_unlock(&adev->lock);
+                    ADEV_UNLOCK(adev);
                     /* Assign compress record use case for second record */
                     in->usecase = USECASE_AUDIO_RECORD_COMPRESS2;
                     in->flags |= AUDIO_INPUT_FLAG_COMPRESS;
@@ -9701,14 +10411,14 @@ static int adev_open_input_stream(struct audio_hw_device *dev,
             }
         }
     }
-    if (audio_extn_ssr_get_stream() != in)
+    if (!audio_extn_ssr_stream_active(in))
         in->config.channels = channel_count;
 
     in->sample_rate  = in->config.rate;
 
     audio_extn_utils_update_stream_input_app_type_cfg(adev->platform,
                                                 &adev->streams_input_cfg_list,
-                                                &in->device_list, flags, in->format,
+                                                &in->device_list.list, flags, in->format,
                                                 in->sample_rate, in->bit_width,
                                                 in->profile, &in->app_type_cfg);
     register_format(in->format, in->supported_formats);
@@ -9725,9 +10435,9 @@ static int adev_open_input_stream(struct audio_hw_device *dev,
 
     lock_input_stream(in);
     audio_extn_snd_mon_register_listener(in, in_snd_mon_cb);
-    pthread_mutex_lock(&adev->lock);
+    ADEV_LOCK(adev);
     in->card_status = adev->card_status;
-    pthread_mutex_unlock(&adev->lock);
+    ADEV_UNLOCK(adev);
     pthread_mutex_unlock(&in->lock);
 
     stream_app_type_cfg_init(&in->app_type_cfg);
@@ -9748,18 +10458,18 @@ static int adev_open_input_stream(struct audio_hw_device *dev,
     }
     in_ctxt->input = in;
 
-    pthread_mutex_lock(&adev->lock);
+    ADEV_LOCK(adev);
     list_add_tail(&adev->active_inputs_list, &in_ctxt->list);
-    pthread_mutex_unlock(&adev->lock);
+    ADEV_UNLOCK(adev);
 
     ALOGV("%s: exit", __func__);
     return ret;
 
 err_open:
     if (in->usecase == USECASE_AUDIO_RECORD) {
-        pthread_mutex_lock(&adev->lock);
+        ADEV_LOCK(adev);
         adev->pcm_record_uc_state = 0;
-        pthread_mutex_unlock(&adev->lock);
+        ADEV_UNLOCK(adev);
     }
     free(in);
     *stream_in = NULL;
@@ -9803,9 +10513,9 @@ static void adev_close_input_stream(struct audio_hw_device *dev,
 
 
     if (in->usecase == USECASE_COMPRESS_VOIP_CALL) {
-        pthread_mutex_lock(&adev->lock);
+        ADEV_LOCK(adev);
         ret = voice_extn_compress_voip_close_input_stream(&stream->common);
-        pthread_mutex_unlock(&adev->lock);
+        ADEV_UNLOCK(adev);
         if (ret != 0)
             ALOGE("%s: Compress voip input cannot be closed, error:%d",
                   __func__, ret);
@@ -9815,7 +10525,7 @@ static void adev_close_input_stream(struct audio_hw_device *dev,
     pthread_mutex_destroy(&in->lock);
     pthread_mutex_destroy(&in->pre_lock);
 
-    pthread_mutex_lock(&adev->lock);
+    ADEV_LOCK(adev);
     if (in->usecase == USECASE_AUDIO_RECORD) {
         adev->pcm_record_uc_state = 0;
     }
@@ -9824,12 +10534,12 @@ static void adev_close_input_stream(struct audio_hw_device *dev,
         adev->enable_voicerx = false;
     }
 
-    if (audio_extn_ssr_get_stream() == in) {
-        audio_extn_ssr_deinit();
+    if (audio_extn_ssr_stream_active(in)) {
+        audio_extn_ssr_deinit(in);
     }
 
-    if (audio_extn_ffv_get_stream() == in) {
-        audio_extn_ffv_stream_deinit();
+    if (audio_extn_ffv_stream_active(in)) {
+        audio_extn_ffv_stream_deinit(in);
     }
 
     if (audio_extn_compr_cap_enabled() &&
@@ -9851,7 +10561,7 @@ static void adev_close_input_stream(struct audio_hw_device *dev,
         ALOGW("%s, input stream already closed", __func__);
     }
     free(stream);
-    pthread_mutex_unlock(&adev->lock);
+    ADEV_UNLOCK(adev);
     return;
 }
 
@@ -9941,22 +10651,23 @@ static int adev_verify_devices(struct audio_device *adev)
             memset(&uc_info, 0, sizeof(uc_info));
             uc_info.id = audio_usecase;
             uc_info.type = usecase_type;
-            list_init(&uc_info.device_list);
+            device_set_init(&uc_info.device_list);
             if (dir) {
                 memset(&in, 0, sizeof(in));
-                list_init(&in.device_list);
-                update_device_list(&in.device_list, audio_device, "", true);
+                device_set_init(&in.device_list);
+                device_set_update(&in.device_list, audio_device, "", true);
                 in.source = AUDIO_SOURCE_VOICE_COMMUNICATION;
                 uc_info.stream.in = &in;
             }
             memset(&out, 0, sizeof(out));
-            list_init(&out.device_list);
-            update_device_list(&out.device_list, audio_device, "", true);
+            device_set_init(&out.device_list);
+            device_set_update(&out.device_list, audio_device, "", true);
             uc_info.stream.out = &out;
-            update_device_list(&uc_info.device_list, audio_device, "", true);
+            device_set_update(&uc_info.device_list, audio_device, "", true);
             uc_info.in_snd_device = SND_DEVICE_NONE;
             uc_info.out_snd_device = SND_DEVICE_NONE;
             list_add_tail(&adev->usecase_list, &uc_info.list);
+            update_active_input(adev);
 
             /* select device - similar to start_(in/out)put_stream() */
             retval = select_devices(adev, audio_usecase);
@@ -9981,6 +10692,7 @@ static int adev_verify_devices(struct audio_device *adev)
             retval = disable_snd_device(adev,
                     dir ? uc_info.in_snd_device : uc_info.out_snd_device);
             list_remove(&uc_info.list);
+            update_active_input(adev);
         }
     }
     return 0;
@@ -10113,7 +10825,7 @@ int adev_create_audio_patch(struct audio_hw_device *dev,
             goto done;
     }
 
-    pthread_mutex_lock(&adev->lock);
+    ADEV_LOCK(adev);
 
     // Generate patch info and update patch
     if (*handle == AUDIO_PATCH_HANDLE_NONE) {
@@ -10122,7 +10834,7 @@ int adev_create_audio_patch(struct audio_hw_device *dev,
                       calloc(1, sizeof(struct audio_patch_info));
         if (p_info == NULL) {
             ALOGE("%s: Failed to allocate memory", __func__);
-            pthread_mutex_unlock(&adev->lock);
+            ADEV_UNLOCK(adev);
             ret = -ENOMEM;
             goto done;
         }
@@ -10132,7 +10844,7 @@ int adev_create_audio_patch(struct audio_hw_device *dev,
         if (p_info == NULL) {
             ALOGE("%s: Unable to fetch patch for received patch handle %d",
                   __func__, *handle);
-            pthread_mutex_unlock(&adev->lock);
+            ADEV_UNLOCK(adev);
             ret = -EINVAL;
             goto done;
         }
@@ -10148,7 +10860,7 @@ int adev_create_audio_patch(struct audio_hw_device *dev,
             ALOGE("%s: Failed to obtain stream info", __func__);
             if (new_patch)
                 free(p_info);
-            pthread_mutex_unlock(&adev->lock);
+            ADEV_UNLOCK(adev);
             ret = -EINVAL;
             goto done;
         }
@@ -10156,7 +10868,7 @@ int adev_create_audio_patch(struct audio_hw_device *dev,
         s_info->patch_handle = *handle;
         stream = s_info->stream;
     }
-    pthread_mutex_unlock(&adev->lock);
+    ADEV_UNLOCK(adev);
 
     // Update routing for stream
     if (stream != NULL) {
@@ -10165,11 +10877,11 @@ int adev_create_audio_patch(struct audio_hw_device *dev,
         else if (p_info->patch_type == PATCH_CAPTURE)
             ret = route_input_stream((struct stream_in *) stream, &devices, input_source);
         if (ret < 0) {
-            pthread_mutex_lock(&adev->lock);
+            ADEV_LOCK(adev);
             s_info->patch_handle = AUDIO_PATCH_HANDLE_NONE;
             if (new_patch)
                 free(p_info);
-            pthread_mutex_unlock(&adev->lock);
+            ADEV_UNLOCK(adev);
             ALOGE("%s: Stream routing failed for io_handle %d", __func__, io_handle);
             goto done;
         }
@@ -10177,10 +10889,10 @@ int adev_create_audio_patch(struct audio_hw_device *dev,
 
     // Add new patch to patch map
     if (!ret && new_patch) {
-        pthread_mutex_lock(&adev->lock);
+        ADEV_LOCK(adev);
         hashmapPut(adev->patch_map, (void *) (intptr_t) *handle, (void *) p_info);
         ALOGD("%s: Added a new patch with handle %d", __func__, *handle);
-        pthread_mutex_unlock(&adev->lock);
+        ADEV_UNLOCK(adev);
     }
 
 done:
@@ -10214,18 +10926,18 @@ int adev_release_audio_patch(struct audio_hw_device *dev,
     }
 
     ALOGD("%s: Remove patch with handle %d", __func__, handle);
-    pthread_mutex_lock(&adev->lock);
+    ADEV_LOCK(adev);
     struct audio_patch_info *p_info = fetch_patch_info_l(adev, handle);
     if (p_info == NULL) {
         ALOGE("%s: Patch info not found with handle %d", __func__, handle);
-        pthread_mutex_unlock(&adev->lock);
+        ADEV_UNLOCK(adev);
         ret = -EINVAL;
         goto done;
     }
     struct audio_patch *patch = p_info->patch;
     if (patch == NULL) {
         ALOGE("%s: Patch not found for handle %d", __func__, handle);
-        pthread_mutex_unlock(&adev->lock);
+        ADEV_UNLOCK(adev);
         ret = -EINVAL;
         goto done;
     }
@@ -10240,7 +10952,7 @@ int adev_release_audio_patch(struct audio_hw_device *dev,
             break;
         case AUDIO_PORT_TYPE_SESSION:
         case AUDIO_PORT_TYPE_NONE:
-            pthread_mutex_unlock(&adev->lock);
+            ADEV_UNLOCK(adev);
             ret = -EINVAL;
             goto done;
     }
@@ -10254,13 +10966,13 @@ int adev_release_audio_patch(struct audio_hw_device *dev,
             hashmapGet(adev->io_streams_map, (void *) (intptr_t) io_handle);
         if (s_info == NULL) {
             ALOGE("%s: stream for io_handle %d is not available", __func__, io_handle);
-            pthread_mutex_unlock(&adev->lock);
+            ADEV_UNLOCK(adev);
             goto done;
         }
         s_info->patch_handle = AUDIO_PATCH_HANDLE_NONE;
         stream = s_info->stream;
     }
-    pthread_mutex_unlock(&adev->lock);
+    ADEV_UNLOCK(adev);
 
     if (stream != NULL) {
         struct listnode devices;
@@ -10301,9 +11013,11 @@ int adev_set_audio_port_config(struct audio_hw_device *dev,
     return ret;
 }
 
-static int adev_dump(const audio_hw_device_t *device __unused,
-                     int fd __unused)
+static int adev_dump(const audio_hw_device_t *device, int fd)
 {
+    struct audio_device *adev = (struct audio_device *)device;
+
+    lock_stats_dump(&adev->lock_stats, &adev->lock, fd);
     return 0;
 }
 
@@ -10358,6 +11072,7 @@ static int adev_close(hw_device_t *device)
         audio_extn_auto_hal_deinit();
         free_map(adev->patch_map);
         free_map(adev->io_streams_map);
+        param_router_destroy(adev->param_router);
         free(device);
         adev = NULL;
     }
@@ -10404,7 +11119,7 @@ static void adev_snd_mon_cb(void *cookie, struct str_parms *parms)
         return;
     }
 
-    pthread_mutex_lock(&adev->lock);
+    ADEV_LOCK(adev);
     if (card == adev->snd_card || is_ext_device_status) {
         if (is_snd_card_status && adev->card_status != status) {
             adev->card_status = status;
@@ -10417,7 +11132,7 @@ static void adev_snd_mon_cb(void *cookie, struct str_parms *parms)
             platform_set_parameters(adev->platform, parms);
         }
     }
-    pthread_mutex_unlock(&adev->lock);
+    ADEV_UNLOCK(adev);
     return;
 }
 
@@ -10443,7 +11158,7 @@ int check_a2dp_restore_l(struct audio_device *adev, struct stream_out *out, bool
     if (restore) {
         pthread_mutex_lock(&out->latch_lock);
         // restore A2DP device for active usecases and unmute if required
-        if (is_a2dp_out_device_type(&out->device_list)) {
+        if (device_set_has(&out->device_list, DEVICE_SET_A2DP_OUT)) {
             ALOGD("%s: restoring A2dp and unmuting stream", __func__);
             if (uc_info->out_snd_device != SND_DEVICE_OUT_BT_A2DP)
                 select_devices(adev, uc_info->id);
@@ -10463,14 +11178,14 @@ int check_a2dp_restore_l(struct audio_device *adev, struct stream_out *out, bool
         pthread_mutex_lock(&out->latch_lock);
         // mute stream and switch to speaker if suspended
         if (!out->a2dp_muted && !out->standby) {
-            assign_devices(&devices, &out->device_list);
-            reassign_device_list(&out->device_list, AUDIO_DEVICE_OUT_SPEAKER, "");
+            assign_devices(&devices, &out->device_list.list);
+            device_set_reassign(&out->device_list, AUDIO_DEVICE_OUT_SPEAKER, "");
             list_for_each(node, &adev->usecase_list) {
                 usecase = node_to_item(node, struct audio_usecase, list);
                 if ((usecase != uc_info) &&
                         platform_check_backends_match(SND_DEVICE_OUT_SPEAKER,
                                                       usecase->out_snd_device)) {
-                    assign_devices(&out->device_list, &usecase->stream.out->device_list);
+                    device_set_assign(&out->device_list, &usecase->stream.out->device_list.list);
                     break;
                 }
             }
@@ -10498,7 +11213,7 @@ int check_a2dp_restore_l(struct audio_device *adev, struct stream_out *out, bool
                 if (out->offload_state == OFFLOAD_STATE_PLAYING)
                     compress_resume(out->compr);
             }
-            assign_devices(&out->device_list, &devices);
+            device_set_assign(&out->device_list, &devices);
         }
         pthread_mutex_unlock(&out->latch_lock);
     }
@@ -10508,11 +11223,11 @@ int check_a2dp_restore_l(struct audio_device *adev, struct stream_out *out, bool
 
 void adev_on_battery_status_changed(bool charging)
 {
-    pthread_mutex_lock(&adev->lock);
+    ADEV_LOCK(adev);
     ALOGI("%s: battery status changed to %scharging", __func__, charging ? "" : "not ");
     adev->is_charging = charging;
     audio_extn_sound_trigger_update_battery_status(charging);
-    pthread_mutex_unlock(&adev->lock);
+    ADEV_UNLOCK(adev);
 }
 
 static int adev_open(const hw_module_t *module, const char *name,
@@ -10522,6 +11237,7 @@ static int adev_open(const hw_module_t *module, const char *name,
     char value[PROPERTY_VALUE_MAX] = {0};
     char mixer_ctl_name[128] = {0};
     struct mixer_ctl *ctl = NULL;
+    bool has_amplifier = false;
 
     ALOGD("%s: enter", __func__);
     if (strcmp(name, AUDIO_HARDWARE_INTERFACE) != 0) return -EINVAL;
@@ -10544,6 +11260,9 @@ static int adev_open(const hw_module_t *module, const char *name,
     }
 
     pthread_mutex_init(&adev->lock, (const pthread_mutexattr_t *) NULL);
+    lock_stats_init(&adev->lock_stats, "audio_device lock",
+                    property_get_bool("vendor.audio.lock_stats.enable", false));
+    adev->proc_budget = property_get_int32(PROC_BUDGET_PROPERTY, PROC_BUDGET_DEFAULT);
 
     // register audio ext hidl at the earliest
     audio_extn_hidl_init();
@@ -10616,6 +11335,12 @@ static int adev_open(const hw_module_t *module, const char *name,
         ret = -ENOMEM;
         goto adev_open_err;
     }
+    adev->param_router = param_router_create();
+    if (!adev->param_router) {
+        ALOGE("%s: Could not create set_parameters router", __func__);
+        ret = -ENOMEM;
+        goto adev_open_err;
+    }
     adev->cur_wfd_channels = 2;
     adev->offload_usecases_state = 0;
     adev->pcm_record_uc_state = 0;
@@ -10756,6 +11481,13 @@ static int adev_open(const hw_module_t *module, const char *name,
 
     if (amplifier_open(adev) != 0)
         ALOGE("Amplifier initialization failed");
+#ifdef EXT_AMPLIFIER_ENABLED
+    else
+        has_amplifier = true;
+#endif
+
+    if (adev_register_param_handlers(adev, has_amplifier) != 0)
+        ALOGE("%s: failed to register set_parameters handlers", __func__);
 
     *device = &adev->device.common;
 
@@ -10816,7 +11548,7 @@ static int adev_open(const hw_module_t *module, const char *name,
     audio_extn_adsp_hdlr_init(adev->mixer);
 
     audio_extn_snd_mon_init();
-    pthread_mutex_lock(&adev->lock);
+    ADEV_LOCK(adev);
     audio_extn_snd_mon_register_listener(adev, adev_snd_mon_cb);
     adev->card_status = CARD_STATUS_ONLINE;
     audio_extn_battery_properties_listener_init(adev_on_battery_status_changed);
@@ -10829,7 +11561,7 @@ static int adev_open(const hw_module_t *module, const char *name,
     audio_extn_sound_trigger_init(adev); /* dependent on snd_mon_init() */
     audio_extn_sound_trigger_update_battery_status(adev->is_charging);
     audio_extn_audiozoom_init();
-    pthread_mutex_unlock(&adev->lock);
+    ADEV_UNLOCK(adev);
     /* Allocate memory for Device config params */
     adev->device_cfg_params = (struct audio_device_config_param*)
                                   calloc(platform_get_max_codec_backend(),
@@ -10857,6 +11589,7 @@ static int adev_open(const hw_module_t *module, const char *name,
     return 0;
 
 adev_open_err:
+    param_router_destroy(adev->param_router);
     free_map(adev->patch_map);
     free_map(adev->io_streams_map);
     free(adev->snd_dev_ref_cnt);
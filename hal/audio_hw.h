@@ -55,6 +55,8 @@
 #include "voice.h"
 #include "audio_hw_extn_api.h"
 #include "device_utils.h"
+#include "param_router.h"
+#include "lock_stats.h"
 
 #if LINUX_ENABLED
 #if defined(__LP64__)
@@ -364,6 +366,23 @@ struct stream_inout {
     void *client_cookie;
 };
 
+struct stream_out;
+
+/*
+ * PCM data path of an output stream. out_update_write_path() derives it from
+ * the stream configuration each time the stream leaves standby, so out_write()
+ * only dispatches through write instead of re-testing the usecase per period.
+ */
+struct stream_out_path {
+    /* bytes is the client write, bytes_to_write what is left after downmix */
+    int (*write)(struct stream_out *out, const void *buffer, size_t bytes,
+                 size_t bytes_to_write);
+    bool downmix_mono;          /* fold 16 bit stereo to mono before writing */
+    bool force_haptic_path;     /* vendor.audio.test_haptic */
+    size_t period_bytes;        /* one period at hal_op_format / pcm config */
+    size_t period_samples;      /* samples converted per period */
+};
+
 struct stream_out {
     struct audio_stream_out stream;
     pthread_mutex_t lock; /* see note below on mutex acquisition order */
@@ -384,7 +403,7 @@ struct stream_out {
     unsigned int sample_rate;
     audio_channel_mask_t channel_mask;
     audio_format_t format;
-    struct listnode device_list;
+    struct audio_device_set device_list;
     audio_output_flags_t flags;
     char profile[MAX_STREAM_PROFILE_STR_LEN];
     audio_usecase_t usecase;
@@ -408,6 +427,20 @@ struct stream_out {
     bool offload_thread_blocked;
     struct timespec writeAt;
 
+    /*
+     * Warm standby: out_standby() stops the PCM but keeps it prepared and
+     * the usecase routed for standby_delay_ms. The standby thread fully
+     * stops the stream if no write arrives before warm_standby_deadline.
+     */
+    uint32_t standby_delay_ms;
+    bool warm_standby;
+    bool standby_thread_exit;
+    struct timespec warm_standby_deadline;
+    pthread_cond_t standby_cond;
+    pthread_t standby_thread;
+    /* set while out_write() routes the stream and opens its PCM unlocked */
+    bool pcm_open_deferred;
+
     void *adsp_hdlr_stream_handle;
     void *ip_hdlr_handle;
 
@@ -422,6 +455,7 @@ struct stream_out {
     audio_format_t hal_ip_format;
     audio_format_t hal_op_format;
     void *convert_buffer;
+    struct stream_out_path write_path;
 
     bool realtime;
     int af_period_multiplier;
@@ -456,8 +490,10 @@ struct stream_out {
     mix_matrix_params_t downmix_params;
     bool set_dual_mono;
     bool prev_card_status_offline;
+    bool perf_hint_held; /* audio_perf profile of the usecase acquired at start */
 
     error_log_t *error_log;
+    struct timespec silence_deadline; /* end of the last silent period after a write error */
     bool pspd_coeff_sent;
 
     int car_audio_stream;
@@ -479,6 +515,7 @@ struct stream_out {
 
     simple_stats_t fifo_underruns;  // TODO: keep a list of the last N fifo underrun times.
     simple_stats_t start_latency_ms;
+    simple_stats_t warm_start_latency_ms;
 };
 
 struct stream_in {
@@ -490,7 +527,7 @@ struct stream_in {
     int standby;
     int source;
     int pcm_device_id;
-    struct listnode device_list;
+    struct audio_device_set device_list;
     audio_channel_mask_t channel_mask;
     audio_usecase_t usecase;
     bool enable_aec;
@@ -507,12 +544,19 @@ struct stream_in {
     char profile[MAX_STREAM_PROFILE_STR_LEN];
     bool is_st_session;
     bool is_st_session_active;
+    void *st_ses_ctx; /* sound trigger session, owned by soundtrigger.c */
+    uint32_t st_ses_gen; /* session list generation st_ses_ctx was resolved at */
     unsigned int sample_rate;
     unsigned int bit_width;
     bool realtime;
     int af_period_multiplier;
     struct stream_app_type_cfg app_type_cfg;
     void *cin_extn;
+    void *ssr_ctx; /* surround record session, owned by ssr.c */
+    void *ffv_ctx; /* far field voice session, owned by ffv.c */
+    /* data path picked by in_select_read_fn() when the stream leaves standby */
+    int (*read_fn)(struct stream_in *in, void *buffer, size_t bytes,
+                   size_t *bytes_read);
     qahwi_stream_in_t qahwi_in;
 
     struct audio_device *dev;
@@ -532,6 +576,7 @@ struct stream_in {
     int64_t frames_muted; /* total frames muted, not cleared when entering standby */
 
     error_log_t *error_log;
+    struct timespec silence_deadline; /* end of the last silent period after a read error */
 
     simple_stats_t start_latency_ms;
 };
@@ -575,7 +620,7 @@ struct audio_usecase {
     struct listnode list;
     audio_usecase_t id;
     usecase_type_t  type;
-    struct listnode device_list;
+    struct audio_device_set device_list;
     snd_device_t out_snd_device;
     snd_device_t in_snd_device;
     struct stream_app_type_cfg out_app_type_cfg;
@@ -605,6 +650,7 @@ struct streams_io_cfg {
     struct listnode format_list;
     struct listnode sample_rate_list;
     struct stream_app_type_cfg app_type_cfg;
+    uint32_t standby_delay_ms;  /* outputs only, 0 disables warm standby */
 };
 
 typedef struct streams_input_ctxt {
@@ -636,6 +682,7 @@ struct audio_device {
     struct audio_hw_device device;
 
     pthread_mutex_t lock; /* see note below on mutex acquisition order */
+    struct lock_stats lock_stats; /* contention of lock, see ADEV_LOCK() */
     pthread_mutex_t cal_lock;
     struct mixer *mixer;
     audio_mode_t mode;
@@ -749,8 +796,44 @@ struct audio_device {
     bool ha_proxy_enable;
 
     amplifier_device_t *amp;
+    struct param_router *param_router;
+    /* last started input, published for adev_get_active_input() */
+    struct stream_in *active_input;
+    /* usecase route changes staged by route_txn_begin(), see audio_hw.c */
+    int route_txn_depth;
+    bool route_txn_pending;
+    /* host capture processing budget and load, see adev_proc_budget_acquire() */
+    int proc_budget;
+    int proc_load;
 };
 
+/*
+ * Host side capture processing (SSR, FFV) runs one session per stream. Each
+ * session charges an estimated cost, in per-mille of one CPU, against
+ * adev->proc_budget when it is created and refunds it when destroyed; a
+ * session that does not fit is refused and the stream records unprocessed.
+ * Inline so that the processing modules built as separate libraries can use it.
+ */
+#define PROC_BUDGET_PROPERTY "vendor.audio.capture_proc_budget"
+#define PROC_BUDGET_DEFAULT 1000
+
+static inline bool adev_proc_budget_acquire(struct audio_device *adev, int cost)
+{
+    int load = __atomic_load_n(&adev->proc_load, __ATOMIC_RELAXED);
+
+    do {
+        if (cost > adev->proc_budget - load)
+            return false;
+    } while (!__atomic_compare_exchange_n(&adev->proc_load, &load, load + cost,
+                                          false, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    return true;
+}
+
+static inline void adev_proc_budget_release(struct audio_device *adev, int cost)
+{
+    __atomic_fetch_sub(&adev->proc_load, cost, __ATOMIC_RELAXED);
+}
+
 struct audio_patch_record {
     struct listnode list;
     audio_patch_handle_t handle;
@@ -849,7 +932,36 @@ audio_patch_handle_t generate_patch_handle();
 /*
  * NOTE: when multiple mutexes have to be acquired, always take the
  * stream_in or stream_out mutex first, followed by the audio_device mutex.
+ *
+ * The complete order, outermost first:
+ *   1. stream pre_lock (stream_out, stream_in)
+ *   2. stream lock
+ *   3. audio_device lock, guarding mode, the usecase list, snd_dev_ref_cnt,
+ *      routing and voice state
+ *   4. stream_out latch_lock, position_query_lock and audio_device cal_lock,
+ *      which are leaf locks and never held across another acquisition
+ *
+ * Read-mostly state is also published for lock-free readers: voice in-call
+ * state and mode (voice_is_in_call()) and the active input
+ * (adev_get_active_input()). Writers still hold the audio_device lock; a
+ * lock-free reader gets a consistent value but must hold the lock before
+ * dereferencing a returned stream.
+ *
+ * Always take the audio_device lock with ADEV_LOCK()/ADEV_UNLOCK(), also in
+ * the audio_extn feature libraries (they build lock_stats.c in), so its
+ * contention is accounted per call site when vendor.audio.lock_stats.enable
+ * is set; the report is part of the HAL dump.
+ *
+ * Leaving standby, out_write() holds the audio_device lock only to add the
+ * usecase and route it. The PCM open and prepare, which set up the DSP
+ * session, run under the stream lock alone (see out_can_defer_pcm_open()),
+ * and a stream resuming from warm standby does not take the lock at all.
+ * The routing itself still runs under the one lock: select_devices(),
+ * enable/disable_snd_device() and the hooks they call read and update the
+ * usecase list, snd_dev_ref_cnt and voice state together.
  */
+#define ADEV_LOCK(adev) LOCK_STATS_LOCK(&(adev)->lock_stats, &(adev)->lock)
+#define ADEV_UNLOCK(adev) lock_stats_unlock(&(adev)->lock_stats, &(adev)->lock)
 
 static inline audio_format_t pcm_format_to_audio_format(const enum pcm_format format)
 {
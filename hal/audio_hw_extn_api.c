@@ -54,6 +54,8 @@
 #ifndef COMPRESSED_TIMESTAMP_FLAG
 #define COMPRESSED_TIMESTAMP_FLAG 0
 struct snd_codec_metadata {
+uint32_t length;
+uint32_t offset;
 uint64_t timestamp;
 };
 #endif
@@ -65,6 +67,13 @@ static void lock_output_stream(struct stream_out *out)
     pthread_mutex_unlock(&out->pre_lock);
 }
 
+static void lock_input_stream(struct stream_in *in)
+{
+    pthread_mutex_lock(&in->pre_lock);
+    pthread_mutex_lock(&in->lock);
+    pthread_mutex_unlock(&in->pre_lock);
+}
+
 /* API to send playback stream specific config parameters */
 int qahwi_out_set_param_data(struct audio_stream_out *stream,
                              audio_extn_param_id param_id,
@@ -117,6 +126,28 @@ int qahwi_out_get_param_data(struct audio_stream_out *stream,
     return ret;
 }
 
+/* API to get capture stream specific config parameters */
+int qahwi_in_get_param_data(struct audio_stream_in *stream,
+                            audio_extn_param_id param_id,
+                            audio_extn_param_payload *payload)
+{
+    int ret;
+    struct stream_in *in = (struct stream_in *)stream;
+
+    if (in == NULL || payload == NULL) {
+        ALOGE("%s::INVALID PARAM\n", __func__);
+        return -EINVAL;
+    }
+
+    lock_input_stream(in);
+    ret = audio_extn_in_get_param_data(in, param_id, payload);
+    if (ret)
+        ALOGE("%s::audio_extn_in_get_param_data failed error %d", __func__, ret);
+    pthread_mutex_unlock(&in->lock);
+
+    return ret;
+}
+
 int qahwi_get_param_data(const struct audio_hw_device *adev,
                          audio_extn_param_id param_id,
                          audio_extn_param_payload *payload)
@@ -199,7 +230,7 @@ int qahwi_in_stop(struct audio_stream_in* stream) {
 
     ALOGD("%s processing, in %p", __func__, in);
 
-    pthread_mutex_lock(&adev->lock);
+    ADEV_LOCK(adev);
 
     if (!in->standby) {
         if (in->pcm != NULL ) {
@@ -213,7 +244,7 @@ int qahwi_in_stop(struct audio_stream_in* stream) {
             ALOGI("%s: capture_stopped bit set", __func__);
     }
 
-    pthread_mutex_unlock(&adev->lock);
+    ADEV_UNLOCK(adev);
 
     return 0;
 }
@@ -16,7 +16,14 @@
 
 #define LOG_TAG "audio_hw_primary"
 
+#include <chrono>
+#include <cerrno>
 #include <cinttypes>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <pthread.h>
+#include <string.h>
 
 #include <utils/Log.h>
 #include <utils/Mutex.h>
@@ -99,18 +106,236 @@ static bool powerHint(PowerHint hint, int32_t data) {
     return ret.isOk();
 }
 
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int kNumHints = 2;
+constexpr PowerHint kHints[kNumHints] = {
+    PowerHint::AUDIO_STREAMING,     // AUDIO_PERF_HINT_STREAMING
+    PowerHint::AUDIO_LOW_LATENCY,   // AUDIO_PERF_HINT_LOW_LATENCY
+};
+constexpr const char *kHintNames[kNumHints] = { "streaming", "low_latency" };
+
+struct HintProfile {
+    const char *name;
+    uint32_t hints;
+    uint32_t releaseMs;
+};
+
+// Indexed by audio_perf_profile_t. VOIP, offload and voice hold no hint
+// unless the platform info XML gives them one.
+HintProfile gProfiles[AUDIO_PERF_PROFILE_MAX] = {
+    { "stream_start", AUDIO_PERF_HINT_STREAMING, 50 },
+    { "mmap", AUDIO_PERF_HINT_LOW_LATENCY, 200 },
+    { "voip", 0, 0 },
+    { "ull", AUDIO_PERF_HINT_LOW_LATENCY, 200 },
+    { "offload", 0, 0 },
+    { "voice", 0, 0 },
+};
+
+struct HintState {
+    bool target;            // state the dispatch thread moves to
+    bool sent;              // state last sent to the PowerHAL
+    bool releasePending;
+    Clock::time_point releaseAt;
+};
+
+struct HintEngine {
+    std::mutex lock;    // never held across a PowerHAL call
+    std::condition_variable cond;
+    int profileRefs[AUDIO_PERF_PROFILE_MAX];
+    HintState state[kNumHints];
+};
+
+std::once_flag gHintThreadOnce;
+
+// Never destroyed, the dispatch thread may still wait on it at exit
+HintEngine &hintEngine() {
+    static HintEngine *engine = new HintEngine();
+    return *engine;
+}
+
+bool isHintWanted(HintEngine &engine, int hint) {
+    for (int p = 0; p < AUDIO_PERF_PROFILE_MAX; p++) {
+        if (engine.profileRefs[p] > 0 && (gProfiles[p].hints & (1 << hint)))
+            return true;
+    }
+    return false;
+}
+
+// Sends target changes and expires pending releases. Quick release and
+// acquire sequences collapse, since only the state differing from what was
+// last sent goes out.
+void hintThreadLoop() {
+    HintEngine &engine = hintEngine();
+    pthread_setname_np(pthread_self(), "audio_perf_hint");
+
+    std::unique_lock<std::mutex> lock(engine.lock);
+    for (;;) {
+        Clock::time_point now = Clock::now();
+        Clock::time_point wakeAt = Clock::time_point::max();
+        int hint;
+
+        for (hint = 0; hint < kNumHints; hint++) {
+            HintState &state = engine.state[hint];
+            if (!state.releasePending)
+                continue;
+            if (now >= state.releaseAt) {
+                state.releasePending = false;
+                state.target = false;
+            } else if (state.releaseAt < wakeAt) {
+                wakeAt = state.releaseAt;
+            }
+        }
+
+        for (hint = 0; hint < kNumHints; hint++) {
+            if (engine.state[hint].target != engine.state[hint].sent)
+                break;
+        }
+        if (hint < kNumHints) {
+            bool on = engine.state[hint].target;
+            engine.state[hint].sent = on;
+            lock.unlock();
+            ALOGV("%s: %s hint %s", __func__, kHintNames[hint], on ? "on" : "off");
+            powerHint(kHints[hint], on ? 1 : 0);
+            lock.lock();
+            continue;
+        }
+
+        if (wakeAt == Clock::time_point::max())
+            engine.cond.wait(lock);
+        else
+            engine.cond.wait_until(lock, wakeAt);
+    }
+}
+
+void startHintThread() {
+    std::call_once(gHintThreadOnce, [] {
+        std::thread(hintThreadLoop).detach();
+    });
+}
+
+bool isValidProfile(audio_perf_profile_t profile) {
+    return profile >= 0 && profile < AUDIO_PERF_PROFILE_MAX;
+}
+
+} // namespace
+
+int audio_perf_hint_acquire(audio_perf_profile_t profile) {
+    if (!isValidProfile(profile))
+        return -EINVAL;
+
+    startHintThread();
+
+    HintEngine &engine = hintEngine();
+    std::lock_guard<std::mutex> lock(engine.lock);
+    engine.profileRefs[profile]++;
+    for (int hint = 0; hint < kNumHints; hint++) {
+        if (!(gProfiles[profile].hints & (1 << hint)))
+            continue;
+        HintState &state = engine.state[hint];
+        state.releasePending = false;
+        if (!state.target) {
+            state.target = true;
+            engine.cond.notify_one();
+        }
+    }
+    return 0;
+}
+
+int audio_perf_hint_release(audio_perf_profile_t profile) {
+    if (!isValidProfile(profile))
+        return -EINVAL;
+
+    HintEngine &engine = hintEngine();
+    std::lock_guard<std::mutex> lock(engine.lock);
+    if (engine.profileRefs[profile] <= 0) {
+        ALOGW("%s: %s released without a request", __func__, gProfiles[profile].name);
+        return -EINVAL;
+    }
+    engine.profileRefs[profile]--;
+    for (int hint = 0; hint < kNumHints; hint++) {
+        if (!(gProfiles[profile].hints & (1 << hint)) || isHintWanted(engine, hint))
+            continue;
+        HintState &state = engine.state[hint];
+        if (gProfiles[profile].releaseMs == 0) {
+            state.releasePending = false;
+            state.target = false;
+        } else {
+            state.releasePending = true;
+            state.releaseAt = Clock::now() +
+                    std::chrono::milliseconds(gProfiles[profile].releaseMs);
+        }
+        engine.cond.notify_one();
+    }
+    return 0;
+}
+
+int audio_perf_get_profile_index(const char *name) {
+    for (int p = 0; p < AUDIO_PERF_PROFILE_MAX; p++) {
+        if (!strcmp(name, gProfiles[p].name))
+            return p;
+    }
+    return -EINVAL;
+}
+
+// Parses a '|' separated hint list such as "streaming|low_latency"
+int audio_perf_get_hint_mask(const char *hints) {
+    int mask = 0;
+    const char *start = hints;
+
+    while (*start) {
+        const char *end = strchr(start, '|');
+        size_t len = end ? (size_t)(end - start) : strlen(start);
+        int hint;
+
+        for (hint = 0; hint < kNumHints; hint++) {
+            if (strlen(kHintNames[hint]) == len &&
+                !strncmp(start, kHintNames[hint], len))
+                break;
+        }
+        if (hint == kNumHints && len != 0)
+            return -EINVAL;
+        if (hint < kNumHints)
+            mask |= 1 << hint;
+        if (!end)
+            break;
+        start = end + 1;
+    }
+    return mask;
+}
+
+int audio_perf_set_hint_profile(audio_perf_profile_t profile, uint32_t hints,
+                                uint32_t release_ms) {
+    if (!isValidProfile(profile) || (hints & ~((1u << kNumHints) - 1)))
+        return -EINVAL;
+
+    HintEngine &engine = hintEngine();
+    std::lock_guard<std::mutex> lock(engine.lock);
+    if (engine.profileRefs[profile] > 0) {
+        ALOGE("%s: %s is in use", __func__, gProfiles[profile].name);
+        return -EBUSY;
+    }
+    gProfiles[profile].hints = hints;
+    gProfiles[profile].releaseMs = release_ms;
+    ALOGD("%s: %s hints 0x%x release %u ms", __func__, gProfiles[profile].name,
+          hints, release_ms);
+    return 0;
+}
+
 int audio_streaming_hint_start() {
-    return powerHint(PowerHint::AUDIO_STREAMING, 1);
+    return audio_perf_hint_acquire(AUDIO_PERF_PROFILE_STREAM_START);
 }
 
 int audio_streaming_hint_end() {
-    return powerHint(PowerHint::AUDIO_STREAMING, 0);
+    return audio_perf_hint_release(AUDIO_PERF_PROFILE_STREAM_START);
 }
 
 int audio_low_latency_hint_start() {
-    return powerHint(PowerHint::AUDIO_LOW_LATENCY, 1);
+    return audio_perf_hint_acquire(AUDIO_PERF_PROFILE_ULL);
 }
 
 int audio_low_latency_hint_end() {
-    return powerHint(PowerHint::AUDIO_LOW_LATENCY, 0);
+    return audio_perf_hint_release(AUDIO_PERF_PROFILE_ULL);
 }
@@ -17,10 +17,44 @@
 #ifndef __QAUDIOPERF_H__
 #define __QAUDIOPERF_H__
 
+#include <stdint.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/* PowerHAL hints a profile can request */
+#define AUDIO_PERF_HINT_STREAMING   (1 << 0)
+#define AUDIO_PERF_HINT_LOW_LATENCY (1 << 1)
+
+/*
+ * Usecase classes holding hints. Each profile has a set of hints and a
+ * release delay; the defaults can be changed from the platform info XML.
+ */
+typedef enum {
+    AUDIO_PERF_PROFILE_STREAM_START,
+    AUDIO_PERF_PROFILE_MMAP,
+    AUDIO_PERF_PROFILE_VOIP,
+    AUDIO_PERF_PROFILE_ULL,
+    AUDIO_PERF_PROFILE_OFFLOAD,
+    AUDIO_PERF_PROFILE_VOICE,
+    AUDIO_PERF_PROFILE_MAX,
+} audio_perf_profile_t;
+
+/*
+ * Requests are refcounted per profile. A hint is on while any profile
+ * holding it has a request, and goes off once the release delay of the
+ * last released profile expires without a new request. Hints are sent to
+ * the PowerHAL from a separate thread, so these calls never block on it.
+ */
+int audio_perf_hint_acquire(audio_perf_profile_t profile);
+int audio_perf_hint_release(audio_perf_profile_t profile);
+
+int audio_perf_get_profile_index(const char *name);
+int audio_perf_get_hint_mask(const char *hints);
+int audio_perf_set_hint_profile(audio_perf_profile_t profile, uint32_t hints,
+                                uint32_t release_ms);
+
 int audio_streaming_hint_start();
 int audio_streaming_hint_end();
 
@@ -1033,6 +1033,8 @@ static int msm_device_to_be_id_external_codec [][NO_COLS] = {
 #define LOW_LATENCY_PLATFORM_DELAY (13*1000LL)
 #define ULL_PLATFORM_DELAY (6*1000LL)
 #define MMAP_PLATFORM_DELAY (3*1000LL)
+#define TRANSCODE_LOOPBACK_PLATFORM_DELAY (13*1000LL)
+#define TRANSCODE_LOOPBACK_LL_PLATFORM_DELAY (3*1000LL)
 
 static int audio_source_delay_ms[AUDIO_SOURCE_CNT] = {0};
 
@@ -4956,8 +4958,8 @@ snd_device_t platform_get_input_snd_device(void *platform,
             if(my_data->fluence_in_audio_rec) {
                 if ((my_data->fluence_type & FLUENCE_HEX_MIC) &&
                     (my_data->source_mic_type & SOURCE_HEX_MIC) &&
-                    (audio_extn_ffv_get_stream() == in)) {
-                    snd_device = audio_extn_ffv_get_capture_snd_device();
+                    audio_extn_ffv_stream_active(in)) {
+                    snd_device = audio_extn_ffv_get_capture_snd_device(in);
                 } else if ((my_data->fluence_type & FLUENCE_QUAD_MIC) &&
                     (my_data->source_mic_type & SOURCE_QUAD_MIC)) {
                     snd_device = SND_DEVICE_IN_HANDSET_QMIC;
@@ -4978,7 +4980,7 @@ snd_device_t platform_get_input_snd_device(void *platform,
         goto exit;
     }
 
-    if (in && (audio_extn_ssr_get_stream() == in))
+    if (in && audio_extn_ssr_stream_active(in))
         snd_device = SND_DEVICE_IN_THREE_MIC;
 
     if (snd_device != SND_DEVICE_NONE) {
@@ -4989,7 +4991,7 @@ snd_device_t platform_get_input_snd_device(void *platform,
             !(in_device & AUDIO_DEVICE_IN_VOICE_CALL) &&
             !(in_device & AUDIO_DEVICE_IN_COMMUNICATION)) {
         if (in_device & AUDIO_DEVICE_IN_BUILTIN_MIC) {
-            if (in && (audio_extn_ssr_get_stream() == in))
+            if (in && audio_extn_ssr_stream_active(in))
                 snd_device = SND_DEVICE_IN_QUAD_MIC;
             else if ((my_data->fluence_type & (FLUENCE_DUAL_MIC | FLUENCE_TRI_MIC | FLUENCE_QUAD_MIC)) &&
                     (channel_count == 2) && (my_data->source_mic_type & SOURCE_DUAL_MIC))
@@ -5124,26 +5126,17 @@ int platform_set_hdmi_channels(void *platform,  int channel_count)
 
 int platform_edid_get_max_channels(void *platform)
 {
-    int channel_count;
     int max_channels = 2;
-    int i = 0, ret = 0;
+    int ret = 0;
     struct platform_data *my_data = (struct platform_data *)platform;
     edid_audio_info *info = NULL;
     ret = platform_get_edid_info(platform);
     info = (edid_audio_info *)my_data->edid_info;
 
     if(ret == 0 && info != NULL) {
-        for (i = 0; i < info->audio_blocks && i < MAX_EDID_BLOCKS; i++) {
-            ALOGV("%s:format %d channel %d", __func__,
-                   info->audio_blocks_array[i].format_id,
-                   info->audio_blocks_array[i].channels);
-            if (info->audio_blocks_array[i].format_id == LPCM) {
-                channel_count = info->audio_blocks_array[i].channels;
-                if (channel_count > max_channels) {
-                   max_channels = channel_count;
-                }
-            }
-        }
+        ALOGV("%s: lpcm max channels %d", __func__, info->lpcm_max_channels);
+        if (info->lpcm_max_channels > max_channels)
+            max_channels = info->lpcm_max_channels;
     }
 
     return max_channels;
@@ -5866,6 +5859,12 @@ int64_t platform_capture_latency(struct stream_in *in)
     return delay;
 }
 
+int64_t platform_transcode_loopback_latency(bool low_latency)
+{
+    return low_latency ? TRANSCODE_LOOPBACK_LL_PLATFORM_DELAY :
+                         TRANSCODE_LOOPBACK_PLATFORM_DELAY;
+}
+
 int platform_update_usecase_from_source(int source, int usecase)
 {
     ALOGV("%s: input source :%d", __func__, source);
@@ -7596,7 +7595,7 @@ bool platform_is_edid_supported_format(void *platform, int format)
 {
     struct platform_data *my_data = (struct platform_data *)platform;
     edid_audio_info *info = NULL;
-    int i, ret;
+    int ret;
     unsigned char format_id = platform_map_to_edid_format(format);
 
     if (format == AUDIO_FORMAT_IEC61937)
@@ -7610,17 +7609,15 @@ bool platform_is_edid_supported_format(void *platform, int format)
     ret = platform_get_edid_info(platform);
     info = (edid_audio_info *)my_data->edid_info;
     if (ret == 0 && info != NULL) {
-        for (i = 0; i < info->audio_blocks && i < MAX_EDID_BLOCKS; i++) {
-             /*
-              * To check
-              *  is there any special for CONFIG_HDMI_PASSTHROUGH_CONVERT
-              *  & DOLBY_DIGITAL_PLUS
-              */
-            if (info->audio_blocks_array[i].format_id == format_id) {
-                ALOGV("%s:returns true %x",
-                      __func__, format);
-                return true;
-            }
+        /*
+         * To check
+         *  is there any special for CONFIG_HDMI_PASSTHROUGH_CONVERT
+         *  & DOLBY_DIGITAL_PLUS
+         */
+        if (info->format_mask & BIT(format_id)) {
+            ALOGV("%s:returns true %x",
+                  __func__, format);
+            return true;
         }
     }
     ALOGV("%s:returns false %x",
@@ -40,6 +40,7 @@
 #include <platform_api.h>
 #include <pthread.h>
 #include <unistd.h>
+#include <time.h>
 #include "platform.h"
 #include "audio_extn.h"
 #include "acdb.h"
@@ -170,6 +171,7 @@
 #define AUDIO_PARAMETER_KEY_DP_CHANNEL_MASK "dp_channel_mask"
 #define AUDIO_PARAMETER_KEY_SPKR_DEVICE_CHMAP "spkr_device_chmap"
 #define AUDIO_PARAMETER_KEY_HFP_ZONE "hfp_zone"
+#define AUDIO_PARAMETER_KEY_CAL_CACHE_STATS "acdb_cal_cache_stats"
 
 #define EVENT_EXTERNAL_SPK_1 "qc_ext_spk_1"
 #define EVENT_EXTERNAL_SPK_2 "qc_ext_spk_2"
@@ -357,6 +359,7 @@ struct platform_data {
         int type;
     } ext_disp[MAX_CONTROLLERS][MAX_STREAMS_PER_CONTROLLER];
     char ec_ref_mixer_path[MIXER_PATH_MAX_LENGTH];
+    struct acdb_cal_cache cal_cache;
     codec_backend_cfg_t current_backend_cfg[MAX_CODEC_BACKENDS];
     char codec_version[CODEC_VERSION_MAX_LENGTH];
     char codec_variant[CODEC_VARIANT_MAX_LENGTH];
@@ -1621,6 +1624,8 @@ static int msm_be_id_array_len  =
 #define LOW_LATENCY_PLATFORM_DELAY (13*1000LL)
 #define ULL_PLATFORM_DELAY         (3*1000LL)
 #define MMAP_PLATFORM_DELAY        (3*1000LL)
+#define TRANSCODE_LOOPBACK_PLATFORM_DELAY    (13*1000LL)
+#define TRANSCODE_LOOPBACK_LL_PLATFORM_DELAY (3*1000LL)
 
 static int audio_source_delay_ms[AUDIO_SOURCE_CNT] = {0};
 
@@ -1935,6 +1940,8 @@ bool platform_send_gain_dep_cal(void *platform, int level) {
         return ret_val;
     }
 
+    acdb_cal_cache_invalidate(&my_data->cal_cache);
+
     if (!voice_is_in_call(adev)) {
         ALOGV("%s: Not Voice call usecase, apply new cal for level %d",
                __func__, level);
@@ -3180,6 +3187,7 @@ void *platform_init(struct audio_device *adev)
     my_data->is_slimbus_interface = true;
     my_data->is_internal_codec = false;
     my_data->is_default_be_config = false;
+    acdb_cal_cache_init(&my_data->cal_cache);
 
     my_data->hw_info = hw_info_init(snd_card_name);
     if (!my_data->hw_info) {
@@ -4371,6 +4379,9 @@ void platform_snd_card_update(void *platform, card_status_t card_status)
 {
     struct platform_data *my_data = (struct platform_data *)platform;
 
+    /* DSP calibration does not survive SSR */
+    acdb_cal_cache_invalidate(&my_data->cal_cache);
+
     if (card_status == CARD_STATUS_ONLINE) {
         if (!platform_is_acdb_initialized(my_data)) {
             if(platform_acdb_init(my_data))
@@ -5210,16 +5221,16 @@ int native_audio_set_params(struct platform_data *platform,
                  usecase = node_to_item(node, struct audio_usecase, list);
 
                  if (usecase->stream.out && is_offload_usecase(usecase->id) &&
-                     (compare_device_type(&usecase->stream.out->device_list,
+                     (device_set_has_type(&usecase->stream.out->device_list,
                                         AUDIO_DEVICE_OUT_WIRED_HEADPHONE) ||
-                     compare_device_type(&usecase->stream.out->device_list,
+                     device_set_has_type(&usecase->stream.out->device_list,
                                          AUDIO_DEVICE_OUT_WIRED_HEADSET)) &&
                      OUTPUT_SAMPLING_RATE_44100 == usecase->stream.out->sample_rate) {
                          ALOGD("%s:napb: triggering dynamic device switch for usecase %d, %s"
                                " stream %p, device (%u)", __func__, usecase->id,
                                use_case_table[usecase->id],
                                (void*) usecase->stream.out,
-                               get_device_types(&usecase->stream.out->device_list));
+                               device_set_types(&usecase->stream.out->device_list));
                          select_devices(platform->adev, usecase->id);
                  }
             }
@@ -5337,6 +5348,14 @@ int platform_get_backend_index(snd_device_t snd_device)
     return port;
 }
 
+static uint64_t platform_get_time_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
 int platform_send_audio_calibration(void *platform, struct audio_usecase *usecase,
                                     int app_type)
 {
@@ -5350,11 +5369,13 @@ int platform_send_audio_calibration(void *platform, struct audio_usecase *usecas
     int sample_rate = DEFAULT_OUTPUT_SAMPLING_RATE;
     struct audio_backend_cfg backend_cfg = {0};
     bool is_bus_dev_usecase = false;
+    struct acdb_cal_state cal;
+    uint64_t send_us;
 
     if (voice_is_in_call_or_call_screen(my_data->adev))
         is_incall_rec_usecase = voice_is_in_call_rec_stream(usecase->stream.in);
 
-    if (compare_device_type(&usecase->device_list, AUDIO_DEVICE_OUT_BUS))
+    if (device_set_has_type(&usecase->device_list, AUDIO_DEVICE_OUT_BUS))
         is_bus_dev_usecase = true;
 
     if (usecase->type == PCM_PLAYBACK)
@@ -5437,7 +5458,7 @@ int platform_send_audio_calibration(void *platform, struct audio_usecase *usecas
         /* Notify device change info to effect clients registered */
         if (usecase->type == PCM_PLAYBACK) {
             audio_extn_gef_notify_device_config(
-                    &usecase->stream.out->device_list,
+                    &usecase->stream.out->device_list.list,
                     usecase->stream.out->channel_mask,
                     sample_rate,
                     acdb_dev_id,
@@ -5452,6 +5473,22 @@ int platform_send_audio_calibration(void *platform, struct audio_usecase *usecas
         else
             acdb_dev_type = ACDB_DEV_TYPE_IN;
 
+        memset(&cal, 0, sizeof(cal));
+        cal.acdb_dev_id = acdb_dev_id;
+        cal.app_type = app_type;
+        cal.sample_rate = sample_rate;
+        cal.path = i;
+        cal.backend_sample_rate = backend_cfg.sample_rate;
+        cal.backend_bit_width = backend_cfg.bit_width;
+        if (acdb_cal_cache_is_sent(&my_data->cal_cache, &cal, acdb_dev_type)) {
+            ALOGV("%s: calibration for acdb_id(%d) already sent", __func__,
+                  acdb_dev_id);
+            acdb_cal_cache_update(&my_data->cal_cache, &cal, acdb_dev_type,
+                                  true, 0);
+            continue;
+        }
+
+        send_us = platform_get_time_us();
         if (my_data->acdb_send_audio_cal_v4) {
             my_data->acdb_send_audio_cal_v4(acdb_dev_id, acdb_dev_type,
                                             app_type, sample_rate, i,
@@ -5463,6 +5500,8 @@ int platform_send_audio_calibration(void *platform, struct audio_usecase *usecas
             my_data->acdb_send_audio_cal(acdb_dev_id, acdb_dev_type, app_type,
                                          sample_rate);
         }
+        acdb_cal_cache_update(&my_data->cal_cache, &cal, acdb_dev_type, false,
+                              platform_get_time_us() - send_us);
     }
 
     return 0;
@@ -6306,7 +6345,7 @@ snd_device_t platform_get_output_snd_device(void *platform, struct stream_out *o
     int stream = -1;
 
     list_init(&devices);
-    assign_devices(&devices, &out->device_list);
+    assign_devices(&devices, &out->device_list.list);
 
     ALOGV("%s: enter: output devices(%#x)", __func__, get_device_types(&devices));
     if (list_empty(&devices) ||
@@ -7012,7 +7051,7 @@ snd_device_t platform_get_input_snd_device(void *platform,
     audio_source_t source = (in == NULL) ? AUDIO_SOURCE_DEFAULT : in->source;
     list_init(&in_devices);
     if (in != NULL)
-        assign_devices(&in_devices, &in->device_list);
+        assign_devices(&in_devices, &in->device_list.list);
     audio_channel_mask_t channel_mask = (in == NULL) ? AUDIO_CHANNEL_IN_MONO : in->channel_mask;
     int channel_count = audio_channel_count_from_in_mask(channel_mask);
     int str_bitwidth = (in == NULL) ? CODEC_BACKEND_DEFAULT_BIT_WIDTH : in->bit_width;
@@ -7451,7 +7490,7 @@ snd_device_t platform_get_input_snd_device(void *platform,
         goto exit;
     }
 
-    if (in && (audio_extn_ssr_get_stream() == in))
+    if (in && audio_extn_ssr_stream_active(in))
         snd_device = SND_DEVICE_IN_THREE_MIC;
 
     if (snd_device != SND_DEVICE_NONE) {
@@ -7462,7 +7501,7 @@ snd_device_t platform_get_input_snd_device(void *platform,
             !(compare_device_type(&in_devices, AUDIO_DEVICE_IN_VOICE_CALL)) &&
             !(compare_device_type(&in_devices, AUDIO_DEVICE_IN_COMMUNICATION))) {
         if (compare_device_type(&in_devices, AUDIO_DEVICE_IN_BUILTIN_MIC)) {
-            if ((in && (audio_extn_ssr_get_stream() == in)) ||
+            if ((in && audio_extn_ssr_stream_active(in)) ||
                 ((my_data->source_mic_type & SOURCE_QUAD_MIC) &&
                  channel_mask == AUDIO_CHANNEL_INDEX_MASK_4))
                 snd_device = SND_DEVICE_IN_QUAD_MIC;
@@ -7692,9 +7731,8 @@ int platform_edid_get_max_channels(void *platform) {
 
 int platform_edid_get_max_channels_v2(void *platform, int controller, int stream)
 {
-    int channel_count;
     int max_channels = 2;
-    int i = 0, ret = 0;
+    int ret = 0;
     struct platform_data *my_data = (struct platform_data *)platform;
     edid_audio_info *info = NULL;
 
@@ -7703,17 +7741,9 @@ int platform_edid_get_max_channels_v2(void *platform, int controller, int stream
         info = (edid_audio_info *)my_data->ext_disp[controller][stream].edid_info;
 
     if(ret == 0 && info != NULL) {
-        for (i = 0; i < info->audio_blocks && i < MAX_EDID_BLOCKS; i++) {
-            ALOGV("%s:format %d channel %d", __func__,
-                   info->audio_blocks_array[i].format_id,
-                   info->audio_blocks_array[i].channels);
-            if (info->audio_blocks_array[i].format_id == LPCM) {
-                channel_count = info->audio_blocks_array[i].channels;
-                if (channel_count > max_channels) {
-                   max_channels = channel_count;
-                }
-            }
-        }
+        ALOGV("%s: lpcm max channels %d", __func__, info->lpcm_max_channels);
+        if (info->lpcm_max_channels > max_channels)
+            max_channels = info->lpcm_max_channels;
     }
     return max_channels;
 }
@@ -8066,7 +8096,7 @@ static void set_audiocal(void *platform, struct str_parms *parms, char *value, i
             goto done_key_audcal;
         }
 
-        list_init(&out.device_list);
+        device_set_init(&out.device_list);
         if (cal.dev_id) {
           if (audio_is_input_device(cal.dev_id)) {
               // FIXME: why pass an input device whereas
@@ -8077,7 +8107,7 @@ static void set_audiocal(void *platform, struct str_parms *parms, char *value, i
               cal.snd_dev_id = platform_get_input_snd_device(platform, NULL, &cal_devices,
                                                              USECASE_TYPE_MAX);
           } else {
-              reassign_device_list(&out.device_list, cal.dev_id, address);
+              device_set_reassign(&out.device_list, cal.dev_id, address);
               out.sample_rate = cal.sampling_rate;
               cal.snd_dev_id = platform_get_output_snd_device(platform, &out, USECASE_TYPE_MAX);
           }
@@ -8092,6 +8122,7 @@ static void set_audiocal(void *platform, struct str_parms *parms, char *value, i
         }
         if(my_data->acdb_set_audio_cal) {
             ret = my_data->acdb_set_audio_cal((void *)&cal, (void*)dptr, dlen);
+            acdb_cal_cache_invalidate(&my_data->cal_cache);
         }
     }
 done_key_audcal:
@@ -8382,6 +8413,7 @@ int platform_set_parameters(void *platform, struct str_parms *parms)
                             value, len);
     if (err >= 0) {
         str_parms_del(parms, AUDIO_PARAMETER_KEY_RELOAD_ACDB);
+        acdb_cal_cache_invalidate(&my_data->cal_cache);
 
         if (my_data->acdb_reload_v2) {
             my_data->acdb_reload_v2(value, my_data->snd_card_name,
@@ -8659,14 +8691,14 @@ static void get_audiocal(void *platform, void *keys, void *pReply) {
         goto done;
     }
 
-    list_init(&out.device_list);
+    device_set_init(&out.device_list);
     if (cal.dev_id & AUDIO_DEVICE_BIT_IN) {
         struct listnode devices;
         list_init(&devices);
         update_device_list(&devices, cal.dev_id, address, true);
         cal.snd_dev_id = platform_get_input_snd_device(platform, NULL, &devices, USECASE_TYPE_MAX);
     } else if (cal.dev_id) {
-        reassign_device_list(&out.device_list, cal.dev_id, address);
+        device_set_reassign(&out.device_list, cal.dev_id, address);
         out.sample_rate = cal.sampling_rate;
         cal.snd_dev_id = platform_get_output_snd_device(platform, &out, USECASE_TYPE_MAX);
     }
@@ -8773,6 +8805,15 @@ void platform_get_parameters(void *platform,
                           my_data->ec_car_state? "true" : "false");
     }
 
+    ret = str_parms_get_str(query, AUDIO_PARAMETER_KEY_CAL_CACHE_STATS,
+                            value, sizeof(value));
+    if (ret >= 0) {
+        snprintf(value, sizeof(value), "hits:%u,misses:%u,saved_us:%llu",
+                 my_data->cal_cache.hits, my_data->cal_cache.misses,
+                 (unsigned long long)my_data->cal_cache.saved_us);
+        str_parms_add_str(reply, AUDIO_PARAMETER_KEY_CAL_CACHE_STATS, value);
+    }
+
     ret = str_parms_get_str(query, AUDIO_PARAMETER_KEY_DP_FOR_VOICE_USECASE,
                             value, sizeof(value));
 
@@ -8975,6 +9016,12 @@ int64_t platform_capture_latency(struct stream_in *in)
     return delay;
 }
 
+int64_t platform_transcode_loopback_latency(bool low_latency)
+{
+    return low_latency ? TRANSCODE_LOOPBACK_LL_PLATFORM_DELAY :
+                         TRANSCODE_LOOPBACK_PLATFORM_DELAY;
+}
+
 int platform_update_usecase_from_source(int source, int usecase)
 {
     ALOGV("%s: input source :%d", __func__, source);
@@ -9286,9 +9333,9 @@ bool platform_check_and_update_island_power_status(void *platform,
     bool ret = false;
     struct platform_data *my_data = (struct platform_data *)platform;
 
-    if (compare_device_type(&usecase->device_list, AUDIO_DEVICE_OUT_EARPIECE) ||
-        compare_device_type(&usecase->device_list, AUDIO_DEVICE_OUT_WIRED_HEADSET) ||
-        compare_device_type(&usecase->device_list, AUDIO_DEVICE_OUT_WIRED_HEADPHONE)) {
+    if (device_set_has_type(&usecase->device_list, AUDIO_DEVICE_OUT_EARPIECE) ||
+        device_set_has_type(&usecase->device_list, AUDIO_DEVICE_OUT_WIRED_HEADSET) ||
+        device_set_has_type(&usecase->device_list, AUDIO_DEVICE_OUT_WIRED_HEADPHONE)) {
         if (snd_device >= SND_DEVICE_MIN && snd_device < SND_DEVICE_MAX) {
             /* update island and power mode in current device */
             my_data->island_cfg[snd_device].mixer_ctl =
@@ -9935,7 +9982,7 @@ static bool platform_check_codec_backend_cfg(struct audio_device* adev,
     }
 
     /* Native playback is preferred for Headphone/HS device over 192Khz */
-    if (!voice_call_active && codec_device_supports_native_playback(&usecase->device_list)) {
+    if (!voice_call_active && codec_device_supports_native_playback(&usecase->device_list.list)) {
         if (audio_is_true_native_stream_active(adev)) {
             if (check_hdset_combo_device(snd_device)) {
                 /*
@@ -10032,7 +10079,7 @@ static bool platform_check_codec_backend_cfg(struct audio_device* adev,
         }
 
         /*set sample rate to 48khz if multiple sample rates are not supported in spkr and hdset*/
-        if (is_hdset_combo_device(&usecase->device_list) &&
+        if (is_hdset_combo_device(&usecase->device_list.list) &&
             !my_data->is_multiple_sample_rate_combo_supported)
             sample_rate = CODEC_BACKEND_DEFAULT_SAMPLE_RATE;
             ALOGD("%s:becf: afe: set default Sample Rate(48k) for combo device",__func__);
@@ -10073,7 +10120,7 @@ static bool platform_check_codec_backend_cfg(struct audio_device* adev,
      * Handset and speaker may have diffrent backend. Check if the device is speaker or handset,
      * and these devices are restricited to 48kHz.
      */
-    if (!codec_device_supports_native_playback(&usecase->device_list) &&
+    if (!codec_device_supports_native_playback(&usecase->device_list.list) &&
         (platform_check_backends_match(SND_DEVICE_OUT_SPEAKER, snd_device) ||
          platform_check_backends_match(SND_DEVICE_OUT_HANDSET, snd_device))) {
         int bw = platform_get_snd_device_bit_width(SND_DEVICE_OUT_SPEAKER);
@@ -10417,7 +10464,7 @@ bool platform_check_and_set_capture_codec_backend_cfg(struct audio_device* adev,
         backend_cfg.format= usecase->stream.in->format;
         backend_cfg.channels = audio_channel_count_from_in_mask(usecase->stream.in->channel_mask);
         if (is_loopback_input_device(
-                    get_device_types(&usecase->stream.in->device_list))) {
+                    device_set_types(&usecase->stream.in->device_list))) {
             int bw = platform_get_snd_device_bit_width(snd_device);
             if ((-ENOSYS != bw) && (backend_cfg.bit_width > (uint32_t)bw)) {
                 backend_cfg.bit_width = bw;
@@ -11277,7 +11324,7 @@ bool platform_is_edid_supported_format_v2(void *platform,
 {
     struct platform_data *my_data = (struct platform_data *)platform;
     edid_audio_info *info = NULL;
-    int i, ret;
+    int ret;
     unsigned char format_id = platform_map_to_edid_format(format);
 
     if (format == AUDIO_FORMAT_IEC61937)
@@ -11292,17 +11339,15 @@ bool platform_is_edid_supported_format_v2(void *platform,
     if (ret == 0)
         info = (edid_audio_info *)my_data->ext_disp[controller][stream].edid_info;
     if (ret == 0 && info != NULL) {
-        for (i = 0; i < info->audio_blocks && i < MAX_EDID_BLOCKS; i++) {
-             /*
-              * To check
-              *  is there any special for CONFIG_HDMI_PASSTHROUGH_CONVERT
-              *  & DOLBY_DIGITAL_PLUS
-              */
-            if (info->audio_blocks_array[i].format_id == format_id) {
-                ALOGV("%s:returns true %x",
-                      __func__, format);
-                return true;
-            }
+        /*
+         * To check
+         *  is there any special for CONFIG_HDMI_PASSTHROUGH_CONVERT
+         *  & DOLBY_DIGITAL_PLUS
+         */
+        if (info->format_mask & BIT(format_id)) {
+            ALOGV("%s:returns true %x",
+                  __func__, format);
+            return true;
         }
     }
     ALOGV("%s:returns false %x",
@@ -11896,6 +11941,8 @@ int platform_send_audio_cal(void* platform, acdb_audio_cal_cfg_t* cal,
        (cal->topo_id == TRUMPET_TOPOLOGY))
         audio_extn_ip_hdlr_copp_update_cal_info((void*)cal, data);
 
+    acdb_cal_cache_invalidate(&my_data->cal_cache);
+
     if (my_data->acdb_set_audio_cal) {
         // persist audio cal in local cache
         if (persist) {
@@ -11953,6 +12000,7 @@ int platform_store_audio_cal(void* platform, acdb_audio_cal_cfg_t* cal,
     }
 
     if (my_data->acdb_set_audio_cal) {
+        acdb_cal_cache_invalidate(&my_data->cal_cache);
         ret = my_data->acdb_set_audio_cal((void*)cal, data, (uint32_t)length);
     }
 
@@ -12110,7 +12158,7 @@ int platform_set_swap_channels(struct audio_device *adev, bool swap_channels)
     list_for_each(node, &adev->usecase_list) {
         usecase = node_to_item(node, struct audio_usecase, list);
         if (usecase->stream.out && usecase->type == PCM_PLAYBACK &&
-            compare_device_type(&usecase->stream.out->device_list,
+            device_set_has_type(&usecase->stream.out->device_list,
                                 AUDIO_DEVICE_OUT_SPEAKER)) {
             /*
              * If acdb tuning is different for SPEAKER_REVERSE, it is must
@@ -238,6 +238,8 @@ int platform_update_lch(void *platform, struct voice_session *session,
 /* returns the latency for a usecase in Us */
 int64_t platform_render_latency(struct stream_out *out);
 int64_t platform_capture_latency(struct stream_in *in);
+/* returns the DSP path delay of a transcode loopback in Us */
+int64_t platform_transcode_loopback_latency(bool low_latency);
 int platform_update_usecase_from_source(int source, audio_usecase_t usecase);
 
 bool platform_listen_device_needs_event(snd_device_t snd_device);
@@ -40,6 +40,7 @@
 #include "acdb.h"
 #include "platform_api.h"
 #include "audio_extn.h"
+#include "audio_perf.h"
 #include <platform.h>
 #include <pthread.h>
 #include <math.h>
@@ -82,6 +83,7 @@ typedef enum {
     CUSTOM_MTMX_PARAM_IN_CH_INFO,
     MMSECNS,
     AUDIO_SOURCE_DELAY,
+    PERF_HINT_PROFILE,
 } section_t;
 
 typedef void (* section_process_fn)(const XML_Char **attr);
@@ -119,6 +121,7 @@ static void process_custom_mtmx_in_params(const XML_Char **attr);
 static void process_custom_mtmx_param_in_ch_info(const XML_Char **attr);
 static void process_fluence_mmsecns(const XML_Char **attr);
 static void process_audio_source_delay(const XML_Char **attr);
+static void process_perf_hint_profile(const XML_Char **attr);
 
 static section_process_fn section_table[] = {
     [ROOT] = process_root,
@@ -144,6 +147,7 @@ static section_process_fn section_table[] = {
     [CUSTOM_MTMX_PARAM_IN_CH_INFO] = process_custom_mtmx_param_in_ch_info,
     [MMSECNS] = process_fluence_mmsecns,
     [AUDIO_SOURCE_DELAY] = process_audio_source_delay,
+    [PERF_HINT_PROFILE] = process_perf_hint_profile,
 };
 
 static section_t section;
@@ -745,6 +749,48 @@ done:
     return;
 }
 
+/*
+ * <perf_hint_profiles>
+ *     <profile name="ull" hints="low_latency" release_ms="200"/>
+ * </perf_hint_profiles>
+ */
+static void process_perf_hint_profile(const XML_Char **attr)
+{
+    int profile, hints;
+
+    if (strcmp(attr[0], "name") != 0) {
+        ALOGE("%s: 'name' not found", __func__);
+        goto done;
+    }
+
+    profile = audio_perf_get_profile_index((const char *)attr[1]);
+    if (profile < 0) {
+        ALOGE("%s: profile %s is not defined", __func__, (char *)attr[1]);
+        goto done;
+    }
+
+    if (attr[2] == NULL || strcmp(attr[2], "hints") != 0) {
+        ALOGE("%s: 'hints' not found", __func__);
+        goto done;
+    }
+
+    hints = audio_perf_get_hint_mask((const char *)attr[3]);
+    if (hints < 0) {
+        ALOGE("%s: invalid hints %s", __func__, (char *)attr[3]);
+        goto done;
+    }
+
+    if (attr[4] == NULL || strcmp(attr[4], "release_ms") != 0) {
+        ALOGE("%s: 'release_ms' not found", __func__);
+        goto done;
+    }
+
+    audio_perf_set_hint_profile(profile, hints, atoi((char *)attr[5]));
+
+done:
+    return;
+}
+
 static void process_config_params(const XML_Char **attr)
 {
     if (strcmp(attr[0], "key") != 0) {
@@ -1492,6 +1538,15 @@ static void start_tag(void *userdata __unused, const XML_Char *tag_name,
         } else if (strcmp(tag_name, "audio_source_delay") == 0) {
             section_process_fn fn = section_table[section];
             fn(attr);
+        } else if (strcmp(tag_name, "perf_hint_profiles") == 0) {
+            section = PERF_HINT_PROFILE;
+        } else if (strcmp(tag_name, "profile") == 0) {
+            if (section != PERF_HINT_PROFILE) {
+                ALOGE("profile tag supported only with PERF_HINT_PROFILE section");
+                return;
+            }
+            section_process_fn fn = section_table[section];
+            fn(attr);
         }
     } else {
         if(strcmp(tag_name, "config_params") == 0) {
@@ -1557,6 +1612,8 @@ static void end_tag(void *userdata __unused, const XML_Char *tag_name)
         section = ROOT;
     } else if (strcmp(tag_name, "custom_mtmx_param_in_chs") == 0) {
         section = CUSTOM_MTMX_IN_PARAMS;
+    } else if (strcmp(tag_name, "perf_hint_profiles") == 0) {
+        section = ROOT;
     }
 }
 
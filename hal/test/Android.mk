@@ -0,0 +1,148 @@
+LOCAL_PATH := $(call my-dir)
+
+# Each test is one source that includes the code under test, built as a
+# vendor executable with the HAL include paths below and test_common.h.
+HAL_TEST_C_INCLUDES := \
+    external/tinyalsa/include \
+    external/tinycompress/include \
+    system/media/audio_utils/include \
+    external/expat/lib \
+    $(call include-path-for, audio-route) \
+    $(call include-path-for, audio-effects) \
+    $(LOCAL_PATH)/.. \
+    $(LOCAL_PATH)/../$(AUDIO_PLATFORM) \
+    $(LOCAL_PATH)/../audio_extn \
+    $(LOCAL_PATH)/../voice_extn \
+    $(TARGET_OUT_INTERMEDIATES)/KERNEL_OBJ/usr/include \
+    $(TARGET_OUT_INTERMEDIATES)/KERNEL_OBJ/usr/include/audio \
+    $(TARGET_OUT_INTERMEDIATES)/KERNEL_OBJ/usr/techpack/audio/include
+
+HAL_TEST_CFLAGS := -Wall -Werror -O2 \
+    -Wno-unused-parameter \
+    -Wno-unused-function \
+    -Wno-unused-variable
+
+# device_set_test
+# ==============================================================================
+include $(CLEAR_VARS)
+LOCAL_SRC_FILES := device_set_test.c \
+                   ../audio_extn/device_utils.c
+LOCAL_MODULE := device_set_test
+LOCAL_MODULE_TAGS := optional
+LOCAL_VENDOR_MODULE := true
+LOCAL_MODULE_OWNER := qti
+LOCAL_HEADER_LIBRARIES := libhardware_headers libsystem_headers
+LOCAL_C_INCLUDES := $(HAL_TEST_C_INCLUDES)
+LOCAL_ADDITIONAL_DEPENDENCIES += $(TARGET_OUT_INTERMEDIATES)/KERNEL_OBJ/usr
+LOCAL_CFLAGS += $(HAL_TEST_CFLAGS)
+LOCAL_SHARED_LIBRARIES := libcutils liblog
+include $(BUILD_EXECUTABLE)
+
+# adsp_hdlr_test
+# ==============================================================================
+include $(CLEAR_VARS)
+LOCAL_SRC_FILES := adsp_hdlr_test.c
+LOCAL_MODULE := adsp_hdlr_test
+LOCAL_MODULE_TAGS := optional
+LOCAL_VENDOR_MODULE := true
+LOCAL_MODULE_OWNER := qti
+LOCAL_HEADER_LIBRARIES := libhardware_headers libsystem_headers
+LOCAL_C_INCLUDES := $(HAL_TEST_C_INCLUDES)
+LOCAL_ADDITIONAL_DEPENDENCIES += $(TARGET_OUT_INTERMEDIATES)/KERNEL_OBJ/usr
+LOCAL_CFLAGS += $(HAL_TEST_CFLAGS) \
+    -DAUDIO_EXTN_ADSP_HDLR_ENABLED
+LOCAL_SHARED_LIBRARIES := libcutils liblog
+include $(BUILD_EXECUTABLE)
+
+# spkr_prot_test
+# ==============================================================================
+include $(CLEAR_VARS)
+LOCAL_SRC_FILES := spkr_prot_test.c \
+                   ../audio_extn/device_utils.c \
+                   ../audio_extn/lock_stats.c
+LOCAL_MODULE := spkr_prot_test
+LOCAL_MODULE_TAGS := optional
+LOCAL_VENDOR_MODULE := true
+LOCAL_MODULE_OWNER := qti
+LOCAL_HEADER_LIBRARIES := libhardware_headers libsystem_headers
+LOCAL_C_INCLUDES := $(HAL_TEST_C_INCLUDES)
+LOCAL_ADDITIONAL_DEPENDENCIES += $(TARGET_OUT_INTERMEDIATES)/KERNEL_OBJ/usr
+LOCAL_CFLAGS += $(HAL_TEST_CFLAGS) \
+    -DSPKR_PROT_ENABLED
+LOCAL_SHARED_LIBRARIES := libcutils liblog libdl
+include $(BUILD_EXECUTABLE)
+
+# usb_caps_fuzz
+# ==============================================================================
+include $(CLEAR_VARS)
+LOCAL_SRC_FILES := usb_caps_fuzz.c
+LOCAL_MODULE := usb_caps_fuzz
+LOCAL_MODULE_TAGS := optional
+LOCAL_VENDOR_MODULE := true
+LOCAL_MODULE_OWNER := qti
+LOCAL_HEADER_LIBRARIES := libhardware_headers libsystem_headers
+LOCAL_C_INCLUDES := $(HAL_TEST_C_INCLUDES)
+LOCAL_ADDITIONAL_DEPENDENCIES += $(TARGET_OUT_INTERMEDIATES)/KERNEL_OBJ/usr
+LOCAL_CFLAGS += $(HAL_TEST_CFLAGS)
+LOCAL_SHARED_LIBRARIES := libcutils liblog
+include $(BUILD_EXECUTABLE)
+
+# edid_test
+# ==============================================================================
+include $(CLEAR_VARS)
+LOCAL_SRC_FILES := edid_test.c
+LOCAL_MODULE := edid_test
+LOCAL_MODULE_TAGS := optional
+LOCAL_VENDOR_MODULE := true
+LOCAL_MODULE_OWNER := qti
+LOCAL_HEADER_LIBRARIES := libhardware_headers libsystem_headers
+LOCAL_C_INCLUDES := $(HAL_TEST_C_INCLUDES)
+LOCAL_ADDITIONAL_DEPENDENCIES += $(TARGET_OUT_INTERMEDIATES)/KERNEL_OBJ/usr
+LOCAL_CFLAGS += $(HAL_TEST_CFLAGS)
+LOCAL_SHARED_LIBRARIES := libcutils liblog
+include $(BUILD_EXECUTABLE)
+
+# hw_loopback_test
+# ==============================================================================
+include $(CLEAR_VARS)
+LOCAL_SRC_FILES := hw_loopback_test.c \
+                   ../audio_extn/device_utils.c
+LOCAL_MODULE := hw_loopback_test
+LOCAL_MODULE_TAGS := optional
+LOCAL_VENDOR_MODULE := true
+LOCAL_MODULE_OWNER := qti
+LOCAL_HEADER_LIBRARIES := libhardware_headers libsystem_headers
+LOCAL_C_INCLUDES := $(HAL_TEST_C_INCLUDES)
+LOCAL_ADDITIONAL_DEPENDENCIES += $(TARGET_OUT_INTERMEDIATES)/KERNEL_OBJ/usr
+LOCAL_CFLAGS += $(HAL_TEST_CFLAGS) \
+    -DAUDIO_HW_LOOPBACK_ENABLED
+LOCAL_SHARED_LIBRARIES := libcutils liblog
+include $(BUILD_EXECUTABLE)
+
+# audio_perf_test
+# ==============================================================================
+include $(CLEAR_VARS)
+LOCAL_SRC_FILES := audio_perf_test.cpp
+LOCAL_MODULE := audio_perf_test
+LOCAL_MODULE_TAGS := optional
+LOCAL_VENDOR_MODULE := true
+LOCAL_MODULE_OWNER := qti
+LOCAL_C_INCLUDES := $(HAL_TEST_C_INCLUDES)
+LOCAL_CFLAGS += $(HAL_TEST_CFLAGS)
+LOCAL_SHARED_LIBRARIES := libbase libhidlbase libutils android.hardware.power@1.2 liblog
+include $(BUILD_EXECUTABLE)
+
+# acdb_cal_cache_test
+# ==============================================================================
+include $(CLEAR_VARS)
+LOCAL_SRC_FILES := acdb_cal_cache_test.c
+LOCAL_MODULE := acdb_cal_cache_test
+LOCAL_MODULE_TAGS := optional
+LOCAL_VENDOR_MODULE := true
+LOCAL_MODULE_OWNER := qti
+LOCAL_HEADER_LIBRARIES := libhardware_headers libsystem_headers
+LOCAL_C_INCLUDES := $(HAL_TEST_C_INCLUDES)
+LOCAL_ADDITIONAL_DEPENDENCIES += $(TARGET_OUT_INTERMEDIATES)/KERNEL_OBJ/usr
+LOCAL_CFLAGS += $(HAL_TEST_CFLAGS)
+LOCAL_SHARED_LIBRARIES := libcutils liblog libdl
+include $(BUILD_EXECUTABLE)
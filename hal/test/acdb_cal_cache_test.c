@@ -0,0 +1,218 @@
+/*
+ * Copyright (c) 2023 Qualcomm Innovation Center, Inc. All rights reserved.
+ * SPDX-License-Identifier: BSD-3-Clause-Clear
+ */
+
+/*
+ * Unit test of the ACDB calibration cache.
+ *
+ * Builds acdb.c with the platform info calls of the ACDB loader stubbed
+ * out and the fake mixer of test_common.h, and drives the calibration
+ * cache the way the platform's audio calibration send does: ask whether
+ * the calibration was already sent, then record the send or the skip.
+ * Checks that an exact repeat on the same device type is skipped, that
+ * any field changing is sent, that the output and input device types are
+ * tracked separately, that an invalidation resends everything, that a
+ * fresh cache sends, and the hit, miss and saved time counts.
+ */
+
+#define TEST_FAKE_MIXER
+#include "test_common.h"
+
+#include "../acdb.c"
+
+static unsigned int checks;
+
+/* nothing below is reached by the cache */
+int audio_extn_utils_get_platform_info(const char *snd_card_name __unused,
+                                       char *platform_info_file __unused)
+{
+    return -ENOSYS;
+}
+
+void audio_get_vendor_config_path(char *config_file_path, int path_size)
+{
+    if (path_size > 0)
+        config_file_path[0] = '\0';
+}
+
+int platform_info_init(const char *filename __unused, void *platform __unused,
+                       caller_t caller_type __unused)
+{
+    return -ENOSYS;
+}
+
+const char *platform_get_snd_card_name_for_acdb_loader(const char *snd_card_name)
+{
+    return snd_card_name;
+}
+
+static void check(const char *what, bool got, bool expected)
+{
+    checks++;
+    EXPECT(got == expected, "%s: got %s, expected %s", what,
+           got ? "sent" : "not sent", expected ? "sent" : "not sent");
+}
+
+static void check_count(const char *what, uint64_t got, uint64_t expected)
+{
+    checks++;
+    EXPECT(got == expected, "%s: got %llu, expected %llu", what,
+           (unsigned long long)got, (unsigned long long)expected);
+}
+
+static void set_cal(struct acdb_cal_state *cal, int acdb_dev_id)
+{
+    memset(cal, 0, sizeof(*cal));
+    cal->acdb_dev_id = acdb_dev_id;
+    cal->app_type = 69936;
+    cal->sample_rate = 48000;
+    cal->path = 0;
+    cal->backend_sample_rate = 48000;
+    cal->backend_bit_width = 16;
+}
+
+/* one calibration send, as the platform does it; true when it was sent */
+static bool send_cal(struct acdb_cal_cache *cache, struct acdb_cal_state *cal,
+                     int acdb_dev_type, uint64_t send_us)
+{
+    struct acdb_cal_state sent = *cal;
+    bool hit = acdb_cal_cache_is_sent(cache, &sent, acdb_dev_type);
+
+    acdb_cal_cache_update(cache, &sent, acdb_dev_type, hit, hit ? 0 : send_us);
+    return !hit;
+}
+
+static void check_repeats(void)
+{
+    struct acdb_cal_cache cache;
+    struct acdb_cal_state cal;
+
+    acdb_cal_cache_init(&cache);
+    set_cal(&cal, 15);
+    check("first send", send_cal(&cache, &cal, ACDB_DEV_TYPE_OUT, 3000), true);
+    check("repeat", send_cal(&cache, &cal, ACDB_DEV_TYPE_OUT, 3000), false);
+    check("second repeat", send_cal(&cache, &cal, ACDB_DEV_TYPE_OUT, 3000), false);
+
+    /* one send at 3 ms, two skips saving it each */
+    check_count("hits", cache.hits, 2);
+    check_count("misses", cache.misses, 1);
+    check_count("send time", cache.send_us, 3000);
+    check_count("saved time", cache.saved_us, 6000);
+
+    /* another send at 1 ms, skips now save the 2 ms average */
+    set_cal(&cal, 16);
+    check("new device", send_cal(&cache, &cal, ACDB_DEV_TYPE_OUT, 1000), true);
+    check("new device repeat",
+          send_cal(&cache, &cal, ACDB_DEV_TYPE_OUT, 1000), false);
+    check_count("hits", cache.hits, 3);
+    check_count("misses", cache.misses, 2);
+    check_count("send time", cache.send_us, 4000);
+    check_count("saved time", cache.saved_us, 8000);
+}
+
+static void check_changes(void)
+{
+    struct acdb_cal_cache cache;
+    struct acdb_cal_state cal;
+    int *fields[] = { &cal.acdb_dev_id, &cal.app_type, &cal.sample_rate,
+                      &cal.path, &cal.backend_sample_rate,
+                      &cal.backend_bit_width };
+    const char *names[] = { "acdb_dev_id", "app_type", "sample_rate", "path",
+                            "backend_sample_rate", "backend_bit_width" };
+    unsigned int i;
+    char what[64];
+
+    acdb_cal_cache_init(&cache);
+    set_cal(&cal, 15);
+    send_cal(&cache, &cal, ACDB_DEV_TYPE_OUT, 1000);
+    for (i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+        set_cal(&cal, 15);
+        *fields[i] += 1;
+        snprintf(what, sizeof(what), "%s changed", names[i]);
+        check(what, send_cal(&cache, &cal, ACDB_DEV_TYPE_OUT, 1000), true);
+        /* back to the original, which was overwritten by the change */
+        set_cal(&cal, 15);
+        snprintf(what, sizeof(what), "%s restored", names[i]);
+        check(what, send_cal(&cache, &cal, ACDB_DEV_TYPE_OUT, 1000), true);
+    }
+    check_count("change hits", cache.hits, 0);
+}
+
+static void check_dev_types(void)
+{
+    struct acdb_cal_cache cache;
+    struct acdb_cal_state out, in;
+
+    acdb_cal_cache_init(&cache);
+    set_cal(&out, 15);
+    set_cal(&in, 11);
+    check("out", send_cal(&cache, &out, ACDB_DEV_TYPE_OUT, 1000), true);
+    check("in", send_cal(&cache, &in, ACDB_DEV_TYPE_IN, 1000), true);
+    check("out repeat", send_cal(&cache, &out, ACDB_DEV_TYPE_OUT, 1000), false);
+    check("in repeat", send_cal(&cache, &in, ACDB_DEV_TYPE_IN, 1000), false);
+
+    /* the same calibration on the other device type is still sent */
+    check("out cal as in", send_cal(&cache, &out, ACDB_DEV_TYPE_IN, 1000), true);
+    check("in replaced", send_cal(&cache, &in, ACDB_DEV_TYPE_IN, 1000), true);
+    check("out kept", send_cal(&cache, &out, ACDB_DEV_TYPE_OUT, 1000), false);
+
+    /* a device type out of range is always sent and never stored */
+    check("bad type", send_cal(&cache, &out, ACDB_CAL_CACHE_DEV_TYPES, 1000), true);
+    check("bad type repeat",
+          send_cal(&cache, &out, ACDB_CAL_CACHE_DEV_TYPES, 1000), true);
+    check("negative type", send_cal(&cache, &out, -1, 1000), true);
+    check("out after bad type",
+          send_cal(&cache, &out, ACDB_DEV_TYPE_OUT, 1000), false);
+}
+
+static void check_invalidate(void)
+{
+    struct acdb_cal_cache cache;
+    struct acdb_cal_state out, in;
+
+    acdb_cal_cache_init(&cache);
+    set_cal(&out, 15);
+    set_cal(&in, 11);
+    send_cal(&cache, &out, ACDB_DEV_TYPE_OUT, 1000);
+    send_cal(&cache, &in, ACDB_DEV_TYPE_IN, 1000);
+
+    acdb_cal_cache_invalidate(&cache);
+    check("out after invalidate",
+          send_cal(&cache, &out, ACDB_DEV_TYPE_OUT, 1000), true);
+    check("in after invalidate",
+          send_cal(&cache, &in, ACDB_DEV_TYPE_IN, 1000), true);
+    check("out resent", send_cal(&cache, &out, ACDB_DEV_TYPE_OUT, 1000), false);
+    check("in resent", send_cal(&cache, &in, ACDB_DEV_TYPE_IN, 1000), false);
+}
+
+static void check_fresh(void)
+{
+    struct acdb_cal_cache cache;
+    struct acdb_cal_state cal;
+
+    /* the zeroed entries of a fresh cache match an all zero calibration */
+    acdb_cal_cache_init(&cache);
+    memset(&cal, 0, sizeof(cal));
+    check("zero cal", send_cal(&cache, &cal, ACDB_DEV_TYPE_OUT, 1000), true);
+    check("zero cal in", send_cal(&cache, &cal, ACDB_DEV_TYPE_IN, 1000), true);
+    check("zero cal repeat",
+          send_cal(&cache, &cal, ACDB_DEV_TYPE_OUT, 1000), false);
+
+    /* no sends yet, nothing to average the saving over */
+    acdb_cal_cache_init(&cache);
+    acdb_cal_cache_update(&cache, &cal, ACDB_DEV_TYPE_OUT, true, 0);
+    check_count("saved with no sends", cache.saved_us, 0);
+}
+
+int main(void)
+{
+    check_repeats();
+    check_changes();
+    check_dev_types();
+    check_invalidate();
+    check_fresh();
+
+    printf("%u checks\n", checks);
+    return test_finish();
+}
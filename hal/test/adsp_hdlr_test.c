@@ -0,0 +1,223 @@
+/*
+ * Copyright (c) 2023 Qualcomm Innovation Center, Inc. All rights reserved.
+ * SPDX-License-Identifier: BSD-3-Clause-Clear
+ */
+
+/*
+ * Test of the ADSP event handler against the fake mixer of test_common.h,
+ * whose change event queue stands in for the DSP and the mixer event fd.
+ * This is the one harness for ADSP event latency. For N streams it
+ * checks that every raised event reaches the callback of its stream exactly
+ * once and in order, that stray events are dropped and that the handler
+ * stops listening once nothing is registered, and reports the latency from
+ * raising an event to its callback.
+ *
+ * usage: adsp_hdlr_test [cycles]
+ */
+
+#define TEST_WITHOUT_HAL_HEADERS
+#define TEST_FAKE_MIXER
+#include <unistd.h>
+#include "test_common.h"
+#include <cutils/list.h>
+#include <hardware/audio.h>
+
+/* adsp_hdlr.c only needs these from the HAL and platform headers */
+#define MIXER_PATH_MAX_LENGTH 128
+typedef enum {
+    PCM_PLAYBACK,
+    PCM_CAPTURE,
+} usecase_type_t;
+
+#include "../audio_extn/adsp_hdlr.c"
+
+#define MAX_STREAMS     32
+#define FAKE_EVENT_LEN  16
+#define MAX_SAMPLES     (1 << 16)
+
+int set_sched_policy(int tid, SchedPolicy policy) { return 0; }
+
+struct stream {
+    void *handle;
+    atomic_uint received;
+    atomic_uint out_of_order;
+};
+
+static struct stream streams[MAX_STREAMS];
+static uint64_t latency[MAX_SAMPLES];
+static atomic_uint num_latency;
+static atomic_uint stray;
+
+/* event payload: sequence number and the time the event was raised */
+static int stream_callback(stream_callback_event_t event, void *param, void *cookie)
+{
+    struct msm_adsp_event_data *evt = param;
+    struct stream *s = cookie;
+    uint32_t seq;
+    uint64_t raised;
+    unsigned int i;
+
+    if (s < streams || s >= streams + MAX_STREAMS ||
+            event != (stream_callback_event_t)AUDIO_EXTN_STREAM_CBK_EVENT_ADSP) {
+        atomic_fetch_add(&stray, 1);
+        return 0;
+    }
+    memcpy(&seq, evt->payload, sizeof(seq));
+    memcpy(&raised, evt->payload + sizeof(seq), sizeof(raised));
+    i = atomic_fetch_add(&num_latency, 1);
+    if (i < MAX_SAMPLES)
+        latency[i] = test_now_ns() - raised;
+    if (seq != atomic_load(&s->received))
+        atomic_fetch_add(&s->out_of_order, 1);
+    atomic_fetch_add(&s->received, 1);
+    return 0;
+}
+
+static void event_ctl_name(char *name, size_t size, int index)
+{
+    snprintf(name, size, "ADSP Stream Callback Event %d", index + 1);
+}
+
+static void raise_stream_event(int index, uint32_t seq)
+{
+    uint8_t buf[sizeof(struct msm_adsp_event_data) + FAKE_EVENT_LEN] = {0};
+    struct msm_adsp_event_data *evt = (struct msm_adsp_event_data *)buf;
+    char name[MIXER_PATH_MAX_LENGTH];
+    uint64_t t = test_now_ns();
+
+    evt->event_type = AUDIO_STREAM_PP_EVENT;
+    evt->payload_len = FAKE_EVENT_LEN;
+    memcpy(evt->payload, &seq, sizeof(seq));
+    memcpy(evt->payload + sizeof(seq), &t, sizeof(t));
+    event_ctl_name(name, sizeof(name), index);
+    test_mixer_raise_event(name, buf, sizeof(buf));
+}
+
+static bool wait_for(int n, unsigned int want)
+{
+    uint64_t deadline = test_now_ns() + 2000000000ULL;
+    int i;
+
+    for (i = 0; i < n; i++) {
+        while (atomic_load(&streams[i].received) < want) {
+            if (test_now_ns() > deadline)
+                return false;
+            usleep(20);
+        }
+    }
+    return true;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+static int test_streams(int n, int cycles)
+{
+    uint32_t pp_payload = 0;
+    struct audio_adsp_event ev = {
+        .event_type = AUDIO_STREAM_PP_EVENT,
+        .payload_length = sizeof(pp_payload),
+        .payload = &pp_payload,
+    };
+    int i, c, ret = 0;
+    unsigned int k;
+    uint64_t deadline;
+
+    memset(streams, 0, sizeof(streams));
+    atomic_store(&num_latency, 0);
+
+    for (i = 0; i < n; i++) {
+        struct adsp_hdlr_stream_cfg config = {
+            .pcm_device_id = i + 1,
+            .type = PCM_PLAYBACK,
+        };
+
+        if (audio_extn_adsp_hdlr_stream_open(&streams[i].handle, &config) ||
+                audio_extn_adsp_hdlr_stream_set_callback(streams[i].handle,
+                                                         stream_callback, &streams[i]) ||
+                audio_extn_adsp_hdlr_stream_set_param(streams[i].handle,
+                                                      ADSP_HDLR_STREAM_CMD_REGISTER_EVENT,
+                                                      &ev)) {
+            EXPECT(false, "%d streams: could not register stream %d", n, i);
+            return -1;
+        }
+    }
+
+    /* an event nobody registered for is dropped */
+    {
+        uint8_t buf[sizeof(struct msm_adsp_event_data) + FAKE_EVENT_LEN] = {0};
+
+        test_mixer_raise_event("ADSP Stream Callback Event 999", buf, sizeof(buf));
+    }
+
+    for (c = 0; c < cycles; c++) {
+        for (i = 0; i < n; i++)
+            raise_stream_event(i, (uint32_t)c);
+        if (!wait_for(n, (unsigned int)c + 1)) {
+            EXPECT(false, "%d streams: events lost in cycle %d", n, c);
+            ret = -1;
+            break;
+        }
+    }
+
+    for (i = 0; i < n && ret == 0; i++) {
+        if (atomic_load(&streams[i].received) != (unsigned int)cycles ||
+                atomic_load(&streams[i].out_of_order) != 0) {
+            EXPECT(false, "%d streams: stream %d got %u events, %u out of order",
+                   n, i, atomic_load(&streams[i].received),
+                   atomic_load(&streams[i].out_of_order));
+            ret = -1;
+        }
+    }
+    if (ret == 0 && atomic_load(&stray) != 0) {
+        EXPECT(false, "%d streams: %u stray callbacks", n, atomic_load(&stray));
+        ret = -1;
+    }
+
+    if (ret == 0) {
+        k = atomic_load(&num_latency);
+        if (k > MAX_SAMPLES)
+            k = MAX_SAMPLES;
+        qsort(latency, k, sizeof(latency[0]), cmp_u64);
+        printf("%2d streams, %u events: event to callback p50 %.1f us, p99 %.1f us, max %.1f us\n",
+               n, k, latency[k / 2] / 1e3, latency[k * 99 / 100] / 1e3, latency[k - 1] / 1e3);
+    }
+
+    for (i = 0; i < n; i++)
+        audio_extn_adsp_hdlr_stream_close(streams[i].handle);
+
+    /* nothing registered: the handler stops listening to mixer events */
+    deadline = test_now_ns() + 2000000000ULL;
+    while (test_mixer_subscribed() && test_now_ns() < deadline)
+        usleep(100);
+    if (ret == 0 && test_mixer_subscribed()) {
+        EXPECT(false, "%d streams: still subscribed to mixer events", n);
+        ret = -1;
+    }
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    static const int stream_counts[] = { 1, 8, MAX_STREAMS };
+    int cycles = argc > 1 ? atoi(argv[1]) : 200;
+    unsigned int i;
+    int ret = 0;
+
+    if (cycles < 1)
+        cycles = 1;
+
+    if (audio_extn_adsp_hdlr_init(mixer_open(0)) != 0) {
+        EXPECT(false, "init");
+        return test_finish();
+    }
+    for (i = 0; i < sizeof(stream_counts) / sizeof(stream_counts[0]) && ret == 0; i++)
+        ret = test_streams(stream_counts[i], cycles);
+    audio_extn_adsp_hdlr_deinit();
+
+    return test_finish();
+}
@@ -0,0 +1,220 @@
+/*
+ * Copyright (c) 2023 Qualcomm Innovation Center, Inc. All rights reserved.
+ * SPDX-License-Identifier: BSD-3-Clause-Clear
+ */
+
+/*
+ * Test of the audio_perf hint profiles against a fake PowerHAL.
+ *
+ * Builds audio_perf.cpp with IPower replaced by a fake that records every
+ * hint it is sent, and counts the on/off transitions of each hint. Checks
+ * that
+ *  - a ULL stream restarting every 20 ms turns the low latency hint on and
+ *    off once instead of on every cycle, and the streaming hint once per
+ *    burst,
+ *  - overlapping MMAP and ULL requests keep the hint on until both are gone
+ *    and the hint goes off only after the release delay,
+ *  - the same state is never sent twice in a row,
+ *  - an unbalanced release is rejected,
+ *  - starts and ends do not block on a slow PowerHAL,
+ *  - a profile configured at runtime holds its hint.
+ * Takes about 3 seconds.
+ */
+
+#include <chrono>
+#include <thread>
+
+#include "test_common.h"
+
+#include <android/hardware/power/1.2/IPower.h>
+
+namespace android {
+namespace hardware {
+namespace power {
+namespace V1_2 {
+
+constexpr int kFakeHints = 2;
+
+// Counts hints sent by audio_perf, index 0 is streaming, 1 low latency
+struct FakePower : public IPower {
+    std::atomic<int> calls{0};
+    std::atomic<int> transitions[kFakeHints];
+    std::atomic<int> duplicates{0};
+    std::atomic<int> state[kFakeHints];
+    std::atomic<int> delayMs{0};
+
+    FakePower() {
+        for (int i = 0; i < kFakeHints; i++) {
+            transitions[i] = 0;
+            state[i] = 0;
+        }
+    }
+
+    static sp<FakePower> getService() {
+        static sp<FakePower> power = new FakePower();
+        return power;
+    }
+
+    Return<bool> linkToDeath(const sp<hidl_death_recipient>& recipient,
+                             uint64_t) override {
+        return recipient != nullptr;
+    }
+
+    Return<void> powerHintAsync_1_2(PowerHint hint, int32_t data) override {
+        int i = (hint == PowerHint::AUDIO_STREAMING) ? 0 : 1;
+
+        if (delayMs)
+            std::this_thread::sleep_for(std::chrono::milliseconds(delayMs));
+        if (state[i] == data)
+            duplicates++;
+        else
+            transitions[i]++;
+        state[i] = data;
+        calls++;
+        return Void();
+    }
+
+    Return<void> setInteractive(bool) override { return Void(); }
+    Return<void> powerHint(V1_0::PowerHint, int32_t) override { return Void(); }
+    Return<void> setFeature(V1_0::Feature, bool) override { return Void(); }
+    Return<void> getPlatformLowPowerStats(getPlatformLowPowerStats_cb) override {
+        return Void();
+    }
+    Return<void> getSubsystemLowPowerStats(getSubsystemLowPowerStats_cb) override {
+        return Void();
+    }
+    Return<void> powerHintAsync(V1_0::PowerHint, int32_t) override { return Void(); }
+};
+
+}  // namespace V1_2
+}  // namespace power
+}  // namespace hardware
+}  // namespace android
+
+#define IPower FakePower
+#include "../audio_perf.cpp"
+#undef IPower
+
+using android::hardware::power::V1_2::FakePower;
+
+static void sleepMs(int ms) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+static void resetCounts(FakePower *power) {
+    power->calls = 0;
+    for (int i = 0; i < android::hardware::power::V1_2::kFakeHints; i++)
+        power->transitions[i] = 0;
+}
+
+// ULL stream restarting every 20 ms, each start boosted
+static void testRestartTrace(FakePower *power) {
+    resetCounts(power);
+    for (int i = 0; i < 50; i++) {
+        audio_streaming_hint_start();
+        audio_perf_hint_acquire(AUDIO_PERF_PROFILE_ULL);
+        audio_streaming_hint_end();
+        sleepMs(10);
+        audio_perf_hint_release(AUDIO_PERF_PROFILE_ULL);
+        sleepMs(10);
+    }
+    sleepMs(400);
+    /* one on and one off, where a call per start and end used to be 100 */
+    EXPECT(power->transitions[1] == 2,
+           "restart trace low latency transitions: %d", (int)power->transitions[1]);
+    /* the 50 ms streaming release spans the 20 ms restarts */
+    EXPECT(power->transitions[0] == 2,
+           "restart trace streaming transitions: %d", (int)power->transitions[0]);
+    EXPECT(power->state[0] == 0 && power->state[1] == 0,
+           "restart trace hints left on: %d", (int)power->state[0] + power->state[1]);
+    printf("restart trace: %d PowerHAL calls for 50 cycles\n", power->calls.load());
+}
+
+// MMAP and ULL overlap, the hint outlives both by the release delay
+static void testOverlap(FakePower *power) {
+    resetCounts(power);
+    audio_perf_hint_acquire(AUDIO_PERF_PROFILE_MMAP);
+    audio_perf_hint_acquire(AUDIO_PERF_PROFILE_ULL);
+    audio_perf_hint_release(AUDIO_PERF_PROFILE_ULL);
+    sleepMs(300);
+    EXPECT(power->state[1] == 1,
+           "low latency with mmap still held: %d", (int)power->state[1]);
+    audio_perf_hint_release(AUDIO_PERF_PROFILE_MMAP);
+    sleepMs(100);
+    EXPECT(power->state[1] == 1,
+           "low latency inside release delay: %d", (int)power->state[1]);
+    sleepMs(200);
+    EXPECT(power->state[1] == 0,
+           "low latency after release delay: %d", (int)power->state[1]);
+    EXPECT(power->transitions[1] == 2,
+           "overlap low latency transitions: %d", (int)power->transitions[1]);
+    EXPECT(audio_perf_hint_release(AUDIO_PERF_PROFILE_ULL) < 0,
+           "unbalanced release accepted");
+}
+
+// callers do not wait for a PowerHAL call
+static void testSlowPowerHal(FakePower *power) {
+    auto start = std::chrono::steady_clock::now();
+    double elapsedMs;
+
+    resetCounts(power);
+    power->delayMs = 50;
+    for (int i = 0; i < 10; i++) {
+        audio_streaming_hint_start();
+        audio_streaming_hint_end();
+    }
+    elapsedMs = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start).count();
+    EXPECT(elapsedMs < 10,
+           "10 start/end pairs with a 50 ms PowerHAL took %d ms", (int)elapsedMs);
+    sleepMs(300);
+    power->delayMs = 0;
+    EXPECT(power->state[0] == 0,
+           "streaming after slow pairs: %d", (int)power->state[0]);
+    EXPECT(power->transitions[0] <= 2,
+           "slow pairs streaming transitions: %d", (int)power->transitions[0]);
+}
+
+static void testRuntimeProfile(FakePower *power) {
+    resetCounts(power);
+    EXPECT(audio_perf_get_profile_index("voip") == AUDIO_PERF_PROFILE_VOIP,
+           "voip profile index: %d", audio_perf_get_profile_index("voip"));
+    EXPECT(audio_perf_get_hint_mask("streaming|low_latency") ==
+           (AUDIO_PERF_HINT_STREAMING | AUDIO_PERF_HINT_LOW_LATENCY),
+           "hint mask: %d", audio_perf_get_hint_mask("streaming|low_latency"));
+    EXPECT(audio_perf_get_hint_mask("bogus") < 0,
+           "unknown hint accepted: %d", audio_perf_get_hint_mask("bogus"));
+
+    /* voip holds nothing by default */
+    audio_perf_hint_acquire(AUDIO_PERF_PROFILE_VOIP);
+    sleepMs(20);
+    EXPECT(power->calls == 0,
+           "default voip profile calls: %d", (int)power->calls);
+    audio_perf_hint_release(AUDIO_PERF_PROFILE_VOIP);
+
+    audio_perf_set_hint_profile(AUDIO_PERF_PROFILE_VOIP,
+                                AUDIO_PERF_HINT_LOW_LATENCY, 0);
+    audio_perf_hint_acquire(AUDIO_PERF_PROFILE_VOIP);
+    sleepMs(20);
+    EXPECT(power->state[1] == 1,
+           "configured voip low latency: %d", (int)power->state[1]);
+    audio_perf_hint_release(AUDIO_PERF_PROFILE_VOIP);
+    sleepMs(20);
+    EXPECT(power->state[1] == 0,
+           "configured voip released: %d", (int)power->state[1]);
+    EXPECT(power->transitions[1] == 2,
+           "configured voip transitions: %d", (int)power->transitions[1]);
+}
+
+int main() {
+    FakePower *power = FakePower::getService().get();
+
+    testRestartTrace(power);
+    testOverlap(power);
+    testSlowPowerHal(power);
+    testRuntimeProfile(power);
+
+    EXPECT(power->duplicates == 0,
+           "hints sent twice in a row: %d", (int)power->duplicates);
+    return test_finish();
+}
@@ -0,0 +1,186 @@
+/*
+ * Copyright (c) 2023 Qualcomm Innovation Center, Inc. All rights reserved.
+ * SPDX-License-Identifier: BSD-3-Clause-Clear
+ */
+
+/*
+ * Equivalence test and benchmark of struct audio_device_set.
+ *
+ * Random sets, including non single bit types, duplicate types with
+ * different addresses and removals, are checked query by query against the
+ * list helpers the sets replace. The benchmark then times the device query
+ * mix of the platform_get_output_snd_device()/select_devices() prologue on a
+ * speaker + A2DP set with both, and the cost of a reassign.
+ *
+ * usage: device_set_test [iterations]
+ */
+
+#define TEST_WITHOUT_HAL_HEADERS
+#include "test_common.h"
+
+#include <stdbool.h>
+#include <cutils/list.h>
+#include <system/audio.h>
+#include "device_utils.h"
+
+static const audio_devices_t device_pool[] = {
+    AUDIO_DEVICE_OUT_SPEAKER,
+    AUDIO_DEVICE_OUT_SPEAKER_SAFE,
+    AUDIO_DEVICE_OUT_BLUETOOTH_A2DP,
+    AUDIO_DEVICE_OUT_BLUETOOTH_SCO,
+    AUDIO_DEVICE_OUT_USB_HEADSET,
+    AUDIO_DEVICE_OUT_WIRED_HEADSET,
+    AUDIO_DEVICE_OUT_AUX_DIGITAL,
+    AUDIO_DEVICE_OUT_ALL_USB,  /* not a single bit */
+    AUDIO_DEVICE_IN_BUILTIN_MIC,
+    AUDIO_DEVICE_IN_USB_DEVICE,
+    AUDIO_DEVICE_IN_BLUETOOTH_SCO_HEADSET,
+    AUDIO_DEVICE_IN_BLUETOOTH_A2DP,
+    AUDIO_DEVICE_NONE,
+};
+
+#define POOL_SIZE (sizeof(device_pool) / sizeof(device_pool[0]))
+
+static volatile int sink;
+
+static audio_devices_t random_device(void)
+{
+    return device_pool[rand() % POOL_SIZE];
+}
+
+static void fill_random(struct audio_device_set *set)
+{
+    int count = rand() % 4;
+    char address[8];
+
+    while (count-- > 0) {
+        snprintf(address, sizeof(address), "%d", rand() % 2);
+        device_set_update(set, random_device(), address, true);
+    }
+    if (rand() % 5 == 0)
+        device_set_update(set, random_device(), "0", false);
+}
+
+/* returns the number of queries whose set and list answers differ */
+static int check_queries(struct audio_device_set *a, struct audio_device_set *b)
+{
+    audio_devices_t type = random_device();
+    int bad = 0;
+
+    bad += device_set_has_type(a, type) != compare_device_type(&a->list, type);
+    bad += device_set_is_single_type(a, type) != is_single_device_type_equal(&a->list, type);
+    bad += device_set_equal(a, b) != compare_devices(&a->list, &b->list);
+    bad += device_set_any_match(a, b) != compare_devices_for_any_match(&a->list, &b->list);
+    bad += device_set_has(a, DEVICE_SET_IN) != is_audio_in_device_type(&a->list);
+    bad += device_set_has(a, DEVICE_SET_OUT) != is_audio_out_device_type(&a->list);
+    bad += device_set_has(a, DEVICE_SET_A2DP_OUT) != is_a2dp_out_device_type(&a->list);
+    bad += device_set_has(a, DEVICE_SET_USB_OUT) != is_usb_out_device_type(&a->list);
+    bad += device_set_has(a, DEVICE_SET_USB_IN) != is_usb_in_device_type(&a->list);
+    bad += device_set_has(a, DEVICE_SET_SCO_OUT) != is_sco_out_device_type(&a->list);
+    bad += device_set_has(a, DEVICE_SET_SCO_IN) != is_sco_in_device_type(&a->list);
+    bad += device_set_has(a, DEVICE_SET_CODEC_BACKEND_OUT) !=
+            is_codec_backend_out_device_type(&a->list);
+    bad += device_set_has(a, DEVICE_SET_CODEC_BACKEND_IN) !=
+            is_codec_backend_in_device_type(&a->list);
+    bad += device_set_types(a) != get_device_types(&a->list);
+    bad += device_set_empty(a) != list_empty(&a->list);
+    return bad;
+}
+
+static void test_equivalence(int iterations)
+{
+    int i;
+
+    srand(1);
+    for (i = 0; i < iterations; i++) {
+        struct audio_device_set a, b;
+        int bad;
+
+        device_set_init(&a);
+        device_set_init(&b);
+        fill_random(&a);
+        fill_random(&b);
+        bad = check_queries(&a, &b);
+        if (rand() % 3 == 0) {
+            device_set_reassign(&b, random_device(), "");
+            device_set_append(&a, &b.list);
+            bad += check_queries(&a, &b);
+            device_set_assign(&b, &a.list);
+            bad += check_queries(&b, &a);
+        }
+        device_set_clear(&a);
+        device_set_clear(&b);
+        EXPECT(bad == 0, "%d set queries differ from the list helpers at iteration %d",
+               bad, i);
+        if (bad)
+            return;
+    }
+}
+
+static void bench(long iterations)
+{
+    struct audio_device_set set, other;
+    uint64_t t0;
+    double list_ns, set_ns, reassign_ns;
+    long i;
+
+    device_set_init(&set);
+    device_set_update(&set, AUDIO_DEVICE_OUT_SPEAKER, "", true);
+    device_set_update(&set, AUDIO_DEVICE_OUT_BLUETOOTH_A2DP, "", true);
+    device_set_init(&other);
+    device_set_update(&other, AUDIO_DEVICE_OUT_WIRED_HEADSET, "", true);
+
+    t0 = test_now_ns();
+    for (i = 0; i < iterations; i++) {
+        int r = 0;
+
+        r += is_a2dp_out_device_type(&set.list);
+        r += is_usb_out_device_type(&set.list);
+        r += is_sco_out_device_type(&set.list);
+        r += compare_device_type(&set.list, AUDIO_DEVICE_OUT_SPEAKER);
+        r += compare_device_type(&set.list, AUDIO_DEVICE_OUT_AUX_DIGITAL);
+        r += is_codec_backend_out_device_type(&set.list);
+        r += compare_devices(&set.list, &other.list);
+        r += compare_devices_for_any_match(&set.list, &other.list);
+        sink += r;
+    }
+    list_ns = (double)(test_now_ns() - t0) / iterations;
+
+    t0 = test_now_ns();
+    for (i = 0; i < iterations; i++) {
+        int r = 0;
+
+        r += device_set_has(&set, DEVICE_SET_A2DP_OUT);
+        r += device_set_has(&set, DEVICE_SET_USB_OUT);
+        r += device_set_has(&set, DEVICE_SET_SCO_OUT);
+        r += device_set_has_type(&set, AUDIO_DEVICE_OUT_SPEAKER);
+        r += device_set_has_type(&set, AUDIO_DEVICE_OUT_AUX_DIGITAL);
+        r += device_set_has(&set, DEVICE_SET_CODEC_BACKEND_OUT);
+        r += device_set_equal(&set, &other);
+        r += device_set_any_match(&set, &other);
+        sink += r;
+    }
+    set_ns = (double)(test_now_ns() - t0) / iterations;
+
+    t0 = test_now_ns();
+    for (i = 0; i < iterations / 10; i++)
+        device_set_reassign(&other, AUDIO_DEVICE_OUT_WIRED_HEADSET, "");
+    reassign_ns = (double)(test_now_ns() - t0) / (iterations / 10);
+
+    printf("8 query routing mix: list %.1f ns, set %.1f ns; reassign %.1f ns\n",
+           list_ns, set_ns, reassign_ns);
+    device_set_clear(&set);
+    device_set_clear(&other);
+}
+
+int main(int argc, char **argv)
+{
+    long iterations = argc > 1 ? atol(argv[1]) : 2000000;
+
+    if (iterations < 1000)
+        iterations = 1000;
+
+    test_equivalence((int)(iterations / 10));
+    bench(iterations);
+    return test_finish();
+}
@@ -0,0 +1,263 @@
+/*
+ * Copyright (c) 2023 Qualcomm Innovation Center, Inc. All rights reserved.
+ * SPDX-License-Identifier: BSD-3-Clause-Clear
+ */
+
+/*
+ * Test of the EDID short audio descriptor parser and its sink cache.
+ *
+ * Feeds the SAD blobs of a corpus directory (a length byte followed by the
+ * descriptors and the speaker allocation, as read from the "Audio EDID"
+ * control) to edid_get_sink_caps(), as is and randomly mutated or cut short.
+ * The rate, bit width and highest rate queries, which read the summary the
+ * parser fills in, are checked against a walk of the audio blocks, and a
+ * second parse of the same blob must be served from the cache with the same
+ * result. Sinks of known layout are also checked against expected values.
+ * Run it with a sanitizer build to catch parser overruns. The corpus is in
+ * edid_corpus/ next to this file.
+ *
+ * usage: edid_test <corpus dir> [mutations per file]
+ */
+
+/* edid.c only needs edid.h */
+#define TEST_WITHOUT_HAL_HEADERS
+#include <dirent.h>
+#include <string.h>
+#include "test_common.h"
+#include <system/audio.h>
+#include "../audio_extn/edid.c"
+
+#define EDID_BLOB_SIZE 256
+
+struct edid_expected {
+    const char *name;
+    int lpcm_max_channels;
+    int highest_sr;
+    int channel_allocation;
+    int channel_count;
+};
+
+static const struct edid_expected expected[] = {
+    { "tv_stereo",      2,  48000, 0x0,  2 },
+    { "dp_monitor",     2,  48000, 0x0,  2 },
+    { "soundbar_5_1",   6,  48000, 0xb,  6 },
+    { "avr_7_1",        8, 192000, 0x13, 8 },
+    { "quad_lpcm",      4,  48000, 0xf,  7 },
+    { "ten_sads",       8, 192000, 0x0,  2 },
+    { "eleven_sads",    8, 192000, 0x0,  2 },
+    { "odd_length",     0,      0, 0x0,  2 },
+};
+
+static const int rates[] = {
+    0, 8000, 32000, 44100, 48000, 88200, 96000, 176400, 192000, 384000
+};
+static const int bit_widths[] = { 0, 16, 20, 24, 32 };
+
+static unsigned int blobs, cache_hits;
+
+static bool ref_is_supported_sr(edid_audio_info *info, int sr)
+{
+    int i;
+
+    for (i = 0; i < info->audio_blocks && i < MAX_EDID_BLOCKS; i++)
+        if (is_supported_sr(info->audio_blocks_array[i].sampling_freq_bitmask, sr))
+            return true;
+    return false;
+}
+
+static bool ref_is_supported_bps(edid_audio_info *info, int bps)
+{
+    int i;
+
+    if (bps == 16)
+        return true;
+    for (i = 0; i < info->audio_blocks && i < MAX_EDID_BLOCKS; i++)
+        if (is_supported_bps(info->audio_blocks_array[i].bits_per_sample_bitmask, bps))
+            return true;
+    return false;
+}
+
+static int ref_highest_sr(edid_audio_info *info)
+{
+    int i, sr, highest_sr = 0;
+
+    for (i = 0; i < info->audio_blocks && i < MAX_EDID_BLOCKS; i++) {
+        sr = get_highest_edid_sf(info->audio_blocks_array[i].sampling_freq_bitmask);
+        if (sr > highest_sr)
+            highest_sr = sr;
+    }
+    return highest_sr;
+}
+
+static int ref_lpcm_max_channels(edid_audio_info *info)
+{
+    int i, channels = 0;
+
+    for (i = 0; i < info->audio_blocks && i < MAX_EDID_BLOCKS; i++)
+        if (info->audio_blocks_array[i].format_id == LPCM &&
+            info->audio_blocks_array[i].channels > channels)
+            channels = info->audio_blocks_array[i].channels;
+    return channels;
+}
+
+/* a broken parser fails most mutations, only print the first few */
+static void fail(const char *name, const char *what, int got, int want)
+{
+    if (test_failures++ < 20)
+        printf("FAIL %s: %s is %d, expected %d\n", name, what, got, want);
+}
+
+static void check_queries(const char *name, edid_audio_info *info)
+{
+    unsigned int i;
+
+    for (i = 0; i < sizeof(rates) / sizeof(rates[0]); i++)
+        if (edid_is_supported_sr(info, rates[i]) != ref_is_supported_sr(info, rates[i]))
+            fail(name, "sample rate support", edid_is_supported_sr(info, rates[i]),
+                 ref_is_supported_sr(info, rates[i]));
+    for (i = 0; i < sizeof(bit_widths) / sizeof(bit_widths[0]); i++)
+        if (edid_is_supported_bps(info, bit_widths[i]) !=
+                ref_is_supported_bps(info, bit_widths[i]))
+            fail(name, "bit width support", edid_is_supported_bps(info, bit_widths[i]),
+                 ref_is_supported_bps(info, bit_widths[i]));
+    if (edid_get_highest_supported_sr(info) != ref_highest_sr(info))
+        fail(name, "highest sample rate", edid_get_highest_supported_sr(info),
+             ref_highest_sr(info));
+    if (info->lpcm_max_channels != ref_lpcm_max_channels(info))
+        fail(name, "lpcm max channels", info->lpcm_max_channels,
+             ref_lpcm_max_channels(info));
+}
+
+/* parses a blob twice, the second time from the cache, and checks both */
+static bool parse_blob(const char *name, char *blob, edid_audio_info *info)
+{
+    edid_audio_info again;
+    bool parsed;
+    int length = (unsigned char)blob[0];
+
+    blobs++;
+    memset(info, 0x5a, sizeof(*info));
+    parsed = edid_get_sink_caps(info, blob);
+    if (parsed != (length >= MIN_AUDIO_DESC_LENGTH))
+        fail(name, "parse result", parsed, !parsed);
+    if (!parsed)
+        return false;
+    check_queries(name, info);
+
+    memset(&again, 0xa5, sizeof(again));
+    if (!edid_get_sink_caps(&again, blob)) {
+        fail(name, "reparse result", 0, 1);
+        return false;
+    }
+    if (length <= EDID_SAD_MAX_LENGTH) {
+        if (again.sink_hash != edid_sad_hash(blob + 1, length))
+            fail(name, "cached sink hash", again.sink_hash,
+                 edid_sad_hash(blob + 1, length));
+        cache_hits++;
+    }
+    if (memcmp(&again, info, sizeof(again)))
+        fail(name, "reparse differs", 1, 0);
+    return true;
+}
+
+static void check_expected(const char *name, edid_audio_info *info)
+{
+    unsigned int i;
+
+    for (i = 0; i < sizeof(expected) / sizeof(expected[0]); i++) {
+        if (strcmp(expected[i].name, name))
+            continue;
+        if (info->lpcm_max_channels != expected[i].lpcm_max_channels)
+            fail(name, "lpcm max channels", info->lpcm_max_channels,
+                 expected[i].lpcm_max_channels);
+        if (edid_get_highest_supported_sr(info) != expected[i].highest_sr)
+            fail(name, "highest sample rate", edid_get_highest_supported_sr(info),
+                 expected[i].highest_sr);
+        if (info->channel_allocation != expected[i].channel_allocation)
+            fail(name, "channel allocation", info->channel_allocation,
+                 expected[i].channel_allocation);
+        if ((int)audio_channel_count_from_out_mask(info->channel_mask) !=
+                expected[i].channel_count)
+            fail(name, "channel count",
+                 audio_channel_count_from_out_mask(info->channel_mask),
+                 expected[i].channel_count);
+        return;
+    }
+}
+
+static void mutate(char *blob, const char *seed, int seed_size)
+{
+    int length, i;
+
+    memset(blob, 0, EDID_BLOB_SIZE);
+    memcpy(blob, seed, seed_size);
+    switch (rand() % 3) {
+    case 0:
+        /* flip descriptor bytes */
+        for (i = rand() % 4; i >= 0; i--)
+            blob[1 + rand() % (EDID_BLOB_SIZE - 1)] ^= 1 << (rand() % 8);
+        break;
+    case 1:
+        /* cut short, or claim more than is there */
+        blob[0] = rand() % (seed_size + 8);
+        break;
+    default:
+        /* random descriptors of a random length */
+        length = rand() % (EDID_SAD_MAX_LENGTH + 8);
+        blob[0] = length;
+        for (i = 1; i <= length; i++)
+            blob[i] = rand();
+        break;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    char path[512], seed[EDID_BLOB_SIZE], blob[EDID_BLOB_SIZE];
+    edid_audio_info info;
+    struct dirent *entry;
+    unsigned int files = 0;
+    int mutations = 20000, seed_size, i;
+    DIR *dir;
+    FILE *f;
+
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <corpus dir> [mutations per file]\n", argv[0]);
+        return 1;
+    }
+    if (argc > 2)
+        mutations = atoi(argv[2]);
+    dir = opendir(argv[1]);
+    if (!dir) {
+        fprintf(stderr, "cannot open %s\n", argv[1]);
+        return 1;
+    }
+    srand(1);
+
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] == '.')
+            continue;
+        snprintf(path, sizeof(path), "%s/%s", argv[1], entry->d_name);
+        f = fopen(path, "rb");
+        if (!f)
+            continue;
+        memset(seed, 0, sizeof(seed));
+        seed_size = fread(seed, 1, sizeof(seed), f);
+        fclose(f);
+        if (seed_size <= 0)
+            continue;
+        files++;
+
+        if (parse_blob(entry->d_name, seed, &info))
+            check_expected(entry->d_name, &info);
+        for (i = 0; i < mutations; i++) {
+            mutate(blob, seed, seed_size);
+            parse_blob(entry->d_name, blob, &info);
+        }
+    }
+    closedir(dir);
+
+    printf("%u corpus files, %u blobs, %u cache hits\n", files, blobs, cache_hits);
+    EXPECT(files > 0, "no corpus files in %s", argv[1]);
+    return test_finish();
+}
@@ -0,0 +1,382 @@
+/*
+ * Copyright (c) 2023 Qualcomm Innovation Center, Inc. All rights reserved.
+ * SPDX-License-Identifier: BSD-3-Clause-Clear
+ */
+
+/*
+ * Unit test of the hw loopback latency planner.
+ *
+ * Builds hw_loopback.c with the HAL, platform and compress calls it makes
+ * stubbed out, and runs loopback_plan_latency() over PCM and compressed
+ * sources, sample rates, channel counts, latency budgets and forced latency
+ * modes. Every plan is checked against a brute force search of the fragment
+ * configurations: the default latency mode is kept whenever something fits
+ * in it, the buffering picked is the largest that fits the budget, a forced
+ * mode is never changed, and a budget nothing fits gets the smallest
+ * configuration. The DSP path delay is taken from the platform, so the test
+ * also changes it and checks that the plan follows. Last, the budget and
+ * render window parameters are set and read back through the patch.
+ */
+
+#define TEST_FAKE_MIXER
+#include "test_common.h"
+
+#include "../audio_extn/hw_loopback.c"
+
+#define DSP_DELAY_US          13000
+#define LOW_DSP_DELAY_US      3000
+
+static int64_t dsp_delay_us = DSP_DELAY_US;
+static int64_t low_dsp_delay_us = LOW_DSP_DELAY_US;
+static unsigned int plans;
+
+int64_t platform_transcode_loopback_latency(bool low_latency)
+{
+    return low_latency ? low_dsp_delay_us : dsp_delay_us;
+}
+
+/* nothing below is reached by the planner */
+int select_devices(struct audio_device *adev __unused,
+                   audio_usecase_t uc_id __unused)
+{
+    return -ENOSYS;
+}
+
+int disable_audio_route(struct audio_device *adev __unused,
+                        struct audio_usecase *usecase __unused)
+{
+    return -ENOSYS;
+}
+
+int disable_snd_device(struct audio_device *adev __unused,
+                       snd_device_t snd_device __unused)
+{
+    return -ENOSYS;
+}
+
+struct audio_usecase *get_usecase_from_list(const struct audio_device *adev __unused,
+                                            audio_usecase_t uc_id __unused)
+{
+    return NULL;
+}
+
+int get_snd_codec_id(audio_format_t format __unused)
+{
+    return 0;
+}
+
+uint32_t hal_format_to_alsa(audio_format_t hal_format __unused)
+{
+    return 0;
+}
+
+int platform_get_pcm_device_id(audio_usecase_t usecase __unused,
+                               int device_type __unused)
+{
+    return -EINVAL;
+}
+
+void platform_invalidate_backend_config(void *platform __unused,
+                                        snd_device_t snd_device __unused)
+{
+}
+
+struct compress *compress_open(unsigned int card __unused,
+                               unsigned int device __unused,
+                               unsigned int flags __unused,
+                               struct compr_config *config __unused)
+{
+    return NULL;
+}
+
+void compress_close(struct compress *compress __unused)
+{
+}
+
+int is_compress_ready(struct compress *compress __unused)
+{
+    return 0;
+}
+
+int compress_start(struct compress *compress __unused)
+{
+    return -ENOSYS;
+}
+
+int compress_write(struct compress *compress __unused,
+                   const void *buf __unused, unsigned int size __unused)
+{
+    return -ENOSYS;
+}
+
+int compress_get_tstamp(struct compress *compress __unused,
+                        unsigned long *samples __unused,
+                        unsigned int *sampling_rate __unused)
+{
+    return -ENOSYS;
+}
+
+#ifdef ENABLE_EXTENDED_COMPRESS_FORMAT
+int compress_set_metadata(struct compress *compress __unused,
+                          struct snd_compr_metadata *mdata __unused)
+{
+    return -ENOSYS;
+}
+#endif
+
+struct port {
+    audio_format_t format;
+    audio_channel_mask_t channel_mask;
+    uint32_t sample_rate;
+    uint32_t frame_size;
+};
+
+static const struct port sources[] = {
+    { AUDIO_FORMAT_PCM_16_BIT, AUDIO_CHANNEL_OUT_STEREO,  48000, 4 },
+    { AUDIO_FORMAT_PCM_16_BIT, AUDIO_CHANNEL_OUT_STEREO,  44100, 4 },
+    { AUDIO_FORMAT_PCM_32_BIT, AUDIO_CHANNEL_OUT_5POINT1, 48000, 24 },
+    { AUDIO_FORMAT_AC3,        AUDIO_CHANNEL_OUT_5POINT1, 48000, 0 },
+};
+
+static const struct port sinks[] = {
+    { AUDIO_FORMAT_PCM_16_BIT, AUDIO_CHANNEL_OUT_STEREO,  48000, 4 },
+    { AUDIO_FORMAT_PCM_16_BIT, AUDIO_CHANNEL_OUT_5POINT1, 48000, 12 },
+};
+
+static const uint32_t budgets_us[] = {
+    0, 1000, 3500, 4000, 8000, 10000, 13500, 14000, 16000, 18500, 20000,
+    30000, 50000, 100000, 200000,
+    /* exactly the estimate of 128 frames at 48 kHz, in and out */
+    8332, 18332,
+};
+
+static void fail(const char *what, uint32_t budget_us, int forced_mode,
+                 uint32_t got, uint32_t want)
+{
+    if (test_failures++ < 20)
+        printf("FAIL budget %u us, forced mode %d: %s is %u, expected %u\n",
+               budget_us, forced_mode, what, got, want);
+}
+
+static void set_port(struct audio_port_config *config, const struct port *port)
+{
+    memset(config, 0, sizeof(*config));
+    config->format = port->format;
+    config->channel_mask = port->channel_mask;
+    config->sample_rate = port->sample_rate;
+}
+
+static uint32_t ref_latency_us(const struct port *source, const struct port *sink,
+                               uint32_t frames, uint32_t mode)
+{
+    uint64_t latency_us = (mode == HW_LOOPBACK_LATENCY_MODE_LOW) ?
+                          low_dsp_delay_us : dsp_delay_us;
+
+    if (source->frame_size)
+        latency_us += (uint64_t)frames * 1000000 / source->sample_rate;
+    latency_us += (uint64_t)frames * 1000000 / sink->sample_rate;
+    return latency_us;
+}
+
+/* largest frames x fragments that fits the budget in a mode, 0 if none */
+static uint32_t ref_best_frames(const struct port *source, const struct port *sink,
+                                uint32_t budget_us, uint32_t mode)
+{
+    uint32_t frames, fragments, best = 0;
+
+    for (frames = HW_LOOPBACK_MIN_FRAGMENT_FRAMES;
+         frames <= HW_LOOPBACK_MAX_FRAGMENT_FRAMES; frames <<= 1)
+        for (fragments = 1; fragments <= HW_LOOPBACK_MAX_FRAGMENTS; fragments++)
+            if (frames * fragments > best &&
+                ref_latency_us(source, sink, frames * fragments, mode) <= budget_us)
+                best = frames * fragments;
+    return best;
+}
+
+static void check_plan(const struct port *source, const struct port *sink,
+                       uint32_t budget_us, int forced_mode)
+{
+    loopback_patch_t patch;
+    struct compr_config source_config, sink_config;
+    uint32_t mode, want_mode, frames, want_frames = 0, fragments, latency_us;
+    uint32_t first_mode, last_mode, m;
+
+    memset(&patch, 0, sizeof(patch));
+    set_port(&patch.loopback_source, source);
+    set_port(&patch.loopback_sink, sink);
+    patch.latency_budget_us = budget_us;
+    memset(&source_config, 0, sizeof(source_config));
+    memset(&sink_config, 0, sizeof(sink_config));
+    source_config.fragment_size = sink_config.fragment_size = HW_LOOPBACK_FRAGMENT_SIZE;
+    source_config.fragments = sink_config.fragments = 1;
+
+    mode = loopback_plan_latency(&patch, &source_config, &sink_config, forced_mode);
+    plans++;
+
+    first_mode = (forced_mode >= 0) ? (uint32_t)forced_mode : HW_LOOPBACK_LATENCY_MODE_DEFAULT;
+    last_mode = (forced_mode >= 0) ? (uint32_t)forced_mode : HW_LOOPBACK_LATENCY_MODE_LOW;
+    want_mode = last_mode;
+    for (m = first_mode; m <= last_mode; m++) {
+        want_frames = ref_best_frames(source, sink, budget_us, m);
+        if (want_frames) {
+            want_mode = m;
+            break;
+        }
+    }
+    if (!want_frames)
+        want_frames = HW_LOOPBACK_MIN_FRAGMENT_FRAMES;
+
+    if (mode != want_mode)
+        fail("latency mode", budget_us, forced_mode, mode, want_mode);
+
+    fragments = sink_config.fragments;
+    frames = sink_config.fragment_size / sink->frame_size;
+    if (sink_config.fragment_size % sink->frame_size)
+        fail("sink fragment size", budget_us, forced_mode,
+             sink_config.fragment_size, frames * sink->frame_size);
+    if (fragments < 1 || fragments > HW_LOOPBACK_MAX_FRAGMENTS)
+        fail("fragments", budget_us, forced_mode, fragments, 1);
+    if (frames * fragments != want_frames)
+        fail("buffered frames", budget_us, forced_mode, frames * fragments,
+             want_frames);
+
+    if (source->frame_size) {
+        if (source_config.fragment_size != frames * source->frame_size ||
+            source_config.fragments != fragments)
+            fail("source fragment size", budget_us, forced_mode,
+                 source_config.fragment_size, frames * source->frame_size);
+    } else if (source_config.fragment_size != HW_LOOPBACK_FRAGMENT_SIZE ||
+               source_config.fragments != 1) {
+        fail("compressed source fragment size", budget_us, forced_mode,
+             source_config.fragment_size, HW_LOOPBACK_FRAGMENT_SIZE);
+    }
+
+    latency_us = loopback_estimate_latency_us(&patch, &source_config,
+                                              &sink_config, mode);
+    if (latency_us != ref_latency_us(source, sink, frames * fragments, mode))
+        fail("estimate", budget_us, forced_mode, latency_us,
+             ref_latency_us(source, sink, frames * fragments, mode));
+    if (ref_best_frames(source, sink, budget_us, mode) && latency_us > budget_us)
+        fail("estimate over budget", budget_us, forced_mode, latency_us, budget_us);
+}
+
+/* a plan worked out by hand, stereo 16 bit 48 kHz in and out */
+static void check_example(uint32_t budget_us, uint32_t want_mode,
+                          uint32_t want_fragment_size, uint32_t want_fragments,
+                          uint32_t want_latency_us)
+{
+    loopback_patch_t patch;
+    struct compr_config source_config, sink_config;
+    uint32_t mode, latency_us;
+
+    memset(&patch, 0, sizeof(patch));
+    set_port(&patch.loopback_source, &sources[0]);
+    set_port(&patch.loopback_sink, &sinks[0]);
+    patch.latency_budget_us = budget_us;
+    memset(&source_config, 0, sizeof(source_config));
+    memset(&sink_config, 0, sizeof(sink_config));
+
+    mode = loopback_plan_latency(&patch, &source_config, &sink_config, -1);
+    latency_us = loopback_estimate_latency_us(&patch, &source_config,
+                                              &sink_config, mode);
+    if (mode != want_mode)
+        fail("example latency mode", budget_us, -1, mode, want_mode);
+    if (sink_config.fragment_size != want_fragment_size ||
+        source_config.fragment_size != want_fragment_size)
+        fail("example fragment size", budget_us, -1, sink_config.fragment_size,
+             want_fragment_size);
+    if (sink_config.fragments != want_fragments)
+        fail("example fragments", budget_us, -1, sink_config.fragments,
+             want_fragments);
+    if (latency_us != want_latency_us)
+        fail("example latency", budget_us, -1, latency_us, want_latency_us);
+}
+
+static void check_parameters(void)
+{
+    struct audio_device adev;
+    struct audio_port_config source, sink;
+    audio_patch_handle_t handle = AUDIO_PATCH_HANDLE_NONE;
+    struct str_parms *parms;
+
+    memset(&adev, 0, sizeof(adev));
+    if (audio_extn_hw_loopback_init(&adev)) {
+        fail("init", 0, -1, 1, 0);
+        return;
+    }
+
+    parms = str_parms_create_str("hw_loopback_latency_budget_us=-5");
+    audio_extn_hw_loopback_set_parameters(parms);
+    str_parms_destroy(parms);
+    if (audio_loopback_mod->latency_budget_us != 0)
+        fail("negative budget", audio_loopback_mod->latency_budget_us, -1,
+             audio_loopback_mod->latency_budget_us, 0);
+    if (audio_loopback_mod->render_window_enabled)
+        fail("render window by default", 0, -1, 1, 0);
+
+    parms = str_parms_create_str(
+            "hw_loopback_latency_budget_us=20000;hw_loopback_render_window=true");
+    audio_extn_hw_loopback_set_parameters(parms);
+    str_parms_destroy(parms);
+
+    /* the patch takes both, session creation then fails on the stubs */
+    set_port(&source, &sources[0]);
+    source.type = AUDIO_PORT_TYPE_DEVICE;
+    source.ext.device.type = AUDIO_DEVICE_IN_HDMI;
+    set_port(&sink, &sinks[0]);
+    sink.type = AUDIO_PORT_TYPE_DEVICE;
+    sink.ext.device.type = AUDIO_DEVICE_OUT_SPEAKER;
+    audio_extn_hw_loopback_create_audio_patch(&adev.device, 1, &source, 1, &sink,
+                                              &handle);
+    if (audio_loopback_mod->patch_db.loopback_patch[0].latency_budget_us != 20000)
+        fail("patch budget", 20000, -1,
+             audio_loopback_mod->patch_db.loopback_patch[0].latency_budget_us, 20000);
+    if (!audio_loopback_mod->patch_db.loopback_patch[0].render_window_enabled)
+        fail("patch render window", 20000, -1, 0, 1);
+
+    parms = str_parms_create_str("hw_loopback_render_window=false");
+    audio_extn_hw_loopback_set_parameters(parms);
+    str_parms_destroy(parms);
+    if (audio_loopback_mod->render_window_enabled)
+        fail("render window off", 0, -1, 1, 0);
+
+    audio_extn_hw_loopback_deinit(&adev);
+}
+
+int main(void)
+{
+    unsigned int i, j, k;
+    int forced_mode;
+
+    /* no mixer controls are reached by the planner */
+    test_mixer.absent = true;
+
+    for (i = 0; i < sizeof(sources) / sizeof(sources[0]); i++)
+        for (j = 0; j < sizeof(sinks) / sizeof(sinks[0]); j++)
+            for (k = 0; k < sizeof(budgets_us) / sizeof(budgets_us[0]); k++)
+                for (forced_mode = -1; forced_mode <= 1; forced_mode++)
+                    check_plan(&sources[i], &sinks[j], budgets_us[k], forced_mode);
+
+    /* 13 ms DSP delay leaves 3.5 ms per stream, 128 frames */
+    check_example(20000, HW_LOOPBACK_LATENCY_MODE_DEFAULT, 512, 1, 18332);
+    check_example(18332, HW_LOOPBACK_LATENCY_MODE_DEFAULT, 512, 1, 18332);
+    /* only low latency mode fits */
+    check_example(10000, HW_LOOPBACK_LATENCY_MODE_LOW, 512, 1, 8332);
+    /* nothing fits, smallest configuration in low latency mode */
+    check_example(3500, HW_LOOPBACK_LATENCY_MODE_LOW, 128, 1, 4332);
+
+    /* the planner follows the platform delay */
+    dsp_delay_us = 5000;
+    low_dsp_delay_us = 1000;
+    check_example(20000, HW_LOOPBACK_LATENCY_MODE_DEFAULT, 1024, 1, 15666);
+    for (i = 0; i < sizeof(sources) / sizeof(sources[0]); i++)
+        for (k = 0; k < sizeof(budgets_us) / sizeof(budgets_us[0]); k++)
+            check_plan(&sources[i], &sinks[0], budgets_us[k], -1);
+    dsp_delay_us = DSP_DELAY_US;
+    low_dsp_delay_us = LOW_DSP_DELAY_US;
+
+    check_parameters();
+
+    printf("%u plans\n", plans);
+    return test_finish();
+}
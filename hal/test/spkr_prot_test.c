@@ -0,0 +1,274 @@
+/*
+ * Copyright (c) 2023 Qualcomm Innovation Center, Inc. All rights reserved.
+ * SPDX-License-Identifier: BSD-3-Clause-Clear
+ */
+
+/*
+ * Speaker protection calibration scheduling test.
+ *
+ * Builds spkr_protection.c against a fake calibration driver and thermal
+ * zones and the fake mixer of test_common.h, with the calibration idle window set to 3 seconds, and replays
+ * a speaker use trace: the speaker plays from boot, stops at 1 s, plays
+ * again at 2 s and goes idle at 2.5 s. A usecase then starts while the
+ * driver still reports calibration in progress. The test checks that
+ *  - calibration starts when the idle window closes, not on a periodic
+ *    wakeup,
+ *  - no temperature is read before the speaker has been idle long enough,
+ *  - a usecase start cancels calibration without waiting for the status
+ *    poll,
+ *  - calibration is retried and completes once the speaker is idle again.
+ * Takes about 15 seconds.
+ */
+
+#define TEST_FAKE_MIXER
+#include <fcntl.h>
+#include <stdarg.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include "test_common.h"
+
+int fake_open(const char *path, int flags, ...);
+int fake_ioctl(int fd, unsigned long request, void *arg);
+FILE *fake_fopen(const char *path, const char *mode);
+
+#define open fake_open
+#define ioctl fake_ioctl
+#define fopen fake_fopen
+#include "../audio_extn/spkr_protection.c"
+#undef open
+#undef ioctl
+#undef fopen
+
+#define MIN_IDLE_SEC          3
+#define IDLE_AT_SEC           2.5
+/* status queries answered with "in progress" before the driver is done */
+#define IN_PROGRESS_POLLS     8
+#define START_TOLERANCE_SEC   1.0
+#define CANCEL_MAX_MS         100
+#define TIMEOUT_SEC           60
+
+static uint64_t t_start_ns;
+static atomic_int temp_reads;
+static atomic_int status_polls;
+static double cal_start_sec = -1;
+static double cal_done_sec = -1;
+
+static double elapsed_sec(void)
+{
+    return (test_now_ns() - t_start_ns) / 1e9;
+}
+
+/* calibration driver */
+int fake_open(const char *path, int flags, ...)
+{
+    if (!strcmp(path, "/dev/msm_audio_cal"))
+        return dup(STDIN_FILENO);
+    return -1;
+}
+
+int fake_ioctl(int fd, unsigned long request, void *arg)
+{
+    if (request == AUDIO_SET_CALIBRATION) {
+        struct audio_cal_fb_spk_prot_cfg *cfg = arg;
+
+        if (cfg->cal_type.cal_info.mode == MSM_SPKR_PROT_CALIBRATION_IN_PROGRESS &&
+                cal_start_sec < 0)
+            cal_start_sec = elapsed_sec();
+        if (cfg->cal_type.cal_info.mode == MSM_SPKR_PROT_CALIBRATED)
+            cal_done_sec = elapsed_sec();
+    } else if (request == AUDIO_GET_CALIBRATION) {
+        struct audio_cal_fb_spk_prot_status *status = arg;
+        int n = atomic_fetch_add(&status_polls, 1);
+
+        status->cal_type.cal_info.status = n < IN_PROGRESS_POLLS ? -EAGAIN : 0;
+        status->cal_type.cal_info.r0[0] = 8 << 24;
+        status->cal_type.cal_info.r0[1] = 8 << 24;
+    }
+    return 0;
+}
+
+/* no thermal zones in sysfs, the temperature comes from the codec */
+FILE *fake_fopen(const char *path, const char *mode)
+{
+    if (mode[0] == 'r')
+        return NULL;
+    return fopen("/dev/null", mode);
+}
+
+int property_get(const char *key, char *value, const char *default_value)
+{
+    const char *result = default_value ? default_value : "";
+
+    if (!strcmp(key, "persist.vendor.audio.speaker.prot.enable"))
+        result = "true";
+    else if (!strcmp(key, "persist.vendor.audio.spkr.cal.duration"))
+        result = "3";
+    strlcpy(value, result, PROPERTY_VALUE_MAX);
+    return strlen(value);
+}
+
+/* codec temperature and VI feedback controls of the fake mixer */
+static int codec_get_value(struct mixer_ctl *ctl, unsigned int id)
+{
+    if (strstr(ctl->name, "Temp")) {
+        atomic_fetch_add(&temp_reads, 1);
+        return 25;
+    }
+    if (strstr(ctl->name, "VI_FEED"))
+        return 1;
+    return ctl->value;
+}
+
+static int fake_pcm;
+
+struct pcm *pcm_open(unsigned int card, unsigned int device, unsigned int flags,
+                     struct pcm_config *config) { return (struct pcm *)&fake_pcm; }
+int pcm_is_ready(struct pcm *pcm) { return 1; }
+int pcm_start(struct pcm *pcm) { return 0; }
+int pcm_close(struct pcm *pcm) { return 0; }
+const char *pcm_get_error(struct pcm *pcm) { return ""; }
+
+int audio_route_apply_and_update_path(struct audio_route *ar, const char *name) { return 0; }
+int audio_route_reset_and_update_path(struct audio_route *ar, const char *name) { return 0; }
+
+/* HAL and platform callbacks */
+static struct audio_usecase *get_usecase(const struct audio_device *adev, audio_usecase_t id)
+{
+    struct listnode *node;
+    struct audio_usecase *usecase;
+
+    list_for_each(node, &adev->usecase_list) {
+        usecase = node_to_item(node, struct audio_usecase, list);
+        if (usecase->id == id)
+            return usecase;
+    }
+    return NULL;
+}
+
+static int snd_device_op(struct audio_device *adev, snd_device_t snd_device) { return 0; }
+static int route_op(struct audio_device *adev, struct audio_usecase *usecase) { return 0; }
+static int get_pcm_device_id(audio_usecase_t usecase, int type) { return 5; }
+static bool is_vbat_enabled(void) { return false; }
+static int is_wsa_analog_mode(void *adev) { return 0; }
+static int fake_spkr_prot_snd_device(snd_device_t snd_device) { return snd_device; }
+static int fake_vi_feedback_snd_device(snd_device_t snd_device)
+{
+    return SND_DEVICE_IN_CAPTURE_VI_FEEDBACK;
+}
+
+static int get_snd_device_name_extn(void *platform, snd_device_t snd_device, char *name)
+{
+    strlcpy(name, "speaker", DEVICE_NAME_MAX_SIZE);
+    return 0;
+}
+
+static const char *get_snd_device_name(snd_device_t snd_device) { return "speaker"; }
+
+static bool check_and_set_codec_backend_cfg(struct audio_device *adev,
+                                            struct audio_usecase *usecase,
+                                            snd_device_t snd_device)
+{
+    return false;
+}
+
+static struct audio_device adev;
+static struct stream_out primary_output;
+
+static void set_speaker(bool on)
+{
+    pthread_mutex_lock(&adev.lock);
+    if (on) {
+        spkr_prot_calib_cancel(&adev);
+        spkr_prot_start_processing(SND_DEVICE_OUT_SPEAKER);
+    } else {
+        spkr_prot_stop_processing(SND_DEVICE_OUT_SPEAKER);
+    }
+    pthread_mutex_unlock(&adev.lock);
+}
+
+static void sleep_until(double sec)
+{
+    while (elapsed_sec() < sec)
+        usleep(10000);
+}
+
+int main(void)
+{
+    spkr_prot_init_config_t config;
+    double t, cancel_ms, idle_sec;
+    int init_temp_reads, early_temp_reads;
+
+    memset(&config, 0, sizeof(config));
+    config.fp_get_usecase_from_list = get_usecase;
+    config.fp_enable_snd_device = snd_device_op;
+    config.fp_disable_snd_device = snd_device_op;
+    config.fp_enable_audio_route = route_op;
+    config.fp_disable_audio_route = route_op;
+    config.fp_platform_get_pcm_device_id = get_pcm_device_id;
+    config.fp_audio_extn_is_vbat_enabled = is_vbat_enabled;
+    config.fp_platform_spkr_prot_is_wsa_analog_mode = is_wsa_analog_mode;
+    config.fp_platform_get_spkr_prot_snd_device = fake_spkr_prot_snd_device;
+    config.fp_platform_get_vi_feedback_snd_device = fake_vi_feedback_snd_device;
+    config.fp_platform_get_snd_device_name_extn = get_snd_device_name_extn;
+    config.fp_platform_get_snd_device_name = get_snd_device_name;
+    config.fp_platform_check_and_set_codec_backend_cfg = check_and_set_codec_backend_cfg;
+
+    pthread_mutex_init(&adev.lock, NULL);
+    list_init(&adev.usecase_list);
+    adev.primary_output = &primary_output;
+    tz_names.spkr_1_name = "wsatz.13";
+    tz_names.spkr_2_name = "wsatz.14";
+
+    test_mixer.get_value = codec_get_value;
+    t_start_ns = test_now_ns();
+
+    pthread_mutex_lock(&adev.lock);
+    spkr_prot_init(&adev, config);
+    spkr_prot_start_processing(SND_DEVICE_OUT_SPEAKER);
+    pthread_mutex_unlock(&adev.lock);
+    /* init probes the speakers for their temperature controls */
+    init_temp_reads = atomic_load(&temp_reads);
+
+    sleep_until(1.0);
+    set_speaker(false);
+    sleep_until(2.0);
+    set_speaker(true);
+    sleep_until(IDLE_AT_SEC);
+    set_speaker(false);
+
+    sleep_until(IDLE_AT_SEC + MIN_IDLE_SEC - 0.2);
+    early_temp_reads = atomic_load(&temp_reads) - init_temp_reads;
+
+    /* start a usecase while the driver reports calibration in progress */
+    while (atomic_load(&status_polls) < 3 && elapsed_sec() < TIMEOUT_SEC)
+        usleep(1000);
+    t = elapsed_sec();
+    set_speaker(true);
+    cancel_ms = (elapsed_sec() - t) * 1000;
+    set_speaker(false);
+    idle_sec = elapsed_sec();
+
+    while (cal_done_sec < 0 && elapsed_sec() < TIMEOUT_SEC)
+        usleep(1000);
+
+    printf("calibration start %.2f s (idle from %.2f s, window %d s)\n",
+           cal_start_sec, IDLE_AT_SEC, MIN_IDLE_SEC);
+    printf("usecase start blocked %.0f ms, calibrated %.2f s after idle\n",
+           cancel_ms, cal_done_sec - idle_sec);
+    printf("temperature reads %d, status polls %d\n",
+           atomic_load(&temp_reads), atomic_load(&status_polls));
+
+    EXPECT(cal_start_sec >= IDLE_AT_SEC + MIN_IDLE_SEC &&
+           cal_start_sec <= IDLE_AT_SEC + MIN_IDLE_SEC + START_TOLERANCE_SEC,
+           "calibration did not start when the idle window closed");
+    EXPECT(early_temp_reads == 0, "%d temperature reads before the idle window closed",
+           early_temp_reads);
+    EXPECT(cancel_ms <= CANCEL_MAX_MS,
+           "usecase start waited for the calibration status poll");
+    EXPECT(cal_done_sec >= 0, "calibration did not complete after the speaker went idle");
+
+    /* calibration keeps its devices until the next usecase starts */
+    set_speaker(true);
+    spkr_prot_deinit();
+    return test_finish();
+}
@@ -0,0 +1,333 @@
+/*
+ * Copyright (c) 2023 Qualcomm Innovation Center, Inc. All rights reserved.
+ * SPDX-License-Identifier: BSD-3-Clause-Clear
+ */
+
+#ifndef AUDIO_HAL_TEST_COMMON_H
+#define AUDIO_HAL_TEST_COMMON_H
+
+/*
+ * Scaffolding shared by the unit tests and benchmarks of the HAL, the
+ * post processing and visualizer libraries and alsa_sim. A test is one
+ * translation unit that includes this header first and then, usually, the
+ * source under test.
+ *
+ * Defines a test may set before including it:
+ *   TEST_WITHOUT_HAL_HEADERS  the source under test only needs its own
+ *                             header, keep audio_hw.h and the platform
+ *                             headers out.
+ *   TEST_FAKE_MIXER           provide the tinyalsa mixer below instead of
+ *                             linking libtinyalsa.
+ */
+
+#ifdef TEST_WITHOUT_HAL_HEADERS
+#define QCOM_AUDIO_HW_H
+#define QCOM_AUDIO_PLATFORM_H
+#define AUDIO_PLATFORM_API_H
+#ifndef __unused
+#define __unused __attribute__((__unused__))
+#endif
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#ifdef __cplusplus
+#include <atomic>
+static std::atomic<unsigned int> test_failures;
+#else
+#include <stdatomic.h>
+static atomic_uint test_failures;
+#endif
+
+/* count a failed check and carry on, so one run reports every failure */
+#define EXPECT(cond, ...) do {                              \
+    if (!(cond)) {                                          \
+        printf("FAIL %s:%d: ", __func__, __LINE__);         \
+        printf(__VA_ARGS__);                                \
+        printf("\n");                                       \
+        test_failures++;                                    \
+    }                                                       \
+} while (0)
+
+static inline uint64_t test_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* print the verdict and return the exit status for main */
+static inline int test_finish(void)
+{
+    unsigned int failures = test_failures;
+
+    if (failures) {
+        printf("FAILED (%u)\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("PASSED\n");
+    return EXIT_SUCCESS;
+}
+
+#ifdef TEST_FAKE_MIXER
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <string.h>
+#include <sound/asound.h>
+#include <tinyalsa/asoundlib.h>
+
+#define TEST_MIXER_MAX_CTLS     128
+#define TEST_MIXER_NAME_LEN     128
+#define TEST_MIXER_MAX_BYTES    512
+#define TEST_MIXER_QUEUE_LEN    (TEST_MIXER_MAX_CTLS * 4)
+
+/*
+ * Controls are created on first lookup and keep the last value and array
+ * written to them. mixer_read() returns the change events queued with
+ * test_mixer_raise_event(), which stands in for the DSP or codec side.
+ */
+struct mixer_ctl {
+    char name[TEST_MIXER_NAME_LEN];
+    int value;
+    uint8_t data[TEST_MIXER_MAX_BYTES];
+    unsigned int size;
+    unsigned int sets;
+};
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    struct mixer_ctl ctls[TEST_MIXER_MAX_CTLS];
+    unsigned int num_ctls;
+    unsigned int queue[TEST_MIXER_QUEUE_LEN];
+    unsigned int head, tail;
+    bool subscribed;
+    /* the card has no mixer: mixer_open() and every lookup fail */
+    bool absent;
+    /* when set, mixer_ctl_get_value() returns what this hook returns */
+    int (*get_value)(struct mixer_ctl *ctl, unsigned int id);
+} test_mixer = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .cond = PTHREAD_COND_INITIALIZER,
+};
+
+struct mixer *mixer_open(unsigned int card)
+{
+    return test_mixer.absent ? NULL : (struct mixer *)&test_mixer;
+}
+
+void mixer_close(struct mixer *mixer) {}
+
+const char *mixer_get_name(struct mixer *mixer)
+{
+    return "test-mixer";
+}
+
+unsigned int mixer_get_num_ctls(struct mixer *mixer)
+{
+    return test_mixer.num_ctls;
+}
+
+struct mixer_ctl *mixer_get_ctl(struct mixer *mixer, unsigned int id)
+{
+    return id < test_mixer.num_ctls ? &test_mixer.ctls[id] : NULL;
+}
+
+struct mixer_ctl *mixer_get_ctl_by_name(struct mixer *mixer, const char *name)
+{
+    struct mixer_ctl *ctl = NULL;
+    unsigned int i;
+
+    if (test_mixer.absent)
+        return NULL;
+
+    pthread_mutex_lock(&test_mixer.lock);
+    for (i = 0; i < test_mixer.num_ctls; i++) {
+        if (!strcmp(test_mixer.ctls[i].name, name)) {
+            ctl = &test_mixer.ctls[i];
+            break;
+        }
+    }
+    if (ctl == NULL && test_mixer.num_ctls < TEST_MIXER_MAX_CTLS) {
+        ctl = &test_mixer.ctls[test_mixer.num_ctls++];
+        snprintf(ctl->name, sizeof(ctl->name), "%s", name);
+    }
+    pthread_mutex_unlock(&test_mixer.lock);
+    return ctl;
+}
+
+void mixer_ctl_update(struct mixer_ctl *ctl) {}
+
+const char *mixer_ctl_get_name(struct mixer_ctl *ctl)
+{
+    return ctl->name;
+}
+
+enum mixer_ctl_type mixer_ctl_get_type(struct mixer_ctl *ctl)
+{
+    return ctl->size ? MIXER_CTL_TYPE_BYTE : MIXER_CTL_TYPE_INT;
+}
+
+const char *mixer_ctl_get_type_string(struct mixer_ctl *ctl)
+{
+    return ctl->size ? "BYTE" : "INT";
+}
+
+unsigned int mixer_ctl_get_num_values(struct mixer_ctl *ctl)
+{
+    return ctl->size ? ctl->size : 1;
+}
+
+unsigned int mixer_ctl_get_num_enums(struct mixer_ctl *ctl)
+{
+    return 0;
+}
+
+const char *mixer_ctl_get_enum_string(struct mixer_ctl *ctl, unsigned int enum_id)
+{
+    return "";
+}
+
+int mixer_ctl_get_range_min(struct mixer_ctl *ctl)
+{
+    return 0;
+}
+
+int mixer_ctl_get_range_max(struct mixer_ctl *ctl)
+{
+    return INT32_MAX;
+}
+
+int mixer_ctl_get_value(struct mixer_ctl *ctl, unsigned int id)
+{
+    if (test_mixer.get_value)
+        return test_mixer.get_value(ctl, id);
+    return ctl->value;
+}
+
+int mixer_ctl_set_value(struct mixer_ctl *ctl, unsigned int id, int value)
+{
+    pthread_mutex_lock(&test_mixer.lock);
+    ctl->value = value;
+    ctl->sets++;
+    pthread_mutex_unlock(&test_mixer.lock);
+    return 0;
+}
+
+int mixer_ctl_set_enum_by_string(struct mixer_ctl *ctl, const char *string)
+{
+    pthread_mutex_lock(&test_mixer.lock);
+    ctl->sets++;
+    pthread_mutex_unlock(&test_mixer.lock);
+    return 0;
+}
+
+int mixer_ctl_get_array(struct mixer_ctl *ctl, void *array, size_t count)
+{
+    pthread_mutex_lock(&test_mixer.lock);
+    memset(array, 0, count);
+    memcpy(array, ctl->data, count < ctl->size ? count : ctl->size);
+    pthread_mutex_unlock(&test_mixer.lock);
+    return 0;
+}
+
+int mixer_ctl_set_array(struct mixer_ctl *ctl, const void *array, size_t count)
+{
+    if (count > TEST_MIXER_MAX_BYTES)
+        return -EINVAL;
+
+    pthread_mutex_lock(&test_mixer.lock);
+    memcpy(ctl->data, array, count);
+    ctl->size = count;
+    ctl->sets++;
+    pthread_mutex_unlock(&test_mixer.lock);
+    return 0;
+}
+
+int mixer_subscribe_events(struct mixer *mixer, int subscribe)
+{
+    pthread_mutex_lock(&test_mixer.lock);
+    test_mixer.subscribed = subscribe != 0;
+    pthread_cond_broadcast(&test_mixer.cond);
+    pthread_mutex_unlock(&test_mixer.lock);
+    return 0;
+}
+
+int mixer_wait_event(struct mixer *mixer, int timeout)
+{
+    struct timespec ts;
+    int ret;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += timeout / 1000;
+    ts.tv_nsec += (timeout % 1000) * 1000000L;
+    if (ts.tv_nsec >= 1000000000L) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000L;
+    }
+
+    pthread_mutex_lock(&test_mixer.lock);
+    while (test_mixer.head == test_mixer.tail) {
+        if (!test_mixer.subscribed) {
+            pthread_mutex_unlock(&test_mixer.lock);
+            return -EINVAL;
+        }
+        if (pthread_cond_timedwait(&test_mixer.cond, &test_mixer.lock, &ts) == ETIMEDOUT)
+            break;
+    }
+    ret = test_mixer.head != test_mixer.tail;
+    pthread_mutex_unlock(&test_mixer.lock);
+    return ret;
+}
+
+int mixer_read(struct mixer *mixer, struct snd_ctl_event *ev)
+{
+    unsigned int index;
+
+    pthread_mutex_lock(&test_mixer.lock);
+    if (test_mixer.head == test_mixer.tail) {
+        pthread_mutex_unlock(&test_mixer.lock);
+        return -EAGAIN;
+    }
+    index = test_mixer.queue[test_mixer.head++ % TEST_MIXER_QUEUE_LEN];
+    memset(ev, 0, sizeof(*ev));
+    ev->type = SNDRV_CTL_EVENT_ELEM;
+    ev->data.elem.mask = SNDRV_CTL_EVENT_MASK_VALUE;
+    snprintf((char *)ev->data.elem.id.name, sizeof(ev->data.elem.id.name), "%s",
+             test_mixer.ctls[index].name);
+    pthread_mutex_unlock(&test_mixer.lock);
+    return sizeof(*ev);
+}
+
+/* the driver side: store a new array value and queue its change event */
+static inline void test_mixer_raise_event(const char *name, const void *data,
+                                          unsigned int size)
+{
+    struct mixer_ctl *ctl = mixer_get_ctl_by_name(NULL, name);
+
+    pthread_mutex_lock(&test_mixer.lock);
+    memcpy(ctl->data, data, size);
+    ctl->size = size;
+    test_mixer.queue[test_mixer.tail++ % TEST_MIXER_QUEUE_LEN] =
+            (unsigned int)(ctl - test_mixer.ctls);
+    pthread_cond_broadcast(&test_mixer.cond);
+    pthread_mutex_unlock(&test_mixer.lock);
+}
+
+static inline bool test_mixer_subscribed(void)
+{
+    bool subscribed;
+
+    pthread_mutex_lock(&test_mixer.lock);
+    subscribed = test_mixer.subscribed;
+    pthread_mutex_unlock(&test_mixer.lock);
+    return subscribed;
+}
+#endif /* TEST_FAKE_MIXER */
+
+#endif /* AUDIO_HAL_TEST_COMMON_H */
@@ -0,0 +1,387 @@
+/*
+ * Copyright (c) 2023 Qualcomm Innovation Center, Inc. All rights reserved.
+ * SPDX-License-Identifier: BSD-3-Clause-Clear
+ */
+
+/*
+ * Fuzz and benchmark harness of the USB audio capability parser.
+ *
+ * Feeds /proc/asound/cardN/stream0 files from a corpus directory, as is and
+ * randomly mutated, to usb_add_device() with /proc/asound redirected to a
+ * scratch directory. For every card it parses, the stream config chosen from
+ * the capability table is compared with the one chosen by walking the
+ * altset list, over a grid of bit widths, rates and channel counts. Run it
+ * with a sanitizer build to catch parser overruns and leaks. The largest
+ * corpus file is then used to time parsing and usb_is_config_supported().
+ * The corpus is in usb_stream0/ next to this file.
+ *
+ * usage: usb_caps_fuzz <corpus dir> [mutations per file]
+ */
+
+#define TEST_FAKE_MIXER
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "test_common.h"
+
+int fake_open(const char *path, int flags, ...);
+int fake_access(const char *path, int mode);
+
+#define open fake_open
+#define access fake_access
+#include "../audio_extn/usb.c"
+#undef open
+#undef access
+
+#define FUZZ_CARD        1
+#define MAX_CORPUS_FILES 64
+#define MAX_STREAM0_SIZE (64 * 1024)
+#define BENCH_QUERIES    1000000
+
+static char proc_root[PATH_MAX];
+
+static const char *proc_path(const char *path, char *buf, size_t size)
+{
+    if (strncmp(path, "/proc/asound/", strlen("/proc/asound/")))
+        return NULL;
+    snprintf(buf, size, "%s/%s", proc_root, path + strlen("/proc/asound/"));
+    return buf;
+}
+
+int fake_open(const char *path, int flags, ...)
+{
+    char buf[PATH_MAX];
+
+    if (proc_path(path, buf, sizeof(buf)) == NULL)
+        return -1;
+    return open(buf, flags);
+}
+
+int fake_access(const char *path, int mode)
+{
+    char buf[PATH_MAX];
+
+    if (proc_path(path, buf, sizeof(buf)) == NULL)
+        return -1;
+    return access(buf, mode);
+}
+
+bool audio_extn_usb_is_sidetone_volume_enabled() { return false; }
+bool voice_is_call_state_active(struct audio_device *adev) { return false; }
+
+struct corpus_file {
+    char name[NAME_MAX + 1];
+    char *data;
+    size_t size;
+};
+
+static struct corpus_file corpus[MAX_CORPUS_FILES];
+static int num_corpus;
+
+static int load_corpus(const char *dir)
+{
+    DIR *d = opendir(dir);
+    struct dirent *entry;
+    char path[PATH_MAX];
+    FILE *f;
+    long size;
+
+    if (d == NULL) {
+        printf("cannot open corpus directory %s\n", dir);
+        return -1;
+    }
+    while ((entry = readdir(d)) != NULL && num_corpus < MAX_CORPUS_FILES) {
+        if (entry->d_name[0] == '.')
+            continue;
+        snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+        f = fopen(path, "rb");
+        if (f == NULL)
+            continue;
+        fseek(f, 0, SEEK_END);
+        size = ftell(f);
+        fseek(f, 0, SEEK_SET);
+        if (size > 0 && size <= MAX_STREAM0_SIZE) {
+            corpus[num_corpus].data = malloc(size);
+            if (corpus[num_corpus].data != NULL &&
+                    fread(corpus[num_corpus].data, 1, size, f) == (size_t)size) {
+                corpus[num_corpus].size = size;
+                strlcpy(corpus[num_corpus].name, entry->d_name,
+                        sizeof(corpus[num_corpus].name));
+                num_corpus++;
+            } else {
+                free(corpus[num_corpus].data);
+            }
+        }
+        fclose(f);
+    }
+    closedir(d);
+    return num_corpus > 0 ? 0 : -1;
+}
+
+static int write_card(int card, const char *data, size_t size, const char *usbid)
+{
+    char path[PATH_MAX];
+    FILE *f;
+
+    snprintf(path, sizeof(path), "%s/card%d", proc_root, card);
+    mkdir(path, 0755);
+    snprintf(path, sizeof(path), "%s/card%d/stream0", proc_root, card);
+    f = fopen(path, "wb");
+    if (f == NULL)
+        return -1;
+    fwrite(data, 1, size, f);
+    fclose(f);
+    snprintf(path, sizeof(path), "%s/card%d/usbid", proc_root, card);
+    f = fopen(path, "w");
+    if (f == NULL)
+        return -1;
+    fprintf(f, "%s\n", usbid);
+    fclose(f);
+    return 0;
+}
+
+static void remove_card(int card)
+{
+    char path[PATH_MAX];
+
+    snprintf(path, sizeof(path), "%s/card%d/stream0", proc_root, card);
+    unlink(path);
+    snprintf(path, sizeof(path), "%s/card%d/usbid", proc_root, card);
+    unlink(path);
+    snprintf(path, sizeof(path), "%s/card%d", proc_root, card);
+    rmdir(path);
+}
+
+static struct usb_card_config *find_card(audio_devices_t device)
+{
+    struct listnode *node;
+    struct usb_card_config *card_info;
+
+    list_for_each(node, &usbmod->usb_card_conf_list) {
+        card_info = node_to_item(node, struct usb_card_config, list);
+        if (card_info->usb_device_type == device)
+            return card_info;
+    }
+    return NULL;
+}
+
+/* byte flips, digit and separator swaps, deletions and truncation */
+static size_t mutate(char *buf, size_t size)
+{
+    static const char tokens[] = "0123456789 ,-:\n";
+    int i, count = 1 + rand() % 8;
+    size_t pos;
+
+    for (i = 0; i < count && size > 1; i++) {
+        pos = rand() % size;
+        switch (rand() % 5) {
+        case 0:
+            buf[pos] = tokens[rand() % (sizeof(tokens) - 1)];
+            break;
+        case 1:
+            buf[pos] = (char)(1 + rand() % 255);
+            break;
+        case 2:
+            memmove(buf + pos, buf + pos + 1, size - pos - 1);
+            size--;
+            break;
+        case 3:
+            buf[pos] = '\n';
+            break;
+        default:
+            size = pos + 1;
+            break;
+        }
+    }
+    return size;
+}
+
+/* returns the number of stream configs the table and the list disagree on */
+static long compare_policies(struct usb_card_config *card_info, long *queries)
+{
+    static const unsigned int bit_widths[] = { 8, 16, 20, 24, 32 };
+    static const unsigned int odd_rates[] = { 1, 12345, 50000, 400000 };
+    struct usb_card_caps saved = card_info->caps;
+    unsigned int num_rates = sizeof(supported_sample_rates) / sizeof(supported_sample_rates[0]);
+    unsigned int b, r, ch;
+    long mismatches = 0;
+
+    if (!saved.valid)
+        return 0;
+
+    for (b = 0; b < sizeof(bit_widths) / sizeof(bit_widths[0]); b++) {
+        for (r = 0; r < num_rates + sizeof(odd_rates) / sizeof(odd_rates[0]); r++) {
+            for (ch = 0; ch <= 12; ch++) {
+                unsigned int rate = r < num_rates ? supported_sample_rates[r] :
+                                                    odd_rates[r - num_rates];
+                unsigned int b1 = bit_widths[b], r1 = rate, c1 = ch;
+                unsigned int b2 = bit_widths[b], r2 = rate, c2 = ch;
+
+                card_info->caps = saved;
+                usb_audio_backend_apply_policy(card_info, &b1, &r1, &c1);
+                card_info->caps.valid = false;
+                usb_audio_backend_apply_policy(card_info, &b2, &r2, &c2);
+                (*queries)++;
+                if (b1 != b2 || r1 != r2 || c1 != c2) {
+                    if (mismatches++ == 0)
+                        printf("  in (%u, %u, %u): table (%u, %u, %u), list (%u, %u, %u)\n",
+                               bit_widths[b], rate, ch, b1, r1, c1, b2, r2, c2);
+                }
+            }
+        }
+    }
+    card_info->caps = saved;
+    return mismatches;
+}
+
+static long fuzz_one(const char *name, const char *data, size_t size, long *queries)
+{
+    static const audio_devices_t devices[] = {
+        AUDIO_DEVICE_OUT_USB_DEVICE,
+        AUDIO_DEVICE_IN_USB_DEVICE,
+    };
+    struct usb_card_config *card_info;
+    long mismatches = 0, m;
+    unsigned int i;
+
+    if (write_card(FUZZ_CARD, data, size, "0000:0000"))
+        return 0;
+    for (i = 0; i < sizeof(devices) / sizeof(devices[0]); i++) {
+        usb_add_device(devices[i], FUZZ_CARD);
+        card_info = find_card(devices[i]);
+        if (card_info != NULL) {
+            m = compare_policies(card_info, queries);
+            EXPECT(m == 0, "%s: %ld %s configs differ from the list walk",
+                   name, m, usb_output_device(devices[i]) ? "playback" : "capture");
+            mismatches += m;
+        }
+        usb_remove_device(devices[i], FUZZ_CARD);
+    }
+    return mismatches;
+}
+
+static int count_altsets(const char *data, size_t size)
+{
+    const char *p = data, *end = data + size;
+    const char *capture = memmem(data, size, "Capture:", strlen("Capture:"));
+    int count = 0;
+
+    if (capture != NULL)
+        end = capture;
+    while ((p = memmem(p, end - p, "Altset", strlen("Altset"))) != NULL) {
+        count++;
+        p += strlen("Altset");
+    }
+    return count;
+}
+
+static double now_sec(void)
+{
+    return test_now_ns() / 1e9;
+}
+
+static void bench(const struct corpus_file *file)
+{
+    struct usb_card_config *card_info;
+    struct listnode *node;
+    volatile unsigned int sink = 0;
+    int reps = 2000, i, parsed = 0, expected = count_altsets(file->data, file->size);
+    double t0, parse_us;
+    unsigned int q, mode;
+
+    write_card(FUZZ_CARD, file->data, file->size, "0000:0001");
+    t0 = now_sec();
+    for (i = 0; i < reps; i++) {
+        usb_add_device(AUDIO_DEVICE_OUT_USB_DEVICE, FUZZ_CARD);
+        usb_remove_device(AUDIO_DEVICE_OUT_USB_DEVICE, FUZZ_CARD);
+    }
+    parse_us = (now_sec() - t0) / reps * 1e6;
+
+    usb_add_device(AUDIO_DEVICE_OUT_USB_DEVICE, FUZZ_CARD);
+    card_info = find_card(AUDIO_DEVICE_OUT_USB_DEVICE);
+    if (card_info == NULL) {
+        EXPECT(false, "%s was not parsed", file->name);
+        return;
+    }
+    list_for_each(node, &card_info->usb_device_conf_list)
+        parsed++;
+    printf("%s: %zu bytes, %d of %d playback altsets parsed, add + remove %.1f us\n",
+           file->name, file->size, parsed, expected, parse_us);
+
+    for (mode = 0; mode < 2; mode++) {
+        bool valid = card_info->caps.valid;
+
+        card_info->caps.valid = valid && mode == 0;
+        t0 = now_sec();
+        for (q = 0; q < BENCH_QUERIES; q++) {
+            unsigned int b = usb_caps_bit_widths[q % 3];
+            unsigned int r = supported_sample_rates[q % 14];
+            unsigned int ch = 1 + q % 8;
+
+            usb_is_config_supported(&b, &r, &ch, true);
+            sink += b + r + ch;
+        }
+        printf("  usb_is_config_supported, %s: %.1f ns\n",
+               mode == 0 ? "capability table" : "altset list",
+               (now_sec() - t0) / BENCH_QUERIES * 1e9);
+        card_info->caps.valid = valid;
+    }
+    usb_remove_device(AUDIO_DEVICE_OUT_USB_DEVICE, FUZZ_CARD);
+
+    EXPECT(parsed == expected, "%s: parsed %d playback altsets, stream0 has %d",
+           file->name, parsed, expected);
+}
+
+int main(int argc, char **argv)
+{
+    static struct audio_device adev;
+    static char buf[MAX_STREAM0_SIZE];
+    const char *tmpdir = getenv("TMPDIR");
+    int mutations = argc > 2 ? atoi(argv[2]) : 2000;
+    long queries = 0, mismatches = 0;
+    int i, n, largest = 0;
+    size_t size;
+
+    if (argc < 2) {
+        printf("usage: usb_caps_fuzz <corpus dir> [mutations per file]\n");
+        return EXIT_FAILURE;
+    }
+    if (load_corpus(argv[1]))
+        return EXIT_FAILURE;
+
+    snprintf(proc_root, sizeof(proc_root), "%s/usb_caps_fuzz_XXXXXX",
+             tmpdir ? tmpdir : "/data/local/tmp");
+    if (mkdtemp(proc_root) == NULL) {
+        printf("cannot create %s\n", proc_root);
+        return EXIT_FAILURE;
+    }
+
+    /* the card has no mixer: no sidetone controls */
+    test_mixer.absent = true;
+    usb_init(&adev);
+    srand(1);
+    for (i = 0; i < num_corpus; i++) {
+        mismatches += fuzz_one(corpus[i].name, corpus[i].data, corpus[i].size, &queries);
+        for (n = 0; n < mutations; n++) {
+            memcpy(buf, corpus[i].data, corpus[i].size);
+            size = mutate(buf, corpus[i].size);
+            mismatches += fuzz_one(corpus[i].name, buf, size, &queries);
+        }
+        if (corpus[i].size > corpus[largest].size)
+            largest = i;
+    }
+    printf("%d corpus files, %d mutations each: %ld stream configs compared, %ld differ\n",
+           num_corpus, mutations, queries, mismatches);
+
+    bench(&corpus[largest]);
+
+    usb_deinit();
+    remove_card(FUZZ_CARD);
+    rmdir(proc_root);
+    for (i = 0; i < num_corpus; i++)
+        free(corpus[i].data);
+
+    return test_finish();
+}
@@ -33,6 +33,7 @@
 #include "platform.h"
 #include "platform_api.h"
 #include "audio_extn.h"
+#include "audio_perf.h"
 
 #ifdef DYNAMIC_LOG_ENABLED
 #include <log_xml_parser.h>
@@ -164,6 +165,10 @@ int voice_stop_usecase(struct audio_device *adev, audio_usecase_t usecase_id)
         return -EINVAL;
     }
 
+    if (session->perf_hint_held) {
+        audio_perf_hint_release(AUDIO_PERF_PROFILE_VOICE);
+        session->perf_hint_held = false;
+    }
     session->state.current = CALL_INACTIVE;
 
     /* Disable sidetone only when no calls are active */
@@ -245,12 +250,12 @@ int voice_start_usecase(struct audio_device *adev, audio_usecase_t usecase_id)
     uc_info->id = usecase_id;
     uc_info->type = VOICE_CALL;
     uc_info->stream.out = adev->current_call_output;
-    list_init(&uc_info->device_list);
-    assign_devices(&uc_info->device_list, &adev->current_call_output->device_list);
+    device_set_init(&uc_info->device_list);
+    device_set_assign(&uc_info->device_list, &adev->current_call_output->device_list.list);
 
-    if (is_in_call && list_length(&uc_info->device_list) == 2) {
+    if (is_in_call && list_length(&uc_info->device_list.list) == 2) {
         ALOGE("%s: Invalid combo device(%#x) for voice call", __func__,
-              get_device_types(&uc_info->device_list));
+              device_set_types(&uc_info->device_list));
         ret = -EIO;
         goto error_start_voice;
     }
@@ -259,9 +264,9 @@ int voice_start_usecase(struct audio_device *adev, audio_usecase_t usecase_id)
     uc_info->out_snd_device = SND_DEVICE_NONE;
     adev->voice.use_device_mute = false;
 
-    if (is_sco_out_device_type(&uc_info->device_list) && !adev->bt_sco_on) {
+    if (device_set_has(&uc_info->device_list, DEVICE_SET_SCO_OUT) && !adev->bt_sco_on) {
         ALOGE("start_call: couldn't find BT SCO, SCO is not ready");
-        adev->voice.in_call = false;
+        __atomic_store_n(&adev->voice.in_call, false, __ATOMIC_RELEASE);
         ret = -EIO;
         goto error_start_voice;
     }
@@ -383,6 +388,8 @@ int voice_start_usecase(struct audio_device *adev, audio_usecase_t usecase_id)
     }
 
     session->state.current = CALL_ACTIVE;
+    audio_perf_hint_acquire(AUDIO_PERF_PROFILE_VOICE);
+    session->perf_hint_held = true;
     goto done;
 
 error_start_voice:
@@ -425,14 +432,19 @@ bool voice_is_call_state_active(struct audio_device *adev)
     return voice_is_active(adev);
 }
 
+/*
+ * Lock-free: in_call and mode are published with release stores under
+ * adev->lock, see the lock order note in audio_hw.h.
+ */
 bool voice_is_in_call(const struct audio_device *adev)
 {
-    return adev->voice.in_call && adev->mode == AUDIO_MODE_IN_CALL;
+    return __atomic_load_n(&adev->voice.in_call, __ATOMIC_ACQUIRE) &&
+           __atomic_load_n(&adev->mode, __ATOMIC_ACQUIRE) == AUDIO_MODE_IN_CALL;
 }
 
 bool voice_is_in_call_or_call_screen(const struct audio_device *adev)
 {
-    return adev->voice.in_call;
+    return __atomic_load_n(&adev->voice.in_call, __ATOMIC_ACQUIRE);
 }
 
 bool voice_is_in_call_rec_stream(const struct stream_in *in)
@@ -702,7 +714,7 @@ int voice_start_call(struct audio_device *adev)
 {
     int ret = 0;
 
-    adev->voice.in_call = true;
+    __atomic_store_n(&adev->voice.in_call, true, __ATOMIC_RELEASE);
 
     voice_set_mic_mute(adev, adev->voice.mic_mute);
 
@@ -718,7 +730,7 @@ int voice_stop_call(struct audio_device *adev)
 {
     int ret = 0;
 
-    adev->voice.in_call = false;
+    __atomic_store_n(&adev->voice.in_call, false, __ATOMIC_RELEASE);
     ret = voice_extn_stop_call(adev);
     if (ret == -ENOSYS) {
         ret = voice_stop_usecase(adev, USECASE_VOICE_CALL);
@@ -827,7 +839,7 @@ void voice_init(struct audio_device *adev)
     adev->voice.hac = false;
     adev->voice.volume = 1.0f;
     adev->voice.mic_mute = false;
-    adev->voice.in_call = false;
+    __atomic_store_n(&adev->voice.in_call, false, __ATOMIC_RELEASE);
     for (i = 0; i < max_voice_sessions; i++) {
         adev->voice.session[i].pcm_rx = NULL;
         adev->voice.session[i].pcm_tx = NULL;
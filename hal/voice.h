@@ -51,6 +51,7 @@ struct voice_session {
     struct pcm *pcm_tx;
     struct call_state state;
     uint32_t vsid;
+    bool perf_hint_held;
 };
 
 struct voice {
@@ -450,7 +450,7 @@ int compress_voip_start_output_stream(struct stream_out *out)
         goto error;
     }
 
-    if (is_sco_out_device_type(&out->device_list)) {
+    if (device_set_has(&out->device_list, DEVICE_SET_SCO_OUT)) {
          if (!adev->bt_sco_on) {
              ALOGE("%s: SCO profile is not ready, return error", __func__);
              ret = -EAGAIN;
@@ -466,7 +466,7 @@ int compress_voip_start_output_stream(struct stream_out *out)
     uc_info = get_usecase_from_list(adev, USECASE_COMPRESS_VOIP_CALL);
     if (uc_info) {
         uc_info->stream.out = out;
-        assign_devices(&uc_info->device_list, &out->device_list);
+        device_set_assign(&uc_info->device_list, &out->device_list.list);
     } else {
         ret = -EINVAL;
         ALOGE("%s: exit(%d): failed to get use case info", __func__, ret);
@@ -492,7 +492,7 @@ int compress_voip_start_input_stream(struct stream_in *in)
         goto error;
     }
 
-    if (is_sco_in_device_type(&in->device_list) && !adev->bt_sco_on) {
+    if (device_set_has(&in->device_list, DEVICE_SET_SCO_IN) && !adev->bt_sco_on) {
         ret = -EIO;
         ALOGE("%s SCO is not ready return error %d", __func__,ret);
         goto error;
@@ -741,7 +741,7 @@ static int voip_start_call(struct audio_device *adev,
             uc_info->stream.out = adev->primary_output;
         uc_info->in_snd_device = SND_DEVICE_NONE;
         uc_info->out_snd_device = SND_DEVICE_NONE;
-        list_init(&uc_info->device_list);
+        device_set_init(&uc_info->device_list);
 
         list_add_tail(&adev->usecase_list, &uc_info->list);
 
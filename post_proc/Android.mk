@@ -258,4 +258,6 @@ endif
 include $(BUILD_SHARED_LIBRARY)
 
 endif
+
+include $(LOCAL_PATH)/test/Android.mk
 endif
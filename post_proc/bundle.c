@@ -81,6 +81,49 @@ const effect_descriptor_t *descriptors[] = {
         NULL,
 };
 
+/*
+ * Effect handles point into slots of a handle table instead of to the effect
+ * context. Slots are allocated in chunks that are never freed, so a stale
+ * handle can be validated in O(1) under the slot lock, without walking
+ * created_effects_list or touching freed memory.
+ *
+ * A slot is reused after its effect is released. To keep a stale handle from
+ * reaching the next effect created in the same slot, each slot has one handle
+ * word per generation (modulo EFFECT_SLOT_GENERATIONS) and the handle given
+ * out is the word of the slot's current generation. Release bumps the
+ * generation, so old handles stop matching until the slot went through
+ * EFFECT_SLOT_GENERATIONS more create/release cycles. Freed slots are reused
+ * in release order and a new chunk is added rather than letting the free list
+ * drop to EFFECT_SLOTS_PER_CHUNK entries, so a released handle is refused for
+ * at least EFFECT_SLOT_GENERATIONS * EFFECT_SLOTS_PER_CHUNK effect creations.
+ */
+#define EFFECT_SLOTS_PER_CHUNK 32
+#define EFFECT_SLOT_GENERATIONS 64
+
+typedef struct effect_slot_s effect_slot_t;
+
+typedef struct effect_handle_word_s {
+    /* must be first: effect_handle_t points to this member */
+    const struct effect_interface_s *itfe;
+    /* slot owning this word, constant once the chunk is allocated */
+    effect_slot_t *slot;
+} effect_handle_word_t;
+
+struct effect_slot_s {
+    /* node in free_slots_list */
+    struct listnode free_node;
+    /*
+     * serializes process, command and release of the effect in this slot.
+     * Lock order: lock (file scope) first, then slot lock.
+     */
+    pthread_mutex_t lock;
+    /* NULL when the slot is free */
+    effect_context_t *context;
+    /* incremented on each release, selects the live handle word */
+    uint32_t generation;
+    effect_handle_word_t handles[EFFECT_SLOT_GENERATIONS];
+};
+
 pthread_once_t once = PTHREAD_ONCE_INIT;
 int init_status;
 /*
@@ -95,9 +138,15 @@ struct listnode created_effects_list;
  * and offload_effects_bundle_hal_stop_output()
  */
 struct listnode active_outputs_list;
+/*
+ * list of free handle table slots, reused in release order
+ */
+struct listnode free_slots_list;
+int free_slots_count;
 /*
  * lock must be held when modifying or accessing
- * created_effects_list or active_outputs_list
+ * created_effects_list, active_outputs_list or free_slots_list.
+ * Effect processing and commands only take the per-effect slot lock.
  */
 pthread_mutex_t lock;
 
@@ -108,6 +157,7 @@ pthread_mutex_t lock;
 static void init_once() {
     list_init(&created_effects_list);
     list_init(&active_outputs_list);
+    list_init(&free_slots_list);
 
     pthread_mutex_init(&lock, NULL);
 
@@ -120,19 +170,71 @@ int lib_init()
     return init_status;
 }
 
-bool effect_exists(effect_context_t *context)
+/* lock must be held */
+static effect_slot_t *alloc_slot()
 {
     struct listnode *node;
-
-    list_for_each(node, &created_effects_list) {
-        effect_context_t *fx_ctxt = node_to_item(node,
-                                                 effect_context_t,
-                                                 effects_list_node);
-        if (fx_ctxt == context) {
-            return true;
+    effect_slot_t *slot;
+    int i, j;
+
+    if (free_slots_count <= EFFECT_SLOTS_PER_CHUNK) {
+        slot = (effect_slot_t *)calloc(EFFECT_SLOTS_PER_CHUNK, sizeof(effect_slot_t));
+        for (i = 0; slot != NULL && i < EFFECT_SLOTS_PER_CHUNK; i++) {
+            for (j = 0; j < EFFECT_SLOT_GENERATIONS; j++) {
+                slot[i].handles[j].itfe = &effect_interface;
+                slot[i].handles[j].slot = &slot[i];
+            }
+            pthread_mutex_init(&slot[i].lock, NULL);
+            list_add_tail(&free_slots_list, &slot[i].free_node);
+            free_slots_count++;
         }
     }
-    return false;
+    /* without a new chunk, fall back to reusing slots early */
+    if (list_empty(&free_slots_list))
+        return NULL;
+    node = list_head(&free_slots_list);
+    list_remove(node);
+    free_slots_count--;
+    return node_to_item(node, effect_slot_t, free_node);
+}
+
+/* lock must be held */
+static void free_slot(effect_slot_t *slot)
+{
+    list_add_tail(&free_slots_list, &slot->free_node);
+    free_slots_count++;
+}
+
+/* slot lock must be held */
+static effect_handle_word_t *slot_handle(effect_slot_t *slot)
+{
+    return &slot->handles[slot->generation % EFFECT_SLOT_GENERATIONS];
+}
+
+/*
+ * Returns the context of a live effect handle with its slot lock held,
+ * or NULL if the handle was released.
+ */
+static effect_context_t *lock_effect(effect_handle_t handle)
+{
+    effect_handle_word_t *word = (effect_handle_word_t *)handle;
+    effect_slot_t *slot;
+
+    if (word == NULL)
+        return NULL;
+
+    slot = word->slot;
+    pthread_mutex_lock(&slot->lock);
+    if (slot->context == NULL || word != slot_handle(slot)) {
+        pthread_mutex_unlock(&slot->lock);
+        return NULL;
+    }
+    return slot->context;
+}
+
+static void unlock_effect(effect_context_t *context)
+{
+    pthread_mutex_unlock(context->lock);
 }
 
 output_context_t *get_output(audio_io_handle_t output)
@@ -277,9 +379,11 @@ int offload_effects_bundle_hal_start_output(audio_io_handle_t output, int pcm_id
                                                  effect_context_t,
                                                  effects_list_node);
         if (fx_ctxt->out_handle == output) {
+            pthread_mutex_lock(fx_ctxt->lock);
             if (fx_ctxt->ops.start)
                 fx_ctxt->ops.start(fx_ctxt, out_ctxt);
             list_add_tail(&out_ctxt->effects_list, &fx_ctxt->output_node);
+            pthread_mutex_unlock(fx_ctxt->lock);
         }
     }
     list_add_tail(&active_outputs_list, &out_ctxt->outputs_list_node);
@@ -313,8 +417,10 @@ int offload_effects_bundle_hal_stop_output(audio_io_handle_t output, int pcm_id)
         effect_context_t *fx_ctxt = node_to_item(fx_node,
                                                  effect_context_t,
                                                  output_node);
+        pthread_mutex_lock(fx_ctxt->lock);
         if (fx_ctxt->ops.stop)
             fx_ctxt->ops.stop(fx_ctxt, out_ctxt);
+        pthread_mutex_unlock(fx_ctxt->lock);
     }
 
     list_remove(&out_ctxt->outputs_list_node);
@@ -366,9 +472,11 @@ int offload_effects_bundle_set_hpx_state(bool hpx_state)
                 effect_context_t *fx_ctxt = node_to_item(fx_node,
                                                          effect_context_t,
                                                          output_node);
+                pthread_mutex_lock(fx_ctxt->lock);
                 if ((fx_ctxt->state == EFFECT_STATE_ACTIVE) &&
                     (fx_ctxt->ops.stop != NULL))
                     fx_ctxt->ops.stop(fx_ctxt, out_ctxt);
+                pthread_mutex_unlock(fx_ctxt->lock);
             }
             out_ctxt->ctl = NULL;
         }
@@ -432,9 +540,11 @@ int offload_effects_bundle_set_hpx_state(bool hpx_state)
                 effect_context_t *fx_ctxt = node_to_item(fx_node,
                                                          effect_context_t,
                                                          output_node);
+                pthread_mutex_lock(fx_ctxt->lock);
                 if ((fx_ctxt->state == EFFECT_STATE_ACTIVE) &&
                     (fx_ctxt->ops.start != NULL))
                     fx_ctxt->ops.start(fx_ctxt, out_ctxt);
+                pthread_mutex_unlock(fx_ctxt->lock);
             }
         }
         /* wait for transition state - 50msec */
@@ -662,14 +772,26 @@ int effect_lib_create(const effect_uuid_t *uuid,
     context->state = EFFECT_STATE_INITIALIZED;
 
     pthread_mutex_lock(&lock);
+    effect_slot_t *slot = alloc_slot();
+    if (slot == NULL) {
+        pthread_mutex_unlock(&lock);
+        ALOGE("%s fail to allocate effect handle", __func__);
+        if (context->ops.release)
+            context->ops.release(context);
+        free(context);
+        return -ENOMEM;
+    }
+    pthread_mutex_lock(&slot->lock);
+    slot->context = context;
+    context->lock = &slot->lock;
     list_add_tail(&created_effects_list, &context->effects_list_node);
     output_context_t *out_ctxt = get_output(ioId);
     if (out_ctxt != NULL)
         add_effect_to_output(out_ctxt, context);
+    *pHandle = (effect_handle_t)&slot_handle(slot)->itfe;
+    pthread_mutex_unlock(&slot->lock);
     pthread_mutex_unlock(&lock);
 
-    *pHandle = (effect_handle_t)context;
-
     ALOGV("%s created context %p", __func__, context);
 
     return 0;
@@ -678,28 +800,37 @@ int effect_lib_create(const effect_uuid_t *uuid,
 
 int effect_lib_release(effect_handle_t handle)
 {
-    effect_context_t *context = (effect_context_t *)handle;
-    int status;
+    effect_slot_t *slot;
+    effect_context_t *context;
 
     if (lib_init() != 0)
         return init_status;
 
-    ALOGV("%s context %p", __func__, handle);
+    ALOGV("%s handle %p", __func__, handle);
     pthread_mutex_lock(&lock);
-    status = -EINVAL;
-    if (effect_exists(context)) {
-        output_context_t *out_ctxt = get_output(context->out_handle);
-        if (out_ctxt != NULL)
-            remove_effect_from_output(out_ctxt, context);
-        list_remove(&context->effects_list_node);
-        if (context->ops.release)
-            context->ops.release(context);
-        free(context);
-        status = 0;
+    context = lock_effect(handle);
+    if (context == NULL) {
+        pthread_mutex_unlock(&lock);
+        return -EINVAL;
     }
+    slot = ((effect_handle_word_t *)handle)->slot;
+    output_context_t *out_ctxt = get_output(context->out_handle);
+    if (out_ctxt != NULL)
+        remove_effect_from_output(out_ctxt, context);
+    list_remove(&context->effects_list_node);
+    /* once the slot is cleared and its generation moved on no other thread
+     * can reach the context, and handles to it are refused */
+    slot->context = NULL;
+    slot->generation++;
+    pthread_mutex_unlock(&slot->lock);
+    free_slot(slot);
     pthread_mutex_unlock(&lock);
 
-    return status;
+    if (context->ops.release)
+        context->ops.release(context);
+    free(context);
+
+    return 0;
 }
 
 int effect_lib_get_descriptor(const effect_uuid_t *uuid,
@@ -736,16 +867,14 @@ int effect_process(effect_handle_t self,
                        audio_buffer_t *inBuffer __unused,
                        audio_buffer_t *outBuffer __unused)
 {
-    effect_context_t * context = (effect_context_t *)self;
+    effect_context_t * context;
     int status = 0;
 
     ALOGV("%s", __func__);
 
-    pthread_mutex_lock(&lock);
-    if (!effect_exists(context)) {
-        status = -ENOSYS;
-        goto exit;
-    }
+    context = lock_effect(self);
+    if (context == NULL)
+        return -ENOSYS;
 
     if (context->state != EFFECT_STATE_ACTIVE) {
         status = -ENODATA;
@@ -755,7 +884,7 @@ int effect_process(effect_handle_t self,
     if (context->ops.process)
         status = context->ops.process(context, inBuffer, outBuffer);
 exit:
-    pthread_mutex_unlock(&lock);
+    unlock_effect(context);
     return status;
 }
 
@@ -763,18 +892,23 @@ int effect_command(effect_handle_t self, uint32_t cmdCode, uint32_t cmdSize,
                    void *pCmdData, uint32_t *replySize, void *pReplyData)
 {
 
-    effect_context_t * context = (effect_context_t *)self;
+    effect_context_t * context;
+    /* only EFFECT_CMD_OFFLOAD moves the effect between outputs */
+    bool list_locked = (cmdCode == EFFECT_CMD_OFFLOAD);
     int status = 0;
 
-    pthread_mutex_lock(&lock);
+    if (list_locked)
+        pthread_mutex_lock(&lock);
 
-    if (!effect_exists(context)) {
-        status = -ENOSYS;
-        goto exit;
+    context = lock_effect(self);
+    if (context == NULL) {
+        if (list_locked)
+            pthread_mutex_unlock(&lock);
+        return -ENOSYS;
     }
 
     ALOGV("%s: ctxt %p, cmd %d", __func__, context, cmdCode);
-    if (context == NULL || context->state == EFFECT_STATE_UNINITIALIZED) {
+    if (context->state == EFFECT_STATE_UNINITIALIZED) {
         status = -ENOSYS;
         goto exit;
     }
@@ -902,7 +1036,8 @@ int effect_command(effect_handle_t self, uint32_t cmdCode, uint32_t cmdSize,
         }
         if (pCmdData == NULL || cmdSize != 2 * sizeof(uint32_t) ||
                 replySize == NULL || *replySize < 2*sizeof(int32_t)) {
-            return -EINVAL;
+            status = -EINVAL;
+            goto exit;
         }
         memcpy(pReplyData, pCmdData, sizeof(int32_t)*2);
         } break;
@@ -946,7 +1081,8 @@ int effect_command(effect_handle_t self, uint32_t cmdCode, uint32_t cmdSize,
               cmdSize, pCmdData, *replySize, pReplyData);
         if (cmdSize != sizeof(uint32_t) || pCmdData == NULL
                 || pReplyData == NULL || *replySize != sizeof(int)) {
-            return -EINVAL;
+            status = -EINVAL;
+            goto exit;
         }
         uint32_t value = *(uint32_t *)pCmdData;
         if (context->ops.set_hw_acc_mode)
@@ -968,7 +1104,9 @@ int effect_command(effect_handle_t self, uint32_t cmdCode, uint32_t cmdSize,
     }
 
 exit:
-    pthread_mutex_unlock(&lock);
+    unlock_effect(context);
+    if (list_locked)
+        pthread_mutex_unlock(&lock);
 
     return status;
 }
@@ -977,12 +1115,17 @@ exit:
 int effect_get_descriptor(effect_handle_t   self,
                           effect_descriptor_t *descriptor)
 {
-    effect_context_t *context = (effect_context_t *)self;
+    effect_context_t *context;
+
+    if (descriptor == NULL)
+        return -EINVAL;
 
-    if (!effect_exists(context) || (descriptor == NULL))
+    context = lock_effect(self);
+    if (context == NULL)
         return -EINVAL;
 
     *descriptor = *context->desc;
+    unlock_effect(context);
 
     return 0;
 }
@@ -20,6 +20,7 @@
 #ifndef OFFLOAD_EFFECT_BUNDLE_H
 #define OFFLOAD_EFFECT_BUNDLE_H
 
+#include <pthread.h>
 #include <tinyalsa/asoundlib.h>
 #include <sound/audio_effects.h>
 #include "effect_api.h"
@@ -88,6 +89,8 @@ struct effect_context_s {
     bool offload_enabled;
     bool hw_acc_enabled;
     effect_ops_t ops;
+    /* per-effect lock, owned by the handle table slot of this context */
+    pthread_mutex_t *lock;
 };
 
 int set_config(effect_context_t *context, effect_config_t *config);
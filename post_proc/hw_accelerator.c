@@ -32,6 +32,7 @@
 /*#define LOG_NDEBUG 0*/
 
 #include <cutils/list.h>
+#include <cutils/properties.h>
 #include <log/log.h>
 #include <fcntl.h>
 #include <tinyalsa/asoundlib.h>
@@ -174,6 +175,10 @@ int hw_accelerator_init(effect_context_t *context)
 
     hw_acc_ctxt->fd = -1;
     memset(&(hw_acc_ctxt->cfg), 0, sizeof(struct msm_hwacc_effects_config));
+    memset(&(hw_acc_ctxt->buf_cfg), 0, sizeof(struct msm_hwacc_buf_cfg));
+    hw_acc_ctxt->buf_cfg_sent = false;
+    hw_acc_ctxt->in_flight = 0;
+    hw_acc_ctxt->pipeline_depth = HWACCELERATOR_DEFAULT_PIPELINE_DEPTH;
     enable_gcov();
     return 0;
 }
@@ -187,6 +192,7 @@ int hw_accelerator_reset(effect_context_t *context)
 int hw_accelerator_set_mode(effect_context_t *context, int32_t frame_count)
 {
     hw_accelerator_context_t *hw_acc_ctxt = (hw_accelerator_context_t *)context;
+    int32_t depth;
 
     ALOGV("%s: ctxt %p", __func__, hw_acc_ctxt);
     hw_acc_ctxt->cfg.output.sample_rate = context->config.inputCfg.samplingRate;
@@ -219,6 +225,21 @@ int hw_accelerator_set_mode(effect_context_t *context, int32_t frame_count)
                     hw_acc_ctxt->cfg.input.num_channels *
                     audio_bytes_per_sample(context->config.outputCfg.format);
 
+    /* buffer lengths are programmed once per mode and only resent when a
+     * process call comes with a different frame count */
+    hw_acc_ctxt->buf_cfg.output_len = hw_acc_ctxt->cfg.output.buf_size;
+    hw_acc_ctxt->buf_cfg.input_len = hw_acc_ctxt->cfg.input.buf_size;
+    hw_acc_ctxt->buf_cfg_sent = false;
+
+    depth = property_get_int32("vendor.audio.hw_acc.pipeline_depth",
+                               HWACCELERATOR_DEFAULT_PIPELINE_DEPTH);
+    if (depth < 1)
+        depth = 1;
+    if (depth > (int32_t)hw_acc_ctxt->cfg.output.num_buf - 1)
+        depth = hw_acc_ctxt->cfg.output.num_buf - 1;
+    hw_acc_ctxt->pipeline_depth = depth;
+    ALOGV("%s: pipeline depth %d", __func__, hw_acc_ctxt->pipeline_depth);
+
     hw_acc_ctxt->cfg.meta_mode_enabled = 0;
     /* TODO: overwrite this for effects using custom topology*/
     hw_acc_ctxt->cfg.overwrite_topology = 0;
@@ -254,6 +275,8 @@ int hw_accelerator_enable(effect_context_t *context)
         hw_acc_ctxt->fd = -1;
         return -EFAULT;
     }
+    hw_acc_ctxt->buf_cfg_sent = false;
+    hw_acc_ctxt->in_flight = 0;
     enable_gcov();
     return 0;
 }
@@ -267,6 +290,7 @@ int hw_accelerator_disable(effect_context_t *context)
         if (close(hw_acc_ctxt->fd) < 0)
             ALOGE("releasing hardware accelerated effects driver failed");
     hw_acc_ctxt->fd = -1;
+    hw_acc_ctxt->in_flight = 0;
     enable_gcov();
     return 0;
 }
@@ -284,6 +308,17 @@ int hw_accelerator_release(effect_context_t *context)
     return 0;
 }
 
+static int hw_accelerator_write(hw_accelerator_context_t *hw_acc_ctxt,
+                                audio_buffer_t *in_buf)
+{
+    if (ioctl(hw_acc_ctxt->fd, AUDIO_EFFECTS_WRITE, (char *)in_buf->raw) < 0) {
+        ALOGE("AUDIO_EFFECTS_WRITE failed");
+        return -EFAULT;
+    }
+    hw_acc_ctxt->in_flight++;
+    return 0;
+}
+
 int hw_accelerator_process(effect_context_t *context, audio_buffer_t *in_buf,
                            audio_buffer_t *out_buf)
 {
@@ -304,39 +339,48 @@ int hw_accelerator_process(effect_context_t *context, audio_buffer_t *in_buf,
                          audio_bytes_per_sample(context->config.outputCfg.format) *
                          hw_acc_ctxt->cfg.input.num_channels;
 
-    if (ioctl(hw_acc_ctxt->fd, AUDIO_EFFECTS_GET_BUF_AVAIL, &buf_avail) < 0) {
-        ALOGE("AUDIO_EFFECTS_GET_BUF_AVAIL failed");
-        return -ENOMEM;
-    }
-
-    if (!hw_acc_ctxt->intial_buffer_done) {
+    if (!hw_acc_ctxt->buf_cfg_sent ||
+            buf_cfg.output_len != hw_acc_ctxt->buf_cfg.output_len ||
+            buf_cfg.input_len != hw_acc_ctxt->buf_cfg.input_len) {
         if (ioctl(hw_acc_ctxt->fd, AUDIO_EFFECTS_SET_BUF_LEN, &buf_cfg) < 0) {
             ALOGE("AUDIO_EFFECTS_BUF_CFG failed");
             return -EFAULT;
         }
-        if (ioctl(hw_acc_ctxt->fd, AUDIO_EFFECTS_WRITE, (char *)in_buf->raw) < 0) {
-            ALOGE("AUDIO_EFFECTS_WRITE failed");
+        hw_acc_ctxt->buf_cfg = buf_cfg;
+        hw_acc_ctxt->buf_cfg_sent = true;
+    }
+
+    /* fill the pipeline before collecting the first processed buffer */
+    if (hw_acc_ctxt->in_flight < hw_acc_ctxt->pipeline_depth) {
+        if (hw_accelerator_write(hw_acc_ctxt, in_buf) < 0)
             return -EFAULT;
-        }
-        ALOGV("Request for more data");
-        hw_acc_ctxt->intial_buffer_done = true;
+        ALOGV("Request for more data, %d buffers queued", hw_acc_ctxt->in_flight);
         return -ENODATA;
     }
-    if (buf_avail.output_num_avail > 1) {
-        if (ioctl(hw_acc_ctxt->fd, AUDIO_EFFECTS_SET_BUF_LEN, &buf_cfg) < 0) {
-            ALOGE("AUDIO_EFFECTS_BUF_CFG failed");
+
+    /* submit buffer N+1 before collecting buffer N. The driver free count
+     * is only queried when local accounting says its queue is full. */
+    if (hw_acc_ctxt->in_flight < hw_acc_ctxt->cfg.output.num_buf) {
+        if (hw_accelerator_write(hw_acc_ctxt, in_buf) < 0)
             return -EFAULT;
+        ret = in_buf->frameCount;
+    } else {
+        if (ioctl(hw_acc_ctxt->fd, AUDIO_EFFECTS_GET_BUF_AVAIL, &buf_avail) < 0) {
+            ALOGE("AUDIO_EFFECTS_GET_BUF_AVAIL failed");
+            return -ENOMEM;
         }
-        if (ioctl(hw_acc_ctxt->fd, AUDIO_EFFECTS_WRITE, (char *)in_buf->raw) < 0) {
-            ALOGE("AUDIO_EFFECTS_WRITE failed");
-            return -EFAULT;
+        if (buf_avail.output_num_avail > 1) {
+            if (hw_accelerator_write(hw_acc_ctxt, in_buf) < 0)
+                return -EFAULT;
+            ret = in_buf->frameCount;
         }
-        ret = in_buf->frameCount;
     }
     if (ioctl(hw_acc_ctxt->fd, AUDIO_EFFECTS_READ, (char *)out_buf->raw) < 0) {
         ALOGE("AUDIO_EFFECTS_READ failed");
         return -EFAULT;
     }
+    if (hw_acc_ctxt->in_flight > 0)
+        hw_acc_ctxt->in_flight--;
 
     return ret;
 }
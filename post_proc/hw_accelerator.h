@@ -36,6 +36,9 @@
 #include <linux/msm_audio.h>
 
 #define HWACCELERATOR_OUTPUT_CHANNELS AUDIO_CHANNEL_OUT_STEREO
+/* buffers queued to the driver before the first read, can be raised up to
+ * cfg.output.num_buf - 1 through vendor.audio.hw_acc.pipeline_depth */
+#define HWACCELERATOR_DEFAULT_PIPELINE_DEPTH 1
 
 extern const effect_descriptor_t hw_accelerator_descriptor;
 
@@ -44,8 +47,13 @@ typedef struct hw_accelerator_context_s {
 
     int fd;
     uint32_t device;
-    bool intial_buffer_done;
     struct msm_hwacc_effects_config cfg;
+    /* buffer lengths last programmed with AUDIO_EFFECTS_SET_BUF_LEN */
+    struct msm_hwacc_buf_cfg buf_cfg;
+    bool buf_cfg_sent;
+    /* buffers written to the driver and not yet read back */
+    uint32_t in_flight;
+    uint32_t pipeline_depth;
 } hw_accelerator_context_t;
 
 int hw_accelerator_get_parameter(effect_context_t *context,
@@ -0,0 +1,73 @@
+LOCAL_PATH := $(call my-dir)
+
+# hw_accelerator_test
+# ==============================================================================
+# hw_accelerator.c against a userspace stand-in for /dev/msm_hweffects. Needs
+# the msm_audio.h uapi, so it is built for the target like the effect itself.
+ifeq ($(strip $(AUDIO_FEATURE_ENABLED_HW_ACCELERATED_EFFECTS)),true)
+include $(CLEAR_VARS)
+LOCAL_SRC_FILES := hw_accelerator_test.c
+LOCAL_MODULE := hw_accelerator_test
+LOCAL_MODULE_TAGS := optional
+LOCAL_VENDOR_MODULE := true
+LOCAL_MODULE_OWNER := qti
+
+LOCAL_CFLAGS += -Wall -Werror -Wno-sign-compare -Wno-unused-parameter -O2
+
+LOCAL_C_INCLUDES := \
+        $(LOCAL_PATH)/.. \
+        $(LOCAL_PATH)/../../hal/test \
+        external/tinyalsa/include \
+        $(TARGET_OUT_INTERMEDIATES)/KERNEL_OBJ/usr/include \
+        $(TARGET_OUT_INTERMEDIATES)/KERNEL_OBJ/usr/include/audio \
+        $(TARGET_OUT_INTERMEDIATES)/KERNEL_OBJ/usr/techpack/audio/include \
+        $(call include-path-for, audio-effects)
+LOCAL_ADDITIONAL_DEPENDENCIES += $(TARGET_OUT_INTERMEDIATES)/KERNEL_OBJ/usr
+
+ifeq ($(strip $(AUDIO_FEATURE_ENABLED_DLKM)),true)
+  LOCAL_HEADER_LIBRARIES += audio_kernel_headers
+  LOCAL_C_INCLUDES += $(TARGET_OUT_INTERMEDIATES)/vendor/qcom/opensource/audio-kernel/include
+endif
+
+LOCAL_HEADER_LIBRARIES += libhardware_headers \
+                          libsystem_headers \
+                          libutils_headers
+
+LOCAL_SHARED_LIBRARIES := liblog
+include $(BUILD_EXECUTABLE)
+endif
+
+# bundle_stress_test
+# ==============================================================================
+# bundle.c handle table under concurrent create/release/command, with fake
+# effects. Needs the audio_effects.h uapi like the bundle library.
+include $(CLEAR_VARS)
+LOCAL_SRC_FILES := bundle_stress_test.c
+LOCAL_MODULE := bundle_stress_test
+LOCAL_MODULE_TAGS := optional
+LOCAL_VENDOR_MODULE := true
+LOCAL_MODULE_OWNER := qti
+
+LOCAL_CFLAGS += -Wall -Werror -Wno-sign-compare -Wno-unused-parameter -O2
+
+LOCAL_C_INCLUDES := \
+        $(LOCAL_PATH)/.. \
+        $(LOCAL_PATH)/../../hal/test \
+        external/tinyalsa/include \
+        $(TARGET_OUT_INTERMEDIATES)/KERNEL_OBJ/usr/include \
+        $(TARGET_OUT_INTERMEDIATES)/KERNEL_OBJ/usr/include/audio \
+        $(TARGET_OUT_INTERMEDIATES)/KERNEL_OBJ/usr/techpack/audio/include \
+        $(call include-path-for, audio-effects)
+LOCAL_ADDITIONAL_DEPENDENCIES += $(TARGET_OUT_INTERMEDIATES)/KERNEL_OBJ/usr
+
+ifeq ($(strip $(AUDIO_FEATURE_ENABLED_DLKM)),true)
+  LOCAL_HEADER_LIBRARIES += audio_kernel_headers
+  LOCAL_C_INCLUDES += $(TARGET_OUT_INTERMEDIATES)/vendor/qcom/opensource/audio-kernel/include
+endif
+
+LOCAL_HEADER_LIBRARIES += libhardware_headers \
+                          libsystem_headers \
+                          libutils_headers
+
+LOCAL_SHARED_LIBRARIES := liblog
+include $(BUILD_EXECUTABLE)
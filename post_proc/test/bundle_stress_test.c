@@ -0,0 +1,310 @@
+/*
+ * Copyright (c) 2023 Qualcomm Innovation Center, Inc. All rights reserved.
+ * SPDX-License-Identifier: BSD-3-Clause-Clear
+ */
+
+/*
+ * Concurrency test for the offload effect bundle handle table.
+ *
+ * bundle.c is built with fake effect implementations. Worker threads create
+ * and release effects, send commands to their own live and just released
+ * handles, and fire commands at handles owned by other threads while those
+ * may be released at the same time. Another thread starts and stops the
+ * output the effects are attached to.
+ *
+ * Each worker checks that a live handle always reaches the context it was
+ * created for, and that a handle released by itself or by another worker is
+ * refused even once its slot was reused. A released handle may only be
+ * accepted again after at least EFFECT_SLOT_GENERATIONS *
+ * EFFECT_SLOTS_PER_CHUNK creates, when its generation came round; any
+ * earlier acceptance fails the test. A separate single threaded case forces
+ * slot reuse and checks the stale handle against the new effect in the same
+ * slot. Build with -fsanitize=address or thread to also catch use after free
+ * and races.
+ *
+ * usage: bundle_stress_test [seconds]
+ */
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "test_common.h"
+
+#include "../bundle.c"
+
+#define WORKERS             8
+#define HANDLES_PER_WORKER  4
+#define STRESS_OUTPUT       1
+
+/* fake effects: set_device records the context it ran on */
+static __thread effect_context_t *last_context;
+static atomic_uint fake_calls;
+
+#define FAKE_EFFECT(name)                                                      \
+int name##_get_parameter(effect_context_t *c, effect_param_t *p, uint32_t *s) \
+{ return 0; }                                                                  \
+int name##_set_parameter(effect_context_t *c, effect_param_t *p, uint32_t s)  \
+{ return 0; }                                                                  \
+int name##_set_device(effect_context_t *c, uint32_t device)                   \
+{ last_context = c; atomic_fetch_add(&fake_calls, 1); return 0; }             \
+int name##_set_mode(effect_context_t *c, int32_t fd) { return 0; }            \
+int name##_reset(effect_context_t *c) { return 0; }                           \
+int name##_init(effect_context_t *c) { return 0; }                            \
+int name##_enable(effect_context_t *c) { return 0; }                          \
+int name##_disable(effect_context_t *c) { return 0; }                         \
+int name##_start(effect_context_t *c, output_context_t *o) { return 0; }      \
+int name##_stop(effect_context_t *c, output_context_t *o) { return 0; }
+
+FAKE_EFFECT(equalizer)
+FAKE_EFFECT(bass)
+FAKE_EFFECT(virtualizer)
+FAKE_EFFECT(reverb)
+
+void reverb_auxiliary_init(reverb_context_t *context) {}
+void reverb_preset_init(reverb_context_t *context) {}
+void reverb_insert_init(reverb_context_t *context) {}
+
+#define FAKE_DESCRIPTOR(var, n)                                                 \
+const effect_descriptor_t var = {                                              \
+    .uuid = { 0x5e1f0000 + n, 0x1234, 0x5678, 0x9abc, { 0, 1, 2, 3, 4, 5 } },  \
+    .name = #var,                                                              \
+}
+
+FAKE_DESCRIPTOR(equalizer_descriptor, 1);
+FAKE_DESCRIPTOR(bassboost_descriptor, 2);
+FAKE_DESCRIPTOR(virtualizer_descriptor, 3);
+FAKE_DESCRIPTOR(aux_env_reverb_descriptor, 4);
+FAKE_DESCRIPTOR(ins_env_reverb_descriptor, 5);
+FAKE_DESCRIPTOR(aux_preset_reverb_descriptor, 6);
+FAKE_DESCRIPTOR(ins_preset_reverb_descriptor, 7);
+
+static const effect_descriptor_t *stress_effects[] = {
+    &equalizer_descriptor,
+    &bassboost_descriptor,
+    &virtualizer_descriptor,
+    &ins_env_reverb_descriptor,
+};
+
+static int fake_ctl;
+
+struct mixer_ctl *mixer_get_ctl_by_name(struct mixer *mixer, const char *name)
+{
+    return (struct mixer_ctl *)&fake_ctl;
+}
+
+int offload_transition_soft_volume_send_params(struct mixer_ctl *ctl,
+                                               struct soft_volume_params vol,
+                                               unsigned param_send_flags)
+{
+    return 0;
+}
+
+int offload_hpx_send_params(struct mixer_ctl *ctl, unsigned param_send_flags)
+{
+    return 0;
+}
+
+/* creations after which a released handle may alias a new effect */
+#define STALE_WINDOW (EFFECT_SLOT_GENERATIONS * EFFECT_SLOTS_PER_CHUNK)
+
+static atomic_bool stop;
+static atomic_uint total_creates;
+static atomic_uint window_wraps;
+/* handles published by workers for the other workers to poke at */
+static _Atomic(effect_handle_t) shared_handles[WORKERS * HANDLES_PER_WORKER];
+/* the last handle each worker released, and total_creates before that */
+static _Atomic(effect_handle_t) released_handles[WORKERS * HANDLES_PER_WORKER];
+static atomic_uint released_at[WORKERS * HANDLES_PER_WORKER];
+
+static int set_device(effect_handle_t handle, uint32_t device)
+{
+    return (*handle)->command(handle, EFFECT_CMD_SET_DEVICE, sizeof(device), &device,
+                              NULL, NULL);
+}
+
+static int enable(effect_handle_t handle, bool on)
+{
+    int reply;
+    uint32_t size = sizeof(reply);
+
+    return (*handle)->command(handle, on ? EFFECT_CMD_ENABLE : EFFECT_CMD_DISABLE,
+                              0, NULL, &size, &reply);
+}
+
+/*
+ * A released handle is refused, even if its slot was taken again, until the
+ * slot went through every generation. creates is total_creates sampled
+ * before the release, so it never undercounts the creates since then.
+ */
+static void check_released(effect_handle_t stale, unsigned int creates)
+{
+    unsigned int since;
+
+    last_context = NULL;
+    if (set_device(stale, 0) == -ENOSYS && last_context == NULL)
+        return;
+    since = atomic_load(&total_creates) - creates;
+    EXPECT(since >= STALE_WINDOW, "released handle accepted after %u creates", since);
+    atomic_fetch_add(&window_wraps, 1);
+}
+
+struct live_effect {
+    effect_handle_t handle;
+    effect_context_t *context;
+    const effect_descriptor_t *desc;
+};
+
+static void *worker(void *arg)
+{
+    int id = (int)(intptr_t)arg;
+    struct live_effect live[HANDLES_PER_WORKER];
+    unsigned int seed = id + 1;
+    unsigned long cycles = 0;
+    effect_descriptor_t desc;
+    effect_handle_t stale;
+    unsigned int creates;
+    int i, k;
+
+    memset(live, 0, sizeof(live));
+    while (!atomic_load(&stop)) {
+        i = rand_r(&seed) % HANDLES_PER_WORKER;
+        if (live[i].handle == NULL) {
+            live[i].desc = stress_effects[rand_r(&seed) % 4];
+            EXPECT(effect_lib_create(&live[i].desc->uuid, 0, STRESS_OUTPUT,
+                                     &live[i].handle) == 0, "create");
+            atomic_fetch_add(&total_creates, 1);
+            last_context = NULL;
+            EXPECT(set_device(live[i].handle, 0) == 0, "set_device on new handle");
+            live[i].context = last_context;
+            EXPECT(live[i].context != NULL, "no context reached");
+            atomic_store(&shared_handles[id * HANDLES_PER_WORKER + i], live[i].handle);
+            continue;
+        }
+
+        switch (rand_r(&seed) % 4) {
+        case 0:
+            /* own live handle reaches its own context */
+            last_context = NULL;
+            EXPECT(set_device(live[i].handle, cycles) == 0, "set_device");
+            EXPECT(last_context == live[i].context, "handle reached another context");
+            EXPECT(live[i].handle[0]->get_descriptor(live[i].handle, &desc) == 0 &&
+                   memcmp(&desc.uuid, &live[i].desc->uuid, sizeof(desc.uuid)) == 0,
+                   "descriptor of another effect");
+            break;
+        case 1:
+            enable(live[i].handle, rand_r(&seed) & 1);
+            break;
+        case 2:
+            /* someone else's handle, it may be released under our feet */
+            k = rand_r(&seed) % (WORKERS * HANDLES_PER_WORKER);
+            stale = atomic_load(&shared_handles[k]);
+            if (stale != NULL) {
+                set_device(stale, cycles);
+                stale[0]->get_descriptor(stale, &desc);
+                enable(stale, rand_r(&seed) & 1);
+            }
+            /* and one it already released: the handle is cleared before
+             * released_at changes, so reading it twice keeps the pair */
+            stale = atomic_load(&released_handles[k]);
+            creates = atomic_load(&released_at[k]);
+            if (stale != NULL && stale == atomic_load(&released_handles[k]))
+                check_released(stale, creates);
+            break;
+        case 3:
+            stale = live[i].handle;
+            k = id * HANDLES_PER_WORKER + i;
+            atomic_store(&shared_handles[k], NULL);
+            atomic_store(&released_handles[k], NULL);
+            creates = atomic_load(&total_creates);
+            EXPECT(effect_lib_release(stale) == 0, "release");
+            memset(&live[i], 0, sizeof(live[i]));
+            atomic_store(&released_at[k], creates);
+            atomic_store(&released_handles[k], stale);
+            check_released(stale, creates);
+            break;
+        }
+        cycles++;
+    }
+
+    for (i = 0; i < HANDLES_PER_WORKER; i++) {
+        if (live[i].handle == NULL)
+            continue;
+        atomic_store(&shared_handles[id * HANDLES_PER_WORKER + i], NULL);
+        effect_lib_release(live[i].handle);
+    }
+    return (void *)cycles;
+}
+
+static void *output_toggler(void *arg)
+{
+    unsigned long toggles = 0;
+
+    while (!atomic_load(&stop)) {
+        offload_effects_bundle_hal_start_output(STRESS_OUTPUT, 0, (struct mixer *)&fake_ctl);
+        usleep(100);
+        offload_effects_bundle_hal_stop_output(STRESS_OUTPUT, 0);
+        toggles++;
+    }
+    return (void *)toggles;
+}
+
+/* a released handle must not alias the next effect created in its slot */
+static void test_slot_reuse(void)
+{
+    effect_handle_t first, handle;
+    effect_context_t *context;
+    int i;
+
+    EXPECT(effect_lib_create(&equalizer_descriptor.uuid, 0, 0, &first) == 0, "create");
+    EXPECT(effect_lib_release(first) == 0, "release");
+
+    /* slots are reused in release order, cycle until the first one comes back */
+    for (i = 0; i < 4 * EFFECT_SLOTS_PER_CHUNK; i++) {
+        EXPECT(effect_lib_create(&virtualizer_descriptor.uuid, 0, 0, &handle) == 0, "create");
+        if (((effect_handle_word_t *)handle)->slot == ((effect_handle_word_t *)first)->slot)
+            break;
+        EXPECT(effect_lib_release(handle) == 0, "release");
+    }
+    EXPECT(i < 4 * EFFECT_SLOTS_PER_CHUNK, "slot never reused");
+    EXPECT(handle != first, "reused slot gave out the released handle");
+
+    last_context = NULL;
+    EXPECT(set_device(first, 0) == -ENOSYS && last_context == NULL, "stale handle accepted");
+    EXPECT(effect_lib_release(first) == -EINVAL, "stale release accepted");
+    EXPECT(set_device(handle, 0) == 0 && last_context != NULL, "new handle refused");
+    context = last_context;
+    EXPECT(context->desc == &virtualizer_descriptor, "new handle reached wrong effect");
+    EXPECT(effect_lib_release(handle) == 0, "release");
+}
+
+int main(int argc, char **argv)
+{
+    int seconds = argc > 1 ? atoi(argv[1]) : 3;
+    pthread_t workers[WORKERS], toggler;
+    unsigned long total = 0, toggles;
+    void *ret;
+    int i;
+
+    test_slot_reuse();
+
+    for (i = 0; i < WORKERS; i++)
+        pthread_create(&workers[i], NULL, worker, (void *)(intptr_t)i);
+    pthread_create(&toggler, NULL, output_toggler, NULL);
+    sleep(seconds);
+    atomic_store(&stop, true);
+    for (i = 0; i < WORKERS; i++) {
+        pthread_join(workers[i], &ret);
+        total += (unsigned long)ret;
+    }
+    pthread_join(toggler, &ret);
+    toggles = (unsigned long)ret;
+
+    EXPECT(list_empty(&created_effects_list), "effects left after release");
+    printf("%d workers, %lu operations, %u creates, %lu output start/stop, %u effect calls\n",
+           WORKERS, total, atomic_load(&total_creates), toggles, atomic_load(&fake_calls));
+    printf("released handles seen again after %d creates: %u\n",
+           STALE_WINDOW, atomic_load(&window_wraps));
+    return test_finish();
+}
@@ -0,0 +1,375 @@
+/*
+ * Copyright (c) 2023 Qualcomm Innovation Center, Inc. All rights reserved.
+ * SPDX-License-Identifier: BSD-3-Clause-Clear
+ */
+
+/*
+ * Test and benchmark for the hw_accelerator pipeline.
+ *
+ * hw_accelerator.c is built against a userspace stand-in for
+ * /dev/msm_hweffects: open/ioctl/close are redirected to a mock that keeps
+ * the driver buffer queue, counts each ioctl and finishes one buffer every
+ * MOCK_DSP_US after it was queued (one buffer at a time, like the DSP). The
+ * processed buffer is the first two channels of the 7.1 input.
+ *
+ * The test checks the ioctl pattern (buffer lengths sent once per frame
+ * count, no GET_BUF_AVAIL while the queue has room), that output comes back
+ * in order and delayed by the pipeline depth, and that disable/enable primes
+ * the pipeline again. It then compares throughput against the per buffer
+ * GET_BUF_AVAIL/SET_BUF_LEN/WRITE/READ sequence the effect used before.
+ *
+ * usage: hw_accelerator_test [buffers]
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <time.h>
+#include <unistd.h>
+#include "test_common.h"
+
+static int mock_open(const char *path, int flags, ...);
+static int mock_ioctl(int fd, unsigned long req, ...);
+static int mock_close(int fd);
+
+#define open mock_open
+#define ioctl mock_ioctl
+#define close mock_close
+#include "../hw_accelerator.c"
+#undef open
+#undef ioctl
+#undef close
+
+#define MOCK_FD             42
+#define MOCK_DSP_US         1000
+#define MOCK_HOST_US        1000
+#define MOCK_MAX_BUF        8
+#define FRAMES              240
+#define IN_CHANNELS         8
+#define OUT_CHANNELS        2
+
+struct mock_dev {
+    bool open;
+    bool started;
+    struct msm_hwacc_effects_config cfg;
+    struct msm_hwacc_buf_cfg buf_cfg;
+    int16_t queue[MOCK_MAX_BUF][FRAMES * IN_CHANNELS];
+    uint64_t ready_us[MOCK_MAX_BUF];
+    uint32_t head, count;
+    uint64_t dsp_free_us;
+    unsigned int n_set_buf_len, n_get_buf_avail, n_write, n_read;
+};
+
+static struct mock_dev dev;
+static int32_t prop_pipeline_depth = 1;
+
+static uint64_t now_us(void)
+{
+    return test_now_ns() / 1000;
+}
+
+static void sleep_until(uint64_t t)
+{
+    uint64_t now = now_us();
+
+    if (t > now)
+        usleep(t - now);
+}
+
+static int mock_open(const char *path, int flags, ...)
+{
+    if (strcmp(path, "/dev/msm_hweffects") != 0 || dev.open) {
+        errno = ENOENT;
+        return -1;
+    }
+    dev.open = true;
+    dev.started = false;
+    dev.head = dev.count = 0;
+    dev.dsp_free_us = 0;
+    return MOCK_FD;
+}
+
+static int mock_close(int fd)
+{
+    if (fd != MOCK_FD || !dev.open) {
+        errno = EBADF;
+        return -1;
+    }
+    dev.open = false;
+    return 0;
+}
+
+static int mock_ioctl(int fd, unsigned long req, ...)
+{
+    va_list ap;
+    void *arg;
+    uint64_t now;
+    uint32_t slot, i;
+
+    va_start(ap, req);
+    arg = va_arg(ap, void *);
+    va_end(ap);
+
+    if (fd != MOCK_FD || !dev.open) {
+        errno = EBADF;
+        return -1;
+    }
+
+    switch (req) {
+    case AUDIO_SET_EFFECTS_CONFIG:
+        dev.cfg = *(struct msm_hwacc_effects_config *)arg;
+        if (dev.cfg.output.num_buf > MOCK_MAX_BUF) {
+            errno = EINVAL;
+            return -1;
+        }
+        return 0;
+    case AUDIO_START:
+        dev.started = true;
+        return 0;
+    case AUDIO_EFFECTS_SET_BUF_LEN:
+        dev.n_set_buf_len++;
+        dev.buf_cfg = *(struct msm_hwacc_buf_cfg *)arg;
+        return 0;
+    case AUDIO_EFFECTS_GET_BUF_AVAIL: {
+        struct msm_hwacc_buf_avail *avail = arg;
+
+        dev.n_get_buf_avail++;
+        avail->output_num_avail = dev.cfg.output.num_buf - dev.count;
+        avail->input_num_avail = dev.count;
+        return 0;
+    }
+    case AUDIO_EFFECTS_WRITE:
+        dev.n_write++;
+        if (!dev.started || dev.count == dev.cfg.output.num_buf ||
+                dev.buf_cfg.output_len > sizeof(dev.queue[0])) {
+            errno = EBUSY;
+            return -1;
+        }
+        now = now_us();
+        slot = (dev.head + dev.count) % dev.cfg.output.num_buf;
+        memcpy(dev.queue[slot], arg, dev.buf_cfg.output_len);
+        /* the DSP works on one buffer at a time */
+        dev.dsp_free_us = (dev.dsp_free_us > now ? dev.dsp_free_us : now) + MOCK_DSP_US;
+        dev.ready_us[slot] = dev.dsp_free_us;
+        dev.count++;
+        return 0;
+    case AUDIO_EFFECTS_READ: {
+        int16_t *out = arg;
+        int16_t *in;
+
+        dev.n_read++;
+        if (dev.count == 0) {
+            errno = EAGAIN;
+            return -1;
+        }
+        slot = dev.head;
+        sleep_until(dev.ready_us[slot]);
+        in = dev.queue[slot];
+        for (i = 0; i < dev.buf_cfg.input_len / (OUT_CHANNELS * sizeof(int16_t)); i++) {
+            out[OUT_CHANNELS * i] = in[IN_CHANNELS * i];
+            out[OUT_CHANNELS * i + 1] = in[IN_CHANNELS * i + 1];
+        }
+        dev.head = (dev.head + 1) % dev.cfg.output.num_buf;
+        dev.count--;
+        return 0;
+    }
+    default:
+        errno = ENOTTY;
+        return -1;
+    }
+}
+
+int32_t property_get_int32(const char *key, int32_t default_value)
+{
+    if (strcmp(key, "vendor.audio.hw_acc.pipeline_depth") == 0)
+        return prop_pipeline_depth;
+    return default_value;
+}
+
+int set_config(effect_context_t *context, effect_config_t *config)
+{
+    context->config = *config;
+    return 0;
+}
+
+int hw_acc_hpx_send_params(int fd, unsigned param_send_flags)
+{
+    return 0;
+}
+
+static void fill_input(int16_t *buf, size_t frames, int16_t seq)
+{
+    size_t i, c;
+
+    for (i = 0; i < frames; i++)
+        for (c = 0; c < IN_CHANNELS; c++)
+            buf[IN_CHANNELS * i + c] = (c < OUT_CHANNELS) ? seq : -1;
+}
+
+static void setup(hw_accelerator_context_t *ctxt, int32_t depth)
+{
+    memset(ctxt, 0, sizeof(*ctxt));
+    memset(&dev, 0, sizeof(dev));
+    prop_pipeline_depth = depth;
+    hw_accelerator_init(&ctxt->common);
+    hw_accelerator_set_mode(&ctxt->common, FRAMES);
+}
+
+/* runs n process calls and checks the returned data against the input
+ * sequence delayed by the pipeline depth */
+static int run_pipeline(hw_accelerator_context_t *ctxt, int n, int host_us, size_t frames)
+{
+    static int16_t in[FRAMES * IN_CHANNELS];
+    static int16_t out[FRAMES * OUT_CHANNELS];
+    audio_buffer_t in_buf = { .frameCount = frames, .raw = in };
+    audio_buffer_t out_buf = { .frameCount = frames, .raw = out };
+    int depth = ctxt->pipeline_depth;
+    int i, ret, errors = 0;
+
+    for (i = 0; i < n; i++) {
+        if (host_us)
+            usleep(host_us);
+        fill_input(in, frames, (int16_t)i);
+        out[0] = out[1] = INT16_MIN;
+        ret = hw_accelerator_process(&ctxt->common, &in_buf, &out_buf);
+        if (i < depth) {
+            if (ret != -ENODATA)
+                errors++;
+            continue;
+        }
+        if (ret != (int)frames || out[0] != i - depth || out[1] != i - depth ||
+                out[OUT_CHANNELS * (frames - 1)] != i - depth)
+            errors++;
+    }
+    return errors;
+}
+
+static void test_ioctl_pattern(int n)
+{
+    hw_accelerator_context_t ctxt;
+    int32_t depth;
+
+    for (depth = 1; depth <= 3; depth++) {
+        setup(&ctxt, depth);
+        EXPECT(ctxt.pipeline_depth == (uint32_t)depth, "depth %u", ctxt.pipeline_depth);
+        EXPECT(hw_accelerator_enable(&ctxt.common) == 0, "enable");
+        EXPECT(run_pipeline(&ctxt, n, 0, FRAMES) == 0, "depth %d: out of order output", depth);
+        EXPECT(dev.n_set_buf_len == 1, "depth %d: %u SET_BUF_LEN", depth, dev.n_set_buf_len);
+        EXPECT(dev.n_get_buf_avail == 0, "depth %d: %u GET_BUF_AVAIL",
+               depth, dev.n_get_buf_avail);
+        EXPECT(dev.n_write == (unsigned)n && dev.n_read == (unsigned)(n - depth),
+               "depth %d: %u writes %u reads", depth, dev.n_write, dev.n_read);
+        hw_accelerator_disable(&ctxt.common);
+    }
+
+    /* depth is capped below the driver queue size */
+    setup(&ctxt, 16);
+    EXPECT(ctxt.pipeline_depth == ctxt.cfg.output.num_buf - 1, "cap %u", ctxt.pipeline_depth);
+}
+
+static void test_frame_count_change(void)
+{
+    hw_accelerator_context_t ctxt;
+
+    setup(&ctxt, 1);
+    hw_accelerator_enable(&ctxt.common);
+    run_pipeline(&ctxt, 10, 0, FRAMES);
+    EXPECT(dev.n_set_buf_len == 1, "%u SET_BUF_LEN", dev.n_set_buf_len);
+    hw_accelerator_disable(&ctxt.common);
+
+    /* a shorter period is programmed once more, not per buffer */
+    hw_accelerator_enable(&ctxt.common);
+    dev.n_set_buf_len = 0;
+    EXPECT(run_pipeline(&ctxt, 10, 0, FRAMES / 2) == 0, "short period output");
+    EXPECT(dev.n_set_buf_len == 1, "%u SET_BUF_LEN", dev.n_set_buf_len);
+    EXPECT(dev.buf_cfg.output_len == FRAMES / 2 * IN_CHANNELS * sizeof(int16_t),
+           "output_len %u", dev.buf_cfg.output_len);
+    hw_accelerator_disable(&ctxt.common);
+}
+
+static void test_reenable_primes(void)
+{
+    hw_accelerator_context_t ctxt;
+
+    setup(&ctxt, 2);
+    hw_accelerator_enable(&ctxt.common);
+    EXPECT(run_pipeline(&ctxt, 5, 0, FRAMES) == 0, "first enable");
+    hw_accelerator_disable(&ctxt.common);
+    EXPECT(ctxt.in_flight == 0, "in_flight %u after disable", ctxt.in_flight);
+    hw_accelerator_enable(&ctxt.common);
+    /* run_pipeline expects -ENODATA for the first depth calls again */
+    EXPECT(run_pipeline(&ctxt, 5, 0, FRAMES) == 0, "second enable");
+    hw_accelerator_disable(&ctxt.common);
+}
+
+/* the per buffer sequence hw_accelerator_process issued before pipelining */
+static double bench_serial(int n)
+{
+    static int16_t in[FRAMES * IN_CHANNELS];
+    static int16_t out[FRAMES * OUT_CHANNELS];
+    struct msm_hwacc_buf_avail avail;
+    struct msm_hwacc_buf_cfg buf_cfg = {
+        .input_len = sizeof(out),
+        .output_len = sizeof(in),
+    };
+    hw_accelerator_context_t ctxt;
+    uint64_t t0;
+    int i;
+
+    setup(&ctxt, 1);
+    hw_accelerator_enable(&ctxt.common);
+    t0 = now_us();
+    for (i = 0; i < n; i++) {
+        usleep(MOCK_HOST_US);
+        fill_input(in, FRAMES, (int16_t)i);
+        mock_ioctl(ctxt.fd, AUDIO_EFFECTS_GET_BUF_AVAIL, &avail);
+        mock_ioctl(ctxt.fd, AUDIO_EFFECTS_SET_BUF_LEN, &buf_cfg);
+        mock_ioctl(ctxt.fd, AUDIO_EFFECTS_WRITE, in);
+        mock_ioctl(ctxt.fd, AUDIO_EFFECTS_READ, out);
+    }
+    hw_accelerator_disable(&ctxt.common);
+    return (double)(now_us() - t0) / n;
+}
+
+static double bench_pipelined(int n, int32_t depth)
+{
+    hw_accelerator_context_t ctxt;
+    uint64_t t0;
+
+    setup(&ctxt, depth);
+    hw_accelerator_enable(&ctxt.common);
+    t0 = now_us();
+    EXPECT(run_pipeline(&ctxt, n, MOCK_HOST_US, FRAMES) == 0, "depth %d output", depth);
+    hw_accelerator_disable(&ctxt.common);
+    return (double)(now_us() - t0) / n;
+}
+
+int main(int argc, char **argv)
+{
+    int n = argc > 1 ? atoi(argv[1]) : 200;
+    double serial, pipelined;
+    int32_t depth;
+
+    if (n < 10)
+        n = 10;
+
+    test_ioctl_pattern(n);
+    test_frame_count_change();
+    test_reenable_primes();
+
+    printf("%d buffers of %d frames, host %d us and DSP %d us per buffer\n",
+           n, FRAMES, MOCK_HOST_US, MOCK_DSP_US);
+    serial = bench_serial(n);
+    printf("  serial (4 ioctls per buffer): %7.1f us/buffer\n", serial);
+    for (depth = 1; depth <= 3; depth++) {
+        pipelined = bench_pipelined(n, depth);
+        printf("  pipelined, depth %d:           %7.1f us/buffer (%.2fx)\n",
+               depth, pipelined, serial / pipelined);
+    }
+
+    return test_finish();
+}
@@ -15,13 +15,15 @@ LOCAL_HEADER_LIBRARIES := libutils_headers \
 
 LOCAL_SRC_FILES := \
     src/qahw.c \
-    src/qahw_effect.c
+    src/qahw_effect.c \
+    src/qahw_shm_transport.c
 
 LOCAL_SHARED_LIBRARIES := \
     liblog \
     libcutils \
     libhardware \
-    libdl
+    libdl \
+    libbinder_ndk
 
 LOCAL_CFLAGS += -Wall -Werror
 
@@ -192,6 +192,19 @@ int qahw_out_set_volume_l(qahw_stream_handle_t *stream, float left, float right)
 ssize_t qahw_out_write_l(qahw_stream_handle_t *stream,
                        qahw_out_buffer_t *out_buf);
 
+/*
+ * Write count buffers under a single stream lock. Consecutive buffers without
+ * a timestamp of their own are joined into one driver write of up to the
+ * stream buffer size when the format is a plain byte stream (PCM, MP3, ADTS
+ * AAC, AC3/E-AC3, DTS, IEC61937); otherwise each buffer is written separately.
+ * Bytes taken from each buffer are returned in consumed (may be NULL).
+ * Returns the total bytes written, stopping at the first short write, or a
+ * negative status_t if nothing was written.
+ */
+ssize_t qahw_out_writev_l(qahw_stream_handle_t *stream,
+                          qahw_out_buffer_t *out_bufs, size_t count,
+                          size_t *consumed);
+
 /*
  * return the number of audio frames written by the audio dsp to DAC since
  * the output has exited standby
@@ -360,10 +373,25 @@ char* qahw_in_get_parameters_l(const qahw_stream_handle_t *in_handle,
  */
 ssize_t qahw_in_read_l(qahw_stream_handle_t *in_handle,
                      qahw_in_buffer_t *in_buf);
+/*
+ * Read into count buffers under a single stream lock. PCM capture without
+ * timestamp or passthrough mode fills consecutive buffers with one driver
+ * read of up to the stream buffer size. Bytes placed in each buffer are
+ * returned in consumed (may be NULL). Returns the total bytes read, stopping
+ * at the first short read, or a negative status_t if nothing was read.
+ */
+ssize_t qahw_in_readv_l(qahw_stream_handle_t *in_handle,
+                        qahw_in_buffer_t *in_bufs, size_t count,
+                        size_t *consumed);
 /*
  * Stop input stream. Returns zero on success.
  */
 int qahw_in_stop_l(qahw_stream_handle_t *in_handle);
+
+/* API to get capture stream specific config parameters */
+int qahw_in_get_param_data_l(qahw_stream_handle_t *in_handle,
+                             qahw_param_id param_id,
+                             qahw_param_payload *payload);
 /*
  * Return the amount of input frames lost in the audio driver since the
  * last call of this function.
@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2019, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef QTI_AUDIO_QAHW_SHM_TRANSPORT_H
+#define QTI_AUDIO_QAHW_SHM_TRANSPORT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/cdefs.h>
+#include <sys/types.h>
+
+__BEGIN_DECLS
+
+/*
+ * Shared memory data plane for stream write/read when qahw calls are routed
+ * through the QTI audio server.
+ *
+ * The client maps a shared region (ashmem, memfd off Android) holding a
+ * request header and a payload area, plus two eventfd doorbells. A write or
+ * read copies the payload into/out of the region, bumps the request index and
+ * rings the server doorbell; the server thread bound to the stream runs the
+ * call through qahw_out_write_l()/qahw_in_read_l() and publishes the result
+ * with the completion index. Calls stay synchronous so HAL pacing, partial
+ * writes and error codes reach the client unchanged.
+ *
+ * The descriptors are handed to the server over a local socket; the stream is
+ * then bound with the QAHW_SHM_TRANSPORT_KEY set_parameters key, which already
+ * travels over the binder control path. The cookie is random, and a transport
+ * only binds to a stream of the process that sent it. The client seals the
+ * region size so that it cannot be shrunk under the server mapping.
+ */
+
+/* property enabling the data plane, read by both client and server */
+#define QAHW_SHM_TRANSPORT_PROPERTY "vendor.audio.qas.shm_transport.enable"
+/* stream set_parameters key binding a transport, value is the cookie */
+#define QAHW_SHM_TRANSPORT_KEY "qahw_shm_transport"
+
+typedef enum {
+    QAHW_SHM_OP_WRITE = 1,
+    QAHW_SHM_OP_READ,
+} qahw_shm_op_t;
+
+typedef struct qahw_shm_transport qahw_shm_transport_t;
+
+/* One call as seen by the server handler. */
+typedef struct {
+    qahw_shm_op_t op;
+    void *buffer;          /* payload in the shared region */
+    size_t bytes;          /* bytes to write, or buffer size to read into */
+    int64_t timestamp;     /* in: write timestamp, out: read timestamp */
+    bool has_timestamp;
+    uint32_t flags;        /* qahw_meta_data_flags_t of the write */
+} qahw_shm_request_t;
+
+typedef ssize_t (*qahw_shm_handler_t)(void *cookie, qahw_shm_request_t *req);
+
+/* Client side */
+
+/* Allocates a transport able to carry up to capacity bytes per call. */
+int qahw_shm_transport_create(size_t capacity, qahw_shm_transport_t **transport);
+/* Hands the descriptors to the server listener, returns the binding cookie. */
+int qahw_shm_transport_connect(qahw_shm_transport_t *transport, uint64_t *cookie);
+/*
+ * Runs one call, splitting buffers larger than the capacity. Returns the
+ * handler result. While waiting for the server, is_dead (if not NULL) is
+ * polled every few hundred ms and the call fails with -ENODEV once it
+ * returns true.
+ */
+ssize_t qahw_shm_transport_call(qahw_shm_transport_t *transport,
+                                qahw_shm_request_t *req, bool (*is_dead)(void));
+
+/* Server side */
+
+/* Starts the socket listener collecting client transports. */
+int qahw_shm_transport_listen(void);
+/*
+ * Binds a collected transport to a stream and starts its server thread.
+ * Fails with -EPERM unless the transport was sent by owner_pid/owner_uid, the
+ * process on whose behalf the stream is bound.
+ */
+int qahw_shm_transport_bind(uint64_t cookie, pid_t owner_pid, uid_t owner_uid,
+                            const void *stream, qahw_shm_handler_t handler,
+                            void *handler_cookie);
+/* Stops and frees the transport bound to stream, if any. */
+void qahw_shm_transport_unbind(const void *stream);
+/* Starts a server thread on a transport shared by other means, e.g. fork(). */
+int qahw_shm_transport_serve(qahw_shm_transport_t *transport,
+                             qahw_shm_handler_t handler, void *handler_cookie);
+
+/* Both sides: unmaps and closes the transport. */
+void qahw_shm_transport_destroy(qahw_shm_transport_t *transport);
+
+__END_DECLS
+
+#endif /* QTI_AUDIO_QAHW_SHM_TRANSPORT_H */
@@ -34,11 +34,18 @@
 #include <dlfcn.h>
 #include <utils/Log.h>
 #include <stdlib.h>
+#include <string.h>
 #include <cutils/list.h>
 #include <pthread.h>
 #include <hardware/audio.h>
 #include <hardware/sound_trigger.h>
+#include <cutils/properties.h>
+#include <unistd.h>
+#ifdef ANDROID
+#include <android/binder_ibinder.h>
+#endif
 #include "qahw.h"
+#include "qahw_shm_transport.h"
 
 #define NO_ERROR 0
 #define MAX_MODULE_NAME_LENGTH  100
@@ -68,6 +75,10 @@ typedef uint64_t (*qahwi_in_read_v2_t)(audio_stream_in_t *in, void* buffer,
 
 typedef int (*qahwi_in_stop_t)(audio_stream_in_t *in);
 
+typedef int (*qahwi_in_get_param_data_t)(audio_stream_in_t *in,
+                                      qahw_param_id param_id,
+                                      qahw_param_payload *payload);
+
 typedef int (*qahwi_out_set_param_data_t)(struct audio_stream_out *out,
                                       qahw_param_id param_id,
                                       qahw_param_payload *payload);
@@ -108,6 +119,8 @@ typedef struct {
     qahwi_out_set_param_data_t qahwi_out_get_param_data;
     qahwi_out_get_param_data_t qahwi_out_set_param_data;
     qahwi_out_write_v2_t qahwi_out_write_v2;
+    void *vec_buf;            /* staging for coalesced qahw_out_writev_l() */
+    size_t vec_buf_size;
 } qahw_stream_out_t;
 
 typedef struct {
@@ -117,6 +130,9 @@ typedef struct {
     pthread_mutex_t lock;
     qahwi_in_read_v2_t qahwi_in_read_v2;
     qahwi_in_stop_t qahwi_in_stop;
+    qahwi_in_get_param_data_t qahwi_in_get_param_data;
+    void *vec_buf;            /* staging for coalesced qahw_in_readv_l() */
+    size_t vec_buf_size;
 } qahw_stream_in_t;
 
 typedef enum {
@@ -376,6 +392,61 @@ exit:
     return rc;
 }
 
+static ssize_t shm_out_write(void *stream, qahw_shm_request_t *req)
+{
+    qahw_out_buffer_t out_buf;
+
+    memset(&out_buf, 0, sizeof(out_buf));
+    out_buf.buffer = req->buffer;
+    out_buf.bytes = req->bytes;
+    out_buf.timestamp = req->has_timestamp ? &req->timestamp : NULL;
+    out_buf.flags = (qahw_meta_data_flags_t)req->flags;
+    return qahw_out_write_l((qahw_stream_handle_t *)stream, &out_buf);
+}
+
+static ssize_t shm_in_read(void *stream, qahw_shm_request_t *req)
+{
+    qahw_in_buffer_t in_buf;
+
+    memset(&in_buf, 0, sizeof(in_buf));
+    in_buf.buffer = req->buffer;
+    in_buf.bytes = req->bytes;
+    in_buf.timestamp = req->has_timestamp ? &req->timestamp : NULL;
+    return qahw_in_read_l((qahw_stream_handle_t *)stream, &in_buf);
+}
+
+/*
+ * Binds a shared memory transport to the stream when kv_pairs is the
+ * QAHW_SHM_TRANSPORT_KEY sent by the qahw_api client after stream open.
+ * Returns true if kv_pairs was consumed, with the result in rc.
+ */
+static bool shm_transport_set_parameters(qahw_stream_handle_t *stream,
+                                         const char *kv_pairs,
+                                         qahw_shm_handler_t handler, int *rc)
+{
+    size_t key_len = strlen(QAHW_SHM_TRANSPORT_KEY);
+
+    pid_t pid;
+    uid_t uid;
+
+    if (kv_pairs == NULL || strncmp(kv_pairs, QAHW_SHM_TRANSPORT_KEY, key_len) ||
+            kv_pairs[key_len] != '=')
+        return false;
+
+    /* the stream owner: the binder caller when the call comes through the QTI
+     * audio server, this process when qahw is called directly */
+#ifdef ANDROID
+    pid = AIBinder_getCallingPid();
+    uid = AIBinder_getCallingUid();
+#else
+    pid = getpid();
+    uid = getuid();
+#endif
+    *rc = qahw_shm_transport_bind(strtoull(kv_pairs + key_len + 1, NULL, 10),
+                                  pid, uid, stream, handler, stream);
+    return true;
+}
+
 int qahw_out_set_parameters_l(qahw_stream_handle_t *out_handle, const char *kv_pairs)
 {
     int rc = NO_ERROR;
@@ -388,6 +459,9 @@ int qahw_out_set_parameters_l(qahw_stream_handle_t *out_handle, const char *kv_p
         goto exit;
     }
 
+    if (shm_transport_set_parameters(out_handle, kv_pairs, shm_out_write, &rc))
+        goto exit;
+
     pthread_mutex_lock(&qahw_stream_out->lock);
     out = qahw_stream_out->stream;
     if (out->common.set_parameters) {
@@ -537,12 +611,27 @@ exit:
    return rc;
 }
 
+/* Called with the stream lock held */
+static ssize_t out_write_locked(qahw_stream_out_t *qahw_stream_out,
+                                const void *buffer, size_t bytes,
+                                int64_t *timestamp)
+{
+    audio_stream_out_t *out = qahw_stream_out->stream;
+
+    if (qahw_stream_out->qahwi_out_write_v2)
+        return qahw_stream_out->qahwi_out_write_v2(out, buffer, bytes, timestamp);
+    if (out->write)
+        return out->write(out, buffer, bytes);
+
+    ALOGW("%s not supported", __func__);
+    return -ENOSYS;
+}
+
 ssize_t qahw_out_write_l(qahw_stream_handle_t *out_handle,
         qahw_out_buffer_t *out_buf)
 {
     int rc = -EINVAL;
     qahw_stream_out_t *qahw_stream_out = (qahw_stream_out_t *)out_handle;
-    audio_stream_out_t *out = NULL;
 
     if ((out_buf == NULL) || (out_buf->buffer == NULL)) {
         ALOGE("%s::Invalid meta data %p", __func__, out_buf);
@@ -556,18 +645,153 @@ ssize_t qahw_out_write_l(qahw_stream_handle_t *out_handle,
 
     /*TBD:: validate other meta data parameters */
     pthread_mutex_lock(&qahw_stream_out->lock);
-    out = qahw_stream_out->stream;
-    if (qahw_stream_out->qahwi_out_write_v2) {
-        rc = qahw_stream_out->qahwi_out_write_v2(out, out_buf->buffer,
-                                         out_buf->bytes, out_buf->timestamp);
+    rc = out_write_locked(qahw_stream_out, out_buf->buffer, out_buf->bytes,
+                          out_buf->timestamp);
+    if (qahw_stream_out->qahwi_out_write_v2)
         out_buf->offset = 0;
-    } else if (out->write) {
-        rc = out->write(out, out_buf->buffer, out_buf->bytes);
-    } else {
-        rc = -ENOSYS;
-        ALOGW("%s not supported", __func__);
+    pthread_mutex_unlock(&qahw_stream_out->lock);
+exit:
+    return rc;
+}
+
+/*
+ * Formats whose byte stream can be joined at any access unit boundary, so
+ * consecutive buffers may reach the driver as a single write.
+ */
+static bool is_concatenable_format(audio_format_t format)
+{
+    if (audio_is_linear_pcm(format))
+        return true;
+
+    switch (format & AUDIO_FORMAT_MAIN_MASK) {
+    case AUDIO_FORMAT_MP3:
+    case AUDIO_FORMAT_AAC_ADTS:
+    case AUDIO_FORMAT_AC3:
+    case AUDIO_FORMAT_E_AC3:
+    case AUDIO_FORMAT_DTS:
+    case AUDIO_FORMAT_DTS_HD:
+    case AUDIO_FORMAT_IEC61937:
+        return true;
+    default:
+        return false;
+    }
+}
+
+static void *vec_buf_get(void **buf, size_t *size, size_t bytes)
+{
+    void *tmp;
+
+    if (bytes <= *size)
+        return *buf;
+
+    tmp = realloc(*buf, bytes);
+    if (tmp == NULL)
+        return NULL;
+    *buf = tmp;
+    *size = bytes;
+    return tmp;
+}
+
+ssize_t qahw_out_writev_l(qahw_stream_handle_t *out_handle,
+                          qahw_out_buffer_t *out_bufs, size_t count,
+                          size_t *consumed)
+{
+    ssize_t rc = -EINVAL;
+    ssize_t total = 0;
+    qahw_stream_out_t *qahw_stream_out = (qahw_stream_out_t *)out_handle;
+    audio_stream_out_t *out = NULL;
+    size_t max_chunk = 0;
+    size_t i, j;
+
+    if ((out_bufs == NULL) || (count == 0)) {
+        ALOGE("%s::Invalid buffers %p count %zu", __func__, out_bufs, count);
+        goto exit;
+    }
+    for (i = 0; i < count; i++) {
+        if (out_bufs[i].buffer == NULL) {
+            ALOGE("%s::Invalid meta data at %zu", __func__, i);
+            goto exit;
+        }
+    }
+
+    if (!is_valid_qahw_stream_l((void *)qahw_stream_out, STREAM_DIR_OUT)) {
+        ALOGE("%s::Invalid out handle %p", __func__, out_handle);
+        goto exit;
+    }
+
+    if (consumed)
+        memset(consumed, 0, count * sizeof(*consumed));
+
+    rc = 0;
+    pthread_mutex_lock(&qahw_stream_out->lock);
+    out = qahw_stream_out->stream;
+    if (is_concatenable_format(out->common.get_format(&out->common)))
+        max_chunk = out->common.get_buffer_size(&out->common);
+
+    i = 0;
+    while (i < count) {
+        size_t first = i;
+        size_t chunk = out_bufs[i].bytes;
+        size_t left;
+        const void *data = out_bufs[i].buffer;
+        ssize_t written;
+
+        /*
+         * The driver takes one timestamp per write, so a buffer carrying its
+         * own timestamp always starts a new chunk.
+         */
+        for (i++; i < count; i++) {
+            if ((out_bufs[i].timestamp != NULL) ||
+                (out_bufs[i].flags != out_bufs[first].flags) ||
+                (chunk > max_chunk) || (out_bufs[i].bytes > max_chunk - chunk))
+                break;
+            chunk += out_bufs[i].bytes;
+        }
+
+        if (i - first > 1) {
+            uint8_t *stage = (uint8_t *)vec_buf_get(&qahw_stream_out->vec_buf,
+                                                    &qahw_stream_out->vec_buf_size,
+                                                    chunk);
+            if (stage == NULL) {
+                /* write the buffers one by one */
+                i = first + 1;
+                chunk = out_bufs[first].bytes;
+            } else {
+                for (j = first, left = 0; j < i; j++) {
+                    memcpy(stage + left, out_bufs[j].buffer, out_bufs[j].bytes);
+                    left += out_bufs[j].bytes;
+                }
+                data = stage;
+            }
+        }
+
+        written = out_write_locked(qahw_stream_out, data, chunk,
+                                   out_bufs[first].timestamp);
+        if (written < 0) {
+            if (total == 0)
+                rc = written;
+            break;
+        }
+
+        for (j = first, left = written; j < i; j++) {
+            size_t n = (out_bufs[j].bytes < left) ? out_bufs[j].bytes : left;
+
+            if (consumed)
+                consumed[j] = n;
+            if (qahw_stream_out->qahwi_out_write_v2)
+                out_bufs[j].offset = 0;
+            left -= n;
+        }
+        total += written;
+
+        /* short write: the driver buffer is full (non-blocking) or failing */
+        if ((size_t)written < chunk)
+            break;
     }
     pthread_mutex_unlock(&qahw_stream_out->lock);
+
+    if (total > 0)
+        rc = total;
 exit:
     return rc;
 }
@@ -959,6 +1183,9 @@ int qahw_in_set_parameters_l(qahw_stream_handle_t *in_handle, const char *kv_pai
         goto exit;
     }
 
+    if (shm_transport_set_parameters(in_handle, kv_pairs, shm_in_read, &rc))
+        goto exit;
+
     pthread_mutex_lock(&qahw_stream_in->lock);
     in = qahw_stream_in->stream;
     if (in->common.set_parameters) {
@@ -1006,12 +1233,26 @@ exit:
  *  negative status_t. If at least one frame was read prior to the error,
  *  read should return that byte count and then return an error in the subsequent call.
  */
+/* Called with the stream lock held */
+static ssize_t in_read_locked(qahw_stream_in_t *qahw_stream_in, void *buffer,
+                              size_t bytes, int64_t *timestamp)
+{
+    audio_stream_in_t *in = qahw_stream_in->stream;
+
+    if (qahw_stream_in->qahwi_in_read_v2)
+        return qahw_stream_in->qahwi_in_read_v2(in, buffer, bytes, timestamp);
+    if (in->read)
+        return in->read(in, buffer, bytes);
+
+    ALOGW("%s not supported", __func__);
+    return -ENOSYS;
+}
+
 ssize_t qahw_in_read_l(qahw_stream_handle_t *in_handle,
                      qahw_in_buffer_t *in_buf)
 {
     int rc = -EINVAL;
     qahw_stream_in_t *qahw_stream_in = (qahw_stream_in_t *)in_handle;
-    audio_stream_in_t *in = NULL;
 
     if ((in_buf == NULL) || (in_buf->buffer == NULL)) {
         ALOGE("%s::Invalid meta data %p", __func__, in_buf);
@@ -1024,20 +1265,109 @@ ssize_t qahw_in_read_l(qahw_stream_handle_t *in_handle,
     }
 
     pthread_mutex_lock(&qahw_stream_in->lock);
-    in = qahw_stream_in->stream;
-    if (qahw_stream_in->qahwi_in_read_v2) {
-        rc = qahw_stream_in->qahwi_in_read_v2(in, in_buf->buffer,
-                                         in_buf->bytes, in_buf->timestamp);
+    rc = in_read_locked(qahw_stream_in, in_buf->buffer, in_buf->bytes,
+                        in_buf->timestamp);
+    if (rc != -ENOSYS)
         in_buf->offset = 0;
-    } else if (in->read) {
-        rc = in->read(in, in_buf->buffer, in_buf->bytes);
-        in_buf->offset = 0;
-    } else {
-        rc = -ENOSYS;
-        ALOGW("%s not supported", __func__);
+    pthread_mutex_unlock(&qahw_stream_in->lock);
+
+exit:
+    return rc;
+}
+
+ssize_t qahw_in_readv_l(qahw_stream_handle_t *in_handle,
+                        qahw_in_buffer_t *in_bufs, size_t count,
+                        size_t *consumed)
+{
+    ssize_t rc = -EINVAL;
+    ssize_t total = 0;
+    qahw_stream_in_t *qahw_stream_in = (qahw_stream_in_t *)in_handle;
+    audio_stream_in_t *in = NULL;
+    size_t max_chunk = 0;
+    size_t i, j;
+
+    if ((in_bufs == NULL) || (count == 0)) {
+        ALOGE("%s::Invalid buffers %p count %zu", __func__, in_bufs, count);
+        goto exit;
+    }
+    for (i = 0; i < count; i++) {
+        if (in_bufs[i].buffer == NULL) {
+            ALOGE("%s::Invalid meta data at %zu", __func__, i);
+            goto exit;
+        }
+    }
+
+    if (!is_valid_qahw_stream_l((void *)qahw_stream_in, STREAM_DIR_IN)) {
+        ALOGV("%s::Invalid in handle %p", __func__, in_handle);
+        goto exit;
+    }
+
+    if (consumed)
+        memset(consumed, 0, count * sizeof(*consumed));
+
+    rc = 0;
+    pthread_mutex_lock(&qahw_stream_in->lock);
+    in = qahw_stream_in->stream;
+    /*
+     * Timestamp and passthrough sessions read exactly one fragment plus its
+     * metadata per call; plain PCM capture can fill several buffers at once.
+     */
+    if ((qahw_stream_in->qahwi_in_read_v2 == NULL) &&
+        audio_is_linear_pcm(in->common.get_format(&in->common)))
+        max_chunk = in->common.get_buffer_size(&in->common);
+
+    i = 0;
+    while (i < count) {
+        size_t first = i;
+        size_t chunk = in_bufs[i].bytes;
+        size_t left;
+        uint8_t *stage = NULL;
+        ssize_t bytes_read;
+
+        for (i++; i < count; i++) {
+            if ((chunk > max_chunk) || (in_bufs[i].bytes > max_chunk - chunk))
+                break;
+            chunk += in_bufs[i].bytes;
+        }
+
+        if (i - first > 1) {
+            stage = (uint8_t *)vec_buf_get(&qahw_stream_in->vec_buf,
+                                           &qahw_stream_in->vec_buf_size, chunk);
+            if (stage == NULL) {
+                /* read the buffers one by one */
+                i = first + 1;
+                chunk = in_bufs[first].bytes;
+            }
+        }
+
+        bytes_read = in_read_locked(qahw_stream_in,
+                                    stage ? stage : in_bufs[first].buffer,
+                                    chunk, in_bufs[first].timestamp);
+        if (bytes_read < 0) {
+            if (total == 0)
+                rc = bytes_read;
+            break;
+        }
+
+        for (j = first, left = bytes_read; j < i; j++) {
+            size_t n = (in_bufs[j].bytes < left) ? in_bufs[j].bytes : left;
+
+            if (stage)
+                memcpy(in_bufs[j].buffer, stage + (bytes_read - left), n);
+            if (consumed)
+                consumed[j] = n;
+            in_bufs[j].offset = 0;
+            left -= n;
+        }
+        total += bytes_read;
+
+        if ((size_t)bytes_read < chunk)
+            break;
     }
     pthread_mutex_unlock(&qahw_stream_in->lock);
 
+    if (total > 0)
+        rc = total;
 exit:
     return rc;
 }
@@ -1067,6 +1397,32 @@ exit:
     return rc;
 }
 
+/* API to get capture stream specific config parameters */
+int qahw_in_get_param_data_l(qahw_stream_handle_t *in_handle,
+                             qahw_param_id param_id,
+                             qahw_param_payload *payload)
+{
+    int rc = -EINVAL;
+    qahw_stream_in_t *qahw_stream_in = (qahw_stream_in_t *)in_handle;
+
+    if (!is_valid_qahw_stream_l((void *)qahw_stream_in, STREAM_DIR_IN)) {
+        ALOGE("%s::Invalid in handle %p", __func__, in_handle);
+        goto exit;
+    }
+
+    /* the HAL serializes against read with its own stream lock */
+    if (qahw_stream_in->qahwi_in_get_param_data) {
+        rc = qahw_stream_in->qahwi_in_get_param_data(qahw_stream_in->stream,
+                                                     param_id, payload);
+    } else {
+        rc = -ENOSYS;
+        ALOGW("%s not supported", __func__);
+    }
+
+exit:
+    return rc;
+}
+
 /*
  * Return the amount of input frames lost in the audio driver since the
  * last call of this function.
@@ -1716,6 +2072,9 @@ int qahw_close_output_stream_l(qahw_stream_handle_t *out_handle)
         goto exit;
     }
 
+    /* the transport thread may be blocked in a write on this stream */
+    qahw_shm_transport_unbind(out_handle);
+
     ALOGV("%s::calling device close_output_stream %p", __func__, out_handle);
     pthread_mutex_lock(&qahw_stream_out->lock);
     qahw_module = qahw_stream_out->module;
@@ -1730,6 +2089,7 @@ int qahw_close_output_stream_l(qahw_stream_handle_t *out_handle)
     pthread_mutex_unlock(&qahw_stream_out->lock);
 
     pthread_mutex_destroy(&qahw_stream_out->lock);
+    free(qahw_stream_out->vec_buf);
     free(qahw_stream_out);
 
 exit:
@@ -1812,6 +2172,14 @@ int qahw_open_input_stream_l(qahw_module_handle_t *hw_module,
         qahw_stream_in->qahwi_in_stop = NULL;
     }
 
+    dlerror();
+    qahw_stream_in->qahwi_in_get_param_data = (qahwi_in_get_param_data_t)
+        dlsym(qahw_module->module->dso, "qahwi_in_get_param_data");
+    if ((error = dlerror()) != NULL) {
+        ALOGI("%s: dlsym error %s for qahwi_in_get_param_data", __func__, error);
+        qahw_stream_in->qahwi_in_get_param_data = NULL;
+    }
+
  exit:
     pthread_mutex_unlock(&qahw_module->lock);
     return rc;
@@ -1830,6 +2198,9 @@ int qahw_close_input_stream_l(qahw_stream_handle_t *in_handle)
         goto exit;
     }
 
+    /* the transport thread may be blocked in a read on this stream */
+    qahw_shm_transport_unbind(in_handle);
+
     ALOGV("%s:: calling device close_input_stream %p", __func__, in_handle);
     pthread_mutex_lock(&qahw_stream_in->lock);
     qahw_module = qahw_stream_in->module;
@@ -1844,6 +2215,7 @@ int qahw_close_input_stream_l(qahw_stream_handle_t *in_handle)
     pthread_mutex_unlock(&qahw_stream_in->lock);
 
     pthread_mutex_destroy(&qahw_stream_in->lock);
+    free(qahw_stream_in->vec_buf);
     free(qahw_stream_in);
 
 exit:
@@ -1993,6 +2365,11 @@ qahw_module_handle_t *qahw_load_module_l(const char *hw_module_id)
     list_add_tail(&qahw_module_list, &qahw_module->module_list);
     load_st_hal();
 
+    /* only the QTI audio server loads modules when qahw_api routes through it */
+    if (property_get_bool("persist.vendor.audio.qas.enabled", false) &&
+            property_get_bool(QAHW_SHM_TRANSPORT_PROPERTY, false))
+        qahw_shm_transport_listen();
+
 error_exit:
     pthread_mutex_unlock(&qahw_module_init_lock);
 
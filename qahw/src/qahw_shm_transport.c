@@ -0,0 +1,709 @@
+/*
+ * Copyright (c) 2019, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#define _GNU_SOURCE
+#define LOG_TAG "qahw_shm_transport"
+/*#define LOG_NDEBUG 0*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/random.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/un.h>
+#include <cutils/list.h>
+#include <utils/Log.h>
+#ifdef ANDROID
+#include <cutils/ashmem.h>
+#endif
+#include "qahw_shm_transport.h"
+
+#define SHM_MAGIC 0x71736d74 /* "qsmt" */
+#define SHM_VERSION 1
+#define SHM_HEADER_SIZE 128
+#define SHM_NUM_FDS 3
+/* abstract socket the server collects client descriptors on */
+#define SHM_SOCKET_NAME "qahw_shm_transport"
+/* transports received but never bound, e.g. client died in between */
+#define SHM_MAX_PENDING 16
+/* how often a waiting client checks whether the server is still there */
+#define SHM_WAIT_SLICE_MS 500
+
+/* Layout of the start of the shared region, payload follows at SHM_HEADER_SIZE */
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t capacity;
+    uint32_t op;
+    atomic_uint req_idx;   /* written by the client when a request is ready */
+    atomic_uint done_idx;  /* written by the server when the result is ready */
+    uint32_t flags;
+    uint32_t has_timestamp;
+    uint64_t bytes;
+    int64_t timestamp;
+    int64_t result;
+} shm_header_t;
+
+struct qahw_shm_transport {
+    int mem_fd;
+    int req_fd;            /* client -> server doorbell */
+    int done_fd;           /* server -> client doorbell */
+    size_t map_size;
+    shm_header_t *hdr;
+    uint8_t *payload;
+    uint32_t capacity;
+    /* client side */
+    uint32_t last_idx;
+    pthread_mutex_t call_lock;
+    /* server side */
+    struct listnode list;
+    uint64_t cookie;
+    struct ucred peer;     /* credentials of the client that sent the descriptors */
+    const void *stream;
+    qahw_shm_handler_t handler;
+    void *handler_cookie;
+    pthread_t thread;
+    bool thread_started;
+    atomic_bool stop;
+};
+
+static pthread_mutex_t shm_list_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct listnode shm_pending_list = { &shm_pending_list, &shm_pending_list };
+static struct listnode shm_bound_list = { &shm_bound_list, &shm_bound_list };
+static unsigned int shm_pending_count;
+static bool shm_listening;
+
+static int shm_alloc_fd(size_t size)
+{
+    int fd;
+
+#ifdef ANDROID
+    fd = ashmem_create_region("qahw_shm_transport", size);
+#else
+    /* the server maps the region only if its size is sealed, see shm_region_size() */
+    fd = syscall(SYS_memfd_create, "qahw_shm_transport", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd >= 0 && (ftruncate(fd, size) < 0 ||
+            fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) < 0)) {
+        close(fd);
+        fd = -1;
+    }
+#endif
+    return fd;
+}
+
+/*
+ * Size of a region received from a client, or a negative errno if its size
+ * is not fixed: a client shrinking the region after the server mapped it
+ * would crash the server on the next access. memfd regions must carry the
+ * shrink and grow seals, ashmem regions cannot be resized once created.
+ */
+static ssize_t shm_region_size(int fd)
+{
+    struct stat st;
+    int seals = fcntl(fd, F_GET_SEALS);
+
+    if (seals >= 0) {
+        if ((seals & (F_SEAL_SHRINK | F_SEAL_GROW)) != (F_SEAL_SHRINK | F_SEAL_GROW))
+            return -EPERM;
+        if (fstat(fd, &st) < 0)
+            return -errno;
+        return (ssize_t)st.st_size;
+    }
+#ifdef ANDROID
+    if (ashmem_valid(fd))
+        return ashmem_get_size_region(fd);
+#endif
+    return -EPERM;
+}
+
+static int shm_map(qahw_shm_transport_t *t, size_t map_size)
+{
+    void *addr = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, t->mem_fd, 0);
+
+    if (addr == MAP_FAILED)
+        return -errno;
+    t->map_size = map_size;
+    t->hdr = (shm_header_t *)addr;
+    t->payload = (uint8_t *)addr + SHM_HEADER_SIZE;
+    return 0;
+}
+
+static qahw_shm_transport_t *shm_alloc_transport(void)
+{
+    qahw_shm_transport_t *t = (qahw_shm_transport_t *)calloc(1, sizeof(*t));
+
+    if (t == NULL)
+        return NULL;
+    t->mem_fd = t->req_fd = t->done_fd = -1;
+    pthread_mutex_init(&t->call_lock, NULL);
+    atomic_init(&t->stop, false);
+    list_init(&t->list);
+    return t;
+}
+
+static void shm_ring(int fd)
+{
+    uint64_t one = 1;
+
+    while (write(fd, &one, sizeof(one)) < 0 && errno == EINTR);
+}
+
+static void shm_drain(int fd)
+{
+    uint64_t count;
+
+    while (read(fd, &count, sizeof(count)) < 0 && errno == EINTR);
+}
+
+static uint32_t shm_next_idx(uint32_t idx)
+{
+    return idx < UINT32_MAX ? idx + 1 : 1;
+}
+
+static void shm_stop(qahw_shm_transport_t *t)
+{
+    if (t->thread_started) {
+        atomic_store(&t->stop, true);
+        shm_ring(t->req_fd);
+        pthread_join(t->thread, (void **) NULL);
+        t->thread_started = false;
+    }
+}
+
+void qahw_shm_transport_destroy(qahw_shm_transport_t *t)
+{
+    if (t == NULL)
+        return;
+    shm_stop(t);
+    if (t->hdr != NULL)
+        munmap(t->hdr, t->map_size);
+    if (t->mem_fd >= 0)
+        close(t->mem_fd);
+    if (t->req_fd >= 0)
+        close(t->req_fd);
+    if (t->done_fd >= 0)
+        close(t->done_fd);
+    pthread_mutex_destroy(&t->call_lock);
+    free(t);
+}
+
+int qahw_shm_transport_create(size_t capacity, qahw_shm_transport_t **transport)
+{
+    qahw_shm_transport_t *t;
+    long page = sysconf(_SC_PAGESIZE);
+    size_t map_size;
+    int ret;
+
+    if (transport == NULL || capacity == 0 || capacity > UINT32_MAX - SHM_HEADER_SIZE)
+        return -EINVAL;
+
+    map_size = (SHM_HEADER_SIZE + capacity + page - 1) & ~(page - 1);
+    t = shm_alloc_transport();
+    if (t == NULL)
+        return -ENOMEM;
+
+    t->mem_fd = shm_alloc_fd(map_size);
+    t->req_fd = eventfd(0, EFD_CLOEXEC);
+    t->done_fd = eventfd(0, EFD_CLOEXEC);
+    if (t->mem_fd < 0 || t->req_fd < 0 || t->done_fd < 0) {
+        ret = -errno;
+        ALOGE("%s: failed to allocate descriptors %d", __func__, ret);
+        goto error;
+    }
+    ret = shm_map(t, map_size);
+    if (ret < 0) {
+        ALOGE("%s: mmap failed %d", __func__, ret);
+        goto error;
+    }
+
+    t->capacity = map_size - SHM_HEADER_SIZE;
+    t->hdr->magic = SHM_MAGIC;
+    t->hdr->version = SHM_VERSION;
+    t->hdr->capacity = t->capacity;
+    atomic_init(&t->hdr->req_idx, 0);
+    atomic_init(&t->hdr->done_idx, 0);
+    *transport = t;
+    return 0;
+
+error:
+    qahw_shm_transport_destroy(t);
+    return ret;
+}
+
+static ssize_t shm_call_chunk(qahw_shm_transport_t *t, qahw_shm_request_t *req,
+                              uint8_t *buffer, size_t bytes, bool (*is_dead)(void))
+{
+    shm_header_t *hdr = t->hdr;
+    uint32_t idx = shm_next_idx(t->last_idx);
+    struct pollfd pfd = { t->done_fd, POLLIN, 0 };
+    ssize_t result;
+
+    if (req->op == QAHW_SHM_OP_WRITE)
+        memcpy(t->payload, buffer, bytes);
+    hdr->op = req->op;
+    hdr->bytes = bytes;
+    hdr->flags = req->flags;
+    hdr->has_timestamp = req->has_timestamp;
+    hdr->timestamp = req->timestamp;
+    atomic_store_explicit(&hdr->req_idx, idx, memory_order_release);
+    t->last_idx = idx;
+    shm_ring(t->req_fd);
+
+    while (atomic_load_explicit(&hdr->done_idx, memory_order_acquire) != idx) {
+        int ret = poll(&pfd, 1, SHM_WAIT_SLICE_MS);
+        if (ret > 0) {
+            shm_drain(t->done_fd);
+        } else if (ret < 0 && errno != EINTR) {
+            return -errno;
+        } else if (ret == 0 && is_dead != NULL && is_dead()) {
+            return -ENODEV;
+        }
+    }
+
+    result = (ssize_t)hdr->result;
+    if (req->op == QAHW_SHM_OP_READ && result > 0)
+        memcpy(buffer, t->payload, (size_t)result > bytes ? bytes : (size_t)result);
+    if (req->has_timestamp)
+        req->timestamp = hdr->timestamp;
+    return result;
+}
+
+ssize_t qahw_shm_transport_call(qahw_shm_transport_t *t, qahw_shm_request_t *req,
+                                bool (*is_dead)(void))
+{
+    uint8_t *buffer;
+    size_t done = 0;
+    ssize_t ret = 0;
+
+    if (t == NULL || req == NULL || req->buffer == NULL)
+        return -EINVAL;
+
+    buffer = (uint8_t *)req->buffer;
+    pthread_mutex_lock(&t->call_lock);
+    while (done < req->bytes) {
+        size_t chunk = req->bytes - done;
+
+        if (chunk > t->capacity)
+            chunk = t->capacity;
+        ret = shm_call_chunk(t, req, buffer + done, chunk, is_dead);
+        if (ret < 0)
+            break;
+        done += ret;
+        /* a short transfer ends the call, as it would on the HAL */
+        if ((size_t)ret < chunk)
+            break;
+        /* the timestamp belongs to the first chunk only */
+        req->has_timestamp = false;
+    }
+    pthread_mutex_unlock(&t->call_lock);
+
+    return (done > 0) ? (ssize_t)done : ret;
+}
+
+static void *shm_server_thread(void *arg)
+{
+    qahw_shm_transport_t *t = (qahw_shm_transport_t *)arg;
+    shm_header_t *hdr = t->hdr;
+    struct pollfd pfd = { t->req_fd, POLLIN, 0 };
+    uint32_t done = atomic_load_explicit(&hdr->done_idx, memory_order_relaxed);
+
+    prctl(PR_SET_NAME, (unsigned long)"qahw_shm", 0, 0, 0);
+
+    while (!atomic_load(&t->stop)) {
+        uint32_t idx;
+        qahw_shm_request_t req;
+
+        if (poll(&pfd, 1, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            ALOGE("%s: poll failed %d", __func__, -errno);
+            break;
+        }
+        shm_drain(t->req_fd);
+
+        idx = atomic_load_explicit(&hdr->req_idx, memory_order_acquire);
+        if (idx == done || atomic_load(&t->stop))
+            continue;
+
+        req.op = (qahw_shm_op_t)hdr->op;
+        req.buffer = t->payload;
+        req.bytes = hdr->bytes > t->capacity ? t->capacity : hdr->bytes;
+        req.timestamp = hdr->timestamp;
+        req.has_timestamp = hdr->has_timestamp;
+        req.flags = hdr->flags;
+        hdr->result = t->handler(t->handler_cookie, &req);
+        hdr->timestamp = req.timestamp;
+
+        done = idx;
+        atomic_store_explicit(&hdr->done_idx, idx, memory_order_release);
+        shm_ring(t->done_fd);
+    }
+
+    return NULL;
+}
+
+int qahw_shm_transport_serve(qahw_shm_transport_t *t, qahw_shm_handler_t handler,
+                             void *handler_cookie)
+{
+    int ret;
+
+    if (t == NULL || handler == NULL || t->thread_started)
+        return -EINVAL;
+
+    t->handler = handler;
+    t->handler_cookie = handler_cookie;
+    ret = pthread_create(&t->thread, (const pthread_attr_t *) NULL, shm_server_thread, t);
+    if (ret != 0)
+        return -ret;
+    t->thread_started = true;
+    return 0;
+}
+
+static int shm_socket_addr(struct sockaddr_un *addr, socklen_t *len)
+{
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    /* abstract namespace: leading NUL, no file system entry to clean up */
+    strncpy(addr->sun_path + 1, SHM_SOCKET_NAME, sizeof(addr->sun_path) - 2);
+    *len = offsetof(struct sockaddr_un, sun_path) + 1 + strlen(SHM_SOCKET_NAME);
+    return 0;
+}
+
+/* Binding cookies must not be guessable by other clients of the server */
+static int shm_new_cookie(uint64_t *cookie)
+{
+    ssize_t ret;
+
+    do {
+        ret = getrandom(cookie, sizeof(*cookie), 0);
+        if (ret < 0 && errno != EINTR)
+            return -errno;
+    } while (ret != sizeof(*cookie) || *cookie == 0);
+    return 0;
+}
+
+int qahw_shm_transport_connect(qahw_shm_transport_t *t, uint64_t *cookie)
+{
+    struct sockaddr_un addr;
+    socklen_t addr_len;
+    int fds[SHM_NUM_FDS];
+    char control[CMSG_SPACE(sizeof(fds))];
+    struct iovec iov;
+    struct msghdr msg;
+    struct cmsghdr *cmsg;
+    int32_t status = -EIO;
+    int sock;
+    int ret;
+
+    if (t == NULL || cookie == NULL)
+        return -EINVAL;
+
+    sock = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (sock < 0)
+        return -errno;
+    shm_socket_addr(&addr, &addr_len);
+    if (connect(sock, (struct sockaddr *)&addr, addr_len) < 0) {
+        ret = -errno;
+        ALOGV("%s: server not listening %d", __func__, ret);
+        goto exit;
+    }
+
+    ret = shm_new_cookie(cookie);
+    if (ret < 0) {
+        ALOGE("%s: no random cookie %d", __func__, ret);
+        goto exit;
+    }
+    fds[0] = t->mem_fd;
+    fds[1] = t->req_fd;
+    fds[2] = t->done_fd;
+    iov.iov_base = cookie;
+    iov.iov_len = sizeof(*cookie);
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+    if (sendmsg(sock, &msg, MSG_NOSIGNAL) < 0 ||
+            recv(sock, &status, sizeof(status), 0) != sizeof(status)) {
+        ret = -errno;
+        ALOGE("%s: handshake failed %d", __func__, ret);
+        goto exit;
+    }
+    ret = status;
+
+exit:
+    close(sock);
+    return ret;
+}
+
+static qahw_shm_transport_t *shm_find_l(struct listnode *list, uint64_t cookie)
+{
+    struct listnode *node;
+
+    list_for_each(node, list) {
+        qahw_shm_transport_t *item = node_to_item(node, qahw_shm_transport_t, list);
+        if (item->cookie == cookie)
+            return item;
+    }
+    return NULL;
+}
+
+/* Takes ownership of fds. peer is the client that sent them, checked against the
+ * stream owner when the transport is bound */
+static int shm_accept_transport(uint64_t cookie, const struct ucred *peer,
+                                int fds[SHM_NUM_FDS])
+{
+    qahw_shm_transport_t *t = shm_alloc_transport();
+    ssize_t size;
+    int ret;
+
+    if (t == NULL) {
+        close(fds[0]);
+        close(fds[1]);
+        close(fds[2]);
+        return -ENOMEM;
+    }
+    t->mem_fd = fds[0];
+    t->req_fd = fds[1];
+    t->done_fd = fds[2];
+    t->cookie = cookie;
+    t->peer = *peer;
+
+    size = shm_region_size(t->mem_fd);
+    if (size <= SHM_HEADER_SIZE) {
+        ret = size < 0 ? (int)size : -EINVAL;
+        goto error;
+    }
+    ret = shm_map(t, (size_t)size);
+    if (ret < 0)
+        goto error;
+    if (t->hdr->magic != SHM_MAGIC || t->hdr->version != SHM_VERSION ||
+            t->hdr->capacity > t->map_size - SHM_HEADER_SIZE) {
+        ret = -EINVAL;
+        goto error;
+    }
+    t->capacity = t->hdr->capacity;
+
+    pthread_mutex_lock(&shm_list_lock);
+    if (shm_find_l(&shm_pending_list, cookie) != NULL ||
+            shm_find_l(&shm_bound_list, cookie) != NULL) {
+        pthread_mutex_unlock(&shm_list_lock);
+        ret = -EEXIST;
+        goto error;
+    }
+    if (shm_pending_count == SHM_MAX_PENDING) {
+        qahw_shm_transport_t *oldest = node_to_item(list_head(&shm_pending_list),
+                                                    qahw_shm_transport_t, list);
+        ALOGW("%s: dropping unbound transport %llx", __func__,
+              (unsigned long long)oldest->cookie);
+        list_remove(&oldest->list);
+        qahw_shm_transport_destroy(oldest);
+        shm_pending_count--;
+    }
+    list_add_tail(&shm_pending_list, &t->list);
+    shm_pending_count++;
+    pthread_mutex_unlock(&shm_list_lock);
+    return 0;
+
+error:
+    ALOGE("%s: invalid transport from client pid %d uid %d: %d", __func__,
+          peer->pid, peer->uid, ret);
+    qahw_shm_transport_destroy(t);
+    return ret;
+}
+
+static void *shm_listen_thread(void *arg)
+{
+    int sock = (int)(intptr_t)arg;
+
+    prctl(PR_SET_NAME, (unsigned long)"qahw_shm_listen", 0, 0, 0);
+
+    for (;;) {
+        int conn = accept4(sock, NULL, NULL, SOCK_CLOEXEC);
+        struct ucred peer;
+        socklen_t peer_len = sizeof(peer);
+        int fds[SHM_NUM_FDS];
+        char control[CMSG_SPACE(sizeof(fds))];
+        uint64_t cookie = 0;
+        struct iovec iov = { &cookie, sizeof(cookie) };
+        struct msghdr msg;
+        struct cmsghdr *cmsg;
+        int32_t status = -EINVAL;
+
+        if (conn < 0) {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            ALOGE("%s: accept failed %d", __func__, -errno);
+            break;
+        }
+
+        /* credentials of the connecting process, set by the kernel at connect() */
+        if (getsockopt(conn, SOL_SOCKET, SO_PEERCRED, &peer, &peer_len) < 0 ||
+                peer_len != sizeof(peer)) {
+            ALOGE("%s: no peer credentials %d", __func__, -errno);
+            status = -EPERM;
+            goto reply;
+        }
+
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        if (recvmsg(conn, &msg, MSG_CMSG_CLOEXEC) == sizeof(cookie)) {
+            cmsg = CMSG_FIRSTHDR(&msg);
+            if (cmsg != NULL && cmsg->cmsg_level == SOL_SOCKET &&
+                    cmsg->cmsg_type == SCM_RIGHTS &&
+                    cmsg->cmsg_len == CMSG_LEN(sizeof(fds))) {
+                memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+                status = shm_accept_transport(cookie, &peer, fds);
+            }
+        }
+reply:
+        send(conn, &status, sizeof(status), MSG_NOSIGNAL);
+        close(conn);
+    }
+
+    close(sock);
+    return NULL;
+}
+
+int qahw_shm_transport_listen(void)
+{
+    struct sockaddr_un addr;
+    socklen_t addr_len;
+    pthread_t thread;
+    pthread_attr_t attr;
+    int sock;
+    int ret = 0;
+
+    pthread_mutex_lock(&shm_list_lock);
+    if (shm_listening)
+        goto exit;
+
+    sock = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (sock < 0) {
+        ret = -errno;
+        goto exit;
+    }
+    shm_socket_addr(&addr, &addr_len);
+    if (bind(sock, (struct sockaddr *)&addr, addr_len) < 0 || listen(sock, 4) < 0) {
+        ret = -errno;
+        ALOGE("%s: cannot listen on %s %d", __func__, SHM_SOCKET_NAME, ret);
+        close(sock);
+        goto exit;
+    }
+
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    ret = -pthread_create(&thread, &attr, shm_listen_thread, (void *)(intptr_t)sock);
+    pthread_attr_destroy(&attr);
+    if (ret != 0) {
+        close(sock);
+        goto exit;
+    }
+    shm_listening = true;
+    ALOGD("%s: listening for stream transports", __func__);
+
+exit:
+    pthread_mutex_unlock(&shm_list_lock);
+    return ret;
+}
+
+int qahw_shm_transport_bind(uint64_t cookie, pid_t owner_pid, uid_t owner_uid,
+                            const void *stream, qahw_shm_handler_t handler,
+                            void *handler_cookie)
+{
+    qahw_shm_transport_t *t;
+    int ret;
+
+    pthread_mutex_lock(&shm_list_lock);
+    t = shm_find_l(&shm_pending_list, cookie);
+    if (t == NULL) {
+        pthread_mutex_unlock(&shm_list_lock);
+        ALOGE("%s: no transport for cookie %llx", __func__, (unsigned long long)cookie);
+        return -ENOENT;
+    }
+    /* only the process that owns the stream may attach its data plane to it */
+    if (t->peer.pid != owner_pid || t->peer.uid != owner_uid) {
+        pthread_mutex_unlock(&shm_list_lock);
+        ALOGE("%s: transport from pid %d uid %d cannot bind to stream of pid %d uid %d",
+              __func__, t->peer.pid, t->peer.uid, owner_pid, owner_uid);
+        return -EPERM;
+    }
+    list_remove(&t->list);
+    shm_pending_count--;
+
+    t->stream = stream;
+    ret = qahw_shm_transport_serve(t, handler, handler_cookie);
+    if (ret == 0)
+        list_add_tail(&shm_bound_list, &t->list);
+    pthread_mutex_unlock(&shm_list_lock);
+
+    if (ret != 0)
+        qahw_shm_transport_destroy(t);
+    return ret;
+}
+
+void qahw_shm_transport_unbind(const void *stream)
+{
+    struct listnode *node, *tempnode;
+    qahw_shm_transport_t *t = NULL;
+
+    pthread_mutex_lock(&shm_list_lock);
+    list_for_each_safe(node, tempnode, &shm_bound_list) {
+        qahw_shm_transport_t *item = node_to_item(node, qahw_shm_transport_t, list);
+        if (item->stream == stream) {
+            list_remove(&item->list);
+            t = item;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&shm_list_lock);
+
+    if (t != NULL)
+        qahw_shm_transport_destroy(t);
+}
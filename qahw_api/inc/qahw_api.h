@@ -185,6 +185,18 @@ int qahw_out_set_volume(qahw_stream_handle_t *stream, float left, float right);
 ssize_t qahw_out_write(qahw_stream_handle_t *stream,
                        qahw_out_buffer_t *out_buf);
 
+/*
+ * Write several buffers, e.g. demuxed access units, in one call. Each buffer
+ * carries its own timestamp and flags. Where the format allows, consecutive
+ * buffers without a timestamp are handed to the driver as one write of up to
+ * the stream buffer size. Bytes taken from each buffer are returned in
+ * consumed (may be NULL). Returns the total bytes written, stopping at the
+ * first short write, or a negative status_t if nothing was written.
+ */
+ssize_t qahw_out_writev(qahw_stream_handle_t *stream,
+                        qahw_out_buffer_t *out_bufs, size_t count,
+                        size_t *consumed);
+
 /*
  * return the number of audio frames written by the audio dsp to DAC since
  * the output has exited standby
@@ -353,6 +365,22 @@ char* qahw_in_get_parameters(const qahw_stream_handle_t *in_handle,
  */
 ssize_t qahw_in_read(qahw_stream_handle_t *in_handle,
                      qahw_in_buffer_t *in_buf);
+/*
+ * Read into several buffers in one call. Bytes placed in each buffer are
+ * returned in consumed (may be NULL). Returns the total bytes read, stopping
+ * at the first short read, or a negative status_t if nothing was read.
+ */
+ssize_t qahw_in_readv(qahw_stream_handle_t *in_handle,
+                      qahw_in_buffer_t *in_bufs, size_t count,
+                      size_t *consumed);
+/*
+ * Get capture stream specific parameters. QAHW_PARAM_IN_FRAME_INFO returns
+ * the timestamp, size and flags of the frames read since the last query on
+ * compress capture streams, so the payload needs no parsing.
+ */
+int qahw_in_get_param_data(qahw_stream_handle_t *in_handle,
+                           qahw_param_id param_id,
+                           qahw_param_payload *payload);
 /*
  * Stop input stream. Returns zero on success.
  */
@@ -418,6 +418,28 @@ typedef struct qahw_hpcm_params {
    qahw_hpcm_direction direction;
 } qahw_hpcm_params_t;
 
+#define QAHW_IN_FRAME_INFO_MAX_FRAMES 16
+
+/* frame descriptor flags */
+#define QAHW_IN_FRAME_FLAG_TIMESTAMP     (1 << 0) /* timestamp is valid */
+#define QAHW_IN_FRAME_FLAG_DISCONTINUITY (1 << 1) /* a read failed before this frame */
+
+struct qahw_in_frame_desc {
+    uint64_t seq;       /* read sequence number of the stream */
+    uint64_t timestamp; /* capture timestamp in us */
+    uint32_t size;      /* payload bytes, metadata excluded */
+    uint32_t flags;
+};
+
+/* payload format for HAL parameter
+ * QAHW_PARAM_IN_FRAME_INFO
+ */
+struct qahw_in_frame_info_param {
+    uint32_t num_frames; /* descriptors returned, oldest first */
+    uint32_t dropped;    /* descriptors overwritten since the last query */
+    struct qahw_in_frame_desc frames[QAHW_IN_FRAME_INFO_MAX_FRAMES];
+};
+
 typedef union {
     struct qahw_source_tracking_param st_params;
     struct qahw_sound_focus_param sf_params;
@@ -436,6 +458,7 @@ typedef union {
     struct qahw_dtmf_gen_params dtmf_gen_params;
     struct qahw_tty_params tty_mode_params;
     struct qahw_hpcm_params hpcm_params;
+    struct qahw_in_frame_info_param in_frame_info;
 } qahw_param_payload;
 
 typedef enum {
@@ -459,6 +482,7 @@ typedef enum {
     QAHW_PARAM_DTMF_GEN,
     QAHW_PARAM_TTY_MODE,
     QAHW_PARAM_HPCM,
+    QAHW_PARAM_IN_FRAME_INFO,      /* PARAM to query capture frame descriptors */
 } qahw_param_id;
 
 
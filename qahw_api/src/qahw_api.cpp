@@ -43,6 +43,7 @@
 #include <cutils/properties.h>
 #include "qahw_api.h"
 #include "qahw.h"
+#include "qahw_shm_transport.h"
 #include <errno.h>
 
 #ifndef ANDROID
@@ -242,6 +243,112 @@ sp<Iqti_audio_server> get_qti_audio_server() {
     return g_qas;
 }
 
+/*
+ * Streams whose write/read go through a shared memory transport instead of a
+ * binder transaction. Binder remains the control path for everything else.
+ */
+typedef struct {
+    struct listnode list;
+    qahw_stream_handle_t *handle;
+    qahw_shm_transport_t *transport;
+} shm_stream_t;
+
+/* minimum payload size of a transport, larger calls are split */
+#define QAHW_SHM_TRANSPORT_MIN_CAPACITY (32 * 1024)
+
+static struct listnode shm_stream_list = { &shm_stream_list, &shm_stream_list };
+static pthread_mutex_t shm_stream_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static bool qas_is_dead()
+{
+    return g_qas_died;
+}
+
+static qahw_shm_transport_t *shm_transport_get(const qahw_stream_handle_t *handle)
+{
+    struct listnode *node;
+    qahw_shm_transport_t *transport = NULL;
+
+    pthread_mutex_lock(&shm_stream_lock);
+    list_for_each(node, &shm_stream_list) {
+        shm_stream_t *item = node_to_item(node, shm_stream_t, list);
+        if (item->handle == handle) {
+            transport = item->transport;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&shm_stream_lock);
+    return transport;
+}
+
+/* Sets up the data plane for a stream just opened through the server */
+static void shm_transport_open(sp<Iqti_audio_server> qas,
+                               qahw_stream_handle_t *handle, bool is_output)
+{
+    char kv_pairs[64];
+    qahw_shm_transport_t *transport = NULL;
+    shm_stream_t *item = NULL;
+    uint64_t cookie;
+    size_t capacity;
+    int rc;
+
+    if (!property_get_bool(QAHW_SHM_TRANSPORT_PROPERTY, false))
+        return;
+
+    capacity = is_output ? qas->qahw_out_get_buffer_size(handle) :
+                           qas->qahw_in_get_buffer_size(handle);
+    if ((ssize_t)capacity < QAHW_SHM_TRANSPORT_MIN_CAPACITY)
+        capacity = QAHW_SHM_TRANSPORT_MIN_CAPACITY;
+
+    rc = qahw_shm_transport_create(capacity, &transport);
+    if (rc == 0)
+        rc = qahw_shm_transport_connect(transport, &cookie);
+    if (rc == 0) {
+        snprintf(kv_pairs, sizeof(kv_pairs), "%s=%llu", QAHW_SHM_TRANSPORT_KEY,
+                 (unsigned long long)cookie);
+        rc = is_output ? qas->qahw_out_set_parameters(handle, kv_pairs) :
+                         qas->qahw_in_set_parameters(handle, kv_pairs);
+    }
+    if (rc == 0) {
+        item = (shm_stream_t *)calloc(1, sizeof(shm_stream_t));
+        rc = (item == NULL) ? -ENOMEM : 0;
+    }
+    if (rc != 0) {
+        ALOGW("%s: stream %p stays on binder data path %d", __func__, handle, rc);
+        qahw_shm_transport_destroy(transport);
+        return;
+    }
+
+    item->handle = handle;
+    item->transport = transport;
+    pthread_mutex_lock(&shm_stream_lock);
+    list_add_tail(&shm_stream_list, &item->list);
+    pthread_mutex_unlock(&shm_stream_lock);
+    ALOGD("%s: stream %p uses shared memory data path", __func__, handle);
+}
+
+static void shm_transport_close(const qahw_stream_handle_t *handle)
+{
+    struct listnode *node, *tempnode;
+    shm_stream_t *found = NULL;
+
+    pthread_mutex_lock(&shm_stream_lock);
+    list_for_each_safe(node, tempnode, &shm_stream_list) {
+        shm_stream_t *item = node_to_item(node, shm_stream_t, list);
+        if (item->handle == handle) {
+            list_remove(&item->list);
+            found = item;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&shm_stream_lock);
+
+    if (found != NULL) {
+        qahw_shm_transport_destroy(found->transport);
+        free(found);
+    }
+}
+
 uint32_t qahw_out_get_sample_rate(const qahw_stream_handle_t *out_handle)
 {
     ALOGV("%d:%s",__LINE__, __func__);
@@ -458,6 +565,20 @@ ssize_t qahw_out_write(qahw_stream_handle_t *out_handle,
 {
     if (g_binder_enabled) {
         if (!g_qas_died) {
+            qahw_shm_transport_t *transport = shm_transport_get(out_handle);
+            if (transport != NULL && out_buf != NULL) {
+                qahw_shm_request_t req;
+
+                memset(&req, 0, sizeof(req));
+                req.op = QAHW_SHM_OP_WRITE;
+                req.buffer = (void *)out_buf->buffer;
+                req.bytes = out_buf->bytes;
+                req.has_timestamp = (out_buf->timestamp != NULL);
+                req.timestamp = req.has_timestamp ? *out_buf->timestamp : 0;
+                req.flags = out_buf->flags;
+                out_buf->offset = 0;
+                return qahw_shm_transport_call(transport, &req, qas_is_dead);
+            }
             sp<Iqti_audio_server> qas = get_qti_audio_server();
             if (qas_status(qas) == -1)
                 return -ENODEV;
@@ -470,6 +591,36 @@ ssize_t qahw_out_write(qahw_stream_handle_t *out_handle,
     }
 }
 
+ssize_t qahw_out_writev(qahw_stream_handle_t *out_handle,
+                        qahw_out_buffer_t *out_bufs, size_t count,
+                        size_t *consumed)
+{
+    if (g_binder_enabled) {
+        ssize_t total = 0;
+        size_t i;
+
+        if (out_bufs == NULL || count == 0)
+            return -EINVAL;
+        if (consumed)
+            memset(consumed, 0, count * sizeof(*consumed));
+        /* the server has no vectored call, submit the buffers one by one */
+        for (i = 0; i < count; i++) {
+            ssize_t ret = qahw_out_write(out_handle, &out_bufs[i]);
+
+            if (ret < 0)
+                return total ? total : ret;
+            if (consumed)
+                consumed[i] = ret;
+            total += ret;
+            if ((size_t)ret < out_bufs[i].bytes)
+                break;
+        }
+        return total;
+    } else {
+        return qahw_out_writev_l(out_handle, out_bufs, count, consumed);
+    }
+}
+
 int qahw_out_get_render_position(const qahw_stream_handle_t *out_handle,
                                  uint32_t *dsp_frames)
 {
@@ -754,6 +905,22 @@ ssize_t qahw_in_read(qahw_stream_handle_t *in_handle,
 {
     if (g_binder_enabled) {
         if (!g_qas_died) {
+            qahw_shm_transport_t *transport = shm_transport_get(in_handle);
+            if (transport != NULL && in_buf != NULL) {
+                qahw_shm_request_t req;
+                ssize_t rc;
+
+                memset(&req, 0, sizeof(req));
+                req.op = QAHW_SHM_OP_READ;
+                req.buffer = in_buf->buffer;
+                req.bytes = in_buf->bytes;
+                req.has_timestamp = (in_buf->timestamp != NULL);
+                rc = qahw_shm_transport_call(transport, &req, qas_is_dead);
+                if (rc >= 0 && in_buf->timestamp != NULL)
+                    *in_buf->timestamp = req.timestamp;
+                in_buf->offset = 0;
+                return rc;
+            }
             sp<Iqti_audio_server> qas = get_qti_audio_server();
             if (qas_status(qas) == -1)
                 return -ENODEV;
@@ -766,6 +933,50 @@ ssize_t qahw_in_read(qahw_stream_handle_t *in_handle,
     }
 }
 
+ssize_t qahw_in_readv(qahw_stream_handle_t *in_handle,
+                      qahw_in_buffer_t *in_bufs, size_t count,
+                      size_t *consumed)
+{
+    if (g_binder_enabled) {
+        ssize_t total = 0;
+        size_t i;
+
+        if (in_bufs == NULL || count == 0)
+            return -EINVAL;
+        if (consumed)
+            memset(consumed, 0, count * sizeof(*consumed));
+        /* the server has no vectored call, submit the buffers one by one */
+        for (i = 0; i < count; i++) {
+            ssize_t ret = qahw_in_read(in_handle, &in_bufs[i]);
+
+            if (ret < 0)
+                return total ? total : ret;
+            if (consumed)
+                consumed[i] = ret;
+            total += ret;
+            if ((size_t)ret < in_bufs[i].bytes)
+                break;
+        }
+        return total;
+    } else {
+        return qahw_in_readv_l(in_handle, in_bufs, count, consumed);
+    }
+}
+
+int qahw_in_get_param_data(qahw_stream_handle_t *in_handle,
+                           qahw_param_id param_id,
+                           qahw_param_payload *payload)
+{
+    ALOGV("%d:%s",__LINE__, __func__);
+    if (g_binder_enabled) {
+        /* not part of the audio server interface */
+        ALOGW("%d:%s not supported through the audio server", __LINE__, __func__);
+        return -ENOSYS;
+    } else {
+        return qahw_in_get_param_data_l(in_handle, param_id, payload);
+    }
+}
+
 int qahw_in_stop(qahw_stream_handle_t *in_handle)
 {
     if (g_binder_enabled) {
@@ -1096,9 +1307,12 @@ int qahw_open_output_stream(qahw_module_handle_t *hw_module,
             sp<Iqti_audio_server> qas = get_qti_audio_server();
             if (qas_status(qas) == -1)
                 return -ENODEV;
-            return qas->qahw_open_output_stream(hw_module, handle, devices,
+            int rc = qas->qahw_open_output_stream(hw_module, handle, devices,
                                                  flags, config, out_handle,
                                                  address);
+            if (rc == 0)
+                shm_transport_open(qas, *out_handle, true);
+            return rc;
         } else {
             return -ENODEV;
         }
@@ -1114,6 +1328,7 @@ int qahw_close_output_stream(qahw_stream_handle_t *out_handle)
     ALOGV("%d:%s",__LINE__, __func__);
     int status;
     if (g_binder_enabled) {
+        shm_transport_close(out_handle);
         if (!g_qas_died) {
             sp<Iqti_audio_server> qas = get_qti_audio_server();
             if (qas_status(qas) == -1)
@@ -1159,9 +1374,12 @@ int qahw_open_input_stream(qahw_module_handle_t *hw_module,
             sp<Iqti_audio_server> qas = get_qti_audio_server();
             if (qas_status(qas) == -1)
                 return -ENODEV;
-            return qas->qahw_open_input_stream(hw_module, handle, devices,
+            int rc = qas->qahw_open_input_stream(hw_module, handle, devices,
                                            config, in_handle, flags,
                                            address, source);
+            if (rc == 0)
+                shm_transport_open(qas, *in_handle, false);
+            return rc;
         } else {
             return -ENODEV;
         }
@@ -1176,6 +1394,7 @@ int qahw_close_input_stream(qahw_stream_handle_t *in_handle)
 {
     ALOGV("%d:%s",__LINE__, __func__);
     if (g_binder_enabled) {
+        shm_transport_close(in_handle);
         if (!g_qas_died) {
             sp<Iqti_audio_server> qas = get_qti_audio_server();
             if (qas_status(qas) == -1)
@@ -1540,6 +1759,13 @@ ssize_t qahw_out_write(qahw_stream_handle_t *out_handle,
     return qahw_out_write_l(out_handle, out_buf);
 }
 
+ssize_t qahw_out_writev(qahw_stream_handle_t *out_handle,
+                        qahw_out_buffer_t *out_bufs, size_t count,
+                        size_t *consumed)
+{
+    return qahw_out_writev_l(out_handle, out_bufs, count, consumed);
+}
+
 int qahw_out_get_render_position(const qahw_stream_handle_t *out_handle,
                                  uint32_t *dsp_frames)
 {
@@ -1648,6 +1874,21 @@ ssize_t qahw_in_read(qahw_stream_handle_t *in_handle,
     return qahw_in_read_l(in_handle, in_buf);
 }
 
+ssize_t qahw_in_readv(qahw_stream_handle_t *in_handle,
+                      qahw_in_buffer_t *in_bufs, size_t count,
+                      size_t *consumed)
+{
+    return qahw_in_readv_l(in_handle, in_bufs, count, consumed);
+}
+
+int qahw_in_get_param_data(qahw_stream_handle_t *in_handle,
+                           qahw_param_id param_id,
+                           qahw_param_payload *payload)
+{
+    ALOGV("%d:%s",__LINE__, __func__);
+    return qahw_in_get_param_data_l(in_handle, param_id, payload);
+}
+
 int qahw_in_stop(qahw_stream_handle_t *in_handle)
 {
     return qahw_in_stop_l(in_handle);
@@ -61,3 +61,79 @@ ifneq ($(filter kona lahaina holi,$(TARGET_BOARD_PLATFORM)),)
 LOCAL_SANITIZE := integer_overflow
 endif
 include $(BUILD_EXECUTABLE)
+
+# audio_hal_transport_bench
+# ==============================================================================
+include $(CLEAR_VARS)
+LOCAL_SRC_FILES := qahw_transport_bench.c
+LOCAL_MODULE := hal_transport_bench
+LOCAL_CFLAGS += -Wall -Werror -Wno-sign-compare
+
+LOCAL_HEADER_LIBRARIES := \
+    libqahw_headers \
+    libqahwapi_headers
+
+LOCAL_SHARED_LIBRARIES := \
+    libcutils \
+    libqahw \
+    libqahwwrapper \
+    libutils
+
+LOCAL_32_BIT_ONLY := true
+
+LOCAL_VENDOR_MODULE := true
+
+ifneq ($(filter kona lahaina holi,$(TARGET_BOARD_PLATFORM)),)
+LOCAL_SANITIZE := integer_overflow
+endif
+include $(BUILD_EXECUTABLE)
+
+# audio_hal_set_params_bench
+# ==============================================================================
+include $(CLEAR_VARS)
+LOCAL_SRC_FILES := qahw_set_params_bench.c
+LOCAL_MODULE := hal_set_params_bench
+LOCAL_CFLAGS += -Wall -Werror -Wno-sign-compare
+
+LOCAL_HEADER_LIBRARIES := \
+    libqahwapi_headers
+
+LOCAL_SHARED_LIBRARIES := \
+    libqahw \
+    libutils
+
+LOCAL_32_BIT_ONLY := true
+
+LOCAL_VENDOR_MODULE := true
+
+ifneq ($(filter kona lahaina holi,$(TARGET_BOARD_PLATFORM)),)
+LOCAL_SANITIZE := integer_overflow
+endif
+include $(BUILD_EXECUTABLE)
+
+# hal_latency_bench
+# ==============================================================================
+# Target build only. Host runs use the automake build of the HAL with
+# libalsa_sim.so preloaded in place of tinyalsa.
+include $(CLEAR_VARS)
+LOCAL_SRC_FILES := qahw_latency_bench.c
+LOCAL_MODULE := hal_latency_bench
+LOCAL_CFLAGS += -Wall -Werror -Wno-sign-compare
+
+LOCAL_C_INCLUDES := $(LOCAL_PATH)/../../alsa_sim/inc
+
+LOCAL_HEADER_LIBRARIES := \
+    libqahwapi_headers
+
+LOCAL_SHARED_LIBRARIES := \
+    libqahw \
+    libutils
+
+LOCAL_32_BIT_ONLY := true
+
+LOCAL_VENDOR_MODULE := true
+
+ifneq ($(filter kona lahaina holi,$(TARGET_BOARD_PLATFORM)),)
+LOCAL_SANITIZE := integer_overflow
+endif
+include $(BUILD_EXECUTABLE)
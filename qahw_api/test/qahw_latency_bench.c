@@ -0,0 +1,782 @@
+/*
+ * Copyright (c) 2020, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * End to end latency benchmark of the primary module. Opens -p playback and
+ * -r record streams, each driven by its own thread for -d seconds, and
+ * reports as JSON:
+ *
+ *  - write/read call latency percentiles per stream,
+ *  - presentation/capture position accuracy: the jitter of the position
+ *    error against the stream clock between two queries, and the drift of
+ *    that error over the run in ppm,
+ *  - standby exit time: the first write/read after qahw_out_standby() or
+ *    qahw_in_standby(), every -s ms,
+ *  - with -W, warm and cold standby exit time of the playback streams the
+ *    HAL can keep warm (not raw, VoIP or haptics): -W is the
+ *    standby_delay_ms audio_io_policy.conf gives their outputs, and after
+ *    each standby such a stream idles alternately for half of it, so it
+ *    resumes from warm standby, and for one and a half times it, so the
+ *    HAL has stopped it fully. The run fails if a stream's median warm
+ *    exit is not faster than its median cold exit,
+ *  - routing switch cost on the first playback stream every -R ms: the
+ *    duration of the routing set_parameters call and the glitch it causes,
+ *    i.e. how much longer than one write period the stream went without a
+ *    write completing around the switch.
+ *
+ * Playback and record streams cycle through the variants below, each of
+ * which lands on a different write or read function of the HAL, so the
+ * default 2+2 run covers the common usecases and -p 7 -r 7 every path.
+ * A variant the platform does not support fails to open and is reported as
+ * skipped. The mmap record usecase has no read path; the fast record
+ * variant is read through in_read_mmap() when the card offers noirq mode.
+ * The same binary runs on target and on a host against the
+ * simulated card of libalsa_sim (LD_PRELOAD or linked in place of
+ * tinyalsa); the simulator is found at run time and its speed is used to
+ * scale the stream clock and its counters are added to the report. At
+ * ALSA_SIM_SPEED=0 the card never blocks, so only call latencies are
+ * meaningful and the position and glitch sections are left out.
+ */
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "qahw_api.h"
+#include "qahw_defs.h"
+#include "alsa_sim.h"
+
+#define DEFAULT_DURATION_S 10
+#define DEFAULT_PLAYBACK_STREAMS 2
+#define DEFAULT_RECORD_STREAMS 2
+#define DEFAULT_STANDBY_MS 2000
+#define DEFAULT_ROUTING_MS 1000
+#define MAX_STREAMS 16
+#define BENCH_SAMPLE_RATE 48000
+/* completions this long after a routing switch still count towards its glitch */
+#define GLITCH_WINDOW_NS 100000000ull
+#define IO_HANDLE_BASE 0x100
+
+struct stream_variant {
+    const char *name;
+    uint32_t flags;
+    audio_format_t format;
+    audio_channel_mask_t channel_mask;
+    uint32_t sample_rate;
+    audio_source_t source;
+};
+
+/* the HAL function each variant is written through is noted above it */
+static const struct stream_variant playback_variants[] = {
+    /* out_write_pcm */
+    {"primary", AUDIO_OUTPUT_FLAG_PRIMARY, AUDIO_FORMAT_PCM_16_BIT,
+     AUDIO_CHANNEL_OUT_STEREO, BENCH_SAMPLE_RATE, AUDIO_SOURCE_DEFAULT},
+    {"fast", AUDIO_OUTPUT_FLAG_FAST, AUDIO_FORMAT_PCM_16_BIT,
+     AUDIO_CHANNEL_OUT_STEREO, BENCH_SAMPLE_RATE, AUDIO_SOURCE_DEFAULT},
+    {"deep_buffer", AUDIO_OUTPUT_FLAG_DEEP_BUFFER, AUDIO_FORMAT_PCM_16_BIT,
+     AUDIO_CHANNEL_OUT_STEREO, BENCH_SAMPLE_RATE, AUDIO_SOURCE_DEFAULT},
+    /* out_write_pcm_mmap when the card offers noirq mode, else out_write_pcm */
+    {"raw", AUDIO_OUTPUT_FLAG_FAST | AUDIO_OUTPUT_FLAG_RAW, AUDIO_FORMAT_PCM_16_BIT,
+     AUDIO_CHANNEL_OUT_STEREO, BENCH_SAMPLE_RATE, AUDIO_SOURCE_DEFAULT},
+    /* out_write_pcm_convert, float is narrowed to the backend format */
+    {"deep_buffer_float", AUDIO_OUTPUT_FLAG_DEEP_BUFFER, AUDIO_FORMAT_PCM_FLOAT,
+     AUDIO_CHANNEL_OUT_STEREO, BENCH_SAMPLE_RATE, AUDIO_SOURCE_DEFAULT},
+    /* out_write_pcm_voip_rx */
+    {"voip_rx", AUDIO_OUTPUT_FLAG_DIRECT | AUDIO_OUTPUT_FLAG_VOIP_RX,
+     AUDIO_FORMAT_PCM_16_BIT, AUDIO_CHANNEL_OUT_MONO, BENCH_SAMPLE_RATE,
+     AUDIO_SOURCE_DEFAULT},
+    /* out_write_pcm_haptics */
+    {"haptics", AUDIO_OUTPUT_FLAG_NONE, AUDIO_FORMAT_PCM_16_BIT,
+     AUDIO_CHANNEL_OUT_STEREO | AUDIO_CHANNEL_OUT_HAPTIC_A, BENCH_SAMPLE_RATE,
+     AUDIO_SOURCE_DEFAULT},
+};
+
+static const struct stream_variant record_variants[] = {
+    /* in_read_pcm */
+    {"mic", AUDIO_INPUT_FLAG_NONE, AUDIO_FORMAT_PCM_16_BIT,
+     AUDIO_CHANNEL_IN_MONO, BENCH_SAMPLE_RATE, AUDIO_SOURCE_MIC},
+    /* in_read_mmap when the card offers noirq mode, else in_read_pcm */
+    {"fast", AUDIO_INPUT_FLAG_FAST, AUDIO_FORMAT_PCM_16_BIT,
+     AUDIO_CHANNEL_IN_MONO, BENCH_SAMPLE_RATE, AUDIO_SOURCE_MIC},
+    /* in_read_pcm_24_8 */
+    {"mic_8_24", AUDIO_INPUT_FLAG_NONE, AUDIO_FORMAT_PCM_8_24_BIT,
+     AUDIO_CHANNEL_IN_MONO, BENCH_SAMPLE_RATE, AUDIO_SOURCE_MIC},
+    /* in_read_cin */
+    {"compress", AUDIO_INPUT_FLAG_COMPRESS, AUDIO_FORMAT_PCM_16_BIT,
+     AUDIO_CHANNEL_IN_MONO, BENCH_SAMPLE_RATE, AUDIO_SOURCE_MIC},
+    /* in_read_compr_cap */
+    {"amr_wb", AUDIO_INPUT_FLAG_NONE, AUDIO_FORMAT_AMR_WB,
+     AUDIO_CHANNEL_IN_MONO, 16000, AUDIO_SOURCE_MIC},
+    /* in_read_ssr */
+    {"ssr", AUDIO_INPUT_FLAG_NONE, AUDIO_FORMAT_PCM_16_BIT,
+     AUDIO_CHANNEL_IN_6, BENCH_SAMPLE_RATE, AUDIO_SOURCE_MIC},
+    /* in_read_ffv */
+    {"ffv", AUDIO_INPUT_FLAG_NONE, AUDIO_FORMAT_PCM_16_BIT,
+     AUDIO_CHANNEL_IN_MONO, 16000, AUDIO_SOURCE_MIC},
+};
+
+/* growable sample array, nanoseconds or signed nanoseconds */
+struct samples {
+    int64_t *v;
+    unsigned int n;
+    unsigned int cap;
+};
+
+struct bench_stream {
+    unsigned int id;
+    bool playback;
+    const struct stream_variant *variant;
+    qahw_stream_handle_t *stream;
+    int open_error;
+    size_t buffer_size;
+    size_t frame_size;
+    void *buffer;
+    pthread_t thread;
+    bool started;
+    bool warm_check;            /* alternate warm and cold standby exits */
+
+    struct samples call_ns;
+    struct samples done_ns;     /* completion time of each call */
+    struct samples exit_ns;     /* first call after standby */
+    struct samples warm_exit_ns;    /* ... idle shorter than the warm delay */
+    struct samples cold_exit_ns;    /* ... idle longer than the warm delay */
+    struct samples pos_jitter_ns;
+    unsigned int errors;
+    unsigned int standbys;
+
+    /* position reference, reset when the stream leaves standby */
+    bool pos_valid;
+    uint64_t pos_frames0;
+    uint64_t pos_time0;
+    int64_t pos_last_err;
+    bool pos_have_last;
+    unsigned int pos_queries;
+    unsigned int pos_unavailable;
+    unsigned int pos_regressions;
+    uint64_t pos_last_frames;
+    double drift_ppm;
+};
+
+struct routing_switch {
+    uint64_t start;
+    uint64_t end;
+};
+
+static volatile bool bench_stop;
+static unsigned int standby_ms = DEFAULT_STANDBY_MS;
+static unsigned int warm_ms;
+static double clock_speed = 1.0;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void sleep_ns(uint64_t ns)
+{
+    struct timespec ts;
+
+    ts.tv_sec = ns / 1000000000ull;
+    ts.tv_nsec = ns % 1000000000ull;
+    nanosleep(&ts, NULL);
+}
+
+static void samples_add(struct samples *s, int64_t v)
+{
+    if (s->n == s->cap) {
+        unsigned int cap = s->cap ? s->cap * 2 : 1024;
+        int64_t *p = (int64_t *)realloc(s->v, cap * sizeof(int64_t));
+
+        if (p == NULL)
+            return;
+        s->v = p;
+        s->cap = cap;
+    }
+    s->v[s->n++] = v;
+}
+
+static int cmp_s64(const void *a, const void *b)
+{
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+static double percentile_us(const int64_t *v, unsigned int n, unsigned int permille)
+{
+    unsigned int idx = (unsigned int)(((uint64_t)n * permille) / 1000);
+
+    return v[idx < n ? idx : n - 1] / 1000.0;
+}
+
+static int64_t samples_median(const struct samples *s)
+{
+    int64_t *v, median;
+
+    if (s->n == 0 || (v = (int64_t *)malloc(s->n * sizeof(int64_t))) == NULL)
+        return 0;
+    memcpy(v, s->v, s->n * sizeof(int64_t));
+    qsort(v, s->n, sizeof(int64_t), cmp_s64);
+    median = v[s->n / 2];
+    free(v);
+    return median;
+}
+
+/* Sorts a copy of s and prints it as a JSON percentile object. */
+static void print_percentiles(FILE *fp, const char *name, const struct samples *s,
+                              const char *indent)
+{
+    int64_t *v;
+
+    fprintf(fp, "%s\"%s\": ", indent, name);
+    if (s->n == 0 || (v = (int64_t *)malloc(s->n * sizeof(int64_t))) == NULL) {
+        fprintf(fp, "null");
+        return;
+    }
+    memcpy(v, s->v, s->n * sizeof(int64_t));
+    qsort(v, s->n, sizeof(int64_t), cmp_s64);
+    fprintf(fp, "{\"count\": %u, \"p50\": %.1f, \"p90\": %.1f, \"p99\": %.1f, "
+            "\"p999\": %.1f, \"max\": %.1f}", s->n, percentile_us(v, s->n, 500),
+            percentile_us(v, s->n, 900), percentile_us(v, s->n, 990),
+            percentile_us(v, s->n, 999), v[s->n - 1] / 1000.0);
+    free(v);
+}
+
+/*
+ * Compares the position the stream reports with the time it reports it for.
+ * The error is how far the stream clock is ahead of the frame count since
+ * the reference query; a healthy stream keeps it constant, so the change
+ * between two queries is the jitter and its slope over the run the drift.
+ */
+static void update_position(struct bench_stream *s)
+{
+    uint64_t frames, time_ns;
+    int64_t err;
+    int ret;
+
+    if (clock_speed <= 0)
+        return;
+
+    s->pos_queries++;
+    if (s->playback) {
+        struct timespec ts;
+
+        ret = qahw_out_get_presentation_position(s->stream, &frames, &ts);
+        time_ns = (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+    } else {
+        int64_t in_frames, in_time;
+
+        ret = qahw_in_get_capture_position(s->stream, &in_frames, &in_time);
+        frames = in_frames > 0 ? (uint64_t)in_frames : 0;
+        time_ns = in_time > 0 ? (uint64_t)in_time : 0;
+    }
+    if (ret != 0 || time_ns == 0) {
+        s->pos_unavailable++;
+        return;
+    }
+
+    if (!s->pos_valid) {
+        s->pos_valid = true;
+        s->pos_have_last = false;
+        s->pos_frames0 = frames;
+        s->pos_time0 = time_ns;
+        s->pos_last_frames = frames;
+        return;
+    }
+    if (frames < s->pos_last_frames || time_ns < s->pos_time0) {
+        /* position went backwards, start over from here */
+        s->pos_regressions++;
+        s->pos_valid = false;
+        return;
+    }
+    s->pos_last_frames = frames;
+
+    err = (int64_t)(time_ns - s->pos_time0) -
+          (int64_t)((double)(frames - s->pos_frames0) * 1000000000.0 /
+                    (s->variant->sample_rate * clock_speed));
+    if (s->pos_have_last)
+        samples_add(&s->pos_jitter_ns, llabs(err - s->pos_last_err));
+    s->pos_last_err = err;
+    s->pos_have_last = true;
+    if (time_ns - s->pos_time0 >= 1000000000ull)
+        s->drift_ppm = (double)err * 1e6 / (double)(time_ns - s->pos_time0);
+}
+
+static void *stream_thread(void *arg)
+{
+    struct bench_stream *s = (struct bench_stream *)arg;
+    uint64_t next_standby = now_ns() + standby_ms * 1000000ull;
+    bool exiting_standby = true, exit_cold = false;
+
+    while (!bench_stop) {
+        uint64_t start, end;
+        ssize_t ret;
+
+        if (standby_ms && now_ns() >= next_standby) {
+            if (s->playback)
+                qahw_out_standby(s->stream);
+            else
+                qahw_in_standby(s->stream);
+            s->standbys++;
+            s->pos_valid = false;
+            exiting_standby = true;
+            if (s->warm_check) {
+                exit_cold = !exit_cold;
+                sleep_ns((exit_cold ? warm_ms * 3 / 2 : warm_ms / 2) * 1000000ull);
+            }
+            next_standby = now_ns() + standby_ms * 1000000ull;
+        }
+
+        start = now_ns();
+        if (s->playback) {
+            qahw_out_buffer_t out_buf;
+
+            memset(&out_buf, 0, sizeof(out_buf));
+            out_buf.buffer = s->buffer;
+            out_buf.bytes = s->buffer_size;
+            ret = qahw_out_write(s->stream, &out_buf);
+        } else {
+            qahw_in_buffer_t in_buf;
+
+            memset(&in_buf, 0, sizeof(in_buf));
+            in_buf.buffer = s->buffer;
+            in_buf.bytes = s->buffer_size;
+            ret = qahw_in_read(s->stream, &in_buf);
+        }
+        end = now_ns();
+
+        if (ret < 0) {
+            s->errors++;
+            /* don't spin on a stream that keeps failing */
+            usleep(5000);
+            continue;
+        }
+        if (exiting_standby) {
+            /* the first call after open is a standby exit too */
+            samples_add(&s->exit_ns, end - start);
+            if (s->warm_check && s->standbys)
+                samples_add(exit_cold ? &s->cold_exit_ns : &s->warm_exit_ns, end - start);
+            exiting_standby = false;
+        } else {
+            samples_add(&s->call_ns, end - start);
+        }
+        samples_add(&s->done_ns, end);
+        update_position(s);
+    }
+    return NULL;
+}
+
+/* whether the HAL may leave a stream of v in warm standby */
+static bool variant_can_warm(const struct stream_variant *v)
+{
+    return !(v->flags & (AUDIO_OUTPUT_FLAG_RAW | AUDIO_OUTPUT_FLAG_VOIP_RX)) &&
+           !(v->channel_mask & AUDIO_CHANNEL_HAPTIC_ALL);
+}
+
+/*
+ * Opens the stream of s as its variant asks. A stream that fails to open is
+ * left closed with its error recorded, so the rest of the run goes on.
+ */
+static int open_stream(qahw_module_handle_t *module, struct bench_stream *s)
+{
+    const struct stream_variant *v = s->variant;
+    struct audio_config config;
+    unsigned int channels;
+    int ret;
+
+    memset(&config, 0, sizeof(config));
+    config.sample_rate = v->sample_rate;
+    config.format = v->format;
+    config.channel_mask = v->channel_mask;
+    if (s->playback) {
+        config.offload_info.size = sizeof(audio_offload_info_t);
+        ret = qahw_open_output_stream(module, IO_HANDLE_BASE + s->id,
+                                      AUDIO_DEVICE_OUT_SPEAKER,
+                                      (audio_output_flags_t)v->flags, &config,
+                                      &s->stream, "");
+        channels = audio_channel_count_from_out_mask(v->channel_mask);
+    } else {
+        ret = qahw_open_input_stream(module, IO_HANDLE_BASE + s->id,
+                                     AUDIO_DEVICE_IN_BUILTIN_MIC, &config,
+                                     &s->stream, (audio_input_flags_t)v->flags,
+                                     "", v->source);
+        channels = audio_channel_count_from_in_mask(v->channel_mask);
+    }
+    if (ret != 0 || s->stream == NULL) {
+        fprintf(stderr, "skipping %s stream %u (%s): open failed %d\n",
+                s->playback ? "playback" : "record", s->id, v->name, ret);
+        s->stream = NULL;
+        s->open_error = ret ? ret : -EINVAL;
+        return s->open_error;
+    }
+
+    /* compressed capture is counted in bytes */
+    s->frame_size = audio_has_proportional_frames(v->format) ?
+                    audio_bytes_per_sample(v->format) * channels : 1;
+    s->buffer_size = s->playback ? qahw_out_get_buffer_size(s->stream) :
+                                   qahw_in_get_buffer_size(s->stream);
+    if (s->buffer_size == 0)
+        s->buffer_size = v->sample_rate / 50 * s->frame_size;
+    s->buffer = calloc(1, s->buffer_size);
+    return s->buffer ? 0 : -ENOMEM;
+}
+
+static void close_stream(struct bench_stream *s)
+{
+    if (s->stream != NULL) {
+        if (s->playback)
+            qahw_close_output_stream(s->stream);
+        else
+            qahw_close_input_stream(s->stream);
+    }
+    free(s->buffer);
+    free(s->call_ns.v);
+    free(s->done_ns.v);
+    free(s->exit_ns.v);
+    free(s->warm_exit_ns.v);
+    free(s->cold_exit_ns.v);
+    free(s->pos_jitter_ns.v);
+}
+
+/*
+ * Glitch of each routing switch: the longest gap between two completed
+ * writes of the stream from the start of the switch until GLITCH_WINDOW_NS
+ * after it returned, less the nominal period of one write.
+ */
+static void routing_glitches(const struct bench_stream *s,
+                             const struct routing_switch *sw, unsigned int num_sw,
+                             struct samples *glitch_ns)
+{
+    int64_t period = (int64_t)((double)(s->buffer_size / s->frame_size) *
+                               1000000000.0 / (s->variant->sample_rate * clock_speed));
+    unsigned int i, k = 0;
+
+    for (i = 0; i < num_sw; i++) {
+        uint64_t prev = sw[i].start, last = sw[i].end + GLITCH_WINDOW_NS;
+        int64_t gap = 0;
+
+        while (k < s->done_ns.n && (uint64_t)s->done_ns.v[k] <= sw[i].start)
+            k++;
+        for (; k < s->done_ns.n && (uint64_t)s->done_ns.v[k] <= last; k++) {
+            if ((int64_t)(s->done_ns.v[k] - prev) > gap)
+                gap = s->done_ns.v[k] - prev;
+            prev = s->done_ns.v[k];
+        }
+        samples_add(glitch_ns, gap > period ? gap - period : 0);
+    }
+}
+
+static void print_stream(FILE *fp, const struct bench_stream *s, bool last)
+{
+    fprintf(fp, "    {\"id\": %u, \"direction\": \"%s\", \"variant\": \"%s\", "
+            "\"flags\": \"0x%x\",\n", s->id, s->playback ? "playback" : "record",
+            s->variant->name, s->variant->flags);
+    if (s->stream == NULL) {
+        fprintf(fp, "     \"skipped\": true, \"open_error\": %d}%s\n",
+                s->open_error, last ? "" : ",");
+        return;
+    }
+    fprintf(fp, "     \"buffer_bytes\": %zu, ", s->buffer_size);
+    fprintf(fp, "\"errors\": %u, \"standbys\": %u,\n", s->errors, s->standbys);
+    print_percentiles(fp, "call_us", &s->call_ns, "     ");
+    fprintf(fp, ",\n");
+    print_percentiles(fp, "standby_exit_us", &s->exit_ns, "     ");
+    if (s->warm_check) {
+        fprintf(fp, ",\n");
+        print_percentiles(fp, "warm_exit_us", &s->warm_exit_ns, "     ");
+        fprintf(fp, ",\n");
+        print_percentiles(fp, "cold_exit_us", &s->cold_exit_ns, "     ");
+    }
+    fprintf(fp, ",\n     \"position\": ");
+    if (clock_speed <= 0) {
+        fprintf(fp, "null");
+    } else {
+        fprintf(fp, "{\"queries\": %u, \"unavailable\": %u, \"regressions\": %u, "
+                "\"drift_ppm\": %.1f,\n", s->pos_queries, s->pos_unavailable,
+                s->pos_regressions, s->drift_ppm);
+        print_percentiles(fp, "jitter_us", &s->pos_jitter_ns, "                  ");
+        fprintf(fp, "}");
+    }
+    fprintf(fp, "}%s\n", last ? "" : ",");
+}
+
+static void usage(void)
+{
+    printf(" \n Usage: hal_latency_bench [options]\n");
+    printf(" -p --playback <count>    - playback streams, default %d\n", DEFAULT_PLAYBACK_STREAMS);
+    printf(" -r --record <count>      - record streams, default %d\n", DEFAULT_RECORD_STREAMS);
+    printf(" -d --duration <seconds>  - run time, default %d\n", DEFAULT_DURATION_S);
+    printf(" -s --standby <ms>        - standby interval per stream, 0 disables, default %d\n",
+           DEFAULT_STANDBY_MS);
+    printf(" -R --routing <ms>        - routing switch interval, 0 disables, default %d\n",
+           DEFAULT_ROUTING_MS);
+    printf(" -W --warm <ms>           - standby_delay_ms of the playback outputs, compares\n"
+           "                            warm and cold standby exits, default off\n");
+    printf(" -o --output <file>       - JSON report, default stdout\n");
+}
+
+int main(int argc, char *argv[])
+{
+    struct bench_stream streams[MAX_STREAMS];
+    unsigned int num_playback = DEFAULT_PLAYBACK_STREAMS;
+    unsigned int num_record = DEFAULT_RECORD_STREAMS;
+    unsigned int duration_s = DEFAULT_DURATION_S, routing_ms = DEFAULT_ROUTING_MS;
+    unsigned int num_streams, num_opened = 0, num_sw = 0, max_sw, i;
+    struct routing_switch *sw = NULL;
+    struct samples set_params_ns, glitch_ns;
+    void (*sim_get_stats)(struct alsa_sim_stats *);
+    double (*sim_get_speed)(void);
+    struct bench_stream *routed = NULL;
+    qahw_module_handle_t *module;
+    const char *output = NULL;
+    uint64_t start, end, next_switch, wake;
+    FILE *fp = stdout;
+    int opt, option_index = 0, rc = 0;
+
+    struct option long_options[] = {
+        {"playback", required_argument, 0, 'p'},
+        {"record",   required_argument, 0, 'r'},
+        {"duration", required_argument, 0, 'd'},
+        {"standby",  required_argument, 0, 's'},
+        {"routing",  required_argument, 0, 'R'},
+        {"warm",     required_argument, 0, 'W'},
+        {"output",   required_argument, 0, 'o'},
+        {"help",     no_argument,       0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    while ((opt = getopt_long(argc, argv, "p:r:d:s:R:W:o:h",
+                              long_options, &option_index)) != -1) {
+        switch (opt) {
+        case 'p':
+            num_playback = atoi(optarg);
+            break;
+        case 'r':
+            num_record = atoi(optarg);
+            break;
+        case 'd':
+            duration_s = atoi(optarg);
+            break;
+        case 's':
+            standby_ms = atoi(optarg);
+            break;
+        case 'R':
+            routing_ms = atoi(optarg);
+            break;
+        case 'W':
+            warm_ms = atoi(optarg);
+            break;
+        case 'o':
+            output = optarg;
+            break;
+        case 'h':
+        default:
+            usage();
+            return 0;
+        }
+    }
+    num_streams = num_playback + num_record;
+    if (num_streams == 0 || num_streams > MAX_STREAMS || duration_s == 0) {
+        usage();
+        return -EINVAL;
+    }
+
+    sim_get_stats = (void (*)(struct alsa_sim_stats *))dlsym(RTLD_DEFAULT,
+                                                             "alsa_sim_get_stats");
+    sim_get_speed = (double (*)(void))dlsym(RTLD_DEFAULT, "alsa_sim_get_speed");
+    if (sim_get_speed != NULL)
+        clock_speed = sim_get_speed();
+    if (sim_get_stats != NULL) {
+        void (*sim_reset_stats)(void) =
+            (void (*)(void))dlsym(RTLD_DEFAULT, "alsa_sim_reset_stats");
+
+        if (sim_reset_stats != NULL)
+            sim_reset_stats();
+    }
+
+    memset(streams, 0, sizeof(streams));
+    memset(&set_params_ns, 0, sizeof(set_params_ns));
+    memset(&glitch_ns, 0, sizeof(glitch_ns));
+    for (i = 0; i < num_streams; i++) {
+        streams[i].id = i;
+        streams[i].playback = i < num_playback;
+        streams[i].variant = streams[i].playback ?
+            &playback_variants[i % (sizeof(playback_variants) /
+                                    sizeof(playback_variants[0]))] :
+            &record_variants[(i - num_playback) %
+                             (sizeof(record_variants) / sizeof(record_variants[0]))];
+        streams[i].warm_check = streams[i].playback && warm_ms &&
+                                variant_can_warm(streams[i].variant);
+    }
+
+    module = qahw_load_module(QAHW_MODULE_ID_PRIMARY);
+    if (module == NULL) {
+        fprintf(stderr, "failed to load primary module\n");
+        return -ENODEV;
+    }
+
+    for (i = 0; i < num_streams; i++) {
+        if (open_stream(module, &streams[i]) != 0)
+            continue;
+        num_opened++;
+        if (routed == NULL && streams[i].playback)
+            routed = &streams[i];
+    }
+    if (num_opened == 0) {
+        fprintf(stderr, "no stream could be opened\n");
+        rc = -ENODEV;
+        goto done;
+    }
+    if (routing_ms == 0)
+        routed = NULL;
+    if (routed != NULL) {
+        max_sw = (duration_s * 1000) / routing_ms + 1;
+        sw = (struct routing_switch *)calloc(max_sw, sizeof(*sw));
+    }
+
+    start = now_ns();
+    for (i = 0; i < num_streams; i++) {
+        if (streams[i].stream == NULL)
+            continue;
+        if (pthread_create(&streams[i].thread, NULL, stream_thread, &streams[i]) != 0) {
+            fprintf(stderr, "failed to start stream %u\n", i);
+            bench_stop = true;
+            rc = -EINVAL;
+            break;
+        }
+        streams[i].started = true;
+    }
+
+    end = start + duration_s * 1000000000ull;
+    next_switch = start + routing_ms * 1000000ull;
+    while (!bench_stop && now_ns() < end) {
+        uint64_t now = now_ns();
+
+        if (sw != NULL && now >= next_switch && num_sw < max_sw) {
+            char kvpairs[32];
+
+            snprintf(kvpairs, sizeof(kvpairs), "routing=%d",
+                     num_sw % 2 ? AUDIO_DEVICE_OUT_SPEAKER :
+                                  AUDIO_DEVICE_OUT_WIRED_HEADPHONE);
+            sw[num_sw].start = now_ns();
+            qahw_out_set_parameters(routed->stream, kvpairs);
+            sw[num_sw].end = now_ns();
+            samples_add(&set_params_ns, sw[num_sw].end - sw[num_sw].start);
+            num_sw++;
+            next_switch += routing_ms * 1000000ull;
+            continue;
+        }
+        wake = (sw != NULL && next_switch < end) ? next_switch : end;
+        if (now < wake)
+            sleep_ns(wake - now);
+    }
+    bench_stop = true;
+    for (i = 0; i < num_streams; i++)
+        if (streams[i].started)
+            pthread_join(streams[i].thread, NULL);
+    end = now_ns();
+
+    if (output != NULL && (fp = fopen(output, "w")) == NULL) {
+        fprintf(stderr, "cannot open %s: %s\n", output, strerror(errno));
+        fp = stdout;
+    }
+
+    fprintf(fp, "{\n  \"backend\": \"%s\", \"clock_speed\": %.3f, \"duration_s\": %.3f,\n",
+            sim_get_speed != NULL ? "alsa_sim" : "hw", clock_speed,
+            (end - start) / 1000000000.0);
+    fprintf(fp, "  \"standby_interval_ms\": %u, \"routing_interval_ms\": %u, "
+            "\"warm_delay_ms\": %u,\n", standby_ms, routed != NULL ? routing_ms : 0,
+            warm_ms);
+    fprintf(fp, "  \"streams\": [\n");
+    for (i = 0; i < num_streams; i++)
+        print_stream(fp, &streams[i], i == num_streams - 1);
+    fprintf(fp, "  ],\n  \"routing\": ");
+    if (routed == NULL) {
+        fprintf(fp, "null");
+    } else {
+        fprintf(fp, "{\"stream\": %u, \"switches\": %u,\n", routed->id, num_sw);
+        print_percentiles(fp, "set_parameters_us", &set_params_ns, "              ");
+        if (clock_speed > 0) {
+            routing_glitches(routed, sw, num_sw, &glitch_ns);
+            fprintf(fp, ",\n");
+            print_percentiles(fp, "glitch_us", &glitch_ns, "              ");
+        }
+        fprintf(fp, "}");
+    }
+    if (sim_get_stats != NULL) {
+        struct alsa_sim_stats stats;
+
+        sim_get_stats(&stats);
+        fprintf(fp, ",\n  \"alsa_sim\": {\"pcm_opens\": %llu, \"frames_written\": %llu, "
+                "\"frames_read\": %llu, \"xruns\": %llu, \"blocked_ms\": %.1f,\n"
+                "               \"ctl_writes\": %llu, \"ctl_events\": %llu}",
+                (unsigned long long)stats.pcm_opens,
+                (unsigned long long)stats.frames_written,
+                (unsigned long long)stats.frames_read,
+                (unsigned long long)stats.xruns, stats.blocked_ns / 1000000.0,
+                (unsigned long long)stats.ctl_writes,
+                (unsigned long long)stats.ctl_events);
+    }
+    fprintf(fp, "\n}\n");
+    if (fp != stdout)
+        fclose(fp);
+
+    for (i = 0; i < num_streams; i++) {
+        const struct bench_stream *s = &streams[i];
+
+        if (!s->warm_check || s->warm_exit_ns.n == 0 || s->cold_exit_ns.n == 0)
+            continue;
+        if (samples_median(&s->warm_exit_ns) >= samples_median(&s->cold_exit_ns)) {
+            fprintf(stderr, "stream %u (%s): warm standby exit %.1f us is not faster "
+                    "than cold %.1f us\n", s->id, s->variant->name,
+                    samples_median(&s->warm_exit_ns) / 1000.0,
+                    samples_median(&s->cold_exit_ns) / 1000.0);
+            rc = -EIO;
+        }
+    }
+
+done:
+    for (i = 0; i < num_streams; i++)
+        close_stream(&streams[i]);
+    qahw_unload_module(module);
+    free(sw);
+    free(set_params_ns.v);
+    free(glitch_ns.v);
+    return rc;
+}
@@ -0,0 +1,279 @@
+/*
+ * Copyright (c) 2019, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Replays a set_parameters trace against the primary module and reports the
+ * latency of each distinct kvpair string. With -c, a second thread keeps
+ * calling qahw_get_parameters(), which takes the device lock in the HAL, to
+ * show how long set_parameters holds that lock.
+ *
+ * The trace holds one kvpair string per line, e.g. captured from the
+ * "adev_set_parameters: enter:" lines of logcat; empty lines and lines
+ * starting with '#' are skipped. Without -f a built-in trace of common
+ * framework parameters is used.
+ */
+
+#include <errno.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "qahw_api.h"
+#include "qahw_defs.h"
+
+#define DEFAULT_NUM_PASSES 200
+#define MAX_TRACE_LINES 256
+#define MAX_LINE_LEN 1024
+
+static const char *default_trace[] = {
+    "screen_state=on",
+    "rotation=90",
+    "rotation=0",
+    "bt_headset_name=<unknown>;bt_headset_nrec=on",
+    "bt_wbs=on",
+    "BT_SCO=off",
+    "A2dpSuspended=false",
+    "tty_mode=tty_off",
+    "HACSetting=OFF",
+    "screen_state=off",
+};
+
+struct trace_entry {
+    char *kvpairs;
+    uint64_t *ns;
+    unsigned int count;
+};
+
+static volatile bool contention_stop;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+static double percentile_us(uint64_t *v, unsigned int n, unsigned int pct)
+{
+    unsigned int idx = (n * pct) / 100;
+
+    return v[idx < n ? idx : n - 1] / 1000.0;
+}
+
+static void print_stats(const char *label, uint64_t *v, unsigned int n)
+{
+    if (n == 0)
+        return;
+    qsort(v, n, sizeof(uint64_t), cmp_u64);
+    fprintf(stdout, "%8u  %9.1f %9.1f %9.1f  %s\n", n, percentile_us(v, n, 50),
+            percentile_us(v, n, 99), v[n - 1] / 1000.0, label);
+}
+
+static int load_trace(const char *path, struct trace_entry *entries,
+                      unsigned int *num_entries)
+{
+    char line[MAX_LINE_LEN];
+    unsigned int n = 0;
+    FILE *fp;
+
+    if (path == NULL) {
+        for (n = 0; n < sizeof(default_trace) / sizeof(default_trace[0]); n++)
+            entries[n].kvpairs = strdup(default_trace[n]);
+        *num_entries = n;
+        return 0;
+    }
+
+    fp = fopen(path, "r");
+    if (fp == NULL) {
+        fprintf(stderr, "cannot open %s: %s\n", path, strerror(errno));
+        return -errno;
+    }
+    while (n < MAX_TRACE_LINES && fgets(line, sizeof(line), fp) != NULL) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0' || line[0] == '#')
+            continue;
+        entries[n++].kvpairs = strdup(line);
+    }
+    fclose(fp);
+    *num_entries = n;
+    return n > 0 ? 0 : -EINVAL;
+}
+
+struct contention {
+    qahw_module_handle_t *module;
+    uint64_t *ns;
+    unsigned int count;
+};
+
+static void *contention_thread(void *arg)
+{
+    struct contention *c = (struct contention *)arg;
+    unsigned int max = 1000000;
+
+    c->ns = (uint64_t *)calloc(max, sizeof(uint64_t));
+    if (c->ns == NULL)
+        return NULL;
+
+    while (!contention_stop && c->count < max) {
+        uint64_t start = now_ns();
+        char *reply = qahw_get_parameters(c->module, "vr_audio_mode_on");
+
+        c->ns[c->count++] = now_ns() - start;
+        free(reply);
+    }
+    return NULL;
+}
+
+static void usage(void)
+{
+    printf(" \n Usage: hal_set_params_bench [options]\n");
+    printf(" -f --trace <file>     - kvpair strings to replay, one per line\n");
+    printf(" -n --passes <count>   - passes over the trace, default %d\n", DEFAULT_NUM_PASSES);
+    printf(" -c --contention       - measure get_parameters latency concurrently\n");
+}
+
+int main(int argc, char *argv[])
+{
+    struct trace_entry entries[MAX_TRACE_LINES];
+    unsigned int num_entries = 0, passes = DEFAULT_NUM_PASSES;
+    const char *trace = NULL;
+    bool contention = false;
+    qahw_module_handle_t *module;
+    struct contention contention_ctx;
+    pthread_t thread;
+    uint64_t *all_ns, start, total;
+    unsigned int i, p, all = 0;
+    int opt, option_index = 0, rc = 0;
+
+    struct option long_options[] = {
+        {"trace",      required_argument, 0, 'f'},
+        {"passes",     required_argument, 0, 'n'},
+        {"contention", no_argument,       0, 'c'},
+        {"help",       no_argument,       0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    while ((opt = getopt_long(argc, argv, "f:n:ch",
+                              long_options, &option_index)) != -1) {
+        switch (opt) {
+        case 'f':
+            trace = optarg;
+            break;
+        case 'n':
+            passes = atoi(optarg);
+            break;
+        case 'c':
+            contention = true;
+            break;
+        case 'h':
+        default:
+            usage();
+            return 0;
+        }
+    }
+    if (passes == 0) {
+        usage();
+        return -EINVAL;
+    }
+
+    memset(entries, 0, sizeof(entries));
+    if (load_trace(trace, entries, &num_entries) != 0)
+        return -EINVAL;
+
+    all_ns = (uint64_t *)calloc((size_t)num_entries * passes, sizeof(uint64_t));
+    for (i = 0; i < num_entries; i++)
+        entries[i].ns = (uint64_t *)calloc(passes, sizeof(uint64_t));
+
+    module = qahw_load_module(QAHW_MODULE_ID_PRIMARY);
+    if (module == NULL) {
+        fprintf(stderr, "failed to load primary module\n");
+        rc = -ENODEV;
+        goto done;
+    }
+
+    memset(&contention_ctx, 0, sizeof(contention_ctx));
+    contention_ctx.module = module;
+    if (contention &&
+            pthread_create(&thread, NULL, contention_thread, &contention_ctx) != 0)
+        contention = false;
+
+    start = now_ns();
+    for (p = 0; p < passes; p++) {
+        for (i = 0; i < num_entries; i++) {
+            uint64_t t = now_ns();
+
+            qahw_set_parameters(module, entries[i].kvpairs);
+            t = now_ns() - t;
+            if (entries[i].ns != NULL)
+                entries[i].ns[entries[i].count++] = t;
+            if (all_ns != NULL)
+                all_ns[all++] = t;
+        }
+    }
+    total = now_ns() - start;
+
+    if (contention) {
+        contention_stop = true;
+        pthread_join(thread, NULL);
+    }
+
+    fprintf(stdout, "%u kvpair strings, %u passes, %.1f ms total\n",
+            num_entries, passes, total / 1000000.0);
+    fprintf(stdout, "%8s  %9s %9s %9s  %s\n", "calls", "p50 us", "p99 us", "max us",
+            "kvpairs");
+    for (i = 0; i < num_entries; i++)
+        print_stats(entries[i].kvpairs, entries[i].ns, entries[i].count);
+    print_stats("(all)", all_ns, all);
+    if (contention) {
+        print_stats("get_parameters while replaying", contention_ctx.ns,
+                    contention_ctx.count);
+        free(contention_ctx.ns);
+    }
+
+    qahw_unload_module(module);
+done:
+    for (i = 0; i < num_entries; i++) {
+        free(entries[i].kvpairs);
+        free(entries[i].ns);
+    }
+    free(all_ns);
+    return rc;
+}
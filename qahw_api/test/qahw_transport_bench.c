@@ -0,0 +1,419 @@
+/*
+ * Copyright (c) 2019, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Benchmark of the qahw_api stream data path.
+ *
+ * hal mode writes to a real output stream through qahw_api and reports the
+ * wall time and the client CPU time of each write. Run it once with
+ * vendor.audio.qas.shm_transport.enable=false (binder data path) and once
+ * with true (shared memory data path) on a target where
+ * persist.vendor.audio.qas.enabled=true. The CPU time per write isolates the
+ * transport cost from the HAL pacing that dominates the wall time.
+ *
+ * transport mode needs no audio HAL: it forks a null server and compares the
+ * shared memory transport with a socket round trip that copies the payload
+ * through the kernel both ways, as a binder transaction does.
+ */
+
+#include <errno.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <cutils/properties.h>
+#include "qahw_api.h"
+#include "qahw_defs.h"
+#include "qahw_shm_transport.h"
+
+#define DEFAULT_NUM_CALLS 2000
+
+struct bench_stats {
+    uint64_t *wall_ns;
+    uint64_t *cpu_ns;
+    unsigned int count;
+    uint64_t bytes;
+    uint64_t total_ns;
+};
+
+static uint64_t now_ns(clockid_t clock)
+{
+    struct timespec ts;
+
+    clock_gettime(clock, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+static uint64_t percentile(uint64_t *v, unsigned int n, unsigned int pct)
+{
+    unsigned int idx = (n * pct) / 100;
+
+    return v[idx < n ? idx : n - 1];
+}
+
+static int stats_init(struct bench_stats *stats, unsigned int calls)
+{
+    memset(stats, 0, sizeof(*stats));
+    stats->wall_ns = (uint64_t *)calloc(calls, sizeof(uint64_t));
+    stats->cpu_ns = (uint64_t *)calloc(calls, sizeof(uint64_t));
+    if (stats->wall_ns == NULL || stats->cpu_ns == NULL) {
+        free(stats->wall_ns);
+        free(stats->cpu_ns);
+        return -ENOMEM;
+    }
+    return 0;
+}
+
+static void stats_print(const char *label, struct bench_stats *stats)
+{
+    unsigned int n = stats->count;
+
+    if (n == 0) {
+        fprintf(stderr, "%s: no successful calls\n", label);
+        return;
+    }
+    qsort(stats->wall_ns, n, sizeof(uint64_t), cmp_u64);
+    qsort(stats->cpu_ns, n, sizeof(uint64_t), cmp_u64);
+    fprintf(stdout, "%-10s calls %u  wall us p50 %.1f p99 %.1f max %.1f  "
+            "cpu us p50 %.1f p99 %.1f  throughput %.1f MB/s\n",
+            label, n,
+            percentile(stats->wall_ns, n, 50) / 1000.0,
+            percentile(stats->wall_ns, n, 99) / 1000.0,
+            stats->wall_ns[n - 1] / 1000.0,
+            percentile(stats->cpu_ns, n, 50) / 1000.0,
+            percentile(stats->cpu_ns, n, 99) / 1000.0,
+            stats->total_ns ? (stats->bytes * 1000.0) / stats->total_ns : 0.0);
+    free(stats->wall_ns);
+    free(stats->cpu_ns);
+}
+
+/* hal mode */
+
+static int bench_hal(unsigned int calls, uint32_t rate, uint32_t channels,
+                     audio_format_t format, audio_output_flags_t flags)
+{
+    qahw_module_handle_t *module;
+    qahw_stream_handle_t *out = NULL;
+    struct audio_config config;
+    struct bench_stats stats;
+    qahw_out_buffer_t out_buf;
+    size_t bytes;
+    void *data;
+    uint64_t start;
+    unsigned int i;
+    int rc;
+
+    module = qahw_load_module(QAHW_MODULE_ID_PRIMARY);
+    if (module == NULL) {
+        fprintf(stderr, "failed to load primary module\n");
+        return -ENODEV;
+    }
+
+    memset(&config, 0, sizeof(config));
+    config.sample_rate = rate;
+    config.channel_mask = audio_channel_out_mask_from_count(channels);
+    config.format = format;
+    rc = qahw_open_output_stream(module, 0x999, AUDIO_DEVICE_OUT_SPEAKER, flags,
+                                 &config, &out, "");
+    if (rc != 0 || out == NULL) {
+        fprintf(stderr, "failed to open output stream %d\n", rc);
+        qahw_unload_module(module);
+        return rc ? rc : -EINVAL;
+    }
+
+    bytes = qahw_out_get_buffer_size(out);
+    data = calloc(1, bytes);
+    if (data == NULL || stats_init(&stats, calls) != 0) {
+        free(data);
+        qahw_close_output_stream(out);
+        qahw_unload_module(module);
+        return -ENOMEM;
+    }
+
+    fprintf(stdout, "hal: %u Hz %u ch format %#x flags %#x, %zu bytes per write, "
+            "qas %d shm transport %d\n", rate, channels, format, flags, bytes,
+            property_get_bool("persist.vendor.audio.qas.enabled", false),
+            property_get_bool(QAHW_SHM_TRANSPORT_PROPERTY, false));
+
+    memset(&out_buf, 0, sizeof(out_buf));
+    out_buf.buffer = data;
+    out_buf.bytes = bytes;
+    start = now_ns(CLOCK_MONOTONIC);
+    for (i = 0; i < calls; i++) {
+        uint64_t wall = now_ns(CLOCK_MONOTONIC);
+        uint64_t cpu = now_ns(CLOCK_THREAD_CPUTIME_ID);
+        ssize_t written = qahw_out_write(out, &out_buf);
+
+        if (written < 0) {
+            fprintf(stderr, "write failed %zd\n", written);
+            break;
+        }
+        stats.cpu_ns[stats.count] = now_ns(CLOCK_THREAD_CPUTIME_ID) - cpu;
+        stats.wall_ns[stats.count] = now_ns(CLOCK_MONOTONIC) - wall;
+        stats.count++;
+        stats.bytes += written;
+    }
+    stats.total_ns = now_ns(CLOCK_MONOTONIC) - start;
+    stats_print("hal", &stats);
+
+    free(data);
+    qahw_close_output_stream(out);
+    qahw_unload_module(module);
+    return 0;
+}
+
+/* transport mode */
+
+static ssize_t null_handler(void *cookie, qahw_shm_request_t *req)
+{
+    volatile uint8_t last;
+
+    (void)cookie;
+    /* touch the payload like a HAL write would */
+    if (req->bytes > 0)
+        last = ((uint8_t *)req->buffer)[req->bytes - 1];
+    (void)last;
+    return req->bytes;
+}
+
+static int bench_shm(unsigned int calls, size_t bytes)
+{
+    qahw_shm_transport_t *transport;
+    struct bench_stats stats;
+    void *data;
+    pid_t pid;
+    uint64_t start;
+    unsigned int i;
+    int rc;
+
+    rc = qahw_shm_transport_create(bytes, &transport);
+    if (rc != 0)
+        return rc;
+
+    pid = fork();
+    if (pid == 0) {
+        /* the child owns a copy of the mapping and descriptors */
+        if (qahw_shm_transport_serve(transport, null_handler, NULL) == 0)
+            pause();
+        _exit(1);
+    }
+
+    data = calloc(1, bytes);
+    if (pid < 0 || data == NULL || stats_init(&stats, calls) != 0) {
+        free(data);
+        if (pid > 0)
+            kill(pid, SIGKILL);
+        qahw_shm_transport_destroy(transport);
+        return -ENOMEM;
+    }
+
+    start = now_ns(CLOCK_MONOTONIC);
+    for (i = 0; i < calls; i++) {
+        qahw_shm_request_t req;
+        uint64_t wall = now_ns(CLOCK_MONOTONIC);
+        uint64_t cpu = now_ns(CLOCK_THREAD_CPUTIME_ID);
+        ssize_t ret;
+
+        memset(&req, 0, sizeof(req));
+        req.op = QAHW_SHM_OP_WRITE;
+        req.buffer = data;
+        req.bytes = bytes;
+        ret = qahw_shm_transport_call(transport, &req, NULL);
+        if (ret < 0)
+            break;
+        stats.cpu_ns[stats.count] = now_ns(CLOCK_THREAD_CPUTIME_ID) - cpu;
+        stats.wall_ns[stats.count] = now_ns(CLOCK_MONOTONIC) - wall;
+        stats.count++;
+        stats.bytes += ret;
+    }
+    stats.total_ns = now_ns(CLOCK_MONOTONIC) - start;
+    stats_print("shm", &stats);
+
+    kill(pid, SIGKILL);
+    waitpid(pid, NULL, 0);
+    free(data);
+    qahw_shm_transport_destroy(transport);
+    return 0;
+}
+
+static int bench_socket(unsigned int calls, size_t bytes)
+{
+    struct bench_stats stats;
+    int sv[2];
+    int sock_buf;
+    uint8_t *data;
+    pid_t pid;
+    uint64_t start;
+    unsigned int i;
+
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sv) < 0)
+        return -errno;
+    /* large payloads must fit in one packet */
+    sock_buf = (int)bytes * 2;
+    setsockopt(sv[0], SOL_SOCKET, SO_SNDBUF, &sock_buf, sizeof(sock_buf));
+    setsockopt(sv[1], SOL_SOCKET, SO_RCVBUF, &sock_buf, sizeof(sock_buf));
+
+    pid = fork();
+    if (pid == 0) {
+        uint8_t *buf = (uint8_t *)malloc(bytes);
+        ssize_t len;
+
+        close(sv[0]);
+        while (buf != NULL && (len = recv(sv[1], buf, bytes, 0)) > 0) {
+            int64_t result = len;
+            send(sv[1], &result, sizeof(result), 0);
+        }
+        _exit(0);
+    }
+    close(sv[1]);
+
+    data = (uint8_t *)calloc(1, bytes);
+    if (pid < 0 || data == NULL || stats_init(&stats, calls) != 0) {
+        free(data);
+        close(sv[0]);
+        return -ENOMEM;
+    }
+
+    start = now_ns(CLOCK_MONOTONIC);
+    for (i = 0; i < calls; i++) {
+        uint64_t wall = now_ns(CLOCK_MONOTONIC);
+        uint64_t cpu = now_ns(CLOCK_THREAD_CPUTIME_ID);
+        int64_t result;
+
+        if (send(sv[0], data, bytes, 0) != (ssize_t)bytes ||
+                recv(sv[0], &result, sizeof(result), 0) != sizeof(result))
+            break;
+        stats.cpu_ns[stats.count] = now_ns(CLOCK_THREAD_CPUTIME_ID) - cpu;
+        stats.wall_ns[stats.count] = now_ns(CLOCK_MONOTONIC) - wall;
+        stats.count++;
+        stats.bytes += result;
+    }
+    stats.total_ns = now_ns(CLOCK_MONOTONIC) - start;
+    stats_print("socket", &stats);
+
+    close(sv[0]);
+    waitpid(pid, NULL, 0);
+    free(data);
+    return 0;
+}
+
+static void usage(void)
+{
+    printf(" \n Usage: hal_transport_bench [options]\n");
+    printf(" -m --mode <hal|transport>     - hal: write to an output stream through qahw_api\n");
+    printf("                                 transport: compare data paths without a HAL\n");
+    printf(" -n --calls <count>            - number of writes, default %d\n", DEFAULT_NUM_CALLS);
+    printf(" -r --sample-rate <Hz>         - hal mode sample rate, default 48000\n");
+    printf(" -c --channels <count>         - hal mode channel count, default 2\n");
+    printf(" -b --bits <16|24|32>          - hal mode sample width, default 16\n");
+    printf(" -F --flags <hex>              - hal mode output flags, default primary\n");
+    printf(" -s --size <bytes>             - transport mode payload size, default 36864\n");
+    printf("                                 (192 kHz, 8 ch, 24 bit, 2 ms)\n");
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned int calls = DEFAULT_NUM_CALLS;
+    uint32_t rate = 48000, channels = 2, bits = 16;
+    audio_output_flags_t flags = AUDIO_OUTPUT_FLAG_PRIMARY;
+    audio_format_t format;
+    size_t size = 192 * 8 * 3 * 8;
+    bool hal_mode = true;
+    int opt, option_index = 0;
+
+    struct option long_options[] = {
+        {"mode",        required_argument, 0, 'm'},
+        {"calls",       required_argument, 0, 'n'},
+        {"sample-rate", required_argument, 0, 'r'},
+        {"channels",    required_argument, 0, 'c'},
+        {"bits",        required_argument, 0, 'b'},
+        {"flags",       required_argument, 0, 'F'},
+        {"size",        required_argument, 0, 's'},
+        {"help",        no_argument,       0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    while ((opt = getopt_long(argc, argv, "m:n:r:c:b:F:s:h",
+                              long_options, &option_index)) != -1) {
+        switch (opt) {
+        case 'm':
+            hal_mode = strcmp(optarg, "transport") != 0;
+            break;
+        case 'n':
+            calls = atoi(optarg);
+            break;
+        case 'r':
+            rate = atoi(optarg);
+            break;
+        case 'c':
+            channels = atoi(optarg);
+            break;
+        case 'b':
+            bits = atoi(optarg);
+            break;
+        case 'F':
+            flags = (audio_output_flags_t)strtol(optarg, NULL, 16);
+            break;
+        case 's':
+            size = strtoul(optarg, NULL, 0);
+            break;
+        case 'h':
+        default:
+            usage();
+            return 0;
+        }
+    }
+
+    if (calls == 0 || size == 0) {
+        usage();
+        return -EINVAL;
+    }
+
+    if (hal_mode) {
+        format = (bits == 32) ? AUDIO_FORMAT_PCM_32_BIT :
+                 (bits == 24) ? AUDIO_FORMAT_PCM_24_BIT_PACKED : AUDIO_FORMAT_PCM_16_BIT;
+        return bench_hal(calls, rate, channels, format, flags);
+    }
+
+    fprintf(stdout, "transport: %zu bytes per call\n", size);
+    bench_socket(calls, size);
+    return bench_shm(calls, size);
+}
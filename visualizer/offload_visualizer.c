@@ -25,6 +25,7 @@
 #include <sys/prctl.h>
 #include <dlfcn.h>
 #include <pthread.h>
+#include <stdatomic.h>
 #include <unistd.h>
 
 #include <cutils/list.h>
@@ -33,6 +34,14 @@
 #include <tinyalsa/asoundlib.h>
 #include <audio_effects/effect_visualizer.h>
 
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define VISUALIZER_NEON
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define VISUALIZER_SSE2
+#endif
+
 #define LIB_ACDB_LOADER "libacdbloader.so"
 #define ACDB_DEV_TYPE_OUT 1
 #define AFE_PROXY_ACDB_ID 45
@@ -125,6 +134,13 @@ typedef struct buffer_stats_s {
     float rms_squared; /* the average square of the samples in a buffer */
 } buffer_stats_t;
 
+/* results of the single pass capture analysis of one buffer */
+typedef struct capture_stats_s {
+    uint32_t peak; /* max absolute sample value */
+    uint64_t sum_squares; /* sum of squared samples */
+    int32_t max_mag; /* max of (smp < 0 ? -smp - 1 : smp), drives normalization */
+} capture_stats_t;
+
 typedef struct visualizer_context_s {
     effect_context_t common;
 
@@ -135,8 +151,14 @@ typedef struct visualizer_context_s {
     uint32_t latency;
     struct timespec buffer_update_time;
     uint8_t capture_buf[CAPTURE_BUF_SIZE];
-    /* for measurements */
+    /* layout of the buffers handed to process() */
     uint8_t channel_count; /* to avoid recomputing it every time a buffer is processed */
+    audio_format_t format;
+    /* per frame downmix of the last processed buffer, scaled as a stereo sum */
+    int32_t *mix_buf;
+    uint32_t mix_buf_frames;
+    uint64_t read_seq; /* next capture_ring period to consume */
+    /* for measurements */
     uint32_t meas_mode;
     uint8_t meas_wndw_size_in_buffers;
     uint8_t meas_buffer_idx;
@@ -174,8 +196,7 @@ struct listnode created_effects_list;
  * and visualizer_hal_stop_output() */
 struct listnode active_outputs_list;
 
-/* thread capturing PCM from Proxy port and calling the process function on each enabled effect
- * attached to an active output stream */
+/* thread capturing PCM from Proxy port and publishing it to capture_ring */
 pthread_t capture_thread;
 /* lock must be held when modifying or accessing created_effects_list or active_outputs_list */
 pthread_mutex_t lock;
@@ -186,7 +207,10 @@ pthread_mutex_t thread_lock;
  * capture thread will reevaluate the capture and effect rocess conditions. */
 pthread_cond_t cond;
 /* true when requesting the capture thread to exit */
-bool exit_thread;
+atomic_bool exit_thread;
+/* true when at least one enabled effect is attached to an active output. Written with lock held,
+ * read by the capture thread without it */
+atomic_bool capture_wanted;
 /* 0 if the capture thread was created successfully */
 int thread_status;
 
@@ -204,18 +228,62 @@ int thread_status;
 #define AUDIO_CAPTURE_SMP_RATE 48000
 #define AUDIO_CAPTURE_PERIOD_SIZE (768)
 #define AUDIO_CAPTURE_PERIOD_COUNT 32
+#define AUDIO_CAPTURE_FORMAT PCM_FORMAT_S16_LE
 
 struct pcm_config pcm_config_capture = {
     .channels = AUDIO_CAPTURE_CHANNEL_COUNT,
     .rate = AUDIO_CAPTURE_SMP_RATE,
     .period_size = AUDIO_CAPTURE_PERIOD_SIZE,
     .period_count = AUDIO_CAPTURE_PERIOD_COUNT,
-    .format = PCM_FORMAT_S16_LE,
+    .format = AUDIO_CAPTURE_FORMAT,
     .start_threshold = AUDIO_CAPTURE_PERIOD_SIZE / 4,
     .stop_threshold = INT_MAX,
     .avail_min = AUDIO_CAPTURE_PERIOD_SIZE / 4,
 };
 
+/* bytes in one proxy period, in pcm_config_capture format */
+static uint32_t capture_period_bytes()
+{
+    return pcm_config_capture.period_size * pcm_config_capture.channels *
+            (pcm_format_to_bits(pcm_config_capture.format) / 8);
+}
+
+/* sample format of the proxy periods handed to process() */
+static audio_format_t capture_audio_format()
+{
+    switch (pcm_config_capture.format) {
+    case PCM_FORMAT_S16_LE:
+        return AUDIO_FORMAT_PCM_16_BIT;
+    case PCM_FORMAT_S24_LE:
+        return AUDIO_FORMAT_PCM_8_24_BIT;
+    case PCM_FORMAT_S32_LE:
+        return AUDIO_FORMAT_PCM_32_BIT;
+    default:
+        return AUDIO_FORMAT_INVALID;
+    }
+}
+
+/* The capture thread publishes each proxy period into capture_ring without taking lock.
+ * Visualizer instances pull the periods they have not consumed yet when their client asks
+ * for a capture or a measurement, so a slow client never holds back the proxy capture.
+ * A slot holds period seq when its tag is seq + 1; the tag is 0 while the slot is rewritten. */
+#define CAPTURE_RING_PERIODS 16
+
+typedef struct capture_period_s {
+    atomic_uint_least64_t tag;
+    struct timespec time; /* CLOCK_MONOTONIC time at which the period was read */
+    /* one period in pcm_config_capture format, room for samples up to 32 bit */
+    int32_t data[AUDIO_CAPTURE_PERIOD_SIZE * AUDIO_CAPTURE_CHANNEL_COUNT];
+} capture_period_t;
+
+capture_period_t capture_ring[CAPTURE_RING_PERIODS];
+/* sequence number of the next period to be published */
+atomic_uint_least64_t capture_write_seq;
+
+/* proxy PCM location, parsed from /proc/asound/pcm once */
+int proxy_sound_card = -1;
+int proxy_capture_device = -1;
+
 
 /*
  *  Local functions
@@ -228,7 +296,9 @@ static void init_once() {
     pthread_mutex_init(&lock, NULL);
     pthread_mutex_init(&thread_lock, NULL);
     pthread_cond_init(&cond, NULL);
-    exit_thread = false;
+    atomic_init(&exit_thread, false);
+    atomic_init(&capture_wanted, false);
+    atomic_init(&capture_write_seq, 0);
     thread_status = -1;
 
     init_status = 0;
@@ -319,6 +389,12 @@ bool effects_enabled() {
     return false;
 }
 
+/* Called with lock held whenever an output, an effect attachment or an effect state changes */
+void update_capture_wanted() {
+    atomic_store(&capture_wanted, effects_enabled());
+    pthread_cond_signal(&cond);
+}
+
 int set_control(const char* name, struct mixer *mixer, int value) {
     struct mixer_ctl *ctl;
 
@@ -447,102 +523,110 @@ int parse_pcm_device(char *descriptor, int param)
     return ret;
 }
 
+/* Resolve the proxy card and device once. Failures fall back to the build time defaults
+ * and are retried on the next capture start. Called with lock held */
+void resolve_proxy_pcm()
+{
+    int sound_card, capture_device;
+
+    if (proxy_sound_card >= 0 && proxy_capture_device >= 0)
+        return;
+
+    sound_card = parse_pcm_device("AFE-PROXY TX", SND_CARD_NUM);
+    capture_device = parse_pcm_device("AFE-PROXY TX", DEVICE_ID);
+    if (sound_card >= 0 && capture_device >= 0) {
+        proxy_sound_card = sound_card;
+        proxy_capture_device = capture_device;
+        ALOGD("%s: proxy capture on card %d device %d", __func__, sound_card, capture_device);
+    }
+}
+
 void *capture_thread_loop(void *arg)
 {
-    int16_t data[AUDIO_CAPTURE_PERIOD_SIZE * AUDIO_CAPTURE_CHANNEL_COUNT * sizeof(int16_t)];
-    audio_buffer_t buf;
-    buf.frameCount = AUDIO_CAPTURE_PERIOD_SIZE;
-    buf.s16 = data;
     bool capture_enabled = false;
     struct mixer *mixer;
     struct pcm *pcm = NULL;
     int ret;
-    int retry_num = 0;
-    int sound_card = SOUND_CARD;
-    int capture_device = CAPTURE_DEVICE;
 
     ALOGD("thread enter");
 
     prctl(PR_SET_NAME, (unsigned long)"visualizer capture", 0, 0, 0);
 
     pthread_mutex_lock(&lock);
-
-    sound_card =
-        parse_pcm_device("AFE-PROXY TX", SND_CARD_NUM);
-    sound_card =
-        (sound_card == -1)? SOUND_CARD : sound_card;
-
-    mixer = mixer_open(sound_card);
-    if (mixer == NULL) {
-        pthread_mutex_unlock(&lock);
+    resolve_proxy_pcm();
+    mixer = mixer_open(proxy_sound_card >= 0 ? proxy_sound_card : SOUND_CARD);
+    pthread_mutex_unlock(&lock);
+    if (mixer == NULL)
         return NULL;
-    }
 
     for (;;) {
-        if (exit_thread) {
+        if (atomic_load(&exit_thread)) {
             break;
         }
-        if (effects_enabled()) {
+        /* lock is only taken on state changes and to sleep while idle: exit_thread and
+         * capture_wanted are updated and cond signaled with lock held, so checking them
+         * again under lock before waiting cannot miss a wake up */
+        if (atomic_load(&capture_wanted) != capture_enabled) {
+            pthread_mutex_lock(&lock);
             if (!capture_enabled) {
                 ret = configure_proxy_capture(mixer, 1);
                 if (ret == 0) {
-                    capture_device =
-                       parse_pcm_device("AFE-PROXY TX", DEVICE_ID);
-                    capture_device =
-                       (capture_device == -1)? CAPTURE_DEVICE : capture_device;
-                    pcm = pcm_open(sound_card, capture_device,
+                    resolve_proxy_pcm();
+                    pcm = pcm_open(proxy_sound_card >= 0 ? proxy_sound_card : SOUND_CARD,
+                                   proxy_capture_device >= 0 ?
+                                           proxy_capture_device : CAPTURE_DEVICE,
                                    PCM_IN|PCM_MMAP|PCM_NOIRQ, &pcm_config_capture);
                     if (pcm && !pcm_is_ready(pcm)) {
                         ALOGW("%s: %s", __func__, pcm_get_error(pcm));
                         pcm_close(pcm);
                         pcm = NULL;
                         configure_proxy_capture(mixer, 0);
-                        pthread_cond_wait(&cond, &lock);
+                        if (!atomic_load(&exit_thread))
+                            pthread_cond_wait(&cond, &lock);
                     } else {
                         capture_enabled = true;
                         ALOGD("%s: capture ENABLED", __func__);
                     }
+                } else if (!atomic_load(&exit_thread)) {
+                    /* retry on the next state change rather than spinning */
+                    pthread_cond_wait(&cond, &lock);
                 }
-            }
-        } else {
-            if (capture_enabled) {
+            } else {
                 if (pcm != NULL)
                     pcm_close(pcm);
+                pcm = NULL;
                 configure_proxy_capture(mixer, 0);
                 ALOGD("%s: capture DISABLED", __func__);
                 capture_enabled = false;
             }
-            pthread_cond_wait(&cond, &lock);
+            pthread_mutex_unlock(&lock);
+            continue;
         }
-        if (!capture_enabled)
+        if (!capture_enabled) {
+            pthread_mutex_lock(&lock);
+            if (!atomic_load(&exit_thread) && !atomic_load(&capture_wanted))
+                pthread_cond_wait(&cond, &lock);
+            pthread_mutex_unlock(&lock);
             continue;
+        }
 
-        pthread_mutex_unlock(&lock);
-        ret = pcm_mmap_read(pcm, data, sizeof(data));
-        pthread_mutex_lock(&lock);
+        /* this thread is the only writer: read straight into the next slot */
+        uint64_t seq = atomic_load_explicit(&capture_write_seq, memory_order_relaxed);
+        capture_period_t *period = &capture_ring[seq % CAPTURE_RING_PERIODS];
 
+        atomic_store_explicit(&period->tag, 0, memory_order_relaxed);
+        atomic_thread_fence(memory_order_release);
+        ret = pcm_mmap_read(pcm, period->data, capture_period_bytes());
         if (ret == 0) {
-            struct listnode *out_node;
-
-            list_for_each(out_node, &active_outputs_list) {
-                output_context_t *out_ctxt = node_to_item(out_node,
-                                                          output_context_t,
-                                                          outputs_list_node);
-                struct listnode *fx_node;
-
-                list_for_each(fx_node, &out_ctxt->effects_list) {
-                    effect_context_t *fx_ctxt = node_to_item(fx_node,
-                                                                effect_context_t,
-                                                                output_node);
-                    if (fx_ctxt->ops.process != NULL)
-                        fx_ctxt->ops.process(fx_ctxt, &buf, &buf);
-                }
-            }
+            clock_gettime(CLOCK_MONOTONIC, &period->time);
+            atomic_store_explicit(&period->tag, seq + 1, memory_order_release);
+            atomic_store_explicit(&capture_write_seq, seq + 1, memory_order_release);
         } else {
             ALOGW("%s: read status %d %s", __func__, ret, pcm_get_error(pcm));
         }
     }
 
+    pthread_mutex_lock(&lock);
     if (capture_enabled) {
         if (pcm != NULL)
             pcm_close(pcm);
@@ -598,12 +682,12 @@ int visualizer_hal_start_output(audio_io_handle_t output, int pcm_id) {
         }
     }
     if (list_empty(&active_outputs_list)) {
-        exit_thread = false;
+        atomic_store(&exit_thread, false);
         thread_status = pthread_create(&capture_thread, (const pthread_attr_t *) NULL,
                         capture_thread_loop, NULL);
     }
     list_add_tail(&active_outputs_list, &out_ctxt->outputs_list_node);
-    pthread_cond_signal(&cond);
+    update_capture_wanted();
 
 exit:
     pthread_mutex_unlock(&lock);
@@ -640,11 +724,11 @@ int visualizer_hal_stop_output(audio_io_handle_t output, int pcm_id) {
             fx_ctxt->ops.stop(fx_ctxt, out_ctxt);
     }
     list_remove(&out_ctxt->outputs_list_node);
-    pthread_cond_signal(&cond);
+    update_capture_wanted();
 
     if (list_empty(&active_outputs_list)) {
         if (thread_status == 0) {
-            exit_thread = true;
+            atomic_store(&exit_thread, true);
             pthread_cond_signal(&cond);
             pthread_mutex_unlock(&lock);
             pthread_join(capture_thread, (void **) NULL);
@@ -673,7 +757,8 @@ int set_config(effect_context_t *context, effect_config_t *config)
     if (config->inputCfg.format != config->outputCfg.format) return -EINVAL;
     if (config->outputCfg.accessMode != EFFECT_BUFFER_ACCESS_WRITE &&
             config->outputCfg.accessMode != EFFECT_BUFFER_ACCESS_ACCUMULATE) return -EINVAL;
-    if (config->inputCfg.format != AUDIO_FORMAT_PCM_16_BIT) return -EINVAL;
+    if (config->inputCfg.format != AUDIO_FORMAT_PCM_16_BIT &&
+            config->inputCfg.format != AUDIO_FORMAT_PCM_FLOAT) return -EINVAL;
 
     context->config = *config;
 
@@ -748,8 +833,13 @@ int visualizer_init(effect_context_t *context)
     visu_ctxt->capture_size = VISUALIZER_CAPTURE_SIZE_MAX;
     visu_ctxt->scaling_mode = VISUALIZER_SCALING_MODE_NORMALIZED;
 
+    /* process() is fed from the proxy capture, not from the framework buffers */
+    visu_ctxt->channel_count = pcm_config_capture.channels;
+    visu_ctxt->format = capture_audio_format();
+    visu_ctxt->mix_buf = NULL;
+    visu_ctxt->mix_buf_frames = 0;
+
     // measurement initialization
-    visu_ctxt->channel_count = popcount(context->config.inputCfg.channels);
     visu_ctxt->meas_mode = MEASUREMENT_MODE_NONE;
     visu_ctxt->meas_wndw_size_in_buffers = MEASUREMENT_WINDOW_MAX_SIZE_IN_BUFFERS;
     visu_ctxt->meas_buffer_idx = 0;
@@ -777,6 +867,16 @@ int visualizer_init(effect_context_t *context)
     return 0;
 }
 
+int visualizer_release(effect_context_t *context)
+{
+    visualizer_context_t *visu_ctxt = (visualizer_context_t *)context;
+
+    free(visu_ctxt->mix_buf);
+    visu_ctxt->mix_buf = NULL;
+    visu_ctxt->mix_buf_frames = 0;
+    return 0;
+}
+
 int visualizer_get_parameter(effect_context_t *context, effect_param_t *p, uint32_t *size)
 {
     visualizer_context_t *visu_ctxt = (visualizer_context_t *)context;
@@ -843,12 +943,151 @@ int visualizer_set_parameter(effect_context_t *context, effect_param_t *p, uint3
     return 0;
 }
 
-/* Real process function called from capture thread. Called with lock held */
+/*
+ * Capture kernels: one pass over the input computes the peak, the sum of
+ * squares, the max magnitude used for the normalization shift and the per
+ * frame downmix. The downmix is scaled as a stereo sum (L + R) whatever the
+ * channel count so that the 8 bit conversion is the same for every layout.
+ */
+
+static inline int32_t sample_to_q15(float f)
+{
+    float smp = f * 32768.0f;
+
+    if (smp > 32767.0f)
+        return 32767;
+    if (smp < -32768.0f)
+        return -32768;
+    return (int32_t)smp;
+}
+
+static inline void capture_stats_add(capture_stats_t *stats, int32_t smp)
+{
+    uint32_t mag = smp < 0 ? -smp : smp;
+
+    if (mag > stats->peak)
+        stats->peak = mag;
+    if ((smp ^ (smp >> 31)) > stats->max_mag)
+        stats->max_mag = smp ^ (smp >> 31);
+    stats->sum_squares += (uint64_t)((int64_t)smp * smp);
+}
+
+/* stereo 16 bit, the proxy capture layout */
+static void capture_analyze_stereo_s16(const int16_t *in, uint32_t frames,
+                                       int32_t *mix, capture_stats_t *stats)
+{
+    uint32_t i = 0;
+
+#if defined(VISUALIZER_NEON)
+    uint16x8_t peak = vdupq_n_u16(0);
+    int16x8_t mag = vdupq_n_s16(0);
+    int64x2_t sum = vdupq_n_s64(0);
+
+    for (; i + 4 <= frames; i += 4) {
+        int16x8_t v = vld1q_s16(in + 2 * i);
+        /* vabsq_s16 wraps -32768 to itself, which is 32768 as unsigned */
+        peak = vmaxq_u16(peak, vreinterpretq_u16_s16(vabsq_s16(v)));
+        mag = vmaxq_s16(mag, veorq_s16(v, vshrq_n_s16(v, 15)));
+        sum = vpadalq_s32(sum, vmull_s16(vget_low_s16(v), vget_low_s16(v)));
+        sum = vpadalq_s32(sum, vmull_s16(vget_high_s16(v), vget_high_s16(v)));
+        vst1q_s32(mix + i, vpaddlq_s16(v));
+    }
+    uint16x4_t peak4 = vpmax_u16(vget_low_u16(peak), vget_high_u16(peak));
+    peak4 = vpmax_u16(peak4, peak4);
+    peak4 = vpmax_u16(peak4, peak4);
+    int16x4_t mag4 = vpmax_s16(vget_low_s16(mag), vget_high_s16(mag));
+    mag4 = vpmax_s16(mag4, mag4);
+    mag4 = vpmax_s16(mag4, mag4);
+    stats->peak = vget_lane_u16(peak4, 0);
+    stats->max_mag = vget_lane_s16(mag4, 0);
+    stats->sum_squares = vgetq_lane_s64(sum, 0) + vgetq_lane_s64(sum, 1);
+#elif defined(VISUALIZER_SSE2)
+    const __m128i bias = _mm_set1_epi16((int16_t)0x8000);
+    const __m128i ones = _mm_set1_epi16(1);
+    const __m128i zero = _mm_setzero_si128();
+    __m128i peak = bias; /* biased so that signed max orders unsigned values */
+    __m128i mag = zero;
+    __m128i sum = zero;
+    int16_t peak_lanes[8], mag_lanes[8];
+    uint64_t sum_lanes[2];
+    int k;
+
+    for (; i + 4 <= frames; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(in + 2 * i));
+        __m128i sign = _mm_srai_epi16(v, 15);
+        __m128i ones_complement = _mm_xor_si128(v, sign);
+        __m128i abs = _mm_sub_epi16(ones_complement, sign);
+        /* L*L + R*R fits in 32 bits unsigned, widen before accumulating */
+        __m128i sq = _mm_madd_epi16(v, v);
+
+        peak = _mm_max_epi16(peak, _mm_xor_si128(abs, bias));
+        mag = _mm_max_epi16(mag, ones_complement);
+        sum = _mm_add_epi64(sum, _mm_unpacklo_epi32(sq, zero));
+        sum = _mm_add_epi64(sum, _mm_unpackhi_epi32(sq, zero));
+        _mm_storeu_si128((__m128i *)(mix + i), _mm_madd_epi16(v, ones));
+    }
+    _mm_storeu_si128((__m128i *)peak_lanes, _mm_xor_si128(peak, bias));
+    _mm_storeu_si128((__m128i *)mag_lanes, mag);
+    _mm_storeu_si128((__m128i *)sum_lanes, sum);
+    for (k = 0; k < 8; k++) {
+        if ((uint16_t)peak_lanes[k] > stats->peak)
+            stats->peak = (uint16_t)peak_lanes[k];
+        if (mag_lanes[k] > stats->max_mag)
+            stats->max_mag = mag_lanes[k];
+    }
+    stats->sum_squares = sum_lanes[0] + sum_lanes[1];
+#endif
+    for (; i < frames; i++) {
+        capture_stats_add(stats, in[2 * i]);
+        capture_stats_add(stats, in[2 * i + 1]);
+        mix[i] = in[2 * i] + in[2 * i + 1];
+    }
+}
+
+/* sample idx of the buffer, reduced to 16 bit */
+static inline int32_t capture_sample(const audio_buffer_t *in, audio_format_t format,
+                                     uint32_t idx)
+{
+    switch (format) {
+    case AUDIO_FORMAT_PCM_FLOAT:
+        return sample_to_q15(in->f32[idx]);
+    case AUDIO_FORMAT_PCM_32_BIT:
+        return in->s32[idx] >> 16;
+    case AUDIO_FORMAT_PCM_8_24_BIT:
+        /* the top byte of the container is not guaranteed to be a sign extension */
+        return (int32_t)((uint32_t)in->s32[idx] << 8) >> 16;
+    default:
+        return in->s16[idx];
+    }
+}
+
+/* any channel count, 16, 24 in 32, 32 bit or float */
+static void capture_analyze_generic(const audio_buffer_t *in, audio_format_t format,
+                                    uint32_t channels, uint32_t frames,
+                                    int32_t *mix, capture_stats_t *stats)
+{
+    uint32_t i, ch;
+
+    for (i = 0; i < frames; i++) {
+        int32_t frame_sum = 0;
+        for (ch = 0; ch < channels; ch++) {
+            int32_t smp = capture_sample(in, format, i * channels + ch);
+            capture_stats_add(stats, smp);
+            frame_sum += smp;
+        }
+        mix[i] = (int32_t)(((int64_t)frame_sum * 2) / (int32_t)channels);
+    }
+}
+
+/* Real process function called from visualizer_pull_capture(). Called without lock */
 int visualizer_process(effect_context_t *context,
                        audio_buffer_t *inBuffer,
                        audio_buffer_t *outBuffer)
 {
     visualizer_context_t *visu_ctxt = (visualizer_context_t *)context;
+    capture_stats_t stats = { 0, 0, 0 };
+    uint32_t frames;
+    uint32_t samples;
 
     if (!effect_exists(context))
         return -EINVAL;
@@ -856,49 +1095,44 @@ int visualizer_process(effect_context_t *context,
     if (inBuffer == NULL || inBuffer->raw == NULL ||
         outBuffer == NULL || outBuffer->raw == NULL ||
         inBuffer->frameCount != outBuffer->frameCount ||
-        inBuffer->frameCount == 0) {
+        inBuffer->frameCount == 0 || visu_ctxt->channel_count == 0 ||
+        visu_ctxt->format == AUDIO_FORMAT_INVALID) {
         return -EINVAL;
     }
 
-    // perform measurements if needed
+    frames = inBuffer->frameCount;
+    samples = frames * visu_ctxt->channel_count;
+    if (frames > visu_ctxt->mix_buf_frames) {
+        int32_t *mix_buf = (int32_t *)realloc(visu_ctxt->mix_buf, frames * sizeof(int32_t));
+        if (mix_buf == NULL)
+            return -ENOMEM;
+        visu_ctxt->mix_buf = mix_buf;
+        visu_ctxt->mix_buf_frames = frames;
+    }
+
+    if (visu_ctxt->format == AUDIO_FORMAT_PCM_16_BIT && visu_ctxt->channel_count == 2)
+        capture_analyze_stereo_s16(inBuffer->s16, frames, visu_ctxt->mix_buf, &stats);
+    else
+        capture_analyze_generic(inBuffer, visu_ctxt->format, visu_ctxt->channel_count,
+                                frames, visu_ctxt->mix_buf, &stats);
+
+    // store measurements if needed
     if (visu_ctxt->meas_mode & MEASUREMENT_MODE_PEAK_RMS) {
-        // find the peak and RMS squared for the new buffer
-        uint32_t inIdx;
-        int16_t max_sample = 0;
-        float rms_squared_acc = 0;
-        for (inIdx = 0 ; inIdx < inBuffer->frameCount * visu_ctxt->channel_count ; inIdx++) {
-            if (inBuffer->s16[inIdx] > max_sample) {
-                max_sample = inBuffer->s16[inIdx];
-            } else if (-inBuffer->s16[inIdx] > max_sample) {
-                max_sample = -inBuffer->s16[inIdx];
-            }
-            rms_squared_acc += (inBuffer->s16[inIdx] * inBuffer->s16[inIdx]);
-        }
-        // store the measurement
-        visu_ctxt->past_meas[visu_ctxt->meas_buffer_idx].peak_u16 = (uint16_t)max_sample;
+        visu_ctxt->past_meas[visu_ctxt->meas_buffer_idx].peak_u16 = (uint16_t)stats.peak;
         visu_ctxt->past_meas[visu_ctxt->meas_buffer_idx].rms_squared =
-                rms_squared_acc / (inBuffer->frameCount * visu_ctxt->channel_count);
+                (float)stats.sum_squares / samples;
         visu_ctxt->past_meas[visu_ctxt->meas_buffer_idx].is_valid = true;
         if (++visu_ctxt->meas_buffer_idx >= visu_ctxt->meas_wndw_size_in_buffers) {
             visu_ctxt->meas_buffer_idx = 0;
         }
     }
 
-    /* all code below assumes stereo 16 bit PCM output and input */
     int32_t shift;
 
     if (visu_ctxt->scaling_mode == VISUALIZER_SCALING_MODE_NORMALIZED) {
         /* derive capture scaling factor from peak value in current buffer
          * this gives more interesting captures for display. */
-        shift = 32;
-        int len = inBuffer->frameCount * 2;
-        int i;
-        for (i = 0; i < len; i++) {
-            int32_t smp = inBuffer->s16[i];
-            if (smp < 0) smp = -smp - 1; /* take care to keep the max negative in range */
-            int32_t clz = __builtin_clz(smp);
-            if (shift > clz) shift = clz;
-        }
+        shift = stats.max_mag == 0 ? 32 : __builtin_clz(stats.max_mag);
         /* A maximum amplitude signal will have 17 leading zeros, which we want to
          * translate to a shift of 8 (for converting 16 bit to 8 bit) */
         shift = 25 - shift;
@@ -914,28 +1148,29 @@ int visualizer_process(effect_context_t *context,
         shift = 9;
     }
 
-    uint32_t capt_idx;
-    uint32_t in_idx;
+    /* write the downmix in at most two contiguous runs of the capture ring */
+    uint32_t capt_idx = visu_ctxt->capture_idx;
+    uint32_t in_idx = 0;
     uint8_t *buf = visu_ctxt->capture_buf;
-    for (in_idx = 0, capt_idx = visu_ctxt->capture_idx;
-         in_idx < inBuffer->frameCount;
-         in_idx++, capt_idx++) {
+    const int32_t *mix = visu_ctxt->mix_buf;
+    while (in_idx < frames) {
+        uint32_t run, k;
+
         if (capt_idx >= CAPTURE_BUF_SIZE) {
             /* wrap around */
             capt_idx = 0;
         }
-        int32_t smp = inBuffer->s16[2 * in_idx] + inBuffer->s16[2 * in_idx + 1];
-        smp = smp >> shift;
-        buf[capt_idx] = ((uint8_t)smp)^0x80;
+        run = CAPTURE_BUF_SIZE - capt_idx;
+        if (run > frames - in_idx)
+            run = frames - in_idx;
+        for (k = 0; k < run; k++)
+            buf[capt_idx + k] = ((uint8_t)(mix[in_idx + k] >> shift)) ^ 0x80;
+        in_idx += run;
+        capt_idx += run;
     }
 
-    /* XXX the following two should really be atomic, though it probably doesn't
-     * matter much for visualization purposes */
+    /* buffer_update_time is set by the caller to the capture time of the period */
     visu_ctxt->capture_idx = capt_idx;
-    /* update last buffer update time stamp */
-    if (clock_gettime(CLOCK_MONOTONIC, &visu_ctxt->buffer_update_time) < 0) {
-        visu_ctxt->buffer_update_time.tv_sec = 0;
-    }
 
     if (context->state != EFFECT_STATE_ACTIVE) {
         ALOGV("%s DONE inactive", __func__);
@@ -945,6 +1180,62 @@ int visualizer_process(effect_context_t *context,
     return 0;
 }
 
+/* Process the periods published to capture_ring since the last pull. Periods overwritten
+ * before they could be read are skipped. Called with lock held; lock is released while the
+ * periods are copied and analyzed so that a pull never stalls the other effect and HAL calls.
+ * This is safe because the capture state of a context is only touched by commands on its own
+ * handle, which the effect framework serializes, and capture_ring is read without lock */
+void visualizer_pull_capture(visualizer_context_t *visu_ctxt)
+{
+    effect_context_t *context = &visu_ctxt->common;
+    int32_t data[AUDIO_CAPTURE_PERIOD_SIZE * AUDIO_CAPTURE_CHANNEL_COUNT];
+    uint32_t bytes = capture_period_bytes();
+    audio_buffer_t buf;
+    uint64_t write_seq = atomic_load_explicit(&capture_write_seq, memory_order_acquire);
+    uint64_t seq = visu_ctxt->read_seq;
+
+    if (get_output(context->out_handle) == NULL || seq == write_seq)
+        return;
+
+    if (write_seq - seq >= CAPTURE_RING_PERIODS) {
+        ALOGV("%s skipping %llu periods", __func__,
+              (unsigned long long)(write_seq - seq - (CAPTURE_RING_PERIODS - 1)));
+        seq = write_seq - (CAPTURE_RING_PERIODS - 1);
+    }
+
+    pthread_mutex_unlock(&lock);
+
+    buf.frameCount = pcm_config_capture.period_size;
+    buf.s32 = data;
+    for (; seq < write_seq; seq++) {
+        capture_period_t *period = &capture_ring[seq % CAPTURE_RING_PERIODS];
+        struct timespec time;
+
+        if (atomic_load_explicit(&period->tag, memory_order_acquire) != seq + 1)
+            continue;
+        memcpy(data, period->data, bytes);
+        time = period->time;
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&period->tag, memory_order_relaxed) != seq + 1)
+            continue;
+
+        if (context->ops.process(context, &buf, &buf) == 0)
+            visu_ctxt->buffer_update_time = time;
+    }
+    visu_ctxt->read_seq = write_seq;
+
+    pthread_mutex_lock(&lock);
+}
+
+int visualizer_enable(effect_context_t *context)
+{
+    visualizer_context_t *visu_ctxt = (visualizer_context_t *)context;
+
+    /* only periods captured from now on are relevant */
+    visu_ctxt->read_seq = atomic_load(&capture_write_seq);
+    return 0;
+}
+
 int visualizer_command(effect_context_t * context, uint32_t cmdCode, uint32_t cmdSize,
         void *pCmdData, uint32_t *replySize, void *pReplyData)
 {
@@ -962,6 +1253,8 @@ int visualizer_command(effect_context_t * context, uint32_t cmdCode, uint32_t cm
             break;
 
         if (context->state == EFFECT_STATE_ACTIVE) {
+            visualizer_pull_capture(visu_ctxt);
+
             int32_t latency_ms = visu_ctxt->latency;
             const int32_t delta_ms = visualizer_get_delta_time_ms_from_updated_time(visu_ctxt);
             latency_ms -= delta_ms;
@@ -1020,6 +1313,9 @@ int visualizer_command(effect_context_t * context, uint32_t cmdCode, uint32_t cm
             android_errorWriteLog(0x534e4554, "30229821");
             return -EINVAL;
         }
+        if (context->state == EFFECT_STATE_ACTIVE)
+            visualizer_pull_capture(visu_ctxt);
+
         uint16_t peak_u16 = 0;
         float sum_rms_squared = 0.0f;
         uint8_t nb_valid_meas = 0;
@@ -1113,6 +1409,8 @@ int effect_lib_create(const effect_uuid_t *uuid,
         context = (effect_context_t *)visu_ctxt;
         context->ops.init = visualizer_init;
         context->ops.reset = visualizer_reset;
+        context->ops.release = visualizer_release;
+        context->ops.enable = visualizer_enable;
         context->ops.process = visualizer_process;
         context->ops.set_parameter = visualizer_set_parameter;
         context->ops.get_parameter = visualizer_get_parameter;
@@ -1140,6 +1438,7 @@ int effect_lib_create(const effect_uuid_t *uuid,
     output_context_t *out_ctxt = get_output(ioId);
     if (out_ctxt != NULL)
         add_effect_to_output(out_ctxt, context);
+    update_capture_wanted();
     pthread_mutex_unlock(&lock);
 
     *pHandle = (effect_handle_t)context;
@@ -1165,6 +1464,7 @@ int effect_lib_release(effect_handle_t handle) {
         if (out_ctxt != NULL)
             remove_effect_from_output(out_ctxt, context);
         list_remove(&context->effects_list_node);
+        update_capture_wanted();
         if (context->ops.release)
             context->ops.release(context);
         free(context);
@@ -1298,7 +1598,7 @@ int effect_command(effect_handle_t self, uint32_t cmdCode, uint32_t cmdSize,
         context->state = EFFECT_STATE_ACTIVE;
         if (context->ops.enable)
             context->ops.enable(context);
-        pthread_cond_signal(&cond);
+        update_capture_wanted();
         ALOGV("%s EFFECT_CMD_ENABLE", __func__);
         *(int *)pReplyData = 0;
         break;
@@ -1314,7 +1614,7 @@ int effect_command(effect_handle_t self, uint32_t cmdCode, uint32_t cmdSize,
         context->state = EFFECT_STATE_INITIALIZED;
         if (context->ops.disable)
             context->ops.disable(context);
-        pthread_cond_signal(&cond);
+        update_capture_wanted();
         ALOGV("%s EFFECT_CMD_DISABLE", __func__);
         *(int *)pReplyData = 0;
         break;
@@ -1385,6 +1685,7 @@ int effect_command(effect_handle_t self, uint32_t cmdCode, uint32_t cmdSize,
         out_ctxt = get_output(offload_param->ioHandle);
         if (out_ctxt != NULL)
             add_effect_to_output(out_ctxt, context);
+        update_capture_wanted();
 
         } break;
 
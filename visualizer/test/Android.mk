@@ -0,0 +1,23 @@
+LOCAL_PATH := $(call my-dir)
+
+# visualizer_test
+# ==============================================================================
+include $(CLEAR_VARS)
+LOCAL_SRC_FILES := visualizer_test.c
+LOCAL_MODULE := visualizer_test
+LOCAL_MODULE_TAGS := optional
+LOCAL_HEADER_LIBRARIES := libsystem_headers \
+                          libhardware_headers
+LOCAL_C_INCLUDES := \
+    $(LOCAL_PATH)/../../hal/test \
+    external/tinyalsa/include \
+    $(call include-path-for, audio-effects)
+LOCAL_CFLAGS += -Wall -Werror -O2 \
+    -Wno-unused-variable \
+    -Wno-unused-parameter \
+    -Wno-unused-function \
+    -Wno-sign-compare \
+    -Wno-gnu-designator
+LOCAL_SHARED_LIBRARIES := liblog libcutils
+LOCAL_LDLIBS := -ldl -lm -lpthread
+include $(BUILD_HOST_EXECUTABLE)
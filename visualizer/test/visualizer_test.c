@@ -0,0 +1,511 @@
+/*
+ * Copyright (c) 2023 Qualcomm Innovation Center, Inc. All rights reserved.
+ * SPDX-License-Identifier: BSD-3-Clause-Clear
+ */
+
+/*
+ * Golden output test and benchmark for the offload visualizer capture
+ * analysis.
+ *
+ * offload_visualizer.c is built with fake tinyalsa calls. The capture bytes
+ * and peak produced by visualizer_process() are checked against a digest of
+ * the output of the scalar code the effect used before the single pass
+ * kernels, against that scalar code itself on random periods, and across
+ * every capture layout the proxy config can describe (16 bit, 24 in 32,
+ * 32 bit, float, more channels). The effect must take its layout from
+ * pcm_config_capture. A fake proxy checks that capture goes on while lock is
+ * held and that pulled periods are analyzed without it.
+ *
+ * usage: visualizer_test [periods]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "test_common.h"
+
+#include "../offload_visualizer.c"
+
+/* fake proxy capture: every read takes a millisecond and returns a constant stereo period */
+#define FAKE_PROXY_LEVEL 8000
+
+static int fake_proxy;
+static atomic_int fake_reads;
+
+struct mixer *mixer_open(unsigned int card) { return (struct mixer *)&fake_proxy; }
+void mixer_close(struct mixer *mixer) {}
+struct mixer_ctl *mixer_get_ctl_by_name(struct mixer *mixer, const char *name)
+{
+    return (struct mixer_ctl *)&fake_proxy;
+}
+int mixer_ctl_set_value(struct mixer_ctl *ctl, unsigned int id, int value) { return 0; }
+struct pcm *pcm_open(unsigned int card, unsigned int device, unsigned int flags,
+                     struct pcm_config *config) { return (struct pcm *)&fake_proxy; }
+int pcm_close(struct pcm *pcm) { return 0; }
+int pcm_is_ready(struct pcm *pcm) { return 1; }
+const char *pcm_get_error(struct pcm *pcm) { return "fake"; }
+
+int pcm_mmap_read(struct pcm *pcm, void *data, unsigned int count)
+{
+    int16_t *out = data;
+    unsigned int i;
+
+    usleep(1000);
+    for (i = 0; i < count / sizeof(int16_t); i++)
+        out[i] = FAKE_PROXY_LEVEL;
+    atomic_fetch_add(&fake_reads, 1);
+    return 0;
+}
+
+unsigned int pcm_format_to_bits(enum pcm_format format)
+{
+    switch (format) {
+    case PCM_FORMAT_S32_LE:
+    case PCM_FORMAT_S24_LE:
+        return 32;
+    default:
+        return 16;
+    }
+}
+
+#define FRAMES          AUDIO_CAPTURE_PERIOD_SIZE
+#define MAX_CHANNELS    8
+#define GOLDEN_PERIODS  6
+
+/*
+ * FNV-1a over the capture bytes and peaks that the scalar code produced for
+ * golden_period(0..5), the first three periods normalized and the last three
+ * as played. Recorded from the scalar implementation before it was replaced.
+ */
+#define GOLDEN_DIGEST   0x1b3256cau
+
+static uint32_t rnd_state;
+
+static uint32_t rnd(void)
+{
+    rnd_state = rnd_state * 1664525u + 1013904223u;
+    return rnd_state >> 8;
+}
+
+/* two triangle tones plus noise, integer only so that the digest does not
+ * depend on libm, at a different level per period so that the normalization
+ * shift moves; -32768 is left out, the scalar code truncated its peak */
+static int32_t triangle(uint32_t t, uint32_t period)
+{
+    uint32_t phase = t % period;
+    int32_t v = (int32_t)(phase * 4 * 16384 / period);
+
+    if (v > 2 * 16384)
+        v = 4 * 16384 - v;
+    return v - 16384;
+}
+
+static void golden_period(int n, int16_t *out, uint32_t frames)
+{
+    static const int32_t levels[] = { 1900, 100, 4, 1024, 20, 2047 };
+    int32_t level = levels[n % 6];
+    uint32_t i;
+
+    rnd_state = 0x5eed + n;
+    for (i = 0; i < frames; i++) {
+        uint32_t t = n * frames + i;
+        int32_t l = triangle(t, 218) * 3 / 4 + (int32_t)(rnd() & 0x1fff) - 0x1000;
+        int32_t r = triangle(t, 145) * 3 / 4 + (int32_t)(rnd() & 0x1fff) - 0x1000;
+        out[2 * i] = (int16_t)(l * level / 1024);
+        out[2 * i + 1] = (int16_t)(r * level / 1024);
+    }
+}
+
+/* the scalar analysis visualizer_process() did before the single pass kernels */
+static void ref_process(const int16_t *in, uint32_t frames, uint32_t scaling_mode,
+                        uint8_t *capture_buf, uint32_t *capture_idx,
+                        uint16_t *peak, float *rms_squared)
+{
+    int16_t max_sample = 0;
+    float rms_squared_acc = 0;
+    uint32_t i;
+    int32_t shift;
+
+    for (i = 0; i < frames * 2; i++) {
+        if (in[i] > max_sample)
+            max_sample = in[i];
+        else if (-in[i] > max_sample)
+            max_sample = -in[i];
+        rms_squared_acc += (in[i] * in[i]);
+    }
+    *peak = (uint16_t)max_sample;
+    *rms_squared = rms_squared_acc / (frames * 2);
+
+    if (scaling_mode == VISUALIZER_SCALING_MODE_NORMALIZED) {
+        shift = 32;
+        for (i = 0; i < frames * 2; i++) {
+            int32_t smp = in[i];
+            if (smp < 0) smp = -smp - 1;
+            /* clz of 0 is 32 on ARM, __builtin_clz(0) is undefined */
+            int32_t clz = smp == 0 ? 32 : __builtin_clz(smp);
+            if (shift > clz) shift = clz;
+        }
+        shift = 25 - shift;
+        if (shift < 3)
+            shift = 3;
+        shift++;
+    } else {
+        shift = 9;
+    }
+
+    uint32_t capt_idx;
+    uint32_t in_idx;
+    for (in_idx = 0, capt_idx = *capture_idx; in_idx < frames; in_idx++, capt_idx++) {
+        if (capt_idx >= CAPTURE_BUF_SIZE)
+            capt_idx = 0;
+        int32_t smp = in[2 * in_idx] + in[2 * in_idx + 1];
+        smp = smp >> shift;
+        capture_buf[capt_idx] = ((uint8_t)smp) ^ 0x80;
+    }
+    *capture_idx = capt_idx;
+}
+
+static uint32_t fnv1a(uint32_t h, const void *data, size_t len)
+{
+    const uint8_t *p = data;
+
+    while (len--) {
+        h ^= *p++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static visualizer_context_t *create_visualizer(effect_handle_t *handle)
+{
+    visualizer_context_t *visu_ctxt;
+
+    if (effect_lib_create(&visualizer_descriptor.uuid, 0, 1, handle) != 0)
+        return NULL;
+    visu_ctxt = (visualizer_context_t *)*handle;
+    visu_ctxt->common.state = EFFECT_STATE_ACTIVE;
+    visu_ctxt->meas_mode = MEASUREMENT_MODE_PEAK_RMS;
+    return visu_ctxt;
+}
+
+static int process(visualizer_context_t *visu_ctxt, void *data, uint32_t frames)
+{
+    audio_buffer_t buf = { .frameCount = frames, .raw = data };
+
+    return visualizer_process(&visu_ctxt->common, &buf, &buf);
+}
+
+static buffer_stats_t *last_meas(visualizer_context_t *visu_ctxt)
+{
+    uint8_t idx = visu_ctxt->meas_buffer_idx;
+
+    idx = idx == 0 ? visu_ctxt->meas_wndw_size_in_buffers - 1 : idx - 1;
+    return &visu_ctxt->past_meas[idx];
+}
+
+static void test_layout_from_capture_config(void)
+{
+    effect_handle_t handle;
+    visualizer_context_t *visu_ctxt;
+
+    visu_ctxt = create_visualizer(&handle);
+    EXPECT(visu_ctxt != NULL, "create");
+    EXPECT(visu_ctxt->format == AUDIO_FORMAT_PCM_16_BIT && visu_ctxt->channel_count == 2,
+           "default layout %#x/%u", visu_ctxt->format, visu_ctxt->channel_count);
+    effect_lib_release(handle);
+
+    pcm_config_capture.format = PCM_FORMAT_S24_LE;
+    visu_ctxt = create_visualizer(&handle);
+    EXPECT(visu_ctxt->format == AUDIO_FORMAT_PCM_8_24_BIT, "S24_LE gave %#x", visu_ctxt->format);
+    EXPECT(capture_period_bytes() == FRAMES * 2 * 4, "period bytes %u", capture_period_bytes());
+    effect_lib_release(handle);
+
+    pcm_config_capture.format = PCM_FORMAT_S24_3LE;
+    visu_ctxt = create_visualizer(&handle);
+    EXPECT(visu_ctxt->format == AUDIO_FORMAT_INVALID, "S24_3LE gave %#x", visu_ctxt->format);
+    int16_t data[4] = { 0 };
+    EXPECT(process(visu_ctxt, data, 2) == -EINVAL, "unsupported layout processed");
+    effect_lib_release(handle);
+
+    pcm_config_capture.format = AUDIO_CAPTURE_FORMAT;
+}
+
+static void test_golden(void)
+{
+    static int16_t in[FRAMES * 2];
+    effect_handle_t handle;
+    visualizer_context_t *visu_ctxt = create_visualizer(&handle);
+    uint32_t h = 2166136261u;
+    int n;
+
+    for (n = 0; n < GOLDEN_PERIODS; n++) {
+        uint16_t peak;
+
+        golden_period(n, in, FRAMES);
+        visu_ctxt->scaling_mode = n < 3 ? VISUALIZER_SCALING_MODE_NORMALIZED :
+                                          VISUALIZER_SCALING_MODE_AS_PLAYED;
+        EXPECT(process(visu_ctxt, in, FRAMES) == 0, "process");
+        peak = last_meas(visu_ctxt)->peak_u16;
+        h = fnv1a(h, visu_ctxt->capture_buf + n * FRAMES, FRAMES);
+        h = fnv1a(h, &peak, sizeof(peak));
+    }
+    printf("golden digest %#010x\n", h);
+    EXPECT(h == GOLDEN_DIGEST, "digest %#x, expected %#x", h, GOLDEN_DIGEST);
+    effect_lib_release(handle);
+}
+
+/* random periods of random lengths, including ring wrap and vector tails */
+static void test_against_reference(int periods)
+{
+    static int16_t in[FRAMES * 2];
+    static uint8_t ref_buf[CAPTURE_BUF_SIZE];
+    effect_handle_t handle;
+    visualizer_context_t *visu_ctxt = create_visualizer(&handle);
+    uint32_t ref_idx = 0;
+    int n, mismatches = 0;
+    uint32_t i;
+
+    memset(ref_buf, 0x80, sizeof(ref_buf));
+    rnd_state = 1;
+    for (n = 0; n < periods; n++) {
+        uint32_t frames = 1 + rnd() % FRAMES;
+        int bits = 1 + rnd() % 15;
+        uint16_t ref_peak;
+        float ref_rms;
+
+        for (i = 0; i < frames * 2; i++) {
+            int32_t smp = (int32_t)(rnd() & 0xffff) - 32768;
+            smp >>= 15 - bits;
+            in[i] = smp < -32767 ? -32767 : smp;
+        }
+        visu_ctxt->scaling_mode = (n & 1) ? VISUALIZER_SCALING_MODE_AS_PLAYED :
+                                            VISUALIZER_SCALING_MODE_NORMALIZED;
+        ref_process(in, frames, visu_ctxt->scaling_mode, ref_buf, &ref_idx, &ref_peak, &ref_rms);
+        process(visu_ctxt, in, frames);
+
+        buffer_stats_t *meas = last_meas(visu_ctxt);
+        if (meas->peak_u16 != ref_peak ||
+                fabsf(meas->rms_squared - ref_rms) > 1e-4f * ref_rms + 1e-3f)
+            mismatches++;
+    }
+    EXPECT(visu_ctxt->capture_idx == ref_idx, "capture index %u vs %u",
+           visu_ctxt->capture_idx, ref_idx);
+    EXPECT(memcmp(visu_ctxt->capture_buf, ref_buf, CAPTURE_BUF_SIZE) == 0,
+           "capture bytes differ from the scalar code");
+    EXPECT(mismatches == 0, "%d periods with different peak or RMS", mismatches);
+
+    /* the scalar code truncated a -32768 peak, it is now reported in full */
+    in[0] = -32768;
+    in[1] = 0;
+    process(visu_ctxt, in, 1);
+    EXPECT(last_meas(visu_ctxt)->peak_u16 == 32768, "peak %u", last_meas(visu_ctxt)->peak_u16);
+    effect_lib_release(handle);
+}
+
+/* every layout carrying the same stereo content gives the stereo 16 bit result */
+static void test_layouts(void)
+{
+    static const struct {
+        audio_format_t format;
+        uint32_t channels;
+        const char *name;
+    } layouts[] = {
+        { AUDIO_FORMAT_PCM_8_24_BIT, 2, "8_24 stereo" },
+        { AUDIO_FORMAT_PCM_32_BIT, 2, "32 bit stereo" },
+        { AUDIO_FORMAT_PCM_FLOAT, 2, "float stereo" },
+        { AUDIO_FORMAT_PCM_16_BIT, 4, "16 bit 4 channels" },
+        { AUDIO_FORMAT_PCM_32_BIT, 8, "32 bit 8 channels" },
+    };
+    static int16_t in[FRAMES * 2];
+    static int32_t wide[FRAMES * MAX_CHANNELS];
+    static uint8_t expected[FRAMES];
+    effect_handle_t handle;
+    visualizer_context_t *visu_ctxt = create_visualizer(&handle);
+    buffer_stats_t ref;
+    size_t l;
+    uint32_t i, ch;
+
+    golden_period(0, in, FRAMES);
+    process(visu_ctxt, in, FRAMES);
+    memcpy(expected, visu_ctxt->capture_buf, FRAMES);
+    ref = *last_meas(visu_ctxt);
+
+    for (l = 0; l < sizeof(layouts) / sizeof(layouts[0]); l++) {
+        uint32_t channels = layouts[l].channels;
+
+        for (i = 0; i < FRAMES; i++) {
+            for (ch = 0; ch < channels; ch++) {
+                int16_t smp = in[2 * i + (ch & 1)];
+                int32_t *out = &wide[i * channels + ch];
+
+                switch (layouts[l].format) {
+                case AUDIO_FORMAT_PCM_8_24_BIT:
+                    /* garbage in the unused top byte */
+                    *out = (int32_t)(((uint32_t)smp << 8) & 0xffffff) | (int32_t)0xa5000000;
+                    break;
+                case AUDIO_FORMAT_PCM_32_BIT:
+                    *out = (int32_t)((uint32_t)smp << 16) | 0x1234;
+                    break;
+                case AUDIO_FORMAT_PCM_FLOAT:
+                    ((float *)wide)[i * channels + ch] = smp / 32768.0f;
+                    break;
+                default:
+                    ((int16_t *)wide)[i * channels + ch] = smp;
+                    break;
+                }
+            }
+        }
+        visu_ctxt->format = layouts[l].format;
+        visu_ctxt->channel_count = channels;
+        visu_ctxt->capture_idx = 0;
+        EXPECT(process(visu_ctxt, wide, FRAMES) == 0, "%s: process", layouts[l].name);
+        EXPECT(memcmp(visu_ctxt->capture_buf, expected, FRAMES) == 0,
+               "%s: capture bytes differ", layouts[l].name);
+        EXPECT(last_meas(visu_ctxt)->peak_u16 == ref.peak_u16 &&
+               fabsf(last_meas(visu_ctxt)->rms_squared - ref.rms_squared) <=
+                       1e-5f * ref.rms_squared,
+               "%s: peak %u rms %f, expected %u %f", layouts[l].name,
+               last_meas(visu_ctxt)->peak_u16, last_meas(visu_ctxt)->rms_squared,
+               ref.peak_u16, ref.rms_squared);
+    }
+    effect_lib_release(handle);
+}
+
+static atomic_int process_calls;
+static atomic_int process_calls_locked;
+
+static int process_check_lock(effect_context_t *context, audio_buffer_t *in,
+                              audio_buffer_t *out)
+{
+    if (pthread_mutex_trylock(&lock) == 0)
+        pthread_mutex_unlock(&lock);
+    else
+        atomic_fetch_add(&process_calls_locked, 1);
+    atomic_fetch_add(&process_calls, 1);
+    return visualizer_process(context, in, out);
+}
+
+static int command_int(effect_handle_t handle, uint32_t cmd, uint32_t size, void *data)
+{
+    int reply = -1;
+    uint32_t reply_size = sizeof(reply);
+
+    if (effect_command(handle, cmd, size, data, &reply_size, &reply) != 0)
+        return -1;
+    return reply;
+}
+
+static bool wait_reads(int count)
+{
+    int i;
+
+    for (i = 0; i < 2000 && atomic_load(&fake_reads) < count; i++)
+        usleep(1000);
+    return atomic_load(&fake_reads) >= count;
+}
+
+/* the capture thread keeps publishing while lock is held elsewhere, and captures are
+ * analyzed without lock */
+static void test_capture_without_lock(void)
+{
+    effect_offload_param_t offload = { .isOffload = true, .ioHandle = 1 };
+    static uint8_t reply[VISUALIZER_CAPTURE_SIZE_MAX];
+    uint32_t reply_size;
+    effect_handle_t handle;
+    visualizer_context_t *visu_ctxt;
+    uint64_t seq;
+    uint32_t i;
+    int silent = 0;
+
+    EXPECT(effect_lib_create(&visualizer_descriptor.uuid, 0, 1, &handle) == 0, "create");
+    visu_ctxt = (visualizer_context_t *)handle;
+    visu_ctxt->common.ops.process = process_check_lock;
+    EXPECT(command_int(handle, EFFECT_CMD_ENABLE, 0, NULL) == 0, "enable");
+    EXPECT(command_int(handle, EFFECT_CMD_OFFLOAD, sizeof(offload), &offload) == 0, "offload");
+    EXPECT(visualizer_hal_start_output(1, 0) == 0, "start output");
+
+    EXPECT(wait_reads(4), "capture thread did not start reading");
+
+    pthread_mutex_lock(&lock);
+    seq = atomic_load(&capture_write_seq);
+    wait_reads(atomic_load(&fake_reads) + 8);
+    EXPECT(atomic_load(&capture_write_seq) >= seq + 4,
+           "capture stalled while lock was held: %llu -> %llu", (unsigned long long)seq,
+           (unsigned long long)atomic_load(&capture_write_seq));
+    pthread_mutex_unlock(&lock);
+
+    reply_size = visu_ctxt->capture_size;
+    EXPECT(effect_command(handle, VISUALIZER_CMD_CAPTURE, 0, NULL, &reply_size, reply) == 0,
+           "capture");
+    for (i = 0; i < visu_ctxt->capture_size; i++)
+        silent += reply[i] == 0x80;
+    EXPECT(silent == 0, "%d silent bytes in a capture of the fake proxy", silent);
+    EXPECT(atomic_load(&process_calls) > 0, "capture pulled no period");
+    EXPECT(atomic_load(&process_calls_locked) == 0, "%d periods analyzed with lock held",
+           atomic_load(&process_calls_locked));
+
+    EXPECT(visualizer_hal_stop_output(1, 0) == 0, "stop output");
+    effect_lib_release(handle);
+}
+
+static void bench(int periods)
+{
+    static int16_t in[FRAMES * 2];
+    static uint8_t ref_buf[CAPTURE_BUF_SIZE];
+    effect_handle_t handle;
+    visualizer_context_t *visu_ctxt = create_visualizer(&handle);
+    uint32_t ref_idx = 0;
+    uint16_t peak;
+    float rms;
+    uint64_t t0;
+    double scalar, kernel, generic;
+    int n;
+
+    golden_period(0, in, FRAMES);
+
+    t0 = test_now_ns();
+    for (n = 0; n < periods; n++)
+        ref_process(in, FRAMES, VISUALIZER_SCALING_MODE_NORMALIZED, ref_buf, &ref_idx,
+                    &peak, &rms);
+    scalar = (double)(test_now_ns() - t0) / periods;
+
+    t0 = test_now_ns();
+    for (n = 0; n < periods; n++)
+        process(visu_ctxt, in, FRAMES);
+    kernel = (double)(test_now_ns() - t0) / periods;
+
+    /* same data through the any layout kernel */
+    visu_ctxt->channel_count = 2;
+    visu_ctxt->format = AUDIO_FORMAT_PCM_16_BIT;
+    t0 = test_now_ns();
+    for (n = 0; n < periods; n++) {
+        audio_buffer_t buf = { .frameCount = FRAMES, .raw = in };
+        capture_stats_t stats = { 0, 0, 0 };
+        capture_analyze_generic(&buf, AUDIO_FORMAT_PCM_16_BIT, 2, FRAMES,
+                                visu_ctxt->mix_buf, &stats);
+    }
+    generic = (double)(test_now_ns() - t0) / periods;
+
+    printf("%d periods of %d stereo frames, ns per period:\n", periods, FRAMES);
+    printf("  scalar reference (3 passes): %8.0f\n", scalar);
+    printf("  visualizer_process:          %8.0f (%.1fx)\n", kernel, scalar / kernel);
+    printf("  generic kernel only:         %8.0f\n", generic);
+    effect_lib_release(handle);
+}
+
+int main(int argc, char **argv)
+{
+    int periods = argc > 1 ? atoi(argv[1]) : 20000;
+
+    if (periods < 100)
+        periods = 100;
+
+    test_layout_from_capture_config();
+    test_golden();
+    test_against_reference(periods / 10);
+    test_layouts();
+    test_capture_without_lock();
+    bench(periods);
+
+    return test_finish();
+}
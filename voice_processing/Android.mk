@@ -19,7 +19,8 @@ LOCAL_VENDOR_MODULE := true
 LOCAL_MODULE_OWNER := qti
 
 LOCAL_SRC_FILES:= \
-    voice_processing.c
+    voice_processing.c \
+    host_ecns.c
 
 LOCAL_C_INCLUDES += \
     $(call include-path-for, audio-effects)
@@ -54,4 +55,6 @@ ifneq ($(filter kona lahaina holi,$(TARGET_BOARD_PLATFORM)),)
 LOCAL_SANITIZE := integer_overflow
 endif
 include $(BUILD_SHARED_LIBRARY)
+
+include $(LOCAL_PATH)/test/Android.mk
 endif
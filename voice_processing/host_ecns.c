@@ -0,0 +1,446 @@
+/*
+ * Copyright (c) 2023 Qualcomm Innovation Center, Inc. All rights reserved.
+ * SPDX-License-Identifier: BSD-3-Clause-Clear
+ */
+
+#define LOG_TAG "voice_processing_host_ecns"
+/*#define LOG_NDEBUG 0*/
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <log/log.h>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define HOST_ECNS_NEON
+#elif defined(__SSE__)
+#include <xmmintrin.h>
+#define HOST_ECNS_SSE
+#endif
+
+#include "host_ecns.h"
+
+//------------------------------------------------------------------------------
+// local definitions
+//------------------------------------------------------------------------------
+
+#define FRAME_DURATION_MS        10
+#define AEC_TAIL_MS              64        // echo path length covered by the filter
+#define AEC_STEP_SIZE            0.5f      // NLMS normalized step size
+#define AEC_REG                  1e-6f     // NLMS regularization
+#define AEC_DTD_THRESHOLD        3.0f      // near end power over the echo power bound
+#define AEC_DTD_GAIN_SMOOTHING   0.95f     // echo path power gain tracking
+#define AEC_DTD_MIN_ERLE_DB      6.0f      // detector only trusted once converged
+#define AEC_DTD_HANGOVER         5         // frames adaptation stays frozen
+#define AEC_REF_ACTIVE_POW       1e-7f     // far end power below which ERLE is not tracked
+#define AEC_ERLE_SMOOTHING       0.95f
+
+#define NS_INIT_FRAMES           10        // frames used to seed the noise estimate
+#define NS_NOISE_DOWN            0.80f     // noise tracking when power falls
+#define NS_NOISE_UP              0.995f    // noise tracking when power rises
+#define NS_OVER_SUBTRACTION      2.0f
+#define NS_GAIN_FLOOR            0.1f
+#define NS_GAIN_SMOOTHING        0.6f
+
+//------------------------------------------------------------------------------
+// Vector kernels. Any length is accepted: frames are rate / 100 samples
+// (441 at 44.1 kHz), so the vector loops are followed by a scalar tail.
+//------------------------------------------------------------------------------
+
+static float vec_dot(const float *a, const float *b, size_t n)
+{
+    size_t i = 0;
+#if defined(HOST_ECNS_NEON)
+    float32x4_t acc0 = vdupq_n_f32(0.0f);
+    float32x4_t acc1 = vdupq_n_f32(0.0f);
+    for (; i + 8 <= n; i += 8) {
+        acc0 = vmlaq_f32(acc0, vld1q_f32(a + i), vld1q_f32(b + i));
+        acc1 = vmlaq_f32(acc1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+    }
+    for (; i + 4 <= n; i += 4)
+        acc0 = vmlaq_f32(acc0, vld1q_f32(a + i), vld1q_f32(b + i));
+    acc0 = vaddq_f32(acc0, acc1);
+    float32x2_t sum2 = vadd_f32(vget_low_f32(acc0), vget_high_f32(acc0));
+    float sum = vget_lane_f32(vpadd_f32(sum2, sum2), 0);
+#elif defined(HOST_ECNS_SSE)
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+    float lanes[4];
+    for (; i + 8 <= n; i += 8) {
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+    }
+    for (; i + 4 <= n; i += 4)
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+    _mm_storeu_ps(lanes, _mm_add_ps(acc0, acc1));
+    float sum = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#else
+    float sum = 0.0f;
+#endif
+    for (; i < n; i++)
+        sum += a[i] * b[i];
+    return sum;
+}
+
+// y += g * x
+static void vec_axpy(float *y, const float *x, float g, size_t n)
+{
+    size_t i = 0;
+#if defined(HOST_ECNS_NEON)
+    float32x4_t vg = vdupq_n_f32(g);
+    for (; i + 4 <= n; i += 4)
+        vst1q_f32(y + i, vmlaq_f32(vld1q_f32(y + i), vld1q_f32(x + i), vg));
+#elif defined(HOST_ECNS_SSE)
+    __m128 vg = _mm_set1_ps(g);
+    for (; i + 4 <= n; i += 4)
+        _mm_storeu_ps(y + i, _mm_add_ps(_mm_loadu_ps(y + i),
+                                        _mm_mul_ps(_mm_loadu_ps(x + i), vg)));
+#endif
+    for (; i < n; i++)
+        y[i] += g * x[i];
+}
+
+static float vec_max_abs(const float *x, size_t n)
+{
+    size_t i = 0;
+#if defined(HOST_ECNS_NEON)
+    float32x4_t vmax = vdupq_n_f32(0.0f);
+    for (; i + 4 <= n; i += 4)
+        vmax = vmaxq_f32(vmax, vabsq_f32(vld1q_f32(x + i)));
+    float32x2_t m2 = vpmax_f32(vget_low_f32(vmax), vget_high_f32(vmax));
+    float max = vget_lane_f32(vpmax_f32(m2, m2), 0);
+#elif defined(HOST_ECNS_SSE)
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    __m128 vmax = _mm_setzero_ps();
+    float lanes[4];
+    for (; i + 4 <= n; i += 4)
+        vmax = _mm_max_ps(vmax, _mm_andnot_ps(sign, _mm_loadu_ps(x + i)));
+    _mm_storeu_ps(lanes, vmax);
+    float max = fmaxf(fmaxf(lanes[0], lanes[1]), fmaxf(lanes[2], lanes[3]));
+#else
+    float max = 0.0f;
+#endif
+    for (; i < n; i++)
+        max = fmaxf(max, fabsf(x[i]));
+    return max;
+}
+
+size_t host_ecns_frame_size(uint32_t sample_rate)
+{
+    return sample_rate * FRAME_DURATION_MS / 1000;
+}
+
+//------------------------------------------------------------------------------
+// Acoustic echo canceller: time domain NLMS with far end referenced double talk
+// detection
+//------------------------------------------------------------------------------
+
+struct host_aec {
+    size_t frame;          // samples per frame
+    size_t taps;           // adaptive filter length, multiple of 8
+    float *w;              // filter coefficients stored time reversed
+    float *x;              // far end history: taps - 1 past samples + current frame
+    int dtd_hangover;
+    float echo_gain;       // echo estimate power over far end tail power
+    float mic_pow;
+    float err_pow;
+    struct host_aec_stats stats;
+};
+
+struct host_aec *host_aec_create(uint32_t sample_rate)
+{
+    struct host_aec *aec;
+
+    if (sample_rate == 0 || sample_rate % 100 != 0)
+        return NULL;
+
+    aec = (struct host_aec *)calloc(1, sizeof(struct host_aec));
+    if (aec == NULL)
+        return NULL;
+
+    aec->frame = host_ecns_frame_size(sample_rate);
+    aec->taps = ((sample_rate * AEC_TAIL_MS / 1000) + 7) & ~7;
+    aec->w = (float *)calloc(aec->taps, sizeof(float));
+    aec->x = (float *)calloc(aec->taps - 1 + aec->frame, sizeof(float));
+    if (aec->w == NULL || aec->x == NULL) {
+        host_aec_destroy(aec);
+        return NULL;
+    }
+    host_aec_reset(aec);
+    ALOGV("%s: rate %u frame %zu taps %zu", __func__, sample_rate, aec->frame, aec->taps);
+    return aec;
+}
+
+void host_aec_destroy(struct host_aec *aec)
+{
+    if (aec == NULL)
+        return;
+    free(aec->w);
+    free(aec->x);
+    free(aec);
+}
+
+void host_aec_reset(struct host_aec *aec)
+{
+    memset(aec->w, 0, aec->taps * sizeof(float));
+    memset(aec->x, 0, (aec->taps - 1 + aec->frame) * sizeof(float));
+    aec->dtd_hangover = 0;
+    aec->echo_gain = 0.0f;
+    aec->mic_pow = 0.0f;
+    aec->err_pow = 0.0f;
+    memset(&aec->stats, 0, sizeof(aec->stats));
+}
+
+void host_aec_process(struct host_aec *aec, float *mic, const float *ref)
+{
+    const size_t taps = aec->taps;
+    const size_t hist = taps - 1;
+    float *x = aec->x;
+    float ref_max, energy, tail_pow, echo_pow = 0.0f, mic_pow = 0.0f, err_pow = 0.0f;
+    size_t i;
+
+    memcpy(x + hist, ref, aec->frame * sizeof(float));
+    ref_max = vec_max_abs(x, hist + aec->frame);
+    energy = vec_dot(x, x, taps);
+    tail_pow = energy / taps;
+
+    // Geigel style detector on powers: the echo can not exceed the far end
+    // over the tail scaled by the echo path gain, so a near end well above
+    // that bound means double talk and adaptation is frozen for a few
+    // frames. Powers rather than peaks keep the bound tight on 10 ms frames.
+    // The gain is measured on the filter's own echo estimate, which does
+    // not follow the near end, and is trusted once the filter converged.
+    if (aec->stats.erle_db > AEC_DTD_MIN_ERLE_DB &&
+            vec_dot(mic, mic, aec->frame) / aec->frame >
+                    AEC_DTD_THRESHOLD * aec->echo_gain * tail_pow)
+        aec->dtd_hangover = AEC_DTD_HANGOVER;
+    else if (aec->dtd_hangover > 0)
+        aec->dtd_hangover--;
+
+    for (i = 0; i < aec->frame; i++) {
+        const float *xi = x + i;
+        float d = mic[i];
+        float y, e;
+
+        if (i > 0)
+            energy += xi[taps - 1] * xi[taps - 1] - xi[-1] * xi[-1];
+        y = vec_dot(aec->w, xi, taps);
+        e = d - y;
+        if (aec->dtd_hangover == 0)
+            vec_axpy(aec->w, xi, AEC_STEP_SIZE * e / (fmaxf(energy, 0.0f) + AEC_REG), taps);
+
+        echo_pow += y * y;
+        mic_pow += d * d;
+        err_pow += e * e;
+        mic[i] = e;
+    }
+    memmove(x, x + aec->frame, hist * sizeof(float));
+
+    if (ref_max * ref_max > AEC_REF_ACTIVE_POW && tail_pow > 0.0f)
+        aec->echo_gain = AEC_DTD_GAIN_SMOOTHING * aec->echo_gain +
+                (1.0f - AEC_DTD_GAIN_SMOOTHING) * echo_pow / aec->frame / tail_pow;
+    // the near end swamps both powers during double talk, which would also
+    // pull ERLE under the detector's convergence gate
+    if (ref_max * ref_max > AEC_REF_ACTIVE_POW && aec->dtd_hangover == 0) {
+        aec->mic_pow = AEC_ERLE_SMOOTHING * aec->mic_pow + (1.0f - AEC_ERLE_SMOOTHING) * mic_pow;
+        aec->err_pow = AEC_ERLE_SMOOTHING * aec->err_pow + (1.0f - AEC_ERLE_SMOOTHING) * err_pow;
+        aec->stats.erle_db = 10.0f * log10f((aec->mic_pow + AEC_REG) / (aec->err_pow + AEC_REG));
+    }
+    aec->stats.frames++;
+    if (aec->dtd_hangover > 0)
+        aec->stats.dtd_frames++;
+}
+
+void host_aec_get_stats(struct host_aec *aec, struct host_aec_stats *stats)
+{
+    *stats = aec->stats;
+}
+
+//------------------------------------------------------------------------------
+// Noise suppressor: spectral subtraction on 50% overlapped sqrt-Hann frames
+//------------------------------------------------------------------------------
+
+struct host_ns {
+    size_t hop;            // samples per frame
+    size_t win;            // analysis window length (2 * hop)
+    size_t fft_size;       // power of two >= win
+    size_t bins;           // fft_size / 2 + 1
+    float *window;
+    float *in_hist;
+    float *ola;
+    float *re;
+    float *im;
+    float *cos_tab;
+    float *sin_tab;
+    uint32_t *bitrev;
+    float *noise;
+    float *gain;
+    uint32_t frames;
+};
+
+static void ns_fft(struct host_ns *ns, float *re, float *im)
+{
+    const size_t n = ns->fft_size;
+    size_t i, len;
+
+    for (i = 0; i < n; i++) {
+        size_t j = ns->bitrev[i];
+        if (j > i) {
+            float t = re[i]; re[i] = re[j]; re[j] = t;
+            t = im[i]; im[i] = im[j]; im[j] = t;
+        }
+    }
+    for (len = 2; len <= n; len <<= 1) {
+        size_t half = len >> 1;
+        size_t step = n / len;
+        size_t start, k;
+        for (start = 0; start < n; start += len) {
+            for (k = 0; k < half; k++) {
+                float wr = ns->cos_tab[k * step];
+                float wi = -ns->sin_tab[k * step];
+                size_t a = start + k, b = a + half;
+                float tr = re[b] * wr - im[b] * wi;
+                float ti = re[b] * wi + im[b] * wr;
+                re[b] = re[a] - tr;
+                im[b] = im[a] - ti;
+                re[a] += tr;
+                im[a] += ti;
+            }
+        }
+    }
+}
+
+struct host_ns *host_ns_create(uint32_t sample_rate)
+{
+    struct host_ns *ns;
+    size_t i, log2n = 0;
+
+    if (sample_rate == 0 || sample_rate % 100 != 0)
+        return NULL;
+
+    ns = (struct host_ns *)calloc(1, sizeof(struct host_ns));
+    if (ns == NULL)
+        return NULL;
+
+    ns->hop = host_ecns_frame_size(sample_rate);
+    ns->win = 2 * ns->hop;
+    for (ns->fft_size = 1; ns->fft_size < ns->win; ns->fft_size <<= 1)
+        log2n++;
+    ns->bins = ns->fft_size / 2 + 1;
+
+    ns->window = (float *)calloc(ns->win, sizeof(float));
+    ns->in_hist = (float *)calloc(ns->win, sizeof(float));
+    ns->ola = (float *)calloc(ns->win, sizeof(float));
+    ns->re = (float *)calloc(ns->fft_size, sizeof(float));
+    ns->im = (float *)calloc(ns->fft_size, sizeof(float));
+    ns->cos_tab = (float *)calloc(ns->fft_size / 2, sizeof(float));
+    ns->sin_tab = (float *)calloc(ns->fft_size / 2, sizeof(float));
+    ns->bitrev = (uint32_t *)calloc(ns->fft_size, sizeof(uint32_t));
+    ns->noise = (float *)calloc(ns->bins, sizeof(float));
+    ns->gain = (float *)calloc(ns->bins, sizeof(float));
+    if (ns->window == NULL || ns->in_hist == NULL || ns->ola == NULL ||
+            ns->re == NULL || ns->im == NULL || ns->cos_tab == NULL ||
+            ns->sin_tab == NULL || ns->bitrev == NULL || ns->noise == NULL ||
+            ns->gain == NULL) {
+        host_ns_destroy(ns);
+        return NULL;
+    }
+
+    // periodic sqrt-Hann: analysis * synthesis windows overlap-add to unity
+    for (i = 0; i < ns->win; i++)
+        ns->window[i] = sqrtf(0.5f - 0.5f * cosf(2.0f * (float)M_PI * i / ns->win));
+    for (i = 0; i < ns->fft_size / 2; i++) {
+        ns->cos_tab[i] = cosf(2.0f * (float)M_PI * i / ns->fft_size);
+        ns->sin_tab[i] = sinf(2.0f * (float)M_PI * i / ns->fft_size);
+    }
+    for (i = 0; i < ns->fft_size; i++) {
+        uint32_t r = 0;
+        size_t b;
+        for (b = 0; b < log2n; b++)
+            r |= ((i >> b) & 1) << (log2n - 1 - b);
+        ns->bitrev[i] = r;
+    }
+    host_ns_reset(ns);
+    ALOGV("%s: rate %u hop %zu fft %zu", __func__, sample_rate, ns->hop, ns->fft_size);
+    return ns;
+}
+
+void host_ns_destroy(struct host_ns *ns)
+{
+    if (ns == NULL)
+        return;
+    free(ns->window);
+    free(ns->in_hist);
+    free(ns->ola);
+    free(ns->re);
+    free(ns->im);
+    free(ns->cos_tab);
+    free(ns->sin_tab);
+    free(ns->bitrev);
+    free(ns->noise);
+    free(ns->gain);
+    free(ns);
+}
+
+void host_ns_reset(struct host_ns *ns)
+{
+    size_t k;
+
+    memset(ns->in_hist, 0, ns->win * sizeof(float));
+    memset(ns->ola, 0, ns->win * sizeof(float));
+    memset(ns->noise, 0, ns->bins * sizeof(float));
+    for (k = 0; k < ns->bins; k++)
+        ns->gain[k] = 1.0f;
+    ns->frames = 0;
+}
+
+void host_ns_process(struct host_ns *ns, float *frame)
+{
+    const size_t n = ns->fft_size;
+    float *re = ns->re, *im = ns->im;
+    size_t i, k;
+
+    memmove(ns->in_hist, ns->in_hist + ns->hop, ns->hop * sizeof(float));
+    memcpy(ns->in_hist + ns->hop, frame, ns->hop * sizeof(float));
+
+    for (i = 0; i < ns->win; i++)
+        re[i] = ns->in_hist[i] * ns->window[i];
+    memset(re + ns->win, 0, (n - ns->win) * sizeof(float));
+    memset(im, 0, n * sizeof(float));
+    ns_fft(ns, re, im);
+
+    for (k = 0; k < ns->bins; k++) {
+        float pow = re[k] * re[k] + im[k] * im[k];
+        float g;
+
+        if (ns->frames < NS_INIT_FRAMES)
+            ns->noise[k] += (pow - ns->noise[k]) / (ns->frames + 1);
+        else if (pow < ns->noise[k])
+            ns->noise[k] = NS_NOISE_DOWN * ns->noise[k] + (1.0f - NS_NOISE_DOWN) * pow;
+        else
+            ns->noise[k] = NS_NOISE_UP * ns->noise[k] + (1.0f - NS_NOISE_UP) * pow;
+
+        g = 1.0f - NS_OVER_SUBTRACTION * ns->noise[k] / (pow + 1e-12f);
+        g = fmaxf(g, NS_GAIN_FLOOR);
+        ns->gain[k] = NS_GAIN_SMOOTHING * ns->gain[k] + (1.0f - NS_GAIN_SMOOTHING) * g;
+
+        re[k] *= ns->gain[k];
+        im[k] *= ns->gain[k];
+        if (k > 0 && k < n / 2) {
+            re[n - k] *= ns->gain[k];
+            im[n - k] *= ns->gain[k];
+        }
+    }
+    ns->frames++;
+
+    // inverse transform through the forward FFT of the conjugate
+    for (i = 0; i < n; i++)
+        im[i] = -im[i];
+    ns_fft(ns, re, im);
+
+    for (i = 0; i < ns->win; i++)
+        ns->ola[i] += re[i] * ns->window[i] / n;
+    memcpy(frame, ns->ola, ns->hop * sizeof(float));
+    memmove(ns->ola, ns->ola + ns->hop, ns->hop * sizeof(float));
+    memset(ns->ola + ns->hop, 0, ns->hop * sizeof(float));
+}
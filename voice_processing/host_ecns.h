@@ -0,0 +1,43 @@
+/*
+ * Copyright (c) 2023 Qualcomm Innovation Center, Inc. All rights reserved.
+ * SPDX-License-Identifier: BSD-3-Clause-Clear
+ */
+
+#ifndef VOICE_PROCESSING_HOST_ECNS_H
+#define VOICE_PROCESSING_HOST_ECNS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Host side echo canceller and noise suppressor used when the DSP ECNS path
+ * is unavailable. Both engines work on mono 10 ms frames of float samples
+ * normalized to [-1, 1]; callers are responsible for buffering the framework
+ * period into frames of host_ecns_frame_size() samples.
+ */
+
+struct host_aec;
+struct host_ns;
+
+struct host_aec_stats {
+    float erle_db;              // smoothed echo return loss enhancement
+    uint32_t frames;            // frames processed since last reset
+    uint32_t dtd_frames;        // frames where adaptation was frozen (double talk)
+};
+
+size_t host_ecns_frame_size(uint32_t sample_rate);
+
+struct host_aec *host_aec_create(uint32_t sample_rate);
+void host_aec_destroy(struct host_aec *aec);
+void host_aec_reset(struct host_aec *aec);
+/* mic is processed in place, ref holds the far end frame time aligned with mic */
+void host_aec_process(struct host_aec *aec, float *mic, const float *ref);
+void host_aec_get_stats(struct host_aec *aec, struct host_aec_stats *stats);
+
+struct host_ns *host_ns_create(uint32_t sample_rate);
+void host_ns_destroy(struct host_ns *ns);
+void host_ns_reset(struct host_ns *ns);
+/* frame is processed in place; output is delayed by one frame (overlap-add) */
+void host_ns_process(struct host_ns *ns, float *frame);
+
+#endif /* VOICE_PROCESSING_HOST_ECNS_H */
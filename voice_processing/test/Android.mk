@@ -0,0 +1,31 @@
+LOCAL_PATH := $(call my-dir)
+
+# host_ecns_test
+# ==============================================================================
+include $(CLEAR_VARS)
+LOCAL_SRC_FILES := \
+    host_ecns_test.c \
+    ../host_ecns.c
+LOCAL_MODULE := host_ecns_test
+LOCAL_MODULE_TAGS := optional
+LOCAL_C_INCLUDES += \
+    $(LOCAL_PATH)/.. \
+    $(LOCAL_PATH)/../../hal/test
+LOCAL_CFLAGS += -Wall -Werror -Wno-sign-compare -O2
+LOCAL_SHARED_LIBRARIES := liblog
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+LOCAL_SRC_FILES := \
+    host_ecns_test.c \
+    ../host_ecns.c
+LOCAL_MODULE := host_ecns_test
+LOCAL_MODULE_TAGS := optional
+LOCAL_VENDOR_MODULE := true
+LOCAL_MODULE_OWNER := qti
+LOCAL_C_INCLUDES += \
+    $(LOCAL_PATH)/.. \
+    $(LOCAL_PATH)/../../hal/test
+LOCAL_CFLAGS += -Wall -Werror -Wno-sign-compare -O2
+LOCAL_SHARED_LIBRARIES := liblog
+include $(BUILD_EXECUTABLE)
@@ -0,0 +1,210 @@
+/*
+ * Copyright (c) 2023 Qualcomm Innovation Center, Inc. All rights reserved.
+ * SPDX-License-Identifier: BSD-3-Clause-Clear
+ */
+
+/*
+ * Offline harness for the host AEC/NS engine.
+ *
+ * The far end is shaped noise played through a synthetic 30 ms room
+ * response with 6 dB echo return loss at every rate; the microphone picks
+ * up the echo plus a little sensor noise, and a near end talker for one
+ * second in the middle (double talk). For each rate the harness reports
+ * the ERLE reached before and after double talk, how much of the double
+ * talk froze adaptation and how many single talk frames froze it wrongly,
+ * the noise suppressor attenuation on stationary noise and how much of a
+ * tone burst it keeps, and the CPU cost per 10 ms frame. It exits non zero
+ * if any figure misses its limit.
+ *
+ * usage: host_ecns_test [seconds]
+ */
+
+#include "test_common.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "host_ecns.h"
+
+#define ECHO_PATH_MS        30
+#define MIN_ERLE_DB         20.0f   /* converged, single talk */
+#define MIN_ERLE_DT_DB      15.0f   /* one second after double talk ended */
+#define MAX_ERLE_DT_DROP_DB 6.0f    /* ERLE lost over the double talk */
+#define MIN_DTD_FROZEN      0.9     /* share of double talk frames frozen */
+#define MAX_DTD_FALSE       0.02    /* share of converged single talk frozen */
+#define ECHO_RETURN_LOSS    0.5f    /* echo path gain, 6 dB */
+#define MIN_NS_ATTEN_DB     5.0
+#define MIN_NS_TONE_KEPT    0.5
+
+static uint32_t rnd_state = 1;
+
+static float rnd(void)
+{
+    rnd_state = rnd_state * 1664525u + 1013904223u;
+    return (float)(rnd_state >> 8) / (float)(1 << 24) - 0.5f;
+}
+
+static void test_aec(uint32_t rate, int seconds, double *cpu_us)
+{
+    const size_t frame = host_ecns_frame_size(rate);
+    const size_t taps = rate * ECHO_PATH_MS / 1000;
+    const int frames = seconds * 100;
+    const int dt_start = frames / 2, dt_end = dt_start + 100;
+    struct host_aec *aec = host_aec_create(rate);
+    struct host_ns *ns = host_ns_create(rate);
+    struct host_aec_stats stats;
+    float *h = calloc(taps, sizeof(float));
+    float *hist = calloc(taps, sizeof(float));
+    float *mic = calloc(frame, sizeof(float));
+    float *ref = calloc(frame, sizeof(float));
+    float erle_st = 0.0f, erle_dt = 0.0f, lp = 0.0f, norm = 0.0f;
+    uint32_t dtd_prev = 0, dt_frozen = 0, st_frozen = 0, st_frames = 0;
+    double total = 0.0, frozen, false_frozen;
+    size_t i, k;
+    int f;
+
+    EXPECT(aec != NULL && ns != NULL && h != NULL && hist != NULL && mic != NULL &&
+           ref != NULL, "%u: allocation failed", rate);
+    if (aec == NULL || ns == NULL || h == NULL || hist == NULL || mic == NULL || ref == NULL)
+        goto done;
+
+    /* same echo level at every rate, however many taps the response has */
+    for (k = 0; k < taps; k++) {
+        h[k] = rnd() * expf(-(float)k / (taps / 6.0f));
+        norm += h[k] * h[k];
+    }
+    for (k = 0; k < taps; k++)
+        h[k] *= ECHO_RETURN_LOSS / sqrtf(norm);
+
+    for (f = 0; f < frames; f++) {
+        for (i = 0; i < frame; i++) {
+            float y = 0.0f;
+
+            /* low passed noise is closer to speech than white noise */
+            lp = 0.7f * lp + 0.3f * rnd();
+            ref[i] = lp;
+            memmove(hist + 1, hist, (taps - 1) * sizeof(float));
+            hist[0] = lp;
+            for (k = 0; k < taps; k++)
+                y += h[k] * hist[k];
+            mic[i] = y + 1e-4f * rnd();
+            if (f >= dt_start && f < dt_end)
+                mic[i] += 0.2f * sinf(2.0f * (float)M_PI * 300.0f * (f * frame + i) / rate);
+        }
+
+        uint64_t t0 = test_now_ns();
+        host_aec_process(aec, mic, ref);
+        host_ns_process(ns, mic);
+        total += (test_now_ns() - t0) / 1e3;
+
+        host_aec_get_stats(aec, &stats);
+        if (f == dt_start - 1)
+            erle_st = stats.erle_db;
+        /* single talk once converged, away from the double talk hangover */
+        if (f >= dt_start && f < dt_end) {
+            dt_frozen += stats.dtd_frames != dtd_prev;
+        } else if (f >= 100 && (f < dt_start - 1 || f >= dt_end + 10)) {
+            st_frozen += stats.dtd_frames != dtd_prev;
+            st_frames++;
+        }
+        dtd_prev = stats.dtd_frames;
+    }
+    host_aec_get_stats(aec, &stats);
+    erle_dt = stats.erle_db;
+    *cpu_us = total / frames;
+    frozen = (double)dt_frozen / (dt_end - dt_start);
+    false_frozen = (double)st_frozen / st_frames;
+
+    printf("%6u: frame %3zu  ERLE %5.1f dB, %5.1f dB after double talk"
+           "  frozen %3.0f%% of double talk, %4.1f%% of single talk  %6.1f us/frame\n",
+           rate, frame, erle_st, erle_dt, 100.0 * frozen, 100.0 * false_frozen, *cpu_us);
+    EXPECT(erle_st >= MIN_ERLE_DB && erle_dt >= MIN_ERLE_DT_DB &&
+           erle_dt >= erle_st - MAX_ERLE_DT_DROP_DB,
+           "%u: ERLE below %.0f/%.0f dB or dropped over %.0f dB", rate,
+           MIN_ERLE_DB, MIN_ERLE_DT_DB, MAX_ERLE_DT_DROP_DB);
+    EXPECT(frozen >= MIN_DTD_FROZEN && false_frozen <= MAX_DTD_FALSE,
+           "%u: double talk froze %.0f%% (min %.0f%%), single talk %.1f%% (max %.1f%%)",
+           rate, 100.0 * frozen, 100.0 * MIN_DTD_FROZEN, 100.0 * false_frozen,
+           100.0 * MAX_DTD_FALSE);
+
+done:
+    host_aec_destroy(aec);
+    host_ns_destroy(ns);
+    free(h);
+    free(hist);
+    free(mic);
+    free(ref);
+}
+
+static void test_ns(uint32_t rate)
+{
+    const size_t frame = host_ecns_frame_size(rate);
+    struct host_ns *ns = host_ns_create(rate);
+    float *buf = calloc(frame, sizeof(float));
+    double noise_in = 0, noise_out = 0, tone_in = 0, tone_out = 0;
+    double atten, kept;
+    size_t i;
+    int f;
+
+    EXPECT(ns != NULL && buf != NULL, "%u: allocation failed", rate);
+    if (ns == NULL || buf == NULL)
+        goto done;
+
+    /* 10 frame bursts of a 1 kHz tone every 40 frames over constant noise */
+    for (f = 0; f < 400; f++) {
+        int burst = f > 40 && (f % 40) < 10;
+        double in = 0, out = 0;
+
+        for (i = 0; i < frame; i++) {
+            buf[i] = 0.02f * rnd();
+            if (burst)
+                buf[i] += 0.3f * sinf(2.0f * (float)M_PI * 1000.0f * (f * frame + i) / rate);
+            in += buf[i] * buf[i];
+        }
+        host_ns_process(ns, buf);
+        for (i = 0; i < frame; i++)
+            out += buf[i] * buf[i];
+
+        /* skip the frames next to burst edges, output lags one frame */
+        if (f <= 40)
+            continue;
+        if (burst && (f % 40) > 1) {
+            tone_in += in;
+            tone_out += out;
+        } else if (!burst && (f % 40) > 11) {
+            noise_in += in;
+            noise_out += out;
+        }
+    }
+    atten = 10 * log10(noise_in / noise_out);
+    kept = tone_out / tone_in;
+    printf("%6u: NS noise attenuation %5.1f dB, tone energy kept %.2f\n", rate, atten, kept);
+    EXPECT(atten >= MIN_NS_ATTEN_DB && kept >= MIN_NS_TONE_KEPT,
+           "%u: NS below %.0f dB or %.2f", rate, MIN_NS_ATTEN_DB, MIN_NS_TONE_KEPT);
+
+done:
+    host_ns_destroy(ns);
+    free(buf);
+}
+
+int main(int argc, char **argv)
+{
+    static const uint32_t rates[] = { 8000, 16000, 32000, 44100, 48000 };
+    int seconds = argc > 1 ? atoi(argv[1]) : 10;
+    double cpu_us;
+    size_t r;
+
+    if (seconds < 4)
+        seconds = 4;
+
+    printf("host ECNS, %d s synthetic echo per rate\n", seconds);
+    for (r = 0; r < sizeof(rates) / sizeof(rates[0]); r++) {
+        rnd_state = 1;
+        test_aec(rates[r], seconds, &cpu_us);
+        test_ns(rates[r]);
+    }
+    EXPECT(host_aec_create(44000 + 50) == NULL && host_ns_create(0) == NULL,
+           "unsupported rate accepted");
+
+    return test_finish();
+}
@@ -22,12 +22,14 @@
 #include <stdlib.h>
 #include <log/log.h>
 #include <cutils/list.h>
+#include <cutils/properties.h>
 #include <unistd.h>
 #include <hardware/audio_effect.h>
 #include <audio_effects/effect_aec.h>
 #include <audio_effects/effect_agc.h>
 #include <audio_effects/effect_ns.h>
 
+#include "host_ecns.h"
 
 //------------------------------------------------------------------------------
 // local definitions
@@ -35,6 +37,13 @@
 
 #define EFFECTS_DESCRIPTOR_LIBRARY_PATH "/vendor/lib/soundfx/libqcomvoiceprocessingdescriptors.so"
 
+// enables the host side AEC/NS engine instead of relying on the DSP ECNS path
+#define HOST_ECNS_PROPERTY "vendor.audio.voiceprocessing.host_ecns.enable"
+// far end samples kept for the echo canceller, in frames
+#define HOST_ECNS_REVERSE_FRAMES 8
+// effects run by the host engine, AGC is left to the DSP path
+#define HOST_ECNS_FX_MSK ((1 << AEC_ID) | (1 << NS_ID))
+
 // types of pre processing modules
 enum effect_id
 {
@@ -89,6 +98,24 @@ struct session_s {
     uint32_t created_msk;            // bit field containing IDs of crested pre processors
     uint32_t enabled_msk;            // bit field containing IDs of enabled pre processors
     uint32_t processed_msk;          // bit field containing IDs of pre processors already
+    effect_config_t rev_config;      // far end (reverse) stream configuration
+    bool rev_configured;             // rev_config was accepted
+    // host engine state, only allocated when the host ECNS engine is enabled
+    struct host_aec *aec;
+    struct host_ns *ns;
+    size_t frame_size;               // engine frame size in samples (10 ms)
+    bool primed;                     // output latency settled on the first period
+    float *frame;                    // near end frame being processed
+    float *ref_frame;                // far end frame aligned with frame
+    int16_t *in_buf;                 // near end samples waiting for a full frame
+    size_t in_cnt;
+    size_t in_cap;
+    int16_t *out_buf;                // processed samples waiting to be returned
+    size_t out_cnt;
+    size_t out_cap;
+    int16_t *rev_buf;                // far end samples received by process_reverse
+    size_t rev_cnt;
+    size_t rev_cap;
 };
 
 
@@ -147,6 +174,7 @@ const effect_descriptor_t *descriptors[NUM_ID] = {
 
 
 static int init_status = 1;
+static bool host_ecns_enabled = false;
 struct listnode session_list;
 static const struct effect_interface_s effect_interface;
 static const effect_uuid_t * uuid_to_id_table[NUM_ID];
@@ -178,6 +206,7 @@ static uint32_t uuid_to_id(const effect_uuid_t * uuid)
 //------------------------------------------------------------------------------
 
 static void session_set_fx_enabled(struct session_s *session, uint32_t id, bool enabled);
+static void session_release_host_engine(struct session_s *session);
 
 #define BAD_STATE_ABORT(from, to) \
         LOG_ALWAYS_FATAL("Bad state transition from %d to %d", from, to);
@@ -292,6 +321,8 @@ static int session_init(struct session_s *session)
     session->id = 0;
     session->io = 0;
     session->created_msk = 0;
+    session->aec = NULL;
+    session->ns = NULL;
     for (i = 0; i < NUM_ID && status == 0; i++)
         status = effect_init(&session->effects[i], i);
 
@@ -339,6 +370,7 @@ static int session_release_effect(struct session_s *session,
     if (session->created_msk == 0)
     {
         ALOGV("session_release_effect() last effect: removing session");
+        session_release_host_engine(session);
         list_remove(&session->node);
         free(session);
     }
@@ -369,6 +401,11 @@ static int session_set_config(struct session_s *session, effect_config_t *config
             return 0;
     }
 
+    // the far end is not resampled, a reverse config at the old rate is stale
+    if (session->rev_configured &&
+            session->rev_config.inputCfg.samplingRate != config->inputCfg.samplingRate)
+        session->rev_configured = false;
+
     memcpy(&session->config, config, sizeof(effect_config_t));
 
     session->state = SESSION_STATE_CONFIG;
@@ -383,6 +420,215 @@ static void session_get_config(struct session_s *session, effect_config_t *confi
             (EFFECT_CONFIG_SMP_RATE | EFFECT_CONFIG_CHANNELS | EFFECT_CONFIG_FORMAT);
 }
 
+static int session_set_reverse_config(struct session_s *session, effect_config_t *config)
+{
+    // the far end is downmixed but not resampled, so it must match the near end
+    if (config->inputCfg.samplingRate != session->config.inputCfg.samplingRate ||
+            config->inputCfg.format != session->config.inputCfg.format ||
+            audio_channel_count_from_out_mask(config->inputCfg.channels) == 0) {
+        ALOGW("session_set_reverse_config() rejected sampling rate %d format %d "
+              "channels %08x, near end sampling rate %d format %d",
+              config->inputCfg.samplingRate, config->inputCfg.format,
+              config->inputCfg.channels, session->config.inputCfg.samplingRate,
+              session->config.inputCfg.format);
+        return -EINVAL;
+    }
+
+    memcpy(&session->rev_config, config, sizeof(effect_config_t));
+    session->rev_configured = true;
+    return 0;
+}
+
+static void session_get_reverse_config(struct session_s *session, effect_config_t *config)
+{
+    memcpy(config, &session->rev_config, sizeof(effect_config_t));
+
+    config->inputCfg.mask = config->outputCfg.mask =
+            (EFFECT_CONFIG_SMP_RATE | EFFECT_CONFIG_CHANNELS | EFFECT_CONFIG_FORMAT);
+}
+
+//------------------------------------------------------------------------------
+// Host ECNS engine
+//------------------------------------------------------------------------------
+
+static int host_buf_reserve(int16_t **buf, size_t *cap, size_t count)
+{
+    int16_t *new_buf;
+
+    if (count <= *cap)
+        return 0;
+
+    new_buf = (int16_t *)realloc(*buf, count * sizeof(int16_t));
+    if (new_buf == NULL)
+        return -ENOMEM;
+    *buf = new_buf;
+    *cap = count;
+    return 0;
+}
+
+static void host_buf_consume(int16_t *buf, size_t *cnt, size_t count)
+{
+    *cnt -= count;
+    memmove(buf, buf + count, *cnt * sizeof(int16_t));
+}
+
+static void session_release_host_engine(struct session_s *session)
+{
+    struct host_aec_stats stats;
+
+    if (session->aec != NULL) {
+        host_aec_get_stats(session->aec, &stats);
+        ALOGD("%s: session %d AEC frames %u double talk %u ERLE %.1f dB", __func__,
+              session->id, stats.frames, stats.dtd_frames, stats.erle_db);
+    }
+    host_aec_destroy(session->aec);
+    host_ns_destroy(session->ns);
+    free(session->frame);
+    free(session->ref_frame);
+    free(session->in_buf);
+    free(session->out_buf);
+    free(session->rev_buf);
+    session->aec = NULL;
+    session->ns = NULL;
+    session->frame = session->ref_frame = NULL;
+    session->in_buf = session->out_buf = session->rev_buf = NULL;
+    session->in_cnt = session->out_cnt = session->rev_cnt = 0;
+    session->in_cap = session->out_cap = session->rev_cap = 0;
+}
+
+static int session_create_host_engine(struct session_s *session)
+{
+    uint32_t rate = session->config.inputCfg.samplingRate;
+
+    if (!host_ecns_enabled)
+        return 0;
+
+    if (session->config.inputCfg.channels != AUDIO_CHANNEL_IN_MONO || rate % 100 != 0) {
+        ALOGW("%s: unsupported config rate %u channels %08x, host ECNS disabled",
+              __func__, rate, session->config.inputCfg.channels);
+        return -EINVAL;
+    }
+
+    session->frame_size = host_ecns_frame_size(rate);
+    session->aec = host_aec_create(rate);
+    session->ns = host_ns_create(rate);
+    session->frame = (float *)calloc(session->frame_size, sizeof(float));
+    session->ref_frame = (float *)calloc(session->frame_size, sizeof(float));
+    if (session->aec == NULL || session->ns == NULL ||
+            session->frame == NULL || session->ref_frame == NULL ||
+            host_buf_reserve(&session->out_buf, &session->out_cap, 2 * session->frame_size) ||
+            host_buf_reserve(&session->rev_buf, &session->rev_cap,
+                             HOST_ECNS_REVERSE_FRAMES * session->frame_size)) {
+        ALOGE("%s: failed to allocate host engine", __func__);
+        session_release_host_engine(session);
+        return -ENOMEM;
+    }
+    session->out_cnt = 0;
+    session->primed = false;
+
+    ALOGV("%s: session %d rate %u frame %zu", __func__, session->id, rate, session->frame_size);
+    return 0;
+}
+
+static void session_reset_host_engine(struct session_s *session)
+{
+    if (session->aec == NULL)
+        return;
+
+    host_aec_reset(session->aec);
+    host_ns_reset(session->ns);
+    session->in_cnt = 0;
+    session->rev_cnt = 0;
+    session->out_cnt = 0;
+    session->primed = false;
+}
+
+static int session_process_host_engine(struct session_s *session,
+                                       audio_buffer_t *in_buffer,
+                                       audio_buffer_t *out_buffer)
+{
+    const size_t frame_size = session->frame_size;
+    size_t frames = in_buffer->frameCount;
+    size_t avail, i;
+
+    if (host_buf_reserve(&session->in_buf, &session->in_cap, session->in_cnt + frames) ||
+            host_buf_reserve(&session->out_buf, &session->out_cap,
+                             session->out_cnt + frames + frame_size))
+        return -ENOMEM;
+
+    // A period that is not a multiple of the frame size leaves a partial
+    // frame behind on some calls. The output is then primed with one frame
+    // of silence so that a full period can always be returned; periods made
+    // of whole frames are processed without added latency.
+    if (!session->primed) {
+        if (frames % frame_size != 0) {
+            memset(session->out_buf, 0, frame_size * sizeof(int16_t));
+            session->out_cnt = frame_size;
+        }
+        session->primed = true;
+    }
+
+    memcpy(session->in_buf + session->in_cnt, in_buffer->s16, frames * sizeof(int16_t));
+    session->in_cnt += frames;
+
+    while (session->in_cnt >= frame_size) {
+        for (i = 0; i < frame_size; i++)
+            session->frame[i] = session->in_buf[i] * (1.0f / 32768.0f);
+        host_buf_consume(session->in_buf, &session->in_cnt, frame_size);
+
+        if (session->enabled_msk & (1 << AEC_ID)) {
+            // missing far end (no playback or late reverse stream) is silence
+            avail = session->rev_cnt < frame_size ? session->rev_cnt : frame_size;
+            for (i = 0; i < avail; i++)
+                session->ref_frame[i] = session->rev_buf[i] * (1.0f / 32768.0f);
+            for (; i < frame_size; i++)
+                session->ref_frame[i] = 0.0f;
+            host_buf_consume(session->rev_buf, &session->rev_cnt, avail);
+            host_aec_process(session->aec, session->frame, session->ref_frame);
+        }
+        if (session->enabled_msk & (1 << NS_ID))
+            host_ns_process(session->ns, session->frame);
+
+        for (i = 0; i < frame_size; i++) {
+            float sample = session->frame[i] * 32768.0f;
+            sample = sample > 32767.0f ? 32767.0f : (sample < -32768.0f ? -32768.0f : sample);
+            session->out_buf[session->out_cnt + i] = (int16_t)sample;
+        }
+        session->out_cnt += frame_size;
+    }
+
+    avail = session->out_cnt < frames ? session->out_cnt : frames;
+    memset(out_buffer->s16, 0, (frames - avail) * sizeof(int16_t));
+    memcpy(out_buffer->s16 + (frames - avail), session->out_buf, avail * sizeof(int16_t));
+    host_buf_consume(session->out_buf, &session->out_cnt, avail);
+    return 0;
+}
+
+static int session_process_reverse_host_engine(struct session_s *session,
+                                               audio_buffer_t *in_buffer)
+{
+    uint32_t channels = audio_channel_count_from_out_mask(session->rev_config.inputCfg.channels);
+    size_t frames = in_buffer->frameCount;
+    size_t drop, i;
+    int32_t sum;
+    uint32_t ch;
+
+    if (frames > session->rev_cap)
+        frames = session->rev_cap;
+
+    // keep the most recent far end, dropping the oldest samples on overflow
+    if (session->rev_cnt + frames > session->rev_cap) {
+        drop = session->rev_cnt + frames - session->rev_cap;
+        host_buf_consume(session->rev_buf, &session->rev_cnt, drop);
+    }
+    for (i = 0; i < frames; i++) {
+        for (ch = 0, sum = 0; ch < channels; ch++)
+            sum += in_buffer->s16[(in_buffer->frameCount - frames + i) * channels + ch];
+        session->rev_buf[session->rev_cnt + i] = (int16_t)(sum / (int32_t)channels);
+    }
+    session->rev_cnt += frames;
+    return 0;
+}
 
 static void session_set_fx_enabled(struct session_s *session, uint32_t id, bool enabled)
 {
@@ -390,12 +636,16 @@ static void session_set_fx_enabled(struct session_s *session, uint32_t id, bool
         if(session->enabled_msk == 0) {
             /* do first enable here */
         }
+        if (!(session->enabled_msk & HOST_ECNS_FX_MSK) && ((1 << id) & HOST_ECNS_FX_MSK))
+            session_create_host_engine(session);
         session->enabled_msk |= (1 << id);
     } else {
         session->enabled_msk &= ~(1 << id);
         if(session->enabled_msk == 0) {
             /* do last enable here */
         }
+        if (!(session->enabled_msk & HOST_ECNS_FX_MSK))
+            session_release_host_engine(session);
     }
     ALOGV("session_set_fx_enabled() id %d, enabled %d enabled_msk %08x",
          id, enabled, session->enabled_msk);
@@ -477,6 +727,9 @@ static int init() {
 
     list_init(&session_list);
 
+    host_ecns_enabled = property_get_bool(HOST_ECNS_PROPERTY, false);
+    ALOGV("%s: host ECNS engine %s", __func__, host_ecns_enabled ? "enabled" : "disabled");
+
     init_status = 0;
     return init_status;
 }
@@ -516,6 +769,17 @@ static int fx_process(effect_handle_t     self,
 
     session = (struct session_s *)effect->session;
 
+    if (session->aec != NULL) {
+        // the whole chain runs on the first enabled effect of each round,
+        // the others see already processed samples
+        if (session->processed_msk == 0) {
+            if (session_process_host_engine(session, inBuffer, outBuffer) != 0)
+                return -ENOMEM;
+        } else if (inBuffer->raw != outBuffer->raw) {
+            memcpy(outBuffer->raw, inBuffer->raw, inBuffer->frameCount * sizeof(int16_t));
+        }
+    }
+
     session->processed_msk |= (1<<effect->id);
 
     if ((session->processed_msk & session->enabled_msk) == session->enabled_msk) {
@@ -525,6 +789,37 @@ static int fx_process(effect_handle_t     self,
         return -ENODATA;
 }
 
+static int fx_process_reverse(effect_handle_t     self,
+                              audio_buffer_t    *inBuffer,
+                              audio_buffer_t    *outBuffer __unused)
+{
+    struct effect_s *effect = (struct effect_s *)self;
+    struct session_s *session;
+
+    if (effect == NULL) {
+        ALOGV("fx_process_reverse() ERROR effect == NULL");
+        return -EINVAL;
+    }
+
+    if (inBuffer == NULL  || inBuffer->raw == NULL) {
+        ALOGW("fx_process_reverse() ERROR bad pointer");
+        return -EINVAL;
+    }
+
+    session = (struct session_s *)effect->session;
+
+    // only the echo canceller consumes the far end
+    if (effect->id != AEC_ID || session->aec == NULL)
+        return -ENODATA;
+
+    if (!session->rev_configured) {
+        ALOGW("fx_process_reverse() ERROR no reverse config");
+        return -EINVAL;
+    }
+
+    return session_process_reverse_host_engine(session, inBuffer);
+}
+
 static int fx_command(effect_handle_t  self,
                             uint32_t            cmdCode,
                             uint32_t            cmdSize,
@@ -574,7 +869,30 @@ static int fx_command(effect_handle_t  self,
             session_get_config(effect->session, (effect_config_t *)pReplyData);
             break;
 
+        case EFFECT_CMD_SET_CONFIG_REVERSE:
+            if (pCmdData    == NULL||
+                    cmdSize     != sizeof(effect_config_t)||
+                    pReplyData  == NULL||
+                    *replySize  != sizeof(int)) {
+                ALOGV("fx_command() EFFECT_CMD_SET_CONFIG_REVERSE invalid args");
+                return -EINVAL;
+            }
+            *(int *)pReplyData = session_set_reverse_config(effect->session,
+                                                            (effect_config_t *)pCmdData);
+            break;
+
+        case EFFECT_CMD_GET_CONFIG_REVERSE:
+            if (pReplyData == NULL ||
+                    *replySize != sizeof(effect_config_t)) {
+                ALOGV("fx_command() EFFECT_CMD_GET_CONFIG_REVERSE invalid args");
+                return -EINVAL;
+            }
+
+            session_get_reverse_config(effect->session, (effect_config_t *)pReplyData);
+            break;
+
         case EFFECT_CMD_RESET:
+            session_reset_host_engine(effect->session);
             break;
 
         case EFFECT_CMD_GET_PARAM: {
@@ -678,7 +996,7 @@ static const struct effect_interface_s effect_interface = {
     fx_process,
     fx_command,
     fx_get_descriptor,
-    NULL
+    fx_process_reverse
 };
 
 //------------------------------------------------------------------------------